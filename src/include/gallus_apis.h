@@ -14,11 +14,12 @@
 #include "gallus_perror.h"
 #include "gallus_heapcheck.h"
 #include "gallus_numa.h"
+#include "gallus_topology.h"
 #include "gallus_dstring.h"
-#include "gallus_hashmap.h"
 #include "gallus_chrono.h"
 #include "gallus_gstate.h"
 #include "gallus_lock.h"
+#include "gallus_hashmap.h"
 #include "gallus_thread.h"
 #include "gallus_strutils.h"
 #include "gallus_qmuxer.h"
@@ -38,6 +39,10 @@
 #include "gallus_poolable.h"
 #include "gallus_pool.h"
 #include "gallus_pooled_thread.h"
+#include "gallus_future.h"
+#include "gallus_parallel.h"
+#include "gallus_sort.h"
+#include "gallus_fiber.h"
 #include "gallus_task.h"
 
 
@@ -0,0 +1,122 @@
+#ifndef __GALLUS_ATOMIC_H__
+#define __GALLUS_ATOMIC_H__
+
+
+
+
+
+/**
+ *	@file	gallus_atomic.h
+ */
+
+
+
+
+
+/*
+ * Atomic operations with explicit memory orderings, on the GCC
+ * __atomic builtins. The builtins take plain (and volatile) objects,
+ * so no _Atomic type is needed for the existing structures.
+ *
+ * Choose the weakest ordering that is correct:
+ *
+ *	RELAXED	... counters and statistics nobody synchronizes with.
+ *	ACQUIRE	... a load of a flag/index guarding data written by
+ *		    other threads.
+ *	RELEASE	... a store of a flag/index publishing data written
+ *		    before it.
+ *	ACQ_REL	... an RMW doing both.
+ *	SEQ_CST	... only for the store-then-load handshakes (Dekker
+ *		    style) where two threads each write then read the
+ *		    other's variable.
+ *
+ * Note that the accesses under a mutex need no ordering at all, the
+ * mutex does it.
+ */
+
+
+
+
+
+#ifdef __GNUC__
+
+#define GALLUS_ATOMIC_RELAXED	__ATOMIC_RELAXED
+#define GALLUS_ATOMIC_ACQUIRE	__ATOMIC_ACQUIRE
+#define GALLUS_ATOMIC_RELEASE	__ATOMIC_RELEASE
+#define GALLUS_ATOMIC_ACQ_REL	__ATOMIC_ACQ_REL
+#define GALLUS_ATOMIC_SEQ_CST	__ATOMIC_SEQ_CST
+
+
+#define gallus_atomic_load(addr, mo)                    \
+  __atomic_load_n((addr), GALLUS_ATOMIC_ ## mo)
+#define gallus_atomic_store(addr, val, mo)              \
+  __atomic_store_n((addr), (val), GALLUS_ATOMIC_ ## mo)
+#define gallus_atomic_exchange(addr, val, mo)           \
+  __atomic_exchange_n((addr), (val), GALLUS_ATOMIC_ ## mo)
+
+
+/*
+ * The expected value is passed by the pointer and updated with the
+ * current value if the CAS fails. The _weak version may fail
+ * spuriously, use it in a loop.
+ */
+#define gallus_atomic_cas(addr, expptr, val, mo_s, mo_f)                \
+  __atomic_compare_exchange_n((addr), (expptr), (val), false,           \
+                              GALLUS_ATOMIC_ ## mo_s,                   \
+                              GALLUS_ATOMIC_ ## mo_f)
+#define gallus_atomic_cas_weak(addr, expptr, val, mo_s, mo_f)           \
+  __atomic_compare_exchange_n((addr), (expptr), (val), true,            \
+                              GALLUS_ATOMIC_ ## mo_s,                   \
+                              GALLUS_ATOMIC_ ## mo_f)
+
+
+#define gallus_atomic_fetch_add(addr, val, mo)          \
+  __atomic_fetch_add((addr), (val), GALLUS_ATOMIC_ ## mo)
+#define gallus_atomic_fetch_sub(addr, val, mo)          \
+  __atomic_fetch_sub((addr), (val), GALLUS_ATOMIC_ ## mo)
+#define gallus_atomic_add_fetch(addr, val, mo)          \
+  __atomic_add_fetch((addr), (val), GALLUS_ATOMIC_ ## mo)
+#define gallus_atomic_sub_fetch(addr, val, mo)          \
+  __atomic_sub_fetch((addr), (val), GALLUS_ATOMIC_ ## mo)
+#define gallus_atomic_fetch_or(addr, val, mo)           \
+  __atomic_fetch_or((addr), (val), GALLUS_ATOMIC_ ## mo)
+#define gallus_atomic_fetch_and(addr, val, mo)          \
+  __atomic_fetch_and((addr), (val), GALLUS_ATOMIC_ ## mo)
+
+
+#define gallus_atomic_fence(mo)                 \
+  __atomic_thread_fence(GALLUS_ATOMIC_ ## mo)
+
+/*
+ * Only stops the compiler reordering.
+ */
+#define gallus_compiler_barrier()       __asm__ volatile("" ::: "memory")
+
+
+/*
+ * Lower/raise *addr to val if val is smaller/larger, or if *addr is
+ * still the init. Relaxed: a min/max only orders against itself.
+ */
+#define gallus_atomic_update_cmp(type, addr, init, val, cmp)            \
+{                                                                       \
+  type __tmp__ = gallus_atomic_load((addr), RELAXED);                   \
+  while (__tmp__ == (init) || __tmp__ cmp (val)) {                      \
+    if (likely(gallus_atomic_cas_weak((addr), &__tmp__, (val),          \
+                                      RELAXED, RELAXED) == true)) {     \
+      break;                                                            \
+    }                                                                   \
+  }                                                                     \
+}
+
+#define gallus_atomic_update_min(type, addr, init, val)  \
+    gallus_atomic_update_cmp(type, addr, init, val, >)
+#define gallus_atomic_update_max(type, addr, init, val)  \
+    gallus_atomic_update_cmp(type, addr, init, val, <)
+
+#endif /* __GNUC__ */
+
+
+
+
+
+#endif /* __GALLUS_ATOMIC_H__ */
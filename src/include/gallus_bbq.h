@@ -49,6 +49,24 @@ typedef gallus_cbuffer_t gallus_bbq_t;
   gallus_cbuffer_create((bbqptr), type, (length), (proc))
 
 
+/**
+ * Create a bounded blocking queue on the NUMA node of a CPU.
+ *
+ *     @param[out] bbqptr         A pointer to a queue to be created.
+ *     @param[in]  type           A type of a value of the queue.
+ *     @param[in]  maxelem        A maximum # of the value the queue holds.
+ *     @param[in]  proc           A value free up function (\b NULL allowed).
+ *     @param[in]  cpu            A CPU of the consumer (<0: anywhere.)
+ *
+ *     @retval GALLUS_RESULT_OK               Succeeded.
+ *     @retval GALLUS_RESULT_NO_MEMORY        Failed, no memory.
+ *     @retval GALLUS_RESULT_ANY_FAILURES     Failed.
+ */
+#define gallus_bbq_create_on_cpu(bbqptr, type, length, proc, cpu)      \
+  gallus_cbuffer_create_on_cpu((bbqptr), sizeof(type), (length), (proc), \
+                               (cpu))
+
+
 /**
  * Shutdown a bounded blocking queue.
  *
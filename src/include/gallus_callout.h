@@ -124,6 +124,22 @@ gallus_result_t
 gallus_callout_stop_main_loop(void);
 
 
+/**
+ * Run the idle proc as soon as possible, not waiting for the idle
+ * interval.
+ *
+ *	@retval	GALLUS_RESULT_OK		Succeeded.
+ *      @retval GALLUS_RESULT_NOT_OPERATIONAL  Failed, the handler is
+ *      not initialized.
+ *
+ * @details This is safe to call from any thread, e.g. from a global
+ * state subscription proc to make the idle proc handle a shutdown
+ * request without polling.
+ */
+gallus_result_t
+gallus_callout_kick_idle_proc(void);
+
+
 
 
 
@@ -182,6 +198,43 @@ gallus_callout_submit_task(const gallus_callout_task_t *tptr,
                             gallus_chrono_t interval);
 
 
+/**
+ * Submit callout tasks at once.
+ *
+ *	@param[in]	tasks	An array of tasks.
+ *	@param[in]	n	A # of the \b tasks.
+ *	@param[in]	delay	Same as the gallus_callout_submit_task().
+ *	@param[in]	interval	Same as the gallus_callout_submit_task().
+ *
+ *	@retval	>0	Succeeded, the \b n.
+ *      @retval GALLUS_RESULT_INVALID_OBJECT   Failed, invalid task(s).
+ *      @retval GALLUS_RESULT_INVALID_STATE_TRANSITION	Failed, task(s) already submitted or being submitted.
+ *      @retval GALLUS_RESULT_INVALID_ARGS     Failed, invalid args, a NULL or duplicated task.
+ *      @retval GALLUS_RESULT_TOO_SMALL        Failed, the \b interval is too small.
+ *      @retval GALLUS_RESULT_NOT_OPERATIONAL  Failed, the callout handler is not initialized.
+ *      @retval GALLUS_RESULT_ANY_FAILURES     Failed.
+ *
+ * @details The tasks must be distinct and freshly created. The whole
+ * batch is checked first, and on a failure none of the tasks is
+ * submitted nor modified. Submitting n tasks by this costs about the
+ * same as submitting a task by the gallus_callout_submit_task().
+ *
+ * @details The non-timed (\b delay <= 0) tasks are queued as the
+ * queue has room, so a batch larger than the queue blocks the caller
+ * until the callout handler drains enough, and the tasks queued first
+ * may run before the rest are queued.
+ *
+ * @details The only exception is the callout handler shutting down
+ * while the non-timed (\b delay <= 0) tasks are queued; then the #
+ * of the tasks queued, if any, is returned, less than the \b n, and
+ * the rest are not submitted.
+ */
+gallus_result_t
+gallus_callout_submit_tasks(const gallus_callout_task_t *tasks, size_t n,
+                             gallus_chrono_t delay,
+                             gallus_chrono_t interval);
+
+
 /**
  * Cancel a submitted task.
  *
@@ -190,11 +243,29 @@ gallus_callout_submit_task(const gallus_callout_task_t *tptr,
  * @details \b If the \b *tptr has created with the non-NULL \b arg
  * and \b freeproc, calling this function implicitly free/clean the \b
  * arg up.
+ *
+ * @details A task waiting for its time is cancelled lazily; it is
+ * just marked as cancelled here and destroyed (and the \b arg is
+ * freed up) later by the scheduler, at the latest when the time
+ * comes.
  */
 void
 gallus_callout_cancel_task(const gallus_callout_task_t *tptr);
 
 
+/**
+ * Cancel submitted tasks.
+ *
+ *	@param[in]	tasks	An array of tasks.
+ *	@param[in]	n	A # of the \b tasks.
+ *
+ * @details Same as calling the gallus_callout_cancel_task() for each
+ * task.
+ */
+void
+gallus_callout_cancel_tasks(const gallus_callout_task_t *tasks, size_t n);
+
+
 /**
  * Execute the sumitted task forcibly.
  *
@@ -31,6 +31,10 @@ typedef struct gallus_callout_task_record {
 
   volatile callout_task_state_t m_status;
 
+  /*
+   * The executor increments the exec count then reads the cancel
+   * count, a canceller does it the other way around; SEQ_CST.
+   */
   volatile size_t m_exec_ref_count;	/** 0 ... no one is executing;
                                             >0 ... someone is executing. */
   volatile size_t m_cancel_ref_count;	/** 0 ... no one is cancelling;
@@ -48,6 +52,11 @@ typedef struct gallus_callout_task_record {
                             insertion/removal. */
   bool m_is_in_bbq;	/** \b true ... the task is either in the
                             uegent Q or the idle Q. */
+  bool m_is_claimed;	/** \b true ... a submitter owns the task
+                            until it is queued. Under the task
+                            lock. */
+  size_t m_shard;	/** The timed task shard the task belongs
+                            to. */
   gallus_chrono_t m_initial_delay_time;
   gallus_chrono_t m_interval_time;
   gallus_chrono_t m_last_abstime;
@@ -58,6 +58,29 @@ gallus_cbuffer_create_with_size(gallus_cbuffer_t *cbptr,
   gallus_cbuffer_create_with_size((cbptr), sizeof(type), (maxelems), (proc))
 
 
+/**
+ * Create a circular buffer on the NUMA node of a CPU.
+ *
+ *     @param[in,out]	cbptr	A pointer to a circular buffer to be created.
+ *     @param[in]	elemsize	A size of the element.
+ *     @param[in]	maxelems	# of maximum elements.
+ *     @param[in]	proc	A value free up function (\b NULL allowed).
+ *     @param[in]	cpu	A CPU of the consumer (<0: anywhere.)
+ *
+ *     @retval GALLUS_RESULT_OK               Succeeded.
+ *     @retval GALLUS_RESULT_NO_MEMORY        Failed, no memory.
+ *     @retval GALLUS_RESULT_ANY_FAILURES     Failed.
+ *
+ *     @details The buffer is allocated by \b gallus_malloc_on_cpu().
+ */
+gallus_result_t
+gallus_cbuffer_create_on_cpu(gallus_cbuffer_t *cbptr,
+                             size_t elemsize,
+                             int64_t maxelems,
+                             gallus_cbuffer_value_freeup_proc_t proc,
+                             int cpu);
+
+
 /**
  * Shutdown a circular buffer.
  *
@@ -19,10 +19,55 @@ __BEGIN_DECLS
 
 
 
+/**
+ * Get the current time of the monotonic clock.
+ *
+ *	@returns	The current time (nsec), comparable to the \b
+ *			CLOCK_MONOTONIC.
+ *
+ * @details Use this for the timeouts and the scheduling, it doesn't
+ * follow the wall clock steps. It reads the invariant TSC calibrated
+ * against the \b CLOCK_MONOTONIC if the CPU has one, and calls the \b
+ * clock_gettime() otherwise.
+ */
 gallus_chrono_t
 gallus_chrono_now(void);
 
 
+/**
+ * Get the current time of the monotonic clock in a kernel tick (1 to
+ * 10 msec) precision.
+ *
+ *	@returns	The current time (nsec), comparable to the \b
+ *			gallus_chrono_now().
+ *
+ * @details It's the \b CLOCK_MONOTONIC_COARSE, the time of the last
+ * kernel tick read without a syscall, for the hot loops. It lags the
+ * gallus_chrono_now() by up to a tick.
+ */
+gallus_chrono_t
+gallus_chrono_coarse_now(void);
+
+
+/**
+ * Get the current wall clock time.
+ *
+ *	@returns	The current time (nsec) since the Epoch.
+ */
+gallus_chrono_t
+gallus_chrono_realtime_now(void);
+
+
+/**
+ * Returns if the \b gallus_chrono_now() reads the TSC.
+ *
+ *	@retval	true	It reads the TSC.
+ *	@retval false	It calls the \b clock_gettime().
+ */
+bool
+gallus_chrono_is_tsc_used(void);
+
+
 gallus_result_t
 gallus_chrono_to_timespec(struct timespec *dstptr,
                            gallus_chrono_t nsec);
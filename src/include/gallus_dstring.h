@@ -33,6 +33,26 @@ typedef struct dstring *gallus_dstring_t;
 gallus_result_t
 gallus_dstring_create(gallus_dstring_t *ds);
 
+/**
+ * Create a dynamic string in the rope mode.
+ *
+ *     @param[out]	ds	A pointer to a dynamic string to be created.
+ *
+ *     @retval	GALLUS_RESULT_OK	Succeeded.
+ *     @retval	GALLUS_RESULT_ANY_FAILURES	Failed.
+ *     @retval	GALLUS_RESULT_INVALID_ARGS	Failed, invalid argument(s).
+ *     @retval	GALLUS_RESULT_NO_MEMORY	Failed, no memory.
+ *
+ *     @details A rope mode dynamic string is a list of segments; the
+ *     appends never move the text already written and the prepends
+ *     and inserts link new segments. It's meant for building large
+ *     outputs that are written out by gallus_dstring_iovec_get() /
+ *     session_write_dstring() without being flattened.
+ *     gallus_dstring_str_get() still returns the flattened copy.
+ */
+gallus_result_t
+gallus_dstring_create_rope(gallus_dstring_t *ds);
+
 /**
  * Destroy a dynamic string.
  *
@@ -212,6 +232,24 @@ gallus_dstring_len_get(gallus_dstring_t *ds);
 bool
 gallus_dstring_empty(gallus_dstring_t *ds);
 
+/**
+ * Get the pieces of a dynamic string as \e struct \e iovec.
+ *
+ *     @param[in]	ds	A pointer to a dynamic string.
+ *     @param[out]	iov	An array of \e struct \e iovec.
+ *     @param[in]	max	The number of the entries of \b iov.
+ *
+ *     @retval	>=0	The number of the pieces, only the first \b max
+ *     are stored.
+ *     @retval	GALLUS_RESULT_INVALID_ARGS	Failed, invalid argument(s).
+ *
+ *     @details The iovecs point into the \b ds, valid until it's
+ *     modified. A flat one has a single piece (none if empty).
+ */
+gallus_result_t
+gallus_dstring_iovec_get(gallus_dstring_t *ds,
+                          struct iovec *iov, size_t max);
+
 
 
 
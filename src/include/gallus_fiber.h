@@ -0,0 +1,183 @@
+#pragma once
+
+
+
+
+
+/**
+ *	@file	gallus_fiber.h
+ *
+ * A parked fiber may resume on another carrier thread. So a fiber
+ * must not yield, sleep, wait for a file descriptor or wait on a
+ * gallus_cond_t while it holds a gallus_mutex_t or a gallus_rwlock_t
+ * bound to its owner thread: any but the \b FUTEX types, and the read
+ * side of the \b DISTRIBUTED rwlock. The mutex a gallus_cond_wait()
+ * releases counts as held if it's recursive and locked more than
+ * once. It's asserted unless \b NDEBUG is defined.
+ */
+
+
+
+
+
+__BEGIN_DECLS
+
+
+
+
+
+typedef struct gallus_fiber_sched_record *gallus_fiber_sched_t;
+typedef struct gallus_fiber_record *gallus_fiber_t;
+
+
+/**
+ * The signature of fiber main functions.
+ *
+ *	@param[in]	arg	An argument.
+ *
+ *	@returns	The result of the fiber.
+ */
+typedef gallus_result_t (*gallus_fiber_proc_t)(void *arg);
+
+
+#define GALLUS_FIBER_DEFAULT_STACK_SIZE	(256 * 1024)
+
+
+
+
+
+/**
+ * Create a fiber scheduler.
+ *
+ *	@param[out]	sptr	A pointer to a scheduler.
+ *	@param[in]	name	A name of the scheduler.
+ *	@param[in]	n_carriers	A # of the carrier threads.
+ *	@param[in]	stack_size	A stack size of the fibers (0: \b
+ *				GALLUS_FIBER_DEFAULT_STACK_SIZE.)
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *	@retval GALLUS_RESULT_POSIX_API_ERROR	Failed, posix API error.
+ *
+ * @details The fibers are run M:N on the carrier threads, which are
+ * started by this function. Every stack has a guard page below it
+ * and the stacks of the exited fibers are kept for the next ones.
+ */
+gallus_result_t
+gallus_fiber_sched_create(gallus_fiber_sched_t *sptr, const char *name,
+                          size_t n_carriers, size_t stack_size);
+
+
+/**
+ * Shutdown a fiber scheduler.
+ *
+ *	@param[in]	sptr	A pointer to a scheduler.
+ *	@param[in]	nsec	A time to wait for the fibers to exit.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_TIMEDOUT		Failed, some fibers are
+ *						still alive.
+ *	@retval GALLUS_RESULT_INVALID_STATE	Failed, called from a fiber
+ *						of the scheduler.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details No more fiber can be spawned after the call. The carrier
+ * threads are stopped once all the fibers exit.
+ */
+gallus_result_t
+gallus_fiber_sched_shutdown(gallus_fiber_sched_t *sptr, gallus_chrono_t nsec);
+
+
+/**
+ * Destroy a fiber scheduler.
+ *
+ *	@param[in]	sptr	A pointer to a scheduler.
+ *
+ * @details It waits for the fibers to exit if it's not shutdown yet.
+ */
+void
+gallus_fiber_sched_destroy(gallus_fiber_sched_t *sptr);
+
+
+/**
+ * Spawn a fiber.
+ *
+ *	@param[in]	sptr	A pointer to a scheduler.
+ *	@param[in]	proc	A main function.
+ *	@param[in]	arg	An argument for the \b proc.
+ *	@param[out]	fptr	A pointer to a future completed with the
+ *				result of the \b proc (\b NULL allowed.)
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_NOT_OPERATIONAL	Failed, the scheduler is
+ *						shutdown.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ */
+gallus_result_t
+gallus_fiber_spawn(gallus_fiber_sched_t *sptr, gallus_fiber_proc_t proc,
+                   void *arg, gallus_future_t *fptr);
+
+
+/**
+ * Get the calling fiber.
+ *
+ *	@returns	The calling fiber, or \b NULL if it's not called
+ *			from a fiber.
+ */
+gallus_fiber_t
+gallus_fiber_self(void);
+
+
+/**
+ * Yield the carrier thread to the other runnable fibers.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *
+ * @details It's \b sched_yield() if it's not called from a fiber.
+ */
+gallus_result_t
+gallus_fiber_yield(void);
+
+
+/**
+ * Sleep the calling fiber.
+ *
+ *	@param[in]	nsec	A time to sleep.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details It sleeps the calling thread if it's not called from a
+ * fiber.
+ */
+gallus_result_t
+gallus_fiber_sleep(gallus_chrono_t nsec);
+
+
+/**
+ * Wait for a file descriptor to be ready.
+ *
+ *	@param[in]	fd	A file descriptor.
+ *	@param[in]	events	The \b poll() events to wait for.
+ *	@param[in]	nsec	A time to wait (<0: forever.)
+ *
+ *	@retval >0				Succeeded, the \b poll()
+ *						revents.
+ *	@retval GALLUS_RESULT_TIMEDOUT		Failed, timed out.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *	@retval GALLUS_RESULT_POSIX_API_ERROR	Failed, posix API error.
+ *
+ * @details Only the calling fiber is parked, the carrier thread runs
+ * the other fibers meanwhile. It's a plain \b poll() if it's not
+ * called from a fiber.
+ */
+gallus_result_t
+gallus_fiber_wait_fd(int fd, short events, gallus_chrono_t nsec);
+
+
+
+
+
+__END_DECLS
@@ -0,0 +1,57 @@
+#pragma once
+
+
+
+
+
+/*
+ * Fibers parked on a gallus_cond_t. The records live on the stacks
+ * of the parked fibers and are only touched under m_lck.
+ */
+typedef struct gallus_fiber_waiter_record {
+  struct gallus_fiber_waiter_record *m_next;
+  struct gallus_fiber_waiter_record *m_prev;
+  gallus_fiber_t m_fiber;
+  uint64_t m_ticket;
+  bool m_is_linked;
+} gallus_fiber_waiter_record;
+
+
+typedef struct gallus_fiber_waitq_record {
+  gallus_spinlock_t m_lck;
+  gallus_fiber_waiter_record *m_head;
+  gallus_fiber_waiter_record *m_tail;
+} gallus_fiber_waitq_record;
+typedef gallus_fiber_waitq_record *gallus_fiber_waitq_t;
+
+
+
+
+
+gallus_result_t
+gallus_fiber_waitq_initialize(gallus_fiber_waitq_t q);
+
+
+void
+gallus_fiber_waitq_finalize(gallus_fiber_waitq_t q);
+
+
+/*
+ * Park the calling fiber on the q, releasing the mtxptr meanwhile.
+ */
+gallus_result_t
+gallus_fiber_waitq_wait(gallus_fiber_waitq_t q, gallus_mutex_t *mtxptr,
+                        gallus_chrono_t nsec);
+
+
+void
+gallus_fiber_waitq_notify(gallus_fiber_waitq_t q, bool for_all);
+
+
+#ifndef NDEBUG
+/*
+ * The number of the pthread backed locks the calling thread holds,
+ * which a fiber must not carry across a park. Kept by lock.c.
+ */
+extern __thread size_t gallus_fiber_n_bound_locks;
+#endif /* ! NDEBUG */
@@ -0,0 +1,313 @@
+#pragma once
+
+
+
+
+
+/**
+ *	@file	gallus_future.h
+ */
+
+
+
+
+
+__BEGIN_DECLS
+
+
+
+
+
+typedef struct gallus_future_record *gallus_future_t;
+typedef struct gallus_task_graph_record *gallus_task_graph_t;
+
+
+/**
+ * The signature of continuation functions.
+ *
+ *	@param[in]	inputs	The futures the continuation depends on.
+ *	@param[in]	n_inputs	A # of the \b inputs.
+ *	@param[in]	arg	An argument.
+ *	@param[out]	valptr	A pointer to a value to set to the
+ *				resulting future (initialized by NULL.)
+ *
+ *	@returns	The result of the resulting future.
+ */
+typedef gallus_result_t (*gallus_future_proc_t)(gallus_future_t *inputs,
+                                                size_t n_inputs,
+                                                void *arg,
+                                                void **valptr);
+
+
+
+
+
+/**
+ * Create a future completed by \b gallus_future_complete().
+ *
+ *	@param[out]	fptr	A pointer to a future.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ */
+gallus_result_t
+gallus_future_create(gallus_future_t *fptr);
+
+
+/**
+ * Complete a future.
+ *
+ *	@param[in]	fptr	A pointer to a future.
+ *	@param[in]	result	A result.
+ *	@param[in]	val	A value (not owned by the future.)
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_ALREADY_HALTED	Failed, already completed.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details The continuations ready by this completion are scheduled
+ * (or run, if they have no thread pool) before this function returns.
+ */
+gallus_result_t
+gallus_future_complete(gallus_future_t *fptr, gallus_result_t result,
+                       void *val);
+
+
+/**
+ * Wait for a future to be completed.
+ *
+ *	@param[in]	fptr	A pointer to a future.
+ *	@param[in]	to	A timeout (in nsec, < 0: forever.)
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_TIMEDOUT		Failed, timedout.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ */
+gallus_result_t
+gallus_future_wait(gallus_future_t *fptr, gallus_chrono_t to);
+
+
+/**
+ * Returns true if a future is completed.
+ *
+ *	@param[in]	fptr	A pointer to a future.
+ */
+bool
+gallus_future_is_done(gallus_future_t *fptr);
+
+
+/**
+ * Get the result of a completed future.
+ *
+ *	@param[in]	fptr	A pointer to a future.
+ *
+ *	@returns	The result given at the completion.
+ *	@retval GALLUS_RESULT_NOT_STARTED	Failed, not yet completed.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ */
+gallus_result_t
+gallus_future_get_result(gallus_future_t *fptr);
+
+
+/**
+ * Get the value of a completed future.
+ *
+ *	@param[in]	fptr	A pointer to a future.
+ *	@param[out]	valptr	A pointer to a value.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NOT_STARTED	Failed, not yet completed.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ */
+gallus_result_t
+gallus_future_get_value(gallus_future_t *fptr, void **valptr);
+
+
+/**
+ * Create a future completed by a function run after a future.
+ *
+ *	@param[in]	fptr	A pointer to a future.
+ *	@param[in]	pptr	A pointer to an executor mode thread pool
+ *				to run the \b proc on (NULL: run it on
+ *				the thread completing the \b fptr.)
+ *	@param[in]	proc	A continuation.
+ *	@param[in]	arg	An argument for the \b proc.
+ *	@param[out]	outptr	A pointer to the resulting future.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details The \b proc is called whatever the result of the \b fptr
+ * is. If the \b proc can't be submitted to the \b pptr the resulting
+ * future is completed with the submission error.
+ */
+gallus_result_t
+gallus_future_then(gallus_future_t *fptr, gallus_thread_pool_t *pptr,
+                   gallus_future_proc_t proc, void *arg,
+                   gallus_future_t *outptr);
+
+
+/**
+ * Create a future completed when all the futures are completed.
+ *
+ *	@param[in]	fs	An array of futures.
+ *	@param[in]	n	A # of the \b fs.
+ *	@param[out]	outptr	A pointer to the resulting future.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details The result of the resulting future is the first (in the
+ * array order) failure (< 0) of the \b fs, or \b GALLUS_RESULT_OK.
+ */
+gallus_result_t
+gallus_future_when_all(gallus_future_t *fs, size_t n, gallus_future_t *outptr);
+
+
+/**
+ * Create a future completed when any of the futures is completed.
+ *
+ *	@param[in]	fs	An array of futures.
+ *	@param[in]	n	A # of the \b fs.
+ *	@param[out]	outptr	A pointer to the resulting future.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details The result of the resulting future is the index of the
+ * first completed one in the \b fs.
+ */
+gallus_result_t
+gallus_future_when_any(gallus_future_t *fs, size_t n, gallus_future_t *outptr);
+
+
+/**
+ * Get another reference to a future.
+ *
+ *	@param[in]	fptr	A pointer to a future.
+ *	@param[out]	outptr	A pointer to the new reference.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details Each reference is released by \b gallus_future_destroy().
+ */
+gallus_result_t
+gallus_future_share(gallus_future_t *fptr, gallus_future_t *outptr);
+
+
+/**
+ * Release a future.
+ *
+ *	@param[in]	fptr	A pointer to a future.
+ *
+ * @details Pending continuations keep their own references, so a
+ * future can be released before it is completed.
+ */
+void
+gallus_future_destroy(gallus_future_t *fptr);
+
+
+
+
+
+/**
+ * Create a task graph.
+ *
+ *	@param[out]	gptr	A pointer to a task graph.
+ *	@param[in]	pptr	A pointer to an executor mode thread pool
+ *				to run the nodes on.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ */
+gallus_result_t
+gallus_task_graph_create(gallus_task_graph_t *gptr,
+                         gallus_thread_pool_t *pptr);
+
+
+/**
+ * Add a node to a task graph.
+ *
+ *	@param[in]	gptr	A pointer to a task graph.
+ *	@param[in]	proc	A function to run. The futures of the
+ *				dependencies are passed as its inputs.
+ *	@param[in]	arg	An argument for the \b proc.
+ *	@param[in]	deps	An array of node ids this node depends on.
+ *	@param[in]	n_deps	A # of the \b deps.
+ *	@param[out]	idptr	A pointer to the node id (NULL allowed.)
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_NOT_FOUND		Failed, a dependency is
+ *						not added yet.
+ *	@retval GALLUS_RESULT_INVALID_STATE	Failed, already run.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details Only already added nodes can be depended on, so a graph
+ * can't have a cycle.
+ */
+gallus_result_t
+gallus_task_graph_add(gallus_task_graph_t *gptr,
+                      gallus_future_proc_t proc, void *arg,
+                      const size_t *deps, size_t n_deps,
+                      size_t *idptr);
+
+
+/**
+ * Run a task graph and wait for it.
+ *
+ *	@param[in]	gptr	A pointer to a task graph.
+ *	@param[in]	to	A timeout (in nsec, < 0: forever.)
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_TIMEDOUT		Failed, timedout.
+ *	@retval GALLUS_RESULT_INVALID_STATE	Failed, already run.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *	@retval <0				Failed, the first failure of
+ *						the nodes in the id order.
+ *
+ * @details A node is submitted as soon as all its dependencies are
+ * completed. A node is not run if any of its dependencies failed,
+ * and is completed with that failure instead.
+ */
+gallus_result_t
+gallus_task_graph_run(gallus_task_graph_t *gptr, gallus_chrono_t to);
+
+
+/**
+ * Get the future of a task graph node.
+ *
+ *	@param[in]	gptr	A pointer to a task graph.
+ *	@param[in]	id	A node id.
+ *	@param[out]	fptr	A pointer to the future, owned by the graph.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NOT_FOUND		Failed, no such node.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ */
+gallus_result_t
+gallus_task_graph_get_future(gallus_task_graph_t *gptr, size_t id,
+                             gallus_future_t *fptr);
+
+
+/**
+ * Destroy a task graph.
+ *
+ *	@param[in]	gptr	A pointer to a task graph.
+ *
+ * @details If the graph is run, wait for all the nodes first.
+ */
+void
+gallus_task_graph_destroy(gallus_task_graph_t *gptr);
+
+
+
+
+
+__END_DECLS
@@ -51,6 +51,18 @@ typedef enum {
    ((int)(s) <= (int)SHUTDOWN_GRACEFULLY)) ? true : false
 
 
+/**
+ * @details The signature of the global state subscription procs.
+ *
+ *	@param[in]	s	The global state reached.
+ *	@param[in]	l	The shutdown grace level.
+ *	@param[in]	arg	An argument given at the subscription.
+ */
+typedef void (*global_state_notify_proc_t)(global_state_t s,
+                                           shutdown_grace_level_t l,
+                                           void *arg);
+
+
 
 
 
@@ -107,6 +119,10 @@ gallus_result_t	global_state_get(global_state_t *sptr);
  *	the \b GALLUS_RESULT_NOT_OPERATIONAL and the caller must
  *	check the \b cur_gptr to prepare/invoke for appropriate
  *	shutdown sequence.
+ *	@details The waiter sleeps on its own futex and is woken up
+ *	only by the transition that reaches the \b s_wait_for (or a
+ *	shutdown state), so a large \b nsec costs nothing while
+ *	waiting. If the state is already there no lock is taken.
  */
 gallus_result_t
 global_state_wait_for(global_state_t s_wait_for,
@@ -163,9 +179,55 @@ gallus_result_t
 global_state_request_shutdown(shutdown_grace_level_t l);
 
 
+/**
+ * Subscribe a change of the global state.
+ *
+ *	@param[in]	s_wait_for	A desired global state.
+ *	@param[in]	proc	A proc called when the global state
+ *	reaches the \b s_wait_for or a shutdown state.
+ *	@param[in]	arg	An argument passed to the \b proc.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *
+ *	@details The subscription is one shot. The \b proc is called
+ *	once, by the thread changing the state, or right here if the
+ *	state is already there.
+ *	@details The \b proc is called with the lock of the global
+ *	state tracker held so it must be short and must not call
+ *	global_state_set(), global_state_request_shutdown() nor
+ *	global_state_[un]subscribe(). Wake someone up in it.
+ */
+gallus_result_t
+global_state_subscribe(global_state_t s_wait_for,
+                       global_state_notify_proc_t proc,
+                       void *arg);
+
+
+/**
+ * Cancel a subscription not fired yet.
+ *
+ *	@param[in]	proc	A proc given to the global_state_subscribe().
+ *	@param[in]	arg	An argument given to the
+ *	global_state_subscribe().
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *	@retval GALLUS_RESULT_NOT_FOUND		Failed, not subscribed or
+ *	already fired.
+ */
+gallus_result_t
+global_state_unsubscribe(global_state_notify_proc_t proc, void *arg);
+
+
 /**
  * Clean an internal state the global state tracker up after the
  * cancellation of the caller threads.
+ *
+ *	@details Kept for the compatibility. The waiters no longer
+ *	sleep holding the lock and clean themselves up when canceled,
+ *	so this does nothing.
  */
 void	global_state_cancel_janitor(void);
 
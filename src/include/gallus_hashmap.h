@@ -101,6 +101,33 @@ gallus_hashmap_create(gallus_hashmap_t *retptr,
                        gallus_hashmap_value_freeup_proc_t proc);
 
 
+/**
+ * Create a hash map with a specified type of the lock.
+ *
+ *	@param[out]	retptr	A pointer to a hash map to be created.
+ *	@param[in]	t	The type of key.
+ *	@param[in]	proc	A value free up function (\b NULL allowed).
+ *	@param[in]	lock_type	The type of the rwlock guarding the
+ *	hash map.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid argument(s).
+ *	@retval GALLUS_RESULT_NO_MEMORY	Failed, no memory.
+ *	@retval GALLUS_RESULT_ANY_FAILURES	Failed.
+ *
+ *	@details Same as the gallus_hashmap_create() but the lock.
+ *	\b GALLUS_RWLOCK_TYPE_DISTRIBUTED suits the read-mostly hash
+ *	maps looked up from many threads. With the lightweight types
+ *	the hash map operations don't toggle the thread cancel state,
+ *	so don't cancel the threads using the hash map.
+ */
+gallus_result_t
+gallus_hashmap_create_with_lock_type(gallus_hashmap_t *retptr,
+                                      gallus_hashmap_type_t t,
+                                      gallus_hashmap_value_freeup_proc_t proc,
+                                      gallus_rwlock_type_t lock_type);
+
+
 /**
  * Shutdown a hash map.
  *
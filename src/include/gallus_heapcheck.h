@@ -8,6 +8,64 @@
 __BEGIN_DECLS
 
 
+
+
+
+/**
+ * The subsystems the allocations are accounted to.
+ */
+typedef enum {
+  GALLUS_HEAPCHECK_TAG_OTHER = 0,
+  GALLUS_HEAPCHECK_TAG_CBUFFER,
+  GALLUS_HEAPCHECK_TAG_HASHMAP,
+  GALLUS_HEAPCHECK_TAG_POOL,
+  GALLUS_HEAPCHECK_TAG_SESSION,
+  GALLUS_HEAPCHECK_TAG_DSTRING,
+  GALLUS_HEAPCHECK_TAG_LOGGER,
+  GALLUS_HEAPCHECK_TAG_MAX
+} gallus_heapcheck_tag_t;
+
+
+/**
+ * Allocation counters. The bytes are the usable sizes of the chunks,
+ * so the malloc(3) rounding is in. The live bytes are \b
+ * m_allocd_bytes - \b m_freed_bytes.
+ */
+typedef struct {
+  uint64_t m_n_allocs;
+  uint64_t m_n_frees;
+  uint64_t m_allocd_bytes;
+  uint64_t m_freed_bytes;
+} gallus_heapcheck_stat_t;
+
+
+/**
+ * The counters of all the threads, the exited ones included.
+ */
+typedef struct {
+  gallus_heapcheck_stat_t m_total;
+  gallus_heapcheck_stat_t m_tags[GALLUS_HEAPCHECK_TAG_MAX];
+  size_t m_n_threads;		/**< # of the live threads counted. */
+} gallus_heapcheck_snapshot_t;
+
+
+#define GALLUS_HEAPCHECK_MAX_FRAMES	16
+
+
+/**
+ * A call site found by the sampling. The \b m_frames[0] is the
+ * return address into the caller of the allocator.
+ */
+typedef struct {
+  gallus_heapcheck_tag_t m_tag;
+  uint64_t m_n_samples;
+  uint64_t m_bytes;		/**< of the sampled allocations. */
+  size_t m_n_frames;
+  void *m_frames[GALLUS_HEAPCHECK_MAX_FRAMES];
+} gallus_heapcheck_site_t;
+
+
+
 
 
 
@@ -23,6 +81,154 @@ gallus_heapcheck_is_mallocd(const void *addr);
 #endif
 
 
+/**
+ * Allocate memory accounted to a subsystem.
+ *
+ *	@param[in]	tag	A subsystem.
+ *	@param[in]	size	A size.
+ *
+ *	@returns	A pointer as malloc(3), or \b NULL.
+ *
+ * @details The counters are per thread and updated with plain stores,
+ * no lock and no atomic read-modify-write, so this costs a malloc(3)
+ * and a few stores. Free the memory by \b gallus_heapcheck_free()
+ * with the same \b tag.
+ */
+void *
+gallus_heapcheck_malloc(gallus_heapcheck_tag_t tag, size_t size);
+
+
+/**
+ * calloc(3) accounted to a subsystem.
+ */
+void *
+gallus_heapcheck_calloc(gallus_heapcheck_tag_t tag, size_t nmemb,
+                        size_t size);
+
+
+/**
+ * realloc(3) accounted to a subsystem.
+ */
+void *
+gallus_heapcheck_realloc(gallus_heapcheck_tag_t tag, void *ptr, size_t size);
+
+
+/**
+ * strdup(3) accounted to a subsystem.
+ */
+char *
+gallus_heapcheck_strdup(gallus_heapcheck_tag_t tag, const char *str);
+
+
+/**
+ * Free memory from the \b gallus_heapcheck_*alloc().
+ *
+ *	@param[in]	tag	The subsystem it was allocated for.
+ *	@param[in]	ptr	A pointer (\b NULL is ignored.)
+ */
+void
+gallus_heapcheck_free(gallus_heapcheck_tag_t tag, void *ptr);
+
+
+/**
+ * Shorthands for the allocators, by the tag without the prefix:
+ *
+ *	p = GALLUS_MALLOC(DSTRING, size);
+ *	GALLUS_FREE(DSTRING, p);
+ */
+#define GALLUS_MALLOC(tag, size)                                        \
+  gallus_heapcheck_malloc(GALLUS_HEAPCHECK_TAG_##tag, (size))
+#define GALLUS_CALLOC(tag, nmemb, size)                                 \
+  gallus_heapcheck_calloc(GALLUS_HEAPCHECK_TAG_##tag, (nmemb), (size))
+#define GALLUS_REALLOC(tag, ptr, size)                                  \
+  gallus_heapcheck_realloc(GALLUS_HEAPCHECK_TAG_##tag, (void *)(ptr), (size))
+#define GALLUS_STRDUP(tag, str)                                         \
+  gallus_heapcheck_strdup(GALLUS_HEAPCHECK_TAG_##tag, (str))
+#define GALLUS_FREE(tag, ptr)                                           \
+  gallus_heapcheck_free(GALLUS_HEAPCHECK_TAG_##tag, (void *)(ptr))
+
+
+/**
+ * Get the name of a subsystem.
+ *
+ *	@param[in]	tag	A subsystem.
+ *
+ *	@returns	The name, "unknown" for an invalid \b tag.
+ */
+const char *
+gallus_heapcheck_tag_name(gallus_heapcheck_tag_t tag);
+
+
+/**
+ * Take a snapshot of the allocation counters.
+ *
+ *	@param[out]	sptr	A pointer to a snapshot.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details The threads keep allocating while the counters are summed,
+ * so it is not of an instant, but every counter is read whole. Diff
+ * two snapshots to see a growth.
+ */
+gallus_result_t
+gallus_heapcheck_snapshot(gallus_heapcheck_snapshot_t *sptr);
+
+
+/**
+ * Set the call site sampling interval.
+ *
+ *	@param[in]	interval	One in \b interval allocations of a
+ *					thread records a backtrace (0: off.)
+ *
+ * @details Off by default, or set by the GALLUS_HEAPCHECK_SAMPLING
+ * environment variable at the start. The sampled bytes times the \b
+ * interval estimate the bytes allocated at a site.
+ */
+void
+gallus_heapcheck_set_sampling(size_t interval);
+
+
+/**
+ * Get the call site sampling interval.
+ */
+size_t
+gallus_heapcheck_get_sampling(void);
+
+
+/**
+ * Get the sampled call sites.
+ *
+ *	@param[out]	sites	An array of sites.
+ *	@param[in]	max	The size of the \b sites.
+ *
+ *	@retval	>=0	# of the sites copied, the most bytes first.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details The frames can be resolved by backtrace_symbols(3).
+ */
+gallus_result_t
+gallus_heapcheck_get_sites(gallus_heapcheck_site_t *sites, size_t max);
+
+
+/**
+ * Forget the sampled call sites.
+ */
+void
+gallus_heapcheck_reset_sites(void);
+
+
+/**
+ * Print a snapshot and the top sampled call sites.
+ *
+ *	@param[in]	fd	A FILE to print to.
+ *	@param[in]	max_sites	# of the sites to print at most.
+ */
+void
+gallus_heapcheck_dump(FILE *fd, size_t max_sites);
+
+
 
 
 
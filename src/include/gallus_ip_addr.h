@@ -33,11 +33,38 @@ typedef struct ip_address gallus_ip_address_t;
  *     @retval	GALLUS_RESULT_ANY_FAILURES	Failed.
  *     @retval	GALLUS_RESULT_INVALID_ARGS	Failed, invalid argument(s).
  *     @retval	GALLUS_RESULT_NO_MEMORY	Failed, no memory.
+ *
+ *     @details Numeric addresses are parsed without the resolver.
+ *     Resolved host names are cached (see
+ *     gallus_ip_address_cache_ttl_set()); a stale one is still
+ *     returned for another TTL while it's re-resolved in the
+ *     background.
  */
 gallus_result_t
 gallus_ip_address_create(const char *name, bool is_ipv4_addr,
                           gallus_ip_address_t **ip);
 
+/**
+ * Set the TTL of the host name resolution cache.
+ *
+ *     @param[in]	ttl	The TTL in nsec (default 30 sec), 0 disables
+ *     the cache.
+ *
+ *     @details The cache is flushed.
+ *
+ *     @retval	GALLUS_RESULT_OK	Succeeded.
+ */
+gallus_result_t
+gallus_ip_address_cache_ttl_set(gallus_chrono_t ttl);
+
+/**
+ * Flush the host name resolution cache.
+ *
+ *     @retval	void
+ */
+void
+gallus_ip_address_cache_flush(void);
+
 /**
  * Destroy a gallus_ip_address_t
  *
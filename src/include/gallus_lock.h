@@ -19,13 +19,34 @@ __BEGIN_DECLS
 
 
 
+/*
+ * The FUTEX and DISTRIBUTED types are lightweight locks for hot
+ * paths of the threads never canceled: their enter/leave_critical()
+ * don't touch the cancel state, the ostate is just passed through.
+ * The FUTEX mutex is not recursive and the FUTEX rwlock prefers the
+ * readers, a steady stream of readers can starve a writer.
+ *
+ * The DISTRIBUTED rwlock is for read-mostly data on many CPUs: the
+ * readers only touch their own per-thread slot (a cache line) and a
+ * writer sweeps all the slots, so the writes are expensive. A read
+ * lock must be released by the thread which has taken it.
+ */
 typedef enum {
   GALLUS_MUTEX_TYPE_UNKNOWN = 0,
   GALLUS_MUTEX_TYPE_DEFAULT,
-  GALLUS_MUTEX_TYPE_RECURSIVE
+  GALLUS_MUTEX_TYPE_RECURSIVE,
+  GALLUS_MUTEX_TYPE_FUTEX
 } gallus_mutex_type_t;
 
 
+typedef enum {
+  GALLUS_RWLOCK_TYPE_UNKNOWN = 0,
+  GALLUS_RWLOCK_TYPE_DEFAULT,
+  GALLUS_RWLOCK_TYPE_FUTEX,
+  GALLUS_RWLOCK_TYPE_DISTRIBUTED
+} gallus_rwlock_type_t;
+
+
 typedef struct gallus_mutex_record 	*gallus_mutex_t;
 typedef struct gallus_rwlock_record 	*gallus_rwlock_t;
 
@@ -43,6 +64,10 @@ gallus_mutex_create(gallus_mutex_t *mtxptr);
 gallus_result_t
 gallus_mutex_create_recursive(gallus_mutex_t *mtxptr);
 
+gallus_result_t
+gallus_mutex_create_with_type(gallus_mutex_t *mtxptr,
+                               gallus_mutex_type_t type);
+
 void
 gallus_mutex_destroy(gallus_mutex_t *mtxptr);
 
@@ -79,12 +104,19 @@ gallus_mutex_leave_critical(gallus_mutex_t *mtxptr, int ostate);
 gallus_result_t
 gallus_rwlock_create(gallus_rwlock_t *rwlptr);
 
+gallus_result_t
+gallus_rwlock_create_with_type(gallus_rwlock_t *rwlptr,
+                                gallus_rwlock_type_t type);
+
 void
 gallus_rwlock_destroy(gallus_rwlock_t *rwlptr);
 
 gallus_result_t
 gallus_rwlock_reinitialize(gallus_rwlock_t *rwlptr);
 
+gallus_result_t
+gallus_rwlock_get_type(gallus_rwlock_t *rwlptr, gallus_rwlock_type_t *tptr);
+
 
 gallus_result_t
 gallus_rwlock_reader_lock(gallus_rwlock_t *rwlptr);
@@ -252,6 +284,266 @@ gallus_spinlock_finalize(gallus_spinlock_t *l) {
 }
 
 
+
+
+
+/*
+ * Spin wait hint. The spinners below yield the CPU every
+ * GALLUS_SPIN_YIELD_LOOPS loops, not to burn the whole time slice
+ * when the holder is preempted on an oversubscribed CPU.
+ */
+#define GALLUS_SPIN_YIELD_LOOPS	128
+
+
+static inline void
+gallus_spin_pause(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield" ::: "memory");
+#else
+  __asm__ __volatile__("" ::: "memory");
+#endif /* __x86_64__ || __i386__ ... */
+}
+
+
+static inline void
+gallus_spin_wait(size_t *loopsptr) {
+  if (unlikely(++*loopsptr % GALLUS_SPIN_YIELD_LOOPS == 0)) {
+    (void)sched_yield();
+  } else {
+    gallus_spin_pause();
+  }
+}
+
+
+
+
+
+/*
+ * Ticket spinlock: FIFO, the waiters spin on the owner word.
+ */
+typedef struct {
+  uint32_t m_next;
+  uint32_t m_owner;
+} gallus_ticketlock_t;
+
+
+static inline gallus_result_t
+gallus_ticketlock_initialize(gallus_ticketlock_t *l) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(l != NULL)) {
+    l->m_next = 0;
+    l->m_owner = 0;
+    mbar();
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+gallus_ticketlock_lock(gallus_ticketlock_t *l) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(l != NULL)) {
+    uint32_t t = __atomic_fetch_add(&(l->m_next), 1, __ATOMIC_RELAXED);
+    size_t loops = 0;
+
+    while (__atomic_load_n(&(l->m_owner), __ATOMIC_ACQUIRE) != t) {
+      gallus_spin_wait(&loops);
+    }
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+gallus_ticketlock_trylock(gallus_ticketlock_t *l) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(l != NULL)) {
+    uint32_t t = __atomic_load_n(&(l->m_owner), __ATOMIC_RELAXED);
+
+    /*
+     * Free iff nobody has taken a ticket past the owner.
+     */
+    if (__atomic_compare_exchange_n(&(l->m_next), &t, t + 1, false,
+                                    __ATOMIC_ACQUIRE,
+                                    __ATOMIC_RELAXED) == true) {
+      ret = GALLUS_RESULT_OK;
+    } else {
+      ret = GALLUS_RESULT_BUSY;
+    }
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+gallus_ticketlock_unlock(gallus_ticketlock_t *l) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(l != NULL)) {
+    /*
+     * Only the holder writes the owner.
+     */
+    __atomic_store_n(&(l->m_owner), l->m_owner + 1, __ATOMIC_RELEASE);
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+static inline void
+gallus_ticketlock_finalize(gallus_ticketlock_t *l) {
+  (void)l;
+}
+
+
+
+
+
+/*
+ * MCS queue spinlock: FIFO, each waiter spins on its own node so a
+ * hand over touches only the two cache lines involved. The node
+ * (usually on the stack) must stay alive from the lock to the
+ * unlock.
+ */
+typedef struct gallus_mcslock_node_record {
+  struct gallus_mcslock_node_record *m_next;
+  bool m_is_waiting;
+} gallus_mcslock_node_t;
+
+
+typedef struct {
+  gallus_mcslock_node_t *m_tail;
+} gallus_mcslock_t;
+
+
+static inline gallus_result_t
+gallus_mcslock_initialize(gallus_mcslock_t *l) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(l != NULL)) {
+    l->m_tail = NULL;
+    mbar();
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+gallus_mcslock_lock(gallus_mcslock_t *l, gallus_mcslock_node_t *n) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(l != NULL && n != NULL)) {
+    gallus_mcslock_node_t *prev;
+    size_t loops = 0;
+
+    n->m_next = NULL;
+    n->m_is_waiting = true;
+    prev = __atomic_exchange_n(&(l->m_tail), n, __ATOMIC_ACQ_REL);
+    if (prev != NULL) {
+      __atomic_store_n(&(prev->m_next), n, __ATOMIC_RELEASE);
+      while (__atomic_load_n(&(n->m_is_waiting), __ATOMIC_ACQUIRE) ==
+             true) {
+        gallus_spin_wait(&loops);
+      }
+    }
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+gallus_mcslock_trylock(gallus_mcslock_t *l, gallus_mcslock_node_t *n) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(l != NULL && n != NULL)) {
+    gallus_mcslock_node_t *free_tail = NULL;
+
+    n->m_next = NULL;
+    n->m_is_waiting = false;
+    if (__atomic_compare_exchange_n(&(l->m_tail), &free_tail, n, false,
+                                    __ATOMIC_ACQ_REL,
+                                    __ATOMIC_RELAXED) == true) {
+      ret = GALLUS_RESULT_OK;
+    } else {
+      ret = GALLUS_RESULT_BUSY;
+    }
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+gallus_mcslock_unlock(gallus_mcslock_t *l, gallus_mcslock_node_t *n) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(l != NULL && n != NULL)) {
+    gallus_mcslock_node_t *next =
+        __atomic_load_n(&(n->m_next), __ATOMIC_ACQUIRE);
+
+    if (next == NULL) {
+      gallus_mcslock_node_t *self = n;
+      size_t loops = 0;
+
+      if (__atomic_compare_exchange_n(&(l->m_tail), &self, NULL, false,
+                                      __ATOMIC_RELEASE,
+                                      __ATOMIC_RELAXED) == false) {
+        /*
+         * A successor has swapped the tail but not linked itself yet.
+         */
+        while ((next = __atomic_load_n(&(n->m_next), __ATOMIC_ACQUIRE)) ==
+               NULL) {
+          gallus_spin_wait(&loops);
+        }
+      }
+    }
+    if (next != NULL) {
+      __atomic_store_n(&(next->m_is_waiting), false, __ATOMIC_RELEASE);
+    }
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+static inline void
+gallus_mcslock_finalize(gallus_mcslock_t *l) {
+  (void)l;
+}
+
+
 
 
 
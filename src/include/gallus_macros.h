@@ -6,12 +6,14 @@
 
 
 #include "gallus_config.h"
+#include "gallus_atomic.h"
 
 /*
- * Architecture independent memory barrier
+ * Architecture independent memory barrier, a full one. Prefer the
+ * orderings in gallus_atomic.h.
  */
 #ifdef __GNUC__
-#define mbar(...)	__sync_synchronize()
+#define mbar(...)	gallus_atomic_fence(SEQ_CST)
 #else
 #define mbar(...)	/**/
 #endif /* __GNUC__ */
@@ -168,13 +170,31 @@
   (((gallus_chrono_t)((tv).tv_sec) * 1000LL * 1000LL + \
     (gallus_chrono_t)(tv).tv_usec) * 1000LL)
 
+/*
+ * The monotonic clock, for the timeouts and the scheduling.
+ */
 #define WHAT_TIME_IS_IT_NOW_IN_NSEC(ns)                    \
+  do {                                                     \
+    (ns) = gallus_chrono_now();                            \
+  } while (0)
+
+/*
+ * The clocks the pthread APIs take the absolute deadlines in.
+ */
+#define WHAT_TIME_IS_IT_NOW_REALTIME_IN_NSEC(ns)           \
   do {                                                     \
     struct timespec __t_s__;                               \
     (void)clock_gettime(CLOCK_REALTIME, &__t_s__);         \
     (ns) = TS_TO_NSEC(__t_s__);                            \
   } while (0)
 
+#define WHAT_TIME_IS_IT_NOW_MONOTONIC_IN_NSEC(ns)          \
+  do {                                                     \
+    struct timespec __t_s__;                               \
+    (void)clock_gettime(CLOCK_MONOTONIC, &__t_s__);        \
+    (ns) = TS_TO_NSEC(__t_s__);                            \
+  } while (0)
+
 #ifdef GALLUS_BIG_ENDIAN
 #ifndef htonll
 #define htonll(_x64) (_x64)
@@ -200,32 +220,6 @@
 #define __UNUSED __attribute__((unused))
 #endif /* __GNUC__ */
 
-#ifdef __GNUC__
-#define gallus_atomic_update_cmp(type, addr, init, val, cmp)           \
-{                                                                       \
-  type __tmp__ =  __sync_fetch_and_add((addr), 0);                      \
-  type __tmp2__;                                                        \
-  do {                                                                  \
-    if (__tmp__ == (init) || __tmp__ cmp (val)) {                       \
-      __tmp2__ = __sync_val_compare_and_swap((addr), __tmp__, (val));   \
-      if (likely(__tmp__ == __tmp2__)) {                                \
-        break;                                                          \
-      } else {                                                          \
-        __tmp__ = __tmp2__;                                             \
-        continue;                                                       \
-      }                                                                 \
-    } else {                                                            \
-      break;                                                            \
-    }                                                                   \
-  } while (true);                                                       \
-}
-
-#define gallus_atomic_update_min(type, addr, init, val)  \
-    gallus_atomic_update_cmp(type, addr, init, val, >)
-#define gallus_atomic_update_max(type, addr, init, val)  \
-    gallus_atomic_update_cmp(type, addr, init, val, <)
-#endif /* __GNUC__ */
-
 
 
 
@@ -171,6 +171,10 @@ typedef void
  *	@retval GALLUS_RESULT_ALREADY_EXISTS	Failed, already exists.
  *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
  *	@retval GALLUS_RESULT_ANY_FAILURES	Failed.
+ *
+ *	@details The module depends on all the modules registered
+ *	before it, so it's initialized and started after them and
+ *	shutdown before them.
  */
 gallus_result_t
 gallus_module_register(const char *name,
@@ -183,6 +187,57 @@ gallus_module_register(const char *name,
                         gallus_module_usage_proc_t usage_proc);
 
 
+/**
+ * Register a module with its dependencies.
+ *
+ *	@param[in]	name	A name of the module.
+ *	@param[in]	init_proc	An initialize function.
+ *	@param[in]	extarg		An extra argument for the initialize function (\b NULL allowed).
+ *	@param[in]	start_proc	A start function.
+ *	@param[in]	shutdown_proc	A shutdown function.
+ *	@param[in]	stop_proc	A stop function (\b NULL allowed.)
+ *	@param[in]	finalize_proc	A finalize function.
+ *	@param[in]	usage_proc	A usage function (\b NULL allowed.)
+ *	@param[in]	deps	A \b NULL terminated array of the names
+ *				of the modules this module depends on
+ *				(\b NULL allowed, no dependencies.)
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY	Failed, no memory.
+ *	@retval GALLUS_RESULT_ALREADY_EXISTS	Failed, already exists.
+ *	@retval GALLUS_RESULT_NOT_FOUND	Failed, a dependency is not
+ *					registered yet.
+ *	@retval GALLUS_RESULT_TOO_MANY_OBJECTS	Failed, too many
+ *						dependencies.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *	@retval GALLUS_RESULT_ANY_FAILURES	Failed.
+ *
+ *	@details The dependencies must be registered before, so that
+ *	they never make a cycle. The modules are leveled by the
+ *	longest dependency chain, and the ones in a level are
+ *	initialized and started concurrently on the worker threads
+ *	after all the lower levels are done. The shutdown, the stop,
+ *	the wait and the finalization go from the highest level down
+ *	in the same manner.
+ *
+ *	@details Hence any of the procs but the usage may be called on
+ *	a thread other than the one calling the gallus_module_*_all(),
+ *	and the procs of a level may run at the same time. If a proc
+ *	calls exit(3) on such a thread in the initialization or the
+ *	start, the modules not started yet are finalized.
+ */
+gallus_result_t
+gallus_module_register_with_deps(const char *name,
+                                  gallus_module_initialize_proc_t init_proc,
+                                  void *extarg,
+                                  gallus_module_start_proc_t start_proc,
+                                  gallus_module_shutdown_proc_t shutdown_proc,
+                                  gallus_module_stop_proc_t stop_proc,
+                                  gallus_module_finalize_proc_t finalize_proc,
+                                  gallus_module_usage_proc_t usage_proc,
+                                  const char *const deps[]);
+
+
 /**
  * Emit all modules' usage.
  *
@@ -210,6 +265,9 @@ gallus_module_initialize_all(int argc, const char *const argv[]);
  *
  *	@retval GALLUS_RESULT_OK		Succeeded.
  *	@retval <0 Any other faiulre(s).
+ *
+ *	@details On success the startup timeline is emitted as info
+ *	messages, see \b gallus_module_dump_timeline().
  */
 gallus_result_t
 gallus_module_start_all(void);
@@ -240,7 +298,8 @@ gallus_module_stop_all(void);
 /**
  * Wait all the modules.
  *
- *	@param[in]	nsec	Wait timeout (in nano second).
+ *	@param[in]	nsec	Wait timeout for all the modules (in
+ *				nano second).
 
  *	@retval GALLUS_RESULT_OK		Succeeded.
  *	@retval <0 Any other faiulre(s).
@@ -256,6 +315,19 @@ void
 gallus_module_finalize_all(void);
 
 
+/**
+ * Emit the startup timeline.
+ *
+ *	@param[in]	fd	A file descriptor emit to.
+ *
+ *	@details A line per module tells its level, when its
+ *	initialization and start began since the \b
+ *	gallus_module_initialize_all() call and how long they took.
+ */
+void
+gallus_module_dump_timeline(FILE *fd);
+
+
 /**
  * Find a module by name.
  *
@@ -66,6 +66,17 @@ void	gallus_free_on_cpu(void *p);
 bool	gallus_is_numa_enabled(void);
 
 
+/**
+ * Get the NUMA node which the specified CPU belongs.
+ *
+ *	@param[in]	cpu	A cpu/core.
+ *
+ *	@retval	>=0	The NUMA node, 0 if the NUMA is not supported.
+ *	@retval	<0	Failed, invalid cpu.
+ */
+int	gallus_numa_node_of_cpu(int cpu);
+
+
 
 
 
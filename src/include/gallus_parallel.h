@@ -0,0 +1,137 @@
+#pragma once
+
+
+
+
+
+/**
+ *	@file	gallus_parallel.h
+ */
+
+
+
+
+
+__BEGIN_DECLS
+
+
+
+
+
+/**
+ * The signature of parallel for body functions.
+ *
+ *	@param[in]	begin	The first index of a chunk.
+ *	@param[in]	end	The last index of a chunk + 1.
+ *	@param[in]	arg	An argument.
+ *
+ *	@retval	>=0	Succeeded.
+ *	@retval	<0	Failed, no more chunk is started.
+ */
+typedef gallus_result_t (*gallus_parallel_for_proc_t)(size_t begin,
+                                                      size_t end,
+                                                      void *arg);
+
+
+/**
+ * The signature of parallel reduce body functions.
+ *
+ *	@param[in]	begin	The first index of a chunk.
+ *	@param[in]	end	The last index of a chunk + 1.
+ *	@param[in,out]	acc	An accumulator to fold the chunk into.
+ *	@param[in]	arg	An argument.
+ *
+ *	@retval	>=0	Succeeded.
+ *	@retval	<0	Failed, no more chunk is started.
+ */
+typedef gallus_result_t (*gallus_parallel_reduce_proc_t)(size_t begin,
+                                                         size_t end,
+                                                         void *acc,
+                                                         void *arg);
+
+
+/**
+ * The signature of parallel reduce combine functions.
+ *
+ *	@param[in,out]	acc	An accumulator.
+ *	@param[in]	other	An accumulator to fold into the \b acc.
+ *	@param[in]	arg	An argument.
+ */
+typedef void (*gallus_parallel_combine_proc_t)(void *acc, const void *other,
+                                               void *arg);
+
+
+
+
+
+/**
+ * Run a function over a range on a thread pool.
+ *
+ *	@param[in]	pptr	A pointer to an executor mode thread pool
+ *				(NULL: run on the caller only.)
+ *	@param[in]	begin	The first index.
+ *	@param[in]	end	The last index + 1.
+ *	@param[in]	grain	The smallest chunk (0: chosen by the
+ *				range and the pool size.)
+ *	@param[in]	proc	A body function.
+ *	@param[in]	arg	An argument for the \b proc.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *	@retval <0				Failed, the first failure of
+ *						the \b proc.
+ *
+ * @details The range is split evenly between the caller and the pool
+ * workers. Each of them takes shrinking chunks from the head of its
+ * own part and steals the latter half of the others' rest when it
+ * runs out, from the ones on the same NUMA node first. The caller
+ * always takes part in, so calling this from a worker of the same
+ * pool doesn't deadlock.
+ */
+gallus_result_t
+gallus_parallel_for(gallus_thread_pool_t *pptr, size_t begin, size_t end,
+                    size_t grain,
+                    gallus_parallel_for_proc_t proc, void *arg);
+
+
+/**
+ * Reduce a range on a thread pool.
+ *
+ *	@param[in]	pptr	A pointer to an executor mode thread pool
+ *				(NULL: run on the caller only.)
+ *	@param[in]	begin	The first index.
+ *	@param[in]	end	The last index + 1.
+ *	@param[in]	grain	The smallest chunk (0: chosen by the
+ *				range and the pool size.)
+ *	@param[in,out]	result	An accumulator, holding the identity
+ *				value at the call and the result at
+ *				the return.
+ *	@param[in]	acc_size	The size of the \b result.
+ *	@param[in]	proc	A body function.
+ *	@param[in]	combine	A combine function, must be associative
+ *				and commutative.
+ *	@param[in]	arg	An argument for the \b proc and the \b
+ *				combine.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *	@retval <0				Failed, the first failure of
+ *						the \b proc.
+ *
+ * @details Every participant folds its chunks into a private copy of
+ * the identity, and the copies are combined into the \b result once
+ * at the end. The split is the same as \b gallus_parallel_for().
+ */
+gallus_result_t
+gallus_parallel_reduce(gallus_thread_pool_t *pptr, size_t begin, size_t end,
+                       size_t grain, void *result, size_t acc_size,
+                       gallus_parallel_reduce_proc_t proc,
+                       gallus_parallel_combine_proc_t combine, void *arg);
+
+
+
+
+
+__END_DECLS
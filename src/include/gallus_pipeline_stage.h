@@ -253,6 +253,79 @@ gallus_pipeline_stage_set_worker_cpu_affinity(
 #endif /* GALLUS_OS_LINUX */
 
 
+/**
+ * Place the workers of pipeline stages on the CPUs by the topology.
+ *
+ *	@param[in]  stages	An array of stages, in the pipeline order.
+ *	@param[in]  is_hot	An array of flags if the stages are hot
+ *	(\b NULL allowed.)
+ *	@param[in]  n_stages	A # of the stages.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_INVALID_OBJECT	Failed, invalid stage.
+ *	@retval GALLUS_RESULT_INVALID_STATE_TRANSITION	Failed, a stage is
+ *	already started.
+ *	@retval GALLUS_RESULT_NOT_FOUND		Failed, no usable CPU.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *	@retval GALLUS_RESULT_ANY_FAILURES	Failed.
+ *
+ *	@details The workers are pinned one by one to the CPUs the
+ *	caller can run on, walking them in the order of the node, the
+ *	package, the L3 and the L2, so the workers of the adjacent
+ *	stages share the caches as much as possible. A worker of a hot
+ *	stage takes a whole core and leaves its SMT siblings idle. The
+ *	CPUs are reused round robin if there are more workers than CPUs.
+ *
+ *	@details The batch buffers of the workers are reallocated on the
+ *	NUMA node of the CPUs, unless they are set by the \b
+ *	gallus_pipeline_stage_set_worker_event_buffer() with an own
+ *	freeup function. Use the \b
+ *	gallus_pipeline_stage_get_worker_cpu() and the \b
+ *	gallus_bbq_create_on_cpu() to allocate the input queues of the
+ *	workers locally as well.
+ *
+ *	@details This API must be called before starting the stages.
+ */
+#ifdef GALLUS_OS_LINUX
+gallus_result_t
+gallus_pipeline_stage_place_workers(const gallus_pipeline_stage_t *stages,
+                                    const bool *is_hot,
+                                    size_t n_stages);
+#endif /* GALLUS_OS_LINUX */
+
+
+/**
+ * Get the CPU a worker of a pipeline stage is placed on.
+ *
+ *	@param[in]  sptr	A pointer to a stage.
+ *	@param[in]  idx		A worker index.
+ *
+ *	@retval >=0				The CPU #.
+ *	@retval GALLUS_RESULT_NOT_FOUND		Failed, not placed on a
+ *	single CPU.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ *	@details The CPU is the last one set by the \b
+ *	gallus_pipeline_stage_set_worker_cpu_affinity() or the \b
+ *	gallus_pipeline_stage_place_workers().
+ */
+gallus_result_t
+gallus_pipeline_stage_get_worker_cpu(const gallus_pipeline_stage_t *sptr,
+                                     size_t idx);
+
+
+/**
+ * Dump the placement of the workers of a pipeline stage.
+ *
+ *	@param[in]  sptr	A pointer to a stage.
+ *	@param[in]  fd		A \b FILE to dump to.
+ */
+void
+gallus_pipeline_stage_dump_placement(const gallus_pipeline_stage_t *sptr,
+                                     FILE *fd);
+
+
 
 
 
@@ -54,8 +54,13 @@ typedef struct gallus_pipeline_stage_record {
   gallus_mutex_t m_lock;
   gallus_cond_t m_cond;
 
-  volatile bool m_do_loop;
-  volatile shutdown_grace_level_t m_sg_lvl;
+  /*
+   * The workers poll the m_do_loop, the m_sg_lvl and the
+   * m_pause_requested without the lock, access them by the
+   * gallus_atomic_*().
+   */
+  bool m_do_loop;
+  shutdown_grace_level_t m_sg_lvl;
 
   volatile gallus_pipeline_stage_state_t m_status;
 
@@ -63,7 +68,7 @@ typedef struct gallus_pipeline_stage_record {
   size_t m_n_canceled_workers;
   size_t m_n_shutdown_workers;
 
-  volatile bool m_pause_requested;
+  bool m_pause_requested;
   gallus_barrier_t m_pause_barrier;
   gallus_mutex_t m_pause_lock;
   gallus_cond_t m_pause_cond;
@@ -28,6 +28,27 @@ typedef enum {
 } gallus_pool_type_t;
 
 
+/*
+ * Sizing and saturation metrics of a pool. The objs are created on
+ * demand up to m_n_max, so m_n_cur is the # of the objs which exist
+ * and m_n_busy is the # of the acquired ones.
+ */
+typedef struct {
+  size_t m_n_min;
+  size_t m_n_max;
+  size_t m_n_cur;
+  size_t m_n_busy;
+  size_t m_n_busy_peak;
+  uint64_t m_n_acquired;
+  uint64_t m_n_waited;		/* acquisitions blocked on a full pool. */
+  uint64_t m_n_timedout;
+  uint64_t m_n_created;
+  uint64_t m_n_retired;
+  gallus_chrono_t m_wait_total;	/* of the blocked acquisitions. */
+  gallus_chrono_t m_wait_max;
+} gallus_pool_stats_t;
+
+
 
 
 
@@ -44,6 +65,30 @@ gallus_pool_create(gallus_pool_t *pptr, size_t sz, const char *name,
 		gallus_poolable_methods_t m);
 
 
+/*
+ * Make a GALLUS_POOL_TYPE_QUEUE pool elastic: n_min objs are created
+ * right now and kept, the surplus ones up to the n_max_objs are
+ * created on demand and retired after being idle for idle_to (<= 0:
+ * never.)
+ */
+gallus_result_t
+gallus_pool_set_elastic(gallus_pool_t *pptr, size_t n_min,
+                        gallus_chrono_t idle_to);
+
+
+/*
+ * Retire the surplus objs which have been idle since the last call,
+ * returns the # of the retired objs. It's called every idle_to by
+ * the pool itself when it's elastic.
+ */
+gallus_result_t
+gallus_pool_trim(gallus_pool_t *pptr);
+
+
+gallus_result_t
+gallus_pool_get_stats(gallus_pool_t *pptr, gallus_pool_stats_t *sptr);
+
+
 gallus_result_t
 gallus_pool_add_poolable_by_index(gallus_pool_t *pptr, uint64_t index, void *args);
 
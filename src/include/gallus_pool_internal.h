@@ -27,7 +27,7 @@ typedef struct gallus_pool_record {
   volatile bool m_is_awakened;
   volatile bool m_is_cancelled;
 	
-  size_t m_n_waiters;
+  size_t m_n_waiters;		/* under the m_lck, relaxed. */
   
   size_t m_obj_idx;
 
@@ -43,4 +43,17 @@ typedef struct gallus_pool_record {
   /* For GALLUS_POOL_TYPE_QUEUE */
   gallus_bbq_t m_free_q;
 
+  /*
+   * Elastic sizing, GALLUS_POOL_TYPE_QUEUE only. m_n_idle_low is the
+   * least # of the idle objs since the last trim; that many objs were
+   * not needed at all during the window.
+   */
+  size_t m_n_min;
+  gallus_chrono_t m_idle_to;
+  size_t m_n_idle_low;
+  size_t m_n_blocked;		/* acquirers blocked on m_free_q. */
+  struct gallus_pool_reaper_record *m_reaper;
+
+  gallus_pool_stats_t m_stats;
+
 } gallus_pool_record;
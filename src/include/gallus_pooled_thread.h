@@ -40,6 +40,29 @@ gallus_result_t
 gallus_thread_pool_create(gallus_thread_pool_t *pptr, const char *name, size_t n);
 
 
+/*
+ * Create a thread pool in the executor mode: the n threads pull tasks
+ * given by gallus_task_submit() from shared run queues instead of
+ * being acquired one by one.
+ */
+gallus_result_t
+gallus_thread_pool_create_executor(gallus_thread_pool_t *pptr,
+                                   const char *name, size_t n);
+
+
+/*
+ * Create an elastic thread pool: n_min threads are started right now,
+ * more are started on demand when an acquisition would block, up to
+ * n_max. The surplus threads are retired after being idle for idle_to
+ * (<= 0: never.)
+ */
+gallus_result_t
+gallus_thread_pool_create_elastic(gallus_thread_pool_t *pptr,
+                                  const char *name,
+                                  size_t n_min, size_t n_max,
+                                  gallus_chrono_t idle_to);
+
+
 gallus_result_t
 gallus_thread_pool_acquire_thread(gallus_thread_pool_t *pptr,
 			       gallus_pooled_thread_t *ptptr,
@@ -54,6 +77,19 @@ gallus_result_t
 gallus_thread_pool_get_outstanding_thread_num(gallus_thread_pool_t *pptr);
 
 
+/*
+ * Retire the surplus threads idle since the last trim right now,
+ * returns the # of the retired threads.
+ */
+gallus_result_t
+gallus_thread_pool_trim(gallus_thread_pool_t *pptr);
+
+
+gallus_result_t
+gallus_thread_pool_get_stats(gallus_thread_pool_t *pptr,
+                             gallus_pool_stats_t *sptr);
+
+
 gallus_result_t
 gallus_thread_pool_wakeup(gallus_thread_pool_t *pptr, gallus_chrono_t to);
 
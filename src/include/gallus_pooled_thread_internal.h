@@ -29,11 +29,51 @@ typedef struct gallus_pooled_thread_record {
 } gallus_pooled_thread_record;
 
 
+/*
+ * Executor mode: tasks are queued on per worker run queues and every
+ * pooled thread runs a worker task pulling them, stealing from the
+ * other queues when its own one is empty.
+ */
+typedef struct gallus_executor_runq_record {
+  gallus_spinlock_t m_lck;
+  gallus_task_t m_head;
+  gallus_task_t m_tail;
+} __attribute__((aligned(64))) gallus_executor_runq_record;
+
+
+typedef struct gallus_executor_worker_record *gallus_executor_worker_t;
+
+
+typedef struct gallus_thread_pool_executor_record {
+  size_t m_n_workers;
+  volatile bool m_is_stopping;
+  volatile bool m_is_stopped;
+  shutdown_grace_level_t m_stop_lvl;
+
+  size_t m_n_queued;		/* atomic */
+  size_t m_n_sleepers;		/* atomic */
+  size_t m_rr;			/* atomic, submission round robin */
+  size_t m_n_enqueuers;		/* atomic, enqueues in flight */
+
+  gallus_mutex_t m_idle_lck;
+  gallus_cond_t m_idle_cnd;
+
+  gallus_executor_runq_record *m_qs;		/* size: m_n_workers */
+  gallus_pooled_thread_t *m_thds;		/* size: m_n_workers */
+  gallus_executor_worker_t *m_workers;		/* size: m_n_workers */
+} gallus_thread_pool_executor_record;
+typedef gallus_thread_pool_executor_record *gallus_thread_pool_executor_t;
+
+
 /*
  * wraping a gallus_pool_record into a gallus_thread_pool_record to get a
  * warning on purpose when implicit type conversion.
  */
 typedef struct gallus_thread_pool_record {
   gallus_pool_record m_pool;
-  void *m_dummy;
+  gallus_thread_pool_executor_t m_exec;	/* NULL unless executor mode. */
 } gallus_thread_pool_record;
+
+
+gallus_result_t
+gallus_thread_pool_enqueue_task(gallus_thread_pool_t *pptr, gallus_task_t t);
@@ -130,8 +130,15 @@ session_close(gallus_session_t s);
  *  @param[in]  s       A session.
  *
  *  @retval GALLUS_RESULT_OK            Succeeded.
+ *  @retval GALLUS_RESULT_EINPROGRESS   The protocol handshake is in
+ *  progress.
  *  @retval GALLUS_RESULT_SOCKET_ERROR  Failed, a session socket is invalid.
+ *  @retval GALLUS_RESULT_TLS_CONN_ERROR Failed, the TLS handshake failed.
  *
+ *  @details Each call advances a TLS handshake by one non-blocking
+ *  step. While GALLUS_RESULT_EINPROGRESS is returned, the read/write
+ *  events of the \b s are set to what the handshake waits for; poll
+ *  the session and call this again.
  */
 gallus_result_t
 session_connect_check(gallus_session_t s);
@@ -145,6 +152,9 @@ session_connect_check(gallus_session_t s);
  *
  *  @retval Size of read data.
  *
+ *  @details On a TLS session -1 with errno EAGAIN means the read is
+ *  blocked on the transport, possibly in a renegotiation; the
+ *  read/write events of the \b s are set to what it waits for.
  */
 ssize_t
 session_read(gallus_session_t s, void *buf, size_t n);
@@ -158,10 +168,41 @@ session_read(gallus_session_t s, void *buf, size_t n);
  *
  *  @retval Size of wrote data.
  *
+ *  @details On a TLS session 0 means the write is blocked; the
+ *  read/write events of the \b s are set to what it waits for.
  */
 ssize_t
 session_write(gallus_session_t s, void *buf, size_t n);
 
+/**
+ * Gather write to a session.
+ *
+ *  @param[in]  s       A session.
+ *  @param[in]  iov     Write data pieces.
+ *  @param[in]  iovcnt  The number of the pieces.
+ *
+ *  @retval Size of wrote data.
+ *
+ *  @details A single writev(2) on the plain sockets (and kTLS); the
+ *  other sessions write the pieces in turn up to a short write.
+ */
+ssize_t
+session_writev(gallus_session_t s, const struct iovec *iov, int iovcnt);
+
+/**
+ * Write a whole dynamic string to a session.
+ *
+ *  @param[in]  s       A session.
+ *  @param[in]  ds      A pointer to a dynamic string.
+ *
+ *  @retval Size of wrote data.
+ *
+ *  @details A rope mode dynamic string is written with writev(2)
+ *  straight from its segments without flattening.
+ */
+ssize_t
+session_write_dstring(gallus_session_t s, gallus_dstring_t *ds);
+
 /**
  * Get socket descriptor in a session.
  *
@@ -241,6 +282,42 @@ session_bind(gallus_session_t s, gallus_ip_address_t *saddr, uint16_t port);
 gallus_result_t
 session_accept(gallus_session_t s1, gallus_session_t *s2);
 
+/**
+ * Accept for a non-blocking passive session.
+ *
+ *  @param[in]   s1     A passive session.
+ *  @param[out]  s2     A accepted session.
+ *
+ *  @retval GALLUS_RESULT_OK              Succeeded.
+ *  @retval GALLUS_RESULT_EINPROGRESS     Succeeded, but the protocol
+ *  handshake is not finished yet.
+ *  @retval GALLUS_RESULT_NO_MORE_ACTION  No pending connection.
+ *  @retval GALLUS_RESULT_POSIX_API_ERROR Failed, in systemcalls.
+ *
+ *  @details The accepted socket is set non-blocking. If
+ *  GALLUS_RESULT_EINPROGRESS is returned, the read/write events of
+ *  the \b s2 are set for the next step and the handshake must be
+ *  driven by session_handshake() when the \b s2 gets ready.
+ */
+gallus_result_t
+session_accept_nonblocking(gallus_session_t s1, gallus_session_t *s2);
+
+/**
+ * Step a protocol handshake of a session.
+ *
+ *  @param[in]   s     A session.
+ *
+ *  @retval GALLUS_RESULT_OK              Succeeded, the handshake is done.
+ *  @retval GALLUS_RESULT_EINPROGRESS     Not finished yet.
+ *  @retval GALLUS_RESULT_TLS_CONN_ERROR  Failed.
+ *
+ *  @details Sessions without a handshake (e.g. TCP) always return
+ *  GALLUS_RESULT_OK. On GALLUS_RESULT_EINPROGRESS the read/write events
+ *  of the \b s tell which direction the handshake is waiting for.
+ */
+gallus_result_t
+session_handshake(gallus_session_t s);
+
 /**
  * Clear a read/write event in a session.
  *
@@ -477,6 +554,266 @@ uint64_t
 session_id_get(gallus_session_t s);
 
 
+typedef struct session_listener_group_record *gallus_session_listener_group_t;
+
+/**
+ * @details The signature of listener group accept callbacks.
+ *
+ * Called on a listener worker thread with a session whose handshake
+ * is finished. The callback takes the ownership of the \b s if it
+ * returns GALLUS_RESULT_OK, otherwise the session is destroyed.
+ */
+typedef gallus_result_t
+(*gallus_session_accept_proc_t)(gallus_session_t s, void *arg);
+
+/**
+ * Create a listener group.
+ *
+ *  @param[in]   session_type  A passive session type.
+ *  @param[in]   addr          A listen address.
+ *  @param[in]   port          A listen port.
+ *  @param[in]   n_workers     A number of listener workers.
+ *  @param[in]   proc          An accept callback.
+ *  @param[in]   arg           An auxiliary argument for the \b proc.
+ *  @param[out]  gptr          A pointer to a created group.
+ *
+ *  @retval GALLUS_RESULT_OK              Succeeded.
+ *  @retval GALLUS_RESULT_INVALID_ARGS    Failed, invalid argument(s).
+ *  @retval GALLUS_RESULT_NO_MEMORY       Failed, no memory.
+ *  @retval GALLUS_RESULT_POSIX_API_ERROR Failed, in systemcalls.
+ *
+ *  @details Each worker owns its own SO_REUSEPORT socket bound to the
+ *  \b addr and the \b port, so the kernel spreads incoming connections
+ *  over the workers. Accepting and the TLS handshakes run non-blocking
+ *  on the workers.
+ */
+gallus_result_t
+session_listener_group_create(session_type_t session_type,
+                              gallus_ip_address_t *addr,
+                              uint16_t port,
+                              size_t n_workers,
+                              gallus_session_accept_proc_t proc,
+                              void *arg,
+                              gallus_session_listener_group_t *gptr);
+
+/**
+ * Set a handshake timeout of a listener group.
+ *
+ *  @param[in]   gptr   A pointer to a group.
+ *  @param[in]   nsec   A timeout (nsec).
+ *
+ *  @retval GALLUS_RESULT_OK              Succeeded.
+ *  @retval GALLUS_RESULT_INVALID_ARGS    Failed, invalid argument(s).
+ *  @retval GALLUS_RESULT_BUSY            Failed, the group is already started.
+ *
+ *  @details Handshakes not finished in the \b nsec are dropped. The
+ *  default is 10 sec.
+ */
+gallus_result_t
+session_listener_group_set_handshake_timeout(
+    gallus_session_listener_group_t *gptr,
+    gallus_chrono_t nsec);
+
+/**
+ * Start a listener group.
+ *
+ *  @param[in]   gptr   A pointer to a group.
+ *
+ *  @retval GALLUS_RESULT_OK              Succeeded.
+ *  @retval GALLUS_RESULT_ALREADY_EXISTS  Failed, already started.
+ *  @retval !=GALLUS_RESULT_OK            Failed.
+ */
+gallus_result_t
+session_listener_group_start(gallus_session_listener_group_t *gptr);
+
+/**
+ * Stop a listener group.
+ *
+ *  @param[in]   gptr   A pointer to a group.
+ *
+ *  @retval GALLUS_RESULT_OK              Succeeded.
+ *  @retval !=GALLUS_RESULT_OK            Failed.
+ *
+ *  @details Pending handshakes are dropped.
+ */
+gallus_result_t
+session_listener_group_stop(gallus_session_listener_group_t *gptr);
+
+/**
+ * Destroy a listener group.
+ *
+ *  @param[in]   gptr   A pointer to a group.
+ *
+ *  @details The group is stopped if it is running.
+ */
+void
+session_listener_group_destroy(gallus_session_listener_group_t *gptr);
+
+
+typedef struct session_pool_record *gallus_session_pool_t;
+
+/**
+ * Create a session pool.
+ *
+ *  @param[in]   n_max_conns  A maximum number of connections per endpoint.
+ *  @param[out]  spptr        A pointer to a created pool.
+ *
+ *  @retval GALLUS_RESULT_OK              Succeeded.
+ *  @retval GALLUS_RESULT_INVALID_ARGS    Failed, invalid argument(s).
+ *  @retval GALLUS_RESULT_NO_MEMORY       Failed, no memory.
+ *
+ *  @details A session pool keeps connected active sessions per
+ *  (session type, address, port) endpoint so that they are reused
+ *  instead of being connected for every request.
+ */
+gallus_result_t
+session_pool_create(size_t n_max_conns, gallus_session_pool_t *spptr);
+
+/**
+ * Acquire a connected session from a session pool.
+ *
+ *  @param[in]   spptr         A pointer to a pool.
+ *  @param[in]   session_type  A session type (SESSION_TCP or
+ *  SESSION_TCP6, optionally with SESSION_TLS).
+ *  @param[in]   addr          A server address.
+ *  @param[in]   port          A server port.
+ *  @param[in]   to            A timeout (nsec), < 0 for no timeout.
+ *  @param[out]  sptr          A pointer to an acquired session.
+ *
+ *  @retval GALLUS_RESULT_OK              Succeeded.
+ *  @retval GALLUS_RESULT_TIMEDOUT        Failed, timed out.
+ *  @retval GALLUS_RESULT_INVALID_ARGS    Failed, invalid argument(s).
+ *  @retval !=GALLUS_RESULT_OK            Failed, can't connect.
+ *
+ *  @details An idle session is health-checked before it is handed
+ *  out; a closed one, or one with unread data, is reconnected. If all
+ *  the \b n_max_conns sessions of the endpoint are in use, this waits
+ *  for one to be released. The \b to covers both the wait and the
+ *  connection setup.
+ */
+gallus_result_t
+session_pool_acquire(gallus_session_pool_t *spptr,
+                     session_type_t session_type,
+                     gallus_ip_address_t *addr, uint16_t port,
+                     gallus_chrono_t to,
+                     gallus_session_t *sptr);
+
+/**
+ * Release a session to a session pool.
+ *
+ *  @param[in]   spptr        A pointer to a pool.
+ *  @param[in]   sptr         A pointer to a session acquired from the \b spptr.
+ *  @param[in]   is_reusable  If false, the session is closed.
+ *
+ *  @retval GALLUS_RESULT_OK              Succeeded.
+ *  @retval GALLUS_RESULT_NOT_OWNER       Failed, the session is not
+ *  acquired from the pool.
+ *  @retval GALLUS_RESULT_INVALID_ARGS    Failed, invalid argument(s).
+ *
+ *  @details Pass false to the \b is_reusable when the session is left
+ *  in the middle of a request/response exchange.
+ */
+gallus_result_t
+session_pool_release(gallus_session_pool_t *spptr,
+                     gallus_session_t *sptr,
+                     bool is_reusable);
+
+/**
+ * Destroy a session pool.
+ *
+ *  @param[in]   spptr   A pointer to a pool.
+ *
+ *  @details All the pooled sessions are closed; release acquired
+ *  sessions before calling this.
+ */
+void
+session_pool_destroy(gallus_session_pool_t *spptr);
+
+
+typedef struct session_channel_record *gallus_session_channel_t;
+
+/**
+ * The size of a channel frame header: a tag and a payload length,
+ * both 32 bit in the network byte order.
+ */
+#define SESSION_CHANNEL_HEADER_SIZE	8
+
+/**
+ * Create a pipelined request channel over a session.
+ *
+ *  @param[in]   s             A connected session.
+ *  @param[in]   max_inflight  A maximum number of in-flight requests
+ *  (up to 65536).
+ *  @param[out]  chptr         A pointer to a created channel.
+ *
+ *  @retval GALLUS_RESULT_OK              Succeeded.
+ *  @retval GALLUS_RESULT_INVALID_ARGS    Failed, invalid argument(s).
+ *  @retval GALLUS_RESULT_NO_MEMORY       Failed, no memory.
+ *  @retval GALLUS_RESULT_POSIX_API_ERROR Failed, the \b s can't be made
+ *  non-blocking.
+ *
+ *  @details Requests from several threads share the \b s; each is
+ *  sent as a frame of a SESSION_CHANNEL_HEADER_SIZE bytes header
+ *  followed by the payload, and the peer must answer with a frame
+ *  carrying the same tag. Responses may come back in any order. The
+ *  channel does not own the \b s, but switches its socket to the
+ *  non-blocking mode, and it stays so after the channel is destroyed.
+ */
+gallus_result_t
+session_channel_create(gallus_session_t s, size_t max_inflight,
+                       gallus_session_channel_t *chptr);
+
+/**
+ * Send a request and wait for its response on a channel.
+ *
+ *  @param[in]   chptr      A pointer to a channel.
+ *  @param[in]   req        A request payload.
+ *  @param[in]   req_len    A length of the \b req.
+ *  @param[out]  resp       A response buffer.
+ *  @param[in]   resp_size  A size of the \b resp.
+ *  @param[out]  resp_len   A length of the response, or NULL.
+ *  @param[in]   to         A timeout (nsec), < 0 for no timeout.
+ *
+ *  @retval GALLUS_RESULT_OK              Succeeded.
+ *  @retval GALLUS_RESULT_TIMEDOUT        Failed, timed out.
+ *  @retval GALLUS_RESULT_TOO_LARGE       Failed, the response is
+ *  truncated to the \b resp_size, \b *resp_len is its real length.
+ *  @retval GALLUS_RESULT_INVALID_ARGS    Failed, invalid argument(s).
+ *  @retval !=GALLUS_RESULT_OK            Failed, the session is broken.
+ *
+ *  @details A response arriving after its request timed out is
+ *  dropped. Once the session breaks every request fails with the
+ *  same error; see session_channel_get_error().
+ */
+gallus_result_t
+session_channel_request(gallus_session_channel_t *chptr,
+                        const void *req, size_t req_len,
+                        void *resp, size_t resp_size,
+                        size_t *resp_len,
+                        gallus_chrono_t to);
+
+/**
+ * Get the error which broke a channel.
+ *
+ *  @param[in]   chptr   A pointer to a channel.
+ *
+ *  @retval GALLUS_RESULT_OK              The channel is operational.
+ *  @retval !=GALLUS_RESULT_OK            The error broke the channel.
+ */
+gallus_result_t
+session_channel_get_error(gallus_session_channel_t *chptr);
+
+/**
+ * Destroy a channel.
+ *
+ *  @param[in]   chptr   A pointer to a channel.
+ *
+ *  @details No request may be in progress. The session is left open.
+ */
+void
+session_channel_destroy(gallus_session_channel_t *chptr);
+
+
 
 
 
@@ -124,6 +124,22 @@ gallus_session_tls_set_server_key(const char *c);
 gallus_result_t
 gallus_session_tls_set_trust_point_conf(const char *c);
 
+/**
+ * Enable/disable kTLS offload for sessions created afterwards.
+ *
+ *  @param[in] ktls    Enable kTLS or not.
+ *
+ *  @retval	GALLUS_RESULT_OK	Succeeded.
+ *
+ *  @details When enabled, TLS 1.2 or later is negotiated and the
+ *  negotiated keys are installed into the kernel (TCP_ULP "tls") after
+ *  the handshake. Then session_write() becomes a plain socket write.
+ *  If the cipher, the OpenSSL or the kernel does not support it, the
+ *  session silently falls back to user space TLS. Disabled by default.
+ */
+gallus_result_t
+gallus_session_tls_set_ktls(bool ktls);
+
 /**
  * Get a certificate store in a session_tls.
  *
@@ -208,6 +224,35 @@ gallus_session_tls_get_server_key(char **c);
 gallus_result_t
 gallus_session_tls_get_trust_point_conf(char **c);
 
+/**
+ * Get the kTLS offload setting of a session_tls.
+ *
+ *  @param[out]  ktls   kTLS is enabled or not.
+ *
+ *  @retval	GALLUS_RESULT_OK	Succeeded.
+ *  @retval	GALLUS_RESULT_INVALID_ARGS	Failed, invalid argument(s).
+ *
+ */
+gallus_result_t
+gallus_session_tls_get_ktls(bool *ktls);
+
+/**
+ * Get the kTLS offload status of an established session.
+ *
+ *  @param[in]   s      A session.
+ *  @param[out]  send   kTLS TX is active or not.
+ *  @param[out]  recv   kTLS RX is active or not.
+ *
+ *  @retval	GALLUS_RESULT_OK	Succeeded.
+ *  @retval	GALLUS_RESULT_INVALID_ARGS	Failed, invalid argument(s).
+ *
+ *  @details Both are false until the handshake is done, or if the
+ *  session fell back to user space TLS.
+ */
+gallus_result_t
+gallus_session_tls_get_ktls_status(gallus_session_t s,
+                                    bool *send, bool *recv);
+
 /**
  * Set default trust point check function.
  *
@@ -0,0 +1,363 @@
+#pragma once
+
+
+
+
+
+/**
+ *	@file	gallus_sort.h
+ */
+
+
+
+
+
+/*
+ * Tunables of GALLUS_SORT_DEFINE().
+ */
+#define GALLUS_SORT_INSERTION_MAX	24	/* insertion sort below this */
+#define GALLUS_SORT_NINTHER_MIN	128	/* pseudo median of 9 above this */
+#define GALLUS_SORT_PARTIAL_LIMIT	8	/* moves allowed on a presorted run */
+
+
+/**
+ * Define a sort function for an element type.
+ *
+ *	@param[in]	name	The name of the function.
+ *	@param[in]	type	The element type.
+ *	@param[in]	less	A function or a function like macro taking
+ *				two elements by value, true iff the first
+ *				one goes before the second one.
+ *
+ * @details This defines:
+ *
+ *	static inline void name(type *array, size_t nelem);
+ *
+ * and its static helpers named name_*. It is a pattern defeating
+ * quicksort: an insertion sort for small ranges, a pseudo median of
+ * 9 pivot, the already partitioned ranges are finished by a bounded
+ * insertion sort, and a heapsort once the partitions go bad too many
+ * times, so O(n log n) in the worst case. Not stable.
+ *
+ * The \b less is expanded in place, so unlike \b gallus_qsort_r() no
+ * comparison is an indirect call and the elements are moved as \b
+ * type, not byte by byte.
+ *
+ * An example:
+ *
+ *	#define RULE_LESS(a, b)	((a).m_prio < (b).m_prio)
+ *	GALLUS_SORT_DEFINE(s_sort_rules, rule_t, RULE_LESS)
+ */
+#define GALLUS_SORT_DEFINE(name, type, less)                                  \
+static inline void                                                            \
+name##_swap(type *a, type *b) {                                               \
+  type t = *a;                                                                \
+  *a = *b;                                                                    \
+  *b = t;                                                                     \
+}                                                                             \
+static inline void                                                            \
+name##_sort2(type *a, type *b) {                                              \
+  if (less(*b, *a)) {                                                         \
+    name##_swap(a, b);                                                        \
+  }                                                                           \
+}                                                                             \
+static inline void                                                            \
+name##_sort3(type *a, type *b, type *c) {                                     \
+  name##_sort2(a, b);                                                         \
+  name##_sort2(b, c);                                                         \
+  name##_sort2(a, b);                                                         \
+}                                                                             \
+static inline void                                                            \
+name##_insertion(type *b, type *e, bool guarded) {                            \
+  type *i, *j;                                                                \
+  type t;                                                                     \
+  for (i = b + 1; i < e; i++) {                                               \
+    if (less(*i, *(i - 1))) {                                                 \
+      t = *i;                                                                 \
+      j = i;                                                                  \
+      do {                                                                    \
+        *j = *(j - 1);                                                        \
+        j--;                                                                  \
+      } while ((guarded == false || j > b) && less(t, *(j - 1)));             \
+      *j = t;                                                                 \
+    }                                                                         \
+  }                                                                           \
+}                                                                             \
+static inline bool                                                            \
+name##_partial_insertion(type *b, type *e) {                                  \
+  type *i, *j;                                                                \
+  type t;                                                                     \
+  size_t moved = 0;                                                           \
+  for (i = b + 1; i < e; i++) {                                               \
+    if (less(*i, *(i - 1))) {                                                 \
+      t = *i;                                                                 \
+      j = i;                                                                  \
+      do {                                                                    \
+        *j = *(j - 1);                                                        \
+        j--;                                                                  \
+      } while (j > b && less(t, *(j - 1)));                                   \
+      *j = t;                                                                 \
+      moved += (size_t)(i - j);                                               \
+      if (moved > GALLUS_SORT_PARTIAL_LIMIT) {                                \
+        return false;                                                         \
+      }                                                                       \
+    }                                                                         \
+  }                                                                           \
+  return true;                                                                \
+}                                                                             \
+static inline type *                                                          \
+name##_partition_right(type *b, type *e, bool *already) {                     \
+  type pivot = *b;                                                            \
+  type *first = b;                                                            \
+  type *last = e;                                                             \
+  type *pp;                                                                   \
+  while (less(*++first, pivot)) {                                             \
+  }                                                                           \
+  if (first - 1 == b) {                                                       \
+    while (first < last && !less(*--last, pivot)) {                           \
+    }                                                                         \
+  } else {                                                                    \
+    while (!less(*--last, pivot)) {                                           \
+    }                                                                         \
+  }                                                                           \
+  *already = (first >= last) ? true : false;                                  \
+  while (first < last) {                                                      \
+    name##_swap(first, last);                                                 \
+    while (less(*++first, pivot)) {                                           \
+    }                                                                         \
+    while (!less(*--last, pivot)) {                                           \
+    }                                                                         \
+  }                                                                           \
+  pp = first - 1;                                                             \
+  *b = *pp;                                                                   \
+  *pp = pivot;                                                                \
+  return pp;                                                                  \
+}                                                                             \
+static inline type *                                                          \
+name##_partition_left(type *b, type *e) {                                     \
+  type pivot = *b;                                                            \
+  type *first = b;                                                            \
+  type *last = e;                                                             \
+  while (less(pivot, *--last)) {                                              \
+  }                                                                           \
+  if (last + 1 == e) {                                                        \
+    while (first < last && !less(pivot, *++first)) {                          \
+    }                                                                         \
+  } else {                                                                    \
+    while (!less(pivot, *++first)) {                                          \
+    }                                                                         \
+  }                                                                           \
+  while (first < last) {                                                      \
+    name##_swap(first, last);                                                 \
+    while (less(pivot, *--last)) {                                            \
+    }                                                                         \
+    while (!less(pivot, *++first)) {                                          \
+    }                                                                         \
+  }                                                                           \
+  *b = *last;                                                                 \
+  *last = pivot;                                                              \
+  return last;                                                                \
+}                                                                             \
+static inline void                                                            \
+name##_sift(type *a, size_t i, size_t n) {                                    \
+  type t = a[i];                                                              \
+  size_t c;                                                                   \
+  while ((c = 2 * i + 1) < n) {                                               \
+    if (c + 1 < n && less(a[c], a[c + 1])) {                                  \
+      c++;                                                                    \
+    }                                                                         \
+    if (!less(t, a[c])) {                                                     \
+      break;                                                                  \
+    }                                                                         \
+    a[i] = a[c];                                                              \
+    i = c;                                                                    \
+  }                                                                           \
+  a[i] = t;                                                                   \
+}                                                                             \
+static inline void                                                            \
+name##_heapsort(type *b, type *e) {                                           \
+  size_t n = (size_t)(e - b);                                                 \
+  size_t i;                                                                   \
+  for (i = n / 2; i-- > 0;) {                                                 \
+    name##_sift(b, i, n);                                                     \
+  }                                                                           \
+  for (i = n; i-- > 1;) {                                                     \
+    name##_swap(b, b + i);                                                    \
+    name##_sift(b, 0, i);                                                     \
+  }                                                                           \
+}                                                                             \
+static inline void                                                            \
+name##_break_pattern(type *b, type *e, type *pp) {                            \
+  size_t l = (size_t)(pp - b);                                                \
+  size_t r = (size_t)(e - (pp + 1));                                          \
+  if (l >= GALLUS_SORT_INSERTION_MAX) {                                       \
+    name##_swap(b, b + l / 4);                                                \
+    name##_swap(pp - 1, pp - l / 4);                                          \
+    if (l > GALLUS_SORT_NINTHER_MIN) {                                        \
+      name##_swap(b + 1, b + (l / 4 + 1));                                    \
+      name##_swap(b + 2, b + (l / 4 + 2));                                    \
+      name##_swap(pp - 2, pp - (l / 4 + 1));                                  \
+      name##_swap(pp - 3, pp - (l / 4 + 2));                                  \
+    }                                                                         \
+  }                                                                           \
+  if (r >= GALLUS_SORT_INSERTION_MAX) {                                       \
+    name##_swap(pp + 1, pp + (1 + r / 4));                                    \
+    name##_swap(e - 1, e - r / 4);                                            \
+    if (r > GALLUS_SORT_NINTHER_MIN) {                                        \
+      name##_swap(pp + 2, pp + (2 + r / 4));                                  \
+      name##_swap(pp + 3, pp + (3 + r / 4));                                  \
+      name##_swap(e - 2, e - (1 + r / 4));                                    \
+      name##_swap(e - 3, e - (2 + r / 4));                                    \
+    }                                                                         \
+  }                                                                           \
+}                                                                             \
+static void                                                                   \
+name##_loop(type *b, type *e, int bad_allowed, bool leftmost) {               \
+  size_t n, h, l, r;                                                          \
+  type *pp;                                                                   \
+  bool already;                                                               \
+  while ((n = (size_t)(e - b)) >= GALLUS_SORT_INSERTION_MAX) {                \
+    h = n / 2;                                                                \
+    if (n > GALLUS_SORT_NINTHER_MIN) {                                        \
+      name##_sort3(b, b + h, e - 1);                                          \
+      name##_sort3(b + 1, b + (h - 1), e - 2);                                \
+      name##_sort3(b + 2, b + (h + 1), e - 3);                                \
+      name##_sort3(b + (h - 1), b + h, b + (h + 1));                          \
+      name##_swap(b, b + h);                                                  \
+    } else {                                                                  \
+      name##_sort3(b + h, b, e - 1);                                          \
+    }                                                                         \
+    if (leftmost == false && !less(*(b - 1), *b)) {                           \
+      b = name##_partition_left(b, e) + 1;                                    \
+      continue;                                                               \
+    }                                                                         \
+    pp = name##_partition_right(b, e, &already);                              \
+    l = (size_t)(pp - b);                                                     \
+    r = (size_t)(e - (pp + 1));                                               \
+    if (l < n / 8 || r < n / 8) {                                             \
+      if (--bad_allowed == 0) {                                               \
+        name##_heapsort(b, e);                                                \
+        return;                                                               \
+      }                                                                       \
+      name##_break_pattern(b, e, pp);                                         \
+    } else if (already == true &&                                             \
+               name##_partial_insertion(b, pp) == true &&                     \
+               name##_partial_insertion(pp + 1, e) == true) {                 \
+      return;                                                                 \
+    }                                                                         \
+    name##_loop(b, pp, bad_allowed, leftmost);                                \
+    b = pp + 1;                                                               \
+    leftmost = false;                                                         \
+  }                                                                           \
+  name##_insertion(b, e, leftmost);                                           \
+}                                                                             \
+static inline void                                                            \
+name(type *array, size_t nelem) {                                             \
+  if (array != NULL && nelem > 1) {                                           \
+    name##_loop(array, array + nelem,                                         \
+                (int)(64 - __builtin_clzll((unsigned long long)nelem)), true); \
+  }                                                                           \
+}
+
+
+
+
+
+__BEGIN_DECLS
+
+
+
+
+
+/**
+ * Sort an array of uint32_t.
+ *
+ *	@param[in,out]	array	An array.
+ *	@param[in]	nelem	# of the elements.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details A LSD radix sort by 8 bits, O(n) with a temporary array of
+ * the same size. The digits all the keys share are skipped.
+ */
+gallus_result_t
+gallus_radix_sort_u32(uint32_t *array, size_t nelem);
+
+
+/**
+ * Sort an array of uint64_t.
+ *
+ *	@param[in,out]	array	An array.
+ *	@param[in]	nelem	# of the elements.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details The same as \b gallus_radix_sort_u32().
+ */
+gallus_result_t
+gallus_radix_sort_u64(uint64_t *array, size_t nelem);
+
+
+/**
+ * Sort an array of records by an integer key in them.
+ *
+ *	@param[in,out]	array	An array.
+ *	@param[in]	nelem	# of the elements.
+ *	@param[in]	size	The size of an element.
+ *	@param[in]	key_offset	The offset of the key in an element.
+ *	@param[in]	key_size	The size of the key (1, 2, 4 or 8.)
+ *	@param[in]	is_signed	If \b true, the key is signed.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details The key is in the host byte order. The sort is stable, so
+ * the records can be sorted by several keys, the least significant
+ * one first.
+ */
+gallus_result_t
+gallus_radix_sort_records(void *array, size_t nelem, size_t size,
+                          size_t key_offset, size_t key_size,
+                          bool is_signed);
+
+
+/**
+ * Sort an array on a thread pool.
+ *
+ *	@param[in]	pptr	A pointer to an executor mode thread pool
+ *				(NULL: sort on the caller only.)
+ *	@param[in,out]	array	An array.
+ *	@param[in]	nelem	# of the elements.
+ *	@param[in]	size	The size of an element.
+ *	@param[in]	cmp	A comparator as \b gallus_qsort_r().
+ *	@param[in]	arg	An argument for the \b cmp.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_NO_MEMORY		Failed, no memory.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details A merge sort: the array is cut into a run per a pool
+ * worker and the caller, the runs are sorted by \b gallus_qsort_r()
+ * in parallel, and then merged pairwise. Every merge pass is split
+ * evenly over the output by the merge path, so the last passes,
+ * which have only one or two merges, are parallel as well. It takes
+ * a temporary array of the same size. Small arrays and a pool of no
+ * worker are just sorted by \b gallus_qsort_r(). Not stable since
+ * the runs aren't.
+ */
+gallus_result_t
+gallus_parallel_sort_r(gallus_thread_pool_t *pptr,
+                       void *array, size_t nelem, size_t size,
+                       int (*cmp)(const void *, const void *, void *),
+                       void *arg);
+
+
+
+
+
+__END_DECLS
@@ -30,6 +30,50 @@ gallus_result_t
 gallus_str_tokenize_quote(char *buf, char **tokens,
                            size_t max, const char *delm, const char *quote);
 
+
+/*
+ * A 256 bit char set, the first four chars broadcasted for the word
+ * at a time scan.
+ */
+typedef struct {
+  uint64_t m_bits[4];
+  uint64_t m_bcast[4];
+  size_t m_n;
+} gallus_str_charset_t;
+
+
+/*
+ * A token view into the tokenized buffer, not NUL terminated.
+ */
+typedef struct {
+  const char *m_str;
+  size_t m_len;
+} gallus_str_token_t;
+
+
+/*
+ * A tokenizer yielding the tokens of [buf, buf + len) one by one
+ * without modifying the buffer. The delimiter semantics are the same
+ * as gallus_str_tokenize(); NULs are ordinary chars here.
+ */
+typedef struct {
+  const char *m_cur;
+  const char *m_end;
+  gallus_str_charset_t m_delms;
+} gallus_str_tokenizer_t;
+
+gallus_result_t
+gallus_str_tokenizer_init(gallus_str_tokenizer_t *tkptr,
+                           const char *buf, size_t len, const char *delm);
+
+/*
+ * Returns GALLUS_RESULT_OK with the next token in *tokptr, or
+ * GALLUS_RESULT_EOF when no tokens are left.
+ */
+gallus_result_t
+gallus_str_tokenizer_next(gallus_str_tokenizer_t *tkptr,
+                           gallus_str_token_t *tokptr);
+
 gallus_result_t
 gallus_str_unescape(const char *org, const char *escaped,
                      char **retptr);
@@ -60,6 +60,23 @@ gallus_result_t
 gallus_task_run(gallus_task_t *tptr, gallus_pooled_thread_t *ptptr, int flag);
 
 
+/*
+ * Queue a task to an executor mode thread pool. Never blocks on the
+ * thread availability.
+ */
+gallus_result_t
+gallus_task_submit(gallus_task_t *tptr, gallus_thread_pool_t *pptr, int flag);
+
+
+/*
+ * Same as gallus_task_submit() but also returns a future completed
+ * with the exit code of the task.
+ */
+gallus_result_t
+gallus_task_submit_future(gallus_task_t *tptr, gallus_thread_pool_t *pptr,
+                          int flag, gallus_future_t *fptr);
+
+
 void
 gallus_task_finalize(gallus_task_t *tptr, bool is_cancelled);
 
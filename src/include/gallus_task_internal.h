@@ -28,4 +28,8 @@ typedef struct gallus_task_record {
   int m_flag;
 
   gallus_thread_t m_tmp_thd;
+
+  struct gallus_task_record *m_next;	/* executor run queue link */
+
+  gallus_future_t m_future;	/* completed with the exit code */
 } gallus_task_record;
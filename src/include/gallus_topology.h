@@ -0,0 +1,90 @@
+#pragma once
+
+
+
+
+
+/**
+ *	@file	gallus_topology.h
+ */
+
+
+
+
+
+__BEGIN_DECLS
+
+
+
+
+
+/**
+ * The place of a CPU in the machine. Every sharing domain is named by
+ * the lowest CPU # in it, so two CPUs share a domain iff the ids are
+ * equal.
+ */
+typedef struct {
+  int m_cpu;
+  int m_core;			/**< SMT siblings share the core. */
+  int m_package;
+  int m_node;			/**< NUMA node. */
+  int m_l2;
+  int m_l3;
+  size_t m_n_smt;		/**< # of the SMT threads of the core. */
+} gallus_cpu_info_t;
+
+
+
+
+
+/**
+ * Get a # of the CPUs configured in the machine.
+ *
+ *	@returns	A # of the CPUs.
+ */
+size_t
+gallus_topology_get_cpu_num(void);
+
+
+/**
+ * Get the topology information of a CPU.
+ *
+ *	@param[in]	cpu	A CPU #.
+ *	@param[out]	info	A pointer to the returned information.
+ *
+ *	@retval GALLUS_RESULT_OK		Succeeded.
+ *	@retval GALLUS_RESULT_OUT_OF_RANGE	Failed, no such CPU.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details The information is read from the sysfs once. Anything the
+ * sysfs doesn't tell is assumed to be private to the CPU except for
+ * the package and the node.
+ */
+gallus_result_t
+gallus_topology_get_cpu_info(int cpu, gallus_cpu_info_t *info);
+
+
+/**
+ * Get the CPUs the calling thread is allowed to run on, in the
+ * topology order.
+ *
+ *	@param[out]	cpus	An array for the returned CPU #s.
+ *	@param[in]	n	A size of the \b cpus.
+ *
+ *	@retval >=0				Succeeded, a # of the CPUs
+ *						returned.
+ *	@retval GALLUS_RESULT_POSIX_API_ERROR	Failed, posix API error.
+ *	@retval GALLUS_RESULT_INVALID_ARGS	Failed, invalid args.
+ *
+ * @details The CPUs are sorted by the node, the package, the L3, the
+ * L2 and the core, so that the neighbors share as many levels as
+ * possible.
+ */
+gallus_result_t
+gallus_topology_get_usable_cpus(int *cpus, size_t n);
+
+
+
+
+
+__END_DECLS
@@ -21,6 +21,14 @@
 #define CALLOUT_STAGE_SHUTDOWN_TIMEOUT	5LL * 1000LL * 1000LL * 1000LL
 					/* 5 sec. */
 
+#define CALLOUT_WORKER_MAX_WAIT	1000LL * 1000LL * 1000LL /* 1 sec. */
+
+#define CALLOUT_SHARD_MAX	64
+
+#define CALLOUT_TASK_TABLE_STRIPES	16
+
+#define CALLOUT_SHARD_SWEEP_THRESHOLD	256	/* tombstones. */
+
 #define gallus_msg_error_with_task(t, str, ...) {                      \
     do {                                                                \
       if (IS_VALID_STRING((t)->m_name) == true) {                       \
@@ -39,6 +47,14 @@ TAILQ_HEAD(chrono_task_queue_t, gallus_callout_task_record);
 typedef struct chrono_task_queue_t chrono_task_queue_t;
 
 
+typedef struct {
+  gallus_mutex_t m_lck;			/* The shard lock. */
+  chrono_task_queue_t m_q;		/* The timed tasks Q. */
+  volatile size_t m_n_tombstones;	/* The cancelled tasks in the Q. */
+} __attribute__((aligned(64))) callout_shard_record;
+typedef callout_shard_record *callout_shard_t;
+
+
 typedef gallus_result_t
 (*final_task_schedule_proc_t)(const gallus_callout_task_t * const tasks,
                               gallus_chrono_t start_time,
@@ -55,21 +71,28 @@ static gallus_mutex_t s_sched_lck = NULL;	/* The scheduler main lock. */
 static gallus_cond_t s_sched_cnd = NULL;		/* The scheduler cond. */
 static gallus_mutex_t s_lck = NULL;		/* The global lock. */
 
-static gallus_hashmap_t s_tsk_tbl = NULL;	/* The valid tasks table. */
+/* The valid tasks table, striped by the task address. */
+static gallus_hashmap_t s_tsk_tbls[CALLOUT_TASK_TABLE_STRIPES];
 
 static gallus_bbq_t s_urgent_tsk_q = NULL;	/* The urgent tasks Q. */
-static chrono_task_queue_t s_chrono_tsk_q;	/* The timed tasks Q. */
-static gallus_mutex_t s_q_lck;			/* The timed task Q lock. */
 static gallus_bbq_t s_idle_tsk_q = NULL;	/* The Idle taskss Q. */
 
+/* The timed tasks Qs, one per a callout worker. */
+static callout_shard_record s_shards[CALLOUT_SHARD_MAX];
+static size_t s_n_shards = 1;
+static volatile size_t s_next_shard = 0;
+static __thread ssize_t s_owned_shard = -1;	/* The shard I drain. */
+static __thread ssize_t s_pref_shard = -1;	/* The shard I submit to. */
+
 static gallus_callout_idle_proc_t s_idle_proc = NULL;
 static gallus_callout_idle_arg_freeup_proc_t s_free_proc = NULL;
 static void *s_idle_proc_arg = NULL;
 static gallus_chrono_t s_idle_interval = -1LL;
 static gallus_chrono_t s_next_idle_abstime = -1LL;
+static bool s_do_idle_now = false;	/* Kicked, run the idle proc. */
 
 static size_t s_n_workers;
-static volatile bool s_do_loop = false;		/* The main loop on/off */
+static bool s_do_loop = false;		/* The main loop on/off */
 static volatile bool s_is_stopped = false;	/* The main loop is
                                                  * stopped or not. */
 
@@ -90,7 +113,7 @@ static void s_dtors(void) __attr_destructor__(107);
  * General lock order:
  *
  *	The global lock (s_lock_global)
- *	The timed task queue lock (s_lock_task_q)
+ *	A timed task shard lock (s_lock_shard)
  *	A task lock (s_lock_task)
  *
  * Note taht the task locks are recursive.
@@ -100,8 +123,8 @@ static void s_dtors(void) __attr_destructor__(107);
 static void s_lock_global(void);
 static void s_unlock_global(void);
 
-static void s_lock_task_q(void);
-static void s_unlock_task_q(void);
+static void s_lock_shard(callout_shard_t sh);
+static void s_unlock_shard(callout_shard_t sh);
 
 static void s_lock_task(gallus_callout_task_t t);
 static void s_unlock_task(gallus_callout_task_t t);
@@ -143,6 +166,9 @@ static gallus_result_t s_schedule_timed_task(gallus_callout_task_t t);
 static void s_unschedule_timed_task_no_lock(gallus_callout_task_t t);
 static void s_unschedule_timed_task(gallus_callout_task_t t);
 
+static void s_prepare_tasks_for_exec(const gallus_callout_task_t * const tasks,
+                                     gallus_chrono_t start_time,
+                                     size_t n);
 static gallus_result_t s_exec_task(gallus_callout_task_t t);
 
 static gallus_result_t s_submit_callout_stage(
@@ -152,6 +178,17 @@ static gallus_result_t s_submit_callout_stage(
 
 static void s_task_freeup(void **valptr);
 
+static void s_tombstone_timed_task(gallus_callout_task_t t);
+static gallus_result_t s_schedule_timed_tasks(
+    const gallus_callout_task_t * const tasks, size_t n, size_t shard,
+    gallus_chrono_t initial_delay, gallus_chrono_t interval);
+static size_t s_pick_shard(void);
+static gallus_result_t
+s_get_runnable_timed_task(callout_shard_t sh,
+                          gallus_chrono_t base_abstime,
+                          gallus_callout_task_t *tasks, size_t n,
+                          gallus_chrono_t *next_wakeup);
+
 
 
 
@@ -181,6 +218,7 @@ s_task_freeup(void **valptr) {
 static void
 s_once_proc(void) {
   gallus_result_t r;
+  size_t i;
 
   if ((r = gallus_mutex_create(&s_sched_lck)) != GALLUS_RESULT_OK) {
     gallus_perror(r);
@@ -197,11 +235,13 @@ s_once_proc(void) {
     gallus_exit_fatal("can't initialize the callout cond.\n");
   }
 
-  if ((r = gallus_hashmap_create(&s_tsk_tbl,
-                                  GALLUS_HASHMAP_TYPE_ONE_WORD,
-                                  NULL)) != GALLUS_RESULT_OK) {
-    gallus_perror(r);
-    gallus_exit_fatal("can't initialize the callout table.\n");
+  for (i = 0; i < CALLOUT_TASK_TABLE_STRIPES; i++) {
+    if ((r = gallus_hashmap_create(&(s_tsk_tbls[i]),
+                                    GALLUS_HASHMAP_TYPE_ONE_WORD,
+                                    NULL)) != GALLUS_RESULT_OK) {
+      gallus_perror(r);
+      gallus_exit_fatal("can't initialize the callout table.\n");
+    }
   }
 
   if ((r = gallus_bbq_create(&s_urgent_tsk_q, gallus_callout_task_t,
@@ -218,13 +258,15 @@ s_once_proc(void) {
     gallus_exit_fatal("can't initialize the callout idle tasks queue.\n");
   }
 
-  if ((r = gallus_mutex_create_recursive(&s_q_lck)) != GALLUS_RESULT_OK) {
-    gallus_perror(r);
-    gallus_exit_fatal("can't initialize the callout task queue mutex.\n");
+  for (i = 0; i < CALLOUT_SHARD_MAX; i++) {
+    if ((r = gallus_mutex_create_recursive(&(s_shards[i].m_lck))) !=
+        GALLUS_RESULT_OK) {
+      gallus_perror(r);
+      gallus_exit_fatal("can't initialize the callout task queue mutex.\n");
+    }
+    TAILQ_INIT(&(s_shards[i].m_q));
   }
 
-  TAILQ_INIT(&s_chrono_tsk_q);
-
   s_is_inited = true;
 }
 
@@ -245,9 +287,16 @@ s_ctors(void) {
 
 static inline void
 s_final(void) {
+  size_t i;
+
   gallus_bbq_destroy(&s_idle_tsk_q, true);
   gallus_bbq_destroy(&s_urgent_tsk_q, true);
-  gallus_hashmap_destroy(&s_tsk_tbl, true);
+  for (i = 0; i < CALLOUT_SHARD_MAX; i++) {
+    gallus_mutex_destroy(&(s_shards[i].m_lck));
+  }
+  for (i = 0; i < CALLOUT_TASK_TABLE_STRIPES; i++) {
+    gallus_hashmap_destroy(&(s_tsk_tbls[i]), true);
+  }
   gallus_cond_destroy(&s_sched_cnd);
   gallus_mutex_destroy(&s_lck);
   gallus_mutex_destroy(&s_sched_lck);
@@ -332,28 +381,12 @@ s_run_tasks_by_self(const gallus_callout_task_t * const tasks,
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
 
   if (likely(tasks != NULL && n > 0)) {
-    gallus_callout_task_t t;
     size_t i;
 
-    for (i = 0; i < n; i++) {
-      /*
-       * Change the state of tasks to TASK_STATE_DEQUEUED and set
-       * the last execution (start) time as now.
-       */
-      t = tasks[i];
-
-      s_lock_task(t);
-      {
-        if (t->m_status == TASK_STATE_ENQUEUED ||
-            t->m_status == TASK_STATE_CREATED) {
-          (void)s_set_task_state_in_table(t, TASK_STATE_DEQUEUED);
-          t->m_status = TASK_STATE_DEQUEUED;
-        }
-        t->m_last_abstime = start_time;
-      }
-      s_unlock_task(t);
+    s_prepare_tasks_for_exec(tasks, start_time, n);
 
-      (void)s_exec_task(t);
+    for (i = 0; i < n; i++) {
+      (void)s_exec_task(tasks[i]);
     }
 
     ret = (gallus_result_t)n;
@@ -396,6 +429,7 @@ s_start_callout_main_loop(void) {
       gallus_result_t sn_timed_tasks;
 
       gallus_result_t r;
+      bool is_kicked;
 
       gallus_chrono_t now;
       gallus_chrono_t next_wakeup;
@@ -411,9 +445,8 @@ s_start_callout_main_loop(void) {
       (void)gallus_mutex_enter_critical(&s_sched_lck, &cstate);
       {
         s_is_stopped = false;
-        mbar();
 
-        while (s_do_loop == true) {
+        while (gallus_atomic_load(&s_do_loop, RELAXED) == true) {
 
           n_out_tasks = 0;
 
@@ -453,12 +486,19 @@ s_start_callout_main_loop(void) {
           s_unlock_global();
 
           /*
-           * Pack the tasks into a buffer.
+           * Pack the tasks into a buffer. The timed tasks are ours
+           * only if there is no callout worker, otherwise the
+           * workers drain their own shards.
            */
 
-          sn_timed_tasks = s_get_runnable_timed_task(now, timed_tasks,
-                                                     CALLOUT_TASK_MAX,
-                                                     &next_wakeup);
+          if (s_n_workers == 0) {
+            sn_timed_tasks = s_get_runnable_timed_task(&(s_shards[0]), now,
+                                                       timed_tasks,
+                                                       CALLOUT_TASK_MAX,
+                                                       &next_wakeup);
+          } else {
+            sn_timed_tasks = 0;
+          }
           if (sn_timed_tasks > 0) {
             /*
              * Pack the timed tasks.
@@ -533,8 +573,11 @@ s_start_callout_main_loop(void) {
             }
           }
 
+          is_kicked = gallus_atomic_exchange(&s_do_idle_now, false,
+                                             ACQUIRE);
           if (s_idle_proc != NULL &&
-              s_next_idle_abstime < (now + CALLOUT_TASK_SCHED_JITTER)) {
+              (is_kicked == true ||
+               s_next_idle_abstime < (now + CALLOUT_TASK_SCHED_JITTER))) {
             if (likely(s_idle_proc(s_idle_proc_arg) ==
                        GALLUS_RESULT_OK)) {
               s_next_idle_abstime = now + s_idle_interval;
@@ -542,7 +585,7 @@ s_start_callout_main_loop(void) {
               /*
                * Stop the main loop and return (clean finish.)
                */
-              s_do_loop = false;
+              gallus_atomic_store(&s_do_loop, false, RELAXED);
               goto critical_end;
             }
           }
@@ -550,7 +593,8 @@ s_start_callout_main_loop(void) {
           /*
            * fetch the start time of the timed task in the queue head.
            */
-          next_wakeup = s_peek_current_wakeup_time();
+          next_wakeup = (s_n_workers == 0) ?
+              s_peek_current_wakeup_time(&(s_shards[0])) : -1LL;
           if (next_wakeup <= 0LL) {
             /*
              * Nothing in the timed Q.
@@ -573,6 +617,15 @@ s_start_callout_main_loop(void) {
            * calculate the timeout and sleep.
            */
           timeout = next_wakeup - now;
+          if (unlikely(gallus_atomic_load(&s_do_idle_now, ACQUIRE) ==
+                       true)) {
+            /*
+             * Kicked while running the tasks. A kick landing after
+             * this check but before the wait is caught when the wait
+             * times out, as the stop request is.
+             */
+            timeout = 0LL;
+          }
           if (likely(timeout > 0LL)) {
             if (timeout > s_idle_interval) {
               timeout = s_idle_interval;
@@ -631,7 +684,7 @@ s_start_callout_main_loop(void) {
       s_wakeup_sched();
       (void)gallus_mutex_leave_critical(&s_sched_lck, cstate);
   
-      if (s_do_loop == false) {
+      if (gallus_atomic_load(&s_do_loop, RELAXED) == false) {
         /*
          * The clean finish.
          */
@@ -655,12 +708,12 @@ s_stop_callout_main_loop(void) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
 
   if (s_is_stopped == false) {
-    if (s_do_loop == true) {
+    if (gallus_atomic_load(&s_do_loop, RELAXED) == true) {
       /*
-       * Stop the main loop first.
+       * Stop the main loop first. SEQ_CST as the mbar() used to, so
+       * that the store is not delayed past the wakeup below.
        */
-      s_do_loop = false;
-      mbar();
+      gallus_atomic_store(&s_do_loop, false, SEQ_CST);
       (void)gallus_bbq_wakeup(&s_urgent_tsk_q, -1LL);
 
       s_lock_sched();
@@ -710,13 +763,15 @@ gallus_callout_initialize_handler(size_t n_workers,
     }
 
     s_n_workers = n_workers;
+    s_n_shards = (n_workers == 0) ? 1 :
+        ((n_workers < CALLOUT_SHARD_MAX) ? n_workers : CALLOUT_SHARD_MAX);
     s_final_task_sched_proc =
         (s_n_workers == 0) ? s_run_tasks_by_self : s_submit_callout_stage;
     s_idle_proc = proc;
     s_idle_proc_arg = arg;
     s_idle_interval = interval;
     s_free_proc = freeup;
-    s_do_loop = false;
+    gallus_atomic_store(&s_do_loop, false, RELAXED);
     s_is_stopped = false;
 
     s_is_handler_inited = true;
@@ -775,14 +830,12 @@ gallus_callout_start_main_loop(void) {
     if (s_n_workers > 0) {
       ret = s_start_callout_stage();
       if (likely(ret == GALLUS_RESULT_OK)) {
-        s_do_loop = true;
-        mbar();
+        gallus_atomic_store(&s_do_loop, true, RELEASE);
 
         ret = s_start_callout_main_loop();
       }
     } else {
-      s_do_loop = true;
-      mbar();
+      gallus_atomic_store(&s_do_loop, true, RELEASE);
 
       ret = s_start_callout_main_loop();
     }
@@ -808,6 +861,26 @@ gallus_callout_stop_main_loop(void) {
 }
 
 
+gallus_result_t
+gallus_callout_kick_idle_proc(void) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(s_is_handler_inited == true)) {
+    /*
+     * Set the flag then wake the loop up, the loop checks the flag
+     * after it wakes.
+     */
+    gallus_atomic_store(&s_do_idle_now, true, RELEASE);
+    (void)gallus_bbq_wakeup(&s_urgent_tsk_q, 0LL);
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_NOT_OPERATIONAL;
+  }
+
+  return ret;
+}
+
+
 
 
 
@@ -889,6 +962,49 @@ gallus_callout_cancel_task(const gallus_callout_task_t *tptr) {
 }
 
 
+gallus_result_t
+gallus_callout_submit_tasks(const gallus_callout_task_t *tasks, size_t n,
+                             gallus_chrono_t delay,
+                             gallus_chrono_t interval) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(s_is_handler_inited == true)) {
+    if (likely(tasks != NULL && n > 0)) {
+
+      /*
+       * All or nothing.
+       */
+      ret = s_submit_tasks(tasks, n, delay, interval);
+    } else {
+      ret = GALLUS_RESULT_INVALID_ARGS;
+    }
+  } else {
+    ret = GALLUS_RESULT_NOT_OPERATIONAL;
+  }
+
+  return ret;
+}
+
+
+void
+gallus_callout_cancel_tasks(const gallus_callout_task_t *tasks, size_t n) {
+  if (likely(s_is_handler_inited == true)) {
+    if (likely(tasks != NULL)) {
+      size_t i;
+
+      /*
+       * The timed tasks are just marked, so this is cheap.
+       */
+      for (i = 0; i < n; i++) {
+        if (likely(tasks[i] != NULL)) {
+          s_cancel_task_no_lock(tasks[i]);
+        }
+      }
+    }
+  }
+}
+
+
 gallus_result_t
 gallus_callout_exec_task_forcibly(const gallus_callout_task_t *tptr) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
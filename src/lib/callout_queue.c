@@ -1,11 +1,8 @@
-
-
-
 /**
  * General lock order:
  *
  *	The global lock (s_lock_global)
- *	The timed task queue lock (s_lock_task_q)
+ *	A timed task shard lock (s_lock_shard)
  *	A task lock (s_lock_task)
  *
  * Note taht the task locks are recursive.
@@ -15,18 +12,110 @@
 
 
 
+/*
+ * The timed tasks are sharded per callout worker. A shard is drained
+ * only by its owner (the worker of the same index, or the master
+ * scheduler if there is no worker), and a task stays in the shard it
+ * was submitted to for all its lifetime.
+ */
+
+
+static inline callout_shard_t
+s_shard_of(gallus_callout_task_t t) {
+  return &(s_shards[t->m_shard]);
+}
+
+
+static inline void
+s_lock_shard(callout_shard_t sh) {
+  (void)gallus_mutex_lock(&(sh->m_lck));
+}
+
+
 static inline void
-s_lock_task_q(void) {
-  if (likely(s_q_lck != NULL)) {
-    (void)gallus_mutex_lock(&s_q_lck);
+s_unlock_shard(callout_shard_t sh) {
+  (void)gallus_mutex_unlock(&(sh->m_lck));
+}
+
+
+/*
+ * The owners use their own shards, the others stick to one shard
+ * per thread.
+ */
+static inline size_t
+s_pick_shard(void) {
+  if (s_owned_shard >= 0) {
+    return (size_t)s_owned_shard;
+  }
+  if (s_pref_shard < 0) {
+    s_pref_shard = (ssize_t)gallus_atomic_fetch_add(&s_next_shard, 1,
+                                                    RELAXED);
   }
+
+  return (size_t)s_pref_shard % s_n_shards;
 }
 
 
+/*
+ * Let the owner of the shard re-compute its timeout.
+ */
 static inline void
-s_unlock_task_q(void) {
-  if (likely(s_q_lck != NULL)) {
-    (void)gallus_mutex_unlock(&s_q_lck);
+s_kick_shard(size_t idx) {
+  gallus_result_t r;
+
+  if (s_n_workers == 0) {
+    r = gallus_bbq_wakeup(&s_urgent_tsk_q, 0LL);
+    if (unlikely(r != GALLUS_RESULT_OK)) {
+      gallus_perror(r);
+      gallus_msg_error("can't wake the callout task master "
+                        "scheduler up.\n");
+    }
+  } else if (s_owned_shard != (ssize_t)idx) {
+    /*
+     * A NULL in the queue never gets lost unlike the wakeup. It's
+     * fine if the queue is full, the worker is busy anyway.
+     */
+    gallus_callout_task_t nil = NULL;
+    (void)gallus_bbq_put(&(s_cs.m_qs[idx]), (void **)&nil,
+                          gallus_callout_task_t, 0LL);
+  }
+}
+
+
+/*
+ * Both the shard and the task must be locked.
+ */
+static inline void
+s_unlink_timed_task(callout_shard_t sh, gallus_callout_task_t t) {
+  TAILQ_REMOVE(&(sh->m_q), t, m_entry);
+  t->m_is_in_timed_q = false;
+  if (t->m_status == TASK_STATE_CANCELLED) {
+    (void)gallus_atomic_fetch_sub(&(sh->m_n_tombstones), 1, RELAXED);
+  }
+}
+
+
+/*
+ * Cancel a task in the timed task Q lazily. The task must be locked
+ * but the shard needs not.
+ *
+ * The task is left in the Q as a tombstone and the owner of the shard
+ * reclaims it at the expiry, or sweeps the shard when the tombstones
+ * pile up.
+ */
+static inline void
+s_tombstone_timed_task(gallus_callout_task_t t) {
+  if (likely(t->m_is_in_timed_q == true &&
+             t->m_status != TASK_STATE_CANCELLED)) {
+    callout_shard_t sh = s_shard_of(t);
+
+    (void)s_set_task_state_in_table(t, TASK_STATE_CANCELLED);
+    t->m_status = TASK_STATE_CANCELLED;
+
+    if (gallus_atomic_add_fetch(&(sh->m_n_tombstones), 1, RELAXED) ==
+        CALLOUT_SHARD_SWEEP_THRESHOLD) {
+      s_kick_shard(t->m_shard);
+    }
   }
 }
 
@@ -34,84 +123,80 @@ s_unlock_task_q(void) {
 
 
 
+/*
+ * The shard must be locked.
+ */
 static inline gallus_chrono_t
-s_do_sched(gallus_callout_task_t t) {
+s_do_sched_no_lock(callout_shard_t sh, gallus_callout_task_t t,
+                   bool *is_head) {
   gallus_result_t ret = -1LL;
-  gallus_result_t r;
-  gallus_callout_task_t e;
 
-  s_lock_task_q();
+  s_lock_task(t);
   {
+    if (likely(t->m_is_in_timed_q == false &&
+               t->m_status != TASK_STATE_CANCELLED)) {
+      gallus_callout_task_t e;
+
+      /*
+       * Firstly (re-)compute the next exeution time of this
+       * task.
+       */
+      if (t->m_is_first == false && t->m_do_repeat == true) {
+        t->m_next_abstime = t->m_last_abstime + t->m_interval_time;
+      } else {
+        WHAT_TIME_IS_IT_NOW_IN_NSEC(t->m_last_abstime);
+        t->m_next_abstime = t->m_last_abstime + t->m_initial_delay_time;
+      }
 
-    s_lock_task(t);
-    {
-      if (likely(t->m_is_in_timed_q == false)) {
-
-        /*
-         * Firstly (re-)compute the next exeution time of this
-         * task.
-         */
-        if (t->m_is_first == false && t->m_do_repeat == true) {
-          t->m_next_abstime = t->m_last_abstime + t->m_interval_time;
-        } else {
-          WHAT_TIME_IS_IT_NOW_IN_NSEC(t->m_last_abstime);
-          t->m_next_abstime = t->m_last_abstime + t->m_initial_delay_time;
-        }
+      /*
+       * Then insert the task into the Q. Search from the tail since
+       * the periodic tasks mostly go there.
+       */
+      for (e = TAILQ_LAST(&(sh->m_q), chrono_task_queue_t);
+           e != NULL && e->m_next_abstime > t->m_next_abstime;
+           e = TAILQ_PREV(e, chrono_task_queue_t, m_entry)) {
+        ;
+      }
+      if (e != NULL) {
+        TAILQ_INSERT_AFTER(&(sh->m_q), e, t, m_entry);
+      } else {
+        TAILQ_INSERT_HEAD(&(sh->m_q), t, m_entry);
+        *is_head = true;
+      }
 
-        /*
-         * Then insert the task into the Q.
-         */
-        e = TAILQ_FIRST(&s_chrono_tsk_q);
-        if (e != NULL) {
-          if (e->m_next_abstime > t->m_next_abstime) {
-            TAILQ_INSERT_HEAD(&s_chrono_tsk_q, t, m_entry);
-          } else {
-            for (;
-                 e != NULL && e->m_next_abstime <= t->m_next_abstime;
-                 e = TAILQ_NEXT(e, m_entry)) {
-              ;
-            }
-            if (e != NULL) {
-              TAILQ_INSERT_BEFORE(e, t, m_entry);
-            } else {
-              TAILQ_INSERT_TAIL(&s_chrono_tsk_q, t, m_entry);
-            }
-          }
-        } else {
-          TAILQ_INSERT_TAIL(&s_chrono_tsk_q, t, m_entry);
-        }
+      (void)s_set_task_state_in_table(t, TASK_STATE_ENQUEUED);
+      t->m_status = TASK_STATE_ENQUEUED;
+      t->m_is_in_timed_q = true;
 
-        (void)s_set_task_state_in_table(t, TASK_STATE_ENQUEUED);
-        t->m_status = TASK_STATE_ENQUEUED;
-        t->m_is_in_timed_q = true;
+      ret = t->m_next_abstime;
+    }
+  }
+  s_unlock_task(t);
 
-        ret = t->m_next_abstime;
+  return ret;
+}
 
-        /*
-         * Fianlly wake the master scheduler.
-         */
-        gallus_msg_debug(4, "wake the master scheduler up.\n");
-
-        /*
-         * TODO
-         *
-         *	Re-optimize forcible wake up by timed task submission
-         *	timing and times. See also
-         *	callout.c:s_start_callout_main_loop()
-         */
-
-        r = gallus_bbq_wakeup(&s_urgent_tsk_q, 0LL);
-        if (unlikely(r != GALLUS_RESULT_OK)) {
-          gallus_perror(r);
-          gallus_msg_error("can't wake the callout task master "
-                            "scheduler up.\n");
-        }
-      }
-    }
-    s_unlock_task(t);
 
+static inline gallus_chrono_t
+s_do_sched(gallus_callout_task_t t) {
+  gallus_result_t ret = -1LL;
+  callout_shard_t sh = s_shard_of(t);
+  bool is_head = false;
+
+  s_lock_shard(sh);
+  {
+    ret = s_do_sched_no_lock(sh, t, &is_head);
+  }
+  s_unlock_shard(sh);
+
+  if (is_head == true) {
+    /*
+     * The shard owner sleeps longer than this task. Wake it.
+     */
+    gallus_msg_debug(4, "wake the shard " PFSZ(u) " owner up.\n",
+                      t->m_shard);
+    s_kick_shard(t->m_shard);
   }
-  s_unlock_task_q();
 
   return ret;
 }
@@ -129,18 +214,67 @@ s_schedule_timed_task_no_lock(gallus_callout_task_t t) {
 }
 
 
+/*
+ * The shard lock is enough to make the timed task submisson/fetch
+ * atomic, don't take the global lock.
+ */
 static inline gallus_chrono_t
 s_schedule_timed_task(gallus_callout_task_t t) {
-  gallus_result_t ret = -1LL;
+  return s_schedule_timed_task_no_lock(t);
+}
 
-  if (likely(t != NULL)) {
 
-    s_lock_global();
+/*
+ * Schedule the claimed tasks into a shard at once. All or nothing;
+ * returns the \b n, or GALLUS_RESULT_INVALID_STATE_TRANSITION leaving
+ * the tasks untouched if any of them can't be queued.
+ */
+static inline gallus_result_t
+s_schedule_timed_tasks(const gallus_callout_task_t * const tasks, size_t n,
+                       size_t shard,
+                       gallus_chrono_t initial_delay,
+                       gallus_chrono_t interval) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  size_t i;
+
+  if (likely(tasks != NULL && n > 0 && shard < s_n_shards)) {
+    callout_shard_t sh = &(s_shards[shard]);
+    bool is_head = false;
+
+    s_lock_shard(sh);
     {
-      ret = s_do_sched(t);
+      /*
+       * The caller has claimed the tasks so no one else submits them
+       * in between the two passes; a task lock at a time is enough.
+       */
+      ret = (gallus_result_t)n;
+      for (i = 0; i < n && ret > 0; i++) {
+        s_lock_task(tasks[i]);
+        {
+          if (unlikely(tasks[i]->m_is_in_timed_q == true ||
+                       tasks[i]->m_status == TASK_STATE_CANCELLED)) {
+            ret = GALLUS_RESULT_INVALID_STATE_TRANSITION;
+          }
+        }
+        s_unlock_task(tasks[i]);
+      }
+
+      for (i = 0; i < n && ret > 0; i++) {
+        s_lock_task(tasks[i]);
+        {
+          s_set_submit_params(tasks[i], shard, initial_delay, interval);
+          (void)s_do_sched_no_lock(sh, tasks[i], &is_head);
+        }
+        s_unlock_task(tasks[i]);
+      }
     }
-    s_unlock_global();
+    s_unlock_shard(sh);
 
+    if (is_head == true) {
+      s_kick_shard(shard);
+    }
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
   }
 
   return ret;
@@ -152,28 +286,27 @@ s_schedule_timed_task(gallus_callout_task_t t) {
 
 static inline void
 s_do_unsched(gallus_callout_task_t t) {
+  callout_shard_t sh = s_shard_of(t);
 
-  s_lock_task_q();
+  s_lock_shard(sh);
   {
 
     s_lock_task(t);
     {
       if (likely(t->m_is_in_timed_q == true)) {
 
-        TAILQ_REMOVE(&s_chrono_tsk_q, t, m_entry);
+        s_unlink_timed_task(sh, t);
 
         if (t->m_status == TASK_STATE_ENQUEUED) {
             (void)s_set_task_state_in_table(t, TASK_STATE_DEQUEUED);
             t->m_status = TASK_STATE_DEQUEUED;
         }
-
-        t->m_is_in_timed_q = false;
       }
     }
     s_unlock_task(t);
-      
+
   }
-  s_unlock_task_q();
+  s_unlock_shard(sh);
 
 }
 
@@ -203,28 +336,14 @@ s_unschedule_timed_task(gallus_callout_task_t t) {
 
 
 
-static inline gallus_callout_task_t
-s_peek_timed_task(void) {
-  gallus_callout_task_t ret = NULL;
-
-  s_lock_task_q();
-  {
-    ret = TAILQ_FIRST(&s_chrono_tsk_q);
-  }
-  s_unlock_task_q();
-
-  return ret;
-}
-
-
 static inline gallus_chrono_t
-s_peek_current_wakeup_time(void) {
+s_peek_current_wakeup_time(callout_shard_t sh) {
   gallus_chrono_t ret = -1LL;
   gallus_callout_task_t t;
 
-  s_lock_task_q();
+  s_lock_shard(sh);
   {
-    t = TAILQ_FIRST(&s_chrono_tsk_q);
+    t = TAILQ_FIRST(&(sh->m_q));
     if (t != NULL) {
 
       s_lock_task(t);
@@ -235,57 +354,33 @@ s_peek_current_wakeup_time(void) {
 
     }
   }
-  s_unlock_task_q();
+  s_unlock_shard(sh);
 
   return ret;
 }
 
 
-
-
-
 static inline gallus_callout_task_t
-s_get(void) {
+s_get_timed_task_no_lock(callout_shard_t sh) {
   gallus_callout_task_t ret = NULL;
 
-  s_lock_task_q();
+  s_lock_shard(sh);
   {
-    ret = TAILQ_FIRST(&s_chrono_tsk_q);
+    ret = TAILQ_FIRST(&(sh->m_q));
 
     if (likely(ret != NULL)) {
 
       s_lock_task(ret);
       {
-        TAILQ_REMOVE(&s_chrono_tsk_q, ret, m_entry);
+        s_unlink_timed_task(sh, ret);
         (void)s_set_task_state_in_table(ret, TASK_STATE_DEQUEUED);
         ret->m_status = TASK_STATE_DEQUEUED;
-        ret->m_is_in_timed_q = false;
       }
       s_unlock_task(ret);
 
     }
   }
-  s_unlock_task_q();
-
-  return ret;
-}
-
-
-static inline gallus_callout_task_t
-s_get_timed_task_no_lock(void) {
-  return s_get();
-}
-
-
-static inline gallus_callout_task_t
-s_get_timed_task(void) {
-  gallus_callout_task_t ret = NULL;
-
-  s_lock_global();
-  {
-    ret = s_get();
-  }
-  s_unlock_global();
+  s_unlock_shard(sh);
 
   return ret;
 }
@@ -294,41 +389,71 @@ s_get_timed_task(void) {
 
 
 
+/*
+ * Get the due tasks in the shard. The tombstones found on the way,
+ * or all over the shard if too many, are reclaimed.
+ */
 static inline gallus_result_t
-s_get_runnables(gallus_chrono_t base_abstime,
+s_get_runnables(callout_shard_t sh,
+                gallus_chrono_t base_abstime,
                 gallus_callout_task_t *tasks, size_t n,
                 gallus_chrono_t *next_wakeup) {
   size_t n_ret = 0LL;
   gallus_callout_task_t e;
+  gallus_callout_task_t next;
   gallus_chrono_t the_abstime = base_abstime + CALLOUT_TASK_SCHED_JITTER;
+  chrono_task_queue_t dead;
 
-  s_lock_task_q();
+  TAILQ_INIT(&dead);
+
+  s_lock_shard(sh);
   {
 
-    e = TAILQ_FIRST(&s_chrono_tsk_q);
+    if (unlikely(gallus_atomic_load(&(sh->m_n_tombstones), RELAXED) >=
+                 CALLOUT_SHARD_SWEEP_THRESHOLD)) {
+      for (e = TAILQ_FIRST(&(sh->m_q)); e != NULL; e = next) {
+        next = TAILQ_NEXT(e, m_entry);
+        if (e->m_status == TASK_STATE_CANCELLED) {
+          s_lock_task(e);
+          {
+            s_unlink_timed_task(sh, e);
+          }
+          s_unlock_task(e);
+          TAILQ_INSERT_TAIL(&dead, e, m_entry);
+        }
+      }
+    }
 
-    while (n_ret < n && e != NULL) {
-      e = TAILQ_FIRST(&s_chrono_tsk_q);
+    while (n_ret < n) {
+      e = TAILQ_FIRST(&(sh->m_q));
       if (likely(e != NULL &&
                  e->m_next_abstime <= the_abstime)) {
-        TAILQ_REMOVE(&s_chrono_tsk_q, e, m_entry);
+        bool is_dead = false;
 
         s_lock_task(e);
         {
-          (void)s_set_task_state_in_table(e, TASK_STATE_DEQUEUED);
-          e->m_status = TASK_STATE_DEQUEUED;
-          e->m_is_in_timed_q = false;
+          if (likely(e->m_status != TASK_STATE_CANCELLED)) {
+            s_unlink_timed_task(sh, e);
+            (void)s_set_task_state_in_table(e, TASK_STATE_DEQUEUED);
+            e->m_status = TASK_STATE_DEQUEUED;
+            tasks[n_ret++] = e;
+          } else {
+            s_unlink_timed_task(sh, e);
+            is_dead = true;
+          }
         }
         s_unlock_task(e);
 
-        tasks[n_ret++] = e;
+        if (is_dead == true) {
+          TAILQ_INSERT_TAIL(&dead, e, m_entry);
+        }
       } else {
         break;
       }
     }
 
     if (likely(next_wakeup != NULL)) {
-      e = TAILQ_FIRST(&s_chrono_tsk_q);
+      e = TAILQ_FIRST(&(sh->m_q));
       if (e != NULL) {
         *next_wakeup = e->m_next_abstime;
       } else {
@@ -337,60 +462,53 @@ s_get_runnables(gallus_chrono_t base_abstime,
     }
 
   }
-  s_unlock_task_q();
-
-  return (gallus_result_t)n_ret;
-}
-
-
-static inline gallus_result_t
-s_get_runnable_timed_task_no_lock(gallus_chrono_t base_abstime,
-                                  gallus_callout_task_t *tasks, size_t n,
-                                  gallus_chrono_t *next_wakeup) {
-  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  s_unlock_shard(sh);
 
-  if (likely(base_abstime > 0LL &&
-             tasks != NULL && n > 0)) {
-    ret = s_get_runnables(base_abstime, tasks, n, next_wakeup);
+  if (unlikely(TAILQ_EMPTY(&dead) == false)) {
+    s_lock_global();
+    {
+      while ((e = TAILQ_FIRST(&dead)) != NULL) {
+        TAILQ_REMOVE(&dead, e, m_entry);
+        s_set_cancel_and_destroy_task_no_lock(e);
+      }
+    }
+    s_unlock_global();
   }
 
-  return ret;
+  return (gallus_result_t)n_ret;
 }
-             
+
 
 static inline gallus_result_t
-s_get_runnable_timed_task(gallus_chrono_t base_abstime,
+s_get_runnable_timed_task(callout_shard_t sh,
+                          gallus_chrono_t base_abstime,
                           gallus_callout_task_t *tasks, size_t n,
                           gallus_chrono_t *next_wakeup) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
 
   if (likely(base_abstime > 0LL &&
              tasks != NULL && n > 0)) {
-
-    s_lock_global();
-    {
-      ret = s_get_runnables(base_abstime, tasks, n, next_wakeup);
-    }
-    s_unlock_global();
-
+    ret = s_get_runnables(sh, base_abstime, tasks, n, next_wakeup);
   }
 
   return ret;
 }
-             
+
 
 static inline void
 s_destroy_all_queued_timed_tasks(void) {
   gallus_callout_task_t t;
+  size_t i;
 
   s_lock_global();
   {
 
-    while ((t = s_get_timed_task_no_lock()) != NULL) {
-      s_set_cancel_and_destroy_task_no_lock(t);
+    for (i = 0; i < s_n_shards; i++) {
+      while ((t = s_get_timed_task_no_lock(&(s_shards[i]))) != NULL) {
+        s_set_cancel_and_destroy_task_no_lock(t);
+      }
     }
 
   }
   s_unlock_global();
 }
-
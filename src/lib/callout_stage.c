@@ -78,14 +78,52 @@ s_callout_worker_fetch(const gallus_pipeline_stage_t *sptr,
 
   if (likely(sptr != NULL && *sptr != NULL)) {
     callout_stage_t cs = (callout_stage_t)*sptr;
+    gallus_callout_task_t *tasks = (gallus_callout_task_t *)evbuf;
     size_t n_puts = 0;
+    size_t n_timed = 0;
+    gallus_chrono_t to = CALLOUT_WORKER_MAX_WAIT;
+
+    if (likely(idx < s_n_shards)) {
+      /*
+       * Drain the due timed tasks of my shard first, then sleep until
+       * the next one is due unless anything is queued up.
+       */
+      gallus_chrono_t now;
+      gallus_chrono_t next_wakeup = -1LL;
+      gallus_result_t r;
+
+      s_owned_shard = (ssize_t)idx;
+
+      WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+      r = s_get_runnable_timed_task(&(s_shards[idx]), now, tasks, max_n_evs,
+                                    &next_wakeup);
+      if (r > 0) {
+        n_timed = (size_t)r;
+        s_prepare_tasks_for_exec(tasks, now, n_timed);
+        to = 0LL;
+      } else if (next_wakeup > 0LL && next_wakeup - now < to) {
+        to = next_wakeup - now;
+        if (to <= 0LL) {
+          to = 1LL;
+        }
+      }
+
+      if (n_timed == max_n_evs) {
+        return (gallus_result_t)n_timed;
+      }
+    }
 
     ret = gallus_bbq_get_n(&(cs->m_qs[idx]),
-                            (void **)evbuf,
-                            max_n_evs, 1,
+                            (void **)(tasks + n_timed),
+                            max_n_evs - n_timed, 1,
                             gallus_callout_task_t,
-                            1000LL * 1000LL * 1000LL, /* 1 sec. */
+                            to,
                             &n_puts);
+    if (n_timed > 0) {
+      return (ret > 0) ?
+          (gallus_result_t)n_timed + ret : (gallus_result_t)n_timed;
+    }
+
     switch (ret) {
       case GALLUS_RESULT_WAKEUP_REQUESTED: {
         ret = (gallus_result_t)n_puts;
@@ -135,7 +173,12 @@ s_callout_worker_main(const gallus_pipeline_stage_t *sptr,
 
     for (i = 0; i < n; i++) {
       t = tasks[i];
-      (void)s_exec_task(t);
+      /*
+       * A NULL is a kick to re-visit my shard, nothing to do here.
+       */
+      if (likely(t != NULL)) {
+        (void)s_exec_task(t);
+      }
     }
     ret = (gallus_result_t)n;
 
@@ -275,29 +318,8 @@ s_submit_callout_stage(const gallus_callout_task_t * const tasks,
   if (likely(s_cs.m_is_initialized == true)) {
     if (likely(tasks != NULL && n > 0)) {
       gallus_pipeline_stage_t s = (gallus_pipeline_stage_t)&s_cs;
-      size_t i;
-      gallus_callout_task_t t;
-
-      for (i = 0; i < n; i++) {
-        /*
-         * Change the state of tasks to TASK_STATE_DEQUEUED and set
-         * the last execution (start) time as now.
-         */
-
-        t = tasks[i];
 
-        s_lock_task(t);
-        {
-          if (t->m_status == TASK_STATE_ENQUEUED ||
-              t->m_status == TASK_STATE_CREATED) {
-            (void)s_set_task_state_in_table(t, TASK_STATE_DEQUEUED);
-            t->m_status = TASK_STATE_DEQUEUED;
-          }
-          t->m_last_abstime = start_time;
-        }
-        s_unlock_task(t);
-
-      }
+      s_prepare_tasks_for_exec(tasks, start_time, n);
 
       if (s_cs.m_n_workers == 1) {
         ret = gallus_pipeline_stage_submit(&s, (void *)tasks, n, (void *)0);
@@ -5,7 +5,7 @@
  * General lock order:
  *
  *	The global lock (s_lock_global)
- *	The timed task queue lock (s_lock_task_q)
+ *	A timed task shard lock (s_lock_shard)
  *	A task lock (s_lock_task)
  *
  * Note taht the task locks are recursive.
@@ -50,6 +50,16 @@ s_wakeup_task(gallus_callout_task_t t) {
 
 
 
+static inline gallus_hashmap_t *
+s_tbl_of(const gallus_callout_task_t t) {
+  uintptr_t h = (uintptr_t)t;
+
+  h = (h >> 4) ^ (h >> 12);
+
+  return &(s_tsk_tbls[h % CALLOUT_TASK_TABLE_STRIPES]);
+}
+
+
 static inline callout_task_state_t
 s_get_task_state_in_table(const gallus_callout_task_t t) {
   callout_task_state_t ret = TASK_STATE_UNKNOWN;
@@ -58,7 +68,7 @@ s_get_task_state_in_table(const gallus_callout_task_t t) {
     void *val;
     gallus_result_t r;
 
-    r = gallus_hashmap_find(&s_tsk_tbl, (void *)t, &val);
+    r = gallus_hashmap_find(s_tbl_of(t), (void *)t, &val);
     if (likely(r == GALLUS_RESULT_OK)) {
       ret = (callout_task_state_t)val;
     }
@@ -77,19 +87,19 @@ s_set_task_state_in_table(const gallus_callout_task_t t,
     void *val;
     gallus_result_t r;
 
-    if (likely((r = gallus_hashmap_find(&s_tsk_tbl, (void *)t, &val)) ==
+    if (likely((r = gallus_hashmap_find(s_tbl_of(t), (void *)t, &val)) ==
                GALLUS_RESULT_OK)) {
       ret = (callout_task_state_t)val;
       val = (void *)s;
 
-      if (unlikely((r = gallus_hashmap_add(&s_tsk_tbl, (void *)t,
+      if (unlikely((r = gallus_hashmap_add(s_tbl_of(t), (void *)t,
                                              &val, true)) !=
                    GALLUS_RESULT_OK)) {
         ret = TASK_STATE_UNKNOWN;
       }
     } else if (likely(r == GALLUS_RESULT_NOT_FOUND)) {
       val = (void *)s;
-      if (likely((r = gallus_hashmap_add(&s_tsk_tbl, (void *)t,
+      if (likely((r = gallus_hashmap_add(s_tbl_of(t), (void *)t,
                                           &val, true)) ==
                  GALLUS_RESULT_OK)) {
         ret = s;
@@ -104,7 +114,7 @@ s_set_task_state_in_table(const gallus_callout_task_t t,
 static inline void
 s_delete_task_in_table(const gallus_callout_task_t t) {
   if (likely(t != NULL)) {
-    (void)gallus_hashmap_delete(&s_tsk_tbl, (void *)t, NULL, true);
+    (void)gallus_hashmap_delete(s_tbl_of(t), (void *)t, NULL, true);
   }
 }
 
@@ -189,6 +199,7 @@ s_create_task(gallus_callout_task_t *tptr,
       (*tptr)->m_do_repeat = false;
       (*tptr)->m_is_first = true;
       (*tptr)->m_is_in_timed_q = false;
+      (*tptr)->m_is_claimed = false;
       (*tptr)->m_initial_delay_time = -1LL;
       (*tptr)->m_interval_time = -1LL;
       (*tptr)->m_last_abstime = 0;
@@ -247,7 +258,6 @@ s_delete(gallus_callout_task_t t) {
       }
       t->m_cancel_ref_count = 0;
       t->m_exec_ref_count = 0;
-      mbar();
       (void)gallus_cond_notify(&(t->m_cond), true);
     }
     s_unlock_task(t);
@@ -324,7 +334,8 @@ s_cancel(const gallus_callout_task_t t) {
     if (likely(st != TASK_STATE_UNKNOWN &&
                st != TASK_STATE_CANCELLED)) {
 
-      if (__sync_fetch_and_add(&(t->m_exec_ref_count), 0) != 0) {
+      if (gallus_atomic_load(&(t->m_exec_ref_count), SEQ_CST) != 0) {
+        bool can_delete = false;
 
         /*
          * The task is executing at this moment.
@@ -334,7 +345,7 @@ s_cancel(const gallus_callout_task_t t) {
          * Increment a # of canceller to notify the task executioner
          * that there is a canceller.
          */
-        (void)__sync_fetch_and_add(&(t->m_cancel_ref_count), 1);
+        (void)gallus_atomic_fetch_add(&(t->m_cancel_ref_count), 1, SEQ_CST);
 
         s_lock_task(t);
         {
@@ -343,68 +354,85 @@ s_cancel(const gallus_callout_task_t t) {
            * that we can wait that by using the CAS, but we prefer to
            * sleep with a cond.
            */
-          while (__sync_fetch_and_add(&(t->m_exec_ref_count), 0) != 0) {
+          while (gallus_atomic_load(&(t->m_exec_ref_count), SEQ_CST) != 0) {
             s_wait_task(t);
           }
+
+          if (t->m_status == TASK_STATE_DELETING) {
+            s_unlock_task(t);
+            return;
+          }
+          if (gallus_atomic_sub_fetch(&(t->m_cancel_ref_count), 1,
+                                      SEQ_CST) > 0) {
+            /*
+             * There are other threads which also want to cancel this
+             * task. Let the last one do that.
+             */
+          } else if (t->m_is_in_timed_q == true &&
+                     gallus_atomic_load(&s_do_loop, RELAXED) == true) {
+            /*
+             * The last one, and the task is re-armed meanwhile.
+             */
+            s_tombstone_timed_task(t);
+          } else if (t->m_status == TASK_STATE_DEQUEUED) {
+            /*
+             * The last one, and the task is re-armed and even fetched
+             * again meanwhile. Let the executioner delete this.
+             */
+            (void)s_set_task_state_in_table(t, TASK_STATE_CANCELLED);
+            t->m_status = TASK_STATE_CANCELLED;
+          } else {
+            /*
+             * The last one.
+             */
+            can_delete = true;
+          }
         }
         s_unlock_task(t);
 
-        if (t->m_status == TASK_STATE_DELETING) {
-          return;
-        }
-        if (__sync_sub_and_fetch(&(t->m_cancel_ref_count), 1) > 0) {
-          /*
-           * There are other threads which also want to cancel this task.
-           * Let the last one do that.
-           */
-          return;
-        } else {
-          /*
-           * The last one.
-           */
+        if (can_delete == true) {
           s_set_cancel_and_destroy_task_no_lock(t);
         }
 
       } else {
+        bool can_delete = false;
 
-        if (st == TASK_STATE_ENQUEUED) {
-          bool can_delete = false;
-
-          s_lock_task(t);
-          {
-            if (t->m_is_in_timed_q == true) {
+        /*
+         * The st could be stale since the task could be executed and
+         * re-armed meanwhile. Decide by the task status.
+         */
+        s_lock_task(t);
+        {
+          if (t->m_is_in_timed_q == true) {
+            if (gallus_atomic_load(&s_do_loop, RELAXED) == true) {
               /*
-               * If it is in the timed task Q, it is deletable safely.
+               * Just leave a tombstone, the owner of the shard
+               * reclaims it.
                */
-              can_delete = true;
+              s_tombstone_timed_task(t);
             } else {
               /*
-               * Set cancel flag.
+               * Nobody drains the timed task Q, it is deletable
+               * safely.
                */
-              (void)s_set_task_state_in_table(t, TASK_STATE_CANCELLED);
-              t->m_status = TASK_STATE_CANCELLED;
+              can_delete = true;
             }
-          }
-          s_unlock_task(t);
-
-          if (can_delete == true) {
-            s_set_cancel_and_destroy_task_no_lock(t);
-          }
-
-        } else if (st == TASK_STATE_DEQUEUED) {
-          /*
-           * The task is about to execute. Just set the cancel flag
-           * and let the callout task worker/main scheduler delete
-           * this.
-           */
-
-          s_lock_task(t);
-          {
+          } else if (t->m_status == TASK_STATE_ENQUEUED ||
+                     t->m_status == TASK_STATE_DEQUEUED ||
+                     t->m_status == TASK_STATE_EXECUTING) {
+            /*
+             * The task is in the urgent/idle Q, about to execute or
+             * executing. Just set the cancel flag and let the
+             * callout task worker/main scheduler delete this.
+             */
             (void)s_set_task_state_in_table(t, TASK_STATE_CANCELLED);
             t->m_status = TASK_STATE_CANCELLED;
           }
-          s_unlock_task(t);
-          
+        }
+        s_unlock_task(t);
+
+        if (can_delete == true) {
+          s_set_cancel_and_destroy_task_no_lock(t);
         }
 
       }
@@ -438,6 +466,34 @@ s_cancel_task(gallus_callout_task_t t) {
 
 
 
+/*
+ * Change the state of tasks to TASK_STATE_DEQUEUED and set the last
+ * execution (start) time.
+ */
+static inline void
+s_prepare_tasks_for_exec(const gallus_callout_task_t * const tasks,
+                         gallus_chrono_t start_time,
+                         size_t n) {
+  gallus_callout_task_t t;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    t = tasks[i];
+
+    s_lock_task(t);
+    {
+      if (t->m_status == TASK_STATE_ENQUEUED ||
+          t->m_status == TASK_STATE_CREATED) {
+        (void)s_set_task_state_in_table(t, TASK_STATE_DEQUEUED);
+        t->m_status = TASK_STATE_DEQUEUED;
+      }
+      t->m_last_abstime = start_time;
+    }
+    s_unlock_task(t);
+  }
+}
+
+
 static inline gallus_result_t
 s_exec_task(gallus_callout_task_t t) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
@@ -453,7 +509,8 @@ s_exec_task(gallus_callout_task_t t) {
       /*
        * Check the t->m_exec_ref_count FIRST.
        */
-      size_t is_execing = __sync_fetch_and_add(&(t->m_exec_ref_count), 1);
+      size_t is_execing =
+        gallus_atomic_fetch_add(&(t->m_exec_ref_count), 1, SEQ_CST);
 
       if (likely(is_execing == 0)) {
         gallus_runnable_t r = (gallus_runnable_t)t;
@@ -525,18 +582,24 @@ s_exec_task(gallus_callout_task_t t) {
           /*
            * The execution succeeded.
            */
-          if (__sync_fetch_and_add(&(t->m_cancel_ref_count), 0) == 0) {
+          if (gallus_atomic_load(&(t->m_cancel_ref_count), SEQ_CST) == 0) {
 
             if (t->m_do_repeat == true) {
               /*
-               * Use the global-locked version of the scheduler to make
-               * the task submisson/fetch atomic. So we must not have
-               * the task lock here, in order to keep the lock order,
-               * which locks the global first then locks the task.
+               * Back to the shard the task came from. We must not
+               * have the task lock here, in order to keep the lock
+               * order, which locks the shard first then locks the
+               * task.
                */
               ret = s_schedule_timed_task(t);
               if (likely(ret >= 0)) {
                 ret = GALLUS_RESULT_OK;
+              } else if (t->m_status == TASK_STATE_CANCELLED) {
+                /*
+                 * Cancelled while executing. Don't re-arm.
+                 */
+                ret = GALLUS_RESULT_OK;
+                do_delete = true;
               } else {
                 /*
                  * Make this task to be deleted.
@@ -572,11 +635,24 @@ s_exec_task(gallus_callout_task_t t) {
       }
 
       if (likely(do_delete == false)) {
-        (void)__sync_fetch_and_sub(&(t->m_exec_ref_count), 1);
+        /*
+         * A canceller could come after the re-arm. Decrement under the
+         * task lock so that it can't take the task away before we
+         * leave, and wake it up.
+         */
+        s_lock_task(t);
+        {
+          (void)gallus_atomic_fetch_sub(&(t->m_exec_ref_count), 1, SEQ_CST);
+          if (unlikely(gallus_atomic_load(&(t->m_cancel_ref_count), SEQ_CST) !=
+                       0)) {
+            s_wakeup_task(t);
+          }
+        }
+        s_unlock_task(t);
       } else {
-        if (__sync_fetch_and_add(&(t->m_cancel_ref_count), 0) == 0) {
+        if (gallus_atomic_load(&(t->m_cancel_ref_count), SEQ_CST) == 0) {
 
-          (void)__sync_fetch_and_sub(&(t->m_exec_ref_count), 1);
+          (void)gallus_atomic_fetch_sub(&(t->m_exec_ref_count), 1, SEQ_CST);
 
           /*
            * Delete the task. Don't change the return value anymore.
@@ -598,7 +674,7 @@ s_exec_task(gallus_callout_task_t t) {
 
           s_lock_task(t);
           {
-            (void)__sync_fetch_and_sub(&(t->m_exec_ref_count), 1);
+            (void)gallus_atomic_fetch_sub(&(t->m_exec_ref_count), 1, SEQ_CST);
             s_wakeup_task(t);
           }
           s_unlock_task(t);
@@ -674,48 +750,85 @@ s_submit_task(gallus_callout_task_t t,
     if (likely(interval >= CALLOUT_TASK_MIN_INTERVAL ||
                interval == 0LL)) {
 
-      s_lock_global();
+      s_lock_task(t);
       {
+        /*
+         * Recheck under the lock, a batch submission may have claimed
+         * or queued the task meanwhile.
+         */
+        if (likely(t->m_is_claimed == false &&
+                   s_get_task_state_in_table(t) == TASK_STATE_CREATED)) {
+          t->m_is_claimed = true;
+          t->m_initial_delay_time = initial_delay;
+          if (interval > 0LL) {
+            t->m_interval_time = interval;
+            t->m_do_repeat = true;
+          }
+          /*
+           * The task stays in this shard for all its lifetime.
+           */
+          if (t->m_is_in_timed_q == false) {
+            t->m_shard = s_pick_shard();
+          }
+          ret = GALLUS_RESULT_OK;
+        } else {
+          ret = GALLUS_RESULT_INVALID_STATE_TRANSITION;
+        }
+      }
+      s_unlock_task(t);
+
+      if (unlikely(ret != GALLUS_RESULT_OK)) {
+        goto done;
+      }
 
+      if (likely(initial_delay > 0LL)) {
         /*
-         * Acquire the global lock to make the task submisson/fetch
-         * atomic.
+         * A timed task. The shard lock makes the task
+         * submisson/fetch atomic.
          */
+        if (likely(s_schedule_timed_task(t) > 0)) {
+          ret = GALLUS_RESULT_OK;
+        } else {
+          ret = GALLUS_RESULT_ANY_FAILURES;
+        }
 
-        s_lock_task_q();
+        s_lock_task(t);
         {
-          s_lock_task(t);
-          {
-            t->m_initial_delay_time = initial_delay;
-            if (interval > 0LL) {
-              t->m_interval_time = interval;
-              t->m_do_repeat = true;
-            }
+          t->m_is_claimed = false;
+        }
+        s_unlock_task(t);
+      } else {
+        /*
+         * An urgent task, or an idle task.
+         */
+        gallus_bbq_t *q = (initial_delay == 0LL) ?
+            &s_urgent_tsk_q : &s_idle_tsk_q;
 
-            if (likely(initial_delay == 0LL)) {
-              /*
-               * An urgent task.
-               */
-              ret = gallus_bbq_put(&s_urgent_tsk_q, (void **)&tt,
-                                    gallus_callout_task_t, -1LL);
-            } else if (likely(initial_delay > 0LL)) {
-              /*
-               * A timed task.
-               */
-              if (likely(s_schedule_timed_task_no_lock(t) > 0)) {
-                ret = GALLUS_RESULT_OK;
-              } else {
-                ret = GALLUS_RESULT_ANY_FAILURES;
-              }
-            } else {
-              /*
-               * An idle task.
-               */
-              ret = gallus_bbq_put(&s_idle_tsk_q, (void **)&tt,
-                                    gallus_callout_task_t, -1LL);
+        s_lock_global();
+        {
+
+          /*
+           * Acquire the global lock to make the task submisson/fetch
+           * atomic. Don't block on a full Q with the lock held, the
+           * master needs it to drain the Q.
+           */
+
+          while ((ret = gallus_bbq_put_n(q, (void **)&tt, 1,
+                                          gallus_callout_task_t, 0LL,
+                                          NULL)) == 0) {
+            s_unlock_global();
+            {
+              ret = gallus_bbq_wait_puttable(q, 100LL * 1000LL * 1000LL);
+            }
+            s_lock_global();
+            if (unlikely(ret < 0 && ret != GALLUS_RESULT_TIMEDOUT)) {
+              break;
             }
+          }
 
-            if (ret == GALLUS_RESULT_OK && t->m_is_in_timed_q == false) {
+          s_lock_task(t);
+          {
+            if (ret == 1) {
               /*
                * For the tasks except the timed ones, set the task state
                * to TASK_STATE_ENQUEUED.
@@ -723,11 +836,223 @@ s_submit_task(gallus_callout_task_t t,
               (void)s_set_task_state_in_table(t, TASK_STATE_ENQUEUED);
               t->m_status = TASK_STATE_ENQUEUED;
               t->m_is_in_bbq = true;
+              ret = GALLUS_RESULT_OK;
             }
+            t->m_is_claimed = false;
           }
           s_unlock_task(t);
+
+        }
+        s_unlock_global();
+
+      }
+
+    } else {
+      ret = GALLUS_RESULT_TOO_SMALL;
+    }
+
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+done:
+  return ret;
+}
+
+
+/*
+ * The task must be locked.
+ */
+static inline void
+s_set_submit_params(gallus_callout_task_t t, size_t shard,
+                    gallus_chrono_t initial_delay,
+                    gallus_chrono_t interval) {
+  t->m_initial_delay_time = initial_delay;
+  if (interval > 0LL) {
+    t->m_interval_time = interval;
+    t->m_do_repeat = true;
+  }
+  if (t->m_is_in_timed_q == false) {
+    t->m_shard = shard;
+  }
+}
+
+
+static inline void
+s_unclaim_tasks(const gallus_callout_task_t * const tasks, size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    s_lock_task(tasks[i]);
+    {
+      tasks[i]->m_is_claimed = false;
+    }
+    s_unlock_task(tasks[i]);
+  }
+}
+
+
+/*
+ * Claim a batch as a whole before any of it is queued: no NULL, no
+ * duplicate, all freshly created and not claimed by another
+ * submitter. On a failure nothing stays claimed. The global lock must
+ * be held.
+ */
+static inline gallus_result_t
+s_claim_tasks_no_lock(const gallus_callout_task_t * const tasks, size_t n) {
+  gallus_result_t ret = GALLUS_RESULT_OK;
+  callout_task_state_t st;
+  gallus_callout_task_t t;
+  size_t i;
+  size_t j;
+
+  for (i = 0; i < n && ret == GALLUS_RESULT_OK; i++) {
+    if (unlikely((t = tasks[i]) == NULL)) {
+      ret = GALLUS_RESULT_INVALID_ARGS;
+      break;
+    }
+
+    s_lock_task(t);
+    {
+      if (unlikely((st = s_get_task_state_in_table(t)) !=
+                   TASK_STATE_CREATED)) {
+        ret = (st == TASK_STATE_UNKNOWN) ?
+            GALLUS_RESULT_INVALID_OBJECT :
+            GALLUS_RESULT_INVALID_STATE_TRANSITION;
+      } else if (unlikely(t->m_is_claimed == true)) {
+        /*
+         * Either a duplicate or being submitted by someone else.
+         */
+        ret = GALLUS_RESULT_INVALID_STATE_TRANSITION;
+        for (j = 0; j < i; j++) {
+          if (tasks[j] == t) {
+            ret = GALLUS_RESULT_INVALID_ARGS;
+            break;
+          }
+        }
+      } else {
+        t->m_is_claimed = true;
+      }
+    }
+    s_unlock_task(t);
+
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      break;
+    }
+  }
+
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    s_unclaim_tasks(tasks, i);
+  }
+
+  return ret;
+}
+
+
+/*
+ * Put the claimed tasks into a Q, as many as it has room for. The
+ * params are set, and the claims dropped, only for the tasks put. The
+ * global lock must be held.
+ */
+static inline gallus_result_t
+s_put_tasks_no_lock(gallus_bbq_t *q,
+                    const gallus_callout_task_t * const tasks, size_t n,
+                    size_t shard,
+                    gallus_chrono_t initial_delay,
+                    gallus_chrono_t interval) {
+  gallus_result_t ret;
+  gallus_callout_task_t t;
+  size_t n_puts = 0;
+  size_t i;
+
+  ret = gallus_bbq_put_n(q, (void **)tasks, n,
+                          gallus_callout_task_t, 0LL, &n_puts);
+  if (likely(ret >= 0)) {
+    n_puts = (size_t)ret;
+  }
+
+  for (i = 0; i < n_puts; i++) {
+    t = tasks[i];
+
+    s_lock_task(t);
+    {
+      s_set_submit_params(t, shard, initial_delay, interval);
+      (void)s_set_task_state_in_table(t, TASK_STATE_ENQUEUED);
+      t->m_status = TASK_STATE_ENQUEUED;
+      t->m_is_in_bbq = true;
+      t->m_is_claimed = false;
+    }
+    s_unlock_task(t);
+  }
+
+  return (ret >= 0) ? (gallus_result_t)n_puts : ret;
+}
+
+
+/*
+ * Submit a batch, all or nothing. The tasks are claimed first so
+ * that no one else can submit them until they are queued. The timed
+ * ones go to a shard at once. The others go to a Q as it has room,
+ * releasing the global lock while waiting for the room since the
+ * master needs the lock to drain the Q; so a batch larger than the Q
+ * is queued in chunks.
+ */
+static inline gallus_result_t
+s_submit_tasks(const gallus_callout_task_t * const tasks, size_t n,
+               gallus_chrono_t initial_delay,
+               gallus_chrono_t interval) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(tasks != NULL && n > 0)) {
+
+    if (likely(interval >= CALLOUT_TASK_MIN_INTERVAL ||
+               interval == 0LL)) {
+      size_t shard = s_pick_shard();
+
+      s_lock_global();
+      {
+        ret = s_claim_tasks_no_lock(tasks, n);
+
+        if (likely(ret == GALLUS_RESULT_OK)) {
+
+          if (likely(initial_delay > 0LL)) {
+            ret = s_schedule_timed_tasks(tasks, n, shard,
+                                         initial_delay, interval);
+            s_unclaim_tasks(tasks, n);
+          } else {
+            gallus_bbq_t *q = (initial_delay == 0LL) ?
+                &s_urgent_tsk_q : &s_idle_tsk_q;
+            size_t n_done = 0;
+
+            while (n_done < n) {
+              ret = s_put_tasks_no_lock(q, tasks + n_done, n - n_done,
+                                        shard, initial_delay, interval);
+              if (unlikely(ret < 0)) {
+                break;
+              }
+              n_done += (size_t)ret;
+
+              if (n_done < n) {
+                s_unlock_global();
+                {
+                  ret = gallus_bbq_wait_puttable(q, 100LL * 1000LL * 1000LL);
+                }
+                s_lock_global();
+                if (unlikely(ret < 0 && ret != GALLUS_RESULT_TIMEDOUT)) {
+                  break;
+                }
+              }
+            }
+
+            if (unlikely(n_done < n)) {
+              s_unclaim_tasks(tasks + n_done, n - n_done);
+            }
+            if (likely(n_done > 0)) {
+              ret = (gallus_result_t)n_done;
+            }
+          }
+
         }
-        s_unlock_task_q();
       }
       s_unlock_global();
 
@@ -763,7 +1088,7 @@ s_force_schedule_task(gallus_callout_task_t t) {
       st = s_get_task_state_in_table(t);
       if (likely(st == TASK_STATE_CREATED ||
                  st == TASK_STATE_ENQUEUED)) {
-        if (likely(__sync_fetch_and_add(&(t->m_exec_ref_count), 0) == 0)) {
+        if (likely(gallus_atomic_load(&(t->m_exec_ref_count), SEQ_CST) == 0)) {
 
           s_lock_task(t);
           {
@@ -17,13 +17,16 @@ typedef struct gallus_cbuffer_record {
   gallus_cond_t m_cond_get;
   gallus_cond_t m_cond_awakened;
 
-  volatile int64_t m_r_idx;
-  volatile int64_t m_w_idx;
-  volatile int64_t m_n_elements;
-  volatile size_t m_n_waiters;
+  /*
+   * Accessed only with the m_lock held, the mutex orders them.
+   */
+  int64_t m_r_idx;
+  int64_t m_w_idx;
+  int64_t m_n_elements;
+  size_t m_n_waiters;
 
-  volatile bool m_is_operational;
-  volatile bool m_is_awakened;
+  bool m_is_operational;
+  bool m_is_awakened;
 
   gallus_cbuffer_value_freeup_proc_t m_del_proc;
 
@@ -35,6 +38,8 @@ typedef struct gallus_cbuffer_record {
   gallus_qmuxer_t m_qmuxer;
   gallus_qmuxer_poll_event_t m_type;
 
+  int m_cpu;			/* >= 0: by gallus_malloc_on_cpu(). */
+
   char m_data[0];
 } gallus_cbuffer_record;
 
@@ -246,9 +251,9 @@ s_wait_io_ready(gallus_cbuffer_t cb,
       gallus_msg_debug(500, "wait " PF64(d) " nsec.\n",
                         nsec);
 
-      (void)__sync_fetch_and_add(&(cb->m_n_waiters), 1);
+      cb->m_n_waiters++;
       ret = gallus_cond_wait(cptr, &(cb->m_lock), nsec);
-      n_waiters = __sync_sub_and_fetch(&(cb->m_n_waiters), 1);
+      n_waiters = --(cb->m_n_waiters);
 
       if (cb->m_is_awakened == true) {
         gallus_msg_debug(5, "awakened while sleeping " PF64(d) " nsec.\n",
@@ -352,7 +357,6 @@ s_put_n(gallus_cbuffer_t *cbptr,
            * Repeat putting until all the data are put.
            */
         check_inf:
-          mbar();
           if (cb->m_is_operational == true) {
             n_copyin += s_copyin(cb,
                                  (void *)((char *)valptr +
@@ -416,7 +420,6 @@ s_put_n(gallus_cbuffer_t *cbptr,
           gallus_chrono_t to = nsec;
 
         check_to:
-          mbar();
           if (cb->m_is_operational == true) {
             WHAT_TIME_IS_IT_NOW_IN_NSEC(copy_start);
             n_copyin += s_copyin(cb,
@@ -532,7 +535,6 @@ s_get_n(gallus_cbuffer_t *cbptr,
            * Repeat getting until all the required # of the data are got.
            */
         check_inf:
-          mbar();
           if (cb->m_is_operational == true) {
             n_copyout += s_copyout(cb,
                                    (void *)((char *)valptr +
@@ -597,7 +599,6 @@ s_get_n(gallus_cbuffer_t *cbptr,
           gallus_chrono_t to = nsec;
 
         check_to:
-          mbar();
           if (cb->m_is_operational == true) {
             WHAT_TIME_IS_IT_NOW_IN_NSEC(copy_start);
             n_copyout += s_copyout(cb,
@@ -671,18 +672,32 @@ s_get_n(gallus_cbuffer_t *cbptr,
 
 
 
-gallus_result_t
-gallus_cbuffer_create_with_size(gallus_cbuffer_t *cbptr,
-                                 size_t elemsize,
-                                 int64_t maxelems,
-                                 gallus_cbuffer_value_freeup_proc_t proc) {
+static inline void
+s_free(gallus_cbuffer_t cb) {
+  if (cb->m_cpu >= 0) {
+    gallus_free_on_cpu((void *)cb);
+  } else {
+    GALLUS_FREE(CBUFFER, cb);
+  }
+}
+
+
+static inline gallus_result_t
+s_create(gallus_cbuffer_t *cbptr,
+         size_t elemsize,
+         int64_t maxelems,
+         gallus_cbuffer_value_freeup_proc_t proc,
+         int cpu) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
 
   if (cbptr != NULL &&
       elemsize > 0 &&
       maxelems > 0) {
-    gallus_cbuffer_t cb = (gallus_cbuffer_t)malloc(
-                             sizeof(*cb) + elemsize * (size_t)(maxelems + N_EMPTY_ROOM));
+    size_t sz = sizeof(gallus_cbuffer_record) +
+                elemsize * (size_t)(maxelems + N_EMPTY_ROOM);
+    gallus_cbuffer_t cb = (gallus_cbuffer_t)
+                          ((cpu >= 0) ? gallus_malloc_on_cpu(sz, cpu) :
+                           GALLUS_MALLOC(CBUFFER, sz));
 
     *cbptr = NULL;
 
@@ -707,13 +722,15 @@ gallus_cbuffer_create_with_size(gallus_cbuffer_t *cbptr,
         cb->m_is_awakened = false;
         cb->m_qmuxer = NULL;
         cb->m_type = GALLUS_QMUXER_POLL_UNKNOWN;
+        cb->m_cpu = cpu;
 
         *cbptr = cb;
 
         ret = GALLUS_RESULT_OK;
 
       } else {
-        free((void *)cb);
+        cb->m_cpu = cpu;
+        s_free(cb);
       }
     } else {
       ret = GALLUS_RESULT_NO_MEMORY;
@@ -726,6 +743,25 @@ gallus_cbuffer_create_with_size(gallus_cbuffer_t *cbptr,
 }
 
 
+gallus_result_t
+gallus_cbuffer_create_with_size(gallus_cbuffer_t *cbptr,
+                                 size_t elemsize,
+                                 int64_t maxelems,
+                                 gallus_cbuffer_value_freeup_proc_t proc) {
+  return s_create(cbptr, elemsize, maxelems, proc, -1);
+}
+
+
+gallus_result_t
+gallus_cbuffer_create_on_cpu(gallus_cbuffer_t *cbptr,
+                             size_t elemsize,
+                             int64_t maxelems,
+                             gallus_cbuffer_value_freeup_proc_t proc,
+                             int cpu) {
+  return s_create(cbptr, elemsize, maxelems, proc, (cpu >= 0) ? cpu : -1);
+}
+
+
 void
 gallus_cbuffer_shutdown(gallus_cbuffer_t *cbptr,
                          bool free_values) {
@@ -759,7 +795,7 @@ gallus_cbuffer_destroy(gallus_cbuffer_t *cbptr,
 
     gallus_mutex_destroy(&((*cbptr)->m_lock));
 
-    free((void *)*cbptr);
+    s_free(*cbptr);
     *cbptr = NULL;
   }
 }
@@ -804,7 +840,7 @@ gallus_cbuffer_wakeup(gallus_cbuffer_t *cbptr, gallus_chrono_t nsec) {
 
     s_lock(*cbptr);
     {
-      n_waiters = __sync_fetch_and_add(&((*cbptr)->m_n_waiters), 0);
+      n_waiters = (*cbptr)->m_n_waiters;
 
       if (n_waiters > 0) {
         if ((*cbptr)->m_is_operational == true) {
@@ -821,7 +857,6 @@ gallus_cbuffer_wakeup(gallus_cbuffer_t *cbptr, gallus_chrono_t nsec) {
                * Then wait for one of the waiters wakes this thread up.
                */
            recheck:
-              mbar();
               if ((*cbptr)->m_is_operational == true) {
                 if ((*cbptr)->m_is_awakened == true) {
 
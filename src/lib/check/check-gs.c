@@ -0,0 +1,127 @@
+#include "gallus_apis.h"
+
+
+
+
+
+/*
+ * The global state wakeup latency: N threads wait for the shutdown
+ * request, one requests it and each waiter records how long it took
+ * to wake up.
+ */
+
+
+
+
+
+#define MAX_WAITERS	1024
+
+
+
+
+
+static gallus_chrono_t s_req_time = 0;
+static gallus_chrono_t s_wake_time[MAX_WAITERS];
+static pthread_barrier_t s_barrier;
+
+
+
+
+
+static void *
+s_waiter_main(void *arg) {
+  size_t idx = (size_t)arg;
+  shutdown_grace_level_t l;
+  gallus_result_t r;
+
+  (void)pthread_barrier_wait(&s_barrier);
+
+  /*
+   * A long timeout, the waiter must be woken up by the request, not
+   * by the timeout.
+   */
+  while ((r = global_state_wait_for_shutdown_request(&l,
+              1000LL * 1000LL * 1000LL * 10LL)) ==
+         GALLUS_RESULT_TIMEDOUT) {
+    ;
+  }
+  WHAT_TIME_IS_IT_NOW_IN_NSEC(s_wake_time[idx]);
+  if (r != GALLUS_RESULT_OK) {
+    gallus_perror(r);
+  }
+
+  return NULL;
+}
+
+
+static void *
+s_acceptor_main(void *arg) {
+  (void)arg;
+
+  (void)global_state_wait_for_shutdown_request(NULL, -1LL);
+  (void)global_state_set(GLOBAL_STATE_ACCEPT_SHUTDOWN);
+
+  return NULL;
+}
+
+
+
+
+
+int
+main(int argc, const char * const argv[]) {
+  size_t n_waiters = 16;
+  pthread_t tids[MAX_WAITERS];
+  pthread_t acceptor;
+  gallus_chrono_t t_accept;
+  gallus_chrono_t max = 0;
+  gallus_chrono_t sum = 0;
+  size_t i;
+
+  (void)argc;
+
+  if (IS_VALID_STRING(argv[1]) == true) {
+    size_t tmp = 16;
+    gallus_result_t r = gallus_str_parse_uint64(argv[1], &tmp);
+    if (r == GALLUS_RESULT_OK && tmp > 0 && tmp <= MAX_WAITERS) {
+      n_waiters = tmp;
+    }
+  }
+
+  (void)global_state_set(GLOBAL_STATE_STARTED);
+
+  (void)pthread_barrier_init(&s_barrier, NULL, (unsigned)n_waiters + 1);
+  for (i = 0; i < n_waiters; i++) {
+    (void)pthread_create(&tids[i], NULL, s_waiter_main, (void *)i);
+  }
+  (void)pthread_create(&acceptor, NULL, s_acceptor_main, NULL);
+  (void)pthread_barrier_wait(&s_barrier);
+
+  /*
+   * Let them all sleep.
+   */
+  usleep(200000);
+
+  WHAT_TIME_IS_IT_NOW_IN_NSEC(s_req_time);
+  (void)global_state_request_shutdown(SHUTDOWN_GRACEFULLY);
+  WHAT_TIME_IS_IT_NOW_IN_NSEC(t_accept);
+
+  (void)pthread_join(acceptor, NULL);
+  for (i = 0; i < n_waiters; i++) {
+    (void)pthread_join(tids[i], NULL);
+    if (s_wake_time[i] - s_req_time > max) {
+      max = s_wake_time[i] - s_req_time;
+    }
+    sum += s_wake_time[i] - s_req_time;
+  }
+  (void)pthread_barrier_destroy(&s_barrier);
+
+  fprintf(stdout, "waiters:\t" PFSZ(u) "\n", n_waiters);
+  fprintf(stdout, "accept:\t%20.6f msec\n",
+          (double)(t_accept - s_req_time) / 1000000.0);
+  fprintf(stdout, "wake(avg):\t%20.6f msec\n",
+          (double)sum / (double)n_waiters / 1000000.0);
+  fprintf(stdout, "wake(max):\t%20.6f msec\n", (double)max / 1000000.0);
+
+  return 0;
+}
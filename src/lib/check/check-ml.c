@@ -4,6 +4,7 @@
 int
 main(int argc, const char * const argv[]) {
   size_t n_workers = 1;
+  gallus_chrono_t t0, t1, t2;
 
   if (IS_VALID_STRING(argv[1]) == true) {
     size_t tmp = 1;
@@ -16,8 +17,24 @@ main(int argc, const char * const argv[]) {
   (void)gallus_mainloop_set_callout_workers_number(n_workers);
   (void)gallus_mainloop_with_callout(argc, argv, NULL, NULL,
                                     false, false, true);
+  (void)global_state_wait_for(GLOBAL_STATE_STARTED, NULL, NULL, -1LL);
+  /*
+   * Let the callout main loop go to sleep.
+   */
+  usleep(300000);
+
+  /*
+   * The shutdown latency, the request to the acceptance by the
+   * callout idle proc and to the main loop thread exit.
+   */
+  WHAT_TIME_IS_IT_NOW_IN_NSEC(t0);
   (void)global_state_request_shutdown(SHUTDOWN_GRACEFULLY);
+  WHAT_TIME_IS_IT_NOW_IN_NSEC(t1);
   gallus_mainloop_wait_thread();
+  WHAT_TIME_IS_IT_NOW_IN_NSEC(t2);
+
+  fprintf(stdout, "accept:\t%20.6f msec\n", (double)(t1 - t0) / 1000000.0);
+  fprintf(stdout, "exit:\t%20.6f msec\n", (double)(t2 - t0) / 1000000.0);
 
   return 0;
 }
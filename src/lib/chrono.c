@@ -1,17 +1,263 @@
 #include "gallus_apis.h"
+#if defined(GALLUS_CPU_X86_64) && defined(__GNUC__)
+#include <cpuid.h>
+#define USE_TSC
+#endif /* GALLUS_CPU_X86_64 && __GNUC__ */
+
+
+
+
+
+/*
+ * The TSC is converted to the CLOCK_MONOTONIC nsec as:
+ *
+ *	now = m_ns0 + (((tsc - m_tsc0) * m_mult) >> TSC_SHIFT)
+ *
+ * The first caller after every TSC_RECAL_NSEC re-anchors the
+ * conversion and slews the m_mult to absorb the drift against the
+ * CLOCK_MONOTONIC, so that the clock never goes back.
+ */
+#define TSC_SHIFT		24
+#define TSC_CALIB_NSEC		(2LL * 1000LL * 1000LL)
+#define TSC_RECAL_NSEC		(500LL * 1000LL * 1000LL)
+#define TSC_MAX_SLEW		1000LL	/* 1 / 1000 of the period. */
+
+
+typedef struct {
+  uint64_t m_tsc0;
+  gallus_chrono_t m_ns0;
+  uint64_t m_mult;
+  uint64_t m_recal_ticks;
+} tsc_conv_t;
+
+
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+static bool s_use_tsc = false;
+
+static volatile uint64_t s_seq = 0;
+static volatile bool s_is_recalibrating = false;
+static tsc_conv_t s_conv;
+static uint64_t s_tsc_origin = 0;
+static gallus_chrono_t s_ns_origin = 0;
 
 
 
 
 
+static inline gallus_chrono_t
+s_mono_now(void) {
+  gallus_chrono_t ret;
+  WHAT_TIME_IS_IT_NOW_MONOTONIC_IN_NSEC(ret);
+  return ret;
+}
+
+
+#ifdef USE_TSC
+static inline bool
+s_is_tsc_invariant(void) {
+  unsigned int eax, ebx, ecx, edx;
+
+  if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 ||
+      eax < 0x80000007) {
+    return false;
+  }
+  if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+    return false;
+  }
+
+  return ((edx & (1U << 8)) != 0) ? true : false;
+}
+
+
+static inline uint64_t
+s_ticks_to_nsec(uint64_t ticks, uint64_t mult) {
+  return (uint64_t)(((unsigned __int128)ticks * mult) >> TSC_SHIFT);
+}
+
+
+static inline uint64_t
+s_nsec_to_mult(gallus_chrono_t nsec, uint64_t ticks) {
+  return (uint64_t)(((unsigned __int128)nsec << TSC_SHIFT) / ticks);
+}
+
+
+static inline uint64_t
+s_nsec_to_ticks(gallus_chrono_t nsec, uint64_t mult) {
+  return (uint64_t)(((unsigned __int128)nsec << TSC_SHIFT) / mult);
+}
+
+
+static void
+s_recalibrate(uint64_t t) {
+  gallus_chrono_t mono = s_mono_now();
+  gallus_chrono_t cur = s_conv.m_ns0 +
+                        (gallus_chrono_t)s_ticks_to_nsec(t - s_conv.m_tsc0,
+                            s_conv.m_mult);
+  /*
+   * The rate is taken over the whole lifetime, the offset is slewed
+   * in within the next period.
+   */
+  uint64_t mult = s_nsec_to_mult(mono - s_ns_origin, t - s_tsc_origin);
+  uint64_t recal_ticks = s_nsec_to_ticks(TSC_RECAL_NSEC, mult);
+  gallus_chrono_t max_slew = TSC_RECAL_NSEC / TSC_MAX_SLEW;
+  gallus_chrono_t err = mono - cur;
+
+  if (err > max_slew * 10) {
+    /*
+     * Too far behind, just jump forward.
+     */
+    cur = mono;
+    err = 0;
+  } else if (err > max_slew) {
+    err = max_slew;
+  } else if (err < -max_slew) {
+    err = -max_slew;
+  }
+  if (recal_ticks == 0) {
+    recal_ticks = 1;
+  }
+
+  s_seq++;
+  mbar();
+  {
+    s_conv.m_tsc0 = t;
+    s_conv.m_ns0 = cur;
+    s_conv.m_mult = s_nsec_to_mult(TSC_RECAL_NSEC + err, recal_ticks);
+    s_conv.m_recal_ticks = recal_ticks;
+  }
+  mbar();
+  s_seq++;
+}
+
+
+static inline gallus_chrono_t
+s_tsc_now(void) {
+  tsc_conv_t c;
+  uint64_t seq;
+  uint64_t t;
+
+  do {
+    seq = s_seq;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    c = s_conv;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((seq & 1) != 0 || seq != s_seq);
+
+  t = gallus_rdtsc();
+  if (unlikely(t < c.m_tsc0)) {
+    /*
+     * Read on a CPU slightly behind the one re-anchored.
+     */
+    t = c.m_tsc0;
+  } else if (unlikely(t - c.m_tsc0 >= c.m_recal_ticks)) {
+    if (__sync_bool_compare_and_swap(&s_is_recalibrating, false, true)) {
+      s_recalibrate(t);
+      mbar();
+      s_is_recalibrating = false;
+      return s_conv.m_ns0;
+    }
+    /*
+     * Someone else is re-anchoring, extrapolate meanwhile.
+     */
+  }
+
+  return c.m_ns0 + (gallus_chrono_t)s_ticks_to_nsec(t - c.m_tsc0, c.m_mult);
+}
+#endif /* USE_TSC */
+
+
+static void
+s_once_proc(void) {
+#ifdef USE_TSC
+  if (s_is_tsc_invariant() == true) {
+    uint64_t t0, t1;
+    gallus_chrono_t n0, n1;
+
+    /*
+     * Spin, not sleep, for a short while.
+     */
+    n0 = s_mono_now();
+    t0 = gallus_rdtsc();
+    do {
+      n1 = s_mono_now();
+      t1 = gallus_rdtsc();
+    } while (n1 - n0 < TSC_CALIB_NSEC);
+
+    if (t1 > t0) {
+      s_tsc_origin = t0;
+      s_ns_origin = n0;
+      s_conv.m_tsc0 = t1;
+      s_conv.m_ns0 = n1;
+      s_conv.m_mult = s_nsec_to_mult(n1 - n0, t1 - t0);
+      if (s_conv.m_mult > 0) {
+        s_conv.m_recal_ticks = s_nsec_to_ticks(TSC_RECAL_NSEC,
+                                               s_conv.m_mult);
+        s_use_tsc = (s_conv.m_recal_ticks > 0) ? true : false;
+      }
+    }
+  }
+#endif /* USE_TSC */
+}
+
+
+static inline void
+s_init(void) {
+  (void)pthread_once(&s_once, s_once_proc);
+}
+
+
+static inline gallus_chrono_t
+s_mono_coarse_now(void) {
+  struct timespec t;
+
+  /*
+   * The time of the last kernel tick, read from the vDSO without a
+   * syscall. No thread of ours has to keep it fresh.
+   */
+  (void)clock_gettime(CLOCK_MONOTONIC_COARSE, &t);
+  return TS_TO_NSEC(t);
+}
+
+
+
+
+
 gallus_chrono_t
 gallus_chrono_now(void) {
+  s_init();
+
+#ifdef USE_TSC
+  if (likely(s_use_tsc == true)) {
+    return s_tsc_now();
+  }
+#endif /* USE_TSC */
+
+  return s_mono_now();
+}
+
+
+gallus_chrono_t
+gallus_chrono_coarse_now(void) {
+  return s_mono_coarse_now();
+}
+
+
+gallus_chrono_t
+gallus_chrono_realtime_now(void) {
   gallus_chrono_t ret = 0;
-  WHAT_TIME_IS_IT_NOW_IN_NSEC(ret);
+  WHAT_TIME_IS_IT_NOW_REALTIME_IN_NSEC(ret);
   return ret;
 }
 
 
+bool
+gallus_chrono_is_tsc_used(void) {
+  s_init();
+
+  return s_use_tsc;
+}
+
+
 gallus_result_t
 gallus_chrono_to_timespec(struct timespec *dstptr,
                            gallus_chrono_t nsec) {
@@ -72,6 +318,13 @@ gallus_chrono_nanosleep(gallus_chrono_t nsec,
     return GALLUS_RESULT_INVALID_ARGS;
   }
 
+  if (gallus_fiber_self() != NULL) {
+    if (remptr != NULL) {
+      *remptr = 0;
+    }
+    return gallus_fiber_sleep(nsec);
+  }
+
   NSEC_TO_TS(nsec, t);
 
   if (remptr == NULL) {
@@ -4,30 +4,94 @@
 #define NULL_STR_SIZE 1   /* size of '\0'. */
 #define ALLOC_SIZE(_n) (sizeof(char) * (_n))
 
-#define DS_VSNPRINTF(_ds, _size, _format, _args)                \
-  vsnprintf((_ds)->str + (_ds)->str_size,                       \
-            (_size), (_format), (_args))
+#define DSTRING_MIN_SIZE 64
+#define DSTRING_SEG_SIZE (64 * 1024)
 
 #define DS_STRDUP(_ds, _offset)                                 \
   (((_ds)->str_size == 0) ? strdup("") : strdup((_ds)->str + _offset))
 
+#define DS_SPARE(_ds, _at)                                      \
+  ((_ds)->size - (size_t) ((_ds)->str - (_ds)->buf) - (_at))
+
+/*
+ * A segment of a rope mode dynamic string.
+ */
+struct dstring_seg {
+  struct dstring_seg *next;
+  size_t size; /* size of buf. */
+  size_t len; /* used bytes of buf, no '\0'. */
+  char buf[];
+};
+
+/*
+ * In the flat mode the string is in [str, str + str_size] of the
+ * allocation buf, the str - buf bytes in front are a gap for the
+ * cheap prepends. In the rope mode the string is the concatenation
+ * of the segments and buf/str are not used.
+ */
 struct dstring {
   size_t size; /* size of the allocation. */
   size_t str_size; /* size of str without '\0'. */
   char *str;
+  char *buf;
+  bool is_rope;
+  struct dstring_seg *seg_head;
+  struct dstring_seg *seg_tail;
+  size_t n_segs;
 };
 
+static inline gallus_result_t
+str_vformat(gallus_dstring_t ds, size_t at, const char *format,
+            va_list *args, size_t *lenp) __attr_format_printf__(3, 0);
+static inline gallus_result_t
+str_vappendf(gallus_dstring_t ds, const char *format,
+             va_list *args) __attr_format_printf__(2, 0);
+static inline gallus_result_t
+str_vinsertf(gallus_dstring_t ds, size_t offset, const char *format,
+             va_list *args) __attr_format_printf__(3, 0);
+static inline gallus_result_t
+seg_vformat(size_t size, const char *format, va_list *args,
+            struct dstring_seg **segp) __attr_format_printf__(2, 0);
+static inline gallus_result_t
+rope_vappendf(gallus_dstring_t ds, const char *format,
+              va_list *args) __attr_format_printf__(2, 0);
+static inline gallus_result_t
+rope_vinsertf(gallus_dstring_t ds, size_t offset, const char *format,
+              va_list *args) __attr_format_printf__(3, 0);
+
 static inline void
 dstring_init(gallus_dstring_t ds) {
   ds->str = NULL;
+  ds->buf = NULL;
   ds->size = 0;
   ds->str_size = 0;
+  ds->is_rope = false;
+  ds->seg_head = NULL;
+  ds->seg_tail = NULL;
+  ds->n_segs = 0;
+}
+
+static inline void
+segs_free(gallus_dstring_t ds) {
+  struct dstring_seg *seg, *next;
+
+  for (seg = ds->seg_head; seg != NULL; seg = next) {
+    next = seg->next;
+    GALLUS_FREE(DSTRING, seg);
+  }
+  ds->seg_head = NULL;
+  ds->seg_tail = NULL;
+  ds->n_segs = 0;
 }
 
 static inline void
 dstring_reset(gallus_dstring_t ds) {
-  if (ds->str != NULL) {
-    /* set '\0'. */
+  if (ds->is_rope == true) {
+    segs_free(ds);
+    ds->str_size = 0;
+  } else if (ds->str != NULL) {
+    /* set '\0', the front gap is given back to the tail. */
+    ds->str = ds->buf;
     ds->str[0] = '\0';
     ds->str_size = 0;
   }
@@ -35,24 +99,42 @@ dstring_reset(gallus_dstring_t ds) {
 
 static inline void
 str_free(gallus_dstring_t ds) {
-  if (ds->str != NULL) {
-    free(ds->str);
+  if (ds->buf != NULL) {
+    GALLUS_FREE(DSTRING, ds->buf);
+    ds->buf = NULL;
     ds->str = NULL;
+    ds->size = 0;
+    ds->str_size = 0;
   }
 }
 
+/*
+ * Make room for the need bytes from the str. Grows geometrically so
+ * the N appends cost O(N) copying in total.
+ */
 static inline gallus_result_t
-str_realloc(gallus_dstring_t ds, size_t size) {
+str_reserve(gallus_dstring_t ds, size_t need) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
   char *tmp = NULL;
-  size_t alloc_size = ds->str_size + size + NULL_STR_SIZE;
+  size_t head = (ds->buf != NULL) ? (size_t) (ds->str - ds->buf) : 0;
+  size_t alloc_size;
 
-  if (ds->str == NULL ||
-      (size != 0 && ds->size < alloc_size)) {
-    tmp = (char *) realloc(ds->str, ALLOC_SIZE(alloc_size));
+  if (ds->buf == NULL || head + need > ds->size) {
+    alloc_size = ds->size * 2;
+    if (alloc_size < head + need) {
+      alloc_size = head + need;
+    }
+    if (alloc_size < DSTRING_MIN_SIZE) {
+      alloc_size = DSTRING_MIN_SIZE;
+    }
+    tmp = (char *) GALLUS_REALLOC(DSTRING, ds->buf, ALLOC_SIZE(alloc_size));
     if (tmp != NULL) {
       /* set dstring fields. */
-      ds->str = tmp;
+      if (ds->buf == NULL) {
+        tmp[0] = '\0';
+      }
+      ds->buf = tmp;
+      ds->str = tmp + head;
       ds->size = alloc_size;
       ret = GALLUS_RESULT_OK;
     } else {
@@ -66,12 +148,374 @@ str_realloc(gallus_dstring_t ds, size_t size) {
   return ret;
 }
 
+/*
+ * Format into the spare capacity at str + at. vsnprintf() runs once
+ * unless the spare is too small.
+ */
+static inline gallus_result_t
+str_vformat(gallus_dstring_t ds, size_t at, const char *format,
+            va_list *args, size_t *lenp) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  va_list cpy_args;
+  int pre_size, size;
+
+  ret = str_reserve(ds, at + NULL_STR_SIZE);
+  if (ret == GALLUS_RESULT_OK) {
+    va_copy(cpy_args, *args);
+    pre_size = vsnprintf(ds->str + at, DS_SPARE(ds, at), format, cpy_args);
+    va_end(cpy_args);
+
+    if (pre_size < 0) {
+      ret = GALLUS_RESULT_OUT_OF_RANGE;
+    } else if ((size_t) pre_size < DS_SPARE(ds, at)) {
+      *lenp = (size_t) pre_size;
+      ret = GALLUS_RESULT_OK;
+    } else {
+      ret = str_reserve(ds, at + (size_t) pre_size + NULL_STR_SIZE);
+      if (ret == GALLUS_RESULT_OK) {
+        size = vsnprintf(ds->str + at, (size_t) (pre_size + NULL_STR_SIZE),
+                         format, *args);
+        if (size >= 0 && size == pre_size) {
+          *lenp = (size_t) size;
+        } else {
+          ret = GALLUS_RESULT_OUT_OF_RANGE;
+        }
+      }
+    }
+  }
+
+  return ret;
+}
+
+/*
+ * Open a front gap of at least n bytes. The gap is proportional to
+ * the string so the repeated prepends are amortized O(1) per byte.
+ */
+static inline gallus_result_t
+str_grow_front(gallus_dstring_t ds, size_t n) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  size_t gap = (ds->str_size > n) ? ds->str_size : n;
+  size_t alloc_size;
+  char *tmp = NULL;
+
+  if (gap < DSTRING_MIN_SIZE) {
+    gap = DSTRING_MIN_SIZE;
+  }
+  /* the str, '\0' and the formatted n bytes behind it. */
+  alloc_size = gap + ds->str_size + NULL_STR_SIZE + n + NULL_STR_SIZE;
+
+  tmp = (char *) GALLUS_MALLOC(DSTRING, ALLOC_SIZE(alloc_size));
+  if (tmp != NULL) {
+    memcpy(tmp + gap, ds->str, ds->str_size + NULL_STR_SIZE + n);
+    GALLUS_FREE(DSTRING, ds->buf);
+    ds->buf = tmp;
+    ds->str = tmp + gap;
+    ds->size = alloc_size;
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_NO_MEMORY;
+  }
+
+  return ret;
+}
+
+static inline gallus_result_t
+str_vappendf(gallus_dstring_t ds, const char *format, va_list *args) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  size_t n = 0;
+
+  ret = str_vformat(ds, ds->str_size, format, args, &n);
+  if (ret == GALLUS_RESULT_OK) {
+    /* sum size of str. */
+    ds->str_size += n;
+  }
+
+  return ret;
+}
+
+/*
+ * The text is formatted behind the '\0' of the str first and then
+ * moved in, shifting the shorter side: the front into the gap or the
+ * tail to the right.
+ */
+static inline gallus_result_t
+str_vinsertf(gallus_dstring_t ds, size_t offset, const char *format,
+             va_list *args) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  size_t at = ds->str_size + NULL_STR_SIZE;
+  size_t n = 0;
+
+  if (offset == ds->str_size) {
+    return str_vappendf(ds, format, args);
+  }
+
+  ret = str_vformat(ds, at, format, args, &n);
+  if (ret == GALLUS_RESULT_OK && n > 0) {
+    if (offset == 0 && (size_t) (ds->str - ds->buf) < n) {
+      ret = str_grow_front(ds, n);
+    }
+    if (ret == GALLUS_RESULT_OK) {
+      if (offset <= ds->str_size / 2 &&
+          (size_t) (ds->str - ds->buf) >= n) {
+        memmove(ds->str - n, ds->str, offset);
+        ds->str -= n;
+        memcpy(ds->str + offset, ds->str + n + at, n);
+      } else {
+        ret = str_reserve(ds, at + n + n);
+        if (ret == GALLUS_RESULT_OK) {
+          memmove(ds->str + at + n, ds->str + at, n);
+          memmove(ds->str + offset + n, ds->str + offset,
+                  ds->str_size - offset + NULL_STR_SIZE);
+          memcpy(ds->str + offset, ds->str + at + n, n);
+        }
+      }
+    }
+    if (ret == GALLUS_RESULT_OK) {
+      /* sum size of str. */
+      ds->str_size += n;
+      *(ds->str + ds->str_size) = '\0';
+    }
+  } else if (ret == GALLUS_RESULT_OK) {
+    *(ds->str + ds->str_size) = '\0';
+  }
+
+  return ret;
+}
+
+static inline gallus_result_t
+str_append(gallus_dstring_t ds, const char *s, size_t len) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  ret = str_reserve(ds, ds->str_size + len + NULL_STR_SIZE);
+  if (ret == GALLUS_RESULT_OK) {
+    memcpy(ds->str + ds->str_size, s, len);
+    ds->str_size += len;
+    *(ds->str + ds->str_size) = '\0';
+  }
+
+  return ret;
+}
+
+static inline struct dstring_seg *
+seg_alloc(size_t size) {
+  struct dstring_seg *seg = NULL;
+
+  seg = (struct dstring_seg *)
+        GALLUS_MALLOC(DSTRING, sizeof(*seg) + ALLOC_SIZE(size));
+  if (seg != NULL) {
+    seg->next = NULL;
+    seg->size = size;
+    seg->len = 0;
+  }
+
+  return seg;
+}
+
+/*
+ * Format into a new segment of at least size bytes.
+ */
+static inline gallus_result_t
+seg_vformat(size_t size, const char *format, va_list *args,
+            struct dstring_seg **segp) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  struct dstring_seg *seg = NULL;
+  struct dstring_seg *tmp = NULL;
+  va_list cpy_args;
+  int pre_size, n;
+
+  seg = seg_alloc(size);
+  if (seg != NULL) {
+    va_copy(cpy_args, *args);
+    pre_size = vsnprintf(seg->buf, seg->size, format, cpy_args);
+    va_end(cpy_args);
+
+    if (pre_size < 0) {
+      ret = GALLUS_RESULT_OUT_OF_RANGE;
+    } else if ((size_t) pre_size < seg->size) {
+      seg->len = (size_t) pre_size;
+      ret = GALLUS_RESULT_OK;
+    } else {
+      tmp = (struct dstring_seg *)
+            GALLUS_REALLOC(DSTRING, seg, sizeof(*seg) +
+                           ALLOC_SIZE((size_t) pre_size + NULL_STR_SIZE));
+      if (tmp != NULL) {
+        seg = tmp;
+        seg->size = (size_t) pre_size + NULL_STR_SIZE;
+        n = vsnprintf(seg->buf, seg->size, format, *args);
+        if (n >= 0 && n == pre_size) {
+          seg->len = (size_t) n;
+          ret = GALLUS_RESULT_OK;
+        } else {
+          ret = GALLUS_RESULT_OUT_OF_RANGE;
+        }
+      } else {
+        ret = GALLUS_RESULT_NO_MEMORY;
+      }
+    }
+
+    if (ret == GALLUS_RESULT_OK) {
+      *segp = seg;
+    } else {
+      GALLUS_FREE(DSTRING, seg);
+    }
+  } else {
+    ret = GALLUS_RESULT_NO_MEMORY;
+  }
+
+  return ret;
+}
+
+static inline void
+seg_link(gallus_dstring_t ds, struct dstring_seg *prev,
+         struct dstring_seg *seg) {
+  if (prev == NULL) {
+    seg->next = ds->seg_head;
+    ds->seg_head = seg;
+  } else {
+    seg->next = prev->next;
+    prev->next = seg;
+  }
+  if (seg->next == NULL) {
+    ds->seg_tail = seg;
+  }
+  ds->n_segs++;
+  ds->str_size += seg->len;
+}
+
+/*
+ * Appends go into the spare of the tail segment, a new segment is
+ * linked when it doesn't fit; nothing already written is moved.
+ */
+static inline gallus_result_t
+rope_vappendf(gallus_dstring_t ds, const char *format, va_list *args) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  struct dstring_seg *tail = ds->seg_tail;
+  struct dstring_seg *seg = NULL;
+  va_list cpy_args;
+  size_t spare;
+  int n;
+
+  if (tail != NULL && tail->size > tail->len) {
+    spare = tail->size - tail->len;
+    va_copy(cpy_args, *args);
+    n = vsnprintf(tail->buf + tail->len, spare, format, cpy_args);
+    va_end(cpy_args);
+
+    if (n < 0) {
+      return GALLUS_RESULT_OUT_OF_RANGE;
+    } else if ((size_t) n < spare) {
+      tail->len += (size_t) n;
+      ds->str_size += (size_t) n;
+      return GALLUS_RESULT_OK;
+    }
+  }
+
+  ret = seg_vformat(DSTRING_SEG_SIZE, format, args, &seg);
+  if (ret == GALLUS_RESULT_OK) {
+    seg_link(ds, tail, seg);
+  }
+
+  return ret;
+}
+
+static inline gallus_result_t
+rope_vinsertf(gallus_dstring_t ds, size_t offset, const char *format,
+              va_list *args) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  struct dstring_seg *prev = NULL;
+  struct dstring_seg *seg = NULL;
+  struct dstring_seg *new_seg = NULL;
+  struct dstring_seg *rest = NULL;
+
+  if (offset == ds->str_size) {
+    return rope_vappendf(ds, format, args);
+  }
+
+  /* find the segment holding the offset. */
+  for (seg = ds->seg_head; seg != NULL && offset >= seg->len;
+       seg = seg->next) {
+    offset -= seg->len;
+    prev = seg;
+  }
+
+  ret = seg_vformat(DSTRING_MIN_SIZE, format, args, &new_seg);
+  if (ret == GALLUS_RESULT_OK && offset > 0) {
+    /* split the segment, the rest follows the new one. */
+    rest = seg_alloc(seg->len - offset);
+    if (rest != NULL) {
+      memcpy(rest->buf, seg->buf + offset, seg->len - offset);
+      rest->len = seg->len - offset;
+      ds->str_size -= rest->len;
+      seg->len = offset;
+      seg_link(ds, seg, rest);
+      prev = seg;
+    } else {
+      GALLUS_FREE(DSTRING, new_seg);
+      ret = GALLUS_RESULT_NO_MEMORY;
+    }
+  }
+  if (ret == GALLUS_RESULT_OK) {
+    seg_link(ds, prev, new_seg);
+  }
+
+  return ret;
+}
+
+static inline gallus_result_t
+rope_append(gallus_dstring_t ds, const char *s, size_t len) {
+  struct dstring_seg *tail = ds->seg_tail;
+  struct dstring_seg *seg = NULL;
+  size_t n;
+
+  if (tail != NULL && tail->size > tail->len) {
+    n = tail->size - tail->len;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(tail->buf + tail->len, s, n);
+    tail->len += n;
+    ds->str_size += n;
+    s += n;
+    len -= n;
+  }
+
+  if (len > 0) {
+    seg = seg_alloc((len > DSTRING_SEG_SIZE) ? len : DSTRING_SEG_SIZE);
+    if (seg == NULL) {
+      return GALLUS_RESULT_NO_MEMORY;
+    }
+    memcpy(seg->buf, s, len);
+    seg->len = len;
+    seg_link(ds, tail, seg);
+  }
+
+  return GALLUS_RESULT_OK;
+}
+
+static inline char *
+rope_strdup(gallus_dstring_t ds) {
+  struct dstring_seg *seg;
+  char *str = NULL;
+  size_t off = 0;
+
+  str = (char *) malloc(ALLOC_SIZE(ds->str_size + NULL_STR_SIZE));
+  if (str != NULL) {
+    for (seg = ds->seg_head; seg != NULL; seg = seg->next) {
+      memcpy(str + off, seg->buf, seg->len);
+      off += seg->len;
+    }
+    str[off] = '\0';
+  }
+
+  return str;
+}
+
 gallus_result_t
 gallus_dstring_create(gallus_dstring_t *ds) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
 
   if (ds != NULL) {
-    *ds = (struct dstring *) malloc(sizeof(struct dstring));
+    *ds = (struct dstring *) GALLUS_MALLOC(DSTRING, sizeof(struct dstring));
 
     if (*ds == NULL) {
       ret = GALLUS_RESULT_NO_MEMORY;
@@ -86,11 +530,24 @@ gallus_dstring_create(gallus_dstring_t *ds) {
   return ret;
 }
 
+gallus_result_t
+gallus_dstring_create_rope(gallus_dstring_t *ds) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  ret = gallus_dstring_create(ds);
+  if (ret == GALLUS_RESULT_OK) {
+    (*ds)->is_rope = true;
+  }
+
+  return ret;
+}
+
 void
 gallus_dstring_destroy(gallus_dstring_t *ds) {
   if (ds != NULL && *ds != NULL) {
     str_free(*ds);
-    free(*ds);
+    segs_free(*ds);
+    GALLUS_FREE(DSTRING, *ds);
     *ds = NULL;
   }
 }
@@ -113,35 +570,18 @@ gallus_result_t
 gallus_dstring_vappendf(gallus_dstring_t *ds, const char *format,
                          va_list *args) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
-  va_list cpy_args;
-  int pre_size, size;
 
   if (ds != NULL && *ds != NULL &&
       format != NULL && args != NULL) {
-    va_copy(cpy_args, *args);
-
-    pre_size = DS_VSNPRINTF(*ds, 0, format, *args);
-
-    if (pre_size >= 0) {
-      ret = str_realloc(*ds, (size_t) pre_size);
-      if (ret == GALLUS_RESULT_OK) {
-        size = DS_VSNPRINTF(*ds, (size_t) (pre_size + NULL_STR_SIZE),
-                            format, cpy_args);
-        if (size >= 0 && size == pre_size) {
-          /* sum size of str. */
-          (*ds)->str_size += (size_t) size;
-          ret = GALLUS_RESULT_OK;
-        } else {
-          /* free. */
-          str_free(*ds);
-          ret = GALLUS_RESULT_OUT_OF_RANGE;
-        }
-      }
+    if ((*ds)->is_rope == true) {
+      ret = rope_vappendf(*ds, format, args);
     } else {
-      ret = GALLUS_RESULT_OUT_OF_RANGE;
+      ret = str_vappendf(*ds, format, args);
+      if (ret == GALLUS_RESULT_OUT_OF_RANGE) {
+        /* free. */
+        str_free(*ds);
+      }
     }
-
-    va_end(cpy_args);
   } else {
     ret = GALLUS_RESULT_INVALID_ARGS;
   }
@@ -169,53 +609,22 @@ gallus_result_t
 gallus_dstring_vprependf(gallus_dstring_t *ds, const char *format,
                           va_list *args) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
-  va_list cpy_args;
-  int pre_size, size;
-  char *cpy_str = NULL;
 
   if (ds != NULL && *ds != NULL &&
       format != NULL && args != NULL) {
-    va_copy(cpy_args, *args);
-
-    pre_size = DS_VSNPRINTF(*ds, 0, format, *args);
-
-    if (pre_size >= 0) {
-      ret = str_realloc(*ds, (size_t) pre_size);
-      if (ret == GALLUS_RESULT_OK) {
-        cpy_str = DS_STRDUP(*ds, 0);
-        if (cpy_str != NULL) {
-          size = vsnprintf((*ds)->str, (size_t) (pre_size + NULL_STR_SIZE),
-                           format, cpy_args);
-          if (size >= 0 && size == pre_size) {
-            memmove((*ds)->str + size, cpy_str, (*ds)->str_size);
-            /* sum size of str. */
-            (*ds)->str_size += (size_t) size;
-            *((*ds)->str + (*ds)->str_size) = '\0';
-            ret = GALLUS_RESULT_OK;
-          } else {
-            ret = GALLUS_RESULT_OUT_OF_RANGE;
-          }
-        } else {
-          ret = GALLUS_RESULT_NO_MEMORY;
-        }
-      } else {
-        ret = GALLUS_RESULT_NO_MEMORY;
-      }
+    if ((*ds)->is_rope == true) {
+      ret = rope_vinsertf(*ds, 0, format, args);
     } else {
-      ret = GALLUS_RESULT_OUT_OF_RANGE;
-    }
-    va_end(cpy_args);
-
-    /* free. */
-    if (ret != GALLUS_RESULT_OK) {
-      str_free(*ds);
+      ret = str_vinsertf(*ds, 0, format, args);
+      /* free. */
+      if (ret != GALLUS_RESULT_OK) {
+        str_free(*ds);
+      }
     }
   } else {
     ret = GALLUS_RESULT_INVALID_ARGS;
   }
 
-  free(cpy_str);
-
   return ret;
 }
 
@@ -241,57 +650,23 @@ gallus_dstring_vinsertf(gallus_dstring_t *ds,
                          const char *format,
                          va_list *args) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
-  va_list cpy_args;
-  int pre_size, size;
-  char *cpy_str = NULL;
 
   if (ds != NULL && *ds != NULL &&
       format != NULL && args != NULL &&
       (*ds)->str_size >= offset) {
-    va_copy(cpy_args, *args);
-
-    pre_size = DS_VSNPRINTF(*ds, 0, format, *args);
-
-    if (pre_size >= 0) {
-      ret = str_realloc(*ds, (size_t) pre_size);
-      if (ret == GALLUS_RESULT_OK) {
-        cpy_str = DS_STRDUP(*ds, offset);
-        if (cpy_str != NULL) {
-          size = vsnprintf((*ds)->str + offset,
-                           (size_t) (pre_size + NULL_STR_SIZE),
-                           format, cpy_args);
-          if (size >= 0 && size == pre_size) {
-            memmove((*ds)->str + size + offset,
-                    cpy_str,
-                    (*ds)->str_size - offset);
-            /* sum size of str. */
-            (*ds)->str_size += (size_t) size;
-            *((*ds)->str + (*ds)->str_size) = '\0';
-            ret = GALLUS_RESULT_OK;
-          } else {
-            ret = GALLUS_RESULT_OUT_OF_RANGE;
-          }
-        } else {
-          ret = GALLUS_RESULT_NO_MEMORY;
-        }
-      } else {
-        ret = GALLUS_RESULT_NO_MEMORY;
-      }
+    if ((*ds)->is_rope == true) {
+      ret = rope_vinsertf(*ds, offset, format, args);
     } else {
-      ret = GALLUS_RESULT_OUT_OF_RANGE;
-    }
-    va_end(cpy_args);
-
-    /* free. */
-    if (ret != GALLUS_RESULT_OK) {
-      str_free(*ds);
+      ret = str_vinsertf(*ds, offset, format, args);
+      /* free. */
+      if (ret != GALLUS_RESULT_OK) {
+        str_free(*ds);
+      }
     }
   } else {
     ret = GALLUS_RESULT_INVALID_ARGS;
   }
 
-  free(cpy_str);
-
   return ret;
 }
 
@@ -317,10 +692,34 @@ gallus_result_t
 gallus_dstring_concat(gallus_dstring_t *dst_ds,
                        const gallus_dstring_t *src_ds) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  struct dstring_seg *seg;
+  char *cpy_str = NULL;
 
   if (dst_ds != NULL && *dst_ds != NULL &&
       src_ds != NULL && *src_ds != NULL) {
-    ret = gallus_dstring_appendf(dst_ds, "%s", (*src_ds)->str);
+    ret = GALLUS_RESULT_OK;
+    if (*dst_ds == *src_ds) {
+      /* the source moves while growing. */
+      ret = gallus_dstring_str_get(dst_ds, &cpy_str);
+      if (ret == GALLUS_RESULT_OK) {
+        ret = ((*dst_ds)->is_rope == true) ?
+              rope_append(*dst_ds, cpy_str, (*dst_ds)->str_size) :
+              str_append(*dst_ds, cpy_str, (*dst_ds)->str_size);
+        free(cpy_str);
+      }
+    } else if ((*src_ds)->is_rope == true) {
+      for (seg = (*src_ds)->seg_head;
+           seg != NULL && ret == GALLUS_RESULT_OK;
+           seg = seg->next) {
+        ret = ((*dst_ds)->is_rope == true) ?
+              rope_append(*dst_ds, seg->buf, seg->len) :
+              str_append(*dst_ds, seg->buf, seg->len);
+      }
+    } else if ((*src_ds)->str_size > 0) {
+      ret = ((*dst_ds)->is_rope == true) ?
+            rope_append(*dst_ds, (*src_ds)->str, (*src_ds)->str_size) :
+            str_append(*dst_ds, (*src_ds)->str, (*src_ds)->str_size);
+    }
   } else {
     ret = GALLUS_RESULT_INVALID_ARGS;
   }
@@ -333,7 +732,11 @@ gallus_dstring_str_get(gallus_dstring_t *ds, char **str) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
 
   if (ds != NULL && *ds != NULL && str != NULL) {
-    *str = DS_STRDUP(*ds, 0);
+    if ((*ds)->is_rope == true) {
+      *str = rope_strdup(*ds);
+    } else {
+      *str = DS_STRDUP(*ds, 0);
+    }
 
     if (*str == NULL) {
       ret = GALLUS_RESULT_NO_MEMORY;
@@ -374,3 +777,36 @@ gallus_dstring_empty(gallus_dstring_t *ds) {
 
   return ret;
 }
+
+gallus_result_t
+gallus_dstring_iovec_get(gallus_dstring_t *ds,
+                          struct iovec *iov, size_t max) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  struct dstring_seg *seg;
+  size_t n = 0;
+
+  if (ds != NULL && *ds != NULL && (iov != NULL || max == 0)) {
+    if ((*ds)->is_rope == true) {
+      for (seg = (*ds)->seg_head; seg != NULL; seg = seg->next) {
+        if (seg->len > 0) {
+          if (n < max) {
+            iov[n].iov_base = (void *) seg->buf;
+            iov[n].iov_len = seg->len;
+          }
+          n++;
+        }
+      }
+    } else if ((*ds)->str_size > 0) {
+      if (max > 0) {
+        iov[0].iov_base = (void *) (*ds)->str;
+        iov[0].iov_len = (*ds)->str_size;
+      }
+      n = 1;
+    }
+    ret = (gallus_result_t) n;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
@@ -0,0 +1,1430 @@
+#include "gallus_apis.h"
+#include "gallus_thread_internal.h"
+#include "gallus_fiber_internal.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#ifndef __x86_64__
+#include <ucontext.h>
+#endif /* ! __x86_64__ */
+
+
+
+
+
+#define FIBER_STACK_CACHE_MAX	128
+#define FIBER_POLL_EVENTS	64
+
+/*
+ * A carrier switches fiber to fiber directly at most this many
+ * times before it gets back to its own loop, where the timers and
+ * the descriptors are checked.
+ */
+#define FIBER_DIRECT_MAX	61
+
+#define FIBER_TIMER_NONE	SIZE_MAX
+#define FIBER_NO_DEADLINE	INT64_MAX
+
+
+/*
+ * The park word: the low 2 bits are the state and the rest is the
+ * ticket, bumped for every park so a late wakeup for an older park
+ * can't wake the fiber up.
+ */
+#define PARK_RUNNING	0ULL
+#define PARK_PARKING	1ULL
+#define PARK_PARKED	2ULL
+#define PARK_NOTIFIED	3ULL
+#define PARK_STATE_MASK	3ULL
+
+#define PARK_WORD(ticket, st)	(((ticket) << 2) | (st))
+#define PARK_TICKET(w)		((w) >> 2)
+#define PARK_STATE(w)		((w) & PARK_STATE_MASK)
+
+
+typedef enum {
+  FIBER_POST_NONE = 0,
+  FIBER_POST_YIELD,
+  FIBER_POST_PARK,
+  FIBER_POST_EXIT,
+} fiber_post_t;
+
+
+#ifdef __x86_64__
+typedef struct fiber_ctx_record {
+  void *m_sp;
+} fiber_ctx_record;
+#else
+typedef struct fiber_ctx_record {
+  ucontext_t m_uc;
+} fiber_ctx_record;
+#endif /* __x86_64__ */
+
+
+typedef struct gallus_fiber_record {
+  fiber_ctx_record m_ctx;
+  gallus_fiber_sched_t m_sched;
+
+  struct gallus_fiber_record *m_next;	/* the run queue/the free list. */
+  struct gallus_fiber_record *m_all_next;
+
+  volatile uint64_t m_park;
+
+  gallus_fiber_proc_t m_proc;
+  void *m_arg;
+  gallus_future_t m_future;
+
+  uint8_t *m_map;	/* the guard page + the stack. */
+  size_t m_map_size;
+
+  /* under m_sched->m_tm_lck. */
+  gallus_chrono_t m_deadline;
+  uint64_t m_tm_ticket;
+  size_t m_tm_idx;
+
+  volatile uint64_t m_fd_ticket;
+} gallus_fiber_record;
+
+
+typedef struct fiber_carrier_record {
+  gallus_thread_record m_thd;	/* must be on the head. */
+
+  gallus_fiber_sched_t m_sched;
+  fiber_ctx_record m_ctx;
+
+  gallus_fiber_t m_cur;
+  fiber_post_t m_post;
+  gallus_fiber_t m_post_fiber;
+  size_t m_n_direct;
+  size_t m_n_loops;
+} fiber_carrier_record;
+typedef fiber_carrier_record *fiber_carrier_t;
+
+
+typedef struct gallus_fiber_sched_record {
+  size_t m_stack_size;
+  size_t m_page_size;
+
+  gallus_spinlock_t m_rq_lck;
+  gallus_fiber_t m_rq_head;
+  gallus_fiber_t m_rq_tail;
+  volatile size_t m_n_runnable;
+
+  gallus_mutex_t m_idle_lck;
+  gallus_cond_t m_idle_cnd;
+  volatile size_t m_n_idle;
+  size_t m_n_cnd_waiters;
+  bool m_is_polling;
+
+  gallus_spinlock_t m_tm_lck;
+  gallus_fiber_t *m_tm_heap;
+  size_t m_tm_n;
+  size_t m_tm_max;
+  volatile gallus_chrono_t m_tm_next;
+
+  int m_epfd;
+  int m_evfd;
+  volatile size_t m_n_fd_waiters;
+
+  gallus_mutex_t m_lck;
+  gallus_cond_t m_cnd;
+  gallus_fiber_t m_all;
+  gallus_fiber_t m_free;
+  size_t m_n_fibers;
+  size_t m_n_cached;
+  volatile size_t m_n_live;
+  volatile bool m_is_shutdown;
+  volatile bool m_do_stop;
+  bool m_is_stopped;
+
+  size_t m_n_carriers;
+  fiber_carrier_t *m_carriers;
+} gallus_fiber_sched_record;
+
+
+
+
+
+static __thread fiber_carrier_t s_carrier_tls = NULL;
+
+
+static void	s_fiber_main(gallus_fiber_t f)
+__attribute__((used, noreturn));
+static void	s_after_switch(fiber_carrier_t c);
+
+
+
+
+
+/*
+ * context switch
+ */
+
+
+#ifdef __x86_64__
+
+extern void gallus_fiber_ctx_switch(fiber_ctx_record *from,
+                                    fiber_ctx_record *to)
+__attribute__((visibility("hidden")));
+extern void gallus_fiber_ctx_entry(void)
+__attribute__((visibility("hidden")));
+
+
+/*
+ * Save the callee-saved registers, the mxcsr and the x87 control
+ * word on the current stack, swap the stack pointers and restore
+ * them from the other one. A new fiber starts from
+ * gallus_fiber_ctx_entry with the fiber in %rbx.
+ */
+__asm__(
+    ".text\n"
+    ".p2align 4\n"
+    ".globl gallus_fiber_ctx_switch\n"
+    ".hidden gallus_fiber_ctx_switch\n"
+    ".type gallus_fiber_ctx_switch, @function\n"
+    "gallus_fiber_ctx_switch:\n"
+    "  pushq %rbp\n"
+    "  pushq %rbx\n"
+    "  pushq %r12\n"
+    "  pushq %r13\n"
+    "  pushq %r14\n"
+    "  pushq %r15\n"
+    "  subq $8, %rsp\n"
+    "  stmxcsr (%rsp)\n"
+    "  fnstcw 4(%rsp)\n"
+    "  movq %rsp, (%rdi)\n"
+    "  movq (%rsi), %rsp\n"
+    "  ldmxcsr (%rsp)\n"
+    "  fldcw 4(%rsp)\n"
+    "  addq $8, %rsp\n"
+    "  popq %r15\n"
+    "  popq %r14\n"
+    "  popq %r13\n"
+    "  popq %r12\n"
+    "  popq %rbx\n"
+    "  popq %rbp\n"
+    "  ret\n"
+    ".size gallus_fiber_ctx_switch, .-gallus_fiber_ctx_switch\n"
+    ".p2align 4\n"
+    ".globl gallus_fiber_ctx_entry\n"
+    ".hidden gallus_fiber_ctx_entry\n"
+    ".type gallus_fiber_ctx_entry, @function\n"
+    "gallus_fiber_ctx_entry:\n"
+    "  movq %rbx, %rdi\n"
+    "  call s_fiber_main\n"
+    "  ud2\n"
+    ".size gallus_fiber_ctx_entry, .-gallus_fiber_ctx_entry\n");
+
+
+static inline void
+s_ctx_switch(fiber_ctx_record *from, fiber_ctx_record *to) {
+  gallus_fiber_ctx_switch(from, to);
+}
+
+
+static inline void
+s_ctx_init(gallus_fiber_t f, uint8_t *stack, size_t size) {
+  uint64_t *sp;
+
+  /*
+   * 8 words: the csr, r15, r14, r13, r12, rbx, rbp and the return
+   * address. The stack is 16 bytes aligned after the ret.
+   */
+  sp = (uint64_t *)((((uintptr_t)(stack + size)) & ~(uintptr_t)15) - 64);
+  sp[0] = 0x1f80ULL | (0x037fULL << 32);
+  sp[1] = 0;
+  sp[2] = 0;
+  sp[3] = 0;
+  sp[4] = 0;
+  sp[5] = (uint64_t)(uintptr_t)f;
+  sp[6] = 0;
+  sp[7] = (uint64_t)(uintptr_t)gallus_fiber_ctx_entry;
+  f->m_ctx.m_sp = (void *)sp;
+}
+
+#else
+
+static void
+s_ctx_entry(unsigned int hi, unsigned int lo) {
+  s_fiber_main((gallus_fiber_t)(uintptr_t)
+               ((((uint64_t)hi) << 32) | (uint64_t)lo));
+}
+
+
+static inline void
+s_ctx_switch(fiber_ctx_record *from, fiber_ctx_record *to) {
+  (void)swapcontext(&from->m_uc, &to->m_uc);
+}
+
+
+static inline void
+s_ctx_init(gallus_fiber_t f, uint8_t *stack, size_t size) {
+  uint64_t p = (uint64_t)(uintptr_t)f;
+
+  (void)getcontext(&f->m_ctx.m_uc);
+  f->m_ctx.m_uc.uc_stack.ss_sp = stack;
+  f->m_ctx.m_uc.uc_stack.ss_size = size;
+  f->m_ctx.m_uc.uc_link = NULL;
+  makecontext(&f->m_ctx.m_uc, (void (*)(void))s_ctx_entry, 2,
+              (unsigned int)(p >> 32), (unsigned int)(p & 0xffffffffU));
+}
+
+#endif /* __x86_64__ */
+
+
+/*
+ * A fiber can resume on another carrier, so don't let the compiler
+ * keep the TLS address across a switch.
+ */
+static __attribute__((noinline)) fiber_carrier_t
+s_carrier(void) {
+  fiber_carrier_t c = s_carrier_tls;
+
+  __asm__ __volatile__("" ::: "memory");
+
+  return c;
+}
+
+
+
+
+
+/*
+ * run queue
+ */
+
+
+static inline void
+s_kick(gallus_fiber_sched_t s) {
+  if (__atomic_load_n(&s->m_n_idle, __ATOMIC_SEQ_CST) > 0) {
+    (void)gallus_mutex_lock(&s->m_idle_lck);
+    {
+      if (s->m_n_cnd_waiters > 0) {
+        (void)gallus_cond_notify(&s->m_idle_cnd, false);
+      } else if (s->m_is_polling == true) {
+        uint64_t v = 1;
+        ssize_t st = write(s->m_evfd, &v, sizeof(v));
+        (void)st;
+      }
+    }
+    (void)gallus_mutex_unlock(&s->m_idle_lck);
+  }
+}
+
+
+static inline void
+s_runq_push(gallus_fiber_sched_t s, gallus_fiber_t f) {
+  f->m_next = NULL;
+
+  (void)gallus_spinlock_lock(&s->m_rq_lck);
+  {
+    if (s->m_rq_tail != NULL) {
+      s->m_rq_tail->m_next = f;
+    } else {
+      __atomic_store_n(&s->m_rq_head, f, __ATOMIC_RELEASE);
+    }
+    s->m_rq_tail = f;
+  }
+  (void)gallus_spinlock_unlock(&s->m_rq_lck);
+
+  (void)__atomic_add_fetch(&s->m_n_runnable, 1, __ATOMIC_SEQ_CST);
+  s_kick(s);
+}
+
+
+static inline gallus_fiber_t
+s_runq_pop(gallus_fiber_sched_t s) {
+  gallus_fiber_t f = NULL;
+
+  if (__atomic_load_n(&s->m_rq_head, __ATOMIC_ACQUIRE) == NULL) {
+    return NULL;
+  }
+
+  (void)gallus_spinlock_lock(&s->m_rq_lck);
+  {
+    if ((f = s->m_rq_head) != NULL) {
+      __atomic_store_n(&s->m_rq_head, f->m_next, __ATOMIC_RELEASE);
+      if (f->m_next == NULL) {
+        s->m_rq_tail = NULL;
+      }
+      f->m_next = NULL;
+    }
+  }
+  (void)gallus_spinlock_unlock(&s->m_rq_lck);
+
+  if (f != NULL) {
+    (void)__atomic_sub_fetch(&s->m_n_runnable, 1, __ATOMIC_SEQ_CST);
+  }
+
+  return f;
+}
+
+
+
+
+
+/*
+ * park/wake
+ */
+
+
+static inline uint64_t
+s_park_begin(gallus_fiber_t f) {
+  uint64_t ticket = PARK_TICKET(f->m_park) + 1;
+
+  __atomic_store_n(&f->m_park, PARK_WORD(ticket, PARK_PARKING),
+                   __ATOMIC_SEQ_CST);
+
+  return ticket;
+}
+
+
+static inline void
+s_park_cancel(gallus_fiber_t f, uint64_t ticket) {
+  __atomic_store_n(&f->m_park, PARK_WORD(ticket, PARK_RUNNING),
+                   __ATOMIC_SEQ_CST);
+}
+
+
+static inline bool
+s_wake(gallus_fiber_t f, uint64_t ticket) {
+  uint64_t w = __atomic_load_n(&f->m_park, __ATOMIC_SEQ_CST);
+
+  while (PARK_TICKET(w) == ticket) {
+    if (PARK_STATE(w) == PARK_PARKING) {
+      /* still on its stack; the carrier requeues it after the switch. */
+      if (__atomic_compare_exchange_n(&f->m_park, &w,
+                                      PARK_WORD(ticket, PARK_NOTIFIED),
+                                      false, __ATOMIC_SEQ_CST,
+                                      __ATOMIC_SEQ_CST) == true) {
+        return true;
+      }
+    } else if (PARK_STATE(w) == PARK_PARKED) {
+      if (__atomic_compare_exchange_n(&f->m_park, &w,
+                                      PARK_WORD(ticket, PARK_RUNNING),
+                                      false, __ATOMIC_SEQ_CST,
+                                      __ATOMIC_SEQ_CST) == true) {
+        s_runq_push(f->m_sched, f);
+        return true;
+      }
+    } else {
+      break;
+    }
+  }
+
+  return false;
+}
+
+
+
+
+
+/*
+ * timers
+ */
+
+
+static inline void
+s_tm_swap(gallus_fiber_sched_t s, size_t i, size_t j) {
+  gallus_fiber_t t = s->m_tm_heap[i];
+
+  s->m_tm_heap[i] = s->m_tm_heap[j];
+  s->m_tm_heap[j] = t;
+  s->m_tm_heap[i]->m_tm_idx = i;
+  s->m_tm_heap[j]->m_tm_idx = j;
+}
+
+
+static inline void
+s_tm_fix(gallus_fiber_sched_t s, size_t i) {
+  size_t p, l, m;
+
+  while (i > 0 &&
+         s->m_tm_heap[(p = (i - 1) / 2)]->m_deadline >
+         s->m_tm_heap[i]->m_deadline) {
+    s_tm_swap(s, i, p);
+    i = p;
+  }
+
+  while ((l = 2 * i + 1) < s->m_tm_n) {
+    m = (l + 1 < s->m_tm_n &&
+         s->m_tm_heap[l + 1]->m_deadline < s->m_tm_heap[l]->m_deadline) ?
+        l + 1 : l;
+    if (s->m_tm_heap[m]->m_deadline >= s->m_tm_heap[i]->m_deadline) {
+      break;
+    }
+    s_tm_swap(s, i, m);
+    i = m;
+  }
+}
+
+
+static inline void
+s_tm_remove_at(gallus_fiber_sched_t s, size_t i) {
+  s->m_tm_heap[i]->m_tm_idx = FIBER_TIMER_NONE;
+  if (--s->m_tm_n != i) {
+    s->m_tm_heap[i] = s->m_tm_heap[s->m_tm_n];
+    s->m_tm_heap[i]->m_tm_idx = i;
+    s_tm_fix(s, i);
+  }
+}
+
+
+static inline void
+s_tm_update_next(gallus_fiber_sched_t s) {
+  __atomic_store_n(&s->m_tm_next,
+                   (s->m_tm_n > 0) ? s->m_tm_heap[0]->m_deadline :
+                   FIBER_NO_DEADLINE, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * A fiber has one timer at most and the heap has a room for every
+ * fiber, reserved at the fiber creation.
+ */
+static inline void
+s_timer_add(gallus_fiber_t f, uint64_t ticket, gallus_chrono_t deadline) {
+  gallus_fiber_sched_t s = f->m_sched;
+
+  (void)gallus_spinlock_lock(&s->m_tm_lck);
+  {
+    f->m_deadline = deadline;
+    f->m_tm_ticket = ticket;
+    f->m_tm_idx = s->m_tm_n;
+    s->m_tm_heap[s->m_tm_n++] = f;
+    s_tm_fix(s, f->m_tm_idx);
+    s_tm_update_next(s);
+  }
+  (void)gallus_spinlock_unlock(&s->m_tm_lck);
+}
+
+
+static inline void
+s_timer_del(gallus_fiber_t f) {
+  gallus_fiber_sched_t s = f->m_sched;
+
+  (void)gallus_spinlock_lock(&s->m_tm_lck);
+  {
+    if (f->m_tm_idx != FIBER_TIMER_NONE) {
+      s_tm_remove_at(s, f->m_tm_idx);
+      s_tm_update_next(s);
+    }
+  }
+  (void)gallus_spinlock_unlock(&s->m_tm_lck);
+}
+
+
+static inline void
+s_timer_fire(gallus_fiber_sched_t s) {
+  gallus_fiber_t fs[16];
+  uint64_t ts[16];
+  size_t i, n;
+  gallus_chrono_t now;
+
+  if (__atomic_load_n(&s->m_tm_next, __ATOMIC_ACQUIRE) ==
+      FIBER_NO_DEADLINE) {
+    return;
+  }
+
+  now = gallus_chrono_now();
+
+  do {
+    n = 0;
+    (void)gallus_spinlock_lock(&s->m_tm_lck);
+    {
+      while (s->m_tm_n > 0 && n < sizeof(fs) / sizeof(fs[0]) &&
+             s->m_tm_heap[0]->m_deadline <= now) {
+        fs[n] = s->m_tm_heap[0];
+        ts[n] = fs[n]->m_tm_ticket;
+        n++;
+        s_tm_remove_at(s, 0);
+      }
+      s_tm_update_next(s);
+    }
+    (void)gallus_spinlock_unlock(&s->m_tm_lck);
+
+    /* the records outlive any ticket, waking outside the lock is fine. */
+    for (i = 0; i < n; i++) {
+      (void)s_wake(fs[i], ts[i]);
+    }
+  } while (n == sizeof(fs) / sizeof(fs[0]));
+}
+
+
+
+
+
+/*
+ * descriptors
+ */
+
+
+static inline void
+s_poll(gallus_fiber_sched_t s, gallus_chrono_t to) {
+  struct epoll_event evs[FIBER_POLL_EVENTS];
+  gallus_fiber_t f;
+  int i, n, msec;
+  uint64_t v;
+
+  if (to < 0) {
+    msec = -1;
+  } else if (to > 1000LL * 1000LL * 1000LL) {
+    msec = 1000;
+  } else {
+    msec = (int)((to + 999999LL) / 1000000LL);
+  }
+
+  n = epoll_wait(s->m_epfd, evs, FIBER_POLL_EVENTS, msec);
+  for (i = 0; i < n; i++) {
+    if ((f = (gallus_fiber_t)evs[i].data.ptr) != NULL) {
+      (void)s_wake(f, __atomic_load_n(&f->m_fd_ticket, __ATOMIC_ACQUIRE));
+    } else {
+      ssize_t st = read(s->m_evfd, &v, sizeof(v));
+      (void)st;
+    }
+  }
+}
+
+
+
+
+
+/*
+ * scheduling
+ */
+
+
+static inline void
+s_fiber_recycle(gallus_fiber_t f) {
+  gallus_fiber_sched_t s = f->m_sched;
+
+  (void)gallus_mutex_lock(&s->m_lck);
+  {
+    if (s->m_n_cached < FIBER_STACK_CACHE_MAX) {
+      s->m_n_cached++;
+    } else {
+      (void)munmap(f->m_map, f->m_map_size);
+      f->m_map = NULL;
+    }
+    f->m_next = s->m_free;
+    s->m_free = f;
+
+    if (--s->m_n_live == 0) {
+      (void)gallus_cond_notify(&s->m_cnd, true);
+    }
+  }
+  (void)gallus_mutex_unlock(&s->m_lck);
+}
+
+
+/*
+ * Run in the context switched to: the fiber switched from is off
+ * its stack now, so it's safe to requeue or recycle it.
+ */
+static void
+s_after_switch(fiber_carrier_t c) {
+  fiber_post_t post = c->m_post;
+  gallus_fiber_t f = c->m_post_fiber;
+  uint64_t w;
+
+  c->m_post = FIBER_POST_NONE;
+  c->m_post_fiber = NULL;
+
+  switch (post) {
+    case FIBER_POST_YIELD:
+      s_runq_push(f->m_sched, f);
+      break;
+
+    case FIBER_POST_PARK:
+      w = __atomic_load_n(&f->m_park, __ATOMIC_SEQ_CST);
+      if (PARK_STATE(w) != PARK_PARKING ||
+          __atomic_compare_exchange_n(&f->m_park, &w,
+                                      PARK_WORD(PARK_TICKET(w), PARK_PARKED),
+                                      false, __ATOMIC_SEQ_CST,
+                                      __ATOMIC_SEQ_CST) == false) {
+        /* woken up while parking. */
+        __atomic_store_n(&f->m_park,
+                         PARK_WORD(PARK_TICKET(w), PARK_RUNNING),
+                         __ATOMIC_SEQ_CST);
+        s_runq_push(f->m_sched, f);
+      }
+      break;
+
+    case FIBER_POST_EXIT:
+      s_fiber_recycle(f);
+      break;
+
+    case FIBER_POST_NONE:
+    default:
+      break;
+  }
+}
+
+
+static void
+s_switch_out(gallus_fiber_t self, fiber_post_t post) {
+  fiber_carrier_t c = s_carrier();
+  gallus_fiber_t next = NULL;
+
+  /*
+   * The fiber may resume on another carrier, which must not unlock
+   * what this one locked.
+   */
+  assert(gallus_fiber_n_bound_locks == 0);
+
+  if (c->m_n_direct < FIBER_DIRECT_MAX &&
+      (next = s_runq_pop(self->m_sched)) != NULL) {
+    c->m_n_direct++;
+  }
+
+  c->m_post = post;
+  c->m_post_fiber = self;
+  c->m_cur = next;
+
+  s_ctx_switch(&self->m_ctx, (next != NULL) ? &next->m_ctx : &c->m_ctx);
+
+  s_after_switch(s_carrier());
+}
+
+
+static void
+s_fiber_main(gallus_fiber_t f) {
+  gallus_result_t ret;
+
+  s_after_switch(s_carrier());
+
+  ret = f->m_proc(f->m_arg);
+
+  if (f->m_future != NULL) {
+    (void)gallus_future_complete(&f->m_future, ret, NULL);
+    gallus_future_destroy(&f->m_future);
+  }
+
+  s_switch_out(f, FIBER_POST_EXIT);
+
+  /* not reached. */
+  abort();
+}
+
+
+static inline void
+s_carrier_idle(fiber_carrier_t c) {
+  gallus_fiber_sched_t s = c->m_sched;
+  gallus_chrono_t next, now, to;
+
+  (void)gallus_mutex_lock(&s->m_idle_lck);
+  {
+
+    (void)__atomic_add_fetch(&s->m_n_idle, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&s->m_n_runnable, __ATOMIC_SEQ_CST) == 0 &&
+        s->m_do_stop == false) {
+      next = __atomic_load_n(&s->m_tm_next, __ATOMIC_ACQUIRE);
+      if (next == FIBER_NO_DEADLINE) {
+        to = -1LL;
+      } else {
+        now = gallus_chrono_now();
+        to = (next > now) ? next - now : 0;
+      }
+
+      if (to != 0) {
+        if (s->m_n_fd_waiters > 0 && s->m_is_polling == false) {
+          s->m_is_polling = true;
+          (void)gallus_mutex_unlock(&s->m_idle_lck);
+          s_poll(s, to);
+          (void)gallus_mutex_lock(&s->m_idle_lck);
+          s->m_is_polling = false;
+        } else {
+          s->m_n_cnd_waiters++;
+          (void)gallus_cond_wait(&s->m_idle_cnd, &s->m_idle_lck, to);
+          s->m_n_cnd_waiters--;
+        }
+      }
+    }
+
+    (void)__atomic_sub_fetch(&s->m_n_idle, 1, __ATOMIC_SEQ_CST);
+
+  }
+  (void)gallus_mutex_unlock(&s->m_idle_lck);
+}
+
+
+static gallus_result_t
+s_carrier_main(const gallus_thread_t *tptr, void *arg) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  fiber_carrier_t c;
+
+  (void)arg;
+
+  if (likely(tptr != NULL &&
+             (c = (fiber_carrier_t)*tptr) != NULL)) {
+    gallus_fiber_sched_t s = c->m_sched;
+    gallus_fiber_t f;
+
+    s_carrier_tls = c;
+
+    while (true) {
+      s_after_switch(c);
+      c->m_n_direct = 0;
+
+      s_timer_fire(s);
+      if (s->m_n_fd_waiters > 0 &&
+          (++c->m_n_loops % FIBER_DIRECT_MAX) == 0) {
+        s_poll(s, 0);
+      }
+
+      if ((f = s_runq_pop(s)) != NULL) {
+        c->m_cur = f;
+        s_ctx_switch(&c->m_ctx, &f->m_ctx);
+        continue;
+      }
+
+      if (s->m_do_stop == true) {
+        break;
+      }
+
+      s_carrier_idle(c);
+    }
+
+    s_carrier_tls = NULL;
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+static inline void
+s_carriers_stop(gallus_fiber_sched_t s) {
+  size_t i;
+
+  s->m_do_stop = true;
+  mbar();
+
+  (void)gallus_mutex_lock(&s->m_idle_lck);
+  {
+    uint64_t v = 1;
+    ssize_t st;
+
+    (void)gallus_cond_notify(&s->m_idle_cnd, true);
+    st = write(s->m_evfd, &v, sizeof(v));
+    (void)st;
+  }
+  (void)gallus_mutex_unlock(&s->m_idle_lck);
+
+  for (i = 0; i < s->m_n_carriers; i++) {
+    if (s->m_carriers[i] != NULL) {
+      (void)gallus_thread_wait((gallus_thread_t *)&s->m_carriers[i], -1LL);
+    }
+  }
+
+  s->m_is_stopped = true;
+}
+
+
+
+
+
+gallus_result_t
+gallus_fiber_sched_create(gallus_fiber_sched_t *sptr, const char *name,
+                          size_t n_carriers, size_t stack_size) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_fiber_sched_t s = NULL;
+  struct epoll_event ev;
+  char thdname[16];
+  size_t i;
+
+  if (unlikely(sptr == NULL || n_carriers == 0)) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+  *sptr = NULL;
+
+  s = (gallus_fiber_sched_t)calloc(1, sizeof(*s));
+  if (unlikely(s == NULL)) {
+    return GALLUS_RESULT_NO_MEMORY;
+  }
+  s->m_epfd = -1;
+  s->m_evfd = -1;
+  s->m_tm_next = FIBER_NO_DEADLINE;
+  s->m_page_size = (size_t)sysconf(_SC_PAGESIZE);
+  if (stack_size == 0) {
+    stack_size = GALLUS_FIBER_DEFAULT_STACK_SIZE;
+  }
+  s->m_stack_size = (stack_size + s->m_page_size - 1) &
+                    ~(s->m_page_size - 1);
+  s->m_n_carriers = n_carriers;
+  s->m_is_stopped = true;
+
+  if (unlikely((ret = gallus_spinlock_initialize(&s->m_rq_lck)) !=
+               GALLUS_RESULT_OK ||
+               (ret = gallus_spinlock_initialize(&s->m_tm_lck)) !=
+               GALLUS_RESULT_OK ||
+               (ret = gallus_mutex_create(&s->m_idle_lck)) !=
+               GALLUS_RESULT_OK ||
+               (ret = gallus_cond_create(&s->m_idle_cnd)) !=
+               GALLUS_RESULT_OK ||
+               (ret = gallus_mutex_create(&s->m_lck)) !=
+               GALLUS_RESULT_OK ||
+               (ret = gallus_cond_create(&s->m_cnd)) !=
+               GALLUS_RESULT_OK)) {
+    goto done;
+  }
+
+  if (unlikely((s->m_epfd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+               (s->m_evfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0)) {
+    ret = GALLUS_RESULT_POSIX_API_ERROR;
+    goto done;
+  }
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  if (unlikely(epoll_ctl(s->m_epfd, EPOLL_CTL_ADD, s->m_evfd, &ev) != 0)) {
+    ret = GALLUS_RESULT_POSIX_API_ERROR;
+    goto done;
+  }
+
+  s->m_carriers = (fiber_carrier_t *)calloc(n_carriers,
+                  sizeof(fiber_carrier_t));
+  if (unlikely(s->m_carriers == NULL)) {
+    ret = GALLUS_RESULT_NO_MEMORY;
+    goto done;
+  }
+
+  s->m_is_stopped = false;
+  for (i = 0; i < n_carriers; i++) {
+    snprintf(thdname, sizeof(thdname), "%.9s:%u",
+             (name != NULL) ? name : "fiber", (unsigned int)(i & 0xffff));
+    ret = gallus_thread_create_with_size((gallus_thread_t *)&s->m_carriers[i],
+                                         sizeof(fiber_carrier_record),
+                                         s_carrier_main, NULL, NULL,
+                                         thdname, NULL);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      goto done;
+    }
+    s->m_carriers[i]->m_sched = s;
+    s->m_carriers[i]->m_cur = NULL;
+    s->m_carriers[i]->m_post = FIBER_POST_NONE;
+    s->m_carriers[i]->m_post_fiber = NULL;
+    s->m_carriers[i]->m_n_direct = 0;
+    s->m_carriers[i]->m_n_loops = 0;
+
+    ret = gallus_thread_start((gallus_thread_t *)&s->m_carriers[i], false);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      gallus_thread_destroy((gallus_thread_t *)&s->m_carriers[i]);
+      s->m_carriers[i] = NULL;
+      goto done;
+    }
+  }
+
+done:
+  if (likely(ret == GALLUS_RESULT_OK)) {
+    *sptr = s;
+  } else {
+    gallus_perror(ret);
+    gallus_msg_error("can't create a fiber scheduler.\n");
+    gallus_fiber_sched_destroy(&s);
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_fiber_sched_shutdown(gallus_fiber_sched_t *sptr, gallus_chrono_t nsec) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_fiber_sched_t s = NULL;
+  gallus_fiber_t self = gallus_fiber_self();
+  gallus_chrono_t end = 0;
+
+  if (unlikely(sptr == NULL || (s = *sptr) == NULL)) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+  if (unlikely(self != NULL && self->m_sched == s)) {
+    return GALLUS_RESULT_INVALID_STATE;
+  }
+
+  if (nsec >= 0) {
+    end = gallus_chrono_now() + nsec;
+  }
+
+  (void)gallus_mutex_lock(&s->m_lck);
+  {
+    s->m_is_shutdown = true;
+
+    ret = GALLUS_RESULT_OK;
+    while (s->m_n_live > 0 && ret == GALLUS_RESULT_OK) {
+      if (nsec >= 0) {
+        gallus_chrono_t now = gallus_chrono_now();
+        ret = gallus_cond_wait(&s->m_cnd, &s->m_lck,
+                               (end > now) ? end - now : 0);
+      } else {
+        ret = gallus_cond_wait(&s->m_cnd, &s->m_lck, -1LL);
+      }
+    }
+    if (s->m_n_live > 0) {
+      ret = GALLUS_RESULT_TIMEDOUT;
+    } else {
+      ret = GALLUS_RESULT_OK;
+    }
+  }
+  (void)gallus_mutex_unlock(&s->m_lck);
+
+  if (ret == GALLUS_RESULT_OK && s->m_is_stopped == false) {
+    s_carriers_stop(s);
+  }
+
+  return ret;
+}
+
+
+void
+gallus_fiber_sched_destroy(gallus_fiber_sched_t *sptr) {
+  gallus_fiber_sched_t s = NULL;
+  gallus_fiber_t f;
+  size_t i;
+
+  if (sptr != NULL && (s = *sptr) != NULL) {
+    if (s->m_is_stopped == false) {
+      (void)gallus_fiber_sched_shutdown(sptr, -1LL);
+    }
+
+    if (s->m_carriers != NULL) {
+      for (i = 0; i < s->m_n_carriers; i++) {
+        if (s->m_carriers[i] != NULL) {
+          gallus_thread_destroy((gallus_thread_t *)&s->m_carriers[i]);
+        }
+      }
+      free(s->m_carriers);
+    }
+
+    while ((f = s->m_all) != NULL) {
+      s->m_all = f->m_all_next;
+      if (f->m_map != NULL) {
+        (void)munmap(f->m_map, f->m_map_size);
+      }
+      free(f);
+    }
+    free(s->m_tm_heap);
+
+    if (s->m_evfd >= 0) {
+      (void)close(s->m_evfd);
+    }
+    if (s->m_epfd >= 0) {
+      (void)close(s->m_epfd);
+    }
+    if (s->m_cnd != NULL) {
+      gallus_cond_destroy(&s->m_cnd);
+    }
+    if (s->m_lck != NULL) {
+      gallus_mutex_destroy(&s->m_lck);
+    }
+    if (s->m_idle_cnd != NULL) {
+      gallus_cond_destroy(&s->m_idle_cnd);
+    }
+    if (s->m_idle_lck != NULL) {
+      gallus_mutex_destroy(&s->m_idle_lck);
+    }
+    gallus_spinlock_finalize(&s->m_tm_lck);
+    gallus_spinlock_finalize(&s->m_rq_lck);
+
+    free(s);
+    *sptr = NULL;
+  }
+}
+
+
+static inline gallus_result_t
+s_fiber_alloc(gallus_fiber_sched_t s, gallus_fiber_t *fptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_fiber_t f = NULL;
+
+  (void)gallus_mutex_lock(&s->m_lck);
+  {
+
+    if (unlikely(s->m_is_shutdown == true)) {
+      ret = GALLUS_RESULT_NOT_OPERATIONAL;
+      goto unlock;
+    }
+
+    if ((f = s->m_free) != NULL) {
+      s->m_free = f->m_next;
+      if (f->m_map != NULL) {
+        s->m_n_cached--;
+      }
+    } else {
+      gallus_fiber_t *heap = NULL;
+
+      /* keep a timer heap slot for every fiber. */
+      if (s->m_tm_max <= s->m_n_fibers) {
+        size_t n = (s->m_tm_max == 0) ? 64 : s->m_tm_max * 2;
+
+        (void)gallus_spinlock_lock(&s->m_tm_lck);
+        {
+          heap = (gallus_fiber_t *)realloc(s->m_tm_heap, n * sizeof(*heap));
+          if (likely(heap != NULL)) {
+            s->m_tm_heap = heap;
+            s->m_tm_max = n;
+          }
+        }
+        (void)gallus_spinlock_unlock(&s->m_tm_lck);
+        if (unlikely(heap == NULL)) {
+          ret = GALLUS_RESULT_NO_MEMORY;
+          goto unlock;
+        }
+      }
+
+      f = (gallus_fiber_t)calloc(1, sizeof(*f));
+      if (unlikely(f == NULL)) {
+        ret = GALLUS_RESULT_NO_MEMORY;
+        goto unlock;
+      }
+      f->m_sched = s;
+      f->m_park = PARK_WORD(0ULL, PARK_RUNNING);
+      f->m_tm_idx = FIBER_TIMER_NONE;
+      f->m_all_next = s->m_all;
+      s->m_all = f;
+      s->m_n_fibers++;
+    }
+
+    if (f->m_map == NULL) {
+      f->m_map_size = s->m_stack_size + s->m_page_size;
+      f->m_map = (uint8_t *)mmap(NULL, f->m_map_size,
+                                 PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,
+                                 -1, 0);
+      if (unlikely(f->m_map == (uint8_t *)MAP_FAILED)) {
+        f->m_map = NULL;
+      } else if (unlikely(mprotect(f->m_map, s->m_page_size,
+                                   PROT_NONE) != 0)) {
+        (void)munmap(f->m_map, f->m_map_size);
+        f->m_map = NULL;
+      }
+      if (unlikely(f->m_map == NULL)) {
+        f->m_next = s->m_free;
+        s->m_free = f;
+        ret = GALLUS_RESULT_NO_MEMORY;
+        goto unlock;
+      }
+    }
+
+    s->m_n_live++;
+    *fptr = f;
+    ret = GALLUS_RESULT_OK;
+
+  unlock:
+    ;
+  }
+  (void)gallus_mutex_unlock(&s->m_lck);
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_fiber_spawn(gallus_fiber_sched_t *sptr, gallus_fiber_proc_t proc,
+                   void *arg, gallus_future_t *fptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_fiber_sched_t s = NULL;
+  gallus_fiber_t f = NULL;
+  gallus_future_t fu = NULL;
+
+  if (unlikely(sptr == NULL || (s = *sptr) == NULL || proc == NULL)) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  if (fptr != NULL) {
+    ret = gallus_future_create(&fu);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      return ret;
+    }
+  }
+
+  ret = s_fiber_alloc(s, &f);
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    if (fu != NULL) {
+      gallus_future_destroy(&fu);
+    }
+    return ret;
+  }
+
+  f->m_proc = proc;
+  f->m_arg = arg;
+  f->m_future = NULL;
+  if (fu != NULL) {
+    (void)gallus_future_share(&fu, &f->m_future);
+    *fptr = fu;
+  }
+  s_ctx_init(f, f->m_map + s->m_page_size, s->m_stack_size);
+
+  s_runq_push(s, f);
+
+  return GALLUS_RESULT_OK;
+}
+
+
+gallus_fiber_t
+gallus_fiber_self(void) {
+  fiber_carrier_t c = s_carrier();
+
+  return (c != NULL) ? c->m_cur : NULL;
+}
+
+
+gallus_result_t
+gallus_fiber_yield(void) {
+  fiber_carrier_t c = s_carrier();
+  gallus_fiber_t self;
+
+  if (c == NULL || (self = c->m_cur) == NULL) {
+    (void)sched_yield();
+    return GALLUS_RESULT_OK;
+  }
+
+  /*
+   * Nothing else to run: just go on, but let the carrier loop see
+   * the timers and the descriptors now and then.
+   */
+  if (__atomic_load_n(&self->m_sched->m_rq_head, __ATOMIC_ACQUIRE) == NULL &&
+      c->m_n_direct < FIBER_DIRECT_MAX) {
+    c->m_n_direct++;
+    return GALLUS_RESULT_OK;
+  }
+
+  s_switch_out(self, FIBER_POST_YIELD);
+
+  return GALLUS_RESULT_OK;
+}
+
+
+gallus_result_t
+gallus_fiber_sleep(gallus_chrono_t nsec) {
+  gallus_fiber_t self = gallus_fiber_self();
+  gallus_chrono_t deadline;
+
+  if (unlikely(nsec < 0)) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+  if (self == NULL) {
+    return gallus_chrono_nanosleep(nsec, NULL);
+  }
+
+  deadline = gallus_chrono_now() + nsec;
+  do {
+    s_timer_add(self, s_park_begin(self), deadline);
+    s_switch_out(self, FIBER_POST_PARK);
+    s_timer_del(self);
+  } while (gallus_chrono_now() < deadline);
+
+  return GALLUS_RESULT_OK;
+}
+
+
+static inline uint32_t
+s_epoll_events(short events) {
+  uint32_t ret = EPOLLONESHOT;
+
+  if ((events & POLLIN) != 0) {
+    ret |= EPOLLIN;
+  }
+  if ((events & POLLOUT) != 0) {
+    ret |= EPOLLOUT;
+  }
+  if ((events & POLLPRI) != 0) {
+    ret |= EPOLLPRI;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_fiber_wait_fd(int fd, short events, gallus_chrono_t nsec) {
+  gallus_fiber_t self = gallus_fiber_self();
+  gallus_fiber_sched_t s;
+  gallus_chrono_t deadline = -1LL;
+  struct pollfd pfd;
+  struct epoll_event ev;
+  uint64_t ticket;
+  int n;
+
+  if (unlikely(fd < 0 || events == 0)) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  if (nsec >= 0) {
+    deadline = gallus_chrono_now() + nsec;
+  }
+
+  while (true) {
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    n = poll(&pfd, 1, (self != NULL) ? 0 :
+             (nsec < 0) ? -1 : (int)((nsec + 999999LL) / 1000000LL));
+    if (n > 0) {
+      return (gallus_result_t)pfd.revents;
+    } else if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return GALLUS_RESULT_POSIX_API_ERROR;
+    }
+    if (self == NULL ||
+        (deadline >= 0 && gallus_chrono_now() >= deadline)) {
+      return GALLUS_RESULT_TIMEDOUT;
+    }
+
+    s = self->m_sched;
+    ticket = s_park_begin(self);
+    __atomic_store_n(&self->m_fd_ticket, ticket, __ATOMIC_RELEASE);
+
+    ev.events = s_epoll_events(events);
+    ev.data.ptr = self;
+    if (unlikely(epoll_ctl(s->m_epfd, EPOLL_CTL_ADD, fd, &ev) != 0)) {
+      s_park_cancel(self, ticket);
+      if (errno == EEXIST) {
+        /* another fiber waits on the fd, fall back to polling. */
+        (void)gallus_fiber_sleep(1000LL * 1000LL);
+        continue;
+      }
+      return GALLUS_RESULT_POSIX_API_ERROR;
+    }
+    (void)__atomic_add_fetch(&s->m_n_fd_waiters, 1, __ATOMIC_SEQ_CST);
+    if (deadline >= 0) {
+      s_timer_add(self, ticket, deadline);
+    }
+
+    s_switch_out(self, FIBER_POST_PARK);
+
+    if (deadline >= 0) {
+      s_timer_del(self);
+    }
+    (void)epoll_ctl(s->m_epfd, EPOLL_CTL_DEL, fd, NULL);
+    (void)__atomic_sub_fetch(&s->m_n_fd_waiters, 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+
+
+
+
+/*
+ * gallus_cond_t support
+ */
+
+
+gallus_result_t
+gallus_fiber_waitq_initialize(gallus_fiber_waitq_t q) {
+  q->m_head = NULL;
+  q->m_tail = NULL;
+
+  return gallus_spinlock_initialize(&q->m_lck);
+}
+
+
+void
+gallus_fiber_waitq_finalize(gallus_fiber_waitq_t q) {
+  gallus_spinlock_finalize(&q->m_lck);
+}
+
+
+static inline void
+s_waitq_unlink(gallus_fiber_waitq_t q, gallus_fiber_waiter_record *w) {
+  if (w->m_prev != NULL) {
+    w->m_prev->m_next = w->m_next;
+  } else {
+    __atomic_store_n(&q->m_head, w->m_next, __ATOMIC_RELEASE);
+  }
+  if (w->m_next != NULL) {
+    w->m_next->m_prev = w->m_prev;
+  } else {
+    q->m_tail = w->m_prev;
+  }
+  w->m_next = NULL;
+  w->m_prev = NULL;
+  w->m_is_linked = false;
+}
+
+
+gallus_result_t
+gallus_fiber_waitq_wait(gallus_fiber_waitq_t q, gallus_mutex_t *mtxptr,
+                        gallus_chrono_t nsec) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_fiber_t self = gallus_fiber_self();
+  gallus_fiber_waiter_record w;
+
+  if (unlikely(self == NULL)) {
+    return GALLUS_RESULT_INVALID_STATE;
+  }
+
+  w.m_fiber = self;
+  w.m_ticket = s_park_begin(self);
+  w.m_next = NULL;
+  w.m_is_linked = true;
+
+  (void)gallus_spinlock_lock(&q->m_lck);
+  {
+    w.m_prev = q->m_tail;
+    if (q->m_tail != NULL) {
+      q->m_tail->m_next = &w;
+    } else {
+      __atomic_store_n(&q->m_head, &w, __ATOMIC_RELEASE);
+    }
+    q->m_tail = &w;
+  }
+  (void)gallus_spinlock_unlock(&q->m_lck);
+
+  if (nsec >= 0) {
+    s_timer_add(self, w.m_ticket, gallus_chrono_now() + nsec);
+  }
+
+  (void)gallus_mutex_unlock(mtxptr);
+
+  s_switch_out(self, FIBER_POST_PARK);
+
+  if (nsec >= 0) {
+    s_timer_del(self);
+  }
+
+  (void)gallus_spinlock_lock(&q->m_lck);
+  {
+    if (w.m_is_linked == true) {
+      s_waitq_unlink(q, &w);
+      ret = GALLUS_RESULT_TIMEDOUT;
+    } else {
+      ret = GALLUS_RESULT_OK;
+    }
+  }
+  (void)gallus_spinlock_unlock(&q->m_lck);
+
+  (void)gallus_mutex_lock(mtxptr);
+
+  return ret;
+}
+
+
+void
+gallus_fiber_waitq_notify(gallus_fiber_waitq_t q, bool for_all) {
+  gallus_fiber_waiter_record *w;
+
+  if (__atomic_load_n(&q->m_head, __ATOMIC_ACQUIRE) == NULL) {
+    return;
+  }
+
+  /*
+   * Wake under the lock: the records are on the stacks of the
+   * waiters, which can't leave before they take the lock.
+   */
+  (void)gallus_spinlock_lock(&q->m_lck);
+  {
+    while ((w = q->m_head) != NULL) {
+      s_waitq_unlink(q, w);
+      (void)s_wake(w->m_fiber, w->m_ticket);
+      if (for_all == false) {
+        break;
+      }
+    }
+  }
+  (void)gallus_spinlock_unlock(&q->m_lck);
+}
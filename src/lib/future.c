@@ -0,0 +1,897 @@
+#include "gallus_apis.h"
+#include "gallus_task_internal.h"
+
+
+
+
+
+#define NODE_MODE_ALL	0
+#define NODE_MODE_ANY	1
+
+
+typedef struct future_node_record *future_node_t;
+
+
+/*
+ * A waiter is a node registered to one of its input futures.
+ */
+typedef struct future_waiter_record {
+  struct future_waiter_record *m_next;
+  future_node_t m_node;
+  size_t m_idx;
+} future_waiter_record;
+typedef future_waiter_record *future_waiter_t;
+
+
+typedef struct gallus_future_record {
+  gallus_mutex_t m_lck;
+  gallus_cond_t m_cnd;
+
+  size_t m_n_refs;		/* atomic */
+
+  volatile bool m_is_done;
+  gallus_result_t m_result;
+  void *m_value;
+
+  future_waiter_t m_waiters;
+} gallus_future_record;
+
+
+/*
+ * A node completes its output future once its inputs are completed
+ * (all of them, or the first one.) It lives as long as it is
+ * registered to an input or its proc is queued or running.
+ */
+typedef struct future_node_record {
+  size_t m_n_refs;		/* atomic */
+
+  int m_mode;
+  bool m_skip_on_error;
+  size_t m_n_pending;		/* atomic */
+  bool m_is_fired;		/* atomic, NODE_MODE_ANY */
+  size_t m_first;
+
+  gallus_future_proc_t m_proc;
+  void *m_arg;
+  gallus_thread_pool_t m_pool;
+
+  gallus_future_t *m_inputs;
+  size_t m_n_inputs;
+  gallus_future_t m_out;
+} future_node_record;
+
+
+typedef struct future_node_task_record {
+  gallus_task_record m_task;	/* must be on the head. */
+
+  future_node_t m_node;
+} future_node_task_record;
+typedef future_node_task_record *future_node_task_t;
+
+
+typedef struct task_graph_node_record {
+  gallus_future_proc_t m_proc;
+  void *m_arg;
+  size_t *m_deps;
+  size_t m_n_deps;
+  gallus_future_t m_future;
+} task_graph_node_record;
+
+
+typedef struct gallus_task_graph_record {
+  gallus_thread_pool_t m_pool;
+  task_graph_node_record *m_nodes;
+  size_t m_n_nodes;
+  size_t m_n_allocd;
+  bool m_is_run;
+  gallus_future_t m_all;
+} gallus_task_graph_record;
+
+
+
+
+
+static void	s_node_input_done(future_node_t n, size_t idx);
+
+
+
+
+
+static inline gallus_future_t
+s_future_ref(gallus_future_t f) {
+  (void)__atomic_add_fetch(&f->m_n_refs, 1, __ATOMIC_RELAXED);
+  return f;
+}
+
+
+static inline void
+s_future_unref(gallus_future_t f) {
+  if (__atomic_sub_fetch(&f->m_n_refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    if (f->m_cnd != NULL) {
+      gallus_cond_destroy(&f->m_cnd);
+    }
+    if (f->m_lck != NULL) {
+      gallus_mutex_destroy(&f->m_lck);
+    }
+    free(f);
+  }
+}
+
+
+static inline gallus_result_t
+s_future_add_waiter(gallus_future_t f, future_node_t n, size_t idx) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  future_waiter_t w = NULL;
+  bool is_done = false;
+
+  w = (future_waiter_t)malloc(sizeof(*w));
+  if (unlikely(w == NULL)) {
+    return GALLUS_RESULT_NO_MEMORY;
+  }
+  w->m_node = n;
+  w->m_idx = idx;
+
+  (void)gallus_mutex_lock(&f->m_lck);
+  {
+    if ((is_done = f->m_is_done) == false) {
+      w->m_next = f->m_waiters;
+      f->m_waiters = w;
+    }
+  }
+  (void)gallus_mutex_unlock(&f->m_lck);
+
+  if (is_done == true) {
+    free(w);
+    s_node_input_done(n, idx);
+  }
+  ret = GALLUS_RESULT_OK;
+
+  return ret;
+}
+
+
+
+
+
+static inline void
+s_node_unref(future_node_t n) {
+  size_t i;
+
+  if (__atomic_sub_fetch(&n->m_n_refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    for (i = 0; i < n->m_n_inputs; i++) {
+      s_future_unref(n->m_inputs[i]);
+    }
+    free(n->m_inputs);
+    s_future_unref(n->m_out);
+    free(n);
+  }
+}
+
+
+static inline void
+s_node_exec(future_node_t n) {
+  gallus_result_t r;
+  void *val = NULL;
+
+  r = n->m_proc(n->m_inputs, n->m_n_inputs, n->m_arg, &val);
+  (void)gallus_future_complete(&n->m_out, r, val);
+}
+
+
+static gallus_result_t
+s_node_task_main(gallus_task_t *tptr) {
+  future_node_task_t nt = NULL;
+
+  if (likely(tptr != NULL && (nt = (future_node_task_t)*tptr) != NULL)) {
+    s_node_exec(nt->m_node);
+    s_node_unref(nt->m_node);
+    return GALLUS_RESULT_OK;
+  }
+
+  return GALLUS_RESULT_INVALID_ARGS;
+}
+
+
+static void
+s_node_fire(future_node_t n) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_result_t r;
+  gallus_task_t t = NULL;
+  size_t i;
+
+  if (n->m_proc == NULL) {
+    if (n->m_mode == NODE_MODE_ANY) {
+      r = (gallus_result_t)n->m_first;
+    } else {
+      r = GALLUS_RESULT_OK;
+      for (i = 0; i < n->m_n_inputs; i++) {
+        if (n->m_inputs[i]->m_result < 0) {
+          r = n->m_inputs[i]->m_result;
+          break;
+        }
+      }
+    }
+    (void)gallus_future_complete(&n->m_out, r, NULL);
+    return;
+  }
+
+  if (n->m_skip_on_error == true) {
+    for (i = 0; i < n->m_n_inputs; i++) {
+      if (n->m_inputs[i]->m_result < 0) {
+        (void)gallus_future_complete(&n->m_out, n->m_inputs[i]->m_result,
+                                     NULL);
+        return;
+      }
+    }
+  }
+
+  if (n->m_pool == NULL) {
+    s_node_exec(n);
+    return;
+  }
+
+  /*
+   * Hand it to the pool; the task holds a node reference.
+   */
+  ret = gallus_task_create(&t, sizeof(future_node_task_record), NULL,
+                           s_node_task_main, NULL, NULL);
+  if (likely(ret == GALLUS_RESULT_OK)) {
+    ((future_node_task_t)t)->m_node = n;
+    (void)__atomic_add_fetch(&n->m_n_refs, 1, __ATOMIC_RELAXED);
+    ret = gallus_task_submit(&t, &n->m_pool,
+                             GALLUS_TASK_DELETE_CONTEXT_AFTER_EXEC);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      gallus_task_destroy(&t);
+      (void)__atomic_sub_fetch(&n->m_n_refs, 1, __ATOMIC_RELAXED);
+    }
+  }
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    (void)gallus_future_complete(&n->m_out, ret, NULL);
+  }
+}
+
+
+static void
+s_node_input_done(future_node_t n, size_t idx) {
+  if (n->m_mode == NODE_MODE_ANY) {
+    bool expected = false;
+    if (__atomic_compare_exchange_n(&n->m_is_fired, &expected, true, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      n->m_first = idx;
+      s_node_fire(n);
+    }
+  } else {
+    if (__atomic_sub_fetch(&n->m_n_pending, 1, __ATOMIC_ACQ_REL) == 0) {
+      s_node_fire(n);
+    }
+  }
+
+  s_node_unref(n);
+}
+
+
+static gallus_result_t
+s_node_create(gallus_future_t *fs, size_t n_fs, int mode, bool skip_on_error,
+              gallus_thread_pool_t *pptr,
+              gallus_future_proc_t proc, void *arg,
+              gallus_future_t out) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  future_node_t n = NULL;
+  size_t i;
+
+  n = (future_node_t)calloc(1, sizeof(*n));
+  if (unlikely(n == NULL)) {
+    return GALLUS_RESULT_NO_MEMORY;
+  }
+  n->m_inputs = (gallus_future_t *)malloc(sizeof(gallus_future_t) * n_fs);
+  if (unlikely(n->m_inputs == NULL)) {
+    free(n);
+    return GALLUS_RESULT_NO_MEMORY;
+  }
+  for (i = 0; i < n_fs; i++) {
+    n->m_inputs[i] = s_future_ref(fs[i]);
+  }
+  n->m_n_inputs = n_fs;
+  n->m_mode = mode;
+  n->m_skip_on_error = skip_on_error;
+  n->m_n_pending = n_fs;
+  n->m_is_fired = false;
+  n->m_first = 0;
+  n->m_proc = proc;
+  n->m_arg = arg;
+  n->m_pool = (pptr != NULL) ? *pptr : NULL;
+  n->m_out = s_future_ref(out);
+
+  /*
+   * One reference per registration plus ours, so that inputs already
+   * completed can't free the node under the loop.
+   */
+  n->m_n_refs = n_fs + 1;
+
+  for (i = 0; i < n_fs; i++) {
+    ret = s_future_add_waiter(n->m_inputs[i], n, i);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      /*
+       * Only allocation failure; the node is half registered, so it
+       * can't be fired properly any more.
+       */
+      gallus_msg_error("can't register a future continuation.\n");
+      break;
+    }
+  }
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    (void)__atomic_sub_fetch(&n->m_n_refs, n_fs - i, __ATOMIC_ACQ_REL);
+    (void)gallus_future_complete(&n->m_out, ret, NULL);
+  }
+
+  s_node_unref(n);
+
+  return ret;
+}
+
+
+
+
+
+gallus_result_t
+gallus_future_create(gallus_future_t *fptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_future_t f = NULL;
+
+  if (likely(fptr != NULL)) {
+    *fptr = NULL;
+
+    f = (gallus_future_t)calloc(1, sizeof(*f));
+    if (unlikely(f == NULL)) {
+      ret = GALLUS_RESULT_NO_MEMORY;
+      goto done;
+    }
+    if (unlikely((ret = gallus_mutex_create(&f->m_lck)) !=
+                 GALLUS_RESULT_OK)) {
+      goto done;
+    }
+    if (unlikely((ret = gallus_cond_create(&f->m_cnd)) !=
+                 GALLUS_RESULT_OK)) {
+      goto done;
+    }
+    f->m_n_refs = 1;
+    f->m_is_done = false;
+    f->m_result = GALLUS_RESULT_NOT_STARTED;
+    f->m_value = NULL;
+    f->m_waiters = NULL;
+
+    *fptr = f;
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+done:
+  if (unlikely(ret != GALLUS_RESULT_OK && f != NULL)) {
+    gallus_perror(ret);
+    gallus_msg_error("can't create a future.\n");
+    s_future_unref(f);
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_future_complete(gallus_future_t *fptr, gallus_result_t result,
+                       void *val) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_future_t f = NULL;
+  future_waiter_t w = NULL;
+  future_waiter_t nw = NULL;
+
+  if (likely(fptr != NULL && (f = *fptr) != NULL)) {
+
+    (void)gallus_mutex_lock(&f->m_lck);
+    {
+
+      if (likely(f->m_is_done == false)) {
+        f->m_result = result;
+        f->m_value = val;
+        f->m_is_done = true;
+        w = f->m_waiters;
+        f->m_waiters = NULL;
+        (void)gallus_cond_notify(&f->m_cnd, true);
+        ret = GALLUS_RESULT_OK;
+      } else {
+        ret = GALLUS_RESULT_ALREADY_HALTED;
+      }
+
+    }
+    (void)gallus_mutex_unlock(&f->m_lck);
+
+    /*
+     * The continuations run out of the lock, and may drop the last
+     * reference but the caller's.
+     */
+    while (w != NULL) {
+      nw = w->m_next;
+      s_node_input_done(w->m_node, w->m_idx);
+      free(w);
+      w = nw;
+    }
+
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_future_wait(gallus_future_t *fptr, gallus_chrono_t to) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_future_t f = NULL;
+  gallus_chrono_t deadline = -1LL;
+  gallus_chrono_t now = 0;
+
+  if (likely(fptr != NULL && (f = *fptr) != NULL)) {
+
+    if (f->m_is_done == true) {
+      return GALLUS_RESULT_OK;
+    }
+
+    /*
+     * Wake-ups don't restart the timeout, wait for what is left of it.
+     */
+    if (to >= 0) {
+      WHAT_TIME_IS_IT_NOW_IN_NSEC(deadline);
+      deadline += to;
+    }
+
+    (void)gallus_mutex_lock(&f->m_lck);
+    {
+
+      ret = GALLUS_RESULT_OK;
+      while (f->m_is_done == false) {
+        if (deadline >= 0) {
+          WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+          if (now >= deadline) {
+            ret = GALLUS_RESULT_TIMEDOUT;
+            break;
+          }
+        }
+        ret = gallus_cond_wait(&f->m_cnd, &f->m_lck,
+                               (deadline >= 0) ? deadline - now : -1LL);
+        if (unlikely(ret != GALLUS_RESULT_OK)) {
+          break;
+        }
+      }
+
+    }
+    (void)gallus_mutex_unlock(&f->m_lck);
+
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+bool
+gallus_future_is_done(gallus_future_t *fptr) {
+  return (fptr != NULL && *fptr != NULL && (*fptr)->m_is_done == true) ?
+         true : false;
+}
+
+
+gallus_result_t
+gallus_future_get_result(gallus_future_t *fptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_future_t f = NULL;
+
+  if (likely(fptr != NULL && (f = *fptr) != NULL)) {
+
+    (void)gallus_mutex_lock(&f->m_lck);
+    {
+      ret = (f->m_is_done == true) ? f->m_result : GALLUS_RESULT_NOT_STARTED;
+    }
+    (void)gallus_mutex_unlock(&f->m_lck);
+
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_future_get_value(gallus_future_t *fptr, void **valptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_future_t f = NULL;
+
+  if (likely(fptr != NULL && (f = *fptr) != NULL && valptr != NULL)) {
+
+    (void)gallus_mutex_lock(&f->m_lck);
+    {
+      if (f->m_is_done == true) {
+        *valptr = f->m_value;
+        ret = GALLUS_RESULT_OK;
+      } else {
+        ret = GALLUS_RESULT_NOT_STARTED;
+      }
+    }
+    (void)gallus_mutex_unlock(&f->m_lck);
+
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_future_then(gallus_future_t *fptr, gallus_thread_pool_t *pptr,
+                   gallus_future_proc_t proc, void *arg,
+                   gallus_future_t *outptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(fptr != NULL && *fptr != NULL && proc != NULL &&
+             outptr != NULL)) {
+    ret = gallus_future_create(outptr);
+    if (likely(ret == GALLUS_RESULT_OK)) {
+      ret = s_node_create(fptr, 1, NODE_MODE_ALL, false, pptr, proc, arg,
+                          *outptr);
+      if (unlikely(ret != GALLUS_RESULT_OK)) {
+        gallus_future_destroy(outptr);
+      }
+    }
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_future_when_all(gallus_future_t *fs, size_t n,
+                       gallus_future_t *outptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(fs != NULL && n > 0 && outptr != NULL)) {
+    ret = gallus_future_create(outptr);
+    if (likely(ret == GALLUS_RESULT_OK)) {
+      ret = s_node_create(fs, n, NODE_MODE_ALL, false, NULL, NULL, NULL,
+                          *outptr);
+      if (unlikely(ret != GALLUS_RESULT_OK)) {
+        gallus_future_destroy(outptr);
+      }
+    }
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_future_when_any(gallus_future_t *fs, size_t n,
+                       gallus_future_t *outptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(fs != NULL && n > 0 && outptr != NULL)) {
+    ret = gallus_future_create(outptr);
+    if (likely(ret == GALLUS_RESULT_OK)) {
+      ret = s_node_create(fs, n, NODE_MODE_ANY, false, NULL, NULL, NULL,
+                          *outptr);
+      if (unlikely(ret != GALLUS_RESULT_OK)) {
+        gallus_future_destroy(outptr);
+      }
+    }
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_future_share(gallus_future_t *fptr, gallus_future_t *outptr) {
+  if (likely(fptr != NULL && *fptr != NULL && outptr != NULL)) {
+    *outptr = s_future_ref(*fptr);
+    return GALLUS_RESULT_OK;
+  }
+
+  return GALLUS_RESULT_INVALID_ARGS;
+}
+
+
+void
+gallus_future_destroy(gallus_future_t *fptr) {
+  if (fptr != NULL && *fptr != NULL) {
+    s_future_unref(*fptr);
+    *fptr = NULL;
+  }
+}
+
+
+gallus_result_t
+gallus_task_submit_future(gallus_task_t *tptr, gallus_thread_pool_t *pptr,
+                          int flag, gallus_future_t *fptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_task_t t = NULL;
+  gallus_future_t f = NULL;
+  gallus_future_t of = NULL;
+
+  if (likely(tptr != NULL && (t = *tptr) != NULL && fptr != NULL)) {
+
+    ret = gallus_future_create(&f);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      return ret;
+    }
+
+    (void)gallus_mutex_lock(&t->m_lck);
+    {
+      of = t->m_future;
+      t->m_future = s_future_ref(f);
+    }
+    (void)gallus_mutex_unlock(&t->m_lck);
+    if (of != NULL) {
+      s_future_unref(of);
+    }
+
+    ret = gallus_task_submit(tptr, pptr, flag);
+    if (likely(ret == GALLUS_RESULT_OK)) {
+      *fptr = f;
+    } else {
+      (void)gallus_mutex_lock(&t->m_lck);
+      {
+        t->m_future = NULL;
+      }
+      (void)gallus_mutex_unlock(&t->m_lck);
+      s_future_unref(f);
+      s_future_unref(f);
+    }
+
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+
+
+
+gallus_result_t
+gallus_task_graph_create(gallus_task_graph_t *gptr,
+                         gallus_thread_pool_t *pptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_task_graph_t g = NULL;
+
+  if (likely(gptr != NULL && pptr != NULL && *pptr != NULL)) {
+    g = (gallus_task_graph_t)calloc(1, sizeof(*g));
+    if (likely(g != NULL)) {
+      g->m_pool = *pptr;
+      g->m_nodes = NULL;
+      g->m_n_nodes = 0;
+      g->m_n_allocd = 0;
+      g->m_is_run = false;
+      g->m_all = NULL;
+      *gptr = g;
+      ret = GALLUS_RESULT_OK;
+    } else {
+      ret = GALLUS_RESULT_NO_MEMORY;
+    }
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_task_graph_add(gallus_task_graph_t *gptr,
+                      gallus_future_proc_t proc, void *arg,
+                      const size_t *deps, size_t n_deps,
+                      size_t *idptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_task_graph_t g = NULL;
+  task_graph_node_record *gn = NULL;
+  size_t i;
+
+  if (likely(gptr != NULL && (g = *gptr) != NULL && proc != NULL &&
+             (deps != NULL || n_deps == 0))) {
+
+    if (unlikely(g->m_is_run == true)) {
+      return GALLUS_RESULT_INVALID_STATE;
+    }
+    for (i = 0; i < n_deps; i++) {
+      if (unlikely(deps[i] >= g->m_n_nodes)) {
+        return GALLUS_RESULT_NOT_FOUND;
+      }
+    }
+
+    if (g->m_n_nodes == g->m_n_allocd) {
+      size_t n_allocd = (g->m_n_allocd == 0) ? 16 : g->m_n_allocd * 2;
+      task_graph_node_record *nodes = (task_graph_node_record *)
+                                      realloc(g->m_nodes,
+                                              sizeof(*nodes) * n_allocd);
+      if (unlikely(nodes == NULL)) {
+        return GALLUS_RESULT_NO_MEMORY;
+      }
+      g->m_nodes = nodes;
+      g->m_n_allocd = n_allocd;
+    }
+
+    gn = &g->m_nodes[g->m_n_nodes];
+    gn->m_proc = proc;
+    gn->m_arg = arg;
+    gn->m_n_deps = n_deps;
+    gn->m_deps = NULL;
+    gn->m_future = NULL;
+    if (n_deps > 0) {
+      gn->m_deps = (size_t *)malloc(sizeof(size_t) * n_deps);
+      if (unlikely(gn->m_deps == NULL)) {
+        return GALLUS_RESULT_NO_MEMORY;
+      }
+      (void)memcpy(gn->m_deps, deps, sizeof(size_t) * n_deps);
+    }
+    ret = gallus_future_create(&gn->m_future);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      free(gn->m_deps);
+      return ret;
+    }
+
+    if (idptr != NULL) {
+      *idptr = g->m_n_nodes;
+    }
+    g->m_n_nodes++;
+
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_task_graph_run(gallus_task_graph_t *gptr, gallus_chrono_t to) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_task_graph_t g = NULL;
+  gallus_future_t start = NULL;
+  gallus_future_t *fs = NULL;
+  gallus_future_t all = NULL;
+  task_graph_node_record *gn = NULL;
+  size_t max_deps = 1;
+  size_t i, j;
+
+  if (unlikely(gptr == NULL || (g = *gptr) == NULL)) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+  if (unlikely(g->m_is_run == true)) {
+    return GALLUS_RESULT_INVALID_STATE;
+  }
+  if (g->m_n_nodes == 0) {
+    g->m_is_run = true;
+    return GALLUS_RESULT_OK;
+  }
+
+  for (i = 0; i < g->m_n_nodes; i++) {
+    if (g->m_nodes[i].m_n_deps > max_deps) {
+      max_deps = g->m_nodes[i].m_n_deps;
+    }
+  }
+  if (unlikely((ret = gallus_future_create(&start)) != GALLUS_RESULT_OK)) {
+    return ret;
+  }
+  fs = (gallus_future_t *)malloc(sizeof(gallus_future_t) *
+                                 ((g->m_n_nodes > max_deps) ?
+                                  g->m_n_nodes : max_deps));
+  if (unlikely(fs == NULL)) {
+    ret = GALLUS_RESULT_NO_MEMORY;
+    goto done;
+  }
+
+  /*
+   * Wire everything up behind a start future so that no node runs
+   * before the whole graph is registered.
+   */
+  g->m_is_run = true;
+  for (i = 0; i < g->m_n_nodes; i++) {
+    gn = &g->m_nodes[i];
+    if (gn->m_n_deps == 0) {
+      ret = s_node_create(&start, 1, NODE_MODE_ALL, true, &g->m_pool,
+                          gn->m_proc, gn->m_arg, gn->m_future);
+    } else {
+      for (j = 0; j < gn->m_n_deps; j++) {
+        fs[j] = g->m_nodes[gn->m_deps[j]].m_future;
+      }
+      ret = s_node_create(fs, gn->m_n_deps, NODE_MODE_ALL, true, &g->m_pool,
+                          gn->m_proc, gn->m_arg, gn->m_future);
+    }
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      break;
+    }
+  }
+
+  for (i = 0; i < g->m_n_nodes; i++) {
+    fs[i] = g->m_nodes[i].m_future;
+  }
+  if (likely(ret == GALLUS_RESULT_OK)) {
+    ret = gallus_future_when_all(fs, g->m_n_nodes, &all);
+  }
+
+  /*
+   * Fire the roots even on failure, the registered nodes complete
+   * with the failure then.
+   */
+  (void)gallus_future_complete(&start,
+                               (ret == GALLUS_RESULT_OK) ?
+                               GALLUS_RESULT_OK : ret, NULL);
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    goto done;
+  }
+
+  g->m_all = all;
+  ret = gallus_future_wait(&all, to);
+  if (likely(ret == GALLUS_RESULT_OK)) {
+    ret = gallus_future_get_result(&all);
+  }
+
+done:
+  free(fs);
+  gallus_future_destroy(&start);
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_task_graph_get_future(gallus_task_graph_t *gptr, size_t id,
+                             gallus_future_t *fptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_task_graph_t g = NULL;
+
+  if (likely(gptr != NULL && (g = *gptr) != NULL && fptr != NULL)) {
+    if (likely(id < g->m_n_nodes)) {
+      *fptr = g->m_nodes[id].m_future;
+      ret = GALLUS_RESULT_OK;
+    } else {
+      ret = GALLUS_RESULT_NOT_FOUND;
+    }
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+void
+gallus_task_graph_destroy(gallus_task_graph_t *gptr) {
+  gallus_task_graph_t g = NULL;
+  size_t i;
+
+  if (gptr != NULL && (g = *gptr) != NULL) {
+    if (g->m_all != NULL) {
+      /*
+       * The nodes refer to their args; let them all finish.
+       */
+      (void)gallus_future_wait(&g->m_all, -1LL);
+      gallus_future_destroy(&g->m_all);
+    }
+    for (i = 0; i < g->m_n_nodes; i++) {
+      free(g->m_nodes[i].m_deps);
+      gallus_future_destroy(&g->m_nodes[i].m_future);
+    }
+    free(g->m_nodes);
+    free(g);
+    *gptr = NULL;
+  }
+}
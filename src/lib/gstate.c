@@ -1,4 +1,45 @@
 #include "gallus_apis.h"
+#include "gallus_fiber_internal.h"
+
+#ifdef GALLUS_OS_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif /* GALLUS_OS_LINUX */
+
+
+
+
+
+/*
+ * A thread waiting for the global state. Each waiter links a record
+ * on its stack and sleeps on its own futex word so that a transition
+ * wakes only the waiters whose desired state is reached, not every
+ * thread waiting for anything.
+ */
+typedef struct gstate_waiter_record {
+  TAILQ_ENTRY(gstate_waiter_record) m_entry;
+  global_state_t m_wait_for;
+  uint32_t m_futex;	/* 0 waiting, 1 notified. */
+  bool m_is_linked;
+} gstate_waiter_record;
+typedef gstate_waiter_record *gstate_waiter_t;
+
+
+/*
+ * A one shot subscription, the proc is called by the thread changing
+ * the state.
+ */
+typedef struct gstate_subscriber_record {
+  TAILQ_ENTRY(gstate_subscriber_record) m_entry;
+  global_state_t m_wait_for;
+  global_state_notify_proc_t m_proc;
+  void *m_arg;
+} gstate_subscriber_record;
+typedef gstate_subscriber_record *gstate_subscriber_t;
+
+
+TAILQ_HEAD(gstate_waiter_list_t, gstate_waiter_record);
+TAILQ_HEAD(gstate_subscriber_list_t, gstate_subscriber_record);
 
 
 
@@ -8,10 +49,26 @@ static pthread_once_t s_once = PTHREAD_ONCE_INIT;
 static bool s_is_inited = false;
 
 static gallus_mutex_t s_lck = NULL;
+
+/*
+ * Only the fibers wait on the cond, parking the fiber not the
+ * carrier thread.
+ */
 static gallus_cond_t s_cond = NULL;
+static size_t s_n_fiber_waiters = 0;
+
+/*
+ * Written under the s_lck, read lock free. The s_gl is stored before
+ * the s_gs so the acquire load of the s_gs makes the s_gl visible.
+ */
 static global_state_t s_gs = GLOBAL_STATE_UNKNOWN;
 static shutdown_grace_level_t s_gl = SHUTDOWN_UNKNOWN;
 
+static struct gstate_waiter_list_t s_waiters =
+    TAILQ_HEAD_INITIALIZER(s_waiters);
+static struct gstate_subscriber_list_t s_subscribers =
+    TAILQ_HEAD_INITIALIZER(s_subscribers);
+
 static void s_ctors(void) __attr_constructor__(109);
 static void s_dtors(void) __attr_destructor__(109);
 
@@ -22,6 +79,11 @@ static void s_dtors(void) __attr_destructor__(109);
 static void
 s_child_at_fork(void) {
   (void)gallus_mutex_reinitialize(&s_lck);
+  /*
+   * The waiting threads are gone in the child.
+   */
+  TAILQ_INIT(&s_waiters);
+  s_n_fiber_waiters = 0;
 }
 
 
@@ -60,6 +122,12 @@ s_ctors(void) {
 
 static inline void
 s_final(void) {
+  gstate_subscriber_t sb;
+
+  while ((sb = TAILQ_FIRST(&s_subscribers)) != NULL) {
+    TAILQ_REMOVE(&s_subscribers, sb, m_entry);
+    free((void *)sb);
+  }
   if (s_cond != NULL) {
     gallus_cond_destroy(&s_cond);
   }
@@ -112,6 +180,226 @@ s_is_valid_state(global_state_t s) {
 }
 
 
+static inline bool
+s_is_reached(global_state_t s_wait_for, global_state_t s) {
+  /*
+   * A shutdown wakes everyone up, whatever they wait for.
+   */
+  return ((int)s >= (int)s_wait_for ||
+          IS_GLOBAL_STATE_SHUTDOWN(s) == true) ? true : false;
+}
+
+
+static inline gallus_result_t
+s_wait_result(global_state_t s_wait_for, global_state_t s) {
+  gallus_result_t ret = GALLUS_RESULT_OK;
+
+  if ((int)s < (int)s_wait_for &&
+      IS_GLOBAL_STATE_SHUTDOWN(s) == true &&
+      IS_GLOBAL_STATE_SHUTDOWN(s_wait_for) == false) {
+    ret = GALLUS_RESULT_NOT_OPERATIONAL;
+  }
+
+  return ret;
+}
+
+
+
+
+
+#ifdef GALLUS_OS_LINUX
+static inline void
+s_futex_wake(uint32_t *addr) {
+  int oerrno = errno;
+  (void)syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+  errno = oerrno;
+}
+#endif /* GALLUS_OS_LINUX */
+
+
+/*
+ * A futex wait as a cancellation point: the raw syscall is not one,
+ * so the async cancellation is enabled just around it, the same way
+ * the libc does for its own cancellable futex waits.
+ */
+static inline gallus_result_t
+s_futex_wait(uint32_t *addr, gallus_chrono_t deadline) {
+  gallus_result_t ret = GALLUS_RESULT_OK;
+  gallus_chrono_t now = 0;
+  int oerrno = errno;
+
+  if (deadline >= 0) {
+    WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+  }
+
+  if (deadline >= 0 && now >= deadline) {
+    ret = GALLUS_RESULT_TIMEDOUT;
+  } else {
+#ifdef GALLUS_OS_LINUX
+    struct timespec ts;
+    struct timespec *tsptr = NULL;
+    int otype;
+    long st;
+
+    if (deadline >= 0) {
+      NSEC_TO_TS(deadline - now, ts);
+      tsptr = &ts;
+    }
+    (void)pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &otype);
+    st = syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, 0, tsptr, NULL, 0);
+    (void)pthread_setcanceltype(otype, NULL);
+    if (st != 0 && errno == ETIMEDOUT) {
+      ret = GALLUS_RESULT_TIMEDOUT;
+    }
+#else
+    (void)addr;
+    (void)usleep(1000);
+    pthread_testcancel();
+#endif /* GALLUS_OS_LINUX */
+  }
+
+  errno = oerrno;
+  return ret;
+}
+
+
+static inline void
+s_waiter_unlink(gstate_waiter_t w) {
+  if (w->m_is_linked == true) {
+    TAILQ_REMOVE(&s_waiters, w, m_entry);
+    w->m_is_linked = false;
+  }
+}
+
+
+static void
+s_waiter_cancel_handler(void *arg) {
+  gstate_waiter_t w = (gstate_waiter_t)arg;
+
+  s_lock();
+  {
+    s_waiter_unlink(w);
+  }
+  s_unlock();
+}
+
+
+/*
+ * Call with the lock held.
+ */
+static inline void
+s_notify(global_state_t s, shutdown_grace_level_t l) {
+  gstate_waiter_t w;
+  gstate_waiter_t next_w;
+  gstate_subscriber_t sb;
+  gstate_subscriber_t next_sb;
+
+  for (w = TAILQ_FIRST(&s_waiters); w != NULL; w = next_w) {
+    next_w = TAILQ_NEXT(w, m_entry);
+    if (s_is_reached(w->m_wait_for, s) == true) {
+      s_waiter_unlink(w);
+      gallus_atomic_store(&(w->m_futex), 1, RELEASE);
+#ifdef GALLUS_OS_LINUX
+      s_futex_wake(&(w->m_futex));
+#endif /* GALLUS_OS_LINUX */
+    }
+  }
+
+  for (sb = TAILQ_FIRST(&s_subscribers); sb != NULL; sb = next_sb) {
+    next_sb = TAILQ_NEXT(sb, m_entry);
+    if (s_is_reached(sb->m_wait_for, s) == true) {
+      TAILQ_REMOVE(&s_subscribers, sb, m_entry);
+      sb->m_proc(s, l, sb->m_arg);
+      free((void *)sb);
+    }
+  }
+
+  if (s_n_fiber_waiters > 0) {
+    (void)gallus_cond_notify(&s_cond, true);
+  }
+}
+
+
+/*
+ * Returns GALLUS_RESULT_OK when the s_wait_for is reached (or the
+ * shutdown), otherwise GALLUS_RESULT_TIMEDOUT.
+ */
+static inline gallus_result_t
+s_wait(global_state_t s_wait_for, gallus_chrono_t nsec) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gstate_waiter_record wr;
+  gstate_waiter_t w = &wr;
+  gallus_chrono_t deadline = -1LL;
+
+  if (nsec > 0) {
+    WHAT_TIME_IS_IT_NOW_IN_NSEC(deadline);
+    deadline += nsec;
+  } else if (nsec == 0) {
+    deadline = 0;
+  }
+
+  if (gallus_fiber_self() != NULL) {
+    s_lock();
+    {
+      s_n_fiber_waiters++;
+      ret = GALLUS_RESULT_OK;
+      while (s_is_reached(s_wait_for, s_gs) == false &&
+             ret == GALLUS_RESULT_OK) {
+        ret = gallus_cond_wait(&s_cond, &s_lck, nsec);
+      }
+      s_n_fiber_waiters--;
+    }
+    s_unlock();
+    goto done;
+  }
+
+  s_lock();
+  {
+    if (s_is_reached(s_wait_for, s_gs) == false) {
+      w->m_wait_for = s_wait_for;
+      w->m_futex = 0;
+      TAILQ_INSERT_TAIL(&s_waiters, w, m_entry);
+      w->m_is_linked = true;
+      ret = GALLUS_RESULT_TIMEDOUT;
+    } else {
+      ret = GALLUS_RESULT_OK;
+    }
+  }
+  s_unlock();
+
+  if (ret == GALLUS_RESULT_TIMEDOUT) {
+
+    pthread_cleanup_push(s_waiter_cancel_handler, (void *)w);
+    {
+      ret = GALLUS_RESULT_OK;
+      while (gallus_atomic_load(&(w->m_futex), ACQUIRE) == 0 &&
+             ret == GALLUS_RESULT_OK) {
+        ret = s_futex_wait(&(w->m_futex), deadline);
+      }
+    }
+    pthread_cleanup_pop(0);
+
+    if (ret == GALLUS_RESULT_TIMEDOUT) {
+      s_lock();
+      {
+        if (w->m_is_linked == true) {
+          s_waiter_unlink(w);
+        } else {
+          /*
+           * Notified right after the timeout.
+           */
+          ret = GALLUS_RESULT_OK;
+        }
+      }
+      s_unlock();
+    }
+  }
+
+done:
+  return ret;
+}
+
+
 
 
 
@@ -124,8 +412,8 @@ global_state_set(global_state_t s) {
     s_lock();
     {
       if (s_is_valid_state(s) == true) {
-        s_gs = s;
-        (void)gallus_cond_notify(&s_cond, true);
+        gallus_atomic_store(&s_gs, s, RELEASE);
+        s_notify(s, s_gl);
         ret = GALLUS_RESULT_OK;
       } else {
         ret = GALLUS_RESULT_INVALID_STATE_TRANSITION;
@@ -146,15 +434,8 @@ global_state_get(global_state_t *sptr) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
 
   if (sptr != NULL) {
-
-    s_lock();
-    {
-      *sptr = s_gs;
-    }
-    s_unlock();
-
+    *sptr = gallus_atomic_load(&s_gs, ACQUIRE);
     ret = GALLUS_RESULT_OK;
-
   } else {
     ret = GALLUS_RESULT_INVALID_ARGS;
   }
@@ -171,39 +452,35 @@ global_state_wait_for(global_state_t s_wait_for,
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
 
   if (IS_VALID_GLOBAL_STATE(s_wait_for) == true) {
-
-    s_lock();
-    {
-    recheck:
-      if ((int)s_gs < (int)s_wait_for &&
-          IS_GLOBAL_STATE_SHUTDOWN(s_gs) == false) {
-        ret = gallus_cond_wait(&s_cond, &s_lck, nsec);
-        if (ret == GALLUS_RESULT_OK) {
-          goto recheck;
-        }
-      } else {
-        if (cur_sptr != NULL) {
-          *cur_sptr = s_gs;
-        }
-        if (cur_gptr != NULL) {
-          *cur_gptr = s_gl;
-        }
-        if ((int)s_gs >= (int)s_wait_for) {
-          ret = GALLUS_RESULT_OK;
-        } else if (IS_GLOBAL_STATE_SHUTDOWN(s_gs) == true &&
-                   IS_GLOBAL_STATE_SHUTDOWN(s_wait_for) == false) {
-          ret = GALLUS_RESULT_NOT_OPERATIONAL;
-        } else {
-          ret = GALLUS_RESULT_OK;
-        }
+    global_state_t s = gallus_atomic_load(&s_gs, ACQUIRE);
+
+    /*
+     * The fast path, no lock if it's already there.
+     */
+    if (s_is_reached(s_wait_for, s) == false) {
+      if (nsec == 0) {
+        ret = GALLUS_RESULT_TIMEDOUT;
+        goto done;
+      }
+      if ((ret = s_wait(s_wait_for, nsec)) != GALLUS_RESULT_OK) {
+        goto done;
       }
+      s = gallus_atomic_load(&s_gs, ACQUIRE);
     }
-    s_unlock();
+
+    if (cur_sptr != NULL) {
+      *cur_sptr = s;
+    }
+    if (cur_gptr != NULL) {
+      *cur_gptr = gallus_atomic_load(&s_gl, RELAXED);
+    }
+    ret = s_wait_result(s_wait_for, s);
 
   } else {
     ret = GALLUS_RESULT_INVALID_ARGS;
   }
 
+done:
   return ret;
 }
 
@@ -221,27 +498,18 @@ global_state_request_shutdown(shutdown_grace_level_t l) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
 
   if (IS_VALID_SHUTDOWN(l) == true) {
+    bool do_wait = false;
 
     s_lock();
     {
       if (IS_GLOBAL_STATE_SHUTDOWN(s_gs) == false &&
           s_gs != GLOBAL_STATE_REQUEST_SHUTDOWN) {
         if (s_is_valid_state(GLOBAL_STATE_REQUEST_SHUTDOWN) == true) {
-          s_gs = GLOBAL_STATE_REQUEST_SHUTDOWN;
-          s_gl = l;
-          (void)gallus_cond_notify(&s_cond, true);
-
-          /*
-           * Wait until someone changes the state to
-           * GLOBAL_STATE_ACCEPT_SHUTDOWN
-           */
-        recheck:
-          if (IS_GLOBAL_STATE_SHUTDOWN(s_gs) == false) {
-            if ((ret = gallus_cond_wait(&s_cond, &s_lck, -1LL)) ==
-                GALLUS_RESULT_OK) {
-              goto recheck;
-            }
-          }
+          gallus_atomic_store(&s_gl, l, RELAXED);
+          gallus_atomic_store(&s_gs, GLOBAL_STATE_REQUEST_SHUTDOWN,
+                              RELEASE);
+          s_notify(GLOBAL_STATE_REQUEST_SHUTDOWN, l);
+          do_wait = true;
         } else {
           ret = GALLUS_RESULT_INVALID_STATE_TRANSITION;
         }
@@ -249,6 +517,84 @@ global_state_request_shutdown(shutdown_grace_level_t l) {
     }
     s_unlock();
 
+    if (do_wait == true) {
+      /*
+       * Wait until someone changes the state to
+       * GLOBAL_STATE_ACCEPT_SHUTDOWN
+       */
+      ret = s_wait(GLOBAL_STATE_ACCEPT_SHUTDOWN, -1LL);
+    }
+
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+global_state_subscribe(global_state_t s_wait_for,
+                       global_state_notify_proc_t proc,
+                       void *arg) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (IS_VALID_GLOBAL_STATE(s_wait_for) == true && proc != NULL) {
+    gstate_subscriber_t sb =
+        (gstate_subscriber_t)malloc(sizeof(*sb));
+
+    if (sb != NULL) {
+      sb->m_wait_for = s_wait_for;
+      sb->m_proc = proc;
+      sb->m_arg = arg;
+
+      s_lock();
+      {
+        if (s_is_reached(s_wait_for, s_gs) == false) {
+          TAILQ_INSERT_TAIL(&s_subscribers, sb, m_entry);
+          sb = NULL;
+        } else {
+          proc(s_gs, s_gl, arg);
+        }
+      }
+      s_unlock();
+
+      free((void *)sb);
+      ret = GALLUS_RESULT_OK;
+    } else {
+      ret = GALLUS_RESULT_NO_MEMORY;
+    }
+
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+global_state_unsubscribe(global_state_notify_proc_t proc, void *arg) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (proc != NULL) {
+    gstate_subscriber_t sb;
+
+    ret = GALLUS_RESULT_NOT_FOUND;
+
+    s_lock();
+    {
+      TAILQ_FOREACH(sb, &s_subscribers, m_entry) {
+        if (sb->m_proc == proc && sb->m_arg == arg) {
+          TAILQ_REMOVE(&s_subscribers, sb, m_entry);
+          free((void *)sb);
+          ret = GALLUS_RESULT_OK;
+          break;
+        }
+      }
+    }
+    s_unlock();
+
   } else {
     ret = GALLUS_RESULT_INVALID_ARGS;
   }
@@ -259,7 +605,10 @@ global_state_request_shutdown(shutdown_grace_level_t l) {
 
 void
 global_state_cancel_janitor(void) {
-  s_unlock();
+  /*
+   * Nothing to do. The waiters no longer sleep holding the lock and
+   * the cancel handler in the s_wait() unlinks the waiter record.
+   */
 }
 
 
@@ -267,8 +616,7 @@ void
 global_state_reset(void) {
   s_lock();
   {
-    s_gs = GLOBAL_STATE_UNKNOWN;
+    gallus_atomic_store(&s_gs, GLOBAL_STATE_UNKNOWN, RELEASE);
   }
   s_unlock();
 }
-
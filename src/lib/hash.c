@@ -194,7 +194,7 @@ DeleteHashEntry(HashEntry *entryPtr) {
     }
   }
   entryPtr->tablePtr->numEntries--;
-  free((char *) entryPtr);
+  GALLUS_FREE(HASHMAP, entryPtr);
 }
 
 /*
@@ -227,7 +227,7 @@ DeleteHashTable(HashTable *tablePtr) {
     hPtr = tablePtr->buckets[i];
     while (hPtr != NULL) {
       nextPtr = hPtr->nextPtr;
-      free((char *) hPtr);
+      GALLUS_FREE(HASHMAP, hPtr);
       hPtr = nextPtr;
     }
   }
@@ -237,7 +237,7 @@ DeleteHashTable(HashTable *tablePtr) {
    */
 
   if (tablePtr->buckets != tablePtr->staticBuckets) {
-    free((char *) tablePtr->buckets);
+    GALLUS_FREE(HASHMAP, tablePtr->buckets);
   }
 
   /*
@@ -545,8 +545,9 @@ StringCreate(HashTable *tablePtr, const void *vKey, int *newPtr) {
     /*
      * Entry not found.  Add a new one to the bucket.
      */
-    hPtr = (HashEntry *)malloc(sizeof(HashEntry) - sizeof(hPtr->key) +
-                               kLen + 1);
+    hPtr = (HashEntry *)GALLUS_MALLOC(HASHMAP,
+                                      sizeof(HashEntry) - sizeof(hPtr->key) +
+                                      kLen + 1);
     if (hPtr != NULL) {
       *newPtr = 1;
       hPtr->tablePtr = tablePtr;
@@ -670,7 +671,7 @@ OneWordCreate(HashTable *tablePtr, const void *key, int *newPtr) {
    * Entry not found.  Add a new one to the bucket.
    */
 
-  hPtr = (HashEntry *)malloc(sizeof(HashEntry));
+  hPtr = (HashEntry *)GALLUS_MALLOC(HASHMAP, sizeof(HashEntry));
   if (hPtr != NULL) {
     *newPtr = 1;
     hPtr->tablePtr = tablePtr;
@@ -825,8 +826,9 @@ ArrayCreate(HashTable *tablePtr, const void *key, int *newPtr) {
   /*
    * Entry not found.  Add a new one to the bucket.
    */
-  hPtr = (HashEntry *)malloc(sizeof(HashEntry) - sizeof(hPtr->key) +
-                             tablePtr->keyLen);
+  hPtr = (HashEntry *)GALLUS_MALLOC(HASHMAP,
+                                    sizeof(HashEntry) - sizeof(hPtr->key) +
+                                    tablePtr->keyLen);
   if (hPtr != NULL) {
     *newPtr = 1;
     hPtr->tablePtr = tablePtr;
@@ -957,7 +959,8 @@ RebuildTable(HashTable *tablePtr) {
 
   tablePtr->numBuckets *= 4;
   tablePtr->buckets =
-    (HashEntry **)malloc(tablePtr->numBuckets * sizeof(HashEntry *));
+    (HashEntry **)GALLUS_MALLOC(HASHMAP,
+                                tablePtr->numBuckets * sizeof(HashEntry *));
   for (count = tablePtr->numBuckets, newChainPtr = tablePtr->buckets;
        count > 0;
        count--, newChainPtr++) {
@@ -997,6 +1000,6 @@ RebuildTable(HashTable *tablePtr) {
    */
 
   if (oldBuckets != tablePtr->staticBuckets) {
-    free((char *) oldBuckets);
+    GALLUS_FREE(HASHMAP, oldBuckets);
   }
 }
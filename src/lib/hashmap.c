@@ -155,14 +155,24 @@ gallus_result_t
 gallus_hashmap_create(gallus_hashmap_t *retptr,
                        gallus_hashmap_type_t t,
                        gallus_hashmap_value_freeup_proc_t proc) {
+  return gallus_hashmap_create_with_lock_type(retptr, t, proc,
+                                               GALLUS_RWLOCK_TYPE_DEFAULT);
+}
+
+
+gallus_result_t
+gallus_hashmap_create_with_lock_type(gallus_hashmap_t *retptr,
+                                      gallus_hashmap_type_t t,
+                                      gallus_hashmap_value_freeup_proc_t proc,
+                                      gallus_rwlock_type_t lock_type) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
   gallus_hashmap_t hm;
 
   if (retptr != NULL) {
     *retptr = NULL;
-    hm = (gallus_hashmap_t)malloc(sizeof(*hm));
+    hm = (gallus_hashmap_t)GALLUS_MALLOC(HASHMAP, sizeof(*hm));
     if (hm != NULL) {
-      if ((ret = gallus_rwlock_create(&(hm->m_lock))) ==
+      if ((ret = gallus_rwlock_create_with_type(&(hm->m_lock), lock_type)) ==
           GALLUS_RESULT_OK) {
         hm->m_type = t;
         InitHashTable(&(hm->m_hashtable), (unsigned int)t);
@@ -172,7 +182,7 @@ gallus_hashmap_create(gallus_hashmap_t *retptr,
         *retptr = hm;
         ret = GALLUS_RESULT_OK;
       } else {
-        free((void *)hm);
+        GALLUS_FREE(HASHMAP, hm);
       }
     } else {
       ret = GALLUS_RESULT_NO_MEMORY;
@@ -220,7 +230,7 @@ gallus_hashmap_destroy(gallus_hashmap_t *hmptr, bool free_values) {
     s_unlock(*hmptr, cstate);
 
     gallus_rwlock_destroy(&((*hmptr)->m_lock));
-    free((void *)*hmptr);
+    GALLUS_FREE(HASHMAP, *hmptr);
     *hmptr = NULL;
   }
 }
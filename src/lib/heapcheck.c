@@ -1,5 +1,10 @@
 #include "gallus_apis.h"
 
+#ifdef __GLIBC__
+#include <execinfo.h>
+#define HAVE_USABLE_SIZE
+#endif /* __GLIBC__ */
+
 
 
 
@@ -17,6 +22,51 @@ static void s_ctors(void) __attr_constructor__(101);
 static void s_dtors(void) __attr_destructor__(101);
 
 
+#define HEAPCHECK_MAX_SITES	1024	/* must be a power of 2. */
+
+
+/*
+ * The counters of a thread. Only the owner writes them, by plain
+ * stores; the snapshot reads them by relaxed loads.
+ */
+typedef struct heapcheck_thread_record {
+  gallus_heapcheck_stat_t m_stats[GALLUS_HEAPCHECK_TAG_MAX];
+  size_t m_sample_left;
+  struct heapcheck_thread_record *m_prev;
+  struct heapcheck_thread_record *m_next;
+} __attribute__((aligned(64))) heapcheck_thread_record;
+typedef heapcheck_thread_record *heapcheck_thread_t;
+
+static __thread heapcheck_thread_t s_thd = NULL;
+static __thread bool s_thd_is_gone = false;
+
+/*
+ * The threads, and the counters of the exited ones and of the
+ * threads without a record, the latter by atomic adds.
+ */
+static pthread_mutex_t s_thds_lck = PTHREAD_MUTEX_INITIALIZER;
+static heapcheck_thread_t s_thds = NULL;
+static size_t s_n_thds = 0;
+static gallus_heapcheck_stat_t s_gone_stats[GALLUS_HEAPCHECK_TAG_MAX];
+static pthread_key_t s_thd_key;
+
+static size_t s_sampling = 0;
+
+static pthread_mutex_t s_sites_lck = PTHREAD_MUTEX_INITIALIZER;
+static gallus_heapcheck_site_t s_sites[HEAPCHECK_MAX_SITES];
+static size_t s_n_sites = 0;
+
+static const char *const s_tag_names[GALLUS_HEAPCHECK_TAG_MAX] = {
+  "other",
+  "cbuffer",
+  "hashmap",
+  "pool",
+  "session",
+  "dstring",
+  "logger",
+};
+
+
 
 
 
@@ -28,8 +78,49 @@ s_mcheck_proc(enum mcheck_status s) {
 #endif
 
 
+static void
+s_thread_exit(void *arg) {
+  heapcheck_thread_t t = (heapcheck_thread_t)arg;
+  size_t i;
+
+  (void)pthread_mutex_lock(&s_thds_lck);
+  {
+    for (i = 0; i < GALLUS_HEAPCHECK_TAG_MAX; i++) {
+      (void)__atomic_add_fetch(&s_gone_stats[i].m_n_allocs,
+                               t->m_stats[i].m_n_allocs, __ATOMIC_RELAXED);
+      (void)__atomic_add_fetch(&s_gone_stats[i].m_n_frees,
+                               t->m_stats[i].m_n_frees, __ATOMIC_RELAXED);
+      (void)__atomic_add_fetch(&s_gone_stats[i].m_allocd_bytes,
+                               t->m_stats[i].m_allocd_bytes,
+                               __ATOMIC_RELAXED);
+      (void)__atomic_add_fetch(&s_gone_stats[i].m_freed_bytes,
+                               t->m_stats[i].m_freed_bytes,
+                               __ATOMIC_RELAXED);
+    }
+    if (t->m_prev != NULL) {
+      t->m_prev->m_next = t->m_next;
+    } else {
+      s_thds = t->m_next;
+    }
+    if (t->m_next != NULL) {
+      t->m_next->m_prev = t->m_prev;
+    }
+    s_n_thds--;
+  }
+  (void)pthread_mutex_unlock(&s_thds_lck);
+
+  /*
+   * The frees by the later TSD destructors go to the s_gone_stats.
+   */
+  s_thd = NULL;
+  s_thd_is_gone = true;
+  free((void *)t);
+}
+
+
 static void
 s_once_proc(void) {
+  char *sampling_str = getenv("GALLUS_HEAPCHECK_SAMPLING");
   char *a;
   uintptr_t b;
 
@@ -44,6 +135,17 @@ s_once_proc(void) {
   }
   free((void *)a);
 
+  if (pthread_key_create(&s_thd_key, s_thread_exit) != 0) {
+    gallus_exit_fatal("can't create a heapcheck thread key.\n");
+  }
+
+  if (IS_VALID_STRING(sampling_str) == true) {
+    uint64_t tmp = 0;
+    if (gallus_str_parse_uint64(sampling_str, &tmp) == GALLUS_RESULT_OK) {
+      s_sampling = (size_t)tmp;
+    }
+  }
+
   s_is_inited = true;
 }
 
@@ -109,6 +211,202 @@ s_is_mallocd(const void *addr) {
 #endif
 
 
+static inline bool
+s_is_valid_tag(gallus_heapcheck_tag_t tag) {
+  return ((int)tag >= 0 && tag < GALLUS_HEAPCHECK_TAG_MAX) ? true : false;
+}
+
+
+static inline size_t
+s_usable_size(void *ptr) {
+#ifdef HAVE_USABLE_SIZE
+  return malloc_usable_size(ptr);
+#else
+  (void)ptr;
+  return 0;
+#endif /* HAVE_USABLE_SIZE */
+}
+
+
+static heapcheck_thread_t
+s_thread_register(void) {
+  heapcheck_thread_t t = NULL;
+
+  s_init();
+
+  if (posix_memalign((void **)&t, 64, sizeof(*t)) != 0) {
+    return NULL;
+  }
+  (void)memset((void *)t, 0, sizeof(*t));
+
+  (void)pthread_mutex_lock(&s_thds_lck);
+  {
+    t->m_next = s_thds;
+    if (s_thds != NULL) {
+      s_thds->m_prev = t;
+    }
+    s_thds = t;
+    s_n_thds++;
+  }
+  (void)pthread_mutex_unlock(&s_thds_lck);
+
+  (void)pthread_setspecific(s_thd_key, (void *)t);
+  s_thd = t;
+
+  return t;
+}
+
+
+static inline heapcheck_thread_t
+s_thread(void) {
+  if (likely(s_thd != NULL)) {
+    return s_thd;
+  }
+  return (s_thd_is_gone == false) ? s_thread_register() : NULL;
+}
+
+
+static inline uint64_t
+s_site_hash(gallus_heapcheck_tag_t tag, void *const *frames, size_t n) {
+  uint64_t h = 14695981039346656037ULL ^ (uint64_t)tag;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    h = (h ^ (uint64_t)(uintptr_t)frames[i]) * 1099511628211ULL;
+  }
+
+  return h ^ (h >> 29);
+}
+
+
+/*
+ * Record the backtrace from the ra, the return address into the
+ * caller of the allocator, so it doesn't depend on what got inlined.
+ */
+static void
+s_sample(gallus_heapcheck_tag_t tag, size_t bytes, void *ra) {
+#ifdef __GLIBC__
+  void *frames[GALLUS_HEAPCHECK_MAX_FRAMES + 8];
+  void **f = frames;
+  gallus_heapcheck_site_t *s = NULL;
+  size_t i, n, idx;
+
+  n = (size_t)backtrace(frames, GALLUS_HEAPCHECK_MAX_FRAMES + 8);
+  for (i = 0; i < n; i++) {
+    if (frames[i] == ra) {
+      f = frames + i;
+      n -= i;
+      break;
+    }
+  }
+  if (n > GALLUS_HEAPCHECK_MAX_FRAMES) {
+    n = GALLUS_HEAPCHECK_MAX_FRAMES;
+  }
+
+  idx = (size_t)s_site_hash(tag, f, n) & (HEAPCHECK_MAX_SITES - 1);
+
+  (void)pthread_mutex_lock(&s_sites_lck);
+  {
+    for (i = 0; i < HEAPCHECK_MAX_SITES; i++) {
+      s = &s_sites[(idx + i) & (HEAPCHECK_MAX_SITES - 1)];
+      if (s->m_n_samples == 0) {
+        s->m_tag = tag;
+        s->m_n_frames = n;
+        (void)memcpy((void *)s->m_frames, (void *)f, sizeof(void *) * n);
+        s_n_sites++;
+        break;
+      }
+      if (s->m_tag == tag && s->m_n_frames == n &&
+          memcmp((void *)s->m_frames, (void *)f, sizeof(void *) * n) == 0) {
+        break;
+      }
+    }
+    /* Dropped when full. */
+    if (i < HEAPCHECK_MAX_SITES) {
+      s->m_n_samples++;
+      s->m_bytes += bytes;
+    }
+  }
+  (void)pthread_mutex_unlock(&s_sites_lck);
+#else
+  (void)tag;
+  (void)bytes;
+  (void)ra;
+#endif /* __GLIBC__ */
+}
+
+
+static inline void
+s_count_alloc(gallus_heapcheck_tag_t tag, void *ptr, void *ra) {
+  heapcheck_thread_t t = s_thread();
+  size_t bytes = s_usable_size(ptr);
+  size_t interval;
+
+  if (likely(t != NULL)) {
+    gallus_heapcheck_stat_t *st = &(t->m_stats[tag]);
+
+    __atomic_store_n(&st->m_n_allocs, st->m_n_allocs + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->m_allocd_bytes, st->m_allocd_bytes + bytes,
+                     __ATOMIC_RELAXED);
+
+    interval = __atomic_load_n(&s_sampling, __ATOMIC_RELAXED);
+    if (unlikely(interval > 0)) {
+      if (t->m_sample_left == 0 || t->m_sample_left > interval) {
+        t->m_sample_left = interval;
+      }
+      if (--t->m_sample_left == 0) {
+        s_sample(tag, bytes, ra);
+      }
+    }
+  } else {
+    (void)__atomic_add_fetch(&s_gone_stats[tag].m_n_allocs, 1,
+                             __ATOMIC_RELAXED);
+    (void)__atomic_add_fetch(&s_gone_stats[tag].m_allocd_bytes, bytes,
+                             __ATOMIC_RELAXED);
+  }
+}
+
+
+static inline void
+s_count_free(gallus_heapcheck_tag_t tag, size_t bytes) {
+  heapcheck_thread_t t = s_thread();
+
+  if (likely(t != NULL)) {
+    gallus_heapcheck_stat_t *st = &(t->m_stats[tag]);
+
+    __atomic_store_n(&st->m_n_frees, st->m_n_frees + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->m_freed_bytes, st->m_freed_bytes + bytes,
+                     __ATOMIC_RELAXED);
+  } else {
+    (void)__atomic_add_fetch(&s_gone_stats[tag].m_n_frees, 1,
+                             __ATOMIC_RELAXED);
+    (void)__atomic_add_fetch(&s_gone_stats[tag].m_freed_bytes, bytes,
+                             __ATOMIC_RELAXED);
+  }
+}
+
+
+static inline void
+s_stat_add(gallus_heapcheck_stat_t *dst, gallus_heapcheck_stat_t *src) {
+  dst->m_n_allocs += __atomic_load_n(&src->m_n_allocs, __ATOMIC_RELAXED);
+  dst->m_n_frees += __atomic_load_n(&src->m_n_frees, __ATOMIC_RELAXED);
+  dst->m_allocd_bytes += __atomic_load_n(&src->m_allocd_bytes,
+                                         __ATOMIC_RELAXED);
+  dst->m_freed_bytes += __atomic_load_n(&src->m_freed_bytes,
+                                        __ATOMIC_RELAXED);
+}
+
+
+static int
+s_site_cmp(const void *a, const void *b) {
+  const gallus_heapcheck_site_t *x = (const gallus_heapcheck_site_t *)a;
+  const gallus_heapcheck_site_t *y = (const gallus_heapcheck_site_t *)b;
+
+  return (x->m_bytes > y->m_bytes) ? -1 :
+         ((x->m_bytes < y->m_bytes) ? 1 : 0);
+}
+
+
 
 
 
@@ -130,3 +428,227 @@ gallus_heapcheck_is_mallocd(const void *addr) {
   return s_is_mallocd(addr);
 }
 #endif
+
+
+void *
+gallus_heapcheck_malloc(gallus_heapcheck_tag_t tag, size_t size) {
+  void *ret = malloc(size);
+
+  if (likely(ret != NULL && s_is_valid_tag(tag) == true)) {
+    s_count_alloc(tag, ret, __builtin_return_address(0));
+  }
+
+  return ret;
+}
+
+
+void *
+gallus_heapcheck_calloc(gallus_heapcheck_tag_t tag, size_t nmemb,
+                        size_t size) {
+  void *ret = calloc(nmemb, size);
+
+  if (likely(ret != NULL && s_is_valid_tag(tag) == true)) {
+    s_count_alloc(tag, ret, __builtin_return_address(0));
+  }
+
+  return ret;
+}
+
+
+void *
+gallus_heapcheck_realloc(gallus_heapcheck_tag_t tag, void *ptr, size_t size) {
+  size_t old = (ptr != NULL) ? s_usable_size(ptr) : 0;
+  void *ret = realloc(ptr, size);
+
+  if (s_is_valid_tag(tag) == true) {
+    /*
+     * A failed realloc() leaves the ptr as is, a realloc() to 0 may
+     * free it.
+     */
+    if (ptr != NULL && (ret != NULL || size == 0)) {
+      s_count_free(tag, old);
+    }
+    if (ret != NULL) {
+      s_count_alloc(tag, ret, __builtin_return_address(0));
+    }
+  }
+
+  return ret;
+}
+
+
+char *
+gallus_heapcheck_strdup(gallus_heapcheck_tag_t tag, const char *str) {
+  char *ret = strdup(str);
+
+  if (likely(ret != NULL && s_is_valid_tag(tag) == true)) {
+    s_count_alloc(tag, (void *)ret, __builtin_return_address(0));
+  }
+
+  return ret;
+}
+
+
+void
+gallus_heapcheck_free(gallus_heapcheck_tag_t tag, void *ptr) {
+  if (ptr != NULL) {
+    if (likely(s_is_valid_tag(tag) == true)) {
+      s_count_free(tag, s_usable_size(ptr));
+    }
+    free(ptr);
+  }
+}
+
+
+const char *
+gallus_heapcheck_tag_name(gallus_heapcheck_tag_t tag) {
+  return (s_is_valid_tag(tag) == true) ? s_tag_names[tag] : "unknown";
+}
+
+
+gallus_result_t
+gallus_heapcheck_snapshot(gallus_heapcheck_snapshot_t *sptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  heapcheck_thread_t t;
+  size_t i;
+
+  if (sptr != NULL) {
+    (void)memset((void *)sptr, 0, sizeof(*sptr));
+
+    (void)pthread_mutex_lock(&s_thds_lck);
+    {
+      for (i = 0; i < GALLUS_HEAPCHECK_TAG_MAX; i++) {
+        s_stat_add(&sptr->m_tags[i], &s_gone_stats[i]);
+      }
+      for (t = s_thds; t != NULL; t = t->m_next) {
+        for (i = 0; i < GALLUS_HEAPCHECK_TAG_MAX; i++) {
+          s_stat_add(&sptr->m_tags[i], &t->m_stats[i]);
+        }
+      }
+      sptr->m_n_threads = s_n_thds;
+    }
+    (void)pthread_mutex_unlock(&s_thds_lck);
+
+    for (i = 0; i < GALLUS_HEAPCHECK_TAG_MAX; i++) {
+      s_stat_add(&sptr->m_total, &sptr->m_tags[i]);
+    }
+
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+void
+gallus_heapcheck_set_sampling(size_t interval) {
+  __atomic_store_n(&s_sampling, interval, __ATOMIC_RELAXED);
+}
+
+
+size_t
+gallus_heapcheck_get_sampling(void) {
+  return __atomic_load_n(&s_sampling, __ATOMIC_RELAXED);
+}
+
+
+gallus_result_t
+gallus_heapcheck_get_sites(gallus_heapcheck_site_t *sites, size_t max) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_heapcheck_site_t *tmp = NULL;
+  size_t i, n = 0;
+
+  if (sites == NULL && max > 0) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  tmp = (gallus_heapcheck_site_t *)
+        malloc(sizeof(gallus_heapcheck_site_t) * HEAPCHECK_MAX_SITES);
+  if (tmp == NULL) {
+    return GALLUS_RESULT_NO_MEMORY;
+  }
+
+  (void)pthread_mutex_lock(&s_sites_lck);
+  {
+    for (i = 0; i < HEAPCHECK_MAX_SITES && n < s_n_sites; i++) {
+      if (s_sites[i].m_n_samples > 0) {
+        tmp[n++] = s_sites[i];
+      }
+    }
+  }
+  (void)pthread_mutex_unlock(&s_sites_lck);
+
+  qsort((void *)tmp, n, sizeof(gallus_heapcheck_site_t), s_site_cmp);
+  if (n > max) {
+    n = max;
+  }
+  if (n > 0) {
+    (void)memcpy((void *)sites, (void *)tmp,
+                 sizeof(gallus_heapcheck_site_t) * n);
+  }
+  ret = (gallus_result_t)n;
+
+  free((void *)tmp);
+  return ret;
+}
+
+
+void
+gallus_heapcheck_reset_sites(void) {
+  (void)pthread_mutex_lock(&s_sites_lck);
+  {
+    (void)memset((void *)s_sites, 0, sizeof(s_sites));
+    s_n_sites = 0;
+  }
+  (void)pthread_mutex_unlock(&s_sites_lck);
+}
+
+
+void
+gallus_heapcheck_dump(FILE *fd, size_t max_sites) {
+  gallus_heapcheck_snapshot_t snap;
+  gallus_heapcheck_site_t *sites = NULL;
+  gallus_heapcheck_stat_t *st;
+  gallus_result_t n = 0;
+  size_t i, interval = gallus_heapcheck_get_sampling();
+
+  if (fd == NULL ||
+      gallus_heapcheck_snapshot(&snap) != GALLUS_RESULT_OK) {
+    return;
+  }
+
+  fprintf(fd, "%-8s %14s %14s %16s\n", "tag", "allocs", "frees",
+          "live bytes");
+  for (i = 0; i <= GALLUS_HEAPCHECK_TAG_MAX; i++) {
+    st = (i < GALLUS_HEAPCHECK_TAG_MAX) ? &snap.m_tags[i] : &snap.m_total;
+    fprintf(fd, "%-8s %14" PRIu64 " %14" PRIu64 " %16" PRId64 "\n",
+            (i < GALLUS_HEAPCHECK_TAG_MAX) ?
+            s_tag_names[i] : "total",
+            st->m_n_allocs, st->m_n_frees,
+            (int64_t)(st->m_allocd_bytes - st->m_freed_bytes));
+  }
+
+  if (max_sites > 0 && interval > 0) {
+    sites = (gallus_heapcheck_site_t *)
+            malloc(sizeof(gallus_heapcheck_site_t) * max_sites);
+    if (sites != NULL &&
+        (n = gallus_heapcheck_get_sites(sites, max_sites)) > 0) {
+      for (i = 0; i < (size_t)n; i++) {
+        fprintf(fd, "site %zu: %s, %" PRIu64 " samples, "
+                "~%" PRIu64 " bytes\n",
+                i, s_tag_names[sites[i].m_tag], sites[i].m_n_samples,
+                sites[i].m_bytes * (uint64_t)interval);
+        fflush(fd);
+#ifdef __GLIBC__
+        backtrace_symbols_fd(sites[i].m_frames, (int)sites[i].m_n_frames,
+                             fileno(fd));
+#endif /* __GLIBC__ */
+      }
+    }
+    free((void *)sites);
+  }
+
+  fflush(fd);
+}
@@ -5,6 +5,10 @@
 #define EAI_ADDRFAMILY EAI_FAMILY
 #endif /* EAI_ADDRFAMILY */
 
+#define CACHE_TTL_DEFAULT	(30LL * 1000LL * 1000LL * 1000LL)
+#define CACHE_BUCKETS		1024	/* must be a power of 2. */
+#define CACHE_MAX_ENTRIES	8192
+
 struct ip_address {
   char addr_str[GALLUS_ADDR_STR_MAX];
   bool is_ipv4;
@@ -12,76 +16,471 @@ struct ip_address {
   struct sockaddr_storage saddr;
 };
 
-gallus_result_t
-gallus_ip_address_create(const char *name, bool is_ipv4_addr,
-                          gallus_ip_address_t **ip) {
+/*
+ * A resolved host name. It's fresh until m_expire and is still
+ * served for another TTL after that while a refresh runs in the
+ * background, so that the hot paths don't wait for the resolver.
+ */
+typedef struct cache_entry {
+  struct cache_entry *m_next;
+  struct cache_entry *m_refresh_next;
+  uint64_t m_hash;
+  bool m_is_ipv4_addr;
+  bool m_is_refreshing;
+  gallus_chrono_t m_expire;
+  gallus_ip_address_t m_ip;
+  char m_name[GALLUS_ADDR_STR_MAX];
+} cache_entry_t;
+
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+static bool s_is_inited = false;
+
+static gallus_mutex_t s_cache_lock = NULL;
+static gallus_cond_t s_cache_cond = NULL;
+static cache_entry_t *s_cache[CACHE_BUCKETS];
+static size_t s_n_cache_entries = 0;
+static gallus_chrono_t s_cache_ttl = CACHE_TTL_DEFAULT;
+
+static cache_entry_t *s_refresh_q = NULL;
+static pthread_once_t s_refresh_once = PTHREAD_ONCE_INIT;
+static pthread_t s_refresh_thd;
+static volatile bool s_refresh_do_loop = false;
+static bool s_refresh_is_running = false;
+
+static void s_ctors(void) __attr_constructor__(116);
+static void s_dtors(void) __attr_destructor__(116);
+
+static inline uint64_t
+s_hash(const char *name, bool is_ipv4_addr) {
+  uint64_t h = 14695981039346656037ULL;
+
+  for (; *name != '\0'; name++) {
+    h = (h ^ (uint8_t)*name) * 1099511628211ULL;
+  }
+  return (h ^ (is_ipv4_addr == true ? 1 : 0)) * 1099511628211ULL;
+}
+
+/*
+ * inet_ntop(3) for AF_INET goes through sprintf(3), several times
+ * slower than this.
+ */
+static inline void
+s_format_ipv4(const struct in_addr *a, char *buf) {
+  const uint8_t *b = (const uint8_t *) &(a->s_addr);
+  size_t i;
+
+  for (i = 0; i < 4; i++) {
+    if (b[i] >= 100) {
+      *buf++ = (char) ('0' + b[i] / 100);
+    }
+    if (b[i] >= 10) {
+      *buf++ = (char) ('0' + (b[i] / 10) % 10);
+    }
+    *buf++ = (char) ('0' + b[i] % 10);
+    *buf++ = (i < 3) ? '.' : '\0';
+  }
+}
+
+/*
+ * Numeric literals in the forms inet_pton(3) takes, no resolver. The
+ * result is the same as the getaddrinfo(3) below; note a v4 mapped
+ * v6 address resolves to the v4 one when an IPv4 is preferred. The
+ * others (e.g. "127.1", "fe80::1%eth0") go to the resolver.
+ */
+static inline bool
+s_parse_numeric(const char *name, bool is_ipv4_addr,
+                gallus_ip_address_t *ip) {
+  struct in_addr a4;
+  struct in6_addr a6;
+  struct sockaddr_in *sin = (struct sockaddr_in *) &(ip->saddr);
+  struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &(ip->saddr);
+
+  if (inet_pton(AF_INET, name, &a4) == 1) {
+    /* nothing to do. */
+  } else if (inet_pton(AF_INET6, name, &a6) == 1) {
+    if (is_ipv4_addr == true && IN6_IS_ADDR_V4MAPPED(&a6)) {
+      memcpy(&a4, &(a6.s6_addr[12]), sizeof(a4));
+    } else {
+      sin6->sin6_family = AF_INET6;
+      sin6->sin6_addr = a6;
+      ip->saddr_len = sizeof(struct sockaddr_in6);
+      ip->is_ipv4 = false;
+      return (inet_ntop(AF_INET6, &a6, ip->addr_str,
+                        GALLUS_ADDR_STR_MAX) != NULL) ? true : false;
+    }
+  } else {
+    return false;
+  }
+
+  sin->sin_family = AF_INET;
+  sin->sin_addr = a4;
+  ip->saddr_len = sizeof(struct sockaddr_in);
+  ip->is_ipv4 = true;
+  s_format_ipv4(&a4, ip->addr_str);
+  return true;
+}
+
+static inline gallus_result_t
+s_resolve(const char *name, bool is_ipv4_addr, gallus_ip_address_t *ip) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
   struct addrinfo hints;
   struct addrinfo *addr = NULL;
-  size_t len = 0;
   int rc;
   int primary;
   int secondary;
 
+  if (is_ipv4_addr == false) {
+    primary = AF_INET6;
+    secondary = AF_INET;
+  } else {
+    primary = AF_INET;
+    secondary = AF_INET6;
+  }
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = 0;
+  hints.ai_family = primary;
+  hints.ai_flags = AI_PASSIVE;
+  hints.ai_protocol = 0;
+  hints.ai_canonname = NULL;
+  hints.ai_addr = NULL;
+  hints.ai_next = NULL;
+
+  rc = getaddrinfo(name, NULL, &hints, &addr);
+  if (rc == EAI_ADDRFAMILY) {
+    hints.ai_family = secondary;
+    rc = getaddrinfo(name, NULL, &hints, &addr);
+  }
+
+  if (rc == 0) {
+    rc = getnameinfo(addr->ai_addr, addr->ai_addrlen,
+                     ip->addr_str, GALLUS_ADDR_STR_MAX,
+                     NULL, 0, NI_NOFQDN | NI_NUMERICHOST);
+  }
+
+  if (rc == 0) {
+    if (addr->ai_family == AF_INET) {
+      ip->is_ipv4 = true;
+    } else {
+      ip->is_ipv4 = false;
+    }
+
+    /*
+     *  The ai_addrlen, which is a length of sockaddr,
+     *  is shorter than a length of sockaddr_storage.
+     */
+    memcpy(&(ip->saddr), addr->ai_addr, addr->ai_addrlen);
+    ip->saddr_len = addr->ai_addrlen;
+    ret = GALLUS_RESULT_OK;
+  } else if (rc == EAI_MEMORY) {
+    ret = GALLUS_RESULT_NO_MEMORY;
+  } else if (rc == EAI_SYSTEM) {
+    ret = GALLUS_RESULT_POSIX_API_ERROR;
+  } else {
+    ret = GALLUS_RESULT_ADDR_RESOLVER_FAILURE;
+  }
+
+  if (addr != NULL) {
+    freeaddrinfo((void *) addr);
+  }
+
+  return ret;
+}
+
+/*
+ * Call with the s_cache_lock held.
+ */
+static inline cache_entry_t *
+s_cache_find(const char *name, bool is_ipv4_addr, uint64_t h) {
+  cache_entry_t *e;
+
+  for (e = s_cache[h & (CACHE_BUCKETS - 1)]; e != NULL; e = e->m_next) {
+    if (e->m_hash == h && e->m_is_ipv4_addr == is_ipv4_addr &&
+        strcmp(e->m_name, name) == 0) {
+      break;
+    }
+  }
+
+  return e;
+}
+
+/*
+ * Call with the s_cache_lock held.
+ */
+static inline void
+s_cache_put(const char *name, bool is_ipv4_addr, uint64_t h,
+            const gallus_ip_address_t *ip) {
+  cache_entry_t *e = s_cache_find(name, is_ipv4_addr, h);
+
+  if (e == NULL && s_n_cache_entries < CACHE_MAX_ENTRIES) {
+    e = (cache_entry_t *) calloc(1, sizeof(cache_entry_t));
+    if (e != NULL) {
+      snprintf(e->m_name, sizeof(e->m_name), "%s", name);
+      e->m_hash = h;
+      e->m_is_ipv4_addr = is_ipv4_addr;
+      e->m_next = s_cache[h & (CACHE_BUCKETS - 1)];
+      s_cache[h & (CACHE_BUCKETS - 1)] = e;
+      s_n_cache_entries++;
+    }
+  }
+  if (e != NULL) {
+    e->m_ip = *ip;
+    e->m_expire = gallus_chrono_now() + s_cache_ttl;
+  }
+}
+
+/*
+ * Call with the s_cache_lock held. The entries being refreshed are
+ * freed by the refresher.
+ */
+static inline void
+s_cache_flush(void) {
+  cache_entry_t *e, *next;
+  size_t i;
+
+  for (i = 0; i < CACHE_BUCKETS; i++) {
+    for (e = s_cache[i]; e != NULL; e = next) {
+      next = e->m_next;
+      if (e->m_is_refreshing == false) {
+        free(e);
+      } else {
+        e->m_next = NULL;
+        e->m_hash = 0;
+        e->m_name[0] = '\0';
+      }
+    }
+    s_cache[i] = NULL;
+  }
+  s_n_cache_entries = 0;
+}
+
+static void *
+s_refresh_main(void *arg) {
+  cache_entry_t *e;
+  gallus_ip_address_t ip;
+  gallus_result_t r;
+  char name[GALLUS_ADDR_STR_MAX];
+  bool is_ipv4_addr;
+
+  (void)arg;
+
+  (void)gallus_mutex_lock(&s_cache_lock);
+  while (s_refresh_do_loop == true) {
+    if (s_refresh_q == NULL) {
+      (void)gallus_cond_wait(&s_cache_cond, &s_cache_lock, -1LL);
+      continue;
+    }
+
+    e = s_refresh_q;
+    s_refresh_q = e->m_refresh_next;
+    snprintf(name, sizeof(name), "%s", e->m_name);
+    is_ipv4_addr = e->m_is_ipv4_addr;
+    (void)gallus_mutex_unlock(&s_cache_lock);
+
+    memset(&ip, 0, sizeof(ip));
+    r = (name[0] != '\0') ?
+        s_resolve(name, is_ipv4_addr, &ip) : GALLUS_RESULT_NOT_FOUND;
+
+    (void)gallus_mutex_lock(&s_cache_lock);
+    if (e->m_name[0] == '\0') {
+      /* flushed meanwhile. */
+      free(e);
+    } else {
+      e->m_is_refreshing = false;
+      if (r == GALLUS_RESULT_OK) {
+        e->m_ip = ip;
+        e->m_expire = gallus_chrono_now() + s_cache_ttl;
+      } else {
+        /*
+         * Keep serving the old one, the grace period bounds it.
+         */
+        gallus_msg_debug(1, "can't refresh %s: %s\n",
+                         name, gallus_error_get_string(r));
+      }
+    }
+  }
+  s_refresh_is_running = false;
+  (void)gallus_mutex_unlock(&s_cache_lock);
+
+  return NULL;
+}
+
+/*
+ * Called with the s_cache_lock held, from s_cache_get().
+ */
+static void
+s_refresh_once_proc(void) {
+  sigset_t all, old;
+
+  /*
+   * Don't let the refresher take any signals.
+   */
+  (void)sigfillset(&all);
+  (void)pthread_sigmask(SIG_SETMASK, &all, &old);
+  s_refresh_do_loop = true;
+  if (pthread_create(&s_refresh_thd, NULL, s_refresh_main, NULL) == 0) {
+    /*
+     * Never joined, it may be stuck in the resolver at exit.
+     */
+    (void)pthread_detach(s_refresh_thd);
+    s_refresh_is_running = true;
+  } else {
+    s_refresh_do_loop = false;
+    gallus_msg_warning("can't start the resolver cache refresher.\n");
+  }
+  (void)pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+static void
+s_once_proc(void) {
+  gallus_result_t r;
+
+  if ((r = gallus_mutex_create(&s_cache_lock)) != GALLUS_RESULT_OK) {
+    gallus_perror(r);
+    gallus_exit_fatal("can't initialize a mutex.\n");
+  }
+  if ((r = gallus_cond_create(&s_cache_cond)) != GALLUS_RESULT_OK) {
+    gallus_perror(r);
+    gallus_exit_fatal("can't initialize a cond.\n");
+  }
+
+  s_is_inited = true;
+}
+
+static inline void
+s_init(void) {
+  (void)pthread_once(&s_once, s_once_proc);
+}
+
+static void
+s_ctors(void) {
+  s_init();
+
+  gallus_msg_debug(10, "The resolver cache is initialized.\n");
+}
+
+static inline void
+s_final(void) {
+  cache_entry_t *e, *next;
+  bool is_running;
+
+  (void)gallus_mutex_lock(&s_cache_lock);
+  {
+    s_refresh_do_loop = false;
+    (void)gallus_cond_notify(&s_cache_cond, true);
+
+    /* the queued ones aren't refreshed any more. */
+    for (e = s_refresh_q; e != NULL; e = next) {
+      next = e->m_refresh_next;
+      if (e->m_name[0] == '\0') {
+        free(e);
+      } else {
+        e->m_is_refreshing = false;
+      }
+    }
+    s_refresh_q = NULL;
+    s_cache_flush();
+    is_running = s_refresh_is_running;
+  }
+  (void)gallus_mutex_unlock(&s_cache_lock);
+
+  /*
+   * A refresher blocked in getaddrinfo(3) still needs the lock when
+   * it returns; leave the lock and the cond to it then.
+   */
+  if (is_running == false) {
+    gallus_cond_destroy(&s_cache_cond);
+    gallus_mutex_destroy(&s_cache_lock);
+  }
+}
+
+static void
+s_dtors(void) {
+  if (s_is_inited == true) {
+    if (gallus_module_is_unloading() &&
+        gallus_module_is_finalized_cleanly()) {
+      s_final();
+
+      gallus_msg_debug(10, "The resolver cache is finalized.\n");
+    } else {
+      gallus_msg_debug(10, "The resolver cache is not finalized "
+                       "because of module finalization problem.\n");
+    }
+  }
+}
+
+/*
+ * Look the name up in the cache, scheduling a refresh for a stale
+ * one. Returns false if it needs resolving now.
+ */
+static inline bool
+s_cache_get(const char *name, bool is_ipv4_addr, uint64_t h,
+            gallus_ip_address_t *ip) {
+  cache_entry_t *e;
+  gallus_chrono_t now;
+  bool ret = false;
+
+  (void)gallus_mutex_lock(&s_cache_lock);
+  {
+    if (s_cache_ttl > 0 &&
+        (e = s_cache_find(name, is_ipv4_addr, h)) != NULL) {
+      now = gallus_chrono_now();
+      if (now < e->m_expire) {
+        *ip = e->m_ip;
+        ret = true;
+      } else if (now < e->m_expire + s_cache_ttl) {
+        (void)pthread_once(&s_refresh_once, s_refresh_once_proc);
+        if (s_refresh_do_loop == true) {
+          *ip = e->m_ip;
+          ret = true;
+          if (e->m_is_refreshing == false) {
+            e->m_is_refreshing = true;
+            e->m_refresh_next = s_refresh_q;
+            s_refresh_q = e;
+            (void)gallus_cond_notify(&s_cache_cond, false);
+          }
+        }
+      }
+    }
+  }
+  (void)gallus_mutex_unlock(&s_cache_lock);
+
+  return ret;
+}
+
+gallus_result_t
+gallus_ip_address_create(const char *name, bool is_ipv4_addr,
+                          gallus_ip_address_t **ip) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  size_t len = 0;
+  uint64_t h;
+
   if (IS_VALID_STRING(name) == true && ip != NULL) {
     *ip = (gallus_ip_address_t *) malloc(sizeof(gallus_ip_address_t));
     if (*ip != NULL) {
       len = strlen(name);
       if (len < GALLUS_ADDR_STR_MAX) {
         memset(*ip, 0, sizeof(gallus_ip_address_t));
-        strncpy((*ip)->addr_str, name, len);
-        (*ip)->addr_str[len] = '\0';
-
-        if (is_ipv4_addr == false) {
-          primary = AF_INET6;
-          secondary = AF_INET;
-        } else {
-          primary = AF_INET;
-          secondary = AF_INET6;
-        }
-        memset(&hints, 0, sizeof(hints));
-        hints.ai_socktype = 0;
-        hints.ai_family = primary;
-        hints.ai_flags = AI_PASSIVE;
-        hints.ai_protocol = 0;
-        hints.ai_canonname = NULL;
-        hints.ai_addr = NULL;
-        hints.ai_next = NULL;
-
-        rc = getaddrinfo((*ip)->addr_str, NULL, &hints, &addr);
-        if (rc == EAI_ADDRFAMILY) {
-          hints.ai_family = secondary;
-          rc = getaddrinfo((*ip)->addr_str, NULL, &hints, &addr);
+
+        if (s_parse_numeric(name, is_ipv4_addr, *ip) == true) {
+          return GALLUS_RESULT_OK;
         }
 
-        if (rc == 0) {
-          rc = getnameinfo(addr->ai_addr, addr->ai_addrlen,
-                           (*ip)->addr_str, GALLUS_ADDR_STR_MAX,
-                           NULL, 0, NI_NOFQDN | NI_NUMERICHOST);
+        h = s_hash(name, is_ipv4_addr);
+        if (s_cache_get(name, is_ipv4_addr, h, *ip) == true) {
+          return GALLUS_RESULT_OK;
         }
 
-        if (rc == 0) {
-          if (addr->ai_family == AF_INET) {
-            (*ip)->is_ipv4 = true;
-          } else {
-            (*ip)->is_ipv4 = false;
+        memset(*ip, 0, sizeof(gallus_ip_address_t));
+        ret = s_resolve(name, is_ipv4_addr, *ip);
+        if (ret == GALLUS_RESULT_OK) {
+          (void)gallus_mutex_lock(&s_cache_lock);
+          {
+            if (s_cache_ttl > 0) {
+              s_cache_put(name, is_ipv4_addr, h, *ip);
+            }
           }
-
-          /*
-           *  The ai_addrlen, which is a length of sockaddr,
-           *  is shorter than a length of sockaddr_storage.
-           */
-          memcpy(&((*ip)->saddr), addr->ai_addr, addr->ai_addrlen);
-          (*ip)->saddr_len = addr->ai_addrlen;
-
-          freeaddrinfo((void *) addr);
+          (void)gallus_mutex_unlock(&s_cache_lock);
           return GALLUS_RESULT_OK;
-        } else if (rc == EAI_MEMORY) {
-          ret = GALLUS_RESULT_NO_MEMORY;
-        } else if (rc == EAI_SYSTEM) {
-          ret = GALLUS_RESULT_POSIX_API_ERROR;
-        } else {
-          ret = GALLUS_RESULT_ADDR_RESOLVER_FAILURE;
         }
       } else {
         ret = GALLUS_RESULT_OUT_OF_RANGE;
@@ -90,9 +489,6 @@ gallus_ip_address_create(const char *name, bool is_ipv4_addr,
       ret = GALLUS_RESULT_NO_MEMORY;
     }
 
-    if (addr != NULL) {
-      freeaddrinfo((void *) addr);
-    }
     free((void *) *ip);
     *ip = NULL;
     return ret;
@@ -101,6 +497,27 @@ gallus_ip_address_create(const char *name, bool is_ipv4_addr,
   return GALLUS_RESULT_INVALID_ARGS;
 }
 
+gallus_result_t
+gallus_ip_address_cache_ttl_set(gallus_chrono_t ttl) {
+  (void)gallus_mutex_lock(&s_cache_lock);
+  {
+    s_cache_ttl = (ttl > 0) ? ttl : 0;
+    s_cache_flush();
+  }
+  (void)gallus_mutex_unlock(&s_cache_lock);
+
+  return GALLUS_RESULT_OK;
+}
+
+void
+gallus_ip_address_cache_flush(void) {
+  (void)gallus_mutex_lock(&s_cache_lock);
+  {
+    s_cache_flush();
+  }
+  (void)gallus_mutex_unlock(&s_cache_lock);
+}
+
 void
 gallus_ip_address_destroy(gallus_ip_address_t *ip) {
   free((void *) ip);
@@ -1,5 +1,11 @@
 #include "gallus_apis.h"
 #include "gallus_config.h"
+#include "gallus_fiber_internal.h"
+
+#ifdef GALLUS_OS_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif /* GALLUS_OS_LINUX */
 
 
 
@@ -7,20 +13,37 @@
 
 struct gallus_mutex_record {
   pthread_mutex_t m_mtx;
+  uint32_t m_futex;	/* FUTEX: 0 free, 1 locked, 2 contended. */
   pid_t m_creator_pid;
   gallus_mutex_type_t m_type;
 };
 
 
+/*
+ * A reader count of the DISTRIBUTED rwlock, a cache line each.
+ */
+typedef struct {
+  uint32_t m_n_readers;
+} __attribute__((aligned(64))) drw_slot_record;
+
+
 struct gallus_rwlock_record {
   pthread_rwlock_t m_rwl;
+  uint32_t m_state;	/* FUTEX: FRW_* | # of the readers,
+                           DISTRIBUTED: the writers' mutex. */
+  uint32_t m_wstate;	/* DISTRIBUTED: DRW_*. */
+  drw_slot_record *m_slots;	/* DISTRIBUTED: s_n_drw_slots. */
   pid_t m_creator_pid;
+  gallus_rwlock_type_t m_type;
 };
 
 
 struct gallus_cond_record {
   pthread_cond_t m_cond;
   pid_t m_creator_pid;
+  gallus_fiber_waitq_record m_fwq;	/* the fibers parked on. */
+  uint32_t m_fseq;		/* bumped for the FUTEX mutex waiters. */
+  uint32_t m_n_fwaiters;
 };
 
 
@@ -33,6 +56,22 @@ struct gallus_barrier_record {
 typedef int (*notify_proc_t)(pthread_cond_t *cnd);
 
 
+/*
+ * Spins before sleeping on a futex.
+ */
+#define FUTEX_SPINS	100
+
+#define FRW_WRITER	0x80000000U
+#define FRW_WAITING	0x40000000U
+
+#define DRW_PENDING	0x1U	/* a writer sweeps, the readers back off. */
+#define DRW_HELD	0x2U	/* the sweep is done, the writer is in. */
+#define DRW_WAITING	0x4U	/* some readers sleep on the m_wstate. */
+
+#define DRW_MIN_SLOTS	4
+#define DRW_MAX_SLOTS	128
+
+
 
 
 
@@ -44,6 +83,23 @@ static notify_proc_t s_notify_all_proc = pthread_cond_broadcast;
 
 static pthread_mutexattr_t s_recur_attr;
 
+static size_t s_n_drw_slots = DRW_MIN_SLOTS;	/* a power of 2. */
+static size_t s_drw_next_slot = 0;
+static __thread ssize_t s_drw_slot = -1;	/* The slot I read in. */
+
+/*
+ * Count the locks bound to the owner thread: the pthread ones and
+ * the read side of the DISTRIBUTED rwlock. The futex ones are not.
+ */
+#ifndef NDEBUG
+__thread size_t gallus_fiber_n_bound_locks = 0;
+#define s_bound_lock_taken()	(gallus_fiber_n_bound_locks++)
+#define s_bound_lock_released()	(gallus_fiber_n_bound_locks--)
+#else
+#define s_bound_lock_taken()
+#define s_bound_lock_released()
+#endif /* ! NDEBUG */
+
 
 
 
@@ -69,6 +125,15 @@ s_once_proc(void) {
     gallus_exit_fatal("can't initialize a recursive mutex attribute.\n");
   }
 #undef RECURSIVE_MUTEX_ATTR
+
+  {
+    long n = sysconf(_SC_NPROCESSORS_CONF);
+
+    while ((long)s_n_drw_slots < n && s_n_drw_slots < DRW_MAX_SLOTS) {
+      s_n_drw_slots <<= 1;
+    }
+  }
+
   s_is_inited = true;
 }
 
@@ -113,6 +178,491 @@ s_dtors(void) {
 
 
 
+/*
+ * Sleep while the *addr is the val, until the deadline (< 0:
+ * forever). It may return spuriously, the callers recheck.
+ */
+static inline gallus_result_t
+s_futex_wait(uint32_t *addr, uint32_t val, gallus_chrono_t deadline) {
+  gallus_result_t ret = GALLUS_RESULT_OK;
+  gallus_chrono_t now = 0;
+  int oerrno = errno;
+
+  if (deadline >= 0) {
+    WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+  }
+
+  if (deadline >= 0 && now >= deadline) {
+    ret = GALLUS_RESULT_TIMEDOUT;
+  } else {
+#ifdef GALLUS_OS_LINUX
+    struct timespec ts;
+    struct timespec *tsptr = NULL;
+
+    if (deadline >= 0) {
+      NSEC_TO_TS(deadline - now, ts);
+      tsptr = &ts;
+    }
+    if (syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, tsptr,
+                NULL, 0) != 0 &&
+        errno == ETIMEDOUT) {
+      ret = GALLUS_RESULT_TIMEDOUT;
+    }
+#else
+    (void)addr;
+    (void)val;
+    (void)sched_yield();
+#endif /* GALLUS_OS_LINUX */
+  }
+
+  errno = oerrno;
+  return ret;
+}
+
+
+static inline void
+s_futex_wake(uint32_t *addr, int n) {
+#ifdef GALLUS_OS_LINUX
+  int oerrno = errno;
+
+  (void)syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+  errno = oerrno;
+#else
+  (void)addr;
+  (void)n;
+#endif /* GALLUS_OS_LINUX */
+}
+
+
+static inline gallus_chrono_t
+s_deadline(gallus_chrono_t nsec) {
+  gallus_chrono_t now = -1LL;
+
+  if (nsec >= 0) {
+    WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+    now += nsec;
+  }
+
+  return now;
+}
+
+
+/*
+ * The FUTEX mutex, the three states one: the unlocker issues the
+ * wake only if somebody has marked the lock contended. Also the
+ * writers' lock of the DISTRIBUTED rwlock.
+ */
+static inline gallus_result_t
+s_fmtx_lock(uint32_t *fp, gallus_chrono_t deadline) {
+  gallus_result_t ret = GALLUS_RESULT_OK;
+  uint32_t c = 0;
+  size_t i;
+
+  for (i = 0; i < FUTEX_SPINS; i++) {
+    c = 0;
+    if (__atomic_compare_exchange_n(fp, &c, 1, false,
+                                    __ATOMIC_ACQUIRE,
+                                    __ATOMIC_RELAXED) == true ||
+        c == 2) {
+      break;
+    }
+    gallus_spin_pause();
+  }
+
+  if (c != 0) {
+    c = __atomic_exchange_n(fp, 2, __ATOMIC_ACQUIRE);
+    while (c != 0 &&
+           (ret = s_futex_wait(fp, 2, deadline)) ==
+           GALLUS_RESULT_OK) {
+      c = __atomic_exchange_n(fp, 2, __ATOMIC_ACQUIRE);
+    }
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+s_fmtx_trylock(uint32_t *fp) {
+  uint32_t c = 0;
+
+  return (__atomic_compare_exchange_n(fp, &c, 1, false,
+                                      __ATOMIC_ACQUIRE,
+                                      __ATOMIC_RELAXED) == true) ?
+      GALLUS_RESULT_OK : GALLUS_RESULT_BUSY;
+}
+
+
+static inline void
+s_fmtx_unlock(uint32_t *fp) {
+  if (__atomic_exchange_n(fp, 0, __ATOMIC_RELEASE) == 2) {
+    s_futex_wake(fp, 1);
+  }
+}
+
+
+/*
+ * The FUTEX rwlock: a writer bit, a waiting bit and the reader
+ * count in a word. The readers only wait for a writer holding the
+ * lock, not for the waiting ones, so the readers win. Who releases
+ * the lock with the waiting bit set wakes all the waiters up.
+ */
+static inline gallus_result_t
+s_frw_rdlock(gallus_rwlock_t rwl, gallus_chrono_t deadline) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  uint32_t s = __atomic_load_n(&(rwl->m_state), __ATOMIC_RELAXED);
+  size_t spins = 0;
+
+  for (;;) {
+    if ((s & FRW_WRITER) == 0) {
+      if (__atomic_compare_exchange_n(&(rwl->m_state), &s, s + 1, true,
+                                      __ATOMIC_ACQUIRE,
+                                      __ATOMIC_RELAXED) == true) {
+        ret = GALLUS_RESULT_OK;
+        break;
+      }
+    } else if (spins++ < FUTEX_SPINS) {
+      gallus_spin_pause();
+      s = __atomic_load_n(&(rwl->m_state), __ATOMIC_RELAXED);
+    } else if ((s & FRW_WAITING) != 0 ||
+               __atomic_compare_exchange_n(&(rwl->m_state), &s,
+                                           s | FRW_WAITING, false,
+                                           __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED) == true) {
+      if (s_futex_wait(&(rwl->m_state), s | FRW_WAITING, deadline) ==
+          GALLUS_RESULT_TIMEDOUT) {
+        ret = GALLUS_RESULT_TIMEDOUT;
+        break;
+      }
+      s = __atomic_load_n(&(rwl->m_state), __ATOMIC_RELAXED);
+    }
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+s_frw_wrlock(gallus_rwlock_t rwl, gallus_chrono_t deadline) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  uint32_t s = __atomic_load_n(&(rwl->m_state), __ATOMIC_RELAXED);
+  size_t spins = 0;
+
+  for (;;) {
+    if ((s & ~FRW_WAITING) == 0) {
+      if (__atomic_compare_exchange_n(&(rwl->m_state), &s, s | FRW_WRITER,
+                                      true,
+                                      __ATOMIC_ACQUIRE,
+                                      __ATOMIC_RELAXED) == true) {
+        ret = GALLUS_RESULT_OK;
+        break;
+      }
+    } else if (spins++ < FUTEX_SPINS) {
+      gallus_spin_pause();
+      s = __atomic_load_n(&(rwl->m_state), __ATOMIC_RELAXED);
+    } else if ((s & FRW_WAITING) != 0 ||
+               __atomic_compare_exchange_n(&(rwl->m_state), &s,
+                                           s | FRW_WAITING, false,
+                                           __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED) == true) {
+      if (s_futex_wait(&(rwl->m_state), s | FRW_WAITING, deadline) ==
+          GALLUS_RESULT_TIMEDOUT) {
+        ret = GALLUS_RESULT_TIMEDOUT;
+        break;
+      }
+      s = __atomic_load_n(&(rwl->m_state), __ATOMIC_RELAXED);
+    }
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+s_frw_tryrdlock(gallus_rwlock_t rwl) {
+  gallus_result_t ret = GALLUS_RESULT_BUSY;
+  uint32_t s = __atomic_load_n(&(rwl->m_state), __ATOMIC_RELAXED);
+
+  while ((s & FRW_WRITER) == 0) {
+    if (__atomic_compare_exchange_n(&(rwl->m_state), &s, s + 1, true,
+                                    __ATOMIC_ACQUIRE,
+                                    __ATOMIC_RELAXED) == true) {
+      ret = GALLUS_RESULT_OK;
+      break;
+    }
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+s_frw_trywrlock(gallus_rwlock_t rwl) {
+  uint32_t s = __atomic_load_n(&(rwl->m_state), __ATOMIC_RELAXED);
+
+  return ((s & ~FRW_WAITING) == 0 &&
+          __atomic_compare_exchange_n(&(rwl->m_state), &s, s | FRW_WRITER,
+                                      false,
+                                      __ATOMIC_ACQUIRE,
+                                      __ATOMIC_RELAXED) == true) ?
+      GALLUS_RESULT_OK : GALLUS_RESULT_BUSY;
+}
+
+
+static inline void
+s_frw_unlock(gallus_rwlock_t rwl) {
+  uint32_t s = __atomic_load_n(&(rwl->m_state), __ATOMIC_RELAXED);
+
+  /*
+   * Only the holding writer sees its own writer bit.
+   */
+  if ((s & FRW_WRITER) != 0) {
+    s = __atomic_fetch_and(&(rwl->m_state), ~(FRW_WRITER | FRW_WAITING),
+                           __ATOMIC_RELEASE);
+    if ((s & FRW_WAITING) != 0) {
+      s_futex_wake(&(rwl->m_state), INT_MAX);
+    }
+  } else {
+    s = __atomic_sub_fetch(&(rwl->m_state), 1, __ATOMIC_RELEASE);
+    if (s == FRW_WAITING &&
+        __atomic_compare_exchange_n(&(rwl->m_state), &s, 0, false,
+                                    __ATOMIC_RELAXED,
+                                    __ATOMIC_RELAXED) == true) {
+      s_futex_wake(&(rwl->m_state), INT_MAX);
+    }
+  }
+}
+
+
+
+
+
+/*
+ * The DISTRIBUTED (big reader) rwlock: a reader only bumps the
+ * count in its own slot and checks the writer state, so the readers
+ * on the different CPUs don't share any written cache line. A
+ * writer takes the writers' mutex, raises the pending bit to turn
+ * the new readers away and sweeps all the slots until they drain.
+ *
+ * Each thread sticks to a slot, assigned round robin on its first
+ * read lock, so a read lock must be released by the same thread.
+ */
+static inline drw_slot_record *
+s_drw_my_slot(gallus_rwlock_t rwl) {
+  if (unlikely(s_drw_slot < 0)) {
+    s_drw_slot = (ssize_t)(__atomic_fetch_add(&s_drw_next_slot, 1,
+                                              __ATOMIC_RELAXED) &
+                           (s_n_drw_slots - 1));
+  }
+  return &(rwl->m_slots[s_drw_slot]);
+}
+
+
+static inline gallus_result_t
+s_drw_rdlock(gallus_rwlock_t rwl, gallus_chrono_t deadline) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  drw_slot_record *slot = s_drw_my_slot(rwl);
+  size_t spins = 0;
+  uint32_t w;
+
+  while (ret == GALLUS_RESULT_ANY_FAILURES) {
+    /*
+     * The count and the writer state are ordered against the
+     * writer's pending bit and its sweep, both seq_cst.
+     */
+    (void)__atomic_add_fetch(&(slot->m_n_readers), 1, __ATOMIC_SEQ_CST);
+    if (likely(__atomic_load_n(&(rwl->m_wstate), __ATOMIC_SEQ_CST) == 0)) {
+      s_bound_lock_taken();
+      ret = GALLUS_RESULT_OK;
+    } else {
+      (void)__atomic_sub_fetch(&(slot->m_n_readers), 1, __ATOMIC_RELEASE);
+      while (ret == GALLUS_RESULT_ANY_FAILURES &&
+             (w = __atomic_load_n(&(rwl->m_wstate), __ATOMIC_ACQUIRE)) != 0) {
+        if (spins++ < FUTEX_SPINS) {
+          gallus_spin_pause();
+        } else if ((w & DRW_WAITING) != 0 ||
+                   __atomic_compare_exchange_n(&(rwl->m_wstate), &w,
+                                               w | DRW_WAITING, false,
+                                               __ATOMIC_RELAXED,
+                                               __ATOMIC_RELAXED) == true) {
+          if (s_futex_wait(&(rwl->m_wstate), w | DRW_WAITING, deadline) ==
+              GALLUS_RESULT_TIMEDOUT) {
+            ret = GALLUS_RESULT_TIMEDOUT;
+          }
+        }
+      }
+    }
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+s_drw_tryrdlock(gallus_rwlock_t rwl) {
+  gallus_result_t ret = GALLUS_RESULT_BUSY;
+  drw_slot_record *slot = s_drw_my_slot(rwl);
+
+  (void)__atomic_add_fetch(&(slot->m_n_readers), 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&(rwl->m_wstate), __ATOMIC_SEQ_CST) == 0) {
+    s_bound_lock_taken();
+    ret = GALLUS_RESULT_OK;
+  } else {
+    (void)__atomic_sub_fetch(&(slot->m_n_readers), 1, __ATOMIC_RELEASE);
+  }
+
+  return ret;
+}
+
+
+static inline void
+s_drw_wrunlock(gallus_rwlock_t rwl) {
+  if ((__atomic_exchange_n(&(rwl->m_wstate), 0, __ATOMIC_RELEASE) &
+       DRW_WAITING) != 0) {
+    s_futex_wake(&(rwl->m_wstate), INT_MAX);
+  }
+  s_fmtx_unlock(&(rwl->m_state));
+}
+
+
+/*
+ * Wait for the readers in all the slots to drain, or until the
+ * deadline (< 0: forever). With the deadline 0 it only checks.
+ */
+static inline gallus_result_t
+s_drw_sweep(gallus_rwlock_t rwl, gallus_chrono_t deadline) {
+  gallus_result_t ret = GALLUS_RESULT_OK;
+  gallus_chrono_t now;
+  size_t i;
+  size_t loops = 0;
+
+  (void)__atomic_fetch_or(&(rwl->m_wstate), DRW_PENDING, __ATOMIC_SEQ_CST);
+
+  for (i = 0; i < s_n_drw_slots && ret == GALLUS_RESULT_OK; i++) {
+    while (__atomic_load_n(&(rwl->m_slots[i].m_n_readers),
+                           __ATOMIC_SEQ_CST) != 0) {
+      if (deadline >= 0) {
+        WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+        if (now >= deadline) {
+          ret = GALLUS_RESULT_TIMEDOUT;
+          break;
+        }
+      }
+      gallus_spin_wait(&loops);
+    }
+  }
+
+  if (ret == GALLUS_RESULT_OK) {
+    (void)__atomic_fetch_or(&(rwl->m_wstate), DRW_HELD, __ATOMIC_ACQUIRE);
+  } else {
+    s_drw_wrunlock(rwl);
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+s_drw_wrlock(gallus_rwlock_t rwl, gallus_chrono_t deadline) {
+  gallus_result_t ret = s_fmtx_lock(&(rwl->m_state), deadline);
+
+  if (ret == GALLUS_RESULT_OK) {
+    ret = s_drw_sweep(rwl, deadline);
+  }
+
+  return ret;
+}
+
+
+static inline gallus_result_t
+s_drw_trywrlock(gallus_rwlock_t rwl) {
+  gallus_result_t ret = s_fmtx_trylock(&(rwl->m_state));
+
+  if (ret == GALLUS_RESULT_OK &&
+      s_drw_sweep(rwl, 0LL) != GALLUS_RESULT_OK) {
+    ret = GALLUS_RESULT_BUSY;
+  }
+
+  return ret;
+}
+
+
+static inline void
+s_drw_unlock(gallus_rwlock_t rwl) {
+  /*
+   * No reader can be in while the held bit is up.
+   */
+  if ((__atomic_load_n(&(rwl->m_wstate), __ATOMIC_RELAXED) &
+       DRW_HELD) != 0) {
+    s_drw_wrunlock(rwl);
+  } else {
+    s_bound_lock_released();
+    (void)__atomic_sub_fetch(&(s_drw_my_slot(rwl)->m_n_readers), 1,
+                             __ATOMIC_RELEASE);
+  }
+}
+
+
+/*
+ * Dispatch the lightweight rwlock types.
+ */
+static inline gallus_result_t
+s_lwrw_rdlock(gallus_rwlock_t rwl, gallus_chrono_t deadline) {
+  return (rwl->m_type == GALLUS_RWLOCK_TYPE_FUTEX) ?
+      s_frw_rdlock(rwl, deadline) : s_drw_rdlock(rwl, deadline);
+}
+
+
+static inline gallus_result_t
+s_lwrw_wrlock(gallus_rwlock_t rwl, gallus_chrono_t deadline) {
+  return (rwl->m_type == GALLUS_RWLOCK_TYPE_FUTEX) ?
+      s_frw_wrlock(rwl, deadline) : s_drw_wrlock(rwl, deadline);
+}
+
+
+static inline gallus_result_t
+s_lwrw_tryrdlock(gallus_rwlock_t rwl) {
+  return (rwl->m_type == GALLUS_RWLOCK_TYPE_FUTEX) ?
+      s_frw_tryrdlock(rwl) : s_drw_tryrdlock(rwl);
+}
+
+
+static inline gallus_result_t
+s_lwrw_trywrlock(gallus_rwlock_t rwl) {
+  return (rwl->m_type == GALLUS_RWLOCK_TYPE_FUTEX) ?
+      s_frw_trywrlock(rwl) : s_drw_trywrlock(rwl);
+}
+
+
+static inline void
+s_lwrw_unlock(gallus_rwlock_t rwl) {
+  if (rwl->m_type == GALLUS_RWLOCK_TYPE_FUTEX) {
+    s_frw_unlock(rwl);
+  } else {
+    s_drw_unlock(rwl);
+  }
+}
+
+
+
+
+
+static inline int
+s_mutex_init(gallus_mutex_t mtx, gallus_mutex_type_t type,
+             pthread_mutexattr_t *attr) {
+  int st;
+
+  if (type == GALLUS_MUTEX_TYPE_FUTEX) {
+    __atomic_store_n(&(mtx->m_futex), 0, __ATOMIC_RELEASE);
+    st = 0;
+  } else {
+    st = pthread_mutex_init(&(mtx->m_mtx), attr);
+  }
+
+  return st;
+}
+
+
 static inline gallus_result_t
 s_create(gallus_mutex_t *mtxptr, gallus_mutex_type_t type) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
@@ -133,6 +683,9 @@ s_create(gallus_mutex_t *mtxptr, gallus_mutex_type_t type) {
           attr = &s_recur_attr;
           break;
         }
+        case GALLUS_MUTEX_TYPE_FUTEX: {
+          break;
+        }
         default: {
           gallus_exit_fatal("Invalid gallus mutex type (%d).\n",
                              (int)type);
@@ -142,7 +695,7 @@ s_create(gallus_mutex_t *mtxptr, gallus_mutex_type_t type) {
       }
 
       errno = 0;
-      if ((st = pthread_mutex_init(&(mtx->m_mtx), attr)) == 0) {
+      if ((st = s_mutex_init(mtx, type, attr)) == 0) {
         mtx->m_type = type;
         mtx->m_creator_pid = getpid();
         *mtxptr = mtx;
@@ -180,11 +733,34 @@ gallus_mutex_create_recursive(gallus_mutex_t *mtxptr) {
 }
 
 
+gallus_result_t
+gallus_mutex_create_with_type(gallus_mutex_t *mtxptr,
+                               gallus_mutex_type_t type) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  switch (type) {
+    case GALLUS_MUTEX_TYPE_DEFAULT:
+    case GALLUS_MUTEX_TYPE_RECURSIVE:
+    case GALLUS_MUTEX_TYPE_FUTEX: {
+      ret = s_create(mtxptr, type);
+      break;
+    }
+    default: {
+      ret = GALLUS_RESULT_INVALID_ARGS;
+      break;
+    }
+  }
+
+  return ret;
+}
+
+
 void
 gallus_mutex_destroy(gallus_mutex_t *mtxptr) {
   if (mtxptr != NULL &&
       *mtxptr != NULL) {
-    if ((*mtxptr)->m_creator_pid == getpid()) {
+    if ((*mtxptr)->m_creator_pid == getpid() &&
+        (*mtxptr)->m_type != GALLUS_MUTEX_TYPE_FUTEX) {
       (void)pthread_mutex_destroy(&((*mtxptr)->m_mtx));
     }
     free((void *)*mtxptr);
@@ -210,6 +786,9 @@ gallus_mutex_reinitialize(gallus_mutex_t *mtxptr) {
         attr = &s_recur_attr;
         break;
       }
+      case GALLUS_MUTEX_TYPE_FUTEX: {
+        break;
+      }
       default: {
         gallus_exit_fatal("Invalid gallus mutex type (%d).\n",
                            (*mtxptr)->m_type);
@@ -219,7 +798,7 @@ gallus_mutex_reinitialize(gallus_mutex_t *mtxptr) {
     }
 
     errno = 0;
-    if ((st = pthread_mutex_init(&((*mtxptr)->m_mtx), attr)) == 0) {
+    if ((st = s_mutex_init(*mtxptr, (*mtxptr)->m_type, attr)) == 0) {
       ret = GALLUS_RESULT_OK;
     } else {
       errno = st;
@@ -255,7 +834,10 @@ gallus_mutex_lock(gallus_mutex_t *mtxptr) {
   if (mtxptr != NULL &&
       *mtxptr != NULL) {
     int st;
-    if ((st = pthread_mutex_lock(&((*mtxptr)->m_mtx))) == 0) {
+    if ((*mtxptr)->m_type == GALLUS_MUTEX_TYPE_FUTEX) {
+      ret = s_fmtx_lock(&((*mtxptr)->m_futex), -1LL);
+    } else if ((st = pthread_mutex_lock(&((*mtxptr)->m_mtx))) == 0) {
+      s_bound_lock_taken();
       ret = GALLUS_RESULT_OK;
     } else {
       errno = st;
@@ -276,7 +858,10 @@ gallus_mutex_trylock(gallus_mutex_t *mtxptr) {
   if (mtxptr != NULL &&
       *mtxptr != NULL) {
     int st;
-    if ((st = pthread_mutex_trylock(&((*mtxptr)->m_mtx))) == 0) {
+    if ((*mtxptr)->m_type == GALLUS_MUTEX_TYPE_FUTEX) {
+      ret = s_fmtx_trylock(&((*mtxptr)->m_futex));
+    } else if ((st = pthread_mutex_trylock(&((*mtxptr)->m_mtx))) == 0) {
+      s_bound_lock_taken();
       ret = GALLUS_RESULT_OK;
     } else {
       errno = st;
@@ -303,8 +888,11 @@ gallus_mutex_timedlock(gallus_mutex_t *mtxptr,
       *mtxptr != NULL) {
     int st;
 
-    if (nsec < 0) {
+    if ((*mtxptr)->m_type == GALLUS_MUTEX_TYPE_FUTEX) {
+      ret = s_fmtx_lock(&((*mtxptr)->m_futex), s_deadline(nsec));
+    } else if (nsec < 0) {
       if ((st = pthread_mutex_lock(&((*mtxptr)->m_mtx))) == 0) {
+        s_bound_lock_taken();
         ret = GALLUS_RESULT_OK;
       } else {
         errno = st;
@@ -314,12 +902,13 @@ gallus_mutex_timedlock(gallus_mutex_t *mtxptr,
       struct timespec ts;
       gallus_chrono_t now;
 
-      WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+      WHAT_TIME_IS_IT_NOW_REALTIME_IN_NSEC(now);
       now += nsec;
       NSEC_TO_TS(now, ts);
 
       if ((st = pthread_mutex_timedlock(&((*mtxptr)->m_mtx),
                                         &ts)) == 0) {
+        s_bound_lock_taken();
         ret = GALLUS_RESULT_OK;
       } else {
         errno = st;
@@ -350,7 +939,11 @@ gallus_mutex_unlock(gallus_mutex_t *mtxptr) {
     /*
      * The caller must have this mutex locked.
      */
-    if ((st = pthread_mutex_unlock(&((*mtxptr)->m_mtx))) == 0) {
+    if ((*mtxptr)->m_type == GALLUS_MUTEX_TYPE_FUTEX) {
+      s_fmtx_unlock(&((*mtxptr)->m_futex));
+      ret = GALLUS_RESULT_OK;
+    } else if ((st = pthread_mutex_unlock(&((*mtxptr)->m_mtx))) == 0) {
+      s_bound_lock_released();
       ret = GALLUS_RESULT_OK;
     } else {
       errno = st;
@@ -372,9 +965,16 @@ gallus_mutex_enter_critical(gallus_mutex_t *mtxptr, int *ostateptr) {
       ostateptr != NULL) {
     int st;
 
-    if ((st = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,
-                                     ostateptr)) == 0) {
+    if ((*mtxptr)->m_type == GALLUS_MUTEX_TYPE_FUTEX) {
+      /*
+       * The cancel state is left as is.
+       */
+      *ostateptr = PTHREAD_CANCEL_DISABLE;
+      ret = s_fmtx_lock(&((*mtxptr)->m_futex), -1LL);
+    } else if ((st = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,
+                                            ostateptr)) == 0) {
       if ((st = pthread_mutex_lock(&((*mtxptr)->m_mtx))) == 0) {
+        s_bound_lock_taken();
         ret = GALLUS_RESULT_OK;
       } else {
         errno = st;
@@ -404,7 +1004,11 @@ gallus_mutex_leave_critical(gallus_mutex_t *mtxptr, int ostate) {
     /*
      * The caller must have this mutex locked.
      */
-    if ((st = pthread_mutex_unlock(&((*mtxptr)->m_mtx))) == 0) {
+    if ((*mtxptr)->m_type == GALLUS_MUTEX_TYPE_FUTEX) {
+      s_fmtx_unlock(&((*mtxptr)->m_futex));
+      ret = GALLUS_RESULT_OK;
+    } else if ((st = pthread_mutex_unlock(&((*mtxptr)->m_mtx))) == 0) {
+      s_bound_lock_released();
       if ((st = pthread_setcancelstate(ostate, NULL)) == 0) {
           ret = GALLUS_RESULT_OK;
           if (ostate == PTHREAD_CANCEL_ENABLE) {
@@ -429,8 +1033,29 @@ gallus_mutex_leave_critical(gallus_mutex_t *mtxptr, int ostate) {
 
 
 
-gallus_result_t
-gallus_rwlock_create(gallus_rwlock_t *rwlptr) {
+static inline int
+s_rwlock_init(gallus_rwlock_t rwl, gallus_rwlock_type_t type) {
+  int st;
+
+  if (type == GALLUS_RWLOCK_TYPE_FUTEX) {
+    __atomic_store_n(&(rwl->m_state), 0, __ATOMIC_RELEASE);
+    st = 0;
+  } else if (type == GALLUS_RWLOCK_TYPE_DISTRIBUTED) {
+    (void)memset((void *)rwl->m_slots, 0,
+                 sizeof(drw_slot_record) * s_n_drw_slots);
+    rwl->m_wstate = 0;
+    __atomic_store_n(&(rwl->m_state), 0, __ATOMIC_RELEASE);
+    st = 0;
+  } else {
+    st = pthread_rwlock_init(&(rwl->m_rwl), NULL);
+  }
+
+  return st;
+}
+
+
+static inline gallus_result_t
+s_rwlock_create(gallus_rwlock_t *rwlptr, gallus_rwlock_type_t type) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
   gallus_rwlock_t rwl = NULL;
 
@@ -438,9 +1063,17 @@ gallus_rwlock_create(gallus_rwlock_t *rwlptr) {
     *rwlptr = NULL;
     rwl = (gallus_rwlock_t)malloc(sizeof(*rwl));
     if (rwl != NULL) {
-      int st;
+      int st = 0;
+      rwl->m_slots = NULL;
       errno = 0;
-      if ((st = pthread_rwlock_init(&(rwl->m_rwl), NULL)) == 0) {
+      if (type == GALLUS_RWLOCK_TYPE_DISTRIBUTED) {
+        s_init();	/* s_n_drw_slots. */
+        st = posix_memalign((void **)&(rwl->m_slots), 64,
+                            sizeof(drw_slot_record) * s_n_drw_slots);
+      }
+      if (st == 0 &&
+          (st = s_rwlock_init(rwl, type)) == 0) {
+        rwl->m_type = type;
         rwl->m_creator_pid = getpid();
         *rwlptr = rwl;
         ret = GALLUS_RESULT_OK;
@@ -451,7 +1084,8 @@ gallus_rwlock_create(gallus_rwlock_t *rwlptr) {
     } else {
       ret = GALLUS_RESULT_NO_MEMORY;
     }
-    if (ret != GALLUS_RESULT_OK) {
+    if (ret != GALLUS_RESULT_OK && rwl != NULL) {
+      free((void *)rwl->m_slots);
       free((void *)rwl);
     }
   } else {
@@ -462,13 +1096,43 @@ gallus_rwlock_create(gallus_rwlock_t *rwlptr) {
 }
 
 
+gallus_result_t
+gallus_rwlock_create(gallus_rwlock_t *rwlptr) {
+  return s_rwlock_create(rwlptr, GALLUS_RWLOCK_TYPE_DEFAULT);
+}
+
+
+gallus_result_t
+gallus_rwlock_create_with_type(gallus_rwlock_t *rwlptr,
+                                gallus_rwlock_type_t type) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  switch (type) {
+    case GALLUS_RWLOCK_TYPE_DEFAULT:
+    case GALLUS_RWLOCK_TYPE_FUTEX:
+    case GALLUS_RWLOCK_TYPE_DISTRIBUTED: {
+      ret = s_rwlock_create(rwlptr, type);
+      break;
+    }
+    default: {
+      ret = GALLUS_RESULT_INVALID_ARGS;
+      break;
+    }
+  }
+
+  return ret;
+}
+
+
 void
 gallus_rwlock_destroy(gallus_rwlock_t *rwlptr) {
   if (rwlptr != NULL &&
       *rwlptr != NULL) {
-    if ((*rwlptr)->m_creator_pid == getpid()) {
+    if ((*rwlptr)->m_creator_pid == getpid() &&
+        (*rwlptr)->m_type == GALLUS_RWLOCK_TYPE_DEFAULT) {
       (void)pthread_rwlock_destroy(&((*rwlptr)->m_rwl));
     }
+    free((void *)(*rwlptr)->m_slots);
     free((void *)*rwlptr);
     *rwlptr = NULL;
   }
@@ -484,7 +1148,7 @@ gallus_rwlock_reinitialize(gallus_rwlock_t *rwlptr) {
     int st;
 
     errno = 0;
-    if ((st = pthread_rwlock_init(&((*rwlptr)->m_rwl), NULL)) == 0) {
+    if ((st = s_rwlock_init(*rwlptr, (*rwlptr)->m_type)) == 0) {
       ret = GALLUS_RESULT_OK;
     } else {
       errno = st;
@@ -498,6 +1162,21 @@ gallus_rwlock_reinitialize(gallus_rwlock_t *rwlptr) {
 }
 
 
+gallus_result_t
+gallus_rwlock_get_type(gallus_rwlock_t *rwlptr, gallus_rwlock_type_t *tptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (rwlptr != NULL && *rwlptr != NULL && tptr != NULL) {
+    *tptr = (*rwlptr)->m_type;
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
 gallus_result_t
 gallus_rwlock_reader_lock(gallus_rwlock_t *rwlptr) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
@@ -505,7 +1184,10 @@ gallus_rwlock_reader_lock(gallus_rwlock_t *rwlptr) {
   if (rwlptr != NULL &&
       *rwlptr != NULL) {
     int st;
-    if ((st = pthread_rwlock_rdlock(&((*rwlptr)->m_rwl))) == 0) {
+    if ((*rwlptr)->m_type != GALLUS_RWLOCK_TYPE_DEFAULT) {
+      ret = s_lwrw_rdlock(*rwlptr, -1LL);
+    } else if ((st = pthread_rwlock_rdlock(&((*rwlptr)->m_rwl))) == 0) {
+      s_bound_lock_taken();
       ret = GALLUS_RESULT_OK;
     } else {
       errno = st;
@@ -526,7 +1208,10 @@ gallus_rwlock_reader_trylock(gallus_rwlock_t *rwlptr) {
   if (rwlptr != NULL &&
       *rwlptr != NULL) {
     int st;
-    if ((st = pthread_rwlock_tryrdlock(&((*rwlptr)->m_rwl))) == 0) {
+    if ((*rwlptr)->m_type != GALLUS_RWLOCK_TYPE_DEFAULT) {
+      ret = s_lwrw_tryrdlock(*rwlptr);
+    } else if ((st = pthread_rwlock_tryrdlock(&((*rwlptr)->m_rwl))) == 0) {
+      s_bound_lock_taken();
       ret = GALLUS_RESULT_OK;
     } else {
       errno = st;
@@ -553,8 +1238,11 @@ gallus_rwlock_reader_timedlock(gallus_rwlock_t *rwlptr,
       *rwlptr != NULL) {
     int st;
 
-    if (nsec < 0) {
+    if ((*rwlptr)->m_type != GALLUS_RWLOCK_TYPE_DEFAULT) {
+      ret = s_lwrw_rdlock(*rwlptr, s_deadline(nsec));
+    } else if (nsec < 0) {
       if ((st = pthread_rwlock_rdlock(&((*rwlptr)->m_rwl))) == 0) {
+        s_bound_lock_taken();
         ret = GALLUS_RESULT_OK;
       } else {
         errno = st;
@@ -564,12 +1252,13 @@ gallus_rwlock_reader_timedlock(gallus_rwlock_t *rwlptr,
       struct timespec ts;
       gallus_chrono_t now;
 
-      WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+      WHAT_TIME_IS_IT_NOW_REALTIME_IN_NSEC(now);
       now += nsec;
       NSEC_TO_TS(now, ts);
 
       if ((st = pthread_rwlock_timedrdlock(&((*rwlptr)->m_rwl),
                                            &ts)) == 0) {
+        s_bound_lock_taken();
         ret = GALLUS_RESULT_OK;
       } else {
         errno = st;
@@ -595,7 +1284,10 @@ gallus_rwlock_writer_lock(gallus_rwlock_t *rwlptr) {
   if (rwlptr != NULL &&
       *rwlptr != NULL) {
     int st;
-    if ((st = pthread_rwlock_wrlock(&((*rwlptr)->m_rwl))) == 0) {
+    if ((*rwlptr)->m_type != GALLUS_RWLOCK_TYPE_DEFAULT) {
+      ret = s_lwrw_wrlock(*rwlptr, -1LL);
+    } else if ((st = pthread_rwlock_wrlock(&((*rwlptr)->m_rwl))) == 0) {
+      s_bound_lock_taken();
       ret = GALLUS_RESULT_OK;
     } else {
       errno = st;
@@ -616,7 +1308,10 @@ gallus_rwlock_writer_trylock(gallus_rwlock_t *rwlptr) {
   if (rwlptr != NULL &&
       *rwlptr != NULL) {
     int st;
-    if ((st = pthread_rwlock_trywrlock(&((*rwlptr)->m_rwl))) == 0) {
+    if ((*rwlptr)->m_type != GALLUS_RWLOCK_TYPE_DEFAULT) {
+      ret = s_lwrw_trywrlock(*rwlptr);
+    } else if ((st = pthread_rwlock_trywrlock(&((*rwlptr)->m_rwl))) == 0) {
+      s_bound_lock_taken();
       ret = GALLUS_RESULT_OK;
     } else {
       errno = st;
@@ -643,8 +1338,11 @@ gallus_rwlock_writer_timedlock(gallus_rwlock_t *rwlptr,
       *rwlptr != NULL) {
     int st;
 
-    if (nsec < 0) {
+    if ((*rwlptr)->m_type != GALLUS_RWLOCK_TYPE_DEFAULT) {
+      ret = s_lwrw_wrlock(*rwlptr, s_deadline(nsec));
+    } else if (nsec < 0) {
       if ((st = pthread_rwlock_wrlock(&((*rwlptr)->m_rwl))) == 0) {
+        s_bound_lock_taken();
         ret = GALLUS_RESULT_OK;
       } else {
         errno = st;
@@ -654,12 +1352,13 @@ gallus_rwlock_writer_timedlock(gallus_rwlock_t *rwlptr,
       struct timespec ts;
       gallus_chrono_t now;
 
-      WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+      WHAT_TIME_IS_IT_NOW_REALTIME_IN_NSEC(now);
       now += nsec;
       NSEC_TO_TS(now, ts);
 
       if ((st = pthread_rwlock_timedwrlock(&((*rwlptr)->m_rwl),
                                            &ts)) == 0) {
+        s_bound_lock_taken();
         ret = GALLUS_RESULT_OK;
       } else {
         errno = st;
@@ -689,7 +1388,11 @@ gallus_rwlock_unlock(gallus_rwlock_t *rwlptr) {
     /*
      * The caller must have this rwlock locked.
      */
-    if ((st = pthread_rwlock_unlock(&((*rwlptr)->m_rwl))) == 0) {
+    if ((*rwlptr)->m_type != GALLUS_RWLOCK_TYPE_DEFAULT) {
+      s_lwrw_unlock(*rwlptr);
+      ret = GALLUS_RESULT_OK;
+    } else if ((st = pthread_rwlock_unlock(&((*rwlptr)->m_rwl))) == 0) {
+      s_bound_lock_released();
       ret = GALLUS_RESULT_OK;
     } else {
       errno = st;
@@ -712,9 +1415,16 @@ gallus_rwlock_reader_enter_critical(gallus_rwlock_t *rwlptr,
       ostateptr != NULL) {
     int st;
 
-    if ((st = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,
-                                     ostateptr)) == 0) {
+    if ((*rwlptr)->m_type != GALLUS_RWLOCK_TYPE_DEFAULT) {
+      /*
+       * The cancel state is left as is.
+       */
+      *ostateptr = PTHREAD_CANCEL_DISABLE;
+      ret = s_lwrw_rdlock(*rwlptr, -1LL);
+    } else if ((st = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,
+                                            ostateptr)) == 0) {
       if ((st = pthread_rwlock_rdlock(&((*rwlptr)->m_rwl))) == 0) {
+        s_bound_lock_taken();
         ret = GALLUS_RESULT_OK;
       } else {
         errno = st;
@@ -741,9 +1451,16 @@ gallus_rwlock_writer_enter_critical(gallus_rwlock_t *rwlptr,
       ostateptr != NULL) {
     int st;
 
-    if ((st = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,
-                                     ostateptr)) == 0) {
+    if ((*rwlptr)->m_type != GALLUS_RWLOCK_TYPE_DEFAULT) {
+      /*
+       * The cancel state is left as is.
+       */
+      *ostateptr = PTHREAD_CANCEL_DISABLE;
+      ret = s_lwrw_wrlock(*rwlptr, -1LL);
+    } else if ((st = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,
+                                            ostateptr)) == 0) {
       if ((st = pthread_rwlock_wrlock(&((*rwlptr)->m_rwl))) == 0) {
+        s_bound_lock_taken();
         ret = GALLUS_RESULT_OK;
       } else {
         errno = st;
@@ -773,7 +1490,11 @@ gallus_rwlock_leave_critical(gallus_rwlock_t *rwlptr, int ostate) {
     /*
      * The caller must have this rwlock locked.
      */
-    if ((st = pthread_rwlock_unlock(&((*rwlptr)->m_rwl))) == 0) {
+    if ((*rwlptr)->m_type != GALLUS_RWLOCK_TYPE_DEFAULT) {
+      s_lwrw_unlock(*rwlptr);
+      ret = GALLUS_RESULT_OK;
+    } else if ((st = pthread_rwlock_unlock(&((*rwlptr)->m_rwl))) == 0) {
+      s_bound_lock_released();
       if ((st = pthread_setcancelstate(ostate, NULL)) == 0) {
         ret = GALLUS_RESULT_OK;
         if (ostate == PTHREAD_CANCEL_ENABLE) {
@@ -808,11 +1529,29 @@ gallus_cond_create(gallus_cond_t *cndptr) {
     cnd = (gallus_cond_t)malloc(sizeof(*cnd));
     if (cnd != NULL) {
       int st;
+      pthread_condattr_t attr;
+
+      /*
+       * Wait in the monotonic clock, not to be disturbed by the wall
+       * clock steps.
+       */
       errno = 0;
-      if ((st = pthread_cond_init(&(cnd->m_cond), NULL)) == 0) {
+      if ((st = pthread_condattr_init(&attr)) == 0) {
+        if ((st = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC)) == 0) {
+          st = pthread_cond_init(&(cnd->m_cond), &attr);
+        }
+        (void)pthread_condattr_destroy(&attr);
+      }
+      if (st == 0) {
         cnd->m_creator_pid = getpid();
-        *cndptr = cnd;
-        ret = GALLUS_RESULT_OK;
+        cnd->m_fseq = 0;
+        cnd->m_n_fwaiters = 0;
+        if ((ret = gallus_fiber_waitq_initialize(&(cnd->m_fwq))) ==
+            GALLUS_RESULT_OK) {
+          *cndptr = cnd;
+        } else {
+          (void)pthread_cond_destroy(&(cnd->m_cond));
+        }
       } else {
         errno = st;
         ret = GALLUS_RESULT_POSIX_API_ERROR;
@@ -838,12 +1577,36 @@ gallus_cond_destroy(gallus_cond_t *cndptr) {
     if ((*cndptr)->m_creator_pid == getpid()) {
       (void)pthread_cond_destroy(&((*cndptr)->m_cond));
     }
+    gallus_fiber_waitq_finalize(&((*cndptr)->m_fwq));
     free((void *)*cndptr);
     *cndptr = NULL;
   }
 }
 
 
+/*
+ * Wait with a FUTEX mutex, on the sequence the notifiers bump. The
+ * waiter is counted before releasing the mutex so a notification
+ * made under the mutex can't be missed.
+ */
+static inline gallus_result_t
+s_fcond_wait(gallus_cond_t cnd, gallus_mutex_t mtx, gallus_chrono_t nsec) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_chrono_t deadline = s_deadline(nsec);
+  uint32_t seq = __atomic_load_n(&(cnd->m_fseq), __ATOMIC_SEQ_CST);
+
+  (void)__atomic_add_fetch(&(cnd->m_n_fwaiters), 1, __ATOMIC_SEQ_CST);
+  s_fmtx_unlock(&(mtx->m_futex));
+
+  ret = s_futex_wait(&(cnd->m_fseq), seq, deadline);
+
+  (void)__atomic_sub_fetch(&(cnd->m_n_fwaiters), 1, __ATOMIC_SEQ_CST);
+  (void)s_fmtx_lock(&(mtx->m_futex), -1LL);
+
+  return ret;
+}
+
+
 gallus_result_t
 gallus_cond_wait(gallus_cond_t *cndptr,
                   gallus_mutex_t *mtxptr,
@@ -863,7 +1626,14 @@ gallus_cond_wait(gallus_cond_t *cndptr,
     int st;
 
     errno = 0;
-    if (nsec < 0) {
+    if (gallus_fiber_self() != NULL) {
+      /*
+       * Park the fiber, not the carrier thread.
+       */
+      ret = gallus_fiber_waitq_wait(&((*cndptr)->m_fwq), mtxptr, nsec);
+    } else if ((*mtxptr)->m_type == GALLUS_MUTEX_TYPE_FUTEX) {
+      ret = s_fcond_wait(*cndptr, *mtxptr, nsec);
+    } else if (nsec < 0) {
       if ((st = pthread_cond_wait(&((*cndptr)->m_cond),
                                   &((*mtxptr)->m_mtx))) == 0) {
         ret = GALLUS_RESULT_OK;
@@ -875,7 +1645,7 @@ gallus_cond_wait(gallus_cond_t *cndptr,
       struct timespec ts;
       gallus_chrono_t now;
 
-      WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+      WHAT_TIME_IS_IT_NOW_MONOTONIC_IN_NSEC(now);
       now += nsec;
       NSEC_TO_TS(now, ts);
     retry:
@@ -917,6 +1687,13 @@ gallus_cond_notify(gallus_cond_t *cndptr,
      */
     mbar();
 
+    gallus_fiber_waitq_notify(&((*cndptr)->m_fwq), for_all);
+
+    if (__atomic_load_n(&((*cndptr)->m_n_fwaiters), __ATOMIC_SEQ_CST) > 0) {
+      (void)__atomic_add_fetch(&((*cndptr)->m_fseq), 1, __ATOMIC_SEQ_CST);
+      s_futex_wake(&((*cndptr)->m_fseq), (for_all == true) ? INT_MAX : 1);
+    }
+
     errno = 0;
     if ((st = ((for_all == true) ? s_notify_all_proc : s_notify_single_proc)(
                 &((*cndptr)->m_cond))) == 0) {
@@ -686,6 +686,21 @@ s_default_mainloop(int argc, const char * const argv[],
 
 
 
+static void
+s_shutdown_requested(global_state_t s, shutdown_grace_level_t l,
+                     void *arg) {
+  (void)s;
+  (void)l;
+  (void)arg;
+
+  /*
+   * Called by the requester with the global state lock held. Just
+   * kick the idle proc, it accepts the request in the callout loop.
+   */
+  (void)gallus_callout_kick_idle_proc();
+}
+
+
 static gallus_result_t
 s_callout_idle_proc(void *arg) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
@@ -738,6 +753,17 @@ s_callout_mainloop(int argc, const char * const argv[],
     if (likely(ret == GALLUS_RESULT_OK)) {
       handler_inited = true;
       if (s_do_abort == false) {
+        /*
+         * Handle the shutdown request as soon as it's made, not at the
+         * next idle interval.
+         */
+        ret = global_state_subscribe(GLOBAL_STATE_REQUEST_SHUTDOWN,
+                                     s_shutdown_requested, NULL);
+        if (unlikely(ret != GALLUS_RESULT_OK)) {
+          gallus_perror(ret);
+          gallus_msg_warning("can't subscribe the shutdown request, "
+                             "poll it in every idle interval.\n");
+        }
         ret = s_prologue(argc, argv, pre_hook, post_hook, ipcfd);
         if (likely(ret == GALLUS_RESULT_OK &&
                    s_do_abort == false)) {
@@ -771,6 +797,7 @@ s_callout_mainloop(int argc, const char * const argv[],
       }
       
       if (handler_inited == true) {
+        (void)global_state_unsubscribe(s_shutdown_requested, NULL);
         gallus_callout_finalize_handler();
       }
     }
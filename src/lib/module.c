@@ -6,6 +6,8 @@
 
 #define MAX_MODULES		1024
 #define MAX_MODULE_NAME		64
+#define MAX_MODULE_DEPS		32
+#define MAX_MODULE_WORKERS	16
 
 
 
@@ -49,9 +51,51 @@ typedef struct {
   gallus_module_finalize_proc_t m_finalize_proc;
   gallus_module_usage_proc_t m_usage_proc;
   a_module_state_t m_status;
+
+  /*
+   * A module runs after all the modules in the lower levels, and
+   * concurrently with the ones in the same level.
+   */
+  size_t m_level;
+
+  gallus_chrono_t m_init_begin;
+  gallus_chrono_t m_init_end;
+  gallus_chrono_t m_start_begin;
+  gallus_chrono_t m_start_end;
 } a_module;
 
 
+typedef enum {
+  MODULE_PHASE_INITIALIZE = 0,
+  MODULE_PHASE_START,
+  MODULE_PHASE_SHUTDOWN,
+  MODULE_PHASE_STOP,
+  MODULE_PHASE_WAIT,
+  MODULE_PHASE_FINALIZE
+} s_module_phase_t;
+
+
+/*
+ * A phase run over the modules of a level, shared by the caller and
+ * the workers.
+ */
+typedef struct {
+  s_module_phase_t m_phase;
+  bool m_is_abortable;		/* stop at the first failure. */
+
+  int m_argc;
+  const char *const *m_argv;
+  shutdown_grace_level_t m_level;
+  gallus_chrono_t m_deadline;	/* < 0: forever. */
+
+  const size_t *m_idxs;
+  size_t m_n_idxs;
+  volatile size_t m_next;
+  volatile size_t m_n_running;	/* the threads in a proc. */
+  volatile gallus_result_t m_first_err;
+} s_module_job_t;
+
+
 
 
 
@@ -60,6 +104,9 @@ static pthread_t s_initializer_tid = GALLUS_INVALID_THREAD;
 
 static size_t s_n_modules = 0;
 static a_module s_modules[MAX_MODULES];
+static size_t s_n_levels = 0;
+static size_t s_level_idxs[MAX_MODULES];
+static gallus_chrono_t s_timeline_begin = 0;
 static volatile size_t s_n_finalized_modules = 0;
 static volatile size_t s_cur_module_idx = 0;
 
@@ -73,6 +120,9 @@ static gallus_cond_t s_cnd = NULL;
 
 static volatile int s_is_exit_handler_called = 0;
 
+static s_module_job_t *volatile s_cur_job = NULL;
+static __thread bool s_is_module_worker = false;
+
 
 /*
  * NOTE:
@@ -85,6 +135,8 @@ static void	s_ctors(void) __attr_constructor__(113);
 static void	s_dtors(void) __attr_destructor__(113);
 
 static void	s_atexit_handler(void);
+static gallus_result_t	s_run_phase(s_module_job_t *j, bool is_reverse);
+static void	s_init_job(s_module_job_t *j, s_module_phase_t phase);
 
 
 
@@ -96,6 +148,7 @@ s_once_proc(void) {
 
   s_gstate = MODULE_GLOBAL_STATE_UNKNOWN;
   s_n_modules = 0;
+  s_n_levels = 0;
   s_n_finalized_modules = 0;
   s_is_unloading = false;
   s_cur_module_idx = 0;
@@ -206,6 +259,64 @@ s_wakeup(void) {
 
 
 
+/*
+ * exit(3) called in a proc on a module worker. The caller of the
+ * phase holds the lock on behalf of the worker and never returns
+ * from waiting for it, so the lock is neither taken nor released
+ * here. Hand out no more modules of the level, let the procs in
+ * flight return and then do what the initializer would do.
+ */
+static void
+s_worker_exit(void) {
+  s_module_job_t *j = s_cur_job;
+  s_module_job_t fj;
+  gallus_chrono_t deadline;
+  gallus_chrono_t now;
+
+  if (j != NULL) {
+    (void)__sync_fetch_and_add(&(j->m_next), j->m_n_idxs);
+
+    WHAT_TIME_IS_IT_NOW_IN_NSEC(deadline);
+    deadline += 1000LL * 1000LL * 1000LL;
+    mbar();
+    while (j->m_n_running > 1) {
+      WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+      if (now >= deadline) {
+        gallus_msg_warning("Module finalization seems not completed.\n");
+        return;
+      }
+      (void)gallus_chrono_nanosleep(1000LL * 1000LL, NULL);
+      mbar();
+    }
+  }
+
+  switch (s_gstate) {
+
+    case MODULE_GLOBAL_STATE_INITIALIZING:
+    case MODULE_GLOBAL_STATE_STARTING: {
+      /*
+       * Same as the gallus_module_finalize_all(), run on this very
+       * thread.
+       */
+      s_gstate = MODULE_GLOBAL_STATE_FINALIZING;
+      s_init_job(&fj, MODULE_PHASE_FINALIZE);
+      (void)s_run_phase(&fj, true);
+      s_gstate = MODULE_GLOBAL_STATE_FINALIZED;
+      s_is_unloading = true;
+      mbar();
+      break;
+    }
+
+    default: {
+      /*
+       * Being torn down. There's nothing we can do at this moment.
+       */
+      break;
+    }
+  }
+}
+
+
 static void
 s_atexit_handler(void) {
   if (likely(__sync_fetch_and_add(&s_is_exit_handler_called, 1) == 0)) {
@@ -247,9 +358,10 @@ s_atexit_handler(void) {
 
     } else if (r == GALLUS_RESULT_BUSY) {
       /*
-       * The lock failure. Snoop s_gstate anyway. Note that it's safe
-       * since the modules are always accessesed only by a single
-       * thread and the thread is calling exit(3) at this moment.
+       * The lock failure. Snoop s_gstate anyway. Note that the
+       * modules are accessed only by the lock holder and, while a
+       * phase runs, by its module workers; it's safe if this thread
+       * is one of them since it is calling exit(3) at this moment.
        */
       if (s_gstate == MODULE_GLOBAL_STATE_UNKNOWN) {
         /*
@@ -312,6 +424,12 @@ s_atexit_handler(void) {
             }
           }
 
+        } else if (s_is_module_worker == true) {
+          /*
+           * A proc on a module worker called exit(3) while the phase
+           * caller holds the lock for it.
+           */
+          s_worker_exit();
         } else { /* (pthread_self() == s_initializer_tid) */
           /*
            * This menas that a thread other than module initialized is
@@ -348,8 +466,8 @@ s_find_module(const char *name, a_module **retmptr) {
         if (strcmp(mptr->m_name, name) == 0) {
           if (retmptr != NULL) {
             *retmptr = mptr;
-            return (gallus_result_t)i;
           }
+          return (gallus_result_t)i;
         }
       }
     }
@@ -369,9 +487,14 @@ s_register_module(const char *name,
                   gallus_module_shutdown_proc_t shutdown_proc,
                   gallus_module_stop_proc_t stop_proc,
                   gallus_module_finalize_proc_t finalize_proc,
-                  gallus_module_usage_proc_t usage_proc) {
+                  gallus_module_usage_proc_t usage_proc,
+                  bool has_deps,
+                  const char *const deps[]) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
   a_module *mptr = NULL;
+  a_module *dptr = NULL;
+  size_t level = 0;
+  size_t i;
 
   if (s_n_modules < MAX_MODULES &&
       (mptr = &(s_modules[s_n_modules])) != NULL) {
@@ -381,6 +504,27 @@ s_register_module(const char *name,
         shutdown_proc != NULL &&
         finalize_proc != NULL) {
       if (s_find_module(name, NULL) == GALLUS_RESULT_NOT_FOUND) {
+
+        if (has_deps == false) {
+          /*
+           * No declaration: after everything registered so far, as
+           * the modules always used to be.
+           */
+          level = s_n_levels;
+        } else if (deps != NULL) {
+          for (i = 0; deps[i] != NULL; i++) {
+            if (i >= MAX_MODULE_DEPS) {
+              return GALLUS_RESULT_TOO_MANY_OBJECTS;
+            }
+            if ((ret = s_find_module(deps[i], &dptr)) < 0) {
+              return ret;
+            }
+            if (dptr->m_level + 1 > level) {
+              level = dptr->m_level + 1;
+            }
+          }
+        }
+
         snprintf(mptr->m_name, sizeof(mptr->m_name), "%s", name);
         mptr->m_init_proc = init_proc;
         mptr->m_init_arg = extarg;
@@ -391,8 +535,12 @@ s_register_module(const char *name,
         mptr->m_finalize_proc = finalize_proc;
         mptr->m_usage_proc = usage_proc;
         mptr->m_status = MODULE_STATE_REGISTERED;
+        mptr->m_level = level;
 
         s_n_modules++;
+        if (level + 1 > s_n_levels) {
+          s_n_levels = level + 1;
+        }
 
         ret = GALLUS_RESULT_OK;
 
@@ -606,6 +754,256 @@ s_usage_module(a_module *mptr, FILE *fd) {
 }
 
 
+
+
+
+static inline gallus_result_t
+s_run_module(s_module_job_t *j, a_module *mptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  const char *what = NULL;
+
+  switch (j->m_phase) {
+
+    case MODULE_PHASE_INITIALIZE: {
+      WHAT_TIME_IS_IT_NOW_IN_NSEC(mptr->m_init_begin);
+      ret = s_initialize_module(mptr, j->m_argc, j->m_argv);
+      WHAT_TIME_IS_IT_NOW_IN_NSEC(mptr->m_init_end);
+      what = "initialize";
+      break;
+    }
+
+    case MODULE_PHASE_START: {
+      WHAT_TIME_IS_IT_NOW_IN_NSEC(mptr->m_start_begin);
+      ret = s_start_module(mptr);
+      WHAT_TIME_IS_IT_NOW_IN_NSEC(mptr->m_start_end);
+      what = "start";
+      break;
+    }
+
+    case MODULE_PHASE_SHUTDOWN: {
+      ret = s_shutdown_module(mptr, j->m_level);
+      what = "shutdown";
+      break;
+    }
+
+    case MODULE_PHASE_STOP: {
+      ret = s_stop_module(mptr);
+      what = "stop";
+      break;
+    }
+
+    case MODULE_PHASE_WAIT: {
+      gallus_chrono_t w = -1LL;
+      gallus_chrono_t now;
+
+      if (j->m_deadline >= 0LL) {
+        WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+        w = j->m_deadline - now;
+        if (w < 0LL) {
+          w = 0LL;
+        }
+      }
+      ret = s_wait_module(mptr, w);
+      what = "wait";
+      break;
+    }
+
+    case MODULE_PHASE_FINALIZE: {
+      s_finalize_module(mptr);
+      ret = GALLUS_RESULT_OK;
+      break;
+    }
+
+    default: {
+      ret = GALLUS_RESULT_INVALID_ARGS;
+      what = "run";
+      break;
+    }
+  }
+
+  if (ret != GALLUS_RESULT_OK) {
+    gallus_perror(ret);
+    gallus_msg_error("can't %s module \"%s\".\n", what, mptr->m_name);
+  }
+
+  return ret;
+}
+
+
+static void
+s_run_job(s_module_job_t *j) {
+  gallus_result_t r;
+  size_t i;
+
+  /*
+   * Counted as running before taking a module, so that one who
+   * retires the job sees all the procs it has to wait for.
+   */
+  for (;;) {
+    (void)__sync_add_and_fetch(&(j->m_n_running), 1);
+    if ((i = __sync_fetch_and_add(&(j->m_next), 1)) >= j->m_n_idxs ||
+        (j->m_is_abortable == true &&
+         j->m_first_err != GALLUS_RESULT_OK)) {
+      (void)__sync_sub_and_fetch(&(j->m_n_running), 1);
+      break;
+    }
+    r = s_run_module(j, &(s_modules[j->m_idxs[i]]));
+    (void)__sync_sub_and_fetch(&(j->m_n_running), 1);
+    if (r != GALLUS_RESULT_OK) {
+      (void)__sync_bool_compare_and_swap(&(j->m_first_err),
+                                         GALLUS_RESULT_OK, r);
+    }
+  }
+}
+
+
+static gallus_result_t
+s_job_worker_main(const gallus_thread_t *selfptr, void *arg) {
+  (void)selfptr;
+
+  s_is_module_worker = true;
+  s_run_job((s_module_job_t *)arg);
+
+  return GALLUS_RESULT_OK;
+}
+
+
+/*
+ * Run a phase level by level. The modules in a level are shared by
+ * the caller and up to MAX_MODULE_WORKERS threads started just for
+ * the level. The phases after the start go from the highest level
+ * down so that no module is torn down before the ones depending on
+ * it.
+ *
+ * The workers can't be executor mode pool threads since those don't
+ * run anything until the global state gets started. A module worker
+ * running a phase on its own (see s_worker_exit()) starts no more.
+ */
+static gallus_result_t
+s_run_phase(s_module_job_t *j, bool is_reverse) {
+  gallus_thread_t thds[MAX_MODULE_WORKERS];
+  size_t n_thds;
+  size_t l, lv, i, n, k;
+
+  j->m_first_err = GALLUS_RESULT_OK;
+  s_cur_job = j;
+
+  for (l = 0; l < s_n_levels; l++) {
+    lv = (is_reverse == false) ? l : s_n_levels - l - 1;
+
+    for (n = 0, i = 0; i < s_n_modules; i++) {
+      k = (is_reverse == false) ? i : s_n_modules - i - 1;
+      if (s_modules[k].m_level == lv) {
+        s_level_idxs[n++] = k;
+      }
+    }
+    if (n == 0) {
+      continue;
+    }
+
+    j->m_idxs = s_level_idxs;
+    j->m_n_idxs = n;
+    j->m_next = 0;
+
+    for (n_thds = 0;
+         s_is_module_worker == false &&
+             n_thds < n - 1 && n_thds < MAX_MODULE_WORKERS;
+         n_thds++) {
+      thds[n_thds] = NULL;
+      if (gallus_thread_create(&(thds[n_thds]), s_job_worker_main,
+                               NULL, NULL, "module worker",
+                               (void *)j) != GALLUS_RESULT_OK) {
+        break;
+      }
+      if (gallus_thread_start(&(thds[n_thds]), false) != GALLUS_RESULT_OK) {
+        gallus_thread_destroy(&(thds[n_thds]));
+        break;
+      }
+    }
+
+    /*
+     * The caller always takes part in, so a level is done even if no
+     * worker could be started.
+     */
+    s_run_job(j);
+
+    for (i = 0; i < n_thds; i++) {
+      (void)gallus_thread_wait(&(thds[i]), -1LL);
+      gallus_thread_destroy(&(thds[i]));
+    }
+
+    if (j->m_is_abortable == true && j->m_first_err != GALLUS_RESULT_OK) {
+      break;
+    }
+  }
+
+  s_cur_job = NULL;
+
+  return j->m_first_err;
+}
+
+
+static void
+s_init_job(s_module_job_t *j, s_module_phase_t phase) {
+  (void)memset((void *)j, 0, sizeof(*j));
+  j->m_phase = phase;
+  j->m_is_abortable = (phase == MODULE_PHASE_INITIALIZE ||
+                       phase == MODULE_PHASE_START) ? true : false;
+  j->m_deadline = -1LL;
+  j->m_first_err = GALLUS_RESULT_OK;
+}
+
+
+static void
+s_emit_timeline(FILE *fd) {
+  char buf[256];
+  a_module *mptr;
+  gallus_chrono_t end = s_timeline_begin;
+  size_t i;
+
+#define to_msec(ns)	((double)(ns) / 1000000.0)
+#define emit_line()                             \
+  if (fd != NULL) {                             \
+    (void)fputs(buf, fd);                       \
+  } else {                                      \
+    gallus_msg_info("%s", buf);                 \
+  }
+
+  for (i = 0; i < s_n_modules; i++) {
+    mptr = &(s_modules[i]);
+    if (mptr->m_init_end == 0) {
+      continue;
+    }
+    if (mptr->m_init_end > end) {
+      end = mptr->m_init_end;
+    }
+    if (mptr->m_start_end > end) {
+      end = mptr->m_start_end;
+    }
+    snprintf(buf, sizeof(buf),
+             "module \"%s\" (level %zu): initialize +%.3f ms (%.3f ms), "
+             "start +%.3f ms (%.3f ms)\n",
+             mptr->m_name, mptr->m_level,
+             to_msec(mptr->m_init_begin - s_timeline_begin),
+             to_msec(mptr->m_init_end - mptr->m_init_begin),
+             (mptr->m_start_end != 0) ?
+             to_msec(mptr->m_start_begin - s_timeline_begin) : 0.0,
+             (mptr->m_start_end != 0) ?
+             to_msec(mptr->m_start_end - mptr->m_start_begin) : 0.0);
+    emit_line();
+  }
+
+  snprintf(buf, sizeof(buf),
+           "%zu modules in %zu levels, up in %.3f ms.\n",
+           s_n_modules, s_n_levels, to_msec(end - s_timeline_begin));
+  emit_line();
+
+#undef emit_line
+#undef to_msec
+}
+
+
+
 
 
 
@@ -628,7 +1026,37 @@ gallus_module_register(const char *name,
                             shutdown_proc,
                             stop_proc,
                             finalize_proc,
-                            usage_proc);
+                            usage_proc,
+                            false, NULL);
+  }
+  s_unlock();
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_module_register_with_deps(const char *name,
+                                  gallus_module_initialize_proc_t init_proc,
+                                  void *extarg,
+                                  gallus_module_start_proc_t start_proc,
+                                  gallus_module_shutdown_proc_t shutdown_proc,
+                                  gallus_module_stop_proc_t stop_proc,
+                                  gallus_module_finalize_proc_t finalize_proc,
+                                  gallus_module_usage_proc_t usage_proc,
+                                  const char *const deps[]) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  s_lock();
+  {
+    ret = s_register_module(name,
+                            init_proc, extarg,
+                            start_proc,
+                            shutdown_proc,
+                            stop_proc,
+                            finalize_proc,
+                            usage_proc,
+                            true, deps);
   }
   s_unlock();
 
@@ -636,6 +1064,7 @@ gallus_module_register(const char *name,
 }
 
 
+
 
 
 
@@ -669,22 +1098,15 @@ gallus_module_initialize_all(int argc, const char *const argv[]) {
   {
 
     if (s_n_modules > 0) {
-      size_t i;
-      a_module *mptr;
+      s_module_job_t j;
 
       s_gstate = MODULE_GLOBAL_STATE_INITIALIZING;
+      WHAT_TIME_IS_IT_NOW_IN_NSEC(s_timeline_begin);
 
-      for (ret = GALLUS_RESULT_OK, i = 0;
-           ret == GALLUS_RESULT_OK && i < s_n_modules;
-           i++) {
-        mptr = &(s_modules[i]);
-        ret = s_initialize_module(mptr, argc, argv);
-        if (ret != GALLUS_RESULT_OK) {
-          gallus_perror(ret);
-          gallus_msg_error("can't initialize module \"%s\".\n",
-                            mptr->m_name);
-        }
-      }
+      s_init_job(&j, MODULE_PHASE_INITIALIZE);
+      j.m_argc = argc;
+      j.m_argv = argv;
+      ret = s_run_phase(&j, false);
     } else {
       ret = GALLUS_RESULT_OK;
     }
@@ -711,19 +1133,12 @@ gallus_module_start_all(void) {
     s_gstate = MODULE_GLOBAL_STATE_STARTING;
 
     if (s_n_modules > 0) {
-      size_t i;
-      a_module *mptr;
+      s_module_job_t j;
 
-      for (ret = GALLUS_RESULT_OK, i = 0;
-           ret == GALLUS_RESULT_OK && i < s_n_modules;
-           i++) {
-        mptr = &(s_modules[i]);
-        ret = s_start_module(mptr);
-        if (ret != GALLUS_RESULT_OK) {
-          gallus_perror(ret);
-          gallus_msg_error("can't start module \"%s\".\n",
-                            mptr->m_name);
-        }
+      s_init_job(&j, MODULE_PHASE_START);
+      ret = s_run_phase(&j, false);
+      if (ret == GALLUS_RESULT_OK) {
+        s_emit_timeline(NULL);
       }
     } else {
       ret = GALLUS_RESULT_OK;
@@ -752,32 +1167,15 @@ gallus_module_shutdown_all(shutdown_grace_level_t level) {
       s_gstate = MODULE_GLOBAL_STATE_SHUTTINGDOWN;
 
       if (s_n_modules > 0) {
-        gallus_result_t first_err = GALLUS_RESULT_OK;
-        size_t i;
-        a_module *mptr;
+        s_module_job_t j;
 
         /*
-         * Reverse order.
+         * Reverse order. Just carry on shutting down no matter what
+         * kind of errors occur.
          */
-        for (i = 0; i < s_n_modules; i++) {
-          mptr = &(s_modules[s_n_modules - i - 1]);
-          ret = s_shutdown_module(mptr, level);
-          if (ret != GALLUS_RESULT_OK) {
-            gallus_perror(ret);
-            gallus_msg_error("can't shutdown module \"%s\".\n",
-                              mptr->m_name);
-            if (first_err == GALLUS_RESULT_OK) {
-              first_err = ret;
-            }
-          }
-          /*
-           * Just carry on shutting down no matter what kind of errors
-           * occur.
-           */
-        }
-
-        ret = first_err;
-
+        s_init_job(&j, MODULE_PHASE_SHUTDOWN);
+        j.m_level = level;
+        ret = s_run_phase(&j, true);
       } else {
         ret = GALLUS_RESULT_OK;
       }
@@ -803,32 +1201,14 @@ gallus_module_stop_all(void) {
     s_gstate = MODULE_GLOBAL_STATE_STOPPING;
 
     if (s_n_modules > 0) {
-      gallus_result_t first_err = GALLUS_RESULT_OK;
-      size_t i;
-      a_module *mptr;
+      s_module_job_t j;
 
       /*
-       * Reverse order.
+       * Reverse order. Just carry on stopping no matter what kind of
+       * errors occur.
        */
-      for (i = 0; i < s_n_modules; i++) {
-        mptr = &(s_modules[s_n_modules - i - 1]);
-        ret = s_stop_module(mptr);
-        if (ret != GALLUS_RESULT_OK) {
-          gallus_perror(ret);
-          gallus_msg_error("can't stop module \"%s\".\n",
-                            mptr->m_name);
-          if (first_err == GALLUS_RESULT_OK) {
-            first_err = ret;
-          }
-        }
-        /*
-         * Just carry on stopping no matter what kind of errors
-         * occur.
-         */
-      }
-
-      ret = first_err;
-
+      s_init_job(&j, MODULE_PHASE_STOP);
+      ret = s_run_phase(&j, true);
     } else {
       ret = GALLUS_RESULT_OK;
     }
@@ -850,65 +1230,19 @@ gallus_module_wait_all(gallus_chrono_t nsec) {
     s_gstate = MODULE_GLOBAL_STATE_WAITING;
 
     if (s_n_modules > 0) {
-      gallus_result_t first_err = GALLUS_RESULT_OK;
-      size_t i;
-      a_module *mptr;
+      s_module_job_t j;
 
       /*
-       * Reverse order.
+       * Reverse order. Just carry on wait no matter what kind of
+       * errors occur. The modules waited concurrently share the
+       * deadline.
        */
-
-      if (nsec < 0LL) {
-
-        for (i = 0; i < s_n_modules; i++) {
-          mptr = &(s_modules[s_n_modules - i - 1]);
-          ret = s_wait_module(mptr, -1LL);
-          if (ret != GALLUS_RESULT_OK) {
-            gallus_perror(ret);
-            gallus_msg_error("can't wait module \"%s\".\n",
-                              mptr->m_name);
-            if (first_err == GALLUS_RESULT_OK) {
-              first_err = ret;
-            }
-          }
-          /*
-           * Just carry on wait no matter what kind of errors
-           * occur.
-           */
-        }
-
-      } else {
-
-        gallus_chrono_t w_begin;
-        gallus_chrono_t w_end;
-        gallus_chrono_t w = nsec;
-
-        for (i = 0; i < s_n_modules; i++) {
-          mptr = &(s_modules[s_n_modules - i - 1]);
-          WHAT_TIME_IS_IT_NOW_IN_NSEC(w_begin);
-          ret = s_wait_module(mptr, w);
-          WHAT_TIME_IS_IT_NOW_IN_NSEC(w_end);
-          if (ret != GALLUS_RESULT_OK) {
-            gallus_perror(ret);
-            gallus_msg_error("can't wait module \"%s\".\n",
-                              mptr->m_name);
-            if (first_err == GALLUS_RESULT_OK) {
-              first_err = ret;
-            }
-          }
-          /*
-           * Just carry on wait no matter what kind of errors
-           * occur.
-           */
-          w = nsec - (w_end - w_begin);
-          if (w < 0LL) {
-            w = 0LL;
-          }
-        }
+      s_init_job(&j, MODULE_PHASE_WAIT);
+      if (nsec >= 0LL) {
+        WHAT_TIME_IS_IT_NOW_IN_NSEC(j.m_deadline);
+        j.m_deadline += nsec;
       }
-
-      ret = first_err;
-
+      ret = s_run_phase(&j, true);
     } else {
       ret = GALLUS_RESULT_OK;
     }
@@ -932,16 +1266,13 @@ gallus_module_finalize_all(void) {
     s_gstate = MODULE_GLOBAL_STATE_FINALIZING;
 
     if (s_n_modules > 0) {
-      size_t i;
-      a_module *mptr;
+      s_module_job_t j;
 
       /*
        * Reverse order.
        */
-      for (i = 0; i < s_n_modules; i++) {
-        mptr = &(s_modules[s_n_modules - i - 1]);
-        s_finalize_module(mptr);
-      }
+      s_init_job(&j, MODULE_PHASE_FINALIZE);
+      (void)s_run_phase(&j, true);
     }
 
     s_gstate = MODULE_GLOBAL_STATE_FINALIZED;
@@ -952,6 +1283,21 @@ gallus_module_finalize_all(void) {
 }
 
 
+void
+gallus_module_dump_timeline(FILE *fd) {
+  if (fd != NULL) {
+
+    s_lock();
+    {
+      s_emit_timeline(fd);
+    }
+    s_unlock();
+
+  }
+}
+
+
+
 
 
 
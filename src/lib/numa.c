@@ -461,6 +461,16 @@ gallus_free_on_cpu(void *p) {
 }
 
 
+int
+gallus_numa_node_of_cpu(int cpu) {
+  if (likely(cpu >= 0 && (int64_t)cpu < s_n_cpus && s_numa_nodes != NULL)) {
+    return (int)s_numa_nodes[cpu];
+  } else {
+    return (cpu >= 0) ? 0 : -1;
+  }
+}
+
+
 
 
 
@@ -513,6 +523,12 @@ gallus_free_on_cpu(void *p) {
 }
 
 
+int
+gallus_numa_node_of_cpu(int cpu) {
+  return (cpu >= 0) ? 0 : -1;
+}
+
+
 
 
 
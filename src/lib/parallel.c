@@ -0,0 +1,430 @@
+#include "gallus_apis.h"
+#include "gallus_poolable_internal.h"
+#include "gallus_thread_internal.h"
+#include "gallus_pool_internal.h"
+#include "gallus_pooled_thread_internal.h"
+#include "gallus_task_internal.h"
+
+
+
+
+
+#define PARALLEL_CHUNKS_PER_LANE	8	/* for the default grain */
+#define PARALLEL_OWN_SHARE		4	/* owner takes 1/4 of its rest */
+
+
+/*
+ * A lane is a contiguous part of the range. Its owner takes chunks
+ * from the head, thieves take the latter half from the tail.
+ */
+typedef struct parallel_lane_record {
+  gallus_spinlock_t m_lck;
+  size_t m_begin;
+  size_t m_end;
+  volatile int m_node;		/* the owner's NUMA node, -1: no owner yet */
+} __attribute__((aligned(64))) parallel_lane_record;
+
+
+typedef struct parallel_job_record {
+  size_t m_n_refs;		/* atomic */
+
+  gallus_mutex_t m_lck;
+  gallus_cond_t m_cnd;
+  size_t m_n_active;
+  bool m_is_closed;
+
+  size_t m_grain;
+  size_t m_n_lanes;
+  size_t m_next_lane;		/* atomic */
+  parallel_lane_record *m_lanes;
+
+  gallus_parallel_for_proc_t m_for_proc;
+  gallus_parallel_reduce_proc_t m_reduce_proc;
+  gallus_parallel_combine_proc_t m_combine;
+  void *m_arg;
+  void *m_result;
+  void *m_identity;
+  size_t m_acc_size;
+
+  volatile bool m_is_failed;
+  gallus_result_t m_error;
+} parallel_job_record;
+typedef parallel_job_record *parallel_job_t;
+
+
+typedef struct parallel_task_record {
+  gallus_task_record m_task;	/* must be on the head. */
+
+  parallel_job_t m_job;
+} parallel_task_record;
+typedef parallel_task_record *parallel_task_t;
+
+
+
+
+
+static void
+s_job_unref(parallel_job_t j) {
+  size_t i;
+
+  if (__atomic_sub_fetch(&j->m_n_refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    if (j->m_lanes != NULL) {
+      for (i = 0; i < j->m_n_lanes; i++) {
+        gallus_spinlock_finalize(&j->m_lanes[i].m_lck);
+      }
+      free(j->m_lanes);
+    }
+    free(j->m_identity);
+    if (j->m_cnd != NULL) {
+      gallus_cond_destroy(&j->m_cnd);
+    }
+    if (j->m_lck != NULL) {
+      gallus_mutex_destroy(&j->m_lck);
+    }
+    free(j);
+  }
+}
+
+
+static inline bool
+s_lane_take(parallel_lane_record *l, size_t grain, size_t *bptr,
+            size_t *eptr) {
+  bool ret = false;
+  size_t n;
+
+  (void)gallus_spinlock_lock(&l->m_lck);
+  {
+    if (l->m_begin < l->m_end) {
+      n = (l->m_end - l->m_begin) / PARALLEL_OWN_SHARE;
+      if (n < grain) {
+        n = grain;
+      }
+      if (n > l->m_end - l->m_begin) {
+        n = l->m_end - l->m_begin;
+      }
+      *bptr = l->m_begin;
+      *eptr = l->m_begin + n;
+      l->m_begin += n;
+      ret = true;
+    }
+  }
+  (void)gallus_spinlock_unlock(&l->m_lck);
+
+  return ret;
+}
+
+
+static inline bool
+s_lane_steal(parallel_lane_record *l, size_t grain, size_t *bptr,
+             size_t *eptr) {
+  bool ret = false;
+  size_t n;
+
+  if (l->m_begin >= l->m_end) {
+    return false;
+  }
+
+  (void)gallus_spinlock_lock(&l->m_lck);
+  {
+    if (l->m_begin < l->m_end) {
+      n = l->m_end - l->m_begin;
+      if (n > grain) {
+        n -= n / 2;
+      }
+      *bptr = l->m_end - n;
+      *eptr = l->m_end;
+      l->m_end -= n;
+      ret = true;
+    }
+  }
+  (void)gallus_spinlock_unlock(&l->m_lck);
+
+  return ret;
+}
+
+
+static inline bool
+s_steal(parallel_job_t j, size_t own, int node, size_t *bptr, size_t *eptr) {
+  size_t i, idx;
+  int pass;
+
+  /*
+   * The lanes of the same NUMA node first, then any.
+   */
+  for (pass = 0; pass < 2; pass++) {
+    for (i = 1; i < j->m_n_lanes; i++) {
+      idx = (own + i) % j->m_n_lanes;
+      if (pass == 0 && j->m_lanes[idx].m_node != node) {
+        continue;
+      }
+      if (s_lane_steal(&j->m_lanes[idx], j->m_grain, bptr, eptr) == true) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+
+static inline void
+s_fail(parallel_job_t j, gallus_result_t r) {
+  (void)gallus_mutex_lock(&j->m_lck);
+  {
+    if (j->m_is_failed == false) {
+      j->m_error = r;
+      j->m_is_failed = true;
+    }
+  }
+  (void)gallus_mutex_unlock(&j->m_lck);
+}
+
+
+static void
+s_participate(parallel_job_t j, size_t lane) {
+  gallus_result_t r = GALLUS_RESULT_OK;
+  size_t b = 0, e = 0;
+  void *acc = NULL;
+  int node = gallus_numa_node_of_cpu(sched_getcpu());
+
+  /*
+   * Touched first by this thread, so it's local anyway.
+   */
+  if (j->m_acc_size > 0) {
+    acc = malloc(j->m_acc_size);
+    if (unlikely(acc == NULL)) {
+      s_fail(j, GALLUS_RESULT_NO_MEMORY);
+      return;
+    }
+    (void)memcpy(acc, j->m_identity, j->m_acc_size);
+  }
+
+  j->m_lanes[lane].m_node = node;
+
+  while (j->m_is_failed == false) {
+    if (s_lane_take(&j->m_lanes[lane], j->m_grain, &b, &e) == false &&
+        s_steal(j, lane, node, &b, &e) == false) {
+      break;
+    }
+    if (j->m_reduce_proc != NULL) {
+      r = j->m_reduce_proc(b, e, acc, j->m_arg);
+    } else {
+      r = j->m_for_proc(b, e, j->m_arg);
+    }
+    if (unlikely(r < 0)) {
+      s_fail(j, r);
+      break;
+    }
+  }
+
+  if (acc != NULL) {
+    (void)gallus_mutex_lock(&j->m_lck);
+    {
+      j->m_combine(j->m_result, acc, j->m_arg);
+    }
+    (void)gallus_mutex_unlock(&j->m_lck);
+    free(acc);
+  }
+}
+
+
+static gallus_result_t
+s_helper_main(gallus_task_t *tptr) {
+  parallel_task_t pt = NULL;
+  parallel_job_t j = NULL;
+  bool is_closed = false;
+  size_t lane;
+
+  if (unlikely(tptr == NULL || (pt = (parallel_task_t)*tptr) == NULL ||
+               (j = pt->m_job) == NULL)) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  /*
+   * Too late if the caller is already done with the whole range.
+   */
+  (void)gallus_mutex_lock(&j->m_lck);
+  {
+    if ((is_closed = j->m_is_closed) == false) {
+      j->m_n_active++;
+    }
+  }
+  (void)gallus_mutex_unlock(&j->m_lck);
+
+  if (is_closed == false) {
+    lane = __atomic_fetch_add(&j->m_next_lane, 1, __ATOMIC_RELAXED);
+    s_participate(j, lane);
+
+    (void)gallus_mutex_lock(&j->m_lck);
+    {
+      if (--j->m_n_active == 0) {
+        (void)gallus_cond_notify(&j->m_cnd, true);
+      }
+    }
+    (void)gallus_mutex_unlock(&j->m_lck);
+  }
+
+  s_job_unref(j);
+
+  return GALLUS_RESULT_OK;
+}
+
+
+static gallus_result_t
+s_run(gallus_thread_pool_t *pptr, size_t begin, size_t end, size_t grain,
+      gallus_parallel_for_proc_t for_proc,
+      gallus_parallel_reduce_proc_t reduce_proc,
+      gallus_parallel_combine_proc_t combine,
+      void *result, size_t acc_size, void *arg) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  parallel_job_t j = NULL;
+  gallus_task_t t = NULL;
+  size_t n = end - begin;
+  size_t n_lanes = 1;
+  size_t i, per;
+
+  if (pptr != NULL && *pptr != NULL && (*pptr)->m_exec != NULL) {
+    n_lanes = (*pptr)->m_exec->m_n_workers + 1;
+  }
+  if (grain == 0) {
+    grain = n / (n_lanes * PARALLEL_CHUNKS_PER_LANE);
+    if (grain == 0) {
+      grain = 1;
+    }
+  }
+  if (n_lanes > (n + grain - 1) / grain) {
+    n_lanes = (n + grain - 1) / grain;
+  }
+
+  /*
+   * Not worth a job.
+   */
+  if (n_lanes <= 1) {
+    if (reduce_proc != NULL) {
+      ret = reduce_proc(begin, end, result, arg);
+    } else {
+      ret = for_proc(begin, end, arg);
+    }
+    return (ret < 0) ? ret : GALLUS_RESULT_OK;
+  }
+
+  j = (parallel_job_t)calloc(1, sizeof(*j));
+  if (unlikely(j == NULL)) {
+    return GALLUS_RESULT_NO_MEMORY;
+  }
+  j->m_n_refs = 1;
+  if (unlikely((ret = gallus_mutex_create(&j->m_lck)) != GALLUS_RESULT_OK ||
+               (ret = gallus_cond_create(&j->m_cnd)) != GALLUS_RESULT_OK)) {
+    goto done;
+  }
+  if (unlikely(posix_memalign((void **)&j->m_lanes, 64,
+                              sizeof(parallel_lane_record) * n_lanes) != 0)) {
+    j->m_lanes = NULL;
+    ret = GALLUS_RESULT_NO_MEMORY;
+    goto done;
+  }
+  (void)memset(j->m_lanes, 0, sizeof(parallel_lane_record) * n_lanes);
+  j->m_n_lanes = n_lanes;
+  per = n / n_lanes;
+  for (i = 0; i < n_lanes; i++) {
+    (void)gallus_spinlock_initialize(&j->m_lanes[i].m_lck);
+    j->m_lanes[i].m_begin = begin + per * i;
+    j->m_lanes[i].m_end = (i == n_lanes - 1) ? end : begin + per * (i + 1);
+    j->m_lanes[i].m_node = -1;
+  }
+  j->m_grain = grain;
+  j->m_next_lane = 1;		/* the caller owns the lane 0. */
+  j->m_for_proc = for_proc;
+  j->m_reduce_proc = reduce_proc;
+  j->m_combine = combine;
+  j->m_arg = arg;
+  j->m_result = result;
+  j->m_acc_size = acc_size;
+  if (acc_size > 0) {
+    /*
+     * The result gets combined into while the others still start.
+     */
+    if (unlikely((j->m_identity = malloc(acc_size)) == NULL)) {
+      ret = GALLUS_RESULT_NO_MEMORY;
+      goto done;
+    }
+    (void)memcpy(j->m_identity, result, acc_size);
+  }
+  j->m_is_failed = false;
+  j->m_error = GALLUS_RESULT_OK;
+
+  /*
+   * Helpers may start late or never if the pool is busy; the lanes
+   * nobody owns are stolen by the others.
+   */
+  for (i = 1; i < n_lanes; i++) {
+    t = NULL;
+    if (unlikely(gallus_task_create(&t, sizeof(parallel_task_record),
+                                    NULL, s_helper_main, NULL, NULL) !=
+                 GALLUS_RESULT_OK)) {
+      break;
+    }
+    ((parallel_task_t)t)->m_job = j;
+    (void)__atomic_add_fetch(&j->m_n_refs, 1, __ATOMIC_RELAXED);
+    if (unlikely(gallus_task_submit(&t, pptr,
+                                    GALLUS_TASK_DELETE_CONTEXT_AFTER_EXEC) !=
+                 GALLUS_RESULT_OK)) {
+      gallus_task_destroy(&t);
+      (void)__atomic_sub_fetch(&j->m_n_refs, 1, __ATOMIC_RELAXED);
+      break;
+    }
+  }
+
+  s_participate(j, 0);
+
+  (void)gallus_mutex_lock(&j->m_lck);
+  {
+    j->m_is_closed = true;
+    while (j->m_n_active > 0) {
+      (void)gallus_cond_wait(&j->m_cnd, &j->m_lck, -1LL);
+    }
+    ret = (j->m_is_failed == true) ? j->m_error : GALLUS_RESULT_OK;
+  }
+  (void)gallus_mutex_unlock(&j->m_lck);
+
+done:
+  s_job_unref(j);
+
+  return ret;
+}
+
+
+
+
+
+gallus_result_t
+gallus_parallel_for(gallus_thread_pool_t *pptr, size_t begin, size_t end,
+                    size_t grain,
+                    gallus_parallel_for_proc_t proc, void *arg) {
+  if (likely(proc != NULL && begin <= end)) {
+    if (begin == end) {
+      return GALLUS_RESULT_OK;
+    }
+    return s_run(pptr, begin, end, grain, proc, NULL, NULL, NULL, 0, arg);
+  } else {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+}
+
+
+gallus_result_t
+gallus_parallel_reduce(gallus_thread_pool_t *pptr, size_t begin, size_t end,
+                       size_t grain, void *result, size_t acc_size,
+                       gallus_parallel_reduce_proc_t proc,
+                       gallus_parallel_combine_proc_t combine, void *arg) {
+  if (likely(proc != NULL && combine != NULL && result != NULL &&
+             acc_size > 0 && begin <= end)) {
+    if (begin == end) {
+      return GALLUS_RESULT_OK;
+    }
+    return s_run(pptr, begin, end, grain, NULL, proc, combine, result,
+                 acc_size, arg);
+  } else {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+}
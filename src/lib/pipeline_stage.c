@@ -294,7 +294,7 @@ static inline void
 s_resume_stage(gallus_pipeline_stage_t ps) {
   s_pause_lock_stage(ps);
   {
-    ps->m_pause_requested = false;
+    gallus_atomic_store(&(ps->m_pause_requested), false, RELEASE);
     s_resume_notify_stage(ps);
   }
   s_pause_unlock_stage(ps);
@@ -329,8 +329,8 @@ s_cancel_stage(gallus_pipeline_stage_t ps, size_t n) {
      * don't have any cancelation points at the first place,)
      * mimic immediate shutdown.
      */
-    ps->m_sg_lvl = SHUTDOWN_RIGHT_NOW;
-    ps->m_do_loop = false;
+    gallus_atomic_store(&(ps->m_sg_lvl), SHUTDOWN_RIGHT_NOW, RELAXED);
+    gallus_atomic_store(&(ps->m_do_loop), false, RELEASE);
 
     ret = first_err;
   } else {
@@ -736,7 +736,7 @@ gallus_pipeline_stage_start(const gallus_pipeline_stage_t *sptr) {
           ps->m_n_canceled_workers = 0LL;
           ps->m_n_shutdown_workers = 0LL;
 
-          ps->m_do_loop = true;
+          gallus_atomic_store(&(ps->m_do_loop), true, RELEASE);
 
           for (i = 0, ret = GALLUS_RESULT_OK;
                i < ps->m_n_workers && ret == GALLUS_RESULT_OK;
@@ -824,7 +824,7 @@ gallus_pipeline_stage_shutdown(const gallus_pipeline_stage_t *sptr,
             ps->m_status = STAGE_STATE_STARTED;
           }
 
-          ps->m_sg_lvl = lvl;
+          gallus_atomic_store(&(ps->m_sg_lvl), lvl, RELAXED);
           if (lvl == SHUTDOWN_RIGHT_NOW) {
             /*
              * No matter what the main worker loop stops for all the
@@ -909,7 +909,7 @@ gallus_pipeline_stage_wait(const gallus_pipeline_stage_t *sptr,
                                  ps->m_n_workers, n_shutdown, n_canceled);
             }
 
-            ps->m_do_loop = false;
+            gallus_atomic_store(&(ps->m_do_loop), false, RELEASE);
           }
 
         } else {
@@ -956,9 +956,178 @@ gallus_pipeline_stage_set_worker_cpu_affinity(
 
   return ret;
 }
+
+
+/*
+ * Pick the next free cpu from the *posptr in the topology order. A hot
+ * worker takes a whole core, so the SMT siblings of it are left idle.
+ */
+static inline int
+s_pick_cpu(const int *cpus, bool *used, size_t n, size_t *posptr,
+           bool is_hot) {
+  size_t i, j, k;
+  gallus_cpu_info_t ci, cj;
+
+  for (k = 0; k < n; k++) {
+    i = (*posptr + k) % n;
+    if (used[i] == true ||
+        gallus_topology_get_cpu_info(cpus[i], &ci) != GALLUS_RESULT_OK) {
+      continue;
+    }
+    if (is_hot == true) {
+      bool is_free = true;
+      for (j = 0; j < n && is_free == true; j++) {
+        if (used[j] == true &&
+            gallus_topology_get_cpu_info(cpus[j], &cj) == GALLUS_RESULT_OK &&
+            cj.m_core == ci.m_core) {
+          is_free = false;
+        }
+      }
+      if (is_free == false) {
+        continue;
+      }
+      for (j = 0; j < n; j++) {
+        if (gallus_topology_get_cpu_info(cpus[j], &cj) == GALLUS_RESULT_OK &&
+            cj.m_core == ci.m_core) {
+          used[j] = true;
+        }
+      }
+    }
+    used[i] = true;
+    *posptr = (i + 1) % n;
+    return cpus[i];
+  }
+
+  return -1;
+}
+
+
+gallus_result_t
+gallus_pipeline_stage_place_workers(const gallus_pipeline_stage_t *stages,
+                                    const bool *is_hot,
+                                    size_t n_stages) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  size_t n_cpus = gallus_topology_get_cpu_num();
+  int *cpus = NULL;
+  bool *used = NULL;
+  size_t n = 0;
+  size_t pos = 0;
+  size_t i, j;
+  gallus_pipeline_stage_t ps;
+
+  if (stages == NULL || n_stages == 0) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  for (i = 0; i < n_stages; i++) {
+    if ((ps = stages[i]) == NULL) {
+      return GALLUS_RESULT_INVALID_ARGS;
+    }
+    if (s_is_stage(ps) == false) {
+      return GALLUS_RESULT_INVALID_OBJECT;
+    }
+  }
+
+  cpus = (int *)malloc(sizeof(int) * n_cpus);
+  used = (bool *)calloc(n_cpus, sizeof(bool));
+  if (cpus == NULL || used == NULL) {
+    ret = GALLUS_RESULT_NO_MEMORY;
+    goto done;
+  }
+  if ((ret = gallus_topology_get_usable_cpus(cpus, n_cpus)) <= 0) {
+    if (ret == 0) {
+      ret = GALLUS_RESULT_NOT_FOUND;
+    }
+    goto done;
+  }
+  n = (size_t)ret;
+  ret = GALLUS_RESULT_OK;
+
+  /*
+   * The stages are placed in the given order so that the workers of
+   * the adjacent stages land on the CPUs sharing the caches.
+   */
+  for (i = 0; i < n_stages && ret == GALLUS_RESULT_OK; i++) {
+    bool hot = (is_hot != NULL) ? is_hot[i] : false;
+    ps = stages[i];
+
+    s_lock_stage(ps);
+    {
+      if (ps->m_status == STAGE_STATE_INITIALIZED ||
+          ps->m_status == STAGE_STATE_SETUP) {
+        for (j = 0; j < ps->m_n_workers && ret == GALLUS_RESULT_OK; j++) {
+          int cpu = s_pick_cpu(cpus, used, n, &pos, hot);
+          if (cpu < 0) {
+            /*
+             * Ran out of the CPUs, wrap around.
+             */
+            (void)memset((void *)used, 0, sizeof(bool) * n);
+            if ((cpu = s_pick_cpu(cpus, used, n, &pos, hot)) < 0) {
+              cpu = s_pick_cpu(cpus, used, n, &pos, false);
+            }
+          }
+          ret = s_worker_place(&(ps->m_workers[j]), cpu);
+        }
+      } else {
+        ret = GALLUS_RESULT_INVALID_STATE_TRANSITION;
+      }
+    }
+    s_unlock_stage(ps);
+  }
+
+done:
+  free((void *)cpus);
+  free((void *)used);
+
+  return ret;
+}
 #endif /* GALLUS_OS_LINUX */
 
 
+gallus_result_t
+gallus_pipeline_stage_get_worker_cpu(const gallus_pipeline_stage_t *sptr,
+                                     size_t idx) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_pipeline_stage_t ps = NULL;
+
+  if (sptr != NULL && (ps = *sptr) != NULL &&
+      idx < ps->m_n_workers) {
+    int cpu = ps->m_workers[idx]->m_cpu;
+    ret = (cpu >= 0) ? (gallus_result_t)cpu : GALLUS_RESULT_NOT_FOUND;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+void
+gallus_pipeline_stage_dump_placement(const gallus_pipeline_stage_t *sptr,
+                                     FILE *fd) {
+  gallus_pipeline_stage_t ps = NULL;
+  gallus_cpu_info_t ci;
+  size_t i;
+
+  if (sptr != NULL && (ps = *sptr) != NULL && fd != NULL) {
+    fprintf(fd, "stage '%s': " PFSZ(u) " workers\n",
+            ps->m_name, ps->m_n_workers);
+    for (i = 0; i < ps->m_n_workers; i++) {
+      int cpu = ps->m_workers[i]->m_cpu;
+      if (cpu >= 0 &&
+          gallus_topology_get_cpu_info(cpu, &ci) == GALLUS_RESULT_OK) {
+        fprintf(fd, "  worker " PFSZ(u) ": cpu %d, core %d (smt "
+                PFSZ(u) "), l2 %d, l3 %d, package %d, node %d\n",
+                i, ci.m_cpu, ci.m_core, ci.m_n_smt, ci.m_l2, ci.m_l3,
+                ci.m_package, ci.m_node);
+      } else {
+        fprintf(fd, "  worker " PFSZ(u) ": not placed\n", i);
+      }
+    }
+  }
+}
+
+
 
 
 
@@ -995,16 +1164,11 @@ gallus_pipeline_stage_pause(const gallus_pipeline_stage_t *sptr,
           s_pause_lock_stage(ps);
           {
             /*
-             * Firstly, set the pause flag. Note that there is a
-             * slight possibility that setting the flag won't work
-             * because of the compiler optimization problem. In order
-             * to make the flag works fine, maybe we need a
-             * compiler/runtime-supported atomic memory read/write
-             * mechanism. For now, we just believe the compiler is
-             * fine with a volatile declaration for the flag.
+             * Firstly, set the pause flag. The workers poll it
+             * without the lock.
              */
 
-            ps->m_pause_requested = true;
+            gallus_atomic_store(&(ps->m_pause_requested), true, RELEASE);
 
             /*
              * Wake sleeping workers up if needed.
@@ -1042,7 +1206,7 @@ gallus_pipeline_stage_pause(const gallus_pipeline_stage_t *sptr,
 
           if (ret != GALLUS_RESULT_OK &&
               ret != GALLUS_RESULT_TIMEDOUT) {
-            ps->m_pause_requested = false;
+            gallus_atomic_store(&(ps->m_pause_requested), false, RELEASE);
           }
 
         } else {
@@ -1124,20 +1288,15 @@ gallus_pipeline_stage_schedule_maintenance(
           s_pause_lock_stage(ps);
           {
             /*
-             * Firstly, set the func, the arg and the pause flag. Note
-             * that there is a slight possibility that setting the
-             * flag won't work because of the compiler optimization
-             * problem. In order to make the flag works fine, maybe we
-             * need a compiler/runtime-supported atomic memory
-             * read/write mechanism. For now, we just believe the
-             * compiler is fine with a volatile declaration for the
-             * flag.
+             * Firstly, set the func, the arg and the pause flag. The
+             * release store of the flag publishes the func and the
+             * arg to the workers polling the flag without the lock.
              */
 
             ps->m_status = STAGE_STATE_MAINTENANCE_REQUESTED;
             ps->m_maint_proc = func;
             ps->m_maint_arg = arg;
-            ps->m_pause_requested = true;
+            gallus_atomic_store(&(ps->m_pause_requested), true, RELEASE);
 
             /*
              * Wake sleeping workers up if needed.
@@ -1180,7 +1339,7 @@ gallus_pipeline_stage_schedule_maintenance(
           s_pause_unlock_stage(ps);
 
           if (ret != GALLUS_RESULT_OK) {
-            ps->m_pause_requested = false;
+            gallus_atomic_store(&(ps->m_pause_requested), false, RELEASE);
             ps->m_maint_proc = NULL;
             ps->m_maint_arg = NULL;
           }
@@ -25,6 +25,8 @@ typedef struct gallus_pipeline_worker_record {
                                  * m_stg->m_batch_buffer_size (in
                                  * bytes.) */
   gallus_pipeline_stage_event_buffer_freeup_proc_t m_freeup_proc;
+
+  int m_cpu;			/* A CPU placed on, -1 if not placed. */
 } gallus_pipeline_worker_record;
 
 
@@ -35,6 +37,9 @@ static inline void	s_worker_pause(gallus_pipeline_worker_t w,
                                    gallus_pipeline_stage_t ps);
 static inline void	s_worker_maintenance(gallus_pipeline_worker_t w,
     gallus_pipeline_stage_t ps);
+static inline void	*s_worker_set_buffer(gallus_pipeline_worker_t *wptr,
+    void *buf,
+    gallus_pipeline_stage_event_buffer_freeup_proc_t freeup_proc);
 
 
 
@@ -49,10 +54,15 @@ static inline void	s_worker_maintenance(gallus_pipeline_worker_t w,
       size_t max_n_evs = (*sptr)->m_max_batch;                          \
       size_t idx = w->m_idx;                                            \
       gallus_result_t st = 0;                                          \
-      while ((*sptr)->m_do_loop == true &&                              \
+      shutdown_grace_level_t lvl;                                       \
+      while (gallus_atomic_load(&((*sptr)->m_do_loop), ACQUIRE) ==     \
+             true &&                                                    \
              ((st > 0) ||                                               \
-              (st == 0 && (*sptr)->m_sg_lvl == SHUTDOWN_UNKNOWN))) {    \
-        if ((*sptr)->m_pause_requested == false) {                      \
+              (st == 0 &&                                               \
+               gallus_atomic_load(&((*sptr)->m_sg_lvl), RELAXED) ==     \
+               SHUTDOWN_UNKNOWN))) {                                    \
+        if (gallus_atomic_load(&((*sptr)->m_pause_requested),          \
+                               ACQUIRE) == false) {                     \
           { OPS }                                                       \
         } else {                                                        \
           ((*sptr)->m_maint_proc != NULL) ?                             \
@@ -60,8 +70,8 @@ static inline void	s_worker_maintenance(gallus_pipeline_worker_t w,
           s_worker_pause(w, *sptr);                                 \
         }                                                               \
       }                                                                 \
-      if (((*sptr)->m_sg_lvl == SHUTDOWN_RIGHT_NOW ||                   \
-           (*sptr)->m_sg_lvl == SHUTDOWN_GRACEFULLY) &&                 \
+      lvl = gallus_atomic_load(&((*sptr)->m_sg_lvl), RELAXED);          \
+      if ((lvl == SHUTDOWN_RIGHT_NOW || lvl == SHUTDOWN_GRACEFULLY) &&  \
           st > 0) {                                                     \
         st = GALLUS_RESULT_OK;                                         \
       }                                                                 \
@@ -354,6 +364,7 @@ s_worker_create(gallus_pipeline_worker_t *wptr,
         w->m_is_started = false;
         w->m_buf = evbuf;
         w->m_freeup_proc = free;
+        w->m_cpu = -1;
         (void)memset((void *)(w->m_buf), 0, (*sptr)->m_batch_buffer_size);
         /*
          * Make the object destroyable via gallus_thread_destroy() so
@@ -411,7 +422,41 @@ s_worker_destroy(gallus_pipeline_worker_t *wptr) {
 #ifdef GALLUS_OS_LINUX
 static inline gallus_result_t
 s_worker_set_cpu_affinity(gallus_pipeline_worker_t *wptr, int cpu) {
-  return gallus_thread_set_cpu_affinity((gallus_thread_t *)wptr, cpu);
+  gallus_result_t ret =
+    gallus_thread_set_cpu_affinity((gallus_thread_t *)wptr, cpu);
+
+  if (ret == GALLUS_RESULT_OK) {
+    (*wptr)->m_cpu = (cpu >= 0) ? cpu : -1;
+  }
+
+  return ret;
+}
+
+
+/*
+ * Pin the worker to the cpu only and move the batch buffer onto the
+ * node of the cpu, unless the buffer is supplied by the user.
+ */
+static inline gallus_result_t
+s_worker_place(gallus_pipeline_worker_t *wptr, int cpu) {
+  gallus_result_t ret;
+  gallus_pipeline_worker_t w = *wptr;
+
+  if ((ret = s_worker_set_cpu_affinity(wptr, -1)) == GALLUS_RESULT_OK &&
+      (ret = s_worker_set_cpu_affinity(wptr, cpu)) == GALLUS_RESULT_OK) {
+    if (w->m_freeup_proc == free ||
+        w->m_freeup_proc == gallus_free_on_cpu) {
+      size_t sz = w->m_stg->m_batch_buffer_size;
+      uint8_t *evbuf = (uint8_t *)gallus_malloc_on_cpu(sz, cpu);
+
+      if (evbuf != NULL) {
+        (void)memset((void *)evbuf, 0, sz);
+        (void)s_worker_set_buffer(wptr, (void *)evbuf, gallus_free_on_cpu);
+      }
+    }
+  }
+
+  return ret;
 }
 #endif /* GALLUS_OS_LINUX */
 
@@ -478,7 +523,8 @@ s_worker_pause(gallus_pipeline_worker_t w,
         }
 
       recheck:
-        if (ps->m_pause_requested == true) {
+        if (gallus_atomic_load(&(ps->m_pause_requested), RELAXED) ==
+            true) {
           st = s_resume_cond_wait_stage(ps, -1LL);
           if (st == GALLUS_RESULT_OK) {
             goto recheck;
@@ -532,7 +578,7 @@ s_worker_maintenance(gallus_pipeline_worker_t w,
           ps->m_maint_proc = NULL;
           ps->m_maint_arg = NULL;
 
-          ps->m_pause_requested = false;
+          gallus_atomic_store(&(ps->m_pause_requested), false, RELAXED);
           ps->m_status = STAGE_STATE_STARTED;
 
           (void)s_pause_notify_stage(ps);
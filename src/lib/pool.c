@@ -1,6 +1,7 @@
 #include "gallus_apis.h"
 #include "gallus_pool_internal.h"
 #include "gallus_poolable_internal.h"
+#include "gallus_thread_internal.h"
 
 
 
@@ -23,6 +24,187 @@ s_poolable_freeup(void **arg) {
 }
 
 
+
+
+
+/*
+ * Elastic sizing.
+ */
+
+
+/*
+ * The reaper of an elastic pool: it trims the pool every idle_to.
+ */
+typedef struct gallus_pool_reaper_record {
+  gallus_thread_record m_thd;	/* must be on the head. */
+
+  gallus_pool_t m_pool;
+  gallus_mutex_t m_lck;
+  gallus_cond_t m_cnd;
+  volatile bool m_is_stopping;
+} gallus_pool_reaper_record;
+typedef gallus_pool_reaper_record *gallus_pool_reaper_t;
+
+
+static gallus_result_t
+s_reaper_main(const gallus_thread_t *tptr, void *arg) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_pool_reaper_t r = NULL;
+
+  (void)arg;
+
+  if (likely(tptr != NULL && (r = (gallus_pool_reaper_t)*tptr) != NULL)) {
+    gallus_pool_t p = r->m_pool;
+
+    (void)gallus_mutex_lock(&r->m_lck);
+    {
+
+      while (r->m_is_stopping == false) {
+        ret = gallus_cond_wait(&r->m_cnd, &r->m_lck, p->m_idle_to);
+        if (ret == GALLUS_RESULT_TIMEDOUT && r->m_is_stopping == false) {
+          (void)gallus_pool_trim(&p);
+        }
+      }
+
+    }
+    (void)gallus_mutex_unlock(&r->m_lck);
+
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+static void
+s_reaper_freeup(const gallus_thread_t *tptr, void *arg) {
+  gallus_pool_reaper_t r = NULL;
+
+  (void)arg;
+
+  if (tptr != NULL && (r = (gallus_pool_reaper_t)*tptr) != NULL) {
+    if (r->m_lck != NULL) {
+      gallus_mutex_destroy(&r->m_lck);
+      r->m_lck = NULL;
+    }
+    if (r->m_cnd != NULL) {
+      gallus_cond_destroy(&r->m_cnd);
+      r->m_cnd = NULL;
+    }
+  }
+}
+
+
+static gallus_result_t
+s_reaper_start(gallus_pool_t p) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_pool_reaper_t r = NULL;
+
+  ret = gallus_thread_create_with_size((gallus_thread_t *)&r,
+                                       sizeof(gallus_pool_reaper_record),
+                                       s_reaper_main, NULL, s_reaper_freeup,
+                                       "pool reaper", NULL);
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    return ret;
+  }
+
+  r->m_pool = p;
+  r->m_lck = NULL;
+  r->m_cnd = NULL;
+  r->m_is_stopping = false;
+
+  if (unlikely((ret = gallus_mutex_create(&r->m_lck)) != GALLUS_RESULT_OK ||
+               (ret = gallus_cond_create(&r->m_cnd)) != GALLUS_RESULT_OK ||
+               (ret = gallus_thread_start((gallus_thread_t *)&r, false)) !=
+               GALLUS_RESULT_OK)) {
+    gallus_thread_destroy((gallus_thread_t *)&r);
+    return ret;
+  }
+
+  p->m_reaper = r;
+
+  return ret;
+}
+
+
+static void
+s_reaper_stop(gallus_pool_t p) {
+  gallus_pool_reaper_t r = p->m_reaper;
+
+  if (r != NULL) {
+    (void)gallus_mutex_lock(&r->m_lck);
+    {
+      r->m_is_stopping = true;
+      (void)gallus_cond_notify(&r->m_cnd, true);
+    }
+    (void)gallus_mutex_unlock(&r->m_lck);
+
+    (void)gallus_thread_wait((gallus_thread_t *)&r, -1LL);
+    gallus_thread_destroy((gallus_thread_t *)&r);
+    p->m_reaper = NULL;
+  }
+}
+
+
+/*
+ * Create a poolable on demand, called with the m_lck held.
+ */
+static inline gallus_result_t
+s_pool_grow(gallus_pool_t p, gallus_poolable_t *pobjptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_poolable_t pobj = NULL;
+
+  ret = gallus_poolable_create_with_size(&pobj, p->m_is_executor, &p->m_m,
+                                      NULL, p->m_pobj_size);
+  if (likely(ret == GALLUS_RESULT_OK)) {
+    pobj->m_obj_idx = p->m_obj_idx;
+    ret = gallus_poolable_setup(&pobj);
+    if (likely(ret == GALLUS_RESULT_OK)) {
+      p->m_objs[p->m_obj_idx++] = pobj;
+      p->m_n_cur = p->m_obj_idx;
+      pobj->m_pool = p;
+      p->m_stats.m_n_created++;
+      *pobjptr = pobj;
+    } else {
+      gallus_poolable_destroy(&pobj);
+    }
+  }
+
+  return ret;
+}
+
+
+/*
+ * Unlink a retiring poolable, called with the m_lck held. The last one
+ * is moved to the hole so that m_objs[0 .. m_obj_idx) stays packed.
+ */
+static inline void
+s_pool_remove(gallus_pool_t p, gallus_poolable_t pobj) {
+  size_t idx = (size_t)pobj->m_obj_idx;
+  size_t last = --p->m_obj_idx;
+
+  if (idx != last) {
+    p->m_objs[idx] = p->m_objs[last];
+    p->m_objs[idx]->m_obj_idx = idx;
+  }
+  p->m_objs[last] = NULL;
+  p->m_n_cur = p->m_obj_idx;
+}
+
+
+static inline void
+s_pool_count_acquired(gallus_pool_t p) {
+  size_t n_busy = p->m_n_max - p->m_n_free;
+
+  p->m_stats.m_n_acquired++;
+  if (n_busy > p->m_stats.m_n_busy_peak) {
+    p->m_stats.m_n_busy_peak = n_busy;
+  }
+}
+
+
 
 
 
@@ -84,7 +266,7 @@ gallus_pool_create(gallus_pool_t *pptr, size_t sz, const char *name,
     p->m_is_cancelled = false;
     p->m_n_waiters = 0;
 
-    p->m_name = strdup(name);
+    p->m_name = GALLUS_STRDUP(POOL, name);
     if (unlikely(p->m_name == NULL)) {
       ret = GALLUS_RESULT_NO_MEMORY;
       gallus_perror(ret);
@@ -107,8 +289,9 @@ gallus_pool_create(gallus_pool_t *pptr, size_t sz, const char *name,
     p->m_n_cur = 0;
     p->m_n_free = n_max_objs;
 
-    p->m_objs = (gallus_poolable_t *)malloc(sizeof(gallus_poolable_t) *
-                                         n_max_objs);
+    p->m_objs = (gallus_poolable_t *)GALLUS_MALLOC(POOL,
+                                                sizeof(gallus_poolable_t) *
+                                                n_max_objs);
     if (likely(p->m_objs != NULL)) {
       (void)memset(p->m_objs, 0, sizeof(gallus_poolable_t) * n_max_objs);
     } else {
@@ -234,7 +417,7 @@ gallus_pool_acquire_poolable_by_index(gallus_pool_t *pptr, uint64_t index,
     gallus_mutex_lock(&p->m_lck);
     {
 
-      n_waiters = __atomic_fetch_add(&p->m_n_waiters, 1, __ATOMIC_ACQ_REL);
+      n_waiters = gallus_atomic_fetch_add(&p->m_n_waiters, 1, RELAXED);
       
       while (true) {
         if (pobj->m_is_used == false) {
@@ -251,7 +434,7 @@ gallus_pool_acquire_poolable_by_index(gallus_pool_t *pptr, uint64_t index,
         }
       }
 
-      n_waiters = __atomic_sub_fetch(&p->m_n_waiters, 1, __ATOMIC_ACQ_REL);
+      n_waiters = gallus_atomic_sub_fetch(&p->m_n_waiters, 1, RELAXED);
 
       if (is_awakened == true) {
         if (n_waiters == 0) {
@@ -267,6 +450,7 @@ gallus_pool_acquire_poolable_by_index(gallus_pool_t *pptr, uint64_t index,
         *pobjptr = pobj;
         pobj->m_is_used = true;
         p->m_n_free--;
+        s_pool_count_acquired(p);
       }
 
     }
@@ -309,7 +493,7 @@ gallus_pool_acquire_poolable(gallus_pool_t *pptr, gallus_chrono_t to,
       gallus_mutex_lock(&p->m_lck);
       {
 
-        n_waiters = __atomic_fetch_add(&p->m_n_waiters, 1, __ATOMIC_ACQ_REL);
+        n_waiters = gallus_atomic_fetch_add(&p->m_n_waiters, 1, RELAXED);
 
         while (found == false) {
           for (i = 0; i < p->m_obj_idx; i++) {
@@ -331,7 +515,7 @@ gallus_pool_acquire_poolable(gallus_pool_t *pptr, gallus_chrono_t to,
           }
         }
 
-        n_waiters = __atomic_sub_fetch(&p->m_n_waiters, 1, __ATOMIC_ACQ_REL);
+        n_waiters = gallus_atomic_sub_fetch(&p->m_n_waiters, 1, RELAXED);
 
         if (is_awakened == true) {
           if (n_waiters == 0) {
@@ -347,6 +531,7 @@ gallus_pool_acquire_poolable(gallus_pool_t *pptr, gallus_chrono_t to,
           *pobjptr = pobj;
           pobj->m_is_used = true;
           p->m_n_free--;
+          s_pool_count_acquired(p);
         }
 
       }
@@ -375,6 +560,9 @@ gallus_pool_acquire_poolable(gallus_pool_t *pptr, gallus_chrono_t to,
           ret = gallus_bbq_get(&p->m_free_q, &pobj, gallus_poolable_t, 0);
           if (likely(ret == GALLUS_RESULT_OK)) {
             found = true;
+            if ((size_t)(n - 1) < p->m_n_idle_low) {
+              p->m_n_idle_low = (size_t)(n - 1);
+            }
           }
 
         } else if (n == 0 && p->m_obj_idx < p->m_n_max) {
@@ -384,19 +572,9 @@ gallus_pool_acquire_poolable(gallus_pool_t *pptr, gallus_chrono_t to,
            * create new one.
            */
 
-          ret = gallus_poolable_create_with_size(&pobj, p->m_is_executor, &p->m_m,
-                                              NULL, p->m_pobj_size);
+          ret = s_pool_grow(p, &pobj);
           if (likely(ret == GALLUS_RESULT_OK)) {
-            pobj->m_obj_idx = p->m_obj_idx;
-            ret = gallus_poolable_setup(&pobj);
-            if (likely(ret == GALLUS_RESULT_OK)) {
-              p->m_objs[p->m_obj_idx++] = pobj;
-              p->m_n_cur = p->m_obj_idx;
-	      pobj->m_pool = p;
-	      found = true;
-            } else {
-              gallus_poolable_destroy(&pobj);
-            }
+            found = true;
           }
         }
 
@@ -404,6 +582,12 @@ gallus_pool_acquire_poolable(gallus_pool_t *pptr, gallus_chrono_t to,
           *pobjptr = pobj;
           pobj->m_is_used = true;
           p->m_n_free--;
+          s_pool_count_acquired(p);
+        } else {
+          p->m_n_blocked++;
+        }
+        if (n <= 1) {
+          p->m_n_idle_low = 0;
         }
 
       }
@@ -416,23 +600,36 @@ gallus_pool_acquire_poolable(gallus_pool_t *pptr, gallus_chrono_t to,
          * Wait for someone release a poolable.
          */
 
+        gallus_chrono_t t0, t1;
+
+        WHAT_TIME_IS_IT_NOW_IN_NSEC(t0);
         ret = gallus_bbq_get(&p->m_free_q, &pobj, sizeof(pobj), to);
-        if (likely(ret == GALLUS_RESULT_OK && pobj != NULL)) {
+        WHAT_TIME_IS_IT_NOW_IN_NSEC(t1);
 
-          /*
-           * Critical region 2
-           */
-          gallus_mutex_lock(&p->m_lck);
-          {
+        /*
+         * Critical region 2
+         */
+        gallus_mutex_lock(&p->m_lck);
+        {
 
+          p->m_n_blocked--;
+          p->m_stats.m_n_waited++;
+          p->m_stats.m_wait_total += t1 - t0;
+          if (t1 - t0 > p->m_stats.m_wait_max) {
+            p->m_stats.m_wait_max = t1 - t0;
+          }
+
+          if (likely(ret == GALLUS_RESULT_OK && pobj != NULL)) {
             *pobjptr = pobj;
             pobj->m_is_used = true;
             p->m_n_free--;
-
+            s_pool_count_acquired(p);
+          } else if (ret == GALLUS_RESULT_TIMEDOUT) {
+            p->m_stats.m_n_timedout++;
           }
-          gallus_mutex_unlock(&p->m_lck);
 
         }
+        gallus_mutex_unlock(&p->m_lck);
       }
 
       /* GALLUS_POOL_TYPE_QUEUE end */
@@ -514,6 +711,169 @@ gallus_pool_release_poolable(gallus_poolable_t *pobjptr) {
 }
 
 
+gallus_result_t
+gallus_pool_set_elastic(gallus_pool_t *pptr, size_t n_min,
+                        gallus_chrono_t idle_to) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_pool_t p = NULL;
+
+  if (likely(pptr != NULL && (p = *pptr) != NULL &&
+             p->m_type == GALLUS_POOL_TYPE_QUEUE &&
+             n_min <= p->m_n_max)) {
+    gallus_poolable_t pobj = NULL;
+    bool do_start = false;
+
+    (void)gallus_mutex_lock(&p->m_lck);
+    {
+
+      if (likely(p->m_state == GALLUS_POOL_STATE_OPERATIONAL)) {
+        p->m_n_min = n_min;
+        p->m_idle_to = idle_to;
+
+        /*
+         * Pre-warm.
+         */
+        ret = GALLUS_RESULT_OK;
+        while (ret == GALLUS_RESULT_OK && p->m_obj_idx < n_min) {
+          ret = s_pool_grow(p, &pobj);
+          if (likely(ret == GALLUS_RESULT_OK)) {
+            ret = gallus_bbq_put(&p->m_free_q, &pobj, gallus_poolable_t,
+                                 -1LL);
+          }
+        }
+        p->m_n_idle_low = (size_t)gallus_bbq_size(&p->m_free_q);
+
+        do_start = (ret == GALLUS_RESULT_OK && idle_to > 0 &&
+                    n_min < p->m_n_max && p->m_reaper == NULL) ?
+                   true : false;
+      } else {
+        ret = GALLUS_RESULT_NOT_OPERATIONAL;
+      }
+
+    }
+    (void)gallus_mutex_unlock(&p->m_lck);
+
+    if (do_start == true) {
+      ret = s_reaper_start(p);
+    }
+
+  } else {
+    if (p != NULL && p->m_type != GALLUS_POOL_TYPE_QUEUE) {
+      ret = GALLUS_RESULT_INVALID_OBJECT;
+    } else {
+      ret = GALLUS_RESULT_INVALID_ARGS;
+    }
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_pool_trim(gallus_pool_t *pptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_pool_t p = NULL;
+
+  if (likely(pptr != NULL && (p = *pptr) != NULL &&
+             p->m_type == GALLUS_POOL_TYPE_QUEUE)) {
+    gallus_poolable_t *objs = NULL;
+    gallus_poolable_t pobj = NULL;
+    int64_t n_idle;
+    size_t n = 0;
+    size_t i = 0;
+
+    (void)gallus_mutex_lock(&p->m_lck);
+    {
+
+      if (likely(p->m_state == GALLUS_POOL_STATE_OPERATIONAL)) {
+        /*
+         * Don't race with the blocked acquirers for a released obj.
+         */
+        if (p->m_n_blocked == 0 && p->m_n_cur > p->m_n_min) {
+          n = p->m_n_idle_low;
+          if (n > p->m_n_cur - p->m_n_min) {
+            n = p->m_n_cur - p->m_n_min;
+          }
+        }
+        if (n > 0 &&
+            (objs = (gallus_poolable_t *)
+                    GALLUS_MALLOC(POOL, sizeof(gallus_poolable_t) * n)) !=
+            NULL) {
+          for (i = 0; i < n; i++) {
+            if (gallus_bbq_get(&p->m_free_q, &pobj, gallus_poolable_t, 0) !=
+                GALLUS_RESULT_OK) {
+              break;
+            }
+            s_pool_remove(p, pobj);
+            objs[i] = pobj;
+          }
+          p->m_stats.m_n_retired += i;
+        }
+
+        /*
+         * Start a new window.
+         */
+        n_idle = gallus_bbq_size(&p->m_free_q);
+        p->m_n_idle_low = (n_idle > 0) ? (size_t)n_idle : 0;
+
+        ret = (gallus_result_t)i;
+      } else {
+        ret = GALLUS_RESULT_NOT_OPERATIONAL;
+      }
+
+    }
+    (void)gallus_mutex_unlock(&p->m_lck);
+
+    /*
+     * Joining the threads of executor poolables may take a while, so
+     * do it out of the m_lck.
+     */
+    n = i;
+    for (i = 0; i < n; i++) {
+      (void)gallus_poolable_shutdown(&objs[i], SHUTDOWN_GRACEFULLY);
+      (void)gallus_poolable_wait(&objs[i], -1LL);
+      gallus_poolable_destroy(&objs[i]);
+    }
+    GALLUS_FREE(POOL, objs);
+
+  } else {
+    if (p != NULL && p->m_type != GALLUS_POOL_TYPE_QUEUE) {
+      ret = GALLUS_RESULT_INVALID_OBJECT;
+    } else {
+      ret = GALLUS_RESULT_INVALID_ARGS;
+    }
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_pool_get_stats(gallus_pool_t *pptr, gallus_pool_stats_t *sptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_pool_t p = NULL;
+
+  if (likely(pptr != NULL && (p = *pptr) != NULL && sptr != NULL)) {
+
+    (void)gallus_mutex_lock(&p->m_lck);
+    {
+      *sptr = p->m_stats;
+      sptr->m_n_min = p->m_n_min;
+      sptr->m_n_max = p->m_n_max;
+      sptr->m_n_cur = p->m_n_cur;
+      sptr->m_n_busy = p->m_n_max - p->m_n_free;
+    }
+    (void)gallus_mutex_unlock(&p->m_lck);
+
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
 gallus_result_t
 gallus_pool_get_outstanding_obj_num(gallus_pool_t *pptr) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
@@ -552,7 +912,7 @@ gallus_pool_wakeup(gallus_pool_t *pptr, gallus_chrono_t to) {
         p->m_is_awakened = true;
         ret = gallus_cond_notify(&p->m_cnd, true);
         if (ret == GALLUS_RESULT_OK) {
-          n_waiters = __atomic_load_n(&p->m_n_waiters, __ATOMIC_ACQUIRE);
+          n_waiters = gallus_atomic_load(&p->m_n_waiters, RELAXED);
           if (n_waiters > 0) {
             ret = gallus_cond_wait(&p->m_awakened_cnd, &p->m_lck, to);
           }
@@ -599,7 +959,9 @@ gallus_pool_shutdown(gallus_pool_t *pptr,  shutdown_grace_level_t lvl,
     gallus_result_t first_err = GALLUS_RESULT_ANY_FAILURES;
     gallus_poolable_t pobj = NULL;
     bool got_err = false;
-    
+
+    s_reaper_stop(p);
+
     (void)gallus_mutex_lock(&p->m_lck);
     {
 
@@ -713,8 +1075,9 @@ gallus_pool_wait(gallus_pool_t *pptr, gallus_chrono_t to) {
 
         do {
           n_errs = 0;
-          WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
-          
+          /* polling in msec, the coarse clock is enough. */
+          now = gallus_chrono_coarse_now();
+
           for (i = 0; i < p->m_obj_idx; i++) {
             pobj = p->m_objs[i];
             /* 1 msec polling. */
@@ -780,10 +1143,12 @@ gallus_pool_destroy(gallus_pool_t *pptr) {
                   (IS_VALID_STRING(p->m_name) == true) ?
                   p->m_name : "???");
 
+    s_reaper_stop(p);
+
     if (p->m_name != NULL) {
       key = p->m_name;
       (void)gallus_hashmap_delete(&s_pools, key, NULL, false);
-      free(p->m_name);
+      GALLUS_FREE(POOL, p->m_name);
     }
 
     if (p->m_objs != NULL) {
@@ -811,7 +1176,7 @@ gallus_pool_destroy(gallus_pool_t *pptr) {
       }
 
       if (n_used == 0) {
-        free(p->m_objs);
+        GALLUS_FREE(POOL, p->m_objs);
       }
     }
 
@@ -181,6 +181,8 @@ gallus_poolable_shutdown(gallus_poolable_t *pptr, shutdown_grace_level_t lvl) {
             }
             if (likely(ret == GALLUS_RESULT_OK)) {
               (*pptr)->m_st = GALLUS_POOLABLE_STATE_NOT_OPERATIONAL;
+              (*pptr)->m_is_torndown = true;
+              (*pptr)->m_is_wait_done = true;
             }
           }
         }
@@ -232,6 +234,8 @@ gallus_poolable_cancel(gallus_poolable_t *pptr) {
             }
             if (likely(ret == GALLUS_RESULT_OK)) {
               (*pptr)->m_st = GALLUS_POOLABLE_STATE_NOT_OPERATIONAL;
+              (*pptr)->m_is_torndown = true;
+              (*pptr)->m_is_wait_done = true;
             }
           }
         }
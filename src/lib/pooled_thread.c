@@ -514,6 +514,375 @@ s_pooled_thread_destruct(gallus_poolable_t *pptr) {
 
 
 
+/*
+ * executor mode
+ */
+
+
+#define EXECUTOR_SPIN_MAX	64
+
+
+typedef struct gallus_executor_worker_record {
+  gallus_task_record m_task;	/* must be on the head. */
+
+  gallus_thread_pool_executor_t m_exec;
+  size_t m_idx;
+} gallus_executor_worker_record;
+
+
+static inline void
+s_runq_push(gallus_executor_runq_record *q, gallus_task_t t) {
+  t->m_next = NULL;
+
+  (void)gallus_spinlock_lock(&q->m_lck);
+  {
+    if (q->m_tail != NULL) {
+      q->m_tail->m_next = t;
+    } else {
+      __atomic_store_n(&q->m_head, t, __ATOMIC_RELEASE);
+    }
+    q->m_tail = t;
+  }
+  (void)gallus_spinlock_unlock(&q->m_lck);
+}
+
+
+static inline gallus_task_t
+s_runq_pop(gallus_executor_runq_record *q) {
+  gallus_task_t t = NULL;
+
+  /*
+   * Peek without the lock; stealers probe every queue.
+   */
+  if (__atomic_load_n(&q->m_head, __ATOMIC_ACQUIRE) == NULL) {
+    return NULL;
+  }
+
+  (void)gallus_spinlock_lock(&q->m_lck);
+  {
+    if ((t = q->m_head) != NULL) {
+      __atomic_store_n(&q->m_head, t->m_next, __ATOMIC_RELEASE);
+      if (t->m_next == NULL) {
+        q->m_tail = NULL;
+      }
+      t->m_next = NULL;
+    }
+  }
+  (void)gallus_spinlock_unlock(&q->m_lck);
+
+  return t;
+}
+
+
+static inline gallus_task_t
+s_executor_take(gallus_thread_pool_executor_t e, size_t idx) {
+  gallus_task_t t = NULL;
+  size_t i;
+
+  for (i = 0; i < e->m_n_workers && t == NULL; i++) {
+    t = s_runq_pop(&e->m_qs[(idx + i) % e->m_n_workers]);
+  }
+  if (t != NULL) {
+    (void)__atomic_sub_fetch(&e->m_n_queued, 1, __ATOMIC_SEQ_CST);
+  }
+
+  return t;
+}
+
+
+static inline void
+s_executor_run_task(gallus_task_t t) {
+  gallus_result_t ret;
+  bool do_autodelete = false;
+
+  (void)gallus_mutex_lock(&t->m_lck);
+  {
+
+    t->m_is_started = true;
+    t->m_state = GALLUS_TASK_STATE_RUNNING;
+    do_autodelete =
+        ((t->m_flag & GALLUS_TASK_DELETE_CONTEXT_AFTER_EXEC) != 0) ?
+        true : false;
+
+  }
+  (void)gallus_mutex_unlock(&t->m_lck);
+
+  /*
+   * Unlike the task runner, don't rename the thread per task; it
+   * costs two syscalls per tiny task.
+   */
+  ret = t->m_main(&t);
+
+  (void)gallus_mutex_lock(&t->m_lck);
+  {
+
+    t->m_exit_code = ret;
+    t->m_is_clean_finished = true;
+    t->m_state = GALLUS_TASK_STATE_CLEAN_FINISHED;
+
+  }
+  (void)gallus_mutex_unlock(&t->m_lck);
+
+  gallus_task_finalize(&t, false);
+
+  if (do_autodelete == true) {
+    gallus_task_destroy(&t);
+  }
+}
+
+
+static inline void
+s_executor_drop_task(gallus_task_t t) {
+  bool do_autodelete = false;
+
+  (void)gallus_mutex_lock(&t->m_lck);
+  {
+
+    t->m_exit_code = GALLUS_RESULT_NOT_STARTED;
+    t->m_is_runner_shutdown = true;
+    t->m_state = GALLUS_TASK_STATE_RUNNER_SHUTDOWN;
+    do_autodelete =
+        ((t->m_flag & GALLUS_TASK_DELETE_CONTEXT_AFTER_EXEC) != 0) ?
+        true : false;
+
+  }
+  (void)gallus_mutex_unlock(&t->m_lck);
+
+  gallus_task_finalize(&t, false);
+
+  if (do_autodelete == true) {
+    gallus_task_destroy(&t);
+  }
+}
+
+
+static gallus_result_t
+s_executor_worker_main(gallus_task_t *tptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_executor_worker_t w = NULL;
+
+  if (likely(tptr != NULL &&
+             (w = (gallus_executor_worker_t)*tptr) != NULL)) {
+    gallus_thread_pool_executor_t e = w->m_exec;
+    gallus_task_t t = NULL;
+    size_t n_spins = 0;
+
+    while (true) {
+
+      if (unlikely(__atomic_load_n(&e->m_is_stopping, __ATOMIC_ACQUIRE) ==
+                   true && e->m_stop_lvl != SHUTDOWN_GRACEFULLY)) {
+        break;
+      }
+
+      if (likely((t = s_executor_take(e, w->m_idx)) != NULL)) {
+        s_executor_run_task(t);
+        n_spins = 0;
+        continue;
+      }
+
+      if (__atomic_load_n(&e->m_is_stopping, __ATOMIC_ACQUIRE) == true) {
+        /*
+         * Drained once no enqueuer that passed its m_is_stopping
+         * check is still pushing.
+         */
+        if (__atomic_load_n(&e->m_n_enqueuers, __ATOMIC_SEQ_CST) == 0 &&
+            __atomic_load_n(&e->m_n_queued, __ATOMIC_SEQ_CST) == 0) {
+          break;
+        }
+        (void)sched_yield();
+        continue;
+      }
+
+      if (n_spins++ < EXECUTOR_SPIN_MAX) {
+        (void)sched_yield();
+        continue;
+      }
+
+      /*
+       * Go to sleep. A submitter bumps m_n_queued before it checks
+       * m_n_sleepers and this does the reverse, so at least one of
+       * them sees the other.
+       */
+      (void)gallus_mutex_lock(&e->m_idle_lck);
+      {
+
+        (void)__atomic_add_fetch(&e->m_n_sleepers, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&e->m_n_queued, __ATOMIC_SEQ_CST) == 0 &&
+            __atomic_load_n(&e->m_is_stopping, __ATOMIC_ACQUIRE) == false) {
+          (void)gallus_cond_wait(&e->m_idle_cnd, &e->m_idle_lck, -1LL);
+        }
+        (void)__atomic_sub_fetch(&e->m_n_sleepers, 1, __ATOMIC_SEQ_CST);
+
+      }
+      (void)gallus_mutex_unlock(&e->m_idle_lck);
+
+      n_spins = 0;
+    }
+
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+static gallus_result_t
+s_executor_stop(gallus_thread_pool_executor_t e, shutdown_grace_level_t lvl,
+                gallus_chrono_t to) {
+  gallus_result_t ret = GALLUS_RESULT_OK;
+  gallus_result_t r;
+  gallus_task_t t = NULL;
+  size_t i;
+
+  if (e->m_is_stopped == true) {
+    return GALLUS_RESULT_OK;
+  }
+
+  e->m_stop_lvl = lvl;
+  mbar();
+  __atomic_store_n(&e->m_is_stopping, true, __ATOMIC_SEQ_CST);
+
+  /*
+   * An enqueuer bumps m_n_enqueuers before it checks m_is_stopping
+   * and this does the reverse, so once the count drops to zero every
+   * accepted task is on a run queue and no more come.
+   */
+  while (__atomic_load_n(&e->m_n_enqueuers, __ATOMIC_SEQ_CST) > 0) {
+    (void)sched_yield();
+  }
+
+  (void)gallus_mutex_lock(&e->m_idle_lck);
+  {
+    (void)gallus_cond_notify(&e->m_idle_cnd, true);
+  }
+  (void)gallus_mutex_unlock(&e->m_idle_lck);
+
+  for (i = 0; i < e->m_n_workers; i++) {
+    if (e->m_workers[i] != NULL) {
+      r = gallus_task_wait((gallus_task_t *)&e->m_workers[i], to);
+      if (unlikely(r != GALLUS_RESULT_OK && ret == GALLUS_RESULT_OK)) {
+        ret = r;
+      }
+    }
+  }
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    return ret;
+  }
+
+  for (i = 0; i < e->m_n_workers; i++) {
+    if (e->m_workers[i] != NULL) {
+      gallus_task_destroy((gallus_task_t *)&e->m_workers[i]);
+      e->m_workers[i] = NULL;
+    }
+    if (e->m_thds[i] != NULL) {
+      (void)gallus_thread_pool_release_thread(&e->m_thds[i]);
+      e->m_thds[i] = NULL;
+    }
+  }
+
+  /*
+   * Whatever is left was never started.
+   */
+  while ((t = s_executor_take(e, 0)) != NULL) {
+    s_executor_drop_task(t);
+  }
+
+  e->m_is_stopped = true;
+
+  return ret;
+}
+
+
+static void
+s_executor_destroy(gallus_thread_pool_executor_t *eptr) {
+  gallus_thread_pool_executor_t e = NULL;
+  size_t i;
+
+  if (eptr != NULL && (e = *eptr) != NULL) {
+    if (e->m_qs != NULL) {
+      for (i = 0; i < e->m_n_workers; i++) {
+        gallus_spinlock_finalize(&e->m_qs[i].m_lck);
+      }
+      free(e->m_qs);
+    }
+    free(e->m_thds);
+    free(e->m_workers);
+    if (e->m_idle_cnd != NULL) {
+      gallus_cond_destroy(&e->m_idle_cnd);
+    }
+    if (e->m_idle_lck != NULL) {
+      gallus_mutex_destroy(&e->m_idle_lck);
+    }
+    free(e);
+    *eptr = NULL;
+  }
+}
+
+
+static gallus_result_t
+s_executor_create(gallus_thread_pool_executor_t *eptr, size_t n) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_thread_pool_executor_t e = NULL;
+  size_t i;
+
+  e = (gallus_thread_pool_executor_t)calloc(1, sizeof(*e));
+  if (unlikely(e == NULL)) {
+    ret = GALLUS_RESULT_NO_MEMORY;
+    goto done;
+  }
+  e->m_n_workers = n;
+  e->m_is_stopping = false;
+  e->m_is_stopped = false;
+  e->m_stop_lvl = SHUTDOWN_UNKNOWN;
+  e->m_n_enqueuers = 0;
+
+  if (unlikely(posix_memalign((void **)&e->m_qs, 64,
+                              sizeof(gallus_executor_runq_record) * n) != 0)) {
+    e->m_qs = NULL;
+    ret = GALLUS_RESULT_NO_MEMORY;
+    goto done;
+  }
+  (void)memset(e->m_qs, 0, sizeof(gallus_executor_runq_record) * n);
+  for (i = 0; i < n; i++) {
+    ret = gallus_spinlock_initialize(&e->m_qs[i].m_lck);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      goto done;
+    }
+  }
+
+  e->m_thds = (gallus_pooled_thread_t *)
+              calloc(n, sizeof(gallus_pooled_thread_t));
+  e->m_workers = (gallus_executor_worker_t *)
+                 calloc(n, sizeof(gallus_executor_worker_t));
+  if (unlikely(e->m_thds == NULL || e->m_workers == NULL)) {
+    ret = GALLUS_RESULT_NO_MEMORY;
+    goto done;
+  }
+
+  if (unlikely((ret = gallus_mutex_create(&e->m_idle_lck)) !=
+               GALLUS_RESULT_OK)) {
+    goto done;
+  }
+  ret = gallus_cond_create(&e->m_idle_cnd);
+
+done:
+  if (likely(ret == GALLUS_RESULT_OK)) {
+    *eptr = e;
+  } else {
+    gallus_perror(ret);
+    gallus_msg_error("can't create an executor for a thread pool.\n");
+    s_executor_destroy(&e);
+  }
+
+  return ret;
+}
+
+
+
+
+
 /*
  * pool wrapper
  */
@@ -532,7 +901,8 @@ static gallus_poolable_methods_record s_methods = {
 
 gallus_result_t
 gallus_thread_pool_create(gallus_thread_pool_t *pptr, const char *name, size_t n) {
-  return gallus_pool_create((gallus_pool_t *)pptr,
+  gallus_result_t ret =
+      gallus_pool_create((gallus_pool_t *)pptr,
                          sizeof(gallus_thread_pool_record),
                          name,
                          GALLUS_POOL_TYPE_QUEUE,	/* queue type */
@@ -540,6 +910,36 @@ gallus_thread_pool_create(gallus_thread_pool_t *pptr, const char *name, size_t n
                          n,
                          sizeof(gallus_pooled_thread_record),
 			 &s_methods);
+  if (likely(ret == GALLUS_RESULT_OK)) {
+    (*pptr)->m_exec = NULL;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_thread_pool_create_elastic(gallus_thread_pool_t *pptr,
+                                  const char *name,
+                                  size_t n_min, size_t n_max,
+                                  gallus_chrono_t idle_to) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (unlikely(pptr == NULL || n_min > n_max)) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  ret = gallus_thread_pool_create(pptr, name, n_max);
+  if (likely(ret == GALLUS_RESULT_OK)) {
+    ret = gallus_pool_set_elastic((gallus_pool_t *)pptr, n_min, idle_to);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      gallus_perror(ret);
+      gallus_thread_pool_destroy(pptr);
+      *pptr = NULL;
+    }
+  }
+
+  return ret;
 }
 
 
@@ -564,6 +964,19 @@ gallus_thread_pool_get_outstanding_thread_num(gallus_thread_pool_t *pptr) {
 }
 
 
+gallus_result_t
+gallus_thread_pool_trim(gallus_thread_pool_t *pptr) {
+  return gallus_pool_trim((gallus_pool_t *)pptr);
+}
+
+
+gallus_result_t
+gallus_thread_pool_get_stats(gallus_thread_pool_t *pptr,
+                             gallus_pool_stats_t *sptr) {
+  return gallus_pool_get_stats((gallus_pool_t *)pptr, sptr);
+}
+
+
 gallus_result_t
 gallus_thread_pool_wakeup(gallus_thread_pool_t *pptr, gallus_chrono_t to) {
   return gallus_pool_wakeup((gallus_pool_t *)pptr, to);
@@ -574,6 +987,13 @@ gallus_result_t
 gallus_thread_pool_shutdown_all(gallus_thread_pool_t *pptr,
 			     shutdown_grace_level_t lvl,
 			     gallus_chrono_t to) {
+  if (pptr != NULL && *pptr != NULL && (*pptr)->m_exec != NULL) {
+    gallus_result_t ret = s_executor_stop((*pptr)->m_exec, lvl, to);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      return ret;
+    }
+  }
+
   return gallus_pool_shutdown((gallus_pool_t *)pptr, lvl, to);
 }
 
@@ -592,6 +1012,11 @@ gallus_thread_pool_wait_all(gallus_thread_pool_t *pptr, gallus_chrono_t to) {
 
 void
 gallus_thread_pool_destroy(gallus_thread_pool_t *pptr) {
+  if (pptr != NULL && *pptr != NULL && (*pptr)->m_exec != NULL) {
+    (void)s_executor_stop((*pptr)->m_exec, SHUTDOWN_RIGHT_NOW, -1LL);
+    s_executor_destroy(&(*pptr)->m_exec);
+  }
+
   gallus_pool_destroy((gallus_pool_t *)pptr);
 }
 
@@ -601,3 +1026,104 @@ gallus_thread_pool_get(const char *name, gallus_thread_pool_t *pptr) {
   return gallus_pool_get_pool(name, (gallus_pool_t *)pptr);  
 }
 
+
+
+gallus_result_t
+gallus_thread_pool_create_executor(gallus_thread_pool_t *pptr,
+                                   const char *name, size_t n) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_thread_pool_executor_t e = NULL;
+  gallus_executor_worker_t w = NULL;
+  size_t i;
+
+  if (unlikely(pptr == NULL || n == 0)) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  ret = gallus_thread_pool_create(pptr, name, n);
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    return ret;
+  }
+
+  ret = s_executor_create(&e, n);
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    goto done;
+  }
+  (*pptr)->m_exec = e;
+
+  /*
+   * Every pooled thread is taken for good and runs a worker task.
+   */
+  for (i = 0; i < n; i++) {
+    ret = gallus_thread_pool_acquire_thread(pptr, &e->m_thds[i], -1LL);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      goto done;
+    }
+
+    w = NULL;
+    ret = gallus_task_create((gallus_task_t *)&w,
+                             sizeof(gallus_executor_worker_record),
+                             "executor",
+                             s_executor_worker_main, NULL, NULL);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      goto done;
+    }
+    w->m_exec = e;
+    w->m_idx = i;
+    e->m_workers[i] = w;
+
+    ret = gallus_task_run((gallus_task_t *)&e->m_workers[i], &e->m_thds[i],
+                          0);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      goto done;
+    }
+  }
+
+done:
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    gallus_perror(ret);
+    gallus_thread_pool_destroy(pptr);
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_thread_pool_enqueue_task(gallus_thread_pool_t *pptr, gallus_task_t t) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_thread_pool_executor_t e = NULL;
+
+  if (likely(pptr != NULL && *pptr != NULL && t != NULL)) {
+    if (likely((e = (*pptr)->m_exec) != NULL)) {
+      (void)__atomic_add_fetch(&e->m_n_enqueuers, 1, __ATOMIC_SEQ_CST);
+      if (likely(__atomic_load_n(&e->m_is_stopping, __ATOMIC_SEQ_CST) ==
+                 false)) {
+        size_t idx = __atomic_fetch_add(&e->m_rr, 1, __ATOMIC_RELAXED) %
+                     e->m_n_workers;
+
+        s_runq_push(&e->m_qs[idx], t);
+        (void)__atomic_add_fetch(&e->m_n_queued, 1, __ATOMIC_SEQ_CST);
+
+        if (__atomic_load_n(&e->m_n_sleepers, __ATOMIC_SEQ_CST) > 0) {
+          (void)gallus_mutex_lock(&e->m_idle_lck);
+          {
+            (void)gallus_cond_notify(&e->m_idle_cnd, false);
+          }
+          (void)gallus_mutex_unlock(&e->m_idle_lck);
+        }
+
+        ret = GALLUS_RESULT_OK;
+      } else {
+        ret = GALLUS_RESULT_NOT_OPERATIONAL;
+      }
+      (void)__atomic_sub_fetch(&e->m_n_enqueuers, 1, __ATOMIC_SEQ_CST);
+    } else {
+      ret = GALLUS_RESULT_INVALID_OBJECT;
+    }
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
@@ -2,10 +2,13 @@
 #include "gallus_session.h"
 #include "session_internal.h"
 
+#include <sys/uio.h>
+
 #define SBUF_UNREAD_LEN(a) ((((a)->rbuf.ep) - ((a)->rbuf.rp)))
 #define SBUF_UNFILL_LEN(a) (((a)->rbuf.buf + SESSION_BUFSIZ) - ((a)->rbuf.ep))
 
 #define MAX_EVENTS     1024
+#define MAX_IOVS       64
 
 extern gallus_result_t session_tcp_init(gallus_session_t );
 extern gallus_result_t session_tls_init(gallus_session_t );
@@ -156,6 +159,23 @@ bind_default(gallus_session_t s,
       close(sock);
       return ret;
     }
+
+    if (s->reuseport == true) {
+#ifdef SO_REUSEPORT
+      ret = setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+      if (ret < 0) {
+        gallus_msg_error("setsockopt error %s.\n", strerror(errno));
+        free(saddr);
+        close(sock);
+        return ret;
+      }
+#else
+      gallus_msg_error("SO_REUSEPORT is not supported.\n");
+      free(saddr);
+      close(sock);
+      return -1;
+#endif /* SO_REUSEPORT */
+    }
   }
 
   ret = bind(sock, saddr, saddr_len);
@@ -255,6 +275,62 @@ writen(gallus_session_t s, void *buf, size_t n) {
   return offset;
 }
 
+/*
+ * Sessions w/o a writev (e.g. TLS) write the pieces one by one.
+ */
+static ssize_t
+writev_default(gallus_session_t s, const struct iovec *iov, int iovcnt) {
+  ssize_t ret, total = 0;
+  int i;
+
+  for (i = 0; i < iovcnt; i++) {
+    ret = s->write(s, iov[i].iov_base, iov[i].iov_len);
+    if (ret < 0 && total == 0) {
+      return ret;
+    } else if (ret <= 0) {
+      break;
+    }
+    total += ret;
+    if ((size_t) ret < iov[i].iov_len) {
+      break;
+    }
+  }
+
+  return total;
+}
+
+static ssize_t
+writevn(gallus_session_t s, struct iovec *iov, int iovcnt) {
+  ssize_t ret, offset = 0;
+  size_t n;
+
+  while (iovcnt > 0) {
+    ret = (s->writev != NULL) ?
+          s->writev(s, iov, (iovcnt > IOV_MAX) ? IOV_MAX : iovcnt) :
+          writev_default(s, iov, iovcnt);
+    if (ret < 0 && offset == 0) {
+      return ret;
+    } else if (ret <= 0) {
+      return offset;
+    }
+    offset += ret;
+
+    /* skip what's written. */
+    n = (size_t) ret;
+    while (iovcnt > 0 && n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = (char *) iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+
+  return offset;
+}
+
 gallus_result_t
 session_create(session_type_t t, gallus_session_t *session) {
   gallus_result_t ret;
@@ -272,7 +348,7 @@ session_create(session_type_t t, gallus_session_t *session) {
 
   gallus_msg_debug(5, "s_server_session %x.\n", t);
 
-  s = malloc(sizeof(struct session));
+  s = GALLUS_MALLOC(SESSION, sizeof(struct session));
   if (s == NULL) {
     return GALLUS_RESULT_NO_MEMORY;
   }
@@ -282,11 +358,15 @@ session_create(session_type_t t, gallus_session_t *session) {
   s->connect = NULL;
   s->read = NULL;
   s->write = NULL;
+  s->writev = NULL;
   s->close = close_default;
   s->destroy = NULL;
   s->connect_check = NULL;
+  s->handshake = NULL;
+  s->pending = NULL;
   s->ctx = NULL;
   s->session_type = t;
+  s->reuseport = false;
   s->events = 0;
   memset(&s->rbuf.buf, 0, sizeof(s->rbuf.buf));
   s->rbuf.rp = s->rbuf.ep = s->rbuf.buf;
@@ -336,7 +416,7 @@ session_create(session_type_t t, gallus_session_t *session) {
 
 err:
   gallus_msg_warning("illegal session type: 0x%x\n", t);
-  free(s);
+  GALLUS_FREE(SESSION, s);
   *session = NULL;
   return ret;
 }
@@ -386,15 +466,18 @@ session_destroy(gallus_session_t s) {
   close_default(s);
   s->read = NULL;
   s->write = NULL;
+  s->writev = NULL;
   s->close = NULL;
   s->connect_check = NULL;
+  s->handshake = NULL;
+  s->pending = NULL;
 
   if (s->destroy) {
     s->destroy(s);
   }
 
   s->destroy = NULL;
-  free(s);
+  GALLUS_FREE(SESSION, s);
 }
 
 bool
@@ -504,7 +587,9 @@ session_poll(gallus_session_t s[], int n, int timeout) {
   }
 
   for (i = 0; i < n; i++) {
-    if ((s[i]->events & POLLIN) && (SBUF_UNREAD_LEN(s[i]) > 0)) {
+    if ((s[i]->events & POLLIN) &&
+        (SBUF_UNREAD_LEN(s[i]) > 0 ||
+         (s[i]->pending != NULL && s[i]->pending(s[i]) > 0))) {
       s[i]->revents = POLLIN;
       n_events++;
     } else {
@@ -540,20 +625,34 @@ session_poll(gallus_session_t s[], int n, int timeout) {
   return ret;
 }
 
-gallus_result_t
-session_accept(gallus_session_t s1, gallus_session_t *s2) {
+static gallus_result_t
+s_accept(gallus_session_t s1, gallus_session_t *s2, bool nonblocking) {
   int sock;
+  int val;
   struct sockaddr_storage ss = {0,0,{0}};
   socklen_t ss_len = sizeof(ss);
   session_type_t t;
   gallus_result_t ret;
 
+  if (s1 == NULL || s2 == NULL) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
   sock = accept(s1->sock, (struct sockaddr *) &ss, &ss_len);
   if (sock  < 0) {
+    if (nonblocking == true &&
+        (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      return GALLUS_RESULT_NO_MORE_ACTION;
+    }
     gallus_msg_warning("accept error.\n");
     return GALLUS_RESULT_POSIX_API_ERROR;
   }
 
+  if (nonblocking == true) {
+    val = 1;
+    ioctl(sock, FIONBIO, &val);
+  }
+
   t = ((s1->session_type
         & (unsigned int) ~(SESSION_PASSIVE|SESSION_ACTIVE)) | SESSION_ACCEPTED);
   ret = session_create(t, s2);
@@ -564,7 +663,35 @@ session_accept(gallus_session_t s1, gallus_session_t *s2) {
   (*s2)->sock = sock;
 
   if (s1->accept != NULL) {
-    return s1->accept(s1, s2);
+    ret = s1->accept(s1, s2);
+    if (ret != GALLUS_RESULT_OK && ret != GALLUS_RESULT_EINPROGRESS) {
+      session_destroy(*s2);
+      *s2 = NULL;
+    }
+    return ret;
+  }
+
+  return GALLUS_RESULT_OK;
+}
+
+gallus_result_t
+session_accept(gallus_session_t s1, gallus_session_t *s2) {
+  return s_accept(s1, s2, false);
+}
+
+gallus_result_t
+session_accept_nonblocking(gallus_session_t s1, gallus_session_t *s2) {
+  return s_accept(s1, s2, true);
+}
+
+gallus_result_t
+session_handshake(gallus_session_t s) {
+  if (s == NULL) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  if (s->handshake != NULL) {
+    return s->handshake(s);
   }
 
   return GALLUS_RESULT_OK;
@@ -689,6 +816,15 @@ session_read(gallus_session_t s, void *buf, size_t n) {
     return -1;
   }
 
+  /*
+   * In a fiber, park it until the socket is readable instead of
+   * blocking the carrier thread.
+   */
+  if (gallus_fiber_self() != NULL && s->sock >= 0 &&
+      (s->pending == NULL || s->pending(s) == 0)) {
+    (void)gallus_fiber_wait_fd(s->sock, POLLIN, -1LL);
+  }
+
   return s->read(s, buf, n);
 }
 
@@ -699,9 +835,68 @@ session_write(gallus_session_t s, void *buf, size_t n) {
     return -1;
   }
 
+  if (gallus_fiber_self() != NULL && s->sock >= 0) {
+    (void)gallus_fiber_wait_fd(s->sock, POLLOUT, -1LL);
+  }
+
   return s->write(s, buf, n);
 }
 
+ssize_t
+session_writev(gallus_session_t s, const struct iovec *iov, int iovcnt) {
+  if (s == NULL || s->write == NULL || iov == NULL || iovcnt < 0) {
+    gallus_msg_warning("session_writev: invalid args.\n");
+    return -1;
+  }
+
+  if (gallus_fiber_self() != NULL && s->sock >= 0) {
+    (void)gallus_fiber_wait_fd(s->sock, POLLOUT, -1LL);
+  }
+
+  if (s->writev != NULL) {
+    return s->writev(s, iov, (iovcnt > IOV_MAX) ? IOV_MAX : iovcnt);
+  }
+  return writev_default(s, iov, iovcnt);
+}
+
+ssize_t
+session_write_dstring(gallus_session_t s, gallus_dstring_t *ds) {
+  struct iovec iovs[MAX_IOVS];
+  struct iovec *iov = iovs;
+  gallus_result_t n;
+  ssize_t ret;
+
+  if (s == NULL || s->write == NULL) {
+    gallus_msg_warning("session_write_dstring: invalid args.\n");
+    return -1;
+  }
+
+  n = gallus_dstring_iovec_get(ds, iovs, MAX_IOVS);
+  if (n <= 0) {
+    return (n == 0) ? 0 : -1;
+  }
+  if (n > MAX_IOVS) {
+    iov = (struct iovec *)
+          GALLUS_MALLOC(SESSION, sizeof(struct iovec) * (size_t) n);
+    if (iov == NULL) {
+      return -1;
+    }
+    (void)gallus_dstring_iovec_get(ds, iov, (size_t) n);
+  }
+
+  if (gallus_fiber_self() != NULL && s->sock >= 0) {
+    (void)gallus_fiber_wait_fd(s->sock, POLLOUT, -1LL);
+  }
+
+  ret = writevn(s, iov, (int) n);
+
+  if (iov != iovs) {
+    GALLUS_FREE(SESSION, iov);
+  }
+
+  return ret;
+}
+
 int
 session_sockfd_get(gallus_session_t s) {
   return s->sock;
@@ -719,6 +914,7 @@ void
 session_write_set(gallus_session_t s, ssize_t (*writep)(gallus_session_t ,
                   void *, size_t)) {
   s->write = writep;
+  s->writev = NULL;
 }
 
 char *
@@ -0,0 +1,573 @@
+#include "gallus_apis.h"
+#include "gallus_session.h"
+#include "session_internal.h"
+
+
+
+
+
+/*
+ * Pipelined request channel. Every frame is a SESSION_CHANNEL_HEADER_SIZE
+ * byte header (a 32 bit tag and a 32 bit payload length, both in the
+ * network byte order) followed by the payload; a response carries the
+ * tag of its request. The tag is a slot index in the lower 16 bits and
+ * a per slot sequence number in the upper 16 bits, so a late response
+ * to a timed out request is never matched to the next user of the slot.
+ *
+ * There is no receiver thread: a requester waiting for its response
+ * becomes the reader if no one else is reading, and dispatches every
+ * frame it receives to the slot named by the tag.
+ *
+ * The session is switched to non-blocking: the reader of a TLS session
+ * holds m_io_lck across SSL_read(), and must not sit there on a
+ * partial record while the writers wait for it.
+ */
+
+
+#define MAX_SLOTS		65536
+#define READER_POLL_TIMEOUT	100	/* msec */
+#define RX_BUFSIZ		(SESSION_BUFSIZ * 4)
+
+
+#define TAG_IDX(tag)		((tag) & 0xffffU)
+#define TAG_SEQ(tag)		((tag) >> 16)
+#define TAG_MAKE(seq, idx)	((((uint32_t)(seq)) << 16) | (uint32_t)(idx))
+
+
+
+
+
+typedef struct channel_slot_record {
+  uint16_t m_seq;
+  bool m_is_used;
+  bool m_is_done;
+  bool m_is_abandoned;
+  gallus_result_t m_result;
+  void *m_buf;
+  size_t m_size;
+  size_t m_len;
+} channel_slot_record;
+
+
+typedef struct session_channel_record {
+  gallus_session_t m_ses;
+  bool m_is_tls;
+
+  gallus_mutex_t m_lck;		/* slots, reader election, rx state */
+  gallus_cond_t m_cnd;
+  gallus_mutex_t m_wr_lck;	/* keeps a frame contiguous */
+  gallus_mutex_t m_io_lck;	/* serializes SSL_read/SSL_write */
+
+  gallus_result_t m_err;		/* sticky, once the stream broke */
+  bool m_has_reader;
+
+  size_t m_n_slots;
+  size_t m_n_free;
+  size_t *m_free_idx;
+  channel_slot_record *m_slots;
+
+  /*
+   * Receive state, owned by the current reader.
+   */
+  uint8_t m_hdr[SESSION_CHANNEL_HEADER_SIZE];
+  size_t m_hdr_len;
+  channel_slot_record *m_rx_slot;	/* NULL: discard the payload. */
+  size_t m_rx_len;
+  size_t m_rx_off;
+  uint8_t m_rx_buf[RX_BUFSIZ];
+} session_channel_record;
+
+
+
+
+
+static inline void
+s_slot_free(session_channel_record *ch, channel_slot_record *sl) {
+  sl->m_is_used = false;
+  sl->m_is_done = false;
+  sl->m_is_abandoned = false;
+  sl->m_buf = NULL;
+  ch->m_free_idx[ch->m_n_free++] = (size_t)(sl - ch->m_slots);
+}
+
+
+/*
+ * Called with m_lck held.
+ */
+static inline void
+s_slot_complete(session_channel_record *ch, channel_slot_record *sl,
+                gallus_result_t result) {
+  if (sl->m_is_abandoned == true) {
+    s_slot_free(ch, sl);
+  } else {
+    sl->m_result = result;
+    sl->m_is_done = true;
+  }
+}
+
+
+/*
+ * Called with m_lck held.
+ */
+static void
+s_break(session_channel_record *ch, gallus_result_t err) {
+  size_t i;
+
+  if (ch->m_err != GALLUS_RESULT_OK) {
+    return;
+  }
+
+  gallus_perror(err);
+  ch->m_err = err;
+  for (i = 0; i < ch->m_n_slots; i++) {
+    if (ch->m_slots[i].m_is_used == true &&
+        ch->m_slots[i].m_is_done == false) {
+      s_slot_complete(ch, &ch->m_slots[i], err);
+    }
+  }
+  (void)gallus_cond_notify(&ch->m_cnd, true);
+}
+
+
+static inline int
+s_poll_fd(gallus_session_t s, short events, int msec) {
+  struct pollfd pfd;
+
+  pfd.fd = s->sock;
+  pfd.events = events;
+  pfd.revents = 0;
+
+  return poll(&pfd, 1, msec);
+}
+
+
+static inline ssize_t
+s_io(session_channel_record *ch, void *buf, size_t n, bool is_write) {
+  ssize_t r;
+
+  if (ch->m_is_tls == true) {
+    (void)gallus_mutex_lock(&ch->m_io_lck);
+  }
+  r = (is_write == true) ?
+      session_write(ch->m_ses, buf, n) : session_read(ch->m_ses, buf, n);
+  if (ch->m_is_tls == true) {
+    (void)gallus_mutex_unlock(&ch->m_io_lck);
+  }
+
+  return r;
+}
+
+
+/*
+ * A frame, once started, has to go out whole; only a broken stream
+ * stops it.
+ */
+static gallus_result_t
+s_write_full(session_channel_record *ch, const uint8_t *buf, size_t len) {
+  ssize_t n;
+
+  while (len > 0) {
+    n = s_io(ch, (void *)buf, len, true);
+    if (n > 0) {
+      buf += n;
+      len -= (size_t)n;
+    } else if (n == 0 ||
+               errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      if (s_poll_fd(ch->m_ses, POLLOUT, READER_POLL_TIMEOUT) < 0 &&
+          errno != EINTR) {
+        return GALLUS_RESULT_POSIX_API_ERROR;
+      }
+    } else {
+      return GALLUS_RESULT_SOCKET_ERROR;
+    }
+  }
+
+  return GALLUS_RESULT_OK;
+}
+
+
+/*
+ * Called with m_lck held.
+ */
+static void
+s_feed(session_channel_record *ch, const uint8_t *p, size_t len) {
+  channel_slot_record *sl;
+  uint32_t tag, plen;
+  size_t n, idx;
+
+  while (len > 0) {
+    if (ch->m_hdr_len < SESSION_CHANNEL_HEADER_SIZE) {
+      n = SESSION_CHANNEL_HEADER_SIZE - ch->m_hdr_len;
+      if (n > len) {
+        n = len;
+      }
+      memcpy(ch->m_hdr + ch->m_hdr_len, p, n);
+      ch->m_hdr_len += n;
+      p += n;
+      len -= n;
+      if (ch->m_hdr_len < SESSION_CHANNEL_HEADER_SIZE) {
+        break;
+      }
+
+      memcpy(&tag, ch->m_hdr, sizeof(tag));
+      memcpy(&plen, ch->m_hdr + sizeof(tag), sizeof(plen));
+      tag = ntohl(tag);
+      plen = ntohl(plen);
+      idx = TAG_IDX(tag);
+
+      ch->m_rx_slot = NULL;
+      ch->m_rx_len = plen;
+      ch->m_rx_off = 0;
+      if (idx < ch->m_n_slots) {
+        sl = &ch->m_slots[idx];
+        if (sl->m_is_used == true && sl->m_is_done == false &&
+            sl->m_seq == (uint16_t)TAG_SEQ(tag)) {
+          ch->m_rx_slot = sl;
+          sl->m_len = plen;
+        }
+      }
+      if (ch->m_rx_slot == NULL) {
+        gallus_msg_warning("discard an unmatched response (tag 0x%08x).\n",
+                           tag);
+      }
+    } else {
+      n = ch->m_rx_len - ch->m_rx_off;
+      if (n > len) {
+        n = len;
+      }
+      sl = ch->m_rx_slot;
+      if (sl != NULL && sl->m_is_abandoned == false &&
+          ch->m_rx_off < sl->m_size) {
+        memcpy((uint8_t *)sl->m_buf + ch->m_rx_off, p,
+               (ch->m_rx_off + n <= sl->m_size) ?
+               n : sl->m_size - ch->m_rx_off);
+      }
+      ch->m_rx_off += n;
+      p += n;
+      len -= n;
+    }
+
+    if (ch->m_hdr_len == SESSION_CHANNEL_HEADER_SIZE &&
+        ch->m_rx_off == ch->m_rx_len) {
+      sl = ch->m_rx_slot;
+      if (sl != NULL) {
+        s_slot_complete(ch, sl, (sl->m_len <= sl->m_size) ?
+                        GALLUS_RESULT_OK : GALLUS_RESULT_TOO_LARGE);
+        (void)gallus_cond_notify(&ch->m_cnd, true);
+      }
+      ch->m_hdr_len = 0;
+      ch->m_rx_slot = NULL;
+    }
+  }
+}
+
+
+/*
+ * Runs on the elected reader without m_lck held: wait for the
+ * session up to msec and dispatch whatever has arrived.
+ */
+static gallus_result_t
+s_read_some(session_channel_record *ch, int msec) {
+  gallus_session_t s = ch->m_ses;
+  ssize_t n;
+  int r;
+
+  if (s->pending == NULL || s->pending(s) == 0) {
+    r = s_poll_fd(s, POLLIN, msec);
+    if (r == 0 || (r < 0 && errno == EINTR)) {
+      return GALLUS_RESULT_OK;
+    } else if (r < 0) {
+      return GALLUS_RESULT_POSIX_API_ERROR;
+    }
+  }
+
+  while (true) {
+    n = s_io(ch, ch->m_rx_buf, sizeof(ch->m_rx_buf), false);
+    if (n > 0) {
+      (void)gallus_mutex_lock(&ch->m_lck);
+      {
+        s_feed(ch, ch->m_rx_buf, (size_t)n);
+      }
+      (void)gallus_mutex_unlock(&ch->m_lck);
+      /*
+       * A full buffer does not tell that more has arrived; read on
+       * only what the TLS layer already holds, and poll for the rest.
+       */
+      if (s->pending == NULL || s->pending(s) == 0) {
+        break;
+      }
+    } else if (n == 0) {
+      return GALLUS_RESULT_EOF;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      break;
+    } else {
+      return GALLUS_RESULT_SOCKET_ERROR;
+    }
+  }
+
+  return GALLUS_RESULT_OK;
+}
+
+
+static inline int
+s_wait_msec(gallus_chrono_t deadline) {
+  gallus_chrono_t rest;
+
+  if (deadline < 0) {
+    return READER_POLL_TIMEOUT;
+  }
+  rest = (deadline - gallus_chrono_now()) / (1000LL * 1000LL);
+  if (rest <= 0) {
+    return 0;
+  }
+
+  return (rest < READER_POLL_TIMEOUT) ? (int)rest : READER_POLL_TIMEOUT;
+}
+
+
+
+
+
+gallus_result_t
+session_channel_create(gallus_session_t s, size_t max_inflight,
+                       gallus_session_channel_t *chptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  session_channel_record *ch = NULL;
+  size_t i;
+  int val;
+
+  if (s == NULL || chptr == NULL || s->sock < 0 ||
+      max_inflight == 0 || max_inflight > MAX_SLOTS) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  *chptr = NULL;
+
+  val = 1;
+  if (ioctl(s->sock, FIONBIO, &val) != 0) {
+    ret = GALLUS_RESULT_POSIX_API_ERROR;
+    gallus_perror(ret);
+    return ret;
+  }
+
+  ch = (session_channel_record *)GALLUS_CALLOC(SESSION, 1, sizeof(*ch));
+  if (ch == NULL) {
+    return GALLUS_RESULT_NO_MEMORY;
+  }
+  ch->m_slots = (channel_slot_record *)
+                GALLUS_CALLOC(SESSION, max_inflight,
+                              sizeof(channel_slot_record));
+  ch->m_free_idx = (size_t *)GALLUS_CALLOC(SESSION, max_inflight,
+                                           sizeof(size_t));
+  if (ch->m_slots == NULL || ch->m_free_idx == NULL) {
+    ret = GALLUS_RESULT_NO_MEMORY;
+    goto done;
+  }
+
+  ch->m_ses = s;
+  ch->m_is_tls = session_type_is_tls(s->session_type);
+  ch->m_err = GALLUS_RESULT_OK;
+  ch->m_n_slots = max_inflight;
+  ch->m_n_free = 0;
+  for (i = max_inflight; i > 0; i--) {
+    ch->m_free_idx[ch->m_n_free++] = i - 1;
+  }
+
+  if ((ret = gallus_mutex_create(&ch->m_lck)) != GALLUS_RESULT_OK ||
+      (ret = gallus_cond_create(&ch->m_cnd)) != GALLUS_RESULT_OK ||
+      (ret = gallus_mutex_create(&ch->m_wr_lck)) != GALLUS_RESULT_OK ||
+      (ret = gallus_mutex_create(&ch->m_io_lck)) != GALLUS_RESULT_OK) {
+    goto done;
+  }
+
+  session_event_clear(s);
+
+done:
+  if (ret == GALLUS_RESULT_OK) {
+    *chptr = ch;
+  } else {
+    gallus_perror(ret);
+    session_channel_destroy(&ch);
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+session_channel_request(gallus_session_channel_t *chptr,
+                        const void *req, size_t req_len,
+                        void *resp, size_t resp_size,
+                        size_t *resp_len,
+                        gallus_chrono_t to) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  session_channel_record *ch;
+  channel_slot_record *sl = NULL;
+  gallus_chrono_t deadline, rest;
+  uint8_t frame[SESSION_BUFSIZ];
+  uint32_t tag, len;
+
+  if (chptr == NULL || (ch = *chptr) == NULL ||
+      (req == NULL && req_len > 0) || req_len > UINT32_MAX ||
+      (resp == NULL && resp_size > 0)) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  deadline = (to < 0) ? -1LL : gallus_chrono_now() + to;
+
+  /*
+   * Take a slot.
+   */
+  (void)gallus_mutex_lock(&ch->m_lck);
+  {
+    while (ch->m_n_free == 0 && ch->m_err == GALLUS_RESULT_OK) {
+      rest = (deadline < 0) ? -1LL : deadline - gallus_chrono_now();
+      if (deadline >= 0 && rest <= 0) {
+        ret = GALLUS_RESULT_TIMEDOUT;
+        break;
+      }
+      ret = gallus_cond_wait(&ch->m_cnd, &ch->m_lck, rest);
+      if (ret != GALLUS_RESULT_OK && ret != GALLUS_RESULT_TIMEDOUT) {
+        break;
+      }
+    }
+    if (ch->m_err != GALLUS_RESULT_OK) {
+      ret = ch->m_err;
+    } else if (ch->m_n_free > 0) {
+      sl = &ch->m_slots[ch->m_free_idx[--ch->m_n_free]];
+      sl->m_is_used = true;
+      sl->m_is_done = false;
+      sl->m_is_abandoned = false;
+      sl->m_seq++;
+      sl->m_buf = resp;
+      sl->m_size = resp_size;
+      sl->m_len = 0;
+      ret = GALLUS_RESULT_OK;
+    }
+  }
+  (void)gallus_mutex_unlock(&ch->m_lck);
+
+  if (ret != GALLUS_RESULT_OK) {
+    return ret;
+  }
+
+  /*
+   * Send the request. Small ones go out in a single write.
+   */
+  tag = htonl(TAG_MAKE(sl->m_seq, sl - ch->m_slots));
+  len = htonl((uint32_t)req_len);
+  memcpy(frame, &tag, sizeof(tag));
+  memcpy(frame + sizeof(tag), &len, sizeof(len));
+
+  (void)gallus_mutex_lock(&ch->m_wr_lck);
+  {
+    if (req_len <= sizeof(frame) - SESSION_CHANNEL_HEADER_SIZE) {
+      if (req_len > 0) {
+        memcpy(frame + SESSION_CHANNEL_HEADER_SIZE, req, req_len);
+      }
+      ret = s_write_full(ch, frame, SESSION_CHANNEL_HEADER_SIZE + req_len);
+    } else {
+      ret = s_write_full(ch, frame, SESSION_CHANNEL_HEADER_SIZE);
+      if (ret == GALLUS_RESULT_OK) {
+        ret = s_write_full(ch, (const uint8_t *)req, req_len);
+      }
+    }
+  }
+  (void)gallus_mutex_unlock(&ch->m_wr_lck);
+
+  /*
+   * Wait for the response, reading on behalf of the others while no
+   * one else does.
+   */
+  (void)gallus_mutex_lock(&ch->m_lck);
+  {
+    if (ret != GALLUS_RESULT_OK) {
+      s_break(ch, ret);
+    }
+
+    while (sl->m_is_done == false) {
+      rest = (deadline < 0) ? -1LL : deadline - gallus_chrono_now();
+      if (deadline >= 0 && rest <= 0) {
+        break;
+      }
+
+      if (ch->m_has_reader == false) {
+        ch->m_has_reader = true;
+        (void)gallus_mutex_unlock(&ch->m_lck);
+
+        ret = s_read_some(ch, s_wait_msec(deadline));
+
+        (void)gallus_mutex_lock(&ch->m_lck);
+        ch->m_has_reader = false;
+        if (ret != GALLUS_RESULT_OK) {
+          s_break(ch, ret);
+        }
+        /* hand over the reader role. */
+        (void)gallus_cond_notify(&ch->m_cnd, true);
+      } else {
+        (void)gallus_cond_wait(&ch->m_cnd, &ch->m_lck, rest);
+      }
+    }
+
+    if (sl->m_is_done == true) {
+      ret = sl->m_result;
+      if (resp_len != NULL) {
+        *resp_len = sl->m_len;
+      }
+      s_slot_free(ch, sl);
+    } else {
+      /*
+       * The reader frees the slot when the response shows up.
+       */
+      sl->m_is_abandoned = true;
+      ret = GALLUS_RESULT_TIMEDOUT;
+    }
+    (void)gallus_cond_notify(&ch->m_cnd, true);
+  }
+  (void)gallus_mutex_unlock(&ch->m_lck);
+
+  return ret;
+}
+
+
+gallus_result_t
+session_channel_get_error(gallus_session_channel_t *chptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (chptr != NULL && *chptr != NULL) {
+    (void)gallus_mutex_lock(&(*chptr)->m_lck);
+    {
+      ret = (*chptr)->m_err;
+    }
+    (void)gallus_mutex_unlock(&(*chptr)->m_lck);
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+void
+session_channel_destroy(gallus_session_channel_t *chptr) {
+  session_channel_record *ch;
+
+  if (chptr != NULL && (ch = *chptr) != NULL) {
+    if (ch->m_io_lck != NULL) {
+      gallus_mutex_destroy(&ch->m_io_lck);
+    }
+    if (ch->m_wr_lck != NULL) {
+      gallus_mutex_destroy(&ch->m_wr_lck);
+    }
+    if (ch->m_cnd != NULL) {
+      gallus_cond_destroy(&ch->m_cnd);
+    }
+    if (ch->m_lck != NULL) {
+      gallus_mutex_destroy(&ch->m_lck);
+    }
+    GALLUS_FREE(SESSION, ch->m_free_idx);
+    GALLUS_FREE(SESSION, ch->m_slots);
+    GALLUS_FREE(SESSION, ch);
+    *chptr = NULL;
+  }
+}
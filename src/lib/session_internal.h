@@ -10,6 +10,7 @@ struct session {
   int type;
   int protocol;
   session_type_t session_type;
+  bool reuseport; /* SO_REUSEPORT on bind, for listener groups */
   short events; /* for session_event_poll */
   short revents; /* for session_event_poll */
   struct session_buf {
@@ -23,9 +24,12 @@ struct session {
   gallus_result_t (*accept)(gallus_session_t s1, gallus_session_t *s2);
   ssize_t (*read)(gallus_session_t, void *, size_t);
   ssize_t (*write)(gallus_session_t, void *, size_t);
+  ssize_t (*writev)(gallus_session_t, const struct iovec *, int);
   void (*close)(gallus_session_t);
   void (*destroy)(gallus_session_t);
   gallus_result_t (*connect_check)(gallus_session_t);
+  gallus_result_t (*handshake)(gallus_session_t);
+  size_t (*pending)(gallus_session_t); /* bytes buffered below read() */
   /* protocol depended context object */
   void *ctx;
 };
@@ -0,0 +1,476 @@
+#include "gallus_apis.h"
+#include "gallus_session.h"
+#include "gallus_thread_internal.h"
+#include "session_internal.h"
+
+
+
+
+
+/*
+ * SO_REUSEPORT listener group: every worker owns its own passive
+ * socket and its own poll loop, so accept(2) and the TLS handshakes
+ * scale with the number of workers instead of serializing behind a
+ * single listener.
+ */
+
+
+#define MAX_PENDING_HANDSHAKES	1023
+#define DEFAULT_HANDSHAKE_TIMEOUT	(10LL * 1000LL * 1000LL * 1000LL)
+#define WORKER_POLL_TIMEOUT	100	/* msec */
+
+
+
+
+
+typedef struct listener_worker_record {
+  gallus_thread_record m_thd;	/* must be on the head. */
+
+  struct session_listener_group_record *m_grp;
+  size_t m_idx;
+  bool m_do_loop;		/* by the gallus_atomic_*(). */
+
+  /*
+   * m_ses[0] is the listener, m_ses[1 .. m_n_ses - 1] are the
+   * sessions in handshake.
+   */
+  size_t m_n_ses;
+  gallus_session_t m_ses[MAX_PENDING_HANDSHAKES + 1];
+  gallus_chrono_t m_deadlines[MAX_PENDING_HANDSHAKES + 1];
+} listener_worker_record;
+typedef listener_worker_record *listener_worker_t;
+
+
+typedef struct session_listener_group_record {
+  gallus_mutex_t m_lck;
+  session_type_t m_type;
+  size_t m_n_workers;
+  gallus_session_accept_proc_t m_proc;
+  void *m_arg;
+  gallus_chrono_t m_handshake_timeout;
+  bool m_is_started;
+  listener_worker_t *m_workers;
+} session_listener_group_record;
+
+
+
+
+
+static inline void
+s_remove_pending(listener_worker_t w, size_t i) {
+  w->m_n_ses--;
+  w->m_ses[i] = w->m_ses[w->m_n_ses];
+  w->m_deadlines[i] = w->m_deadlines[w->m_n_ses];
+  w->m_ses[w->m_n_ses] = NULL;
+}
+
+
+static inline void
+s_deliver(listener_worker_t w, gallus_session_t s) {
+  gallus_result_t r;
+
+  session_event_clear(s);
+  r = w->m_grp->m_proc(s, w->m_grp->m_arg);
+  if (r != GALLUS_RESULT_OK) {
+    session_destroy(s);
+  }
+}
+
+
+static inline void
+s_accept_all(listener_worker_t w, gallus_chrono_t now) {
+  gallus_result_t r;
+  gallus_session_t s;
+
+  while (w->m_n_ses <= MAX_PENDING_HANDSHAKES) {
+    s = NULL;
+    r = session_accept_nonblocking(w->m_ses[0], &s);
+    if (r == GALLUS_RESULT_OK) {
+      s_deliver(w, s);
+    } else if (r == GALLUS_RESULT_EINPROGRESS) {
+      w->m_ses[w->m_n_ses] = s;
+      w->m_deadlines[w->m_n_ses] = now + w->m_grp->m_handshake_timeout;
+      w->m_n_ses++;
+    } else if (r == GALLUS_RESULT_NO_MORE_ACTION) {
+      break;
+    } else {
+      gallus_perror(r);
+      if (r == GALLUS_RESULT_POSIX_API_ERROR) {
+        break;
+      }
+    }
+  }
+}
+
+
+static inline void
+s_step_handshakes(listener_worker_t w, gallus_chrono_t now) {
+  gallus_result_t r;
+  gallus_session_t s;
+  size_t i;
+
+  /*
+   * Walk backward so that s_remove_pending() only moves already
+   * visited entries.
+   */
+  for (i = w->m_n_ses - 1; i >= 1; i--) {
+    s = w->m_ses[i];
+    if (s->revents != 0) {
+      r = session_handshake(s);
+      if (r == GALLUS_RESULT_OK) {
+        s_remove_pending(w, i);
+        s_deliver(w, s);
+      } else if (r != GALLUS_RESULT_EINPROGRESS) {
+        s_remove_pending(w, i);
+        session_destroy(s);
+      }
+    } else if (now >= w->m_deadlines[i]) {
+      gallus_msg_warning("listener %zu: handshake timedout.\n", w->m_idx);
+      s_remove_pending(w, i);
+      session_destroy(s);
+    }
+  }
+}
+
+
+static gallus_result_t
+s_worker_main(const gallus_thread_t *tptr, void *arg) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  listener_worker_t w;
+
+  (void)arg;
+
+  if (likely(tptr != NULL &&
+             (w = (listener_worker_t)*tptr) != NULL)) {
+    gallus_session_t l = w->m_ses[0];
+    gallus_chrono_t now;
+
+    while (gallus_atomic_load(&(w->m_do_loop), RELAXED) == true) {
+      /*
+       * Stop accepting while the pending table is full; the kernel
+       * backlog keeps the rest.
+       */
+      if (w->m_n_ses <= MAX_PENDING_HANDSHAKES) {
+        session_read_event_set(l);
+      } else {
+        session_read_event_unset(l);
+      }
+
+      ret = session_poll(w->m_ses, (int)w->m_n_ses, WORKER_POLL_TIMEOUT);
+      if (ret < 0 &&
+          ret != GALLUS_RESULT_TIMEDOUT &&
+          ret != GALLUS_RESULT_INTERRUPTED) {
+        gallus_perror(ret);
+        break;
+      }
+
+      now = gallus_chrono_now();
+      s_step_handshakes(w, now);
+      if ((l->revents & POLLIN) != 0) {
+        s_accept_all(w, now);
+      }
+    }
+
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+static void
+s_worker_finalize(const gallus_thread_t *tptr, bool is_canceled,
+                  void *arg) {
+  listener_worker_t w;
+
+  (void)is_canceled;
+  (void)arg;
+
+  if (likely(tptr != NULL &&
+             (w = (listener_worker_t)*tptr) != NULL)) {
+    while (w->m_n_ses > 1) {
+      w->m_n_ses--;
+      session_destroy(w->m_ses[w->m_n_ses]);
+      w->m_ses[w->m_n_ses] = NULL;
+    }
+  }
+}
+
+
+static void
+s_worker_freeup(const gallus_thread_t *tptr, void *arg) {
+  listener_worker_t w;
+
+  (void)arg;
+
+  if (likely(tptr != NULL &&
+             (w = (listener_worker_t)*tptr) != NULL)) {
+    if (w->m_ses[0] != NULL) {
+      session_destroy(w->m_ses[0]);
+      w->m_ses[0] = NULL;
+    }
+  }
+}
+
+
+static gallus_result_t
+s_worker_create(listener_worker_t *wptr,
+                session_listener_group_record *g,
+                size_t idx,
+                gallus_ip_address_t *addr,
+                uint16_t port) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  listener_worker_t w = NULL;
+  gallus_session_t l = NULL;
+  char name[16];
+  int val;
+
+  ret = session_create(g->m_type, &l);
+  if (ret != GALLUS_RESULT_OK) {
+    gallus_perror(ret);
+    goto done;
+  }
+  l->reuseport = true;
+
+  ret = session_bind(l, addr, port);
+  if (ret != GALLUS_RESULT_OK) {
+    gallus_perror(ret);
+    session_destroy(l);
+    goto done;
+  }
+
+  val = 1;
+  if (ioctl(l->sock, FIONBIO, &val) != 0) {
+    ret = GALLUS_RESULT_POSIX_API_ERROR;
+    gallus_perror(ret);
+    session_destroy(l);
+    goto done;
+  }
+
+  snprintf(name, sizeof(name), "listener:%u", (unsigned int)(idx & 0xffff));
+  ret = gallus_thread_create_with_size((gallus_thread_t *)&w,
+                                        sizeof(*w),
+                                        s_worker_main,
+                                        s_worker_finalize,
+                                        s_worker_freeup,
+                                        name, NULL);
+  if (ret != GALLUS_RESULT_OK) {
+    gallus_perror(ret);
+    session_destroy(l);
+    goto done;
+  }
+
+  w->m_grp = g;
+  w->m_idx = idx;
+  w->m_do_loop = false;
+  w->m_n_ses = 1;
+  w->m_ses[0] = l;
+  w->m_deadlines[0] = 0;
+  *wptr = w;
+
+done:
+  return ret;
+}
+
+
+static inline void
+s_group_stop(session_listener_group_record *g) {
+  size_t i;
+
+  if (g->m_is_started == false) {
+    return;
+  }
+
+  for (i = 0; i < g->m_n_workers; i++) {
+    gallus_atomic_store(&(g->m_workers[i]->m_do_loop), false, RELAXED);
+  }
+  for (i = 0; i < g->m_n_workers; i++) {
+    (void)gallus_thread_wait((gallus_thread_t *)&g->m_workers[i], -1LL);
+  }
+
+  g->m_is_started = false;
+}
+
+
+
+
+
+gallus_result_t
+session_listener_group_create(session_type_t session_type,
+                              gallus_ip_address_t *addr,
+                              uint16_t port,
+                              size_t n_workers,
+                              gallus_session_accept_proc_t proc,
+                              void *arg,
+                              gallus_session_listener_group_t *gptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  session_listener_group_record *g = NULL;
+  size_t i;
+
+  if (gptr == NULL || addr == NULL || port == 0 ||
+      n_workers == 0 || proc == NULL ||
+      (session_type & SESSION_PASSIVE) == 0) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  *gptr = NULL;
+
+  g = (session_listener_group_record *)GALLUS_CALLOC(SESSION, 1, sizeof(*g));
+  if (g == NULL) {
+    return GALLUS_RESULT_NO_MEMORY;
+  }
+  g->m_workers = (listener_worker_t *)GALLUS_CALLOC(SESSION, n_workers,
+                 sizeof(listener_worker_t));
+  if (g->m_workers == NULL) {
+    GALLUS_FREE(SESSION, g);
+    return GALLUS_RESULT_NO_MEMORY;
+  }
+
+  ret = gallus_mutex_create(&g->m_lck);
+  if (ret != GALLUS_RESULT_OK) {
+    gallus_perror(ret);
+    GALLUS_FREE(SESSION, g->m_workers);
+    GALLUS_FREE(SESSION, g);
+    return ret;
+  }
+
+  g->m_type = session_type;
+  g->m_proc = proc;
+  g->m_arg = arg;
+  g->m_handshake_timeout = DEFAULT_HANDSHAKE_TIMEOUT;
+  g->m_is_started = false;
+
+  /*
+   * Bind all the sockets here so that address errors are reported
+   * synchronously.
+   */
+  for (i = 0; i < n_workers; i++) {
+    ret = s_worker_create(&g->m_workers[i], g, i, addr, port);
+    if (ret != GALLUS_RESULT_OK) {
+      break;
+    }
+    g->m_n_workers++;
+  }
+
+  if (ret == GALLUS_RESULT_OK) {
+    *gptr = g;
+  } else {
+    session_listener_group_destroy(&g);
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+session_listener_group_set_handshake_timeout(
+    gallus_session_listener_group_t *gptr,
+    gallus_chrono_t nsec) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(gptr != NULL && *gptr != NULL && nsec > 0)) {
+    (void)gallus_mutex_lock(&(*gptr)->m_lck);
+    {
+      if ((*gptr)->m_is_started == false) {
+        (*gptr)->m_handshake_timeout = nsec;
+        ret = GALLUS_RESULT_OK;
+      } else {
+        ret = GALLUS_RESULT_BUSY;
+      }
+    }
+    (void)gallus_mutex_unlock(&(*gptr)->m_lck);
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+session_listener_group_start(gallus_session_listener_group_t *gptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  session_listener_group_record *g;
+  size_t i;
+
+  if (likely(gptr != NULL && (g = *gptr) != NULL)) {
+    (void)gallus_mutex_lock(&g->m_lck);
+    {
+      if (g->m_is_started == false) {
+        for (i = 0; i < g->m_n_workers; i++) {
+          /*
+           * The thread creation orders it.
+           */
+          g->m_workers[i]->m_do_loop = true;
+        }
+        for (i = 0; i < g->m_n_workers; i++) {
+          ret = gallus_thread_start((gallus_thread_t *)&g->m_workers[i],
+                                     false);
+          if (ret != GALLUS_RESULT_OK) {
+            gallus_perror(ret);
+            break;
+          }
+        }
+        g->m_is_started = true;
+        if (ret != GALLUS_RESULT_OK) {
+          /*
+           * Workers not started yet just see m_do_loop cleared.
+           */
+          s_group_stop(g);
+        }
+      } else {
+        ret = GALLUS_RESULT_ALREADY_EXISTS;
+      }
+    }
+    (void)gallus_mutex_unlock(&g->m_lck);
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+session_listener_group_stop(gallus_session_listener_group_t *gptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  session_listener_group_record *g;
+
+  if (likely(gptr != NULL && (g = *gptr) != NULL)) {
+    (void)gallus_mutex_lock(&g->m_lck);
+    {
+      s_group_stop(g);
+      ret = GALLUS_RESULT_OK;
+    }
+    (void)gallus_mutex_unlock(&g->m_lck);
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+void
+session_listener_group_destroy(gallus_session_listener_group_t *gptr) {
+  session_listener_group_record *g;
+  size_t i;
+
+  if (likely(gptr != NULL && (g = *gptr) != NULL)) {
+    (void)gallus_mutex_lock(&g->m_lck);
+    {
+      s_group_stop(g);
+      for (i = 0; i < g->m_n_workers; i++) {
+        gallus_thread_destroy((gallus_thread_t *)&g->m_workers[i]);
+      }
+    }
+    (void)gallus_mutex_unlock(&g->m_lck);
+
+    gallus_mutex_destroy(&g->m_lck);
+    GALLUS_FREE(SESSION, g->m_workers);
+    GALLUS_FREE(SESSION, g);
+    *gptr = NULL;
+  }
+}
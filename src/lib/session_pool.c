@@ -0,0 +1,430 @@
+#include "gallus_apis.h"
+#include "gallus_session.h"
+#include "gallus_poolable_internal.h"
+#include "gallus_pool_internal.h"
+#include "session_internal.h"
+
+
+
+
+
+/*
+ * Session pool: one gallus_pool (GALLUS_POOL_TYPE_QUEUE) per (type,
+ * address, port) endpoint. A poolable is a connection slot; its
+ * session is (re)connected lazily on acquisition, so a slot whose
+ * connection went stale costs a reconnect, never a failed request.
+ */
+
+
+#define CONNECT_POLL_TIMEOUT	100	/* msec */
+
+
+
+
+
+typedef struct session_pool_conn_record {
+  gallus_poolable_record m_pobj;	/* must be on the head. */
+
+  gallus_session_t m_ses;
+} session_pool_conn_record;
+typedef session_pool_conn_record *session_pool_conn_t;
+
+
+typedef struct session_pool_endpoint_record {
+  gallus_pool_record m_pool;	/* must be on the head. */
+
+  session_type_t m_type;
+  gallus_ip_address_t *m_addr;
+  uint16_t m_port;
+} session_pool_endpoint_record;
+typedef session_pool_endpoint_record *session_pool_endpoint_t;
+
+
+typedef struct session_pool_record {
+  gallus_mutex_t m_lck;
+  size_t m_n_max_conns;
+  gallus_hashmap_t m_endpoints;	/* "type/addr/port" -> endpoint */
+  gallus_hashmap_t m_leases;	/* session -> conn */
+} session_pool_record;
+
+
+
+
+
+/*
+ * poolable methods
+ */
+
+
+static gallus_result_t
+s_conn_construct(gallus_poolable_t *pptr, void *carg) {
+  (void)carg;
+
+  if (likely(pptr != NULL && *pptr != NULL)) {
+    ((session_pool_conn_t)*pptr)->m_ses = NULL;
+    return GALLUS_RESULT_OK;
+  }
+
+  return GALLUS_RESULT_INVALID_ARGS;
+}
+
+
+static void
+s_conn_destruct(gallus_poolable_t *pptr) {
+  session_pool_conn_t c;
+
+  if (likely(pptr != NULL && (c = (session_pool_conn_t)*pptr) != NULL)) {
+    if (c->m_ses != NULL) {
+      session_destroy(c->m_ses);
+      c->m_ses = NULL;
+    }
+  }
+}
+
+
+static gallus_poolable_methods_record s_methods = {
+  s_conn_construct,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  s_conn_destruct
+};
+
+
+
+
+
+/*
+ * An idle pooled connection must have nothing to read: readability
+ * means either EOF from the peer or stray bytes that would be taken
+ * for the next response.
+ */
+static inline bool
+s_is_healthy(gallus_session_t s) {
+  struct pollfd pfd;
+
+  if (session_is_alive(s) == false) {
+    return false;
+  }
+  if (s->rbuf.ep != s->rbuf.rp ||
+      (s->pending != NULL && s->pending(s) > 0)) {
+    return false;
+  }
+
+  pfd.fd = s->sock;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  return (poll(&pfd, 1, 0) == 0) ? true : false;
+}
+
+
+static inline int
+s_poll_msec(gallus_chrono_t deadline) {
+  gallus_chrono_t rest;
+
+  if (deadline < 0) {
+    return CONNECT_POLL_TIMEOUT;
+  }
+  rest = (deadline - gallus_chrono_now()) / (1000LL * 1000LL);
+  if (rest <= 0) {
+    return 0;
+  }
+
+  return (rest < CONNECT_POLL_TIMEOUT) ? (int)rest : CONNECT_POLL_TIMEOUT;
+}
+
+
+static gallus_result_t
+s_connect(session_pool_endpoint_t ep, gallus_chrono_t deadline,
+          gallus_session_t *sptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_session_t s = NULL;
+  gallus_session_t sp[1];
+  gallus_result_t r;
+
+  ret = session_create(ep->m_type | SESSION_ACTIVE, &s);
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    goto done;
+  }
+
+  ret = session_connect(s, ep->m_addr, ep->m_port, NULL, 0);
+  while (ret == GALLUS_RESULT_EINPROGRESS) {
+    if (deadline >= 0 && gallus_chrono_now() >= deadline) {
+      ret = GALLUS_RESULT_TIMEDOUT;
+      break;
+    }
+
+    /*
+     * TLS sets the events its handshake waits for by itself; a plain
+     * connect(2) completes when the socket turns writable.
+     */
+    if (s->events == 0) {
+      session_write_event_set(s);
+    }
+    sp[0] = s;
+    r = session_poll(sp, 1, s_poll_msec(deadline));
+    if (r < 0 &&
+        r != GALLUS_RESULT_TIMEDOUT &&
+        r != GALLUS_RESULT_INTERRUPTED) {
+      ret = r;
+      break;
+    }
+    if (s->revents != 0) {
+      ret = session_connect_check(s);
+    }
+  }
+
+done:
+  if (ret == GALLUS_RESULT_OK) {
+    session_event_clear(s);
+    *sptr = s;
+  } else if (s != NULL) {
+    session_destroy(s);
+  }
+
+  return ret;
+}
+
+
+static void
+s_endpoint_destroy(void *arg) {
+  session_pool_endpoint_t ep = (session_pool_endpoint_t)arg;
+
+  if (ep != NULL) {
+    if (ep->m_addr != NULL) {
+      gallus_ip_address_destroy(ep->m_addr);
+      ep->m_addr = NULL;
+    }
+    gallus_pool_destroy((gallus_pool_t *)&ep);
+  }
+}
+
+
+static gallus_result_t
+s_endpoint_get(session_pool_record *sp, session_type_t type,
+               gallus_ip_address_t *addr, uint16_t port,
+               session_pool_endpoint_t *epptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  session_pool_endpoint_t ep = NULL;
+  char *astr = NULL;
+  char key[128];
+  char name[160];
+  void *v = NULL;
+
+  ret = gallus_ip_address_str_get(addr, &astr);
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    return ret;
+  }
+  snprintf(key, sizeof(key), "%x/%s/%u", (unsigned int)type, astr,
+           (unsigned int)port);
+  free(astr);
+
+  (void)gallus_mutex_lock(&sp->m_lck);
+  {
+    ret = gallus_hashmap_find(&sp->m_endpoints, key, &v);
+    if (ret == GALLUS_RESULT_OK) {
+      ep = (session_pool_endpoint_t)v;
+    } else if (ret == GALLUS_RESULT_NOT_FOUND) {
+      /*
+       * Pool names are global, qualify them with the owner.
+       */
+      snprintf(name, sizeof(name), "session_pool:%p:%s", (void *)sp, key);
+      ret = gallus_pool_create((gallus_pool_t *)&ep,
+                               sizeof(session_pool_endpoint_record),
+                               name,
+                               GALLUS_POOL_TYPE_QUEUE,
+                               false,
+                               sp->m_n_max_conns,
+                               sizeof(session_pool_conn_record),
+                               &s_methods);
+      if (likely(ret == GALLUS_RESULT_OK)) {
+        ep->m_type = type;
+        ep->m_port = port;
+        ep->m_addr = NULL;
+        ret = gallus_ip_address_copy(addr, &ep->m_addr);
+        if (likely(ret == GALLUS_RESULT_OK)) {
+          v = (void *)ep;
+          ret = gallus_hashmap_add(&sp->m_endpoints, key, &v, false);
+        }
+        if (unlikely(ret != GALLUS_RESULT_OK)) {
+          s_endpoint_destroy((void *)ep);
+          ep = NULL;
+        }
+      }
+    }
+  }
+  (void)gallus_mutex_unlock(&sp->m_lck);
+
+  *epptr = ep;
+
+  return ret;
+}
+
+
+
+
+
+gallus_result_t
+session_pool_create(size_t n_max_conns, gallus_session_pool_t *spptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  session_pool_record *sp = NULL;
+
+  if (spptr == NULL || n_max_conns == 0) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  *spptr = NULL;
+
+  sp = (session_pool_record *)GALLUS_CALLOC(SESSION, 1, sizeof(*sp));
+  if (sp == NULL) {
+    return GALLUS_RESULT_NO_MEMORY;
+  }
+  sp->m_n_max_conns = n_max_conns;
+
+  ret = gallus_mutex_create(&sp->m_lck);
+  if (ret != GALLUS_RESULT_OK) {
+    goto done;
+  }
+  ret = gallus_hashmap_create(&sp->m_endpoints, GALLUS_HASHMAP_TYPE_STRING,
+                              s_endpoint_destroy);
+  if (ret != GALLUS_RESULT_OK) {
+    goto done;
+  }
+  ret = gallus_hashmap_create(&sp->m_leases, GALLUS_HASHMAP_TYPE_ONE_WORD,
+                              NULL);
+
+done:
+  if (ret == GALLUS_RESULT_OK) {
+    *spptr = sp;
+  } else {
+    gallus_perror(ret);
+    session_pool_destroy(&sp);
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+session_pool_acquire(gallus_session_pool_t *spptr,
+                     session_type_t session_type,
+                     gallus_ip_address_t *addr, uint16_t port,
+                     gallus_chrono_t to,
+                     gallus_session_t *sptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  session_pool_record *sp;
+  session_pool_endpoint_t ep = NULL;
+  gallus_poolable_t pobj = NULL;
+  session_pool_conn_t c;
+  gallus_chrono_t deadline;
+  void *v;
+
+  if (spptr == NULL || (sp = *spptr) == NULL || addr == NULL ||
+      port == 0 || sptr == NULL ||
+      (session_type & (SESSION_TCP | SESSION_TCP6)) == 0) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  *sptr = NULL;
+  session_type &= (SESSION_TCP | SESSION_TCP6 | SESSION_TLS);
+  deadline = (to < 0) ? -1LL : gallus_chrono_now() + to;
+
+  ret = s_endpoint_get(sp, session_type, addr, port, &ep);
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    goto done;
+  }
+
+  ret = gallus_pool_acquire_poolable((gallus_pool_t *)&ep, to, &pobj);
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    goto done;
+  }
+  c = (session_pool_conn_t)pobj;
+
+  if (c->m_ses != NULL && s_is_healthy(c->m_ses) == false) {
+    gallus_msg_debug(5, "drop a stale pooled session.\n");
+    session_destroy(c->m_ses);
+    c->m_ses = NULL;
+  }
+  if (c->m_ses == NULL) {
+    ret = s_connect(ep, deadline, &c->m_ses);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      c->m_ses = NULL;
+      (void)gallus_pool_release_poolable(&pobj);
+      goto done;
+    }
+  }
+
+  v = (void *)c;
+  ret = gallus_hashmap_add(&sp->m_leases, (void *)c->m_ses, &v, true);
+  if (likely(ret == GALLUS_RESULT_OK)) {
+    *sptr = c->m_ses;
+  } else {
+    (void)gallus_pool_release_poolable(&pobj);
+  }
+
+done:
+  return ret;
+}
+
+
+gallus_result_t
+session_pool_release(gallus_session_pool_t *spptr,
+                     gallus_session_t *sptr,
+                     bool is_reusable) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  session_pool_record *sp;
+  session_pool_conn_t c;
+  gallus_poolable_t pobj;
+  void *v = NULL;
+
+  if (spptr == NULL || (sp = *spptr) == NULL ||
+      sptr == NULL || *sptr == NULL) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  ret = gallus_hashmap_delete(&sp->m_leases, (void *)*sptr, &v, false);
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    return ret;
+  } else if (unlikely(v == NULL)) {
+    return GALLUS_RESULT_NOT_OWNER;
+  }
+  c = (session_pool_conn_t)v;
+
+  if (is_reusable == false || s_is_healthy(c->m_ses) == false) {
+    session_destroy(c->m_ses);
+    c->m_ses = NULL;
+  } else {
+    session_event_clear(c->m_ses);
+  }
+
+  pobj = (gallus_poolable_t)c;
+  ret = gallus_pool_release_poolable(&pobj);
+  if (likely(ret == GALLUS_RESULT_OK)) {
+    *sptr = NULL;
+  }
+
+  return ret;
+}
+
+
+void
+session_pool_destroy(gallus_session_pool_t *spptr) {
+  session_pool_record *sp;
+
+  if (spptr != NULL && (sp = *spptr) != NULL) {
+    if (sp->m_leases != NULL) {
+      gallus_hashmap_destroy(&sp->m_leases, false);
+    }
+    if (sp->m_endpoints != NULL) {
+      gallus_hashmap_destroy(&sp->m_endpoints, true);
+    }
+    if (sp->m_lck != NULL) {
+      gallus_mutex_destroy(&sp->m_lck);
+    }
+    GALLUS_FREE(SESSION, sp);
+    *spptr = NULL;
+  }
+}
@@ -2,6 +2,8 @@
 #include "gallus_session.h"
 #include "session_internal.h"
 
+#include <sys/uio.h>
+
 gallus_result_t session_tcp_init(gallus_session_t );
 
 static ssize_t
@@ -14,10 +16,16 @@ write_tcp(gallus_session_t s, void *buf, size_t n) {
   return write(s->sock, buf, n);
 }
 
+static ssize_t
+writev_tcp(gallus_session_t s, const struct iovec *iov, int iovcnt) {
+  return writev(s->sock, iov, iovcnt);
+}
+
 gallus_result_t
 session_tcp_init(gallus_session_t s) {
   s->read = read_tcp;
   s->write = write_tcp;
+  s->writev = writev_tcp;
 
   return GALLUS_RESULT_OK;
 }
@@ -7,6 +7,7 @@
 #include <openssl/err.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <sys/uio.h>
 
 static void	s_ctors(void) __attr_constructor__(111);
 static void	s_dtors(void) __attr_destructor__(111);
@@ -19,6 +20,9 @@ static void close_tls(gallus_session_t s);
 static ssize_t read_tls(gallus_session_t s, void *buf, size_t n);
 static ssize_t write_tls(gallus_session_t s, void *buf, size_t n);
 static gallus_result_t connect_check_tls(gallus_session_t s);
+static gallus_result_t handshake_tls(gallus_session_t s);
+static size_t pending_tls(gallus_session_t s);
+static void ktls_setup(gallus_session_t s);
 static int check_cert_chain(const gallus_session_t s);
 
 void
@@ -49,12 +53,17 @@ struct tls_ctx {
   gallus_result_t
   (*check_certificates)(const char *issuer_dn, const char *subject_dn);
   bool verified;
+  bool ktls;		/* kTLS requested for this session */
+  bool ktls_send;	/* kTLS TX is active */
+  bool ktls_recv;	/* kTLS RX is active */
+  short wanted;		/* events set only for an SSL retry */
 };
 
 typedef struct tls_conf {
   char session_cert[PATH_MAX];
   char private_key[PATH_MAX];
   char session_ca_dir[PATH_MAX];
+  bool ktls;
   gallus_rwlock_t s_lck;
 } tls_conf_t;
 
@@ -62,19 +71,73 @@ static tls_conf_t tls;
 
 #include "session_checkcert.c"
 
+/*
+ * Map SSL_ERROR_WANT_READ/WANT_WRITE onto the session events so that
+ * the caller polls for what OpenSSL actually waits for (e.g. a
+ * renegotiation may need to write in SSL_read()). An event the
+ * caller didn't ask for is remembered, to be dropped by want_done().
+ */
+static bool
+want_to_events(gallus_session_t s, int err) {
+  short ev;
+
+  if (err == SSL_ERROR_WANT_READ) {
+    ev = POLLIN;
+  } else if (err == SSL_ERROR_WANT_WRITE) {
+    ev = POLLOUT;
+  } else {
+    return false;
+  }
+  if ((s->events & ev) == 0) {
+    GET_TLS_CTX(s)->wanted |= ev;
+  }
+  if (ev == POLLIN) {
+    session_read_event_set(s);
+  } else {
+    session_write_event_set(s);
+  }
+  return true;
+}
+
+/*
+ * The retried I/O went through: stop polling for the events only
+ * the retry wanted, or a socket that stays writable (readable) would
+ * spin the caller's poll loop. The revents are kept for the caller.
+ */
+static void
+want_done(gallus_session_t s) {
+  if (GET_TLS_CTX(s)->wanted != 0) {
+    s->events = (short)(s->events & ~(GET_TLS_CTX(s)->wanted));
+    GET_TLS_CTX(s)->wanted = 0;
+  }
+}
+
 static ssize_t
 read_tls(gallus_session_t s, void *buf, size_t n) {
   int ret;
+  int err;
 
-  if (IS_CTX_NULL(s)) {
+  if (IS_CTX_NULL(s) || GET_TLS_CTX(s)->ssl == NULL) {
     gallus_msg_warning("session ctx is null.\n");
     return -1;
   }
 
-  do {
-    ret = SSL_read(GET_TLS_CTX(s)->ssl, buf, (int) n);
-  } while (SSL_pending(GET_TLS_CTX(s)->ssl));
+  /*
+   * One record at most; whatever is left in the SSL buffer is
+   * reported by pending_tls() to session_poll().
+   */
+  ret = SSL_read(GET_TLS_CTX(s)->ssl, buf, (int) n);
+  if (ret <= 0) {
+    err = SSL_get_error(GET_TLS_CTX(s)->ssl, ret);
+    if (err == SSL_ERROR_ZERO_RETURN) {
+      return 0;
+    } else if (want_to_events(s, err) == true) {
+      errno = EAGAIN;
+    }
+    return -1;
+  }
 
+  want_done(s);
   return (ssize_t) ret;
 }
 
@@ -82,38 +145,96 @@ static ssize_t
 write_tls(gallus_session_t s, void *buf, size_t n) {
   int ret;
 
-  if (IS_CTX_NULL(s)) {
+  if (IS_CTX_NULL(s) || GET_TLS_CTX(s)->ssl == NULL) {
     gallus_msg_warning("session ctx is null.\n");
     return -1;
   }
 
   ret = SSL_write(GET_TLS_CTX(s)->ssl, buf, (int) n);
-  if (SSL_get_error(GET_TLS_CTX(s)->ssl, ret) == SSL_ERROR_WANT_WRITE) {
+  if (ret > 0) {
+    want_done(s);
+  } else if (want_to_events(s, SSL_get_error(GET_TLS_CTX(s)->ssl,
+                                             ret)) == true) {
     /* wrote but blocked. */
     ret = 0;
   }
   return ret;
 }
 
+/*
+ * With kTLS TX the kernel frames and encrypts, so application data is
+ * a plain write(2) (and sendfile(2)/splice(2) work on the socket).
+ */
+static ssize_t
+write_ktls(gallus_session_t s, void *buf, size_t n) {
+  ssize_t ret;
+
+  ret = write(s->sock, buf, n);
+  if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    session_write_event_set(s);
+    ret = 0;
+  }
+  return ret;
+}
+
+static ssize_t
+writev_ktls(gallus_session_t s, const struct iovec *iov, int iovcnt) {
+  ssize_t ret;
+
+  ret = writev(s->sock, iov, iovcnt);
+  if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    session_write_event_set(s);
+    ret = 0;
+  }
+  return ret;
+}
+
+static size_t
+pending_tls(gallus_session_t s) {
+  if (IS_CTX_NULL(s) || GET_TLS_CTX(s)->ssl == NULL) {
+    return 0;
+  }
+  return (size_t) SSL_pending(GET_TLS_CTX(s)->ssl);
+}
+
 static int verify_callback(int ok, X509_STORE_CTX *store) {
   (void) store;
   return ok;
 }
 
 static SSL_CTX *
-get_ssl_ctx_common(char *ca_dir, char *cert, char *key) {
+get_ssl_ctx_common(char *ca_dir, char *cert, char *key, bool ktls) {
   int ret;
   SSL_CTX *ssl_ctx;
   const SSL_METHOD *method;
 
   gallus_msg_info("ca_dir:[%s], cert:[%s], key:[%s]\n", ca_dir, cert, key);
-  method = TLSv1_method();
+  if (ktls == true) {
+    /* the kernel only offloads TLS 1.2 and later. */
+    method = TLS_method();
+  } else {
+    method = TLSv1_method();
+  }
   ssl_ctx = SSL_CTX_new(method);
   if (ssl_ctx == NULL) {
     gallus_msg_warning("no memory.\n");
     return NULL;
   }
 
+  if (ktls == true) {
+    if (SSL_CTX_set_min_proto_version(ssl_ctx, TLS1_2_VERSION) != 1) {
+      gallus_msg_warning("SSL_CTX_set_min_proto_version() fail.\n");
+      SSL_CTX_free(ssl_ctx);
+      return NULL;
+    }
+#ifdef SSL_OP_ENABLE_KTLS
+    SSL_CTX_set_options(ssl_ctx, SSL_OP_ENABLE_KTLS);
+#else
+    gallus_msg_info("kTLS is not supported by this OpenSSL, "
+                     "falling back to user space TLS.\n");
+#endif /* SSL_OP_ENABLE_KTLS */
+  }
+
   /* add cert. */
   ret = SSL_CTX_use_certificate_file(ssl_ctx, cert, SSL_FILETYPE_PEM);
   if (ret != 1) {
@@ -145,10 +266,10 @@ get_ssl_ctx_common(char *ca_dir, char *cert, char *key) {
 }
 
 static SSL_CTX *
-get_server_ssl_ctx(char *ca_dir, char *cert, char *key) {
+get_server_ssl_ctx(char *ca_dir, char *cert, char *key, bool ktls) {
   SSL_CTX *ssl_ctx;
 
-  ssl_ctx = get_ssl_ctx_common(ca_dir, cert, key);
+  ssl_ctx = get_ssl_ctx_common(ca_dir, cert, key, ktls);
   if (ssl_ctx == NULL) {
     return NULL;
   }
@@ -168,10 +289,10 @@ get_server_ssl_ctx(char *ca_dir, char *cert, char *key) {
 }
 
 static SSL_CTX *
-get_client_ssl_ctx(char *ca_dir, char *cert, char *key) {
+get_client_ssl_ctx(char *ca_dir, char *cert, char *key, bool ktls) {
   SSL_CTX *ssl_ctx;
 
-  ssl_ctx = get_ssl_ctx_common(ca_dir, cert, key);
+  ssl_ctx = get_ssl_ctx_common(ca_dir, cert, key, ktls);
   if (ssl_ctx == NULL) {
     return NULL;
   }
@@ -185,11 +306,10 @@ get_client_ssl_ctx(char *ca_dir, char *cert, char *key) {
 
 static gallus_result_t
 accept_tls(gallus_session_t s1, gallus_session_t *s2) {
-  int ret;
   SSL *ssl;
   BIO *sbio;
 
-  if (s1 == NULL || *s2 == NULL) {
+  if (s1 == NULL || *s2 == NULL || IS_CTX_NULL(*s2)) {
     return GALLUS_RESULT_INVALID_ARGS;
   }
 
@@ -202,34 +322,104 @@ accept_tls(gallus_session_t s1, gallus_session_t *s2) {
 
   sbio = BIO_new_socket((*s2)->sock, BIO_NOCLOSE);
   SSL_set_bio(GET_TLS_CTX(*s2)->ssl, sbio, sbio);
+  SSL_set_accept_state(GET_TLS_CTX(*s2)->ssl);
+
+  /*
+   * On a blocking socket this completes the handshake. On a
+   * non-blocking one it returns GALLUS_RESULT_EINPROGRESS and the
+   * caller drives the rest with session_handshake().
+   */
+  return handshake_tls(*s2);
+}
 
-retry:
-  ret = SSL_accept(GET_TLS_CTX(*s2)->ssl);
+static gallus_result_t
+handshake_tls(gallus_session_t s) {
+  int ret;
+  int err;
+  SSL *ssl;
+
+  if (IS_CTX_NULL(s) || (ssl = GET_TLS_CTX(s)->ssl) == NULL) {
+    return GALLUS_RESULT_NOT_STARTED;
+  }
+
+  if (SSL_is_init_finished(ssl) && GET_TLS_CTX(s)->verified == true) {
+    return GALLUS_RESULT_OK;
+  }
+
+  ret = SSL_do_handshake(ssl);
   if (ret <= 0) {
-    if (SSL_get_error(GET_TLS_CTX(*s2)->ssl, ret) == SSL_ERROR_WANT_READ
-        || SSL_get_error(GET_TLS_CTX(*s2)->ssl, ret) == SSL_ERROR_WANT_WRITE) {
-      goto retry;
+    err = SSL_get_error(ssl, ret);
+    if (err == SSL_ERROR_WANT_READ) {
+      session_write_event_unset(s);
+      session_read_event_set(s);
+      return GALLUS_RESULT_EINPROGRESS;
+    } else if (err == SSL_ERROR_WANT_WRITE) {
+      session_read_event_unset(s);
+      session_write_event_set(s);
+      return GALLUS_RESULT_EINPROGRESS;
     }
-    gallus_msg_warning("tls error (%s:%d).\n", ERR_error_string((unsigned long)
-                        SSL_get_error(GET_TLS_CTX(*s2)->ssl, ret), NULL),
-                        (int) SSL_get_error(GET_TLS_CTX(*s2)->ssl, ret));
-    destroy_tls(*s2);
+    gallus_msg_warning("tls error (%s:%d).\n",
+                        ERR_error_string((unsigned long) err, NULL), err);
     return GALLUS_RESULT_TLS_CONN_ERROR;
   }
 
-  if (SSL_get_peer_certificate(GET_TLS_CTX(*s2)->ssl) != NULL) {
-    ret = check_cert_chain(*s2);
-    if (ret < 0) {
+  if (GET_TLS_CTX(s)->verified == false) {
+    if (s->session_type & SESSION_ACCEPTED) {
+      /* the peer certificate is optional on the server side. */
+      X509 *peer = SSL_get_peer_certificate(ssl);
+      if (peer != NULL) {
+        X509_free(peer);
+        if (check_cert_chain(s) < 0) {
+          gallus_msg_warning("certificate error.\n");
+          return GALLUS_RESULT_TLS_CONN_ERROR;
+        }
+      }
+    } else if (check_cert_chain(s) < 0) {
       gallus_msg_warning("certificate error.\n");
-      destroy_tls(*s2);
       return GALLUS_RESULT_TLS_CONN_ERROR;
     }
-    GET_TLS_CTX(*s2)->verified = true;
+    GET_TLS_CTX(s)->verified = true;
+    ktls_setup(s);
   }
 
   return GALLUS_RESULT_OK;
 }
 
+/*
+ * Called once the handshake is done. OpenSSL has already tried to push
+ * the negotiated keys into the kernel if SSL_OP_ENABLE_KTLS was set;
+ * it silently stays in user space when the cipher, the protocol
+ * version or the kernel (no "tls" ULP) does not allow it.
+ */
+static void
+ktls_setup(gallus_session_t s) {
+  SSL *ssl = GET_TLS_CTX(s)->ssl;
+
+  if (GET_TLS_CTX(s)->ktls == false) {
+    return;
+  }
+
+  GET_TLS_CTX(s)->ktls_send =
+    (BIO_get_ktls_send(SSL_get_wbio(ssl))) ? true : false;
+  GET_TLS_CTX(s)->ktls_recv =
+    (BIO_get_ktls_recv(SSL_get_rbio(ssl))) ? true : false;
+
+  if (GET_TLS_CTX(s)->ktls_send == true) {
+    s->write = write_ktls;
+    s->writev = writev_ktls;
+  }
+  /*
+   * Reads stay on SSL_read(): with kTLS RX it only demultiplexes the
+   * record types (alerts, post-handshake messages), the decryption is
+   * done in the kernel.
+   */
+
+  gallus_msg_debug(10, "kTLS send:%s, recv:%s (%s).\n",
+                    (GET_TLS_CTX(s)->ktls_send == true) ? "on" : "off",
+                    (GET_TLS_CTX(s)->ktls_recv == true) ? "on" : "off",
+                    SSL_get_cipher_name(ssl));
+}
+
 static void
 initialize_internal(void) {
   gallus_result_t ret;
@@ -514,6 +704,41 @@ gallus_session_tls_set_certcheck_default(gallus_result_t
   (void)gallus_rwlock_unlock(&(tls.s_lck));
 }
 
+gallus_result_t
+gallus_session_tls_set_ktls(bool ktls) {
+  (void)gallus_rwlock_writer_lock(&(tls.s_lck));
+  {
+    tls.ktls = ktls;
+  }
+  (void)gallus_rwlock_unlock(&(tls.s_lck));
+  return GALLUS_RESULT_OK;
+}
+
+gallus_result_t
+gallus_session_tls_get_ktls(bool *ktls) {
+  if (ktls != NULL) {
+    (void)gallus_rwlock_reader_lock(&(tls.s_lck));
+    {
+      *ktls = tls.ktls;
+    }
+    (void)gallus_rwlock_unlock(&(tls.s_lck));
+    return GALLUS_RESULT_OK;
+  }
+  return GALLUS_RESULT_INVALID_ARGS;
+}
+
+gallus_result_t
+gallus_session_tls_get_ktls_status(gallus_session_t s,
+                                    bool *send, bool *recv) {
+  if (s != NULL && (s->session_type & SESSION_TLS) &&
+      IS_CTX_NULL(s) == false && send != NULL && recv != NULL) {
+    *send = GET_TLS_CTX(s)->ktls_send;
+    *recv = GET_TLS_CTX(s)->ktls_recv;
+    return GALLUS_RESULT_OK;
+  }
+  return GALLUS_RESULT_INVALID_ARGS;
+}
+
 /* Assume locked. */
 void
 gallus_session_tls_set_certcheck(gallus_session_t s, gallus_result_t
@@ -571,7 +796,7 @@ session_tls_init(gallus_session_t s) {
 
   pthread_once(&initialized, initialize_internal);
 
-  s->ctx = malloc(sizeof(struct tls_ctx));
+  s->ctx = GALLUS_CALLOC(SESSION, 1, sizeof(struct tls_ctx));
   if (s->ctx == NULL) {
     gallus_msg_warning("no memory.\n");
     return GALLUS_RESULT_NO_MEMORY;
@@ -580,12 +805,13 @@ session_tls_init(gallus_session_t s) {
   gallus_mutex_lock(&lock);
   (void)gallus_rwlock_writer_lock(&(tls.s_lck));
   {
-    GET_TLS_CTX(s)->ca_dir = strdup(tls.session_ca_dir);
+    GET_TLS_CTX(s)->ca_dir = GALLUS_STRDUP(SESSION, tls.session_ca_dir);
+    GET_TLS_CTX(s)->ktls = tls.ktls;
   }
   (void)gallus_rwlock_unlock(&(tls.s_lck));
   if (GET_TLS_CTX(s)->ca_dir == NULL) {
     gallus_msg_warning("no memory.\n");
-    free(s->ctx);
+    GALLUS_FREE(SESSION, s->ctx);
     gallus_mutex_unlock(&lock);
     return GALLUS_RESULT_NO_MEMORY;
   }
@@ -593,26 +819,26 @@ session_tls_init(gallus_session_t s) {
   if (s->session_type & SESSION_PASSIVE) {
     (void)gallus_rwlock_writer_lock(&(tls.s_lck));
     {
-      GET_TLS_CTX(s)->cert = strdup(tls.session_cert);
+      GET_TLS_CTX(s)->cert = GALLUS_STRDUP(SESSION, tls.session_cert);
     }
     (void)gallus_rwlock_unlock(&(tls.s_lck));
     if (GET_TLS_CTX(s)->cert == NULL) {
       gallus_msg_warning("no memory.\n");
-      free(GET_TLS_CTX(s)->ca_dir);
-      free(s->ctx);
+      GALLUS_FREE(SESSION, GET_TLS_CTX(s)->ca_dir);
+      GALLUS_FREE(SESSION, s->ctx);
       gallus_mutex_unlock(&lock);
       return GALLUS_RESULT_NO_MEMORY;
     }
   } else if (s->session_type & SESSION_ACTIVE) {
     (void)gallus_rwlock_writer_lock(&(tls.s_lck));
     {
-      GET_TLS_CTX(s)->cert = strdup(tls.session_cert);
+      GET_TLS_CTX(s)->cert = GALLUS_STRDUP(SESSION, tls.session_cert);
     }
     (void)gallus_rwlock_unlock(&(tls.s_lck));
     if (GET_TLS_CTX(s)->cert == NULL) {
       gallus_msg_warning("no memory.\n");
-      free(GET_TLS_CTX(s)->ca_dir);
-      free(s->ctx);
+      GALLUS_FREE(SESSION, GET_TLS_CTX(s)->ca_dir);
+      GALLUS_FREE(SESSION, s->ctx);
       gallus_mutex_unlock(&lock);
       return GALLUS_RESULT_NO_MEMORY;
     }
@@ -623,28 +849,28 @@ session_tls_init(gallus_session_t s) {
   if (s->session_type & SESSION_PASSIVE) {
     (void)gallus_rwlock_writer_lock(&(tls.s_lck));
     {
-      GET_TLS_CTX(s)->key = strdup(tls.private_key);
+      GET_TLS_CTX(s)->key = GALLUS_STRDUP(SESSION, tls.private_key);
     }
     (void)gallus_rwlock_unlock(&(tls.s_lck));
     if (GET_TLS_CTX(s)->key == NULL) {
       gallus_msg_warning("no memory.\n");
-      free(GET_TLS_CTX(s)->cert);
-      free(GET_TLS_CTX(s)->ca_dir);
-      free(s->ctx);
+      GALLUS_FREE(SESSION, GET_TLS_CTX(s)->cert);
+      GALLUS_FREE(SESSION, GET_TLS_CTX(s)->ca_dir);
+      GALLUS_FREE(SESSION, s->ctx);
       gallus_mutex_unlock(&lock);
       return GALLUS_RESULT_NO_MEMORY;
     }
   } else if (s->session_type & SESSION_ACTIVE) {
     (void)gallus_rwlock_writer_lock(&(tls.s_lck));
     {
-      GET_TLS_CTX(s)->key = strdup(tls.private_key);
+      GET_TLS_CTX(s)->key = GALLUS_STRDUP(SESSION, tls.private_key);
     }
     (void)gallus_rwlock_unlock(&(tls.s_lck));
     if (GET_TLS_CTX(s)->key == NULL) {
       gallus_msg_warning("no memory.\n");
-      free(GET_TLS_CTX(s)->cert);
-      free(GET_TLS_CTX(s)->ca_dir);
-      free(s->ctx);
+      GALLUS_FREE(SESSION, GET_TLS_CTX(s)->cert);
+      GALLUS_FREE(SESSION, GET_TLS_CTX(s)->ca_dir);
+      GALLUS_FREE(SESSION, s->ctx);
       gallus_mutex_unlock(&lock);
       return GALLUS_RESULT_NO_MEMORY;
     }
@@ -656,12 +882,13 @@ session_tls_init(gallus_session_t s) {
   if (s->session_type & SESSION_PASSIVE) {
     GET_TLS_CTX(s)->ctx =
       get_server_ssl_ctx(GET_TLS_CTX(s)->ca_dir,
-                         GET_TLS_CTX(s)->cert, GET_TLS_CTX(s)->key);
+                         GET_TLS_CTX(s)->cert, GET_TLS_CTX(s)->key,
+                         GET_TLS_CTX(s)->ktls);
     if (GET_TLS_CTX(s)->ctx == NULL) {
-      free(GET_TLS_CTX(s)->key);
-      free(GET_TLS_CTX(s)->cert);
-      free(GET_TLS_CTX(s)->ca_dir);
-      free(s->ctx);
+      GALLUS_FREE(SESSION, GET_TLS_CTX(s)->key);
+      GALLUS_FREE(SESSION, GET_TLS_CTX(s)->cert);
+      GALLUS_FREE(SESSION, GET_TLS_CTX(s)->ca_dir);
+      GALLUS_FREE(SESSION, s->ctx);
       return GALLUS_RESULT_NO_MEMORY;
     }
   } else {
@@ -675,9 +902,12 @@ session_tls_init(gallus_session_t s) {
   s->connect = connect_tls;
   s->read = read_tls;
   s->write = write_tls;
+  s->writev = NULL;
   s->close = close_tls;
   s->destroy = destroy_tls;
   s->connect_check = connect_check_tls;
+  s->handshake = handshake_tls;
+  s->pending = pending_tls;
 
   return GALLUS_RESULT_OK;
 }
@@ -735,7 +965,7 @@ done:
 
 static gallus_result_t
 connect_tls(gallus_session_t s, const char *host, const char *port) {
-  int ret;
+  gallus_result_t ret;
   BIO *sbio;
 
   (void) host;
@@ -747,7 +977,7 @@ connect_tls(gallus_session_t s, const char *host, const char *port) {
     SSL_CTX *ssl_ctx;
 
     ssl_ctx = get_client_ssl_ctx(GET_TLS_CTX(s)->ca_dir, GET_TLS_CTX(s)->cert,
-                                 GET_TLS_CTX(s)->key);
+                                 GET_TLS_CTX(s)->key, GET_TLS_CTX(s)->ktls);
     if (ssl_ctx == NULL) {
       gallus_msg_warning("get_client_ssl_ctx() fail.\n");
       return GALLUS_RESULT_TLS_CONN_ERROR;
@@ -768,54 +998,48 @@ connect_tls(gallus_session_t s, const char *host, const char *port) {
   if (SSL_get_rbio(GET_TLS_CTX(s)->ssl) == NULL) {
     sbio = BIO_new_socket(s->sock, BIO_NOCLOSE);
     SSL_set_bio(GET_TLS_CTX(s)->ssl, sbio, sbio);
+    SSL_set_connect_state(GET_TLS_CTX(s)->ssl);
   }
 
-  ret = SSL_connect(GET_TLS_CTX(s)->ssl);
-  if (ret == 0) {
-    gallus_msg_warning("tls handshake failed.\n");
-    return GALLUS_RESULT_TLS_CONN_ERROR;
-  } else if (ret < 0
-             && (SSL_get_error(GET_TLS_CTX(s)->ssl, ret) != SSL_ERROR_WANT_READ
-                 && SSL_get_error(GET_TLS_CTX(s)->ssl, ret) != SSL_ERROR_WANT_WRITE)) {
-    gallus_msg_warning("tls error (%s:%d).\n", ERR_error_string((unsigned long)
-                        SSL_get_error(GET_TLS_CTX(s)->ssl, ret), NULL),
-                        (int) SSL_get_error(GET_TLS_CTX(s)->ssl, ret));
-    return GALLUS_RESULT_TLS_CONN_ERROR;
-  } else if (ret < 0) {
-    gallus_msg_info("tls error (%s:%d), but continue.\n",
-                     ERR_error_string((unsigned long)
-                                      SSL_get_error(GET_TLS_CTX(s)->ssl, ret), NULL),
-                     (int) SSL_get_error(GET_TLS_CTX(s)->ssl, ret));
-    return GALLUS_RESULT_EINPROGRESS;
-  } else {
-    ret = check_cert_chain(s);
-    if (ret < 0) {
-      gallus_msg_warning("certificate error.\n");
-      return GALLUS_RESULT_TLS_CONN_ERROR;
-    }
-    GET_TLS_CTX(s)->verified = true;
+  /*
+   * One step only; GALLUS_RESULT_EINPROGRESS leaves the read/write
+   * event the handshake waits for set on the session.
+   */
+  ret = handshake_tls(s);
+  if (ret == GALLUS_RESULT_OK) {
     gallus_msg_info("tls handshake end.\n");
+  } else if (ret == GALLUS_RESULT_EINPROGRESS) {
+    gallus_msg_debug(10, "tls handshake in progress.\n");
   }
 
-  return GALLUS_RESULT_OK;
+  return ret;
 }
 
 
 static void
 destroy_tls(gallus_session_t s) {
-  if (IS_TLS_NOT_INIT(s) == false) {
-    free(GET_TLS_CTX(s)->ca_dir);
-    free(GET_TLS_CTX(s)->cert);
-    free(GET_TLS_CTX(s)->key);
+  if (IS_CTX_NULL(s)) {
+    return;
+  }
+
+  /*
+   * Accepted sessions own an SSL but no SSL_CTX, so free them
+   * independently. The configuration lock is shared by every session
+   * and must survive this one.
+   */
+  if (GET_TLS_CTX(s)->ssl != NULL) {
     SSL_free(GET_TLS_CTX(s)->ssl);
     GET_TLS_CTX(s)->ssl = NULL;
+  }
+  if (IS_TLS_NOT_INIT(s) == false) {
     SSL_CTX_free(GET_TLS_CTX(s)->ctx);
     GET_TLS_CTX(s)->ctx = NULL;
   }
+  GALLUS_FREE(SESSION, GET_TLS_CTX(s)->ca_dir);
+  GALLUS_FREE(SESSION, GET_TLS_CTX(s)->cert);
+  GALLUS_FREE(SESSION, GET_TLS_CTX(s)->key);
 
-  gallus_rwlock_destroy(&(tls.s_lck));
-
-  free(GET_TLS_CTX(s));
+  GALLUS_FREE(SESSION, GET_TLS_CTX(s));
   s->ctx =  NULL;
 }
 
@@ -829,9 +1053,7 @@ close_tls(gallus_session_t s) {
 
 static gallus_result_t
 connect_check_tls(gallus_session_t s) {
-  long res = -1;
-  X509 *peer = NULL;
-  gallus_result_t ret = 0;
+  gallus_result_t ret = GALLUS_RESULT_OK;
 
   gallus_msg_debug(10, "connect check in\n");
   if (IS_CTX_NULL(s)) {
@@ -839,13 +1061,13 @@ connect_check_tls(gallus_session_t s) {
     return GALLUS_RESULT_INVALID_ARGS;
   }
 
-  if (IS_TLS_NOT_INIT(s) == false) {
-    res = SSL_get_verify_result(GET_TLS_CTX(s)->ssl);
-    peer = SSL_get_peer_certificate(GET_TLS_CTX(s)->ssl);
-  }
-
-  if (res != X509_V_OK || peer == NULL
-      || GET_TLS_CTX(s)->verified == false) {
+  /*
+   * Advance the handshake by one step; GALLUS_RESULT_EINPROGRESS
+   * reports that it is still running.
+   */
+  if (GET_TLS_CTX(s)->ssl == NULL ||
+      SSL_is_init_finished(GET_TLS_CTX(s)->ssl) == 0 ||
+      GET_TLS_CTX(s)->verified == false) {
     ret = connect_tls(s, NULL, NULL);
   }
   gallus_msg_debug(10, "connect check out ret:%d\n", (int) ret);
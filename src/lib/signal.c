@@ -22,7 +22,7 @@ typedef struct signal_thread_record {
   gallus_mutex_t m_lock;
   sighandler_t m_sigprocs[NSIG];
   sigset_t m_sigset;
-  bool m_do_loop;
+  bool m_do_loop;		/* by the gallus_atomic_*(). */
 } signal_thread_record;
 typedef signal_thread_record 	*signal_thread_t;
 
@@ -156,7 +156,7 @@ s_save_sigprocs(signal_thread_t st, sighandler_t *procs) {
 static inline void
 s_stop(signal_thread_t st) {
   if (st != NULL) {
-    st->m_do_loop = false;
+    gallus_atomic_store(&(st->m_do_loop), false, RELAXED);
   }
 }
 
@@ -182,7 +182,7 @@ s_main(const gallus_thread_t *tptr, void *arg) {
        * Don't initialize stptr->m_sigset since it would be set before
        * the start.
        */
-      while (st->m_do_loop == true) {
+      while (gallus_atomic_load(&(st->m_do_loop), RELAXED) == true) {
 
         s_lock(st);
         {
@@ -0,0 +1,417 @@
+#include "gallus_apis.h"
+#include "gallus_poolable_internal.h"
+#include "gallus_thread_internal.h"
+#include "gallus_pool_internal.h"
+#include "gallus_pooled_thread_internal.h"
+#include "gallus_task_internal.h"
+
+
+
+
+
+#define RADIX_BITS	8
+#define RADIX_N		(1 << RADIX_BITS)
+
+#define SORT_MIN_RUN		8192	/* smallest run to sort in parallel */
+#define SORT_MIN_MERGE_GRAIN	4096	/* smallest slice of a merge */
+#define SORT_SLICES_PER_LANE	8
+
+
+/*
+ * A parallel merge sort. The m_bounds[i] is the first element of
+ * the run i, m_bounds[m_n_runs] is the nelem. A merge pass merges the
+ * runs [2kw, 2kw + w) and [2kw + w, 2kw + 2w) for w = m_width, from
+ * the m_src to the m_dst.
+ */
+typedef struct sort_job_record {
+  uint8_t *m_src;
+  uint8_t *m_dst;
+  size_t m_size;
+  int (*m_cmp)(const void *, const void *, void *);
+  void *m_arg;
+
+  size_t *m_bounds;
+  size_t m_n_runs;
+  size_t m_width;
+} sort_job_record;
+
+
+
+
+
+static inline void
+s_copy_elem(uint8_t *dst, const uint8_t *src, size_t size) {
+  switch (size) {
+    case 4: {
+      (void)memcpy((void *)dst, (const void *)src, 4);
+      break;
+    }
+    case 8: {
+      (void)memcpy((void *)dst, (const void *)src, 8);
+      break;
+    }
+    case 16: {
+      (void)memcpy((void *)dst, (const void *)src, 16);
+      break;
+    }
+    default: {
+      (void)memcpy((void *)dst, (const void *)src, size);
+      break;
+    }
+  }
+}
+
+
+static inline uint64_t
+s_load_key(const uint8_t *p, size_t key_size) {
+  uint64_t ret = 0;
+
+  switch (key_size) {
+    case 1: {
+      ret = *p;
+      break;
+    }
+    case 2: {
+      uint16_t k;
+      (void)memcpy((void *)&k, (const void *)p, sizeof(k));
+      ret = k;
+      break;
+    }
+    case 4: {
+      uint32_t k;
+      (void)memcpy((void *)&k, (const void *)p, sizeof(k));
+      ret = k;
+      break;
+    }
+    default: {
+      (void)memcpy((void *)&ret, (const void *)p, sizeof(ret));
+      break;
+    }
+  }
+
+  return ret;
+}
+
+
+/*
+ * LSD radix sort, a pass per a byte of the key. All the histograms
+ * are taken in one read of the array, and the passes of a byte all
+ * the keys share are skipped, so the keys of a narrow range cost
+ * only a pass or two.
+ */
+static inline gallus_result_t
+s_radix_sort(uint8_t *array, size_t nelem, size_t size,
+             size_t key_offset, size_t key_size, bool is_signed) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  uint64_t flip = (is_signed == true) ?
+                  (1ULL << (key_size * 8 - 1)) : 0ULL;
+  size_t (*counts)[RADIX_N] = NULL;
+  uint8_t *tmp = NULL;
+  uint8_t *src = array;
+  uint8_t *dst;
+  uint8_t *p;
+  uint64_t k;
+  size_t i, d, sum, c;
+  unsigned int shift;
+
+  if (nelem < 2) {
+    return GALLUS_RESULT_OK;
+  }
+
+  counts = (size_t (*)[RADIX_N])calloc(key_size, sizeof(*counts));
+  tmp = (uint8_t *)malloc(nelem * size);
+  if (unlikely(counts == NULL || tmp == NULL)) {
+    ret = GALLUS_RESULT_NO_MEMORY;
+    goto done;
+  }
+  dst = tmp;
+
+  for (i = 0, p = array; i < nelem; i++, p += size) {
+    k = s_load_key(p + key_offset, key_size) ^ flip;
+    for (d = 0; d < key_size; d++) {
+      counts[d][(k >> (d * RADIX_BITS)) & (RADIX_N - 1)]++;
+    }
+  }
+
+  for (d = 0; d < key_size; d++) {
+    shift = (unsigned int)(d * RADIX_BITS);
+    k = s_load_key(src + key_offset, key_size) ^ flip;
+    if (counts[d][(k >> shift) & (RADIX_N - 1)] == nelem) {
+      continue;
+    }
+
+    for (sum = 0, i = 0; i < RADIX_N; i++) {
+      c = counts[d][i];
+      counts[d][i] = sum;
+      sum += c;
+    }
+    for (i = 0, p = src; i < nelem; i++, p += size) {
+      k = s_load_key(p + key_offset, key_size) ^ flip;
+      s_copy_elem(dst + counts[d][(k >> shift) & (RADIX_N - 1)]++ * size,
+                  p, size);
+    }
+
+    p = src;
+    src = dst;
+    dst = p;
+  }
+
+  if (src != array) {
+    (void)memcpy((void *)array, (const void *)src, nelem * size);
+  }
+  ret = GALLUS_RESULT_OK;
+
+done:
+  free((void *)tmp);
+  free((void *)counts);
+  return ret;
+}
+
+
+
+
+
+gallus_result_t
+gallus_radix_sort_u32(uint32_t *array, size_t nelem) {
+  if (array == NULL && nelem > 0) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+  return s_radix_sort((uint8_t *)array, nelem, sizeof(uint32_t),
+                      0, sizeof(uint32_t), false);
+}
+
+
+gallus_result_t
+gallus_radix_sort_u64(uint64_t *array, size_t nelem) {
+  if (array == NULL && nelem > 0) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+  return s_radix_sort((uint8_t *)array, nelem, sizeof(uint64_t),
+                      0, sizeof(uint64_t), false);
+}
+
+
+gallus_result_t
+gallus_radix_sort_records(void *array, size_t nelem, size_t size,
+                          size_t key_offset, size_t key_size,
+                          bool is_signed) {
+  if ((array == NULL && nelem > 0) ||
+      (key_size != 1 && key_size != 2 && key_size != 4 && key_size != 8) ||
+      key_offset + key_size > size) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+  return s_radix_sort((uint8_t *)array, nelem, size,
+                      key_offset, key_size, is_signed);
+}
+
+
+
+
+
+static gallus_result_t
+s_sort_runs(size_t begin, size_t end, void *arg) {
+  sort_job_record *j = (sort_job_record *)arg;
+  size_t i;
+
+  for (i = begin; i < end; i++) {
+    gallus_qsort_r((void *)(j->m_src + j->m_bounds[i] * j->m_size),
+                   j->m_bounds[i + 1] - j->m_bounds[i], j->m_size,
+                   j->m_cmp, j->m_arg);
+  }
+
+  return GALLUS_RESULT_OK;
+}
+
+
+/*
+ * # of the elements from the a in the first k of the merge of the a
+ * and the b. The ties go to the a.
+ */
+static inline size_t
+s_co_rank(const sort_job_record *j, size_t k,
+          const uint8_t *a, size_t na, const uint8_t *b, size_t nb) {
+  size_t lo = (k > nb) ? k - nb : 0;
+  size_t hi = (k < na) ? k : na;
+  size_t i;
+
+  while (lo < hi) {
+    i = lo + (hi - lo) / 2;
+    if (j->m_cmp((const void *)(a + i * j->m_size),
+                 (const void *)(b + (k - i - 1) * j->m_size),
+                 j->m_arg) <= 0) {
+      lo = i + 1;
+    } else {
+      hi = i;
+    }
+  }
+
+  return lo;
+}
+
+
+/*
+ * The run the element at the pos is in.
+ */
+static inline size_t
+s_run_of(const sort_job_record *j, size_t pos) {
+  size_t lo = 0;
+  size_t hi = j->m_n_runs;
+  size_t m;
+
+  while (hi - lo > 1) {
+    m = lo + (hi - lo) / 2;
+    if (j->m_bounds[m] <= pos) {
+      lo = m;
+    } else {
+      hi = m;
+    }
+  }
+
+  return lo;
+}
+
+
+/*
+ * Merge the output [begin, end) of a pass. It may span merges.
+ */
+static gallus_result_t
+s_merge_slice(size_t begin, size_t end, void *arg) {
+  sort_job_record *j = (sort_job_record *)arg;
+  size_t size = j->m_size;
+  size_t r, lo, mid, hi, stop, ia, ib, ea, eb;
+  const uint8_t *a;
+  const uint8_t *b;
+  uint8_t *d;
+
+  while (begin < end) {
+    r = s_run_of(j, begin) / (2 * j->m_width) * (2 * j->m_width);
+    lo = j->m_bounds[r];
+    mid = j->m_bounds[(r + j->m_width < j->m_n_runs) ?
+                      r + j->m_width : j->m_n_runs];
+    hi = j->m_bounds[(r + 2 * j->m_width < j->m_n_runs) ?
+                     r + 2 * j->m_width : j->m_n_runs];
+    stop = (end < hi) ? end : hi;
+
+    a = j->m_src + lo * size;
+    b = j->m_src + mid * size;
+    ia = s_co_rank(j, begin - lo, a, mid - lo, b, hi - mid);
+    ea = s_co_rank(j, stop - lo, a, mid - lo, b, hi - mid);
+    ib = begin - lo - ia;
+    eb = stop - lo - ea;
+
+    d = j->m_dst + begin * size;
+    while (ia < ea && ib < eb) {
+      if (j->m_cmp((const void *)(b + ib * size),
+                   (const void *)(a + ia * size), j->m_arg) < 0) {
+        s_copy_elem(d, b + ib++ * size, size);
+      } else {
+        s_copy_elem(d, a + ia++ * size, size);
+      }
+      d += size;
+    }
+    if (ia < ea) {
+      (void)memcpy((void *)d, (const void *)(a + ia * size),
+                   (ea - ia) * size);
+    } else if (ib < eb) {
+      (void)memcpy((void *)d, (const void *)(b + ib * size),
+                   (eb - ib) * size);
+    }
+
+    begin = stop;
+  }
+
+  return GALLUS_RESULT_OK;
+}
+
+
+static gallus_result_t
+s_copy_slice(size_t begin, size_t end, void *arg) {
+  sort_job_record *j = (sort_job_record *)arg;
+
+  (void)memcpy((void *)(j->m_dst + begin * j->m_size),
+               (const void *)(j->m_src + begin * j->m_size),
+               (end - begin) * j->m_size);
+
+  return GALLUS_RESULT_OK;
+}
+
+
+gallus_result_t
+gallus_parallel_sort_r(gallus_thread_pool_t *pptr,
+                       void *array, size_t nelem, size_t size,
+                       int (*cmp)(const void *, const void *, void *),
+                       void *arg) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  sort_job_record j;
+  size_t n_runs = 1;
+  size_t grain, i;
+  uint8_t *tmp = NULL;
+  uint8_t *p;
+
+  if ((array == NULL && nelem > 0) || size == 0 || cmp == NULL) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  if (pptr != NULL && *pptr != NULL && (*pptr)->m_exec != NULL) {
+    n_runs = (*pptr)->m_exec->m_n_workers + 1;
+  }
+  if (n_runs > nelem / SORT_MIN_RUN) {
+    n_runs = nelem / SORT_MIN_RUN;
+  }
+
+  /*
+   * Not worth a merge.
+   */
+  if (n_runs <= 1) {
+    gallus_qsort_r(array, nelem, size, cmp, arg);
+    return GALLUS_RESULT_OK;
+  }
+
+  (void)memset((void *)&j, 0, sizeof(j));
+  tmp = (uint8_t *)malloc(nelem * size);
+  j.m_bounds = (size_t *)malloc(sizeof(size_t) * (n_runs + 1));
+  if (unlikely(tmp == NULL || j.m_bounds == NULL)) {
+    ret = GALLUS_RESULT_NO_MEMORY;
+    goto done;
+  }
+  for (i = 0; i <= n_runs; i++) {
+    j.m_bounds[i] = i * (nelem / n_runs) +
+                    ((i < nelem % n_runs) ? i : nelem % n_runs);
+  }
+  j.m_n_runs = n_runs;
+  j.m_size = size;
+  j.m_cmp = cmp;
+  j.m_arg = arg;
+  j.m_src = (uint8_t *)array;
+  j.m_dst = tmp;
+
+  ret = gallus_parallel_for(pptr, 0, n_runs, 1, s_sort_runs, (void *)&j);
+  if (unlikely(ret != GALLUS_RESULT_OK)) {
+    goto done;
+  }
+
+  grain = nelem / (n_runs * SORT_SLICES_PER_LANE);
+  if (grain < SORT_MIN_MERGE_GRAIN) {
+    grain = SORT_MIN_MERGE_GRAIN;
+  }
+  for (j.m_width = 1; j.m_width < n_runs; j.m_width *= 2) {
+    ret = gallus_parallel_for(pptr, 0, nelem, grain,
+                              s_merge_slice, (void *)&j);
+    if (unlikely(ret != GALLUS_RESULT_OK)) {
+      goto done;
+    }
+    p = j.m_src;
+    j.m_src = j.m_dst;
+    j.m_dst = p;
+  }
+
+  if (j.m_src != (uint8_t *)array) {
+    ret = gallus_parallel_for(pptr, 0, nelem, grain,
+                              s_copy_slice, (void *)&j);
+  }
+
+done:
+  free((void *)j.m_bounds);
+  free((void *)tmp);
+  return ret;
+}
@@ -8,11 +8,11 @@
 
 typedef struct gallus_statistic_struct {
   const char *m_name;
-  volatile size_t m_n;
-  volatile int64_t m_min;
-  volatile int64_t m_max;
-  volatile int64_t m_sum;
-  volatile int64_t m_sum2;
+  size_t m_n;
+  int64_t m_min;
+  int64_t m_max;
+  int64_t m_sum;
+  int64_t m_sum2;
 } gallus_statistic_struct;
 
 
@@ -182,11 +182,11 @@ s_find_stat(gallus_statistic_t *sptr, const char *name) {
 static inline gallus_result_t
 s_reset_stat(gallus_statistic_t s) {
   if (likely(s != NULL)) {
-    s->m_n = 0LL;
-    s->m_min = LLONG_MAX;
-    s->m_max = LLONG_MIN;
-    s->m_sum = 0LL;
-    s->m_sum2 = 0LL;
+    gallus_atomic_store(&(s->m_n), 0LL, RELAXED);
+    gallus_atomic_store(&(s->m_min), LLONG_MAX, RELAXED);
+    gallus_atomic_store(&(s->m_max), LLONG_MIN, RELAXED);
+    gallus_atomic_store(&(s->m_sum), 0LL, RELAXED);
+    gallus_atomic_store(&(s->m_sum2), 0LL, RELAXED);
     return GALLUS_RESULT_OK;
   } else {
     return GALLUS_RESULT_INVALID_ARGS;
@@ -197,11 +197,9 @@ s_reset_stat(gallus_statistic_t s) {
 static inline gallus_result_t
 s_record_stat(gallus_statistic_t s, int64_t val) {
   /*
-   * TODO:
-   *
-   *	Well. should I use a mutex to provide the atomicity? I wonder
-   *	four or more atomic operations costs more than takig a mutex
-   *	lock or not.
+   * Each field is atomic on its own and nobody synchronizes with
+   * them, so the relaxed ordering. The readers may see the fields of
+   * different records, which is fine for statistics.
    */
 
   if (likely(s != NULL)) {
@@ -209,9 +207,9 @@ s_record_stat(gallus_statistic_t s, int64_t val) {
 
     sum2 = val * val;
 
-    (void)__sync_add_and_fetch(&(s->m_n), 1);
-    (void)__sync_add_and_fetch(&(s->m_sum), val);
-    (void)__sync_add_and_fetch(&(s->m_sum2), sum2);
+    (void)gallus_atomic_fetch_add(&(s->m_n), 1, RELAXED);
+    (void)gallus_atomic_fetch_add(&(s->m_sum), val, RELAXED);
+    (void)gallus_atomic_fetch_add(&(s->m_sum2), sum2, RELAXED);
 
     gallus_atomic_update_min(int64_t, &(s->m_min), LLONG_MAX, val);
     gallus_atomic_update_max(int64_t, &(s->m_max), LLONG_MIN, val);
@@ -226,7 +224,7 @@ s_record_stat(gallus_statistic_t s, int64_t val) {
 static inline gallus_result_t
 s_get_n_stat(gallus_statistic_t s) {
   if (likely(s != NULL)) {
-    return (gallus_result_t)(__sync_fetch_and_add(&(s->m_n), 0));
+    return (gallus_result_t)(gallus_atomic_load(&(s->m_n), RELAXED));
   } else {
     return GALLUS_RESULT_INVALID_ARGS;
   }
@@ -236,7 +234,7 @@ s_get_n_stat(gallus_statistic_t s) {
 static inline gallus_result_t
 s_get_min_stat(gallus_statistic_t s, int64_t *valptr) {
   if (likely(s != NULL && valptr != NULL)) {
-    *valptr = (__sync_fetch_and_add(&(s->m_min), 0));
+    *valptr = (gallus_atomic_load(&(s->m_min), RELAXED));
     return GALLUS_RESULT_OK;
   } else {
     return GALLUS_RESULT_INVALID_ARGS;
@@ -247,7 +245,7 @@ s_get_min_stat(gallus_statistic_t s, int64_t *valptr) {
 static inline gallus_result_t
 s_get_max_stat(gallus_statistic_t s, int64_t *valptr) {
   if (likely(s != NULL && valptr != NULL)) {
-    *valptr = (__sync_fetch_and_add(&(s->m_max), 0));
+    *valptr = (gallus_atomic_load(&(s->m_max), RELAXED));
     return GALLUS_RESULT_OK;
   } else {
     return GALLUS_RESULT_INVALID_ARGS;
@@ -258,10 +256,10 @@ s_get_max_stat(gallus_statistic_t s, int64_t *valptr) {
 static inline gallus_result_t
 s_get_avg_stat(gallus_statistic_t s, double *valptr) {
   if (likely(s != NULL && valptr != NULL)) {
-    int64_t n = (int64_t)__sync_fetch_and_add(&(s->m_n), 0); 
+    int64_t n = (int64_t)gallus_atomic_load(&(s->m_n), RELAXED);
 
     if (n > 0) {
-      double sum = (double)__sync_fetch_and_add(&(s->m_sum), 0);
+      double sum = (double)gallus_atomic_load(&(s->m_sum), RELAXED);
       *valptr = sum / (double)n;
     } else {
       *valptr = 0.0;
@@ -278,13 +276,13 @@ s_get_avg_stat(gallus_statistic_t s, double *valptr) {
 static inline gallus_result_t
 s_get_sd_stat(gallus_statistic_t s, double *valptr, bool is_ssd) {
   if (likely(s != NULL && valptr != NULL)) {
-    int64_t n = (int64_t)__sync_fetch_and_add(&(s->m_n), 0);
+    int64_t n = (int64_t)gallus_atomic_load(&(s->m_n), RELAXED);
 
     if (n == 0) {
       *valptr = 0.0;
     } else {
-      double sum = (double)__sync_fetch_and_add(&(s->m_sum), 0);
-      double sum2 = (double)__sync_fetch_and_add(&(s->m_sum2), 0);
+      double sum = (double)gallus_atomic_load(&(s->m_sum), RELAXED);
+      double sum2 = (double)gallus_atomic_load(&(s->m_sum2), RELAXED);
       double avg = sum / (double)n;
       double ssum = 
           sum2 -
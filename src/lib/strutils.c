@@ -21,34 +21,39 @@
 
 
 static pthread_once_t s_once = PTHREAD_ONCE_INIT;
-static bool s_is_inited = false;
 
-static MP_INT s_0;
-static MP_INT s_1;
-static MP_INT s_neg1;
-
-static MP_INT s_SHRT_MIN;
-static MP_INT s_SHRT_MAX;
-static MP_INT s_USHRT_MAX;
-
-static MP_INT s_INT_MIN;
-static MP_INT s_INT_MAX;
-static MP_INT s_UINT_MAX;
-
-static MP_INT s_LONG_MIN;
-static MP_INT s_LONG_MAX;
-static MP_INT s_ULONG_MAX;
-
-static MP_INT s_LLONG_MIN;
-static MP_INT s_LLONG_MAX;
-static MP_INT s_ULLONG_MAX;
-
-static MP_INT s_mult[8];
-static MP_INT s_mult_i[8];
-static gallus_hashmap_t s_mult_tbl;
+/*
+ * Digit values, 0xff for non-digits. Letters are case insensitive up
+ * to base 36, above it 'A'-'Z' are 10-35 and 'a'-'z' are 36-61.
+ */
+#define NOT_A_DIGIT	0xff
+static uint8_t s_digits_ci[256];
+static uint8_t s_digits_cs[256];
+
+/*
+ * The SI prefix multipliers, 1000^(n + 1) and 1024^(n + 1) for k, m,
+ * g, t, p, x, z and y. 0 stands for the ones not fitting in 64 bits.
+ */
+static const uint64_t s_mult[8] = {
+  1000ULL,
+  1000000ULL,
+  1000000000ULL,
+  1000000000000ULL,
+  1000000000000000ULL,
+  1000000000000000000ULL,
+  0, 0
+};
+static const uint64_t s_mult_i[8] = {
+  1ULL << 10,
+  1ULL << 20,
+  1ULL << 30,
+  1ULL << 40,
+  1ULL << 50,
+  1ULL << 60,
+  0, 0
+};
 
 static void s_ctors(void) __attr_constructor__(103);
-static void s_dtors(void) __attr_destructor__(103);
 
 
 
@@ -56,137 +61,21 @@ static void s_dtors(void) __attr_destructor__(103);
 
 static void
 s_once_proc(void) {
-  size_t i;
-  size_t j;
-  gallus_result_t r;
-  void *v;
-  char buf[64];
-
-  if (mpz_init_set_str(&s_0, "0", 10) != 0) {
-    gallus_exit_fatal("can't initialize '0' to an MP_INT.\n");
-  }
-  if (mpz_init_set_str(&s_1, "1", 10) != 0) {
-    gallus_exit_fatal("can't initialize '1' to an MP_INT.\n");
-  }
-  if (mpz_init_set_str(&s_neg1, "-1", 10) != 0) {
-    gallus_exit_fatal("can't initialize '-1' to an MP_INT.\n");
-  }
+  int c;
 
+  (void)memset((void *)s_digits_ci, NOT_A_DIGIT, sizeof(s_digits_ci));
+  (void)memset((void *)s_digits_cs, NOT_A_DIGIT, sizeof(s_digits_cs));
 
-  if ((r = gallus_hashmap_create(&s_mult_tbl,
-                                  GALLUS_HASHMAP_TYPE_STRING, NULL)) !=
-      GALLUS_RESULT_OK) {
-    gallus_perror(r);
-    gallus_exit_fatal("can't initialize an SI prefix multiplier table.\n");
+  for (c = '0'; c <= '9'; c++) {
+    s_digits_ci[c] = s_digits_cs[c] = (uint8_t)(c - '0');
   }
-
-  for (i = 0; i < 8; i++) {
-    if (mpz_init_set_str(&(s_mult[i]), "1000", 10) != 0) {
-      gallus_exit_fatal("can't initialize '1000' to an MP_INT.\n");
-    }
-    if (mpz_init_set_str(&(s_mult_i[i]), "1024", 10) != 0) {
-      gallus_exit_fatal("can't initialize '1024' to an MP_INT.\n");
-    }
-    for (j = 0; j < i; j++) {
-      mpz_mul(&(s_mult[i]), &(s_mult[i]), &(s_mult[0]));
-      mpz_mul(&(s_mult_i[i]), &(s_mult_i[i]), &(s_mult_i[0]));
-    }
-  }
-
-  v = (void *)&(s_mult[0]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"k", &v, false);
-  v = (void *)&(s_mult_i[0]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"ki", &v, false);
-
-  v = (void *)&(s_mult[1]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"m", &v, false);
-  v = &(s_mult_i[1]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"mi", &v, false);
-
-  v = (void *)&(s_mult[2]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"g", &v, false);
-  v = (void *)&(s_mult_i[2]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"gi", &v, false);
-
-  v = (void *)&(s_mult[3]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"t", &v, false);
-  v = (void *)&(s_mult_i[3]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"ti", &v, false);
-
-  v = (void *)&(s_mult[4]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"p", &v, false);
-  v = (void *)&(s_mult_i[4]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"pi", &v, false);
-
-  v = (void *)&(s_mult[5]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"x", &v, false);
-  v = (void *)&(s_mult_i[5]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"xi", &v, false);
-
-  v = (void *)&(s_mult[6]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"z", &v, false);
-  v = (void *)&(s_mult_i[6]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"zi", &v, false);
-
-  v = (void *)&(s_mult[7]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"y", &v, false);
-  v = (void *)&(s_mult_i[7]);
-  (void)gallus_hashmap_add(&s_mult_tbl, (void *)"yi", &v, false);
-
-
-  snprintf(buf, sizeof(buf), "%d", SHRT_MIN);
-  if (mpz_init_set_str(&s_SHRT_MIN, buf, 10) != 0) {
-    gallus_exit_fatal("can't initialize SHRT_MIN to an MP_INT.\n");
-  }
-  snprintf(buf, sizeof(buf), "%d", SHRT_MAX);
-  if (mpz_init_set_str(&s_SHRT_MAX, buf, 10) != 0) {
-    gallus_exit_fatal("can't initialize SHRT_MAX to an MP_INT.\n");
-  }
-  snprintf(buf, sizeof(buf), "%u", USHRT_MAX);
-  if (mpz_init_set_str(&s_USHRT_MAX, buf, 10) != 0) {
-    gallus_exit_fatal("can't initialize USHRT_MAX to an MP_INT.\n");
+  for (c = 'a'; c <= 'z'; c++) {
+    s_digits_ci[c] = (uint8_t)(c - 'a' + 10);
+    s_digits_cs[c] = (uint8_t)(c - 'a' + 36);
   }
-
-  snprintf(buf, sizeof(buf), "%d", INT_MIN);
-  if (mpz_init_set_str(&s_INT_MIN, buf, 10) != 0) {
-    gallus_exit_fatal("can't initialize INT_MIN to an MP_INT.\n");
-  }
-  snprintf(buf, sizeof(buf), "%d", INT_MAX);
-  if (mpz_init_set_str(&s_INT_MAX, buf, 10) != 0) {
-    gallus_exit_fatal("can't initialize INT_MAX to an MP_INT.\n");
-  }
-  snprintf(buf, sizeof(buf), "%u", UINT_MAX);
-  if (mpz_init_set_str(&s_UINT_MAX, buf, 10) != 0) {
-    gallus_exit_fatal("can't initialize UINT_MAX to an MP_INT.\n");
-  }
-
-  snprintf(buf, sizeof(buf), "%ld", LONG_MIN);
-  if (mpz_init_set_str(&s_LONG_MIN, buf, 10) != 0) {
-    gallus_exit_fatal("can't initialize LONG_MIN to an MP_INT.\n");
+  for (c = 'A'; c <= 'Z'; c++) {
+    s_digits_ci[c] = s_digits_cs[c] = (uint8_t)(c - 'A' + 10);
   }
-  snprintf(buf, sizeof(buf), "%ld", LONG_MAX);
-  if (mpz_init_set_str(&s_LONG_MAX, buf, 10) != 0) {
-    gallus_exit_fatal("can't initialize LONG_MAX to an MP_INT.\n");
-  }
-  snprintf(buf, sizeof(buf), "%lu", ULONG_MAX);
-  if (mpz_init_set_str(&s_ULONG_MAX, buf, 10) != 0) {
-    gallus_exit_fatal("can't initialize ULONG_MAX to an MP_INT.\n");
-  }
-
-  snprintf(buf, sizeof(buf), "%lld", LLONG_MIN);
-  if (mpz_init_set_str(&s_LLONG_MIN, buf, 10) != 0) {
-    gallus_exit_fatal("can't initialize LLONG_MIN to an MP_INT.\n");
-  }
-  snprintf(buf, sizeof(buf), "%lld", LLONG_MAX);
-  if (mpz_init_set_str(&s_LLONG_MAX, buf, 10) != 0) {
-    gallus_exit_fatal("can't initialize LLONG_MAX to an MP_INT.\n");
-  }
-  snprintf(buf, sizeof(buf), "%llu", ULLONG_MAX);
-  if (mpz_init_set_str(&s_ULLONG_MAX, buf, 10) != 0) {
-    gallus_exit_fatal("can't initialize ULLONG_MAX to an MP_INT.\n");
-  }
-
-  s_is_inited = true;
 }
 
 
@@ -203,218 +92,221 @@ s_ctors(void) {
 }
 
 
-static inline void
-s_final(void) {
-  size_t i;
+
 
-  mpz_clear(&s_0);
-  mpz_clear(&s_1);
-  mpz_clear(&s_neg1);
 
-  for (i = 0; i < 8; i++) {
-    mpz_clear(&(s_mult[i]));
-    mpz_clear(&(s_mult_i[i]));
+/*
+ * Strip the SI prefix off the tail of [str, *endptr) and return its
+ * multiplier in *mulptr. The trailing spaces are stripped too, and
+ * so is a trailing 'i' even with no prefix letter before it.
+ */
+static inline bool
+s_strip_prefix_multiplier(const char *str, const char **endptr,
+                          uint64_t *mulptr) {
+  const char *e = *endptr;
+  bool got_i = false;
+  int idx = -1;
+
+#define rtrim()                                                 \
+  while (e > str && isspace((int)(unsigned char)e[-1]) != 0) {  \
+    e--;                                                        \
   }
 
-  mpz_clear(&s_SHRT_MIN);
-  mpz_clear(&s_SHRT_MAX);
-  mpz_clear(&s_USHRT_MAX);
-
-  mpz_clear(&s_INT_MIN);
-  mpz_clear(&s_INT_MAX);
-  mpz_clear(&s_UINT_MAX);
+  rtrim();
+  if (e == str) {
+    return false;
+  }
 
-  mpz_clear(&s_LONG_MIN);
-  mpz_clear(&s_LONG_MAX);
-  mpz_clear(&s_ULONG_MAX);
+  if (e[-1] == 'i' || e[-1] == 'I') {
+    got_i = true;
+    e--;
+    rtrim();
+    if (e == str) {
+      /*
+       * Got only 'i'/'I'.
+       */
+      return false;
+    }
+  }
 
-  mpz_clear(&s_LLONG_MIN);
-  mpz_clear(&s_LLONG_MAX);
-  mpz_clear(&s_ULLONG_MAX);
+  switch ((int)e[-1]) {
+    case 'K' : case 'k': {
+      idx = 0;
+      break;
+    }
+    case 'M' : case 'm': {
+      idx = 1;
+      break;
+    }
+    case 'G' : case 'g': {
+      idx = 2;
+      break;
+    }
+    case 'T' : case 't': {
+      idx = 3;
+      break;
+    }
+    case 'P' : case 'p': {
+      idx = 4;
+      break;
+    }
+    case 'X' : case 'x': {
+      idx = 5;
+      break;
+    }
+    case 'Z' : case 'z': {
+      idx = 6;
+      break;
+    }
+    case 'Y' : case 'y': {
+      idx = 7;
+      break;
+    }
+  }
 
-  gallus_hashmap_destroy(&s_mult_tbl, true);
-}
+  if (idx >= 0) {
+    e--;
+    rtrim();
+    if (e == str) {
+      return false;
+    }
+  }
 
+#undef rtrim
 
-static void
-s_dtors(void) {
-  if (s_is_inited == true) {
-    if (gallus_module_is_unloading() &&
-        gallus_module_is_finalized_cleanly()) {
-      s_final();
+  *endptr = e;
+  *mulptr = (idx < 0) ? 1 :
+            ((got_i == true) ? s_mult_i[idx] : s_mult[idx]);
 
-      gallus_msg_debug(5, "The string utility module finalized.\n");
-    } else {
-      gallus_msg_debug(10, "The string utility module is not finalized "
-                    "because of module finalization problem.\n");
-    }
-  }
+  return true;
 }
 
 
-
-
+#ifdef GALLUS_LITTLE_ENDIAN
+/*
+ * SWAR: eight ASCII decimal digits in a word at once, the first
+ * digit in the lowest byte.
+ */
+static inline bool
+s_is_8_digits(uint64_t v) {
+  return (((v & 0xf0f0f0f0f0f0f0f0ULL) |
+           (((v + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) >> 4)) ==
+          0x3333333333333333ULL) ? true : false;
+}
 
-static inline const MP_INT *
-s_get_prefix_multiplier(char *str) {
-  const MP_INT *ret = NULL;
-  size_t len = strlen(str);
 
-  if (len > 0) {
-    bool got_i = false;
-    const char *key = NULL;
-    char *endp;
-    size_t l_c;
-    bool do_trim_last = false;
+static inline uint64_t
+s_8_digits_value(uint64_t v) {
+  v = ((v & 0x0f0f0f0f0f0f0f0fULL) * 2561) >> 8;
+  v = ((v & 0x00ff00ff00ff00ffULL) * 6553601) >> 16;
+  return ((v & 0x0000ffff0000ffffULL) * 42949672960001ULL) >> 32;
+}
+#endif /* GALLUS_LITTLE_ENDIAN */
+
+
+/*
+ * Parse [str, end) in the way mpz_set_str() does: an optional '-', a
+ * digit, then digits and spaces, the spaces ignored. The magnitude
+ * goes to *valptr and a '-' flips *is_negptr.
+ *
+ *	GALLUS_RESULT_OK		Succeeded.
+ *	GALLUS_RESULT_OUT_OF_RANGE	Well formed, but exceeds 64 bits.
+ *	GALLUS_RESULT_INVALID_ARGS	Not a number.
+ */
+static inline gallus_result_t
+s_parse_digits(const char *str, const char *end, unsigned int base,
+               bool *is_negptr, uint64_t *valptr) {
+  const uint8_t *p = (const uint8_t *)str;
+  const uint8_t *e = (const uint8_t *)end;
+  const uint8_t *tbl = (base <= 36) ? s_digits_ci : s_digits_cs;
+  uint64_t v = 0;
+  bool is_over = false;
+  unsigned int d;
+
+  if (unlikely(base < 2 || base > 62)) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
 
-    endp = &str[len];
-    trim_spaces(str, endp);
+  while (p < e && isspace((int)*p) != 0) {
+    p++;
+  }
+  if (p < e && *p == '-') {
+    *is_negptr = (*is_negptr == true) ? false : true;
+    p++;
+  }
+  if (unlikely(p >= e || tbl[*p] >= base)) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
 
-    len = strlen(str);
-    if (len < 1) {
-      goto done;
-    }
+  while (p < e) {
 
-    if (((int)(str[len - 1])) == 'i' ||
-        ((int)(str[len - 1])) == 'I') {
-      got_i = true;
-      len--;
-      if (len < 1) {
-        /*
-         * Got only 'i'/'I'.
-         */
-        goto done;
-      }
-      endp = &(str[len]);
-      *endp = '\0';
-      trim_spaces(str, endp);
-    }
+#ifdef GALLUS_LITTLE_ENDIAN
+    if (base == 10 && e - p >= 8) {
+      uint64_t w;
 
-    len = strlen(str);
-    if (len < 1) {
-      goto done;
-    }
-    endp = &str[len];
-    trim_spaces(str, endp);
-
-    l_c = len - 1;
-    switch ((int)str[l_c]) {
-      case 'K' : case 'k': {
-        key = (got_i == true) ? "ki" : "k";
-        do_trim_last = true;
-        break;
-      }
-      case 'M' : case 'm': {
-        key = (got_i == true) ? "mi" : "m";
-        do_trim_last = true;
-        break;
-      }
-      case 'G' : case 'g': {
-        key = (got_i == true) ? "gi" : "g";
-        do_trim_last = true;
-        break;
-      }
-      case 'T' : case 't': {
-        key = (got_i == true) ? "ti" : "t";
-        do_trim_last = true;
-        break;
-      }
-      case 'P' : case 'p': {
-        key = (got_i == true) ? "pi" : "p";
-        do_trim_last = true;
-        break;
-      }
-      case 'X' : case 'x': {
-        key = (got_i == true) ? "xi" : "x";
-        do_trim_last = true;
-        break;
-      }
-      case 'Z' : case 'z': {
-        key = (got_i == true) ? "zi" : "z";
-        do_trim_last = true;
-        break;
-      }
-      case 'Y' : case 'y': {
-        key = (got_i == true) ? "yi" : "y";
-        do_trim_last = true;
-        break;
+      (void)memcpy((void *)&w, (const void *)p, sizeof(w));
+      if (s_is_8_digits(w) == true) {
+        if (likely(is_over == false)) {
+          is_over =
+              (__builtin_mul_overflow(v, 100000000ULL, &v) ||
+               __builtin_add_overflow(v, s_8_digits_value(w), &v)) ?
+              true : false;
+        }
+        p += 8;
+        continue;
       }
     }
-
-    if (do_trim_last == true) {
-      endp = &(str[l_c]);
-      *endp = '\0';
-      trim_spaces(str, endp);
-    }
-    if (strlen(str) < 1) {
-      goto done;
-    }
-
-    if (key != NULL) {
-      void *val = NULL;
-      gallus_result_t r;
-      if ((r = gallus_hashmap_find(&s_mult_tbl, (void *)key, &val)) ==
-          GALLUS_RESULT_OK &&
-          val != NULL) {
-        ret = val;
-      } else {
-        gallus_exit_fatal("can't find a multiplier for '%s', "
-                           "must not happen.\n", key);
+#endif /* GALLUS_LITTLE_ENDIAN */
+
+    if ((d = tbl[*p]) < base) {
+      if (likely(is_over == false)) {
+        is_over =
+            (__builtin_mul_overflow(v, (uint64_t)base, &v) ||
+             __builtin_add_overflow(v, (uint64_t)d, &v)) ?
+            true : false;
       }
-    } else {
-      ret = &s_1;
+    } else if (isspace((int)*p) == 0) {
+      return GALLUS_RESULT_INVALID_ARGS;
     }
+    p++;
   }
 
-done:
-  return ret;
+  *valptr = v;
+
+  return (is_over == false) ?
+         GALLUS_RESULT_OK : GALLUS_RESULT_OUT_OF_RANGE;
 }
 
 
-static inline bool
-s_parse_bigint_by_base(const char *str, MP_INT *valptr, unsigned int base) {
-  bool ret = false;
-  bool is_neg = false;
+static inline gallus_result_t
+s_parse_int_by_base(const char *str, unsigned int base,
+                    bool *is_negptr, uint64_t *valptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  const char *end;
+  uint64_t mul = 1;
 
   skip_spaces(str);
-  if (IS_VALID_STRING(str) == true) {
-    switch ((int)str[0]) {
-      case '-': {
-        is_neg = true;
-        str++;
-        break;
-      }
-      case '+': {
-        str++;
-        break;
-      }
-    }
+  if (*str == '-') {
+    *is_negptr = (*is_negptr == true) ? false : true;
+    str++;
+  } else if (*str == '+') {
+    str++;
   }
 
   skip_spaces(str);
-  if (IS_VALID_STRING(str) == true) {
-    char *buf = strdup(str);
-    if (buf != NULL) {
-      size_t len;
-      if ((len = strlen(buf)) > 0) {
-        const MP_INT *mul = NULL;
-        char *endp = &(buf[len]);
-
-        trim_spaces(buf, endp);
-        mul = s_get_prefix_multiplier(buf);
-        if (mul != NULL) {
-          MP_INT tmp;
-          if (mpz_init_set_str(&tmp, buf, (int)base) == 0) {
-            mpz_mul(valptr, &tmp, mul);
-            if (is_neg == true) {
-              mpz_neg(valptr, valptr);
-            }
-            ret = true;
-          }
-          mpz_clear(&tmp);
-        }
-      }
-      free((void *)buf);
+  if (IS_VALID_STRING(str) == false) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  end = str + strlen(str);
+  if (s_strip_prefix_multiplier(str, &end, &mul) == false) {
+    return GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  ret = s_parse_digits(str, end, base, is_negptr, valptr);
+  if (ret == GALLUS_RESULT_OK && *valptr != 0) {
+    if (mul == 0 || __builtin_mul_overflow(*valptr, mul, valptr)) {
+      ret = GALLUS_RESULT_OUT_OF_RANGE;
     }
   }
 
@@ -422,8 +314,8 @@ s_parse_bigint_by_base(const char *str, MP_INT *valptr, unsigned int base) {
 }
 
 
-static inline bool
-s_parse_bigint(const char *str, MP_INT *valptr) {
+static inline gallus_result_t
+s_parse_int(const char *str, bool *is_negptr, uint64_t *valptr) {
   /*
    * str := str2 | str8 | str10 | str16
    * str2 :=
@@ -436,23 +328,14 @@ s_parse_bigint(const char *str, MP_INT *valptr) {
    *	[[:space:]]*[\-\+][0\\]x[[:space:]]*[0-9a-fA-F]+[[:space:]]*([kKmMgGtTpP]+[i]*)*
    */
 
-  bool ret = false;
-  bool is_neg = false;
   unsigned int base = 10;
 
   skip_spaces(str);
-  if (IS_VALID_STRING(str) == true) {
-    switch ((int)str[0]) {
-      case '-': {
-        is_neg = true;
-        str++;
-        break;
-      }
-      case '+': {
-        str++;
-        break;
-      }
-    }
+  if (*str == '-') {
+    *is_negptr = (*is_negptr == true) ? false : true;
+    str++;
+  } else if (*str == '+') {
+    str++;
   }
 
   skip_spaces(str);
@@ -475,118 +358,43 @@ s_parse_bigint(const char *str, MP_INT *valptr) {
   }
 
   skip_spaces(str);
-  if (IS_VALID_STRING(str) == true) {
-    char *buf = strdup(str);
-    if (buf != NULL) {
-      if (s_parse_bigint_by_base(buf, valptr, base) == true) {
-        if (is_neg == true) {
-          mpz_neg(valptr, valptr);
-        }
-        ret = true;
-      }
-      free((void *)buf);
-    }
+  if (IS_VALID_STRING(str) == false) {
+    return GALLUS_RESULT_INVALID_ARGS;
   }
 
-  return ret;
-}
-
-
-static inline bool
-s_mpz_ge(MP_INT *z1, MP_INT *z2) {
-  return ((mpz_cmp(z1, z2) > 0) || (mpz_cmp(z1, z2) == 0)) ?
-         true : false;
-}
-
-
-static inline bool
-s_mpz_le(MP_INT *z1, MP_INT *z2) {
-  return ((mpz_cmp(z1, z2) < 0) || (mpz_cmp(z1, z2) == 0)) ?
-         true : false;
+  return s_parse_int_by_base(str, base, is_negptr, valptr);
 }
 
 
+/*
+ * The range is [-neg_max, pos_max] in the magnitudes.
+ */
 static inline gallus_result_t
-s_parse_bigint_by_base_in_range(const char *str, MP_INT *valptr,
-                                unsigned int base,
-                                MP_INT *lower, MP_INT *upper) {
-  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
-
-  if (s_parse_bigint_by_base(str, valptr, base) == true) {
-    if (s_mpz_ge(valptr, lower) == true &&
-        s_mpz_le(valptr, upper) == true) {
-      ret = GALLUS_RESULT_OK;
-    } else {
-      ret = GALLUS_RESULT_OUT_OF_RANGE;
+s_check_range(gallus_result_t r, bool is_neg, uint64_t v,
+              uint64_t neg_max, uint64_t pos_max) {
+  if (r == GALLUS_RESULT_OK) {
+    if ((is_neg == true && v > neg_max) ||
+        (is_neg == false && v > pos_max)) {
+      r = GALLUS_RESULT_OUT_OF_RANGE;
     }
-  } else {
-    ret = GALLUS_RESULT_INVALID_ARGS;
   }
 
-  return ret;
+  return r;
 }
 
 
-static inline gallus_result_t
-s_parse_bigint_in_range(const char *str, MP_INT *valptr,
-                        MP_INT *lower, MP_INT *upper) {
-  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
-
-  if (s_parse_bigint(str, valptr) == true) {
-    if (s_mpz_ge(valptr, lower) == true &&
-        s_mpz_le(valptr, upper) == true) {
-      ret = GALLUS_RESULT_OK;
-    } else {
-      ret = GALLUS_RESULT_OUT_OF_RANGE;
-    }
-  } else {
-    ret = GALLUS_RESULT_INVALID_ARGS;
-  }
-
-  return ret;
+static inline int64_t
+s_signed_value(bool is_neg, uint64_t v) {
+  return (is_neg == true) ? (int64_t)(0ULL - v) : (int64_t)v;
 }
 
 
-
-
-
-#ifdef GALLUS_ARCH_32_BITS
-static inline uint64_t
-s_bignum_2_uint64_t(MP_INT *v) {
-  uint64_t ret;
-  uint32_t lo, hi;
-  MP_INT posv;
-  MP_INT z_lo;
-  MP_INT z_hi;
-  bool is_neg = (mpz_sgn(v) < 0) ? true : false;
-
-  mpz_init(&z_lo);
-  mpz_init(&z_hi);
-  if (is_neg == true) {
-    mpz_init(&posv);
-    mpz_neg(&posv, v);
-    v = &posv;
-  }
+#define INT64_NEG_MAX	((uint64_t)INT64_MAX + 1ULL)
+#define INT32_NEG_MAX	((uint64_t)INT32_MAX + 1ULL)
+#define INT16_NEG_MAX	((uint64_t)INT16_MAX + 1ULL)
 
-  mpz_tdiv_q_2exp(&z_hi, v, 32);
-  mpz_tdiv_r_2exp(&z_lo, v, 32);
 
-  hi = mpz_get_ui(&z_hi);
-  lo = mpz_get_ui(&z_lo);
-  mpz_clear(&z_hi);
-  mpz_clear(&z_lo);
-
-  ret = ((uint64_t)hi << 32) | (uint64_t)lo;
-
-  if (is_neg == true) {
-    ret--;
-    ret = ~ret;
-    mpz_clear(&posv);
-  }
-
-  return ret;
-}
-#endif /* GALLUS_ARCH_32_BITS */
+
 
 
 gallus_result_t
@@ -597,22 +405,15 @@ gallus_str_parse_int64_by_base(const char *buf, int64_t *val,
   if (IS_VALID_STRING(buf) == true &&
       val != NULL &&
       base > 1) {
-    MP_INT v;
-    mpz_init(&v);
+    bool is_neg = false;
+    uint64_t v = 0;
 
-    if ((ret = s_parse_bigint_by_base_in_range(buf, &v, base,
-               &s_LLONG_MIN, &s_LLONG_MAX)) ==
+    ret = s_parse_int_by_base(buf, base, &is_neg, &v);
+    if ((ret = s_check_range(ret, is_neg, v,
+                             INT64_NEG_MAX, INT64_MAX)) ==
         GALLUS_RESULT_OK) {
-
-#ifdef GALLUS_ARCH_64_BITS
-      *val = (int64_t)mpz_get_si(&v);
-#else
-      *val = (int64_t)s_bignum_2_uint64_t(&v);
-#endif /* GALLUS_ARCH_64_BITS */
-
+      *val = s_signed_value(is_neg, v);
     }
-
-    mpz_clear(&v);
   }
 
   return ret;
@@ -627,22 +428,14 @@ gallus_str_parse_uint64_by_base(const char *buf, uint64_t *val,
   if (IS_VALID_STRING(buf) == true &&
       val != NULL &&
       base > 1) {
-    MP_INT v;
-    mpz_init(&v);
+    bool is_neg = false;
+    uint64_t v = 0;
 
-    if ((ret = s_parse_bigint_by_base_in_range(buf, &v, base,
-               &s_0, &s_ULLONG_MAX)) ==
+    ret = s_parse_int_by_base(buf, base, &is_neg, &v);
+    if ((ret = s_check_range(ret, is_neg, v, 0, UINT64_MAX)) ==
         GALLUS_RESULT_OK) {
-
-#ifdef GALLUS_ARCH_64_BITS
-      *val = (uint64_t)mpz_get_ui(&v);
-#else
-      *val = s_bignum_2_uint64_t(&v);
-#endif /* GALLUS_ARCH_64_BITS */
-
+      *val = v;
     }
-
-    mpz_clear(&v);
   }
 
   return ret;
@@ -655,22 +448,15 @@ gallus_str_parse_int64(const char *buf, int64_t *val) {
 
   if (IS_VALID_STRING(buf) == true &&
       val != NULL) {
-    MP_INT v;
-    mpz_init(&v);
+    bool is_neg = false;
+    uint64_t v = 0;
 
-    if ((ret = s_parse_bigint_in_range(buf, &v,
-                                       &s_LLONG_MIN, &s_LLONG_MAX)) ==
+    ret = s_parse_int(buf, &is_neg, &v);
+    if ((ret = s_check_range(ret, is_neg, v,
+                             INT64_NEG_MAX, INT64_MAX)) ==
         GALLUS_RESULT_OK) {
-
-#ifdef GALLUS_ARCH_64_BITS
-      *val = (int64_t)mpz_get_si(&v);
-#else
-      *val = (int64_t)s_bignum_2_uint64_t(&v);
-#endif /* GALLUS_ARCH_64_BITS */
-
+      *val = s_signed_value(is_neg, v);
     }
-
-    mpz_clear(&v);
   }
 
   return ret;
@@ -683,22 +469,14 @@ gallus_str_parse_uint64(const char *buf, uint64_t *val) {
 
   if (IS_VALID_STRING(buf) == true &&
       val != NULL) {
-    MP_INT v;
-    mpz_init(&v);
+    bool is_neg = false;
+    uint64_t v = 0;
 
-    if ((ret = s_parse_bigint_in_range(buf, &v,
-                                       &s_0, &s_ULLONG_MAX)) ==
+    ret = s_parse_int(buf, &is_neg, &v);
+    if ((ret = s_check_range(ret, is_neg, v, 0, UINT64_MAX)) ==
         GALLUS_RESULT_OK) {
-
-#ifdef GALLUS_ARCH_64_BITS
-      *val = (uint64_t)mpz_get_ui(&v);
-#else
-      *val = s_bignum_2_uint64_t(&v);
-#endif /* GALLUS_ARCH_64_BITS */
-
+      *val = v;
     }
-
-    mpz_clear(&v);
   }
 
   return ret;
@@ -716,24 +494,15 @@ gallus_str_parse_int32_by_base(const char *buf, int32_t *val,
   if (IS_VALID_STRING(buf) == true &&
       val != NULL &&
       base > 1) {
-    MP_INT v;
-    mpz_init(&v);
+    bool is_neg = false;
+    uint64_t v = 0;
 
-    if ((ret = s_parse_bigint_by_base_in_range(buf, &v, base,
-               &s_INT_MIN, &s_INT_MAX)) ==
+    ret = s_parse_int_by_base(buf, base, &is_neg, &v);
+    if ((ret = s_check_range(ret, is_neg, v,
+                             INT32_NEG_MAX, INT32_MAX)) ==
         GALLUS_RESULT_OK) {
-
-#ifdef GALLUS_ARCH_64_BITS
-      int64_t v64 = (int64_t)mpz_get_si(&v);
-      *val = (int32_t)v64;
-#else
-      int64_t v64 = (int64_t)s_bignum_2_uint64_t(&v);
-      *val = (int32_t)v64;
-#endif /* GALLUS_ARCH_64_BITS */
-
+      *val = (int32_t)s_signed_value(is_neg, v);
     }
-
-    mpz_clear(&v);
   }
 
   return ret;
@@ -748,24 +517,14 @@ gallus_str_parse_uint32_by_base(const char *buf, uint32_t *val,
   if (IS_VALID_STRING(buf) == true &&
       val != NULL &&
       base > 1) {
-    MP_INT v;
-    mpz_init(&v);
+    bool is_neg = false;
+    uint64_t v = 0;
 
-    if ((ret = s_parse_bigint_by_base_in_range(buf, &v, base,
-               &s_0, &s_UINT_MAX)) ==
+    ret = s_parse_int_by_base(buf, base, &is_neg, &v);
+    if ((ret = s_check_range(ret, is_neg, v, 0, UINT32_MAX)) ==
         GALLUS_RESULT_OK) {
-
-#ifdef GALLUS_ARCH_64_BITS
-      uint64_t v64 = (uint64_t)mpz_get_ui(&v);
-      *val = (uint32_t)v64;
-#else
-      uint64_t v64 = s_bignum_2_uint64_t(&v);
-      *val = (uint32_t)v64;
-#endif /* GALLUS_ARCH_64_BITS */
-
+      *val = (uint32_t)v;
     }
-
-    mpz_clear(&v);
   }
 
   return ret;
@@ -778,24 +537,15 @@ gallus_str_parse_int32(const char *buf, int32_t *val) {
 
   if (IS_VALID_STRING(buf) == true &&
       val != NULL) {
-    MP_INT v;
-    mpz_init(&v);
+    bool is_neg = false;
+    uint64_t v = 0;
 
-    if ((ret = s_parse_bigint_in_range(buf, &v,
-                                       &s_INT_MIN, &s_INT_MAX)) ==
+    ret = s_parse_int(buf, &is_neg, &v);
+    if ((ret = s_check_range(ret, is_neg, v,
+                             INT32_NEG_MAX, INT32_MAX)) ==
         GALLUS_RESULT_OK) {
-
-#ifdef GALLUS_ARCH_64_BITS
-      int64_t v64 = (int64_t)mpz_get_si(&v);
-      *val = (int32_t)v64;
-#else
-      int64_t v64 = (int64_t)s_bignum_2_uint64_t(&v);
-      *val = (int32_t)v64;
-#endif /* GALLUS_ARCH_64_BITS */
-
+      *val = (int32_t)s_signed_value(is_neg, v);
     }
-
-    mpz_clear(&v);
   }
 
   return ret;
@@ -808,24 +558,14 @@ gallus_str_parse_uint32(const char *buf, uint32_t *val) {
 
   if (IS_VALID_STRING(buf) == true &&
       val != NULL) {
-    MP_INT v;
-    mpz_init(&v);
+    bool is_neg = false;
+    uint64_t v = 0;
 
-    if ((ret = s_parse_bigint_in_range(buf, &v,
-                                       &s_0, &s_UINT_MAX)) ==
+    ret = s_parse_int(buf, &is_neg, &v);
+    if ((ret = s_check_range(ret, is_neg, v, 0, UINT32_MAX)) ==
         GALLUS_RESULT_OK) {
-
-#ifdef GALLUS_ARCH_64_BITS
-      uint64_t v64 = (uint64_t)mpz_get_ui(&v);
-      *val = (uint32_t)v64;
-#else
-      uint64_t v64 = s_bignum_2_uint64_t(&v);
-      *val = (uint32_t)v64;
-#endif /* GALLUS_ARCH_64_BITS */
-
+      *val = (uint32_t)v;
     }
-
-    mpz_clear(&v);
   }
 
   return ret;
@@ -843,24 +583,15 @@ gallus_str_parse_int16_by_base(const char *buf, int16_t *val,
   if (IS_VALID_STRING(buf) == true &&
       val != NULL &&
       base > 1) {
-    MP_INT v;
-    mpz_init(&v);
+    bool is_neg = false;
+    uint64_t v = 0;
 
-    if ((ret = s_parse_bigint_by_base_in_range(buf, &v, base,
-               &s_SHRT_MIN, &s_SHRT_MAX)) ==
+    ret = s_parse_int_by_base(buf, base, &is_neg, &v);
+    if ((ret = s_check_range(ret, is_neg, v,
+                             INT16_NEG_MAX, INT16_MAX)) ==
         GALLUS_RESULT_OK) {
-
-#ifdef GALLUS_ARCH_64_BITS
-      int64_t v64 = (int64_t)mpz_get_si(&v);
-      *val = (int16_t)v64;
-#else
-      int64_t v64 = (int64_t)s_bignum_2_uint64_t(&v);
-      *val = (int16_t)v64;
-#endif /* GALLUS_ARCH_64_BITS */
-
+      *val = (int16_t)s_signed_value(is_neg, v);
     }
-
-    mpz_clear(&v);
   }
 
   return ret;
@@ -875,24 +606,14 @@ gallus_str_parse_uint16_by_base(const char *buf, uint16_t *val,
   if (IS_VALID_STRING(buf) == true &&
       val != NULL &&
       base > 1) {
-    MP_INT v;
-    mpz_init(&v);
+    bool is_neg = false;
+    uint64_t v = 0;
 
-    if ((ret = s_parse_bigint_by_base_in_range(buf, &v, base,
-               &s_0, &s_USHRT_MAX)) ==
+    ret = s_parse_int_by_base(buf, base, &is_neg, &v);
+    if ((ret = s_check_range(ret, is_neg, v, 0, UINT16_MAX)) ==
         GALLUS_RESULT_OK) {
-
-#ifdef GALLUS_ARCH_64_BITS
-      uint64_t v64 = (uint64_t)mpz_get_ui(&v);
-      *val = (uint16_t)v64;
-#else
-      uint64_t v64 = s_bignum_2_uint64_t(&v);
-      *val = (uint16_t)v64;
-#endif /* GALLUS_ARCH_64_BITS */
-
+      *val = (uint16_t)v;
     }
-
-    mpz_clear(&v);
   }
 
   return ret;
@@ -905,24 +626,15 @@ gallus_str_parse_int16(const char *buf, int16_t *val) {
 
   if (IS_VALID_STRING(buf) == true &&
       val != NULL) {
-    MP_INT v;
-    mpz_init(&v);
+    bool is_neg = false;
+    uint64_t v = 0;
 
-    if ((ret = s_parse_bigint_in_range(buf, &v,
-                                       &s_SHRT_MIN, &s_SHRT_MAX)) ==
+    ret = s_parse_int(buf, &is_neg, &v);
+    if ((ret = s_check_range(ret, is_neg, v,
+                             INT16_NEG_MAX, INT16_MAX)) ==
         GALLUS_RESULT_OK) {
-
-#ifdef GALLUS_ARCH_64_BITS
-      int64_t v64 = (int64_t)mpz_get_si(&v);
-      *val = (int16_t)v64;
-#else
-      int64_t v64 = (int64_t)s_bignum_2_uint64_t(&v);
-      *val = (int16_t)v64;
-#endif /* GALLUS_ARCH_64_BITS */
-
+      *val = (int16_t)s_signed_value(is_neg, v);
     }
-
-    mpz_clear(&v);
   }
 
   return ret;
@@ -935,30 +647,21 @@ gallus_str_parse_uint16(const char *buf, uint16_t *val) {
 
   if (IS_VALID_STRING(buf) == true &&
       val != NULL) {
-    MP_INT v;
-    mpz_init(&v);
+    bool is_neg = false;
+    uint64_t v = 0;
 
-    if ((ret = s_parse_bigint_in_range(buf, &v,
-                                       &s_0, &s_USHRT_MAX)) ==
+    ret = s_parse_int(buf, &is_neg, &v);
+    if ((ret = s_check_range(ret, is_neg, v, 0, UINT16_MAX)) ==
         GALLUS_RESULT_OK) {
-
-#ifdef GALLUS_ARCH_64_BITS
-      uint64_t v64 = (uint64_t)mpz_get_ui(&v);
-      *val = (uint16_t)v64;
-#else
-      uint64_t v64 = s_bignum_2_uint64_t(&v);
-      *val = (uint16_t)v64;
-#endif /* GALLUS_ARCH_64_BITS */
-
+      *val = (uint16_t)v;
     }
-
-    mpz_clear(&v);
   }
 
   return ret;
 }
 
 
+
 
 
 
@@ -1091,24 +794,112 @@ gallus_str_parse_bool(const char *buf, bool *val) {
 
 
 
+#define CHARSET_SWAR_MAX	4
+
+
+static inline void
+s_charset_add(gallus_str_charset_t *cs, const char *chars) {
+  const uint8_t *p = (const uint8_t *)chars;
+
+  for (; *p != '\0'; p++) {
+    if ((cs->m_bits[*p >> 6] & (1ULL << (*p & 63))) == 0) {
+      cs->m_bits[*p >> 6] |= 1ULL << (*p & 63);
+      if (cs->m_n < CHARSET_SWAR_MAX) {
+        cs->m_bcast[cs->m_n] = 0x0101010101010101ULL * (uint64_t)*p;
+      }
+      cs->m_n++;
+    }
+  }
+}
+
+
+static inline void
+s_charset_build(gallus_str_charset_t *cs, const char *chars) {
+  (void)memset((void *)cs, 0, sizeof(*cs));
+  s_charset_add(cs, chars);
+}
+
+
+static inline bool
+s_charset_has(const gallus_str_charset_t *cs, char c) {
+  uint8_t u = (uint8_t)c;
+
+  return ((cs->m_bits[u >> 6] & (1ULL << (u & 63))) != 0) ? true : false;
+}
+
+
+/*
+ * Skip the chars in the set.
+ */
+static inline const char *
+s_charset_span(const gallus_str_charset_t *cs, const char *p, const char *e) {
+  while (p < e && s_charset_has(cs, *p) == true) {
+    p++;
+  }
+
+  return p;
+}
+
+
+/*
+ * Find the first char in the set, or the e.
+ */
+static inline const char *
+s_charset_find(const gallus_str_charset_t *cs, const char *p, const char *e) {
+
+#ifdef GALLUS_LITTLE_ENDIAN
+  if (cs->m_n <= CHARSET_SWAR_MAX) {
+    /*
+     * SWAR: a byte of (w ^ bcast) is zero iff it's the char. The
+     * lowest flagged byte is always a real hit.
+     */
+    uint64_t w, x, hit;
+    size_t i;
+
+    while (e - p >= 8) {
+      (void)memcpy((void *)&w, (const void *)p, sizeof(w));
+      for (hit = 0, i = 0; i < cs->m_n; i++) {
+        x = w ^ cs->m_bcast[i];
+        hit |= (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+      }
+      if (hit != 0) {
+        return p + (__builtin_ctzll(hit) >> 3);
+      }
+      p += 8;
+    }
+  }
+#endif /* GALLUS_LITTLE_ENDIAN */
+
+  while (p < e && s_charset_has(cs, *p) == false) {
+    p++;
+  }
+
+  return p;
+}
+
+
+
+
+
 gallus_result_t
 gallus_str_tokenize_with_limit(char *buf, char **tokens,
                                 size_t max, size_t limit, const char *delm) {
   gallus_result_t n = 0;
-  size_t no_delm = 0;
 
   if (IS_VALID_STRING(buf) == true &&
       IS_VALID_STRING(delm) == true) {
+    gallus_str_charset_t cs;
+    char *e = buf + strlen(buf);
 
-    while (*buf != '\0' && (size_t)n < max) {
+    s_charset_build(&cs, delm);
 
-      while (strchr(delm, (int)*buf) != NULL && *buf != '\0') {
-        /*
-         * Increent the pointer while *buf is a delimiter.
-         */
-        buf++;
-      }
-      if (*buf == '\0') {
+    while (buf < e && (size_t)n < max) {
+
+      /*
+       * Increment the pointer while *buf is a delimiter.
+       */
+      buf = (char *)s_charset_span(&cs, buf, e);
+      if (buf == e) {
         break;
       }
       tokens[n] = buf;
@@ -1119,24 +910,12 @@ gallus_str_tokenize_with_limit(char *buf, char **tokens,
         goto done;
       }
 
-      no_delm = 0;
-      while (strchr(delm, (int)*buf) == NULL && *buf != '\0') {
-        no_delm++;
-        buf++;
-      }
-      if (*buf == '\0') {
-        if (no_delm > 0) {
-          n++;
-        }
-        break;
-      }
-      *buf = '\0';
+      buf = (char *)s_charset_find(&cs, buf, e);
       n++;
-      if (*(buf + 1) == '\0') {
+      if (buf == e) {
         break;
-      } else {
-        buf++;
       }
+      *buf++ = '\0';
 
     }
   } else {
@@ -1157,16 +936,21 @@ gallus_str_tokenize_quote(char *buf, char **tokens,
   if (IS_VALID_STRING(buf) == true &&
       IS_VALID_STRING(delm) == true &&
       IS_VALID_STRING(quote) == true) {
+    gallus_str_charset_t ds;
+    gallus_str_charset_t stops;
+    char *e = buf + strlen(buf);
 
-    while (*buf != '\0' && (size_t)n < max) {
+    s_charset_build(&ds, delm);
+    s_charset_build(&stops, delm);
+    s_charset_add(&stops, quote);
 
-      while (*buf != '\0' && strchr(delm, (int)*buf) != NULL) {
-        /*
-         * Increent the pointer while *buf is a delimiter.
-         */
-        buf++;
-      }
-      if (*buf == '\0') {
+    while (buf < e && (size_t)n < max) {
+
+      /*
+       * Increment the pointer while *buf is a delimiter.
+       */
+      buf = (char *)s_charset_span(&ds, buf, e);
+      if (buf == e) {
         break;
       }
       tokens[n] = buf;
@@ -1174,75 +958,74 @@ gallus_str_tokenize_quote(char *buf, char **tokens,
       no_delm = 0;
       cur_quote = 0;
 
-      while (*buf != '\0' && strchr(delm, (int)*buf) == NULL) {
+      while (buf < e) {
+        char *s = buf;
 
-        if (strchr(quote, (int)*buf) != NULL) {
-          /*
-           * Quoted
-           */
-          cur_quote = (int)*buf;
-          /*
-           * terminate the current token.
-           */
-          *buf = '\0';
+        /*
+         * Not quoted up to a delimiter or a quote.
+         */
+        buf = (char *)s_charset_find(&stops, buf, e);
+        no_delm += (size_t)(buf - s);
+        if (buf == e || s_charset_has(&ds, *buf) == true) {
+          break;
+        }
 
-          buf++;
-          if (*buf != '\0') {
-            if (no_delm > 0) {
-              if ((size_t)n < max) {
-                n++;
-              } else {
-                goto done;
-              }
+        /*
+         * Quoted
+         */
+        cur_quote = (int)*buf;
+        /*
+         * terminate the current token.
+         */
+        *buf = '\0';
+
+        buf++;
+        if (buf < e) {
+          if (no_delm > 0) {
+            n++;
+            if ((size_t)n >= max) {
+              goto done;
             }
-            tokens[n] = buf;
-
-            /*
-             * Skip to unquote point.
-             */
-            while (*buf != '\0') {
-              buf = strchr(buf, cur_quote);
-              if (buf != NULL) {
-                if ((int)(*(buf - 1)) == '\\') {
-                  /*
-                   * The current quote letter is escaped by '\\' so
-                   * we are still in the qutoted string.
-                   */
-                  buf++;
-                  continue;
-                } else {
-                  /*
-                   * The string is unqouted for now and increent the
-                   * token count.
-                   */
-                  no_delm = 1;
-                  goto got_token;
-                }
+          }
+          tokens[n] = buf;
+
+          /*
+           * Skip to unquote point.
+           */
+          while (buf < e) {
+            buf = (char *)memchr(buf, cur_quote, (size_t)(e - buf));
+            if (buf != NULL) {
+              if ((int)(*(buf - 1)) == '\\') {
+                /*
+                 * The current quote letter is escaped by '\\' so
+                 * we are still in the qutoted string.
+                 */
+                buf++;
+                continue;
               } else {
-                n = GALLUS_RESULT_QUOTE_NOT_CLOSED;
-                goto done;
+                /*
+                 * The string is unqouted for now and increent the
+                 * token count.
+                 */
+                no_delm = 1;
+                goto got_token;
               }
+            } else {
+              n = GALLUS_RESULT_QUOTE_NOT_CLOSED;
+              goto done;
             }
-          } else {
-            /*
-             * Quotation stated at the tail of the string.
-             */
-            n = GALLUS_RESULT_QUOTE_NOT_CLOSED;
-            goto done;
           }
-
         } else {
           /*
-           * Not quoted.
+           * Quotation stated at the tail of the string.
            */
-          no_delm++;
-          buf++;
+          n = GALLUS_RESULT_QUOTE_NOT_CLOSED;
+          goto done;
         }
-
       }
 
     got_token:
-      if (*buf == '\0') {
+      if (buf == e) {
         if (no_delm > 0) {
           n++;
         }
@@ -1250,7 +1033,7 @@ gallus_str_tokenize_quote(char *buf, char **tokens,
       }
       *buf = '\0';
       n++;
-      if (*(buf + 1) == '\0') {
+      if (buf + 1 == e) {
         break;
       } else {
         buf++;
@@ -1267,6 +1050,54 @@ done:
 }
 
 
+gallus_result_t
+gallus_str_tokenizer_init(gallus_str_tokenizer_t *tkptr,
+                           const char *buf, size_t len, const char *delm) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (tkptr != NULL &&
+      (buf != NULL || len == 0) &&
+      IS_VALID_STRING(delm) == true) {
+    tkptr->m_cur = buf;
+    tkptr->m_end = buf + len;
+    s_charset_build(&(tkptr->m_delms), delm);
+    ret = GALLUS_RESULT_OK;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_str_tokenizer_next(gallus_str_tokenizer_t *tkptr,
+                           gallus_str_token_t *tokptr) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (tkptr != NULL && tokptr != NULL) {
+    const char *s = s_charset_span(&(tkptr->m_delms),
+                                   tkptr->m_cur, tkptr->m_end);
+
+    if (s < tkptr->m_end) {
+      const char *e = s_charset_find(&(tkptr->m_delms), s, tkptr->m_end);
+
+      tokptr->m_str = s;
+      tokptr->m_len = (size_t)(e - s);
+      tkptr->m_cur = (e < tkptr->m_end) ? e + 1 : e;
+      ret = GALLUS_RESULT_OK;
+    } else {
+      tkptr->m_cur = tkptr->m_end;
+      ret = GALLUS_RESULT_EOF;
+    }
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
 gallus_result_t
 gallus_str_unescape(const char *org, const char *escaped,
                      char **retptr) {
@@ -77,6 +77,8 @@ gallus_task_create(gallus_task_t *tptr, size_t sz, const char *name,
     t->m_freeup = freeup_func;
     t->m_flag = 0;
     t->m_tmp_thd = NULL;
+    t->m_next = NULL;
+    t->m_future = NULL;
 
     t->m_state = GALLUS_TASK_STATE_CONSTRUCTED;
 
@@ -133,7 +135,7 @@ gallus_task_run(gallus_task_t *tptr, gallus_pooled_thread_t *ptptr, int flag) {
       (void)gallus_mutex_unlock(&tr->m_lck);
 
       if (likely(ret == GALLUS_RESULT_OK)) {
-        if ((t->m_flag & GALLUS_TASK_DELETE_CONTEXT_AFTER_EXEC) != 0) {
+        if ((flag & GALLUS_TASK_DELETE_CONTEXT_AFTER_EXEC) != 0) {
           /*
            * no one can touch this task anymore.
            */
@@ -159,6 +161,62 @@ gallus_task_run(gallus_task_t *tptr, gallus_pooled_thread_t *ptptr, int flag) {
 }
 
 
+gallus_result_t
+gallus_task_submit(gallus_task_t *tptr, gallus_thread_pool_t *pptr, int flag) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_task_t t = NULL;
+
+  if (likely(tptr != NULL && (t = *tptr) != NULL && t->m_main != NULL &&
+             pptr != NULL && *pptr != NULL)) {
+    gallus_task_state_t o_state;
+    int o_flag;
+    bool o_is_wait_done;
+
+    (void)gallus_mutex_lock(&t->m_lck);
+    {
+
+      o_state = t->m_state;
+      o_flag = t->m_flag;
+      o_is_wait_done = t->m_is_wait_done;
+
+      t->m_state = GALLUS_TASK_STATE_ATTACHED;
+      t->m_flag = flag & ~GALLUS_TASK_RELEASE_THREAD_AFTER_EXEC;
+      t->m_is_wait_done = false;
+
+    }
+    (void)gallus_mutex_unlock(&t->m_lck);
+
+    ret = gallus_thread_pool_enqueue_task(pptr, t);
+    if (likely(ret == GALLUS_RESULT_OK)) {
+      if ((flag & GALLUS_TASK_DELETE_CONTEXT_AFTER_EXEC) != 0) {
+        /*
+         * no one can touch this task anymore.
+         */
+        *tptr = NULL;
+      }
+    } else {
+      /*
+       * Not queued, put it back as it was.
+       */
+      (void)gallus_mutex_lock(&t->m_lck);
+      {
+
+        t->m_state = o_state;
+        t->m_flag = o_flag;
+        t->m_is_wait_done = o_is_wait_done;
+
+      }
+      (void)gallus_mutex_unlock(&t->m_lck);
+    }
+
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
 void
 gallus_task_finalize(gallus_task_t *tptr, bool is_cancelled) {
   gallus_task_t t = NULL;
@@ -167,6 +225,7 @@ gallus_task_finalize(gallus_task_t *tptr, bool is_cancelled) {
                 (is_cancelled == true) ? "yes" : "no");
   
   if (likely(tptr != NULL && (t = *tptr) != NULL)) {
+    gallus_future_t f = NULL;
 
     if (t->m_finalize != NULL) {
       t->m_finalize(tptr, is_cancelled);
@@ -186,8 +245,16 @@ gallus_task_finalize(gallus_task_t *tptr, bool is_cancelled) {
       (void)gallus_cond_notify(&t->m_cnd, true);
 
       gallus_msg_debug(5, "woke task \"%s\" waiters up.\n", t->m_name);
+
+      f = t->m_future;
+      t->m_future = NULL;
     }
     (void)gallus_mutex_unlock(&t->m_lck);
+
+    if (f != NULL) {
+      (void)gallus_future_complete(&f, t->m_exit_code, NULL);
+      gallus_future_destroy(&f);
+    }
   }
 }
 
@@ -288,6 +355,10 @@ gallus_task_destroy(gallus_task_t *tptr) {
       t->m_freeup(tptr);
     }
 
+    if (t->m_future != NULL) {
+      gallus_future_destroy(&t->m_future);
+    }
+
     if (t->m_cnd != NULL) {
 
       if (t->m_lck != NULL) {
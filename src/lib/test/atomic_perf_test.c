@@ -0,0 +1,309 @@
+#include "unity.h"
+#include "gallus_apis.h"
+
+/*
+ * The full barrier primitives against the gallus_atomic.h orderings.
+ *
+ *   sync add		__sync_add_and_fetch(), always SEQ_CST
+ *   relaxed add	gallus_atomic_fetch_add(RELAXED)
+ *   sync load		__sync_fetch_and_add(x, 0), an RMW to read
+ *   acquire load	gallus_atomic_load(ACQUIRE)
+ *   store + mbar	a plain store then mbar()
+ *   release store	gallus_atomic_store(RELEASE)
+ *   statistic		gallus_statistic_record() from the threads
+ *
+ * as ns/op over all the threads. On x86 only the RMW reads and the
+ * fences differ, the loads and the stores are plain moves; on arm64
+ * every one of them maps to a different instruction, run it there
+ * (e.g. under qemu-aarch64 with a cross build) too.
+ *
+ * Environment:
+ *   ATOMIC_PERF_OPS		ops per thread (default 2000000)
+ *   ATOMIC_PERF_THREADS	threads (default 4)
+ */
+
+#define OUTPUT stdout
+
+#define DEFAULT_OPS		2000000
+#define DEFAULT_THREADS		4
+#define MAX_THREADS		256
+
+typedef enum {
+  KIND_SYNC_ADD = 0,
+  KIND_RELAXED_ADD,
+  KIND_SYNC_LOAD,
+  KIND_ACQUIRE_LOAD,
+  KIND_STORE_MBAR,
+  KIND_RELEASE_STORE,
+  KIND_STATISTIC
+} atomic_kind_t;
+
+typedef struct {
+  atomic_kind_t m_kind;
+  size_t m_n_threads;
+  size_t m_n_ops;
+  pthread_barrier_t m_barrier;
+  gallus_statistic_t m_stat;
+  uint64_t m_shared __attribute__((aligned(64)));
+  uint64_t m_private[MAX_THREADS][8] __attribute__((aligned(64)));
+} bench_record;
+
+typedef struct {
+  bench_record *m_b;
+  size_t m_idx;
+} bench_arg_record;
+
+static size_t s_n_ops = DEFAULT_OPS;
+static size_t s_n_threads = DEFAULT_THREADS;
+
+
+/*
+ * The message passing: the producer fills the payload then publishes
+ * the sequence # with a release store, the consumer must see the
+ * payload of any sequence # it acquires.
+ */
+#define MP_N_MSGS	200000
+#define MP_PAYLOAD	7
+
+typedef struct {
+  uint64_t m_seq;
+  uint64_t m_payload[MP_PAYLOAD];
+  bool m_is_ok;
+} mp_record;
+
+
+
+
+
+void
+setUp(void) {
+  const char *e;
+
+  if ((e = getenv("ATOMIC_PERF_OPS")) != NULL && atoi(e) > 0) {
+    s_n_ops = (size_t)atoi(e);
+  }
+  if ((e = getenv("ATOMIC_PERF_THREADS")) != NULL && atoi(e) > 0) {
+    s_n_threads = (size_t)atoi(e);
+    if (s_n_threads > MAX_THREADS) {
+      s_n_threads = MAX_THREADS;
+    }
+  }
+}
+
+
+void
+tearDown(void) {
+}
+
+
+
+
+
+static inline uint64_t
+s_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000LL + (uint64_t)ts.tv_nsec;
+}
+
+static void
+s_report(const char *label, size_t n_threads, size_t n, uint64_t total) {
+  fprintf(OUTPUT, "%-16s threads %3zu ops %9zu: %6.2f ns/op\n",
+          label, n_threads, n, (double)total / (double)n);
+  fflush(OUTPUT);
+}
+
+
+static void *
+s_bench_main(void *arg) {
+  bench_arg_record *a = (bench_arg_record *)arg;
+  bench_record *b = a->m_b;
+  uint64_t *mine = &(b->m_private[a->m_idx][0]);
+  uint64_t sum = 0;
+  size_t i;
+
+  (void)pthread_barrier_wait(&(b->m_barrier));
+
+  switch (b->m_kind) {
+    case KIND_SYNC_ADD:
+      for (i = 0; i < b->m_n_ops; i++) {
+        (void)__sync_add_and_fetch(&(b->m_shared), 1);
+      }
+      break;
+    case KIND_RELAXED_ADD:
+      for (i = 0; i < b->m_n_ops; i++) {
+        (void)gallus_atomic_fetch_add(&(b->m_shared), 1, RELAXED);
+      }
+      break;
+    case KIND_SYNC_LOAD:
+      for (i = 0; i < b->m_n_ops; i++) {
+        sum += __sync_fetch_and_add(mine, 0);
+      }
+      break;
+    case KIND_ACQUIRE_LOAD:
+      for (i = 0; i < b->m_n_ops; i++) {
+        sum += gallus_atomic_load(mine, ACQUIRE);
+      }
+      break;
+    case KIND_STORE_MBAR:
+      for (i = 0; i < b->m_n_ops; i++) {
+        *(volatile uint64_t *)mine = i;
+        mbar();
+      }
+      break;
+    case KIND_RELEASE_STORE:
+      for (i = 0; i < b->m_n_ops; i++) {
+        gallus_atomic_store(mine, i, RELEASE);
+      }
+      break;
+    case KIND_STATISTIC:
+      for (i = 0; i < b->m_n_ops; i++) {
+        (void)gallus_statistic_record(&(b->m_stat), (int64_t)(i & 1023));
+      }
+      break;
+    default:
+      break;
+  }
+
+  mine[1] = sum;
+
+  return NULL;
+}
+
+
+static void
+s_bench(const char *label, atomic_kind_t kind, size_t n_threads) {
+  bench_record *b = NULL;
+  bench_arg_record args[MAX_THREADS];
+  pthread_t tids[MAX_THREADS];
+  uint64_t start;
+  size_t i;
+
+  TEST_ASSERT_EQUAL(0, posix_memalign((void **)&b, 64, sizeof(*b)));
+  (void)memset((void *)b, 0, sizeof(*b));
+  b->m_kind = kind;
+  b->m_n_threads = n_threads;
+  b->m_n_ops = s_n_ops;
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_statistic_create(&(b->m_stat), label));
+  TEST_ASSERT_EQUAL(0, pthread_barrier_init(&(b->m_barrier), NULL,
+                    (unsigned)n_threads + 1));
+
+  for (i = 0; i < n_threads; i++) {
+    args[i].m_b = b;
+    args[i].m_idx = i;
+    TEST_ASSERT_EQUAL(0, pthread_create(&tids[i], NULL, s_bench_main,
+                                        (void *)&args[i]));
+  }
+
+  (void)pthread_barrier_wait(&(b->m_barrier));
+  start = s_now();
+  for (i = 0; i < n_threads; i++) {
+    (void)pthread_join(tids[i], NULL);
+  }
+  s_report(label, n_threads, s_n_ops * n_threads, s_now() - start);
+
+  if (kind == KIND_SYNC_ADD || kind == KIND_RELAXED_ADD) {
+    TEST_ASSERT_TRUE(b->m_shared == s_n_ops * n_threads);
+  } else if (kind == KIND_STATISTIC) {
+    TEST_ASSERT_EQUAL(s_n_ops * n_threads,
+                      gallus_statistic_sample_n(&(b->m_stat)));
+  }
+
+  (void)pthread_barrier_destroy(&(b->m_barrier));
+  gallus_statistic_destroy(&(b->m_stat));
+  free((void *)b);
+}
+
+
+static void *
+s_mp_consumer(void *arg) {
+  mp_record *m = (mp_record *)arg;
+  uint64_t seq = 0;
+  uint64_t prev = 0;
+  size_t i;
+
+  m->m_is_ok = true;
+  while (prev < MP_N_MSGS) {
+    seq = gallus_atomic_load(&(m->m_seq), ACQUIRE);
+    if (seq != prev) {
+      for (i = 0; i < MP_PAYLOAD; i++) {
+        /*
+         * The producer may already be writing the next one, but
+         * never something older than the seq.
+         */
+        if (gallus_atomic_load(&(m->m_payload[i]), RELAXED) < seq) {
+          m->m_is_ok = false;
+        }
+      }
+      prev = seq;
+    }
+  }
+
+  return NULL;
+}
+
+
+
+
+
+void
+test_message_passing(void) {
+  mp_record m;
+  pthread_t t;
+  uint64_t seq;
+  size_t i;
+
+  (void)memset((void *)&m, 0, sizeof(m));
+  TEST_ASSERT_EQUAL(0, pthread_create(&t, NULL, s_mp_consumer,
+                                      (void *)&m));
+
+  for (seq = 1; seq <= MP_N_MSGS; seq++) {
+    for (i = 0; i < MP_PAYLOAD; i++) {
+      gallus_atomic_store(&(m.m_payload[i]), seq, RELAXED);
+    }
+    gallus_atomic_store(&(m.m_seq), seq, RELEASE);
+  }
+
+  TEST_ASSERT_EQUAL(0, pthread_join(t, NULL));
+  TEST_ASSERT_TRUE(m.m_is_ok);
+}
+
+
+void
+test_update_min_max(void) {
+  int64_t min = LLONG_MAX;
+  int64_t max = LLONG_MIN;
+  int64_t v;
+
+  for (v = -100; v <= 100; v += 7) {
+    gallus_atomic_update_min(int64_t, &min, LLONG_MAX, v);
+    gallus_atomic_update_max(int64_t, &max, LLONG_MIN, v);
+  }
+  TEST_ASSERT_TRUE(min == -100);
+  TEST_ASSERT_TRUE(max == 96);
+}
+
+
+void
+test_atomic_single(void) {
+  s_bench("sync add", KIND_SYNC_ADD, 1);
+  s_bench("relaxed add", KIND_RELAXED_ADD, 1);
+  s_bench("sync load", KIND_SYNC_LOAD, 1);
+  s_bench("acquire load", KIND_ACQUIRE_LOAD, 1);
+  s_bench("store + mbar", KIND_STORE_MBAR, 1);
+  s_bench("release store", KIND_RELEASE_STORE, 1);
+  s_bench("statistic", KIND_STATISTIC, 1);
+}
+
+
+void
+test_atomic_threads(void) {
+  s_bench("sync add", KIND_SYNC_ADD, s_n_threads);
+  s_bench("relaxed add", KIND_RELAXED_ADD, s_n_threads);
+  s_bench("sync load", KIND_SYNC_LOAD, s_n_threads);
+  s_bench("acquire load", KIND_ACQUIRE_LOAD, s_n_threads);
+  s_bench("store + mbar", KIND_STORE_MBAR, s_n_threads);
+  s_bench("release store", KIND_RELEASE_STORE, s_n_threads);
+  s_bench("statistic", KIND_STATISTIC, s_n_threads);
+}
@@ -0,0 +1,531 @@
+#include "gallus_apis.h"
+#include "unity.h"
+
+
+
+
+
+#define N_CALLOUT_WORKERS	4
+#define N_TASKS			64
+#define N_MANY_TASKS		1024
+#define N_OVERFLOW_TASKS	1500	/* > the urgent Q (CALLOUT_TASK_MAX). */
+
+
+
+
+
+void
+setUp(void) {
+}
+
+
+void
+tearDown(void) {
+}
+
+
+
+
+
+typedef struct {
+  gallus_mutex_t m_lock;
+  gallus_cond_t m_cond;
+  volatile size_t m_n_exec;
+  size_t m_n_stop;
+  volatile bool m_is_freeuped;
+} callout_arg_struct;
+typedef callout_arg_struct *callout_arg_t;
+
+
+static inline callout_arg_t
+s_alloc_arg(size_t n_stop) {
+  callout_arg_t ret = NULL;
+  gallus_mutex_t lock = NULL;
+  gallus_cond_t cond = NULL;
+
+  if (gallus_mutex_create(&lock) != GALLUS_RESULT_OK) {
+    goto done;
+  }
+  if (gallus_cond_create(&cond) != GALLUS_RESULT_OK) {
+    gallus_mutex_destroy(&lock);
+    goto done;
+  }
+
+  ret = (callout_arg_t)malloc(sizeof(*ret));
+  if (ret == NULL) {
+    gallus_cond_destroy(&cond);
+    gallus_mutex_destroy(&lock);
+    goto done;
+  }
+
+  (void)memset((void *)ret, 0, sizeof(*ret));
+  ret->m_lock = lock;
+  ret->m_cond = cond;
+  ret->m_n_exec = 0;
+  ret->m_n_stop = n_stop;
+  ret->m_is_freeuped = false;
+
+done:
+  return ret;
+}
+
+
+static inline void
+s_destroy_arg(callout_arg_t arg) {
+  if (likely(arg != NULL &&
+             arg->m_is_freeuped == true)) {
+    gallus_cond_destroy(&(arg->m_cond));
+    gallus_mutex_destroy(&(arg->m_lock));
+    free((void *)arg);
+  }
+}
+
+
+static void
+s_freeup_arg(void *arg) {
+  if (likely(arg != NULL)) {
+    callout_arg_t carg = (callout_arg_t)arg;
+
+    (void)gallus_mutex_lock(&(carg->m_lock));
+    {
+      carg->m_is_freeuped = true;
+      (void)gallus_cond_notify(&(carg->m_cond), true);
+    }
+    (void)gallus_mutex_unlock(&(carg->m_lock));
+  }
+}
+
+
+static inline size_t
+s_wait_freeup_arg(callout_arg_t arg) {
+  size_t ret = 0;
+
+  if (likely(arg != NULL)) {
+
+    (void)gallus_mutex_lock(&(arg->m_lock));
+    {
+      while (arg->m_is_freeuped != true) {
+        (void)gallus_cond_wait(&(arg->m_cond), &(arg->m_lock), -1LL);
+      }
+      ret = __sync_fetch_and_add(&(arg->m_n_exec), 0);
+    }
+    (void)gallus_mutex_unlock(&(arg->m_lock));
+
+  }
+
+  return ret;
+}
+
+
+static inline bool
+s_wait_freeup_arg_until(callout_arg_t arg, gallus_chrono_t nsec) {
+  bool ret = false;
+  gallus_chrono_t end;
+  gallus_chrono_t now;
+
+  WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+  end = now + nsec;
+
+  (void)gallus_mutex_lock(&(arg->m_lock));
+  {
+    while (arg->m_is_freeuped != true && now < end) {
+      (void)gallus_cond_wait(&(arg->m_cond), &(arg->m_lock), end - now);
+      WHAT_TIME_IS_IT_NOW_IN_NSEC(now);
+    }
+    ret = arg->m_is_freeuped;
+  }
+  (void)gallus_mutex_unlock(&(arg->m_lock));
+
+  return ret;
+}
+
+
+static gallus_result_t
+callout_task(void *arg) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  if (likely(arg != NULL)) {
+    callout_arg_t carg = (callout_arg_t)arg;
+    size_t n_exec = __sync_add_and_fetch(&(carg->m_n_exec), 1);
+
+    if (n_exec < carg->m_n_stop) {
+      ret = GALLUS_RESULT_OK;
+    }
+  }
+
+  return ret;
+}
+
+
+static inline void
+s_create_tasks(gallus_callout_task_t *tasks, callout_arg_t *args,
+               size_t n, size_t n_stop) {
+  gallus_result_t r;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    args[i] = s_alloc_arg(n_stop);
+    TEST_ASSERT_NOT_EQUAL(args[i], NULL);
+
+    tasks[i] = NULL;
+    r = gallus_callout_create_task(&tasks[i], 0, __func__,
+                                    callout_task, (void *)args[i],
+                                    s_freeup_arg);
+    TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  }
+}
+
+
+static inline void
+s_submit_tasks(gallus_callout_task_t *tasks, callout_arg_t *args,
+               size_t n_stop,
+               gallus_chrono_t delay, gallus_chrono_t interval) {
+  gallus_result_t r;
+  size_t i;
+
+  s_create_tasks(tasks, args, N_TASKS, n_stop);
+
+  for (i = 0; i < N_TASKS; i++) {
+    r = gallus_callout_submit_task(&tasks[i], delay, interval);
+    TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  }
+}
+
+
+
+
+
+void
+test_prologue(void) {
+  gallus_result_t r;
+  const char *argv0 =
+      ((IS_VALID_STRING(gallus_get_command_name()) == true) ?
+       gallus_get_command_name() : "callout_shard_test");
+  const char * const argv[] = {
+    argv0, NULL
+  };
+
+  (void)gallus_mainloop_set_callout_workers_number(N_CALLOUT_WORKERS);
+  r = gallus_mainloop_with_callout(1, argv, NULL, NULL,
+                                    false, false, true);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+}
+
+
+
+
+
+/*
+ * Repeated timed tasks spread over the shards of the workers.
+ */
+void
+test_sharded_repeat(void) {
+  gallus_callout_task_t tasks[N_TASKS];
+  callout_arg_t args[N_TASKS];
+  size_t i;
+
+  s_submit_tasks(tasks, args, 5,
+                 10LL * 1000LL * 1000LL, 10LL * 1000LL * 1000LL);
+
+  for (i = 0; i < N_TASKS; i++) {
+    TEST_ASSERT_EQUAL(s_wait_freeup_arg(args[i]), 5);
+    s_destroy_arg(args[i]);
+  }
+}
+
+
+/*
+ * Cancel the timed tasks in the shards of the others.
+ */
+void
+test_sharded_cancel_before(void) {
+  gallus_callout_task_t tasks[N_TASKS];
+  callout_arg_t args[N_TASKS];
+  size_t i;
+
+  s_submit_tasks(tasks, args, 5,
+                 1000LL * 1000LL * 1000LL, 10LL * 1000LL * 1000LL);
+
+  for (i = 0; i < N_TASKS; i++) {
+    gallus_callout_cancel_task(&tasks[i]);
+  }
+
+  for (i = 0; i < N_TASKS; i++) {
+    TEST_ASSERT_EQUAL(s_wait_freeup_arg(args[i]), 0);
+    s_destroy_arg(args[i]);
+  }
+}
+
+
+void
+test_sharded_cancel_while(void) {
+  gallus_callout_task_t tasks[N_TASKS];
+  callout_arg_t args[N_TASKS];
+  size_t i;
+
+  s_submit_tasks(tasks, args, 1000000,
+                 10LL * 1000LL * 1000LL, 10LL * 1000LL * 1000LL);
+
+  (void)gallus_chrono_nanosleep(100LL * 1000LL * 1000LL, NULL);
+
+  for (i = 0; i < N_TASKS; i++) {
+    gallus_callout_cancel_task(&tasks[i]);
+  }
+
+  for (i = 0; i < N_TASKS; i++) {
+    TEST_ASSERT_NOT_EQUAL(s_wait_freeup_arg(args[i]), 0);
+    s_destroy_arg(args[i]);
+  }
+}
+
+
+
+
+
+/*
+ * Batch submission/cancellation.
+ */
+void
+test_batch_submit_urgent(void) {
+  gallus_callout_task_t tasks[N_TASKS];
+  callout_arg_t args[N_TASKS];
+  gallus_result_t r;
+  size_t i;
+
+  s_create_tasks(tasks, args, N_TASKS, 1);
+
+  r = gallus_callout_submit_tasks(tasks, N_TASKS, 0LL, 0LL);
+  TEST_ASSERT_EQUAL(r, N_TASKS);
+
+  for (i = 0; i < N_TASKS; i++) {
+    TEST_ASSERT_EQUAL(s_wait_freeup_arg(args[i]), 1);
+    s_destroy_arg(args[i]);
+  }
+}
+
+
+/*
+ * More than the urgent Q holds; queued in chunks while the master
+ * drains it.
+ */
+void
+test_batch_submit_overflow(void) {
+  gallus_callout_task_t *tasks =
+      (gallus_callout_task_t *)malloc(sizeof(*tasks) * N_OVERFLOW_TASKS);
+  callout_arg_t *args =
+      (callout_arg_t *)malloc(sizeof(*args) * N_OVERFLOW_TASKS);
+  gallus_result_t r;
+  size_t i;
+
+  TEST_ASSERT_NOT_EQUAL(tasks, NULL);
+  TEST_ASSERT_NOT_EQUAL(args, NULL);
+
+  s_create_tasks(tasks, args, N_OVERFLOW_TASKS, 1);
+
+  r = gallus_callout_submit_tasks(tasks, N_OVERFLOW_TASKS, 0LL, 0LL);
+  TEST_ASSERT_EQUAL(r, N_OVERFLOW_TASKS);
+
+  for (i = 0; i < N_OVERFLOW_TASKS; i++) {
+    TEST_ASSERT_EQUAL(s_wait_freeup_arg_until(args[i],
+                                              5LL * 1000LL * 1000LL * 1000LL),
+                      true);
+    TEST_ASSERT_EQUAL(args[i]->m_n_exec, 1);
+    s_destroy_arg(args[i]);
+  }
+
+  free((void *)args);
+  free((void *)tasks);
+}
+
+
+void
+test_batch_submit_timed(void) {
+  gallus_callout_task_t tasks[N_TASKS];
+  callout_arg_t args[N_TASKS];
+  gallus_result_t r;
+  size_t i;
+
+  s_create_tasks(tasks, args, N_TASKS, 3);
+
+  r = gallus_callout_submit_tasks(tasks, N_TASKS,
+                                   10LL * 1000LL * 1000LL,
+                                   10LL * 1000LL * 1000LL);
+  TEST_ASSERT_EQUAL(r, N_TASKS);
+
+  for (i = 0; i < N_TASKS; i++) {
+    TEST_ASSERT_EQUAL(s_wait_freeup_arg(args[i]), 3);
+    s_destroy_arg(args[i]);
+  }
+}
+
+
+void
+test_batch_submit_twice(void) {
+  gallus_callout_task_t tasks[N_TASKS];
+  callout_arg_t args[N_TASKS];
+  gallus_result_t r;
+  size_t i;
+
+  s_create_tasks(tasks, args, N_TASKS, 1);
+
+  r = gallus_callout_submit_tasks(tasks, N_TASKS,
+                                   1000LL * 1000LL * 1000LL, 0LL);
+  TEST_ASSERT_EQUAL(r, N_TASKS);
+
+  r = gallus_callout_submit_tasks(tasks, N_TASKS,
+                                   1000LL * 1000LL * 1000LL, 0LL);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_INVALID_STATE_TRANSITION);
+
+  gallus_callout_cancel_tasks(tasks, N_TASKS);
+
+  for (i = 0; i < N_TASKS; i++) {
+    TEST_ASSERT_EQUAL(s_wait_freeup_arg(args[i]), 0);
+    s_destroy_arg(args[i]);
+  }
+}
+
+
+/*
+ * A bad task in the middle rejects the whole batch, and leaves the
+ * tasks untouched.
+ */
+void
+test_batch_submit_invalid(void) {
+  gallus_callout_task_t tasks[N_TASKS];
+  callout_arg_t args[N_TASKS];
+  gallus_callout_task_t t;
+  gallus_result_t r;
+  size_t i;
+
+  s_create_tasks(tasks, args, N_TASKS, 1000000);
+
+  /* a duplicate. */
+  t = tasks[N_TASKS / 2];
+  tasks[N_TASKS / 2] = tasks[0];
+  r = gallus_callout_submit_tasks(tasks, N_TASKS,
+                                   10LL * 1000LL * 1000LL,
+                                   10LL * 1000LL * 1000LL);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_INVALID_ARGS);
+
+  /* a NULL. */
+  tasks[N_TASKS / 2] = NULL;
+  r = gallus_callout_submit_tasks(tasks, N_TASKS, 0LL,
+                                   10LL * 1000LL * 1000LL);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_INVALID_ARGS);
+
+  /* an already submitted one. */
+  tasks[N_TASKS / 2] = t;
+  r = gallus_callout_submit_task(&tasks[N_TASKS / 2],
+                                  1000LL * 1000LL * 1000LL, 0LL);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  r = gallus_callout_submit_tasks(tasks, N_TASKS,
+                                   10LL * 1000LL * 1000LL,
+                                   10LL * 1000LL * 1000LL);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_INVALID_STATE_TRANSITION);
+  gallus_callout_cancel_task(&tasks[N_TASKS / 2]);
+  TEST_ASSERT_EQUAL(s_wait_freeup_arg(args[N_TASKS / 2]), 0);
+  s_destroy_arg(args[N_TASKS / 2]);
+
+  /*
+   * The others are still fresh single-shot tasks: no interval was
+   * left on them by the failed submissions, each runs just once.
+   */
+  tasks[N_TASKS / 2] = tasks[N_TASKS - 1];
+  args[N_TASKS / 2] = args[N_TASKS - 1];
+  r = gallus_callout_submit_tasks(tasks, N_TASKS - 1, 0LL, 0LL);
+  TEST_ASSERT_EQUAL(r, N_TASKS - 1);
+
+  for (i = 0; i < N_TASKS - 1; i++) {
+    TEST_ASSERT_EQUAL(s_wait_freeup_arg_until(args[i],
+                                              5LL * 1000LL * 1000LL *
+                                              1000LL),
+                      true);
+    TEST_ASSERT_EQUAL(args[i]->m_n_exec, 1);
+    s_destroy_arg(args[i]);
+  }
+}
+
+
+/*
+ * The tombstones of the far future tasks are swept before the time
+ * comes if there are many.
+ */
+void
+test_batch_cancel_sweep(void) {
+  gallus_callout_task_t *tasks =
+      (gallus_callout_task_t *)malloc(sizeof(*tasks) * N_MANY_TASKS);
+  callout_arg_t *args =
+      (callout_arg_t *)malloc(sizeof(*args) * N_MANY_TASKS);
+  gallus_result_t r;
+  size_t i;
+
+  TEST_ASSERT_NOT_EQUAL(tasks, NULL);
+  TEST_ASSERT_NOT_EQUAL(args, NULL);
+
+  s_create_tasks(tasks, args, N_MANY_TASKS, 1);
+
+  r = gallus_callout_submit_tasks(tasks, N_MANY_TASKS,
+                                   3600LL * 1000LL * 1000LL * 1000LL, 0LL);
+  TEST_ASSERT_EQUAL(r, N_MANY_TASKS);
+
+  gallus_callout_cancel_tasks(tasks, N_MANY_TASKS);
+
+  for (i = 0; i < N_MANY_TASKS; i++) {
+    TEST_ASSERT_EQUAL(s_wait_freeup_arg_until(args[i],
+                                              5LL * 1000LL * 1000LL * 1000LL),
+                      true);
+    TEST_ASSERT_EQUAL(args[i]->m_n_exec, 0);
+    s_destroy_arg(args[i]);
+  }
+
+  free((void *)args);
+  free((void *)tasks);
+}
+
+
+/*
+ * Cancel the tasks re-arming themselves rapidly, at various timings.
+ */
+void
+test_cancel_rearm_race(void) {
+  gallus_callout_task_t tasks[N_TASKS];
+  callout_arg_t args[N_TASKS];
+  gallus_result_t r;
+  size_t i;
+  size_t j;
+
+  for (j = 0; j < 20; j++) {
+    s_create_tasks(tasks, args, N_TASKS, 1000000);
+
+    r = gallus_callout_submit_tasks(tasks, N_TASKS,
+                                     10LL * 1000LL, 10LL * 1000LL);
+    TEST_ASSERT_EQUAL(r, N_TASKS);
+
+    for (i = 0; i < N_TASKS; i++) {
+      if ((i % 8) == 0) {
+        (void)gallus_chrono_nanosleep((gallus_chrono_t)(j + 1) * 10LL * 1000LL,
+                                       NULL);
+      }
+      gallus_callout_cancel_task(&tasks[i]);
+    }
+
+    for (i = 0; i < N_TASKS; i++) {
+      TEST_ASSERT_EQUAL(s_wait_freeup_arg_until(args[i],
+                                                5LL * 1000LL * 1000LL *
+                                                1000LL),
+                        true);
+      s_destroy_arg(args[i]);
+    }
+  }
+}
+
+
+
+
+
+void
+test_epilogue(void) {
+  gallus_result_t r = global_state_request_shutdown(SHUTDOWN_GRACEFULLY);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  gallus_mainloop_wait_thread();
+}
@@ -0,0 +1,108 @@
+#include "gallus_apis.h"
+#include "unity.h"
+
+
+
+
+
+void
+setUp(void) {
+}
+
+
+void
+tearDown(void) {
+}
+
+
+
+
+
+static inline gallus_chrono_t
+s_abs(gallus_chrono_t v) {
+  return (v < 0) ? -v : v;
+}
+
+
+void
+test_now_is_monotonic(void) {
+  gallus_chrono_t end, prev, now, mono;
+  struct timespec ts;
+
+  /* across a few re-anchorings of the TSC. */
+  prev = gallus_chrono_now();
+  end = prev + 1200LL * 1000LL * 1000LL;
+  do {
+    now = gallus_chrono_now();
+    TEST_ASSERT_TRUE(now >= prev);
+    prev = now;
+  } while (now < end);
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  mono = TS_TO_NSEC(ts);
+  now = gallus_chrono_now();
+  TEST_ASSERT_TRUE(s_abs(now - mono) < 1000LL * 1000LL);
+}
+
+
+void
+test_now_follows_sleep(void) {
+  gallus_chrono_t t0, t1;
+
+  t0 = gallus_chrono_now();
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_chrono_nanosleep(50LL * 1000LL * 1000LL, NULL));
+  t1 = gallus_chrono_now();
+
+  TEST_ASSERT_TRUE(t1 - t0 >= 50LL * 1000LL * 1000LL);
+  TEST_ASSERT_TRUE(t1 - t0 < 1000LL * 1000LL * 1000LL);
+}
+
+
+void
+test_coarse_now(void) {
+  gallus_chrono_t c0, c1, now;
+
+  c0 = gallus_chrono_coarse_now();
+  now = gallus_chrono_now();
+  TEST_ASSERT_TRUE(now >= c0);
+
+  (void)gallus_chrono_nanosleep(20LL * 1000LL * 1000LL, NULL);
+  c1 = gallus_chrono_coarse_now();
+  now = gallus_chrono_now();
+  TEST_ASSERT_TRUE(c1 > c0);
+  TEST_ASSERT_TRUE(now - c1 < 100LL * 1000LL * 1000LL);
+}
+
+
+void
+test_realtime_now(void) {
+  gallus_chrono_t rt = gallus_chrono_realtime_now();
+  gallus_chrono_t t = (gallus_chrono_t)time(NULL) * 1000LL * 1000LL * 1000LL;
+
+  TEST_ASSERT_TRUE(s_abs(rt - t) < 2LL * 1000LL * 1000LL * 1000LL);
+}
+
+
+void
+test_cond_timedwait(void) {
+  gallus_mutex_t mtx = NULL;
+  gallus_cond_t cnd = NULL;
+  gallus_chrono_t t0, t1;
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mutex_create(&mtx));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_cond_create(&cnd));
+
+  (void)gallus_mutex_lock(&mtx);
+  t0 = gallus_chrono_now();
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_TIMEDOUT,
+                    gallus_cond_wait(&cnd, &mtx, 30LL * 1000LL * 1000LL));
+  t1 = gallus_chrono_now();
+  (void)gallus_mutex_unlock(&mtx);
+
+  TEST_ASSERT_TRUE(t1 - t0 >= 30LL * 1000LL * 1000LL);
+  TEST_ASSERT_TRUE(t1 - t0 < 1000LL * 1000LL * 1000LL);
+
+  gallus_cond_destroy(&cnd);
+  gallus_mutex_destroy(&mtx);
+}
@@ -770,3 +770,140 @@ test_gallus_dstring_insertf_empty(void) {
                             "gallus_dstring_insertf error.");
   TEST_DSTRING(ret, &ds, str, test_str2);
 }
+
+/*
+ * Reference for the mixed edits: a plain buffer edited with memmove.
+ */
+static void
+s_ref_insert(char *ref, size_t offset, const char *s) {
+  size_t len = strlen(s);
+
+  memmove(ref + offset + len, ref + offset, strlen(ref) - offset + 1);
+  memcpy(ref + offset, s, len);
+}
+
+static void
+s_mixed_edits(gallus_dstring_t *d) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  static char ref[256 * 1024];
+  char tmp[32];
+  char *str = NULL;
+  size_t i, len, offset;
+
+  ref[0] = '\0';
+  srand(1);
+  for (i = 0; i < 8000; i++) {
+    len = strlen(ref);
+    snprintf(tmp, sizeof(tmp), "<%zu>", i);
+    switch (rand() % 4) {
+      case 0:
+        ret = gallus_dstring_appendf(d, "<%zu>", i);
+        s_ref_insert(ref, len, tmp);
+        break;
+      case 1:
+        ret = gallus_dstring_prependf(d, "<%zu>", i);
+        s_ref_insert(ref, 0, tmp);
+        break;
+      default:
+        offset = (len == 0) ? 0 : (size_t) rand() % (len + 1);
+        ret = gallus_dstring_insertf(d, offset, "<%zu>", i);
+        s_ref_insert(ref, offset, tmp);
+        break;
+    }
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  }
+  TEST_ASSERT_EQUAL(strlen(ref), gallus_dstring_len_get(d));
+  TEST_DSTRING(ret, d, str, ref);
+}
+
+void
+test_gallus_dstring_mixed_edits(void) {
+  gallus_dstring_t rope = NULL;
+
+  s_mixed_edits(&ds);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_dstring_create_rope(&rope));
+  s_mixed_edits(&rope);
+  gallus_dstring_destroy(&rope);
+}
+
+void
+test_gallus_dstring_rope(void) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_dstring_t rope = NULL;
+  struct iovec iov[64];
+  char *str = NULL;
+  char *flat = NULL;
+  size_t i, len = 0;
+  gallus_result_t n;
+
+  ret = gallus_dstring_create_rope(&rope);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_EQUAL(true, gallus_dstring_empty(&rope));
+  TEST_ASSERT_EQUAL(0, gallus_dstring_iovec_get(&rope, iov, 64));
+
+  /* a few segments worth. */
+  for (i = 0; i < 50000; i++) {
+    ret = gallus_dstring_appendf(&rope, "line %zu\n", i);
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+    ret = gallus_dstring_appendf(&ds, "line %zu\n", i);
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  }
+  TEST_ASSERT_EQUAL(gallus_dstring_len_get(&ds),
+                    gallus_dstring_len_get(&rope));
+
+  ret = gallus_dstring_str_get(&ds, &flat);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_DSTRING(ret, &rope, str, flat);
+
+  /* the iovecs cover the string in order. */
+  n = gallus_dstring_iovec_get(&rope, iov, 64);
+  TEST_ASSERT_TRUE(n > 1 && n <= 64);
+  for (i = 0; i < (size_t) n; i++) {
+    TEST_ASSERT_EQUAL(0, memcmp(flat + len, iov[i].iov_base, iov[i].iov_len));
+    len += iov[i].iov_len;
+  }
+  TEST_ASSERT_EQUAL(strlen(flat), len);
+  TEST_ASSERT_EQUAL(1, gallus_dstring_iovec_get(&ds, iov, 64));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_dstring_iovec_get(&rope, NULL, 1));
+
+  /* rope -> flat and flat -> rope. */
+  ret = gallus_dstring_clear(&ds);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_dstring_concat(&ds, &rope);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_DSTRING(ret, &ds, str, flat);
+  ret = gallus_dstring_clear(&rope);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_EQUAL(true, gallus_dstring_empty(&rope));
+  ret = gallus_dstring_concat(&rope, &ds);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_DSTRING(ret, &rope, str, flat);
+
+  free(flat);
+  gallus_dstring_destroy(&rope);
+  TEST_ASSERT_NULL(rope);
+}
+
+void
+test_gallus_dstring_concat_self(void) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_dstring_t rope = NULL;
+  char *str = NULL;
+
+  ret = gallus_dstring_appendf(&ds, "%s", "abc");
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_dstring_concat(&ds, &ds);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_DSTRING(ret, &ds, str, "abcabc");
+
+  ret = gallus_dstring_create_rope(&rope);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_dstring_appendf(&rope, "%s", "xyz");
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_dstring_concat(&rope, &rope);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_DSTRING(ret, &rope, str, "xyzxyz");
+  gallus_dstring_destroy(&rope);
+}
@@ -0,0 +1,251 @@
+#include "gallus_apis.h"
+#include "unity.h"
+
+
+
+
+
+#define N_FIBERS	100
+#define N_YIELDS	100
+#define N_VALUES	10000
+
+
+static gallus_fiber_sched_t s_sched = NULL;
+static size_t s_n_steps = 0;
+static gallus_cbuffer_t s_cb = NULL;
+static int s_pipe[2] = { -1, -1 };
+
+
+static gallus_result_t
+s_yielder(void *arg) {
+  size_t i;
+
+  for (i = 0; i < N_YIELDS; i++) {
+    (void)__atomic_add_fetch(&s_n_steps, 1, __ATOMIC_SEQ_CST);
+    (void)gallus_fiber_yield();
+  }
+
+  return (gallus_result_t)(intptr_t)arg;
+}
+
+
+static gallus_result_t
+s_sleeper(void *arg) {
+  (void)arg;
+
+  if (gallus_fiber_self() == NULL) {
+    return GALLUS_RESULT_INVALID_STATE;
+  }
+
+  return gallus_chrono_nanosleep(20LL * 1000LL * 1000LL, NULL);
+}
+
+
+static gallus_result_t
+s_producer(void *arg) {
+  gallus_result_t ret = GALLUS_RESULT_OK;
+  int i;
+
+  (void)arg;
+
+  for (i = 0; i < N_VALUES && ret == GALLUS_RESULT_OK; i++) {
+    ret = gallus_cbuffer_put(&s_cb, &i, int, -1LL);
+  }
+
+  return ret;
+}
+
+
+static gallus_result_t
+s_consumer(void *arg) {
+  gallus_result_t ret = GALLUS_RESULT_OK;
+  int64_t sum = 0;
+  int i, v;
+
+  (void)arg;
+
+  for (i = 0; i < N_VALUES && ret == GALLUS_RESULT_OK; i++) {
+    ret = gallus_cbuffer_get(&s_cb, &v, int, -1LL);
+    sum += v;
+  }
+
+  return (ret == GALLUS_RESULT_OK) ? (gallus_result_t)sum : ret;
+}
+
+
+static gallus_result_t
+s_fd_waiter(void *arg) {
+  return gallus_fiber_wait_fd(s_pipe[0], POLLIN, (gallus_chrono_t)(intptr_t)arg);
+}
+
+
+
+
+
+void
+setUp(void) {
+  gallus_result_t ret;
+
+  (void)global_state_set(GLOBAL_STATE_STARTED);
+
+  /* one carrier: every blocking call must yield to get through. */
+  ret = gallus_fiber_sched_create(&s_sched, "fiber test", 1, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "sched create error.");
+  s_n_steps = 0;
+}
+
+
+void
+tearDown(void) {
+  gallus_fiber_sched_destroy(&s_sched);
+  TEST_ASSERT_NULL(s_sched);
+  if (s_cb != NULL) {
+    gallus_cbuffer_destroy(&s_cb, false);
+    s_cb = NULL;
+  }
+  if (s_pipe[0] >= 0) {
+    (void)close(s_pipe[0]);
+    (void)close(s_pipe[1]);
+    s_pipe[0] = s_pipe[1] = -1;
+  }
+}
+
+
+
+
+
+void
+test_fiber_spawn_yield(void) {
+  gallus_future_t fs[N_FIBERS];
+  gallus_result_t ret;
+  size_t i;
+
+  for (i = 0; i < N_FIBERS; i++) {
+    ret = gallus_fiber_spawn(&s_sched, s_yielder, (void *)(intptr_t)i, &fs[i]);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "spawn error.");
+  }
+  for (i = 0; i < N_FIBERS; i++) {
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_wait(&fs[i], -1LL));
+    TEST_ASSERT_EQUAL(i, gallus_future_get_result(&fs[i]));
+    gallus_future_destroy(&fs[i]);
+  }
+  TEST_ASSERT_EQUAL(N_FIBERS * N_YIELDS, s_n_steps);
+
+  TEST_ASSERT_NULL(gallus_fiber_self());
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_fiber_yield());
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_fiber_spawn(&s_sched, NULL, NULL, NULL));
+}
+
+
+void
+test_fiber_sleep(void) {
+  gallus_future_t fs[N_FIBERS];
+  gallus_result_t ret;
+  gallus_chrono_t t0, t1;
+  size_t i;
+
+  t0 = gallus_chrono_now();
+  for (i = 0; i < N_FIBERS; i++) {
+    ret = gallus_fiber_spawn(&s_sched, s_sleeper, NULL, &fs[i]);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "spawn error.");
+  }
+  for (i = 0; i < N_FIBERS; i++) {
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_wait(&fs[i], -1LL));
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_get_result(&fs[i]));
+    gallus_future_destroy(&fs[i]);
+  }
+  t1 = gallus_chrono_now();
+
+  /* the sleeps overlap on the single carrier. */
+  TEST_ASSERT_TRUE(t1 - t0 >= 20LL * 1000LL * 1000LL);
+  TEST_ASSERT_TRUE(t1 - t0 < 1000LL * 1000LL * 1000LL);
+}
+
+
+void
+test_fiber_cbuffer(void) {
+  gallus_future_t fp = NULL;
+  gallus_future_t fc = NULL;
+  gallus_result_t ret;
+  int i;
+
+  ret = gallus_cbuffer_create(&s_cb, int, 4, NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  /* both ends are fibers on the same carrier. */
+  ret = gallus_fiber_spawn(&s_sched, s_consumer, NULL, &fc);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_fiber_spawn(&s_sched, s_producer, NULL, &fp);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_wait(&fc, -1LL));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_wait(&fp, -1LL));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_get_result(&fp));
+  TEST_ASSERT_EQUAL((int64_t)N_VALUES * (N_VALUES - 1) / 2,
+                    gallus_future_get_result(&fc));
+  gallus_future_destroy(&fp);
+  gallus_future_destroy(&fc);
+
+  /* a thread feeds a fiber. */
+  ret = gallus_fiber_spawn(&s_sched, s_consumer, NULL, &fc);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  for (i = 0; i < N_VALUES; i++) {
+    ret = gallus_cbuffer_put(&s_cb, &i, int, -1LL);
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  }
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_wait(&fc, -1LL));
+  TEST_ASSERT_EQUAL((int64_t)N_VALUES * (N_VALUES - 1) / 2,
+                    gallus_future_get_result(&fc));
+  gallus_future_destroy(&fc);
+}
+
+
+void
+test_fiber_wait_fd(void) {
+  gallus_future_t f1 = NULL;
+  gallus_future_t f2 = NULL;
+  gallus_result_t ret;
+  char c = 'x';
+
+  TEST_ASSERT_EQUAL(0, pipe(s_pipe));
+
+  ret = gallus_fiber_spawn(&s_sched, s_fd_waiter,
+                           (void *)(intptr_t)(10LL * 1000LL * 1000LL), &f1);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_wait(&f1, -1LL));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_TIMEDOUT, gallus_future_get_result(&f1));
+
+  ret = gallus_fiber_spawn(&s_sched, s_fd_waiter, (void *)(intptr_t)-1,
+                           &f2);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  (void)gallus_chrono_nanosleep(10LL * 1000LL * 1000LL, NULL);
+  TEST_ASSERT_FALSE(gallus_future_is_done(&f2));
+
+  TEST_ASSERT_EQUAL(1, write(s_pipe[1], &c, 1));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_wait(&f2, -1LL));
+  TEST_ASSERT_TRUE((gallus_future_get_result(&f2) & POLLIN) != 0);
+
+  gallus_future_destroy(&f1);
+  gallus_future_destroy(&f2);
+}
+
+
+void
+test_fiber_shutdown(void) {
+  gallus_future_t f = NULL;
+  gallus_result_t ret;
+
+  ret = gallus_fiber_spawn(&s_sched, s_sleeper, NULL, &f);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  ret = gallus_fiber_sched_shutdown(&s_sched, 0LL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_TIMEDOUT, ret);
+  ret = gallus_fiber_spawn(&s_sched, s_sleeper, NULL, NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_NOT_OPERATIONAL, ret);
+
+  ret = gallus_fiber_sched_shutdown(&s_sched, -1LL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_TRUE(gallus_future_is_done(&f));
+  gallus_future_destroy(&f);
+}
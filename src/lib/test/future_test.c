@@ -0,0 +1,301 @@
+#include "gallus_apis.h"
+#include "unity.h"
+
+
+
+
+
+static gallus_thread_pool_t s_pool = NULL;
+
+
+static gallus_result_t
+s_add_one(gallus_future_t *inputs, size_t n_inputs, void *arg,
+          void **valptr) {
+  gallus_result_t ret = 1;
+  size_t i;
+
+  (void)arg;
+  (void)valptr;
+
+  for (i = 0; i < n_inputs; i++) {
+    ret += gallus_future_get_result(&inputs[i]);
+  }
+
+  return ret;
+}
+
+
+static gallus_result_t
+s_fail(gallus_future_t *inputs, size_t n_inputs, void *arg, void **valptr) {
+  (void)inputs;
+  (void)n_inputs;
+  (void)valptr;
+
+  return (gallus_result_t)(intptr_t)arg;
+}
+
+
+static gallus_result_t
+s_count(gallus_future_t *inputs, size_t n_inputs, void *arg,
+        void **valptr) {
+  (void)inputs;
+  (void)n_inputs;
+  (void)valptr;
+
+  (void)__atomic_add_fetch((size_t *)arg, 1, __ATOMIC_SEQ_CST);
+
+  return GALLUS_RESULT_OK;
+}
+
+
+static gallus_result_t
+s_task_main(gallus_task_t *tptr) {
+  (void)tptr;
+
+  return 10;
+}
+
+
+
+
+
+void
+setUp(void) {
+  gallus_result_t ret;
+
+  (void)global_state_set(GLOBAL_STATE_STARTED);
+
+  ret = gallus_thread_pool_create_executor(&s_pool, "future test", 2);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "executor create error.");
+}
+
+
+void
+tearDown(void) {
+  (void)gallus_thread_pool_shutdown_all(&s_pool, SHUTDOWN_GRACEFULLY, -1LL);
+  gallus_thread_pool_destroy(&s_pool);
+  s_pool = NULL;
+}
+
+
+
+
+
+void
+test_future_complete_wait(void) {
+  gallus_future_t f = NULL;
+  gallus_result_t ret;
+  int x = 0;
+  void *v = NULL;
+
+  ret = gallus_future_create(&f);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  TEST_ASSERT_FALSE(gallus_future_is_done(&f));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_NOT_STARTED, gallus_future_get_result(&f));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_NOT_STARTED, gallus_future_get_value(&f, &v));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_TIMEDOUT,
+                    gallus_future_wait(&f, 10LL * 1000LL * 1000LL));
+
+  ret = gallus_future_complete(&f, 5, &x);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_future_complete(&f, 6, NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_ALREADY_HALTED, ret);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_wait(&f, -1LL));
+  TEST_ASSERT_TRUE(gallus_future_is_done(&f));
+  TEST_ASSERT_EQUAL(5, gallus_future_get_result(&f));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_get_value(&f, &v));
+  TEST_ASSERT_TRUE(v == &x);
+
+  gallus_future_destroy(&f);
+  TEST_ASSERT_NULL(f);
+}
+
+
+void
+test_future_then(void) {
+  gallus_future_t p = NULL;
+  gallus_future_t f1 = NULL;
+  gallus_future_t f2 = NULL;
+  gallus_future_t f3 = NULL;
+  gallus_future_t fi = NULL;
+  gallus_result_t ret;
+
+  ret = gallus_future_create(&p);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  ret = gallus_future_then(&p, &s_pool, s_add_one, NULL, &f1);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_future_then(&f1, &s_pool, s_add_one, NULL, &f2);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_future_then(&f2, &s_pool, s_add_one, NULL, &f3);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  /* the intermediate ones can go before completion. */
+  gallus_future_destroy(&f1);
+  gallus_future_destroy(&f2);
+
+  TEST_ASSERT_FALSE(gallus_future_is_done(&f3));
+
+  ret = gallus_future_complete(&p, 1, NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_wait(&f3, -1LL));
+  TEST_ASSERT_EQUAL(4, gallus_future_get_result(&f3));
+
+  /* on a completed future without a pool: run right here. */
+  ret = gallus_future_then(&f3, NULL, s_add_one, NULL, &fi);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_TRUE(gallus_future_is_done(&fi));
+  TEST_ASSERT_EQUAL(5, gallus_future_get_result(&fi));
+
+  gallus_future_destroy(&fi);
+  gallus_future_destroy(&f3);
+  gallus_future_destroy(&p);
+}
+
+
+void
+test_future_when_all_any(void) {
+  gallus_future_t fs[3] = { NULL, NULL, NULL };
+  gallus_future_t all = NULL;
+  gallus_future_t any = NULL;
+  gallus_result_t ret;
+  size_t i;
+
+  for (i = 0; i < 3; i++) {
+    ret = gallus_future_create(&fs[i]);
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  }
+
+  ret = gallus_future_when_all(fs, 3, &all);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_future_when_any(fs, 3, &any);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  (void)gallus_future_complete(&fs[2], GALLUS_RESULT_OK, NULL);
+  TEST_ASSERT_TRUE(gallus_future_is_done(&any));
+  TEST_ASSERT_EQUAL(2, gallus_future_get_result(&any));
+  TEST_ASSERT_FALSE(gallus_future_is_done(&all));
+
+  (void)gallus_future_complete(&fs[1], GALLUS_RESULT_TIMEDOUT, NULL);
+  (void)gallus_future_complete(&fs[0], GALLUS_RESULT_OK, NULL);
+  TEST_ASSERT_TRUE(gallus_future_is_done(&all));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_TIMEDOUT, gallus_future_get_result(&all));
+  TEST_ASSERT_EQUAL(2, gallus_future_get_result(&any));
+
+  gallus_future_destroy(&all);
+  gallus_future_destroy(&any);
+  for (i = 0; i < 3; i++) {
+    gallus_future_destroy(&fs[i]);
+  }
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_future_when_all(fs, 0, &all));
+}
+
+
+void
+test_task_submit_future(void) {
+  gallus_task_t t = NULL;
+  gallus_future_t f = NULL;
+  gallus_future_t f2 = NULL;
+  gallus_result_t ret;
+
+  ret = gallus_task_create(&t, 0, NULL, s_task_main, NULL, NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_task_submit_future(&t, &s_pool,
+                                  GALLUS_TASK_DELETE_CONTEXT_AFTER_EXEC, &f);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_NULL(t);
+
+  ret = gallus_future_then(&f, &s_pool, s_add_one, NULL, &f2);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_wait(&f2, -1LL));
+  TEST_ASSERT_EQUAL(10, gallus_future_get_result(&f));
+  TEST_ASSERT_EQUAL(11, gallus_future_get_result(&f2));
+
+  gallus_future_destroy(&f);
+  gallus_future_destroy(&f2);
+}
+
+
+void
+test_task_graph_diamond(void) {
+  gallus_task_graph_t g = NULL;
+  gallus_future_t f = NULL;
+  gallus_result_t ret;
+  size_t a, b, c, d;
+  size_t deps[2];
+
+  ret = gallus_task_graph_create(&g, &s_pool);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  ret = gallus_task_graph_add(&g, s_add_one, NULL, NULL, 0, &a);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  deps[0] = a;
+  ret = gallus_task_graph_add(&g, s_add_one, NULL, deps, 1, &b);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_task_graph_add(&g, s_add_one, NULL, deps, 1, &c);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  deps[0] = b;
+  deps[1] = c;
+  ret = gallus_task_graph_add(&g, s_add_one, NULL, deps, 2, &d);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  deps[0] = 100;
+  ret = gallus_task_graph_add(&g, s_add_one, NULL, deps, 1, NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_NOT_FOUND, ret);
+
+  ret = gallus_task_graph_run(&g, -1LL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  /* a = 1, b = c = 2, d = 1 + 2 + 2 */
+  ret = gallus_task_graph_get_future(&g, d, &f);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_EQUAL(5, gallus_future_get_result(&f));
+
+  ret = gallus_task_graph_run(&g, -1LL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_STATE, ret);
+  ret = gallus_task_graph_add(&g, s_add_one, NULL, NULL, 0, NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_STATE, ret);
+
+  gallus_task_graph_destroy(&g);
+  TEST_ASSERT_NULL(g);
+}
+
+
+void
+test_task_graph_failure(void) {
+  gallus_task_graph_t g = NULL;
+  gallus_future_t f = NULL;
+  gallus_result_t ret;
+  size_t n_run = 0;
+  size_t a, b, c;
+
+  ret = gallus_task_graph_create(&g, &s_pool);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  ret = gallus_task_graph_add(&g, s_fail,
+                              (void *)(intptr_t)GALLUS_RESULT_NOT_FOUND,
+                              NULL, 0, &a);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_task_graph_add(&g, s_count, &n_run, &a, 1, &b);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_task_graph_add(&g, s_count, &n_run, NULL, 0, &c);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  ret = gallus_task_graph_run(&g, -1LL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_NOT_FOUND, ret);
+
+  /* b is skipped, c runs. */
+  TEST_ASSERT_EQUAL(1, n_run);
+  (void)gallus_task_graph_get_future(&g, b, &f);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_NOT_FOUND, gallus_future_get_result(&f));
+  (void)gallus_task_graph_get_future(&g, c, &f);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_future_get_result(&f));
+
+  gallus_task_graph_destroy(&g);
+}
@@ -97,6 +97,29 @@ s_finalize(const gallus_thread_t *tptr, bool is_canceled, void *arg) {
 }
 
 
+static void
+s_count_proc(global_state_t s, shutdown_grace_level_t l, void *arg) {
+  (void)s;
+  (void)l;
+
+  (*(size_t *)arg)++;
+}
+
+
+static void *
+s_waiter_main(void *arg) {
+  gallus_result_t *rptr = (gallus_result_t *)arg;
+  global_state_t s = GLOBAL_STATE_UNKNOWN;
+
+  *rptr = global_state_wait_for(GLOBAL_STATE_STARTED, &s, NULL, -1LL);
+  if (*rptr == GALLUS_RESULT_OK && s < GLOBAL_STATE_STARTED) {
+    *rptr = GALLUS_RESULT_ANY_FAILURES;
+  }
+
+  return NULL;
+}
+
+
 static inline gallus_result_t
 s_null_create(null_thread_t *nptr, shutdown_grace_level_t l) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
@@ -323,3 +346,126 @@ test_cancel2(void) {
 
   gallus_thread_destroy((gallus_thread_t *)&nt);
 }
+
+
+void
+test_wait_timeout(void) {
+  gallus_result_t r;
+  global_state_t s;
+
+  global_state_reset();
+
+  r = global_state_set(GLOBAL_STATE_INITIALIZING);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+
+  r = global_state_wait_for(GLOBAL_STATE_STARTED, &s, NULL, 0LL);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_TIMEDOUT);
+  r = global_state_wait_for(GLOBAL_STATE_STARTED, &s, NULL,
+                            1000LL * 1000LL * 10LL);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_TIMEDOUT);
+
+  r = global_state_set(GLOBAL_STATE_STARTED);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  r = global_state_wait_for(GLOBAL_STATE_STARTED, &s, NULL, 0LL);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  TEST_ASSERT_EQUAL(s, GLOBAL_STATE_STARTED);
+
+  r = global_state_set(GLOBAL_STATE_ACCEPT_SHUTDOWN);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  r = global_state_wait_for(GLOBAL_STATE_FINALIZED, &s, NULL, -1LL);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  TEST_ASSERT_EQUAL(s, GLOBAL_STATE_ACCEPT_SHUTDOWN);
+}
+
+
+void
+test_wait_threads(void) {
+  gallus_result_t r;
+  gallus_result_t rs[8];
+  pthread_t tids[8];
+  size_t i;
+
+  global_state_reset();
+
+  r = global_state_set(GLOBAL_STATE_INITIALIZING);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+
+  for (i = 0; i < 8; i++) {
+    rs[i] = GALLUS_RESULT_ANY_FAILURES;
+    TEST_ASSERT_EQUAL(0, pthread_create(&tids[i], NULL, s_waiter_main,
+                                        (void *)&rs[i]));
+  }
+
+  usleep(100000);
+
+  /*
+   * Not there yet, no one wakes up.
+   */
+  r = global_state_set(GLOBAL_STATE_STARTING);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  usleep(100000);
+  for (i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_ANY_FAILURES, rs[i]);
+  }
+
+  r = global_state_set(GLOBAL_STATE_STARTED);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  for (i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL(0, pthread_join(tids[i], NULL));
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, rs[i]);
+  }
+}
+
+
+void
+test_subscribe(void) {
+  gallus_result_t r;
+  size_t n = 0;
+  size_t n2 = 0;
+
+  global_state_reset();
+
+  r = global_state_set(GLOBAL_STATE_INITIALIZING);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+
+  r = global_state_subscribe(GLOBAL_STATE_STARTED, s_count_proc,
+                             (void *)&n);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  r = global_state_subscribe(GLOBAL_STATE_FINALIZED, s_count_proc,
+                             (void *)&n2);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+
+  r = global_state_set(GLOBAL_STATE_INITIALIZED);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  TEST_ASSERT_EQUAL(0, n);
+
+  r = global_state_set(GLOBAL_STATE_STARTED);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  TEST_ASSERT_EQUAL(1, n);
+
+  /*
+   * One shot.
+   */
+  r = global_state_set(GLOBAL_STATE_REQUEST_SHUTDOWN);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  TEST_ASSERT_EQUAL(1, n);
+  TEST_ASSERT_EQUAL(0, n2);
+
+  /*
+   * Already there, called right away.
+   */
+  r = global_state_subscribe(GLOBAL_STATE_STARTED, s_count_proc,
+                             (void *)&n);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  TEST_ASSERT_EQUAL(2, n);
+
+  r = global_state_unsubscribe(s_count_proc, (void *)&n);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_NOT_FOUND);
+  r = global_state_unsubscribe(s_count_proc, (void *)&n2);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_OK);
+  r = global_state_unsubscribe(s_count_proc, (void *)&n2);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_NOT_FOUND);
+
+  r = global_state_subscribe(GLOBAL_STATE_STARTED, NULL, NULL);
+  TEST_ASSERT_EQUAL(r, GALLUS_RESULT_INVALID_ARGS);
+}
@@ -0,0 +1,228 @@
+#include "gallus_apis.h"
+#include "unity.h"
+
+
+
+
+
+#define N_ALLOCS	16
+#define TAG		GALLUS_HEAPCHECK_TAG_LOGGER	/* not used by the lib. */
+
+
+static gallus_heapcheck_snapshot_t s_before;
+
+
+static int64_t
+s_live(const gallus_heapcheck_stat_t *st) {
+  return (int64_t)(st->m_allocd_bytes - st->m_freed_bytes);
+}
+
+
+static void *
+s_thread_main(void *arg) {
+  void **ptrs = (void **)arg;
+  size_t i;
+
+  for (i = 0; i < N_ALLOCS; i++) {
+    ptrs[i] = gallus_heapcheck_malloc(TAG, 100);
+  }
+
+  return NULL;
+}
+
+
+static void
+s_alloc_site(void **ptrs) {
+  size_t i;
+
+  for (i = 0; i < N_ALLOCS; i++) {
+    ptrs[i] = gallus_heapcheck_malloc(TAG, 1000);
+  }
+}
+
+
+
+
+
+void
+setUp(void) {
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_heapcheck_snapshot(&s_before));
+}
+
+
+void
+tearDown(void) {
+  gallus_heapcheck_set_sampling(0);
+  gallus_heapcheck_reset_sites();
+}
+
+
+
+
+
+void
+test_counts(void) {
+  gallus_heapcheck_snapshot_t after;
+  void *ptrs[N_ALLOCS];
+  size_t i;
+
+  for (i = 0; i < N_ALLOCS; i++) {
+    ptrs[i] = gallus_heapcheck_malloc(TAG, 100);
+    TEST_ASSERT_NOT_NULL(ptrs[i]);
+  }
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_heapcheck_snapshot(&after));
+  TEST_ASSERT_EQUAL(N_ALLOCS, after.m_tags[TAG].m_n_allocs -
+                    s_before.m_tags[TAG].m_n_allocs);
+  TEST_ASSERT_TRUE(s_live(&after.m_tags[TAG]) - s_live(&s_before.m_tags[TAG])
+                   >= 100 * N_ALLOCS);
+  TEST_ASSERT_TRUE(after.m_total.m_n_allocs >=
+                   s_before.m_total.m_n_allocs + N_ALLOCS);
+
+  for (i = 0; i < N_ALLOCS; i++) {
+    gallus_heapcheck_free(TAG, ptrs[i]);
+  }
+  gallus_heapcheck_free(TAG, NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_heapcheck_snapshot(&after));
+  TEST_ASSERT_EQUAL(N_ALLOCS, after.m_tags[TAG].m_n_frees -
+                    s_before.m_tags[TAG].m_n_frees);
+  TEST_ASSERT_TRUE(s_live(&after.m_tags[TAG]) ==
+                   s_live(&s_before.m_tags[TAG]));
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_heapcheck_snapshot(NULL));
+  TEST_ASSERT_EQUAL_STRING("dstring",
+                           gallus_heapcheck_tag_name(
+                             GALLUS_HEAPCHECK_TAG_DSTRING));
+  TEST_ASSERT_EQUAL_STRING("unknown",
+                           gallus_heapcheck_tag_name(
+                             GALLUS_HEAPCHECK_TAG_MAX));
+}
+
+
+void
+test_realloc_strdup(void) {
+  gallus_heapcheck_snapshot_t after;
+  char *p = NULL;
+  char *s = NULL;
+
+  p = (char *)gallus_heapcheck_realloc(TAG, NULL, 10);
+  TEST_ASSERT_NOT_NULL(p);
+  p = (char *)gallus_heapcheck_realloc(TAG, p, 10000);
+  TEST_ASSERT_NOT_NULL(p);
+  s = gallus_heapcheck_strdup(TAG, "heapcheck");
+  TEST_ASSERT_EQUAL_STRING("heapcheck", s);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_heapcheck_snapshot(&after));
+  TEST_ASSERT_EQUAL(3, after.m_tags[TAG].m_n_allocs -
+                    s_before.m_tags[TAG].m_n_allocs);
+  TEST_ASSERT_EQUAL(1, after.m_tags[TAG].m_n_frees -
+                    s_before.m_tags[TAG].m_n_frees);
+  TEST_ASSERT_TRUE(s_live(&after.m_tags[TAG]) - s_live(&s_before.m_tags[TAG])
+                   >= 10000);
+
+  gallus_heapcheck_free(TAG, p);
+  gallus_heapcheck_free(TAG, s);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_heapcheck_snapshot(&after));
+  TEST_ASSERT_TRUE(s_live(&after.m_tags[TAG]) ==
+                   s_live(&s_before.m_tags[TAG]));
+}
+
+
+void
+test_thread_exit(void) {
+  gallus_heapcheck_snapshot_t after;
+  void *ptrs[N_ALLOCS];
+  pthread_t t;
+  size_t i;
+
+  TEST_ASSERT_EQUAL(0, pthread_create(&t, NULL, s_thread_main,
+                                      (void *)ptrs));
+  TEST_ASSERT_EQUAL(0, pthread_join(t, NULL));
+
+  /*
+   * The counts of the exited thread are kept.
+   */
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_heapcheck_snapshot(&after));
+  TEST_ASSERT_EQUAL(N_ALLOCS, after.m_tags[TAG].m_n_allocs -
+                    s_before.m_tags[TAG].m_n_allocs);
+  TEST_ASSERT_EQUAL(s_before.m_n_threads, after.m_n_threads);
+
+  for (i = 0; i < N_ALLOCS; i++) {
+    gallus_heapcheck_free(TAG, ptrs[i]);
+  }
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_heapcheck_snapshot(&after));
+  TEST_ASSERT_TRUE(s_live(&after.m_tags[TAG]) ==
+                   s_live(&s_before.m_tags[TAG]));
+}
+
+
+void
+test_subsystems(void) {
+  gallus_heapcheck_snapshot_t after;
+  gallus_dstring_t ds = NULL;
+  gallus_hashmap_t hm = NULL;
+  size_t i;
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_dstring_create(&ds));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_dstring_appendf(&ds, "%s",
+                    "accounted to the dstring"));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_hashmap_create(&hm, GALLUS_HASHMAP_TYPE_ONE_WORD,
+                                          NULL));
+  for (i = 0; i < 100; i++) {
+    void *v = (void *)i;
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                      gallus_hashmap_add(&hm, (void *)i, &v, false));
+  }
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_heapcheck_snapshot(&after));
+  TEST_ASSERT_TRUE(
+    s_live(&after.m_tags[GALLUS_HEAPCHECK_TAG_DSTRING]) >
+    s_live(&s_before.m_tags[GALLUS_HEAPCHECK_TAG_DSTRING]));
+  TEST_ASSERT_TRUE(
+    after.m_tags[GALLUS_HEAPCHECK_TAG_HASHMAP].m_n_allocs -
+    s_before.m_tags[GALLUS_HEAPCHECK_TAG_HASHMAP].m_n_allocs >= 101);
+
+  gallus_dstring_destroy(&ds);
+  gallus_hashmap_destroy(&hm, false);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_heapcheck_snapshot(&after));
+  TEST_ASSERT_TRUE(
+    s_live(&after.m_tags[GALLUS_HEAPCHECK_TAG_DSTRING]) ==
+    s_live(&s_before.m_tags[GALLUS_HEAPCHECK_TAG_DSTRING]));
+  TEST_ASSERT_TRUE(
+    s_live(&after.m_tags[GALLUS_HEAPCHECK_TAG_HASHMAP]) ==
+    s_live(&s_before.m_tags[GALLUS_HEAPCHECK_TAG_HASHMAP]));
+}
+
+
+void
+test_sampling(void) {
+  gallus_heapcheck_site_t sites[4];
+  void *ptrs[N_ALLOCS];
+  gallus_result_t n;
+  size_t i;
+
+  gallus_heapcheck_set_sampling(2);
+  TEST_ASSERT_EQUAL(2, gallus_heapcheck_get_sampling());
+
+  s_alloc_site(ptrs);
+  n = gallus_heapcheck_get_sites(sites, 4);
+  TEST_ASSERT_TRUE(n >= 1);
+  /* the most bytes first, the loop in the s_alloc_site(). */
+  TEST_ASSERT_EQUAL(TAG, sites[0].m_tag);
+  TEST_ASSERT_EQUAL(N_ALLOCS / 2, sites[0].m_n_samples);
+  TEST_ASSERT_TRUE(sites[0].m_bytes >= 1000 * N_ALLOCS / 2);
+  TEST_ASSERT_TRUE(sites[0].m_n_frames > 0);
+
+  gallus_heapcheck_dump(stdout, 1);
+
+  for (i = 0; i < N_ALLOCS; i++) {
+    gallus_heapcheck_free(TAG, ptrs[i]);
+  }
+
+  gallus_heapcheck_reset_sites();
+  TEST_ASSERT_EQUAL(0, gallus_heapcheck_get_sites(sites, 4));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_heapcheck_get_sites(NULL, 4));
+}
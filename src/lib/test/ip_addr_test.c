@@ -428,3 +428,97 @@ test_ip_address_public_sockaddr(void) {
   gallus_ip_address_destroy(ip3);
   free(ip4);
 }
+
+void
+test_ip_address_numeric(void) {
+  gallus_result_t rc;
+  gallus_ip_address_t *ip = NULL;
+
+  // v4 mapped v6 resolves to v4 when IPv4 is preferred
+  rc = gallus_ip_address_create("::FFFF:10.1.2.3", true, &ip);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, rc);
+  TEST_ASSERT_EQUAL(true, ip->is_ipv4);
+  TEST_ASSERT_EQUAL(sizeof(struct sockaddr_in), ip->saddr_len);
+  TEST_ASSERT_EQUAL_STRING("10.1.2.3", ip->addr_str);
+  gallus_ip_address_destroy(ip);
+
+  rc = gallus_ip_address_create("::FFFF:10.1.2.3", false, &ip);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, rc);
+  TEST_ASSERT_EQUAL(false, ip->is_ipv4);
+  TEST_ASSERT_EQUAL_STRING("::ffff:10.1.2.3", ip->addr_str);
+  gallus_ip_address_destroy(ip);
+
+  rc = gallus_ip_address_create("255.0.10.9", false, &ip);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, rc);
+  TEST_ASSERT_EQUAL(AF_INET, (ip->saddr).ss_family);
+  TEST_ASSERT_EQUAL_STRING("255.0.10.9", ip->addr_str);
+  gallus_ip_address_destroy(ip);
+
+  // not for inet_pton(), still resolved
+  rc = gallus_ip_address_create("127.1", true, &ip);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, rc);
+  TEST_ASSERT_EQUAL_STRING("127.0.0.1", ip->addr_str);
+  gallus_ip_address_destroy(ip);
+
+  // numeric ones aren't cached
+  (void)gallus_mutex_lock(&s_cache_lock);
+  TEST_ASSERT_NULL(s_cache_find("255.0.10.9", false,
+                                s_hash("255.0.10.9", false)));
+  (void)gallus_mutex_unlock(&s_cache_lock);
+}
+
+void
+test_ip_address_cache(void) {
+  gallus_result_t rc;
+  gallus_ip_address_t *ip = NULL;
+  cache_entry_t *e;
+  gallus_chrono_t ttl = 200LL * 1000LL * 1000LL;
+  gallus_chrono_t expire;
+  int i;
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_ip_address_cache_ttl_set(ttl));
+
+  rc = gallus_ip_address_create("localhost", true, &ip);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, rc);
+  TEST_ASSERT_EQUAL_STRING("127.0.0.1", ip->addr_str);
+  gallus_ip_address_destroy(ip);
+
+  (void)gallus_mutex_lock(&s_cache_lock);
+  e = s_cache_find("localhost", true, s_hash("localhost", true));
+  TEST_ASSERT_NOT_NULL(e);
+  expire = e->m_expire;
+  (void)gallus_mutex_unlock(&s_cache_lock);
+
+  // stale: served and refreshed in the background
+  (void)gallus_chrono_nanosleep(ttl + ttl / 4, NULL);
+  rc = gallus_ip_address_create("localhost", true, &ip);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, rc);
+  TEST_ASSERT_EQUAL_STRING("127.0.0.1", ip->addr_str);
+  gallus_ip_address_destroy(ip);
+
+  for (i = 0; i < 100; i++) {
+    (void)gallus_mutex_lock(&s_cache_lock);
+    e = s_cache_find("localhost", true, s_hash("localhost", true));
+    if (e != NULL && e->m_is_refreshing == false && e->m_expire > expire) {
+      i = -1;
+    }
+    (void)gallus_mutex_unlock(&s_cache_lock);
+    if (i < 0) {
+      break;
+    }
+    (void)gallus_chrono_nanosleep(10LL * 1000LL * 1000LL, NULL);
+  }
+  TEST_ASSERT_EQUAL(-1, i);
+
+  // disabled
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_ip_address_cache_ttl_set(0));
+  rc = gallus_ip_address_create("localhost", true, &ip);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, rc);
+  gallus_ip_address_destroy(ip);
+  (void)gallus_mutex_lock(&s_cache_lock);
+  TEST_ASSERT_EQUAL(0, s_n_cache_entries);
+  (void)gallus_mutex_unlock(&s_cache_lock);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_ip_address_cache_ttl_set(CACHE_TTL_DEFAULT));
+}
@@ -0,0 +1,516 @@
+#include "unity.h"
+#include "gallus_apis.h"
+
+/*
+ * The locks under contention.
+ *
+ * The threads hammer a lock around a tiny critical section (a
+ * counter bump), the numbers are ns/op and ops/s over all the
+ * threads:
+ *
+ *   mutex		gallus_mutex_lock()/unlock(), pthread
+ *   mutex crit		gallus_mutex_enter_critical()/leave_critical(),
+ *			pthread + the cancel state toggling
+ *   futex		the same two with a GALLUS_MUTEX_TYPE_FUTEX mutex
+ *   futex crit
+ *   spin		gallus_spinlock_t (pthread_spinlock_t)
+ *   ticket		gallus_ticketlock_t
+ *   mcs		gallus_mcslock_t
+ *
+ * The rwlocks run a read-mostly mix, the readers only load the
+ * counter:
+ *
+ *   rwlock crit	GALLUS_RWLOCK_TYPE_DEFAULT, enter/leave_critical()
+ *   rwlock futex crit	GALLUS_RWLOCK_TYPE_FUTEX, enter/leave_critical()
+ *   rwlock dist crit	GALLUS_RWLOCK_TYPE_DISTRIBUTED,
+ *			enter/leave_critical()
+ *
+ * The rwlock scaling runs the three rwlock types with 1, 2, 4, ...
+ * reader threads at 0.1% writes, the ns/op should stay flat as the
+ * threads are added on a lock whose readers don't share a line.
+ *
+ * Environment:
+ *   LOCK_PERF_OPS		ops per thread (default 200000)
+ *   LOCK_PERF_THREADS		threads (default 4)
+ *   LOCK_PERF_WRITE_PERMIL	rwlock writes per 1000 ops (default 10)
+ *   LOCK_PERF_SCALE_OPS	ops per thread of the scaling
+ *				(default 50000)
+ *   LOCK_PERF_SCALE_THREADS	max threads of the scaling (default 64)
+ */
+
+#define OUTPUT stdout
+
+#define DEFAULT_OPS		200000
+#define DEFAULT_THREADS		4
+#define DEFAULT_WRITE_PERMIL	10
+#define DEFAULT_SCALE_OPS	50000
+#define DEFAULT_SCALE_THREADS	64
+#define SCALE_WRITE_PERMIL	1
+#define MAX_THREADS		256
+
+typedef enum {
+  KIND_MUTEX = 0,
+  KIND_MUTEX_CRITICAL,
+  KIND_SPIN,
+  KIND_TICKET,
+  KIND_MCS,
+  KIND_RWLOCK_CRITICAL
+} lock_kind_t;
+
+typedef struct {
+  lock_kind_t m_kind;
+  gallus_mutex_t m_mtx;
+  gallus_rwlock_t m_rwl;
+  gallus_spinlock_t m_spin;
+  gallus_ticketlock_t m_ticket;
+  gallus_mcslock_t m_mcs;
+  size_t m_n_threads;
+  size_t m_n_ops;
+  size_t m_write_permil;
+  pthread_barrier_t m_barrier;
+  volatile uint64_t m_counter;
+  uint64_t m_n_writes;
+} bench_record;
+
+typedef struct {
+  bench_record *m_b;
+  uint64_t m_seed;
+} bench_arg_record;
+
+static size_t s_n_ops = DEFAULT_OPS;
+static size_t s_n_threads = DEFAULT_THREADS;
+static size_t s_write_permil = DEFAULT_WRITE_PERMIL;
+static size_t s_n_scale_ops = DEFAULT_SCALE_OPS;
+static size_t s_n_scale_threads = DEFAULT_SCALE_THREADS;
+
+void
+setUp(void) {
+  const char *e;
+
+  if ((e = getenv("LOCK_PERF_OPS")) != NULL && atoi(e) > 0) {
+    s_n_ops = (size_t)atoi(e);
+  }
+  if ((e = getenv("LOCK_PERF_THREADS")) != NULL && atoi(e) > 0) {
+    s_n_threads = (size_t)atoi(e);
+    if (s_n_threads > MAX_THREADS) {
+      s_n_threads = MAX_THREADS;
+    }
+  }
+  if ((e = getenv("LOCK_PERF_WRITE_PERMIL")) != NULL && atoi(e) >= 0) {
+    s_write_permil = (size_t)atoi(e);
+  }
+  if ((e = getenv("LOCK_PERF_SCALE_OPS")) != NULL && atoi(e) > 0) {
+    s_n_scale_ops = (size_t)atoi(e);
+  }
+  if ((e = getenv("LOCK_PERF_SCALE_THREADS")) != NULL && atoi(e) > 0) {
+    s_n_scale_threads = (size_t)atoi(e);
+    if (s_n_scale_threads > MAX_THREADS) {
+      s_n_scale_threads = MAX_THREADS;
+    }
+  }
+}
+
+void
+tearDown(void) {
+}
+
+
+
+
+
+static inline uint64_t
+s_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000LL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t
+s_rand(uint64_t *seedptr) {
+  *seedptr ^= *seedptr << 13;
+  *seedptr ^= *seedptr >> 7;
+  *seedptr ^= *seedptr << 17;
+  return *seedptr;
+}
+
+static void
+s_report(const char *label, size_t n_threads, size_t n, uint64_t total) {
+  fprintf(OUTPUT, "%-18s threads %3zu ops %9zu: %8.1f ns/op, "
+          "%12.0f ops/s\n",
+          label, n_threads, n,
+          (double)total / (double)n,
+          (double)n * 1e9 / (double)total);
+  fflush(OUTPUT);
+}
+
+static void *
+s_bench_main(void *arg) {
+  bench_arg_record *a = (bench_arg_record *)arg;
+  bench_record *b = a->m_b;
+  gallus_mcslock_node_t node;
+  uint64_t n_writes = 0;
+  volatile uint64_t sink = 0;
+  int ostate;
+  size_t i;
+
+  (void)pthread_barrier_wait(&(b->m_barrier));
+
+  for (i = 0; i < b->m_n_ops; i++) {
+    switch (b->m_kind) {
+      case KIND_MUTEX: {
+        (void)gallus_mutex_lock(&(b->m_mtx));
+        b->m_counter++;
+        (void)gallus_mutex_unlock(&(b->m_mtx));
+        break;
+      }
+      case KIND_MUTEX_CRITICAL: {
+        (void)gallus_mutex_enter_critical(&(b->m_mtx), &ostate);
+        b->m_counter++;
+        (void)gallus_mutex_leave_critical(&(b->m_mtx), ostate);
+        break;
+      }
+      case KIND_SPIN: {
+        (void)gallus_spinlock_lock(&(b->m_spin));
+        b->m_counter++;
+        (void)gallus_spinlock_unlock(&(b->m_spin));
+        break;
+      }
+      case KIND_TICKET: {
+        (void)gallus_ticketlock_lock(&(b->m_ticket));
+        b->m_counter++;
+        (void)gallus_ticketlock_unlock(&(b->m_ticket));
+        break;
+      }
+      case KIND_MCS: {
+        (void)gallus_mcslock_lock(&(b->m_mcs), &node);
+        b->m_counter++;
+        (void)gallus_mcslock_unlock(&(b->m_mcs), &node);
+        break;
+      }
+      case KIND_RWLOCK_CRITICAL: {
+        if (s_rand(&(a->m_seed)) % 1000 < b->m_write_permil) {
+          (void)gallus_rwlock_writer_enter_critical(&(b->m_rwl), &ostate);
+          b->m_counter++;
+          (void)gallus_rwlock_leave_critical(&(b->m_rwl), ostate);
+          n_writes++;
+        } else {
+          (void)gallus_rwlock_reader_enter_critical(&(b->m_rwl), &ostate);
+          sink += b->m_counter;
+          (void)gallus_rwlock_leave_critical(&(b->m_rwl), ostate);
+        }
+        break;
+      }
+    }
+  }
+
+  (void)__atomic_add_fetch(&(b->m_n_writes), n_writes, __ATOMIC_RELAXED);
+
+  return NULL;
+}
+
+/*
+ * Run b->m_n_threads threads of b->m_n_ops ops each, or the
+ * defaults if they are 0.
+ */
+static void
+s_bench(const char *label, bench_record *b) {
+  pthread_t thds[MAX_THREADS];
+  bench_arg_record args[MAX_THREADS];
+  uint64_t start;
+  size_t i;
+
+  if (b->m_n_threads == 0) {
+    b->m_n_threads = s_n_threads;
+  }
+  if (b->m_n_ops == 0) {
+    b->m_n_ops = s_n_ops;
+    b->m_write_permil = s_write_permil;
+  }
+  b->m_counter = 0;
+  b->m_n_writes = 0;
+  TEST_ASSERT_EQUAL(0, pthread_barrier_init(&(b->m_barrier), NULL,
+                                            (unsigned)b->m_n_threads + 1));
+  for (i = 0; i < b->m_n_threads; i++) {
+    args[i].m_b = b;
+    args[i].m_seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+    TEST_ASSERT_EQUAL(0, pthread_create(&thds[i], NULL, s_bench_main,
+                                        &args[i]));
+  }
+
+  (void)pthread_barrier_wait(&(b->m_barrier));
+  start = s_now();
+  for (i = 0; i < b->m_n_threads; i++) {
+    (void)pthread_join(thds[i], NULL);
+  }
+  s_report(label, b->m_n_threads, b->m_n_ops * b->m_n_threads,
+           s_now() - start);
+  (void)pthread_barrier_destroy(&(b->m_barrier));
+
+  if (b->m_kind == KIND_RWLOCK_CRITICAL) {
+    TEST_ASSERT_TRUE(b->m_n_writes == b->m_counter);
+  } else {
+    TEST_ASSERT_TRUE(b->m_n_ops * b->m_n_threads == b->m_counter);
+  }
+}
+
+
+
+
+
+static gallus_mutex_t s_cond_mtx = NULL;
+static gallus_cond_t s_cond = NULL;
+static volatile bool s_cond_flag = false;
+
+static void *
+s_cond_main(void *arg) {
+  (void)arg;
+
+  (void)gallus_chrono_nanosleep(10LL * 1000LL * 1000LL, NULL);
+  (void)gallus_mutex_lock(&s_cond_mtx);
+  {
+    s_cond_flag = true;
+    (void)gallus_cond_notify(&s_cond, true);
+  }
+  (void)gallus_mutex_unlock(&s_cond_mtx);
+
+  return NULL;
+}
+
+
+void
+test_futex_mutex(void) {
+  gallus_mutex_t mtx = NULL;
+  gallus_mutex_type_t type;
+  pthread_t thd;
+  int ostate;
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_mutex_create_with_type(&mtx,
+                                                  GALLUS_MUTEX_TYPE_UNKNOWN));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_mutex_create_with_type(&mtx,
+                                                  GALLUS_MUTEX_TYPE_FUTEX));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mutex_get_type(&mtx, &type));
+  TEST_ASSERT_EQUAL(GALLUS_MUTEX_TYPE_FUTEX, type);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mutex_lock(&mtx));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_BUSY, gallus_mutex_trylock(&mtx));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mutex_unlock(&mtx));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mutex_trylock(&mtx));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mutex_unlock(&mtx));
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_mutex_enter_critical(&mtx, &ostate));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_mutex_leave_critical(&mtx, ostate));
+
+  /*
+   * cond waits with a futex mutex.
+   */
+  s_cond_mtx = mtx;
+  s_cond_flag = false;
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_cond_create(&s_cond));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mutex_lock(&s_cond_mtx));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_TIMEDOUT,
+                    gallus_cond_wait(&s_cond, &s_cond_mtx,
+                                     5LL * 1000LL * 1000LL));
+  TEST_ASSERT_EQUAL(0, pthread_create(&thd, NULL, s_cond_main, NULL));
+  while (s_cond_flag == false) {
+    TEST_ASSERT_TRUE(IS_GALLUS_RESULT_OK(
+        gallus_cond_wait(&s_cond, &s_cond_mtx,
+                         1000LL * 1000LL * 1000LL)));
+  }
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mutex_unlock(&s_cond_mtx));
+  (void)pthread_join(thd, NULL);
+
+  gallus_cond_destroy(&s_cond);
+  gallus_mutex_destroy(&mtx);
+  s_cond_mtx = NULL;
+}
+
+
+static void
+s_rwlock_semantics(gallus_rwlock_type_t t) {
+  gallus_rwlock_t rwl = NULL;
+  gallus_rwlock_type_t type;
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_rwlock_create_with_type(
+                        &rwl, GALLUS_RWLOCK_TYPE_UNKNOWN));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_rwlock_create_with_type(&rwl, t));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_rwlock_get_type(&rwl, &type));
+  TEST_ASSERT_EQUAL(t, type);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_rwlock_reader_lock(&rwl));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_rwlock_reader_trylock(&rwl));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_BUSY, gallus_rwlock_writer_trylock(&rwl));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_TIMEDOUT,
+                    gallus_rwlock_writer_timedlock(&rwl,
+                                                   10LL * 1000LL * 1000LL));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_rwlock_unlock(&rwl));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_rwlock_unlock(&rwl));
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_rwlock_writer_lock(&rwl));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_BUSY, gallus_rwlock_reader_trylock(&rwl));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_TIMEDOUT,
+                    gallus_rwlock_reader_timedlock(&rwl,
+                                                   10LL * 1000LL * 1000LL));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_rwlock_unlock(&rwl));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_rwlock_writer_trylock(&rwl));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_rwlock_unlock(&rwl));
+
+  gallus_rwlock_destroy(&rwl);
+}
+
+
+void
+test_futex_rwlock(void) {
+  s_rwlock_semantics(GALLUS_RWLOCK_TYPE_FUTEX);
+}
+
+
+void
+test_distributed_rwlock(void) {
+  gallus_hashmap_t hm = NULL;
+  void *val = (void *)1;
+
+  s_rwlock_semantics(GALLUS_RWLOCK_TYPE_DISTRIBUTED);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_hashmap_create_with_lock_type(
+                        &hm, GALLUS_HASHMAP_TYPE_STRING, NULL,
+                        GALLUS_RWLOCK_TYPE_DISTRIBUTED));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_hashmap_add(&hm, (void *)"key", &val, false));
+  val = NULL;
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_hashmap_find(&hm, (void *)"key", &val));
+  TEST_ASSERT_TRUE(val == (void *)1);
+  gallus_hashmap_destroy(&hm, false);
+}
+
+
+void
+test_spinlocks_try(void) {
+  gallus_ticketlock_t t;
+  gallus_mcslock_t m;
+  gallus_mcslock_node_t n0, n1;
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_ticketlock_initialize(&t));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_ticketlock_trylock(&t));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_BUSY, gallus_ticketlock_trylock(&t));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_ticketlock_unlock(&t));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_ticketlock_lock(&t));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_ticketlock_unlock(&t));
+  gallus_ticketlock_finalize(&t);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mcslock_initialize(&m));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mcslock_trylock(&m, &n0));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_BUSY, gallus_mcslock_trylock(&m, &n1));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mcslock_unlock(&m, &n0));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mcslock_lock(&m, &n1));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mcslock_unlock(&m, &n1));
+  gallus_mcslock_finalize(&m);
+}
+
+
+void
+test_mutex(void) {
+  bench_record b;
+
+  (void)memset(&b, 0, sizeof(b));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mutex_create(&(b.m_mtx)));
+  b.m_kind = KIND_MUTEX;
+  s_bench("mutex", &b);
+  b.m_kind = KIND_MUTEX_CRITICAL;
+  s_bench("mutex crit", &b);
+  gallus_mutex_destroy(&(b.m_mtx));
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_mutex_create_with_type(&(b.m_mtx),
+                                                  GALLUS_MUTEX_TYPE_FUTEX));
+  b.m_kind = KIND_MUTEX;
+  s_bench("futex", &b);
+  b.m_kind = KIND_MUTEX_CRITICAL;
+  s_bench("futex crit", &b);
+  gallus_mutex_destroy(&(b.m_mtx));
+}
+
+
+void
+test_spinlocks(void) {
+  bench_record b;
+
+  (void)memset(&b, 0, sizeof(b));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_spinlock_initialize(&(b.m_spin)));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_ticketlock_initialize(&(b.m_ticket)));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_mcslock_initialize(&(b.m_mcs)));
+
+  b.m_kind = KIND_SPIN;
+  s_bench("spin", &b);
+  b.m_kind = KIND_TICKET;
+  s_bench("ticket", &b);
+  b.m_kind = KIND_MCS;
+  s_bench("mcs", &b);
+
+  gallus_spinlock_finalize(&(b.m_spin));
+  gallus_ticketlock_finalize(&(b.m_ticket));
+  gallus_mcslock_finalize(&(b.m_mcs));
+}
+
+
+void
+test_rwlock(void) {
+  bench_record b;
+
+  (void)memset(&b, 0, sizeof(b));
+  b.m_kind = KIND_RWLOCK_CRITICAL;
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_rwlock_create(&(b.m_rwl)));
+  s_bench("rwlock crit", &b);
+  gallus_rwlock_destroy(&(b.m_rwl));
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_rwlock_create_with_type(&(b.m_rwl),
+                                                   GALLUS_RWLOCK_TYPE_FUTEX));
+  s_bench("rwlock futex crit", &b);
+  gallus_rwlock_destroy(&(b.m_rwl));
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_rwlock_create_with_type(
+                        &(b.m_rwl), GALLUS_RWLOCK_TYPE_DISTRIBUTED));
+  s_bench("rwlock dist crit", &b);
+  gallus_rwlock_destroy(&(b.m_rwl));
+}
+
+
+void
+test_rwlock_scaling(void) {
+  static const struct {
+    const char *m_label;
+    gallus_rwlock_type_t m_type;
+  } types[] = {
+    { "scale default", GALLUS_RWLOCK_TYPE_DEFAULT },
+    { "scale futex", GALLUS_RWLOCK_TYPE_FUTEX },
+    { "scale dist", GALLUS_RWLOCK_TYPE_DISTRIBUTED },
+  };
+  bench_record b;
+  size_t i, n;
+
+  for (i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+    for (n = 1; n <= s_n_scale_threads; n *= 2) {
+      (void)memset(&b, 0, sizeof(b));
+      b.m_kind = KIND_RWLOCK_CRITICAL;
+      b.m_n_threads = n;
+      b.m_n_ops = s_n_scale_ops;
+      b.m_write_permil = SCALE_WRITE_PERMIL;
+      TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                        gallus_rwlock_create_with_type(&(b.m_rwl),
+                                                       types[i].m_type));
+      s_bench(types[i].m_label, &b);
+      gallus_rwlock_destroy(&(b.m_rwl));
+    }
+  }
+}
@@ -0,0 +1,331 @@
+#include "gallus_apis.h"
+#include "unity.h"
+
+#include <sys/wait.h>
+
+
+
+
+
+/*
+ * base <- left, right <- top <- legacy (registered w/o dependencies.)
+ */
+#define MOD_BASE	0
+#define MOD_LEFT	1
+#define MOD_RIGHT	2
+#define MOD_TOP		3
+#define MOD_LEGACY	4
+#define N_MODS		5
+
+#define PH_INIT		0
+#define PH_START	1
+#define PH_SHUTDOWN	2
+#define PH_FINALIZE	3
+#define N_PHS		4
+
+
+static size_t s_ids[N_MODS] = { 0, 1, 2, 3, 4 };
+static volatile size_t s_seq = 0;
+static volatile size_t s_stamps[N_MODS][N_PHS];
+static volatile bool s_is_in_init[N_MODS];
+
+
+
+
+
+static gallus_result_t
+s_stamp(size_t id, size_t ph) {
+  s_stamps[id][ph] = __sync_add_and_fetch(&s_seq, 1);
+  return GALLUS_RESULT_OK;
+}
+
+
+/*
+ * Both wait for each other in the initialization, which only
+ * completes if they run concurrently.
+ */
+static gallus_result_t
+s_rendezvous(size_t id, size_t other) {
+  size_t i;
+
+  s_is_in_init[id] = true;
+  mbar();
+  for (i = 0; i < 5000 && s_is_in_init[other] == false; i++) {
+    (void)gallus_chrono_nanosleep(1000LL * 1000LL, NULL);
+    mbar();
+  }
+
+  return (s_is_in_init[other] == true) ?
+         GALLUS_RESULT_OK : GALLUS_RESULT_TIMEDOUT;
+}
+
+
+static gallus_result_t
+s_init(int argc, const char *const argv[], void *extarg,
+       gallus_thread_t **thdptr) {
+  size_t id = *(size_t *)extarg;
+  gallus_result_t ret = GALLUS_RESULT_OK;
+
+  (void)argc;
+  (void)argv;
+  (void)thdptr;
+
+  if (id == MOD_LEFT) {
+    ret = s_rendezvous(MOD_LEFT, MOD_RIGHT);
+  } else if (id == MOD_RIGHT) {
+    ret = s_rendezvous(MOD_RIGHT, MOD_LEFT);
+  }
+  if (ret == GALLUS_RESULT_OK) {
+    ret = s_stamp(id, PH_INIT);
+  }
+
+  return ret;
+}
+
+
+#define DEFINE_MOD_PROCS(id)                                            \
+  static gallus_result_t                                                \
+  s_start_##id(void) {                                                  \
+    return s_stamp(id, PH_START);                                       \
+  }                                                                     \
+  static gallus_result_t                                                \
+  s_shutdown_##id(shutdown_grace_level_t l) {                           \
+    (void)l;                                                            \
+    return s_stamp(id, PH_SHUTDOWN);                                    \
+  }                                                                     \
+  static void                                                           \
+  s_finalize_##id(void) {                                               \
+    (void)s_stamp(id, PH_FINALIZE);                                     \
+  }
+
+DEFINE_MOD_PROCS(0)
+DEFINE_MOD_PROCS(1)
+DEFINE_MOD_PROCS(2)
+DEFINE_MOD_PROCS(3)
+DEFINE_MOD_PROCS(4)
+
+#define MOD_PROCS(id)                                                   \
+  s_init, (void *)&s_ids[id], s_start_##id, s_shutdown_##id, NULL,      \
+    s_finalize_##id, NULL
+
+
+/*
+ * A proc calling exit(3) on a module worker, run in a child.
+ */
+static int s_exit_fd = -1;
+static pthread_t s_exit_main_tid;
+static volatile bool s_is_main_started = false;
+
+
+static gallus_result_t
+s_exit_init(int argc, const char *const argv[], void *extarg,
+            gallus_thread_t **thdptr) {
+  (void)argc;
+  (void)argv;
+  (void)extarg;
+  (void)thdptr;
+
+  return GALLUS_RESULT_OK;
+}
+
+
+/*
+ * The one on the worker exits while the other one is being started
+ * on the caller.
+ */
+static gallus_result_t
+s_exit_start(void) {
+  size_t i;
+
+  if (pthread_self() == s_exit_main_tid) {
+    s_is_main_started = true;
+    mbar();
+    (void)gallus_chrono_nanosleep(200LL * 1000LL * 1000LL, NULL);
+    return GALLUS_RESULT_OK;
+  }
+
+  for (i = 0; i < 5000 && s_is_main_started == false; i++) {
+    (void)gallus_chrono_nanosleep(1000LL * 1000LL, NULL);
+    mbar();
+  }
+  exit(0);
+}
+
+
+static gallus_result_t
+s_exit_shutdown(shutdown_grace_level_t l) {
+  (void)l;
+  return GALLUS_RESULT_OK;
+}
+
+
+static void
+s_exit_check(void) {
+  if (s_exit_fd >= 0) {
+    (void)write(s_exit_fd,
+                (gallus_module_is_unloading() == true) ? "u" : "-", 1);
+  }
+}
+
+
+/*
+ * Called in the exit handler of the module manager, and the check
+ * goes right after it.
+ */
+static void
+s_exit_finalize(void) {
+  if (s_exit_fd >= 0) {
+    (void)write(s_exit_fd, "f", 1);
+    (void)atexit(s_exit_check);
+  }
+}
+
+
+static void
+s_assert_before(size_t a, size_t b, size_t ph) {
+  TEST_ASSERT_NOT_EQUAL(0, s_stamps[a][ph]);
+  TEST_ASSERT_NOT_EQUAL(0, s_stamps[b][ph]);
+  TEST_ASSERT_TRUE(s_stamps[a][ph] < s_stamps[b][ph]);
+}
+
+
+
+
+
+void
+setUp(void) {
+}
+
+
+void
+tearDown(void) {
+}
+
+
+
+
+
+/*
+ * Run first, while no modules are registered in this process.
+ */
+void
+test_exit_on_worker(void) {
+  const char *const none[] = { NULL };
+  char buf[8];
+  ssize_t n;
+  int fds[2];
+  int st = -1;
+  int i;
+  pid_t pid;
+
+  TEST_ASSERT_EQUAL(0, pipe(fds));
+  pid = fork();
+  TEST_ASSERT_TRUE(pid >= 0);
+
+  if (pid == 0) {
+    (void)close(fds[0]);
+    s_exit_fd = fds[1];
+    s_exit_main_tid = pthread_self();
+    (void)gallus_module_register_with_deps("exit0", s_exit_init, NULL,
+                                           s_exit_start, s_exit_shutdown,
+                                           NULL, s_exit_finalize, NULL,
+                                           none);
+    (void)gallus_module_register_with_deps("exit1", s_exit_init, NULL,
+                                           s_exit_start, s_exit_shutdown,
+                                           NULL, s_exit_finalize, NULL,
+                                           none);
+    if (gallus_module_initialize_all(0, NULL) == GALLUS_RESULT_OK) {
+      (void)gallus_module_start_all();
+    }
+    _exit(1);
+  }
+
+  (void)close(fds[1]);
+  for (i = 0; i < 1000 && waitpid(pid, &st, WNOHANG) == 0; i++) {
+    (void)gallus_chrono_nanosleep(10LL * 1000LL * 1000LL, NULL);
+  }
+  if (i == 1000) {
+    (void)kill(pid, SIGKILL);
+    (void)waitpid(pid, &st, 0);
+  }
+  n = read(fds[0], buf, sizeof(buf) - 1);
+  (void)close(fds[0]);
+
+  TEST_ASSERT_TRUE(WIFEXITED(st));
+  TEST_ASSERT_EQUAL(0, WEXITSTATUS(st));
+  /*
+   * Only the module not started is finalized, and the destructors are
+   * told to clean up.
+   */
+  TEST_ASSERT_EQUAL(2, n);
+  buf[n] = '\0';
+  TEST_ASSERT_EQUAL_STRING("fu", buf);
+}
+
+
+void
+test_register_deps(void) {
+  const char *const no_such[] = { "no such module", NULL };
+  const char *const none[] = { NULL };
+  const char *const base[] = { "base", NULL };
+  const char *const both[] = { "left", "right", NULL };
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_NOT_FOUND,
+                    gallus_module_register_with_deps("bad", MOD_PROCS(0),
+                                                     no_such));
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_module_register_with_deps("base", MOD_PROCS(0),
+                                                     none));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_module_register_with_deps("left", MOD_PROCS(1),
+                                                     base));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_module_register_with_deps("right", MOD_PROCS(2),
+                                                     base));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_module_register_with_deps("top", MOD_PROCS(3),
+                                                     both));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_module_register("legacy", MOD_PROCS(4)));
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_ALREADY_EXISTS,
+                    gallus_module_register_with_deps("top", MOD_PROCS(3),
+                                                     base));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_NOT_FOUND, gallus_module_find("bad"));
+  TEST_ASSERT_EQUAL(MOD_TOP, gallus_module_find("top"));
+}
+
+
+void
+test_lifecycle(void) {
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_module_initialize_all(0, NULL));
+  s_assert_before(MOD_BASE, MOD_LEFT, PH_INIT);
+  s_assert_before(MOD_BASE, MOD_RIGHT, PH_INIT);
+  s_assert_before(MOD_LEFT, MOD_TOP, PH_INIT);
+  s_assert_before(MOD_RIGHT, MOD_TOP, PH_INIT);
+  s_assert_before(MOD_TOP, MOD_LEGACY, PH_INIT);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_module_start_all());
+  s_assert_before(MOD_BASE, MOD_LEFT, PH_START);
+  s_assert_before(MOD_RIGHT, MOD_TOP, PH_START);
+  s_assert_before(MOD_TOP, MOD_LEGACY, PH_START);
+
+  gallus_module_dump_timeline(stdout);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_module_shutdown_all(SHUTDOWN_GRACEFULLY));
+  s_assert_before(MOD_LEGACY, MOD_TOP, PH_SHUTDOWN);
+  s_assert_before(MOD_TOP, MOD_LEFT, PH_SHUTDOWN);
+  s_assert_before(MOD_TOP, MOD_RIGHT, PH_SHUTDOWN);
+  s_assert_before(MOD_LEFT, MOD_BASE, PH_SHUTDOWN);
+  s_assert_before(MOD_RIGHT, MOD_BASE, PH_SHUTDOWN);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_module_wait_all(1000LL * 1000LL));
+
+  gallus_module_finalize_all();
+  s_assert_before(MOD_LEGACY, MOD_TOP, PH_FINALIZE);
+  s_assert_before(MOD_LEFT, MOD_BASE, PH_FINALIZE);
+  TEST_ASSERT_TRUE(gallus_module_is_finalized_cleanly());
+}
@@ -0,0 +1,215 @@
+#include "gallus_apis.h"
+#include "unity.h"
+
+
+
+
+
+#define N_ELEMS	100000
+
+
+static gallus_thread_pool_t s_pool = NULL;
+static uint8_t s_marks[N_ELEMS];
+
+
+static gallus_result_t
+s_mark(size_t begin, size_t end, void *arg) {
+  size_t i;
+
+  (void)arg;
+
+  for (i = begin; i < end; i++) {
+    (void)__atomic_add_fetch(&s_marks[i], 1, __ATOMIC_RELAXED);
+  }
+
+  return GALLUS_RESULT_OK;
+}
+
+
+static gallus_result_t
+s_fail_at(size_t begin, size_t end, void *arg) {
+  size_t at = *(size_t *)arg;
+
+  return (begin <= at && at < end) ? GALLUS_RESULT_OUT_OF_RANGE :
+         GALLUS_RESULT_OK;
+}
+
+
+static gallus_result_t
+s_nested(size_t begin, size_t end, void *arg) {
+  size_t i;
+  gallus_result_t ret = GALLUS_RESULT_OK;
+
+  (void)arg;
+
+  for (i = begin; i < end && ret == GALLUS_RESULT_OK; i++) {
+    ret = gallus_parallel_for(&s_pool, i * 1000, (i + 1) * 1000, 10,
+                              s_mark, NULL);
+  }
+
+  return ret;
+}
+
+
+typedef struct {
+  uint64_t m_sum;
+  size_t m_min;
+  size_t m_max;
+} sum_acc;
+
+
+static gallus_result_t
+s_sum(size_t begin, size_t end, void *acc, void *arg) {
+  sum_acc *a = (sum_acc *)acc;
+  size_t i;
+
+  (void)arg;
+
+  for (i = begin; i < end; i++) {
+    a->m_sum += i;
+  }
+  if (begin < a->m_min) {
+    a->m_min = begin;
+  }
+  if (end - 1 > a->m_max) {
+    a->m_max = end - 1;
+  }
+
+  return GALLUS_RESULT_OK;
+}
+
+
+static void
+s_combine(void *acc, const void *other, void *arg) {
+  sum_acc *a = (sum_acc *)acc;
+  const sum_acc *o = (const sum_acc *)other;
+
+  (void)arg;
+
+  a->m_sum += o->m_sum;
+  if (o->m_min < a->m_min) {
+    a->m_min = o->m_min;
+  }
+  if (o->m_max > a->m_max) {
+    a->m_max = o->m_max;
+  }
+}
+
+
+static void
+s_check_marks(size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    if (s_marks[i] != 1) {
+      break;
+    }
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(n, i, "an element is not visited once.");
+}
+
+
+
+
+
+void
+setUp(void) {
+  gallus_result_t ret;
+
+  (void)global_state_set(GLOBAL_STATE_STARTED);
+
+  ret = gallus_thread_pool_create_executor(&s_pool, "parallel test", 4);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "executor create error.");
+
+  (void)memset(s_marks, 0, sizeof(s_marks));
+}
+
+
+void
+tearDown(void) {
+  (void)gallus_thread_pool_shutdown_all(&s_pool, SHUTDOWN_GRACEFULLY, -1LL);
+  gallus_thread_pool_destroy(&s_pool);
+  s_pool = NULL;
+}
+
+
+
+
+
+void
+test_parallel_for(void) {
+  gallus_result_t ret;
+  size_t grains[] = { 0, 1, 7, 4096, N_ELEMS * 2 };
+  size_t i;
+
+  for (i = 0; i < sizeof(grains) / sizeof(grains[0]); i++) {
+    (void)memset(s_marks, 0, sizeof(s_marks));
+    ret = gallus_parallel_for(&s_pool, 0, N_ELEMS, grains[i], s_mark, NULL);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "parallel for error.");
+    s_check_marks(N_ELEMS);
+  }
+
+  /* no pool: the caller only. */
+  (void)memset(s_marks, 0, sizeof(s_marks));
+  ret = gallus_parallel_for(NULL, 0, N_ELEMS, 0, s_mark, NULL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "parallel for error.");
+  s_check_marks(N_ELEMS);
+
+  ret = gallus_parallel_for(&s_pool, 10, 10, 0, s_mark, NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_parallel_for(&s_pool, 10, 9, 0, s_mark, NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS, ret);
+  ret = gallus_parallel_for(&s_pool, 0, 10, 0, NULL, NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS, ret);
+}
+
+
+void
+test_parallel_for_error(void) {
+  gallus_result_t ret;
+  size_t at = N_ELEMS / 3;
+
+  ret = gallus_parallel_for(&s_pool, 0, N_ELEMS, 16, s_fail_at, &at);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OUT_OF_RANGE, ret);
+}
+
+
+void
+test_parallel_for_nested(void) {
+  gallus_result_t ret;
+
+  /* runs parallel_for on the pool workers of the same pool. */
+  ret = gallus_parallel_for(&s_pool, 0, N_ELEMS / 1000, 1, s_nested, NULL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "nested error.");
+  s_check_marks(N_ELEMS);
+}
+
+
+void
+test_parallel_reduce(void) {
+  gallus_result_t ret;
+  sum_acc a;
+  size_t n = 1000000;
+
+  a.m_sum = 0;
+  a.m_min = SIZE_MAX;
+  a.m_max = 0;
+  ret = gallus_parallel_reduce(&s_pool, 0, n, 0, &a, sizeof(a),
+                               s_sum, s_combine, NULL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "parallel reduce error.");
+  TEST_ASSERT_TRUE(a.m_sum == (uint64_t)n * (n - 1) / 2);
+  TEST_ASSERT_EQUAL(0, a.m_min);
+  TEST_ASSERT_EQUAL(n - 1, a.m_max);
+
+  a.m_sum = 0;
+  a.m_min = SIZE_MAX;
+  a.m_max = 0;
+  ret = gallus_parallel_reduce(NULL, 0, n, 0, &a, sizeof(a),
+                               s_sum, s_combine, NULL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "parallel reduce error.");
+  TEST_ASSERT_TRUE(a.m_sum == (uint64_t)n * (n - 1) / 2);
+
+  ret = gallus_parallel_reduce(&s_pool, 0, n, 0, &a, 0,
+                               s_sum, s_combine, NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS, ret);
+}
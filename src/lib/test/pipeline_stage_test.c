@@ -1415,3 +1415,62 @@ test_gallus_pipeline_stage_find_null(void) {
   TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_INVALID_ARGS, ret,
                             "gallus_pipeline_stage_find(null) error.");
 }
+
+void
+test_gallus_pipeline_stage_place_workers(void) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_pipeline_stage_t stage = NULL;
+  bool is_hot = true;
+  FILE *fd = NULL;
+
+  pipeline_stage_create(&stage,
+                        pipeline_pre_pause,
+                        pipeline_sched,
+                        pipeline_setup,
+                        pipeline_fetch,
+                        pipeline_main,
+                        pipeline_throw,
+                        pipeline_shutdown,
+                        pipeline_finalize,
+                        pipeline_freeup);
+
+  /* not placed yet. */
+  ret = gallus_pipeline_stage_get_worker_cpu(&stage, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_NOT_FOUND, ret,
+                            "gallus_pipeline_stage_get_worker_cpu error.");
+
+  /* call func. */
+  ret = gallus_pipeline_stage_place_workers(&stage, &is_hot, 1);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "gallus_pipeline_stage_place_workers error.");
+  ret = gallus_pipeline_stage_get_worker_cpu(&stage, 0);
+  TEST_ASSERT_TRUE_MESSAGE(ret >= 0,
+                           "gallus_pipeline_stage_get_worker_cpu error.");
+  ret = gallus_pipeline_stage_get_worker_cpu(&stage, 1);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_INVALID_ARGS, ret,
+                            "gallus_pipeline_stage_get_worker_cpu error.");
+
+  fd = tmpfile();
+  TEST_ASSERT_NOT_NULL(fd);
+  gallus_pipeline_stage_dump_placement(&stage, fd);
+  TEST_ASSERT_TRUE_MESSAGE(ftell(fd) > 0,
+                           "gallus_pipeline_stage_dump_placement error.");
+  fclose(fd);
+
+  ret = gallus_pipeline_stage_start(&stage);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "gallus_pipeline_stage_start error.");
+
+  /* too late. */
+  ret = gallus_pipeline_stage_place_workers(&stage, NULL, 1);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_INVALID_STATE_TRANSITION, ret,
+                            "gallus_pipeline_stage_place_workers error.");
+
+  ret = gallus_pipeline_stage_shutdown(&stage, SHUTDOWN_GRACEFULLY);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "gallus_pipeline_stage_shutdown error.");
+
+  /* after. */
+  do_stop = true;
+  gallus_pipeline_stage_destroy(&stage);
+}
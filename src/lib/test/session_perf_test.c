@@ -0,0 +1,428 @@
+#include "unity.h"
+#include "gallus_apis.h"
+#include "gallus_session.h"
+#include "gallus_session_tls.h"
+#include "../session_internal.h"
+
+/*
+ * Throughput/latency baseline for the session I/O paths.
+ *
+ * N client/server pairs ping-pong fixed size messages over loopback
+ * TCP, AF_UNIX stream pairs and loopback TLS. Every client measures
+ * the round trip of each message; the server echoes it back.
+ *
+ *   rw    client: session_write()/session_read(),
+ *         server: session_read()/session_write()
+ *   line  client: session_printf()/session_fgets(),
+ *         server: session_fgets()/session_write()
+ *
+ * Reported per run: round trips/s, MB/s (both directions), p50/p99
+ * round trip latency, and read/write family syscalls per round trip
+ * (both ends, from /proc/self/io).
+ *
+ * Environment:
+ *   SESSION_PERF_PAIRS	number of pairs (default 2)
+ *   SESSION_PERF_MSGS	messages per pair (default 10000)
+ *   SESSION_PERF_TLS_DIR	directory with ca/, cert.pem and key.pem;
+ *			TLS runs are skipped without it.
+ *
+ * TLS runs request kTLS and are labelled "ktls" when the kernel took
+ * over the TX path, "tls" when they fell back to user space.
+ */
+
+#define OUTPUT stdout
+
+#define PERF_PORT	10026
+#define DEFAULT_PAIRS	2
+#define DEFAULT_MSGS	10000
+#define MAX_MSG_SIZE	1024
+
+#define MODE_RW		0
+#define MODE_LINE	1
+
+struct perf_pair {
+  gallus_session_t m_client;
+  gallus_session_t m_server;
+  gallus_session_t m_listener;	/* TCP/TLS: the server accepts by itself */
+  pthread_t m_client_thd;
+  pthread_t m_server_thd;
+  pthread_barrier_t *m_barrier;
+  int m_mode;
+  size_t m_size;
+  size_t m_n_msgs;
+  uint64_t *m_rtts;	/* nsec */
+  size_t m_errors;
+};
+
+static size_t s_n_pairs = DEFAULT_PAIRS;
+static size_t s_n_msgs = DEFAULT_MSGS;
+
+void
+setUp(void) {
+  const char *e;
+
+  if ((e = getenv("SESSION_PERF_PAIRS")) != NULL && atoi(e) > 0) {
+    s_n_pairs = (size_t)atoi(e);
+  }
+  if ((e = getenv("SESSION_PERF_MSGS")) != NULL && atoi(e) > 0) {
+    s_n_msgs = (size_t)atoi(e);
+  }
+}
+
+void
+tearDown(void) {
+}
+
+
+
+
+
+static inline uint64_t
+s_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000LL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t
+s_syscalls(void) {
+  FILE *fp;
+  char line[128];
+  unsigned long long v;
+  uint64_t n = 0;
+
+  if ((fp = fopen("/proc/self/io", "r")) == NULL) {
+    return 0;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (sscanf(line, "syscr: %llu", &v) == 1 ||
+        sscanf(line, "syscw: %llu", &v) == 1) {
+      n += v;
+    }
+  }
+  fclose(fp);
+  return n;
+}
+
+static int
+s_cmp_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static bool
+s_write_all(gallus_session_t s, char *buf, size_t n) {
+  ssize_t r;
+  size_t off = 0;
+
+  while (off < n) {
+    r = session_write(s, buf + off, n - off);
+    if (r < 0) {
+      return false;
+    }
+    off += (size_t)r;
+  }
+  return true;
+}
+
+static bool
+s_read_all(gallus_session_t s, char *buf, size_t n) {
+  ssize_t r;
+  size_t off = 0;
+
+  while (off < n) {
+    r = session_read(s, buf + off, n - off);
+    if (r <= 0) {
+      return false;
+    }
+    off += (size_t)r;
+  }
+  return true;
+}
+
+/*
+ * The benchmark measures the I/O path, not the event loop; switch the
+ * (non-blocking) active sessions to blocking once connected.
+ */
+static void
+s_set_blocking(gallus_session_t s) {
+  int val = 0;
+  (void)ioctl(session_sockfd_get(s), FIONBIO, &val);
+}
+
+
+
+
+
+static void *
+s_server_main(void *arg) {
+  struct perf_pair *p = (struct perf_pair *)arg;
+  char buf[MAX_MSG_SIZE + 2];
+  ssize_t n;
+
+  if (p->m_listener != NULL) {
+    if (session_accept(p->m_listener, &p->m_server) != GALLUS_RESULT_OK) {
+      p->m_errors++;
+      return NULL;
+    }
+  }
+
+  while (true) {
+    if (p->m_mode == MODE_RW) {
+      n = session_read(p->m_server, buf, p->m_size);
+      if (n <= 0) {
+        break;
+      }
+    } else {
+      if (session_fgets(buf, (int)sizeof(buf), p->m_server) == NULL) {
+        break;
+      }
+      n = (ssize_t)strlen(buf);
+    }
+    if (s_write_all(p->m_server, buf, (size_t)n) == false) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+static void *
+s_client_main(void *arg) {
+  struct perf_pair *p = (struct perf_pair *)arg;
+  char msg[MAX_MSG_SIZE + 2];
+  char buf[MAX_MSG_SIZE + 2];
+  uint64_t t0;
+  size_t i;
+
+  memset(msg, 'x', p->m_size);
+  msg[p->m_size] = '\0';
+
+  pthread_barrier_wait(p->m_barrier);
+
+  for (i = 0; i < p->m_n_msgs; i++) {
+    t0 = s_now();
+    if (p->m_mode == MODE_RW) {
+      if (s_write_all(p->m_client, msg, p->m_size) == false ||
+          s_read_all(p->m_client, buf, p->m_size) == false) {
+        p->m_errors++;
+        break;
+      }
+    } else {
+      /* the line is m_size bytes including the newline. */
+      if (session_printf(p->m_client, "%.*s\n",
+                         (int)(p->m_size - 1), msg) != (int)p->m_size ||
+          session_fgets(buf, (int)sizeof(buf), p->m_client) == NULL) {
+        p->m_errors++;
+        break;
+      }
+    }
+    p->m_rtts[i] = s_now() - t0;
+  }
+
+  pthread_barrier_wait(p->m_barrier);
+
+  return NULL;
+}
+
+
+
+
+
+static void
+s_connect_client(session_type_t t, gallus_ip_address_t *dst,
+                 struct perf_pair *p) {
+  gallus_result_t ret;
+  gallus_session_t sp[1];
+  int i;
+
+  ret = session_create(t | SESSION_ACTIVE, &p->m_client);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_connect(p->m_client, dst, PERF_PORT, NULL, 0);
+  for (i = 0; i < 1000 && ret == GALLUS_RESULT_EINPROGRESS; i++) {
+    /* TLS sets the events the handshake waits for by itself. */
+    if ((t & SESSION_TLS) == 0) {
+      session_write_event_set(p->m_client);
+    }
+    sp[0] = p->m_client;
+    (void)session_poll(sp, 1, 10);
+    ret = session_connect_check(p->m_client);
+  }
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  session_event_clear(p->m_client);
+  s_set_blocking(p->m_client);
+}
+
+static void
+s_run(const char *name, session_type_t t, int mode, size_t size) {
+  gallus_result_t ret;
+  gallus_session_t listener = NULL;
+  gallus_ip_address_t *src = NULL, *dst = NULL;
+  struct perf_pair *pairs;
+  pthread_barrier_t barrier;
+  uint64_t *all, start, elapsed, sc0, sc1;
+  size_t i, n_total = 0, errors = 0;
+  double secs;
+
+  pairs = (struct perf_pair *)calloc(s_n_pairs, sizeof(*pairs));
+  all = (uint64_t *)calloc(s_n_pairs * s_n_msgs, sizeof(uint64_t));
+  TEST_ASSERT_NOT_NULL(pairs);
+  TEST_ASSERT_NOT_NULL(all);
+
+  pthread_barrier_init(&barrier, NULL, (unsigned int)s_n_pairs + 1);
+
+  if (t & (SESSION_TCP | SESSION_TCP6)) {
+    ret = gallus_ip_address_create("0.0.0.0", true, &src);
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+    ret = gallus_ip_address_create("127.0.0.1", true, &dst);
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+    ret = session_create(t | SESSION_PASSIVE, &listener);
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+    ret = session_bind(listener, src, PERF_PORT);
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  }
+
+  for (i = 0; i < s_n_pairs; i++) {
+    struct perf_pair *p = &pairs[i];
+
+    p->m_barrier = &barrier;
+    p->m_mode = mode;
+    p->m_size = size;
+    p->m_n_msgs = s_n_msgs;
+    p->m_rtts = all + i * s_n_msgs;
+    if (listener != NULL) {
+      p->m_listener = listener;
+      pthread_create(&p->m_server_thd, NULL, s_server_main, p);
+      s_connect_client(t, dst, p);
+    } else {
+      gallus_session_t sp[2];
+      ret = session_pair(t, sp);
+      TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+      p->m_client = sp[0];
+      p->m_server = sp[1];
+      pthread_create(&p->m_server_thd, NULL, s_server_main, p);
+    }
+    pthread_create(&p->m_client_thd, NULL, s_client_main, p);
+  }
+
+  sc0 = s_syscalls();
+  pthread_barrier_wait(&barrier);
+  start = s_now();
+  pthread_barrier_wait(&barrier);
+  elapsed = s_now() - start;
+  sc1 = s_syscalls();
+
+  if (t & SESSION_TLS) {
+    bool snd = false, rcv = false;
+    (void)gallus_session_tls_get_ktls_status(pairs[0].m_client, &snd, &rcv);
+    name = (snd == true) ? "ktls" : "tls";
+  }
+
+  /*
+   * A TCP server thread may have accepted another pair's client, so
+   * close every client before joining the servers.
+   */
+  for (i = 0; i < s_n_pairs; i++) {
+    pthread_join(pairs[i].m_client_thd, NULL);
+    session_close(pairs[i].m_client);
+  }
+  for (i = 0; i < s_n_pairs; i++) {
+    pthread_join(pairs[i].m_server_thd, NULL);
+    errors += pairs[i].m_errors;
+    session_destroy(pairs[i].m_client);
+    session_destroy(pairs[i].m_server);
+  }
+
+  n_total = s_n_pairs * s_n_msgs;
+  qsort(all, n_total, sizeof(uint64_t), s_cmp_u64);
+  secs = (double)elapsed / 1e9;
+
+  fprintf(OUTPUT, "session perf: %-5s %-4s %5zu B x %zu pairs: "
+          "%10.0f msg/s %8.2f MB/s p50 %8.1f us p99 %8.1f us "
+          "%5.2f syscalls/msg\n",
+          name, (mode == MODE_RW) ? "rw" : "line", size, s_n_pairs,
+          (double)n_total / secs,
+          (double)(n_total * size * 2) / secs / 1e6,
+          (double)all[n_total / 2] / 1e3,
+          (double)all[(n_total * 99) / 100] / 1e3,
+          (double)(sc1 - sc0) / (double)n_total);
+
+  pthread_barrier_destroy(&barrier);
+  if (listener != NULL) {
+    session_destroy(listener);
+  }
+  if (src != NULL) {
+    gallus_ip_address_destroy(src);
+  }
+  if (dst != NULL) {
+    gallus_ip_address_destroy(dst);
+  }
+  free(all);
+  free(pairs);
+
+  TEST_ASSERT_EQUAL(0, errors);
+}
+
+static void
+s_run_all(const char *name, session_type_t t) {
+  s_run(name, t, MODE_RW, 64);
+  s_run(name, t, MODE_RW, MAX_MSG_SIZE);
+  s_run(name, t, MODE_LINE, 64);
+  s_run(name, t, MODE_LINE, MAX_MSG_SIZE);
+}
+
+static bool
+s_tls_setup(void) {
+  const char *dir = getenv("SESSION_PERF_TLS_DIR");
+  char path[PATH_MAX];
+
+  if (dir == NULL) {
+    fprintf(OUTPUT, "session perf: tls skipped, "
+            "set SESSION_PERF_TLS_DIR.\n");
+    return false;
+  }
+
+  snprintf(path, sizeof(path), "%s/ca", dir);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_session_tls_set_ca_dir(path));
+  snprintf(path, sizeof(path), "%s/cert.pem", dir);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_session_tls_set_server_cert(path));
+  snprintf(path, sizeof(path), "%s/key.pem", dir);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_session_tls_set_server_key(path));
+  return true;
+}
+
+static gallus_result_t
+s_certcheck_any(const char *issuer_dn, const char *subject_dn) {
+  (void)issuer_dn;
+  (void)subject_dn;
+  return GALLUS_RESULT_OK;
+}
+
+
+
+
+
+void
+test_session_perf_tcp(void) {
+  s_run_all("tcp", SESSION_TCP);
+}
+
+void
+test_session_perf_unix(void) {
+  s_run_all("unix", SESSION_UNIX_STREAM);
+}
+
+void
+test_session_perf_tls(void) {
+  if (s_tls_setup() == false) {
+    return;
+  }
+  gallus_session_tls_set_certcheck_default(s_certcheck_any);
+
+  (void)gallus_session_tls_set_ktls(true);
+  s_run_all("tls", SESSION_TCP | SESSION_TLS);
+  (void)gallus_session_tls_set_ktls(false);
+}
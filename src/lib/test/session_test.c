@@ -4,6 +4,11 @@
 #include "gallus_session_tls.h"
 #include "../session_internal.h"
 #include <sys/stat.h>
+#include <netinet/tcp.h>
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
 
 int s4 = -1, s6 = -1;
 void
@@ -278,6 +283,57 @@ test_session_pair_stream(void) {
   session_destroy(s[1]);
 }
 
+void
+test_session_write_dstring(void) {
+  gallus_result_t ret;
+  gallus_session_t s[2];
+  gallus_dstring_t ds = NULL;
+  struct iovec iov[2];
+  char buf[256 * 1024];
+  char *str = NULL;
+  size_t i, len = 0;
+  ssize_t n;
+
+  ret = session_pair(SESSION_UNIX_STREAM, s);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  iov[0].iov_base = (void *)"hoge";
+  iov[0].iov_len = 4;
+  iov[1].iov_base = (void *)"foo\n";
+  iov[1].iov_len = 4;
+  n = session_writev(s[0], iov, 2);
+  TEST_ASSERT_EQUAL(8, n);
+  n = session_read(s[1], buf, sizeof(buf));
+  TEST_ASSERT_EQUAL(8, n);
+  TEST_ASSERT_EQUAL(0, memcmp(buf, "hogefoo\n", 8));
+
+  /* a rope over several segments. */
+  ret = gallus_dstring_create_rope(&ds);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  for (i = 0; i < 10000; i++) {
+    ret = gallus_dstring_appendf(&ds, "line %zu\n", i);
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  }
+  ret = gallus_dstring_str_get(&ds, &str);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_TRUE(strlen(str) < sizeof(buf));
+
+  n = session_write_dstring(s[0], &ds);
+  TEST_ASSERT_EQUAL(strlen(str), n);
+  while (len < (size_t) n) {
+    ssize_t r = session_read(s[1], buf + len, sizeof(buf) - len);
+    TEST_ASSERT_TRUE(r > 0);
+    len += (size_t) r;
+  }
+  TEST_ASSERT_EQUAL(strlen(str), len);
+  TEST_ASSERT_EQUAL(0, memcmp(buf, str, len));
+
+  free(str);
+  gallus_dstring_destroy(&ds);
+  session_destroy(s[0]);
+  session_destroy(s[1]);
+}
+
 /*
  * Cannot do unit-tests for initialization of session_tls
  * so that gallus_session_tls is not included in this file.
@@ -501,3 +557,718 @@ test_session_fgets(void) {
   session_destroy(sesa);
   session_destroy(sess);
 }
+
+static size_t s_n_accepted = 0;
+
+static gallus_result_t
+s_listener_accepted(gallus_session_t s, void *arg) {
+  (void)arg;
+  __sync_fetch_and_add(&s_n_accepted, 1);
+  session_destroy(s);
+  return GALLUS_RESULT_OK;
+}
+
+void
+test_session_listener_group_tcp(void) {
+  gallus_result_t ret;
+  size_t i;
+  gallus_session_t sesc[4];
+  gallus_session_listener_group_t g = NULL;
+  gallus_ip_address_t *dst, *src;
+
+  ret = gallus_ip_address_create("0.0.0.0", true, &src);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_ip_address_create("127.0.0.1", true, &dst);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  ret = session_listener_group_create(SESSION_TCP|SESSION_ACTIVE, src, 10025,
+                                      2, s_listener_accepted, NULL, &g);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS, ret);
+
+  ret = session_listener_group_create(SESSION_TCP|SESSION_PASSIVE, src, 10025,
+                                      2, s_listener_accepted, NULL, &g);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_NOT_NULL(g);
+
+  ret = session_listener_group_start(&g);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_listener_group_start(&g);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_ALREADY_EXISTS, ret);
+
+  for (i = 0; i < 4; i++) {
+    ret = session_create(SESSION_TCP|SESSION_ACTIVE, &sesc[i]);
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+    ret = session_connect(sesc[i], dst, 10025, NULL, 0);
+    TEST_ASSERT_TRUE(ret == GALLUS_RESULT_OK ||
+                     ret == GALLUS_RESULT_EINPROGRESS);
+  }
+
+  for (i = 0; i < 50 && s_n_accepted < 4; i++) {
+    usleep(100 * 1000);
+  }
+  TEST_ASSERT_EQUAL(4, s_n_accepted);
+
+  ret = session_listener_group_stop(&g);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  session_listener_group_destroy(&g);
+  TEST_ASSERT_NULL(g);
+
+  for (i = 0; i < 4; i++) {
+    session_destroy(sesc[i]);
+  }
+  gallus_ip_address_destroy(dst);
+  gallus_ip_address_destroy(src);
+}
+
+static char s_tls_dir[64];
+static char s_tls_ca_dir[128];
+static char s_tls_key[128];
+static char s_tls_cert[128];
+static char s_tls_ca_cert[128];
+
+static gallus_result_t
+s_certcheck_any(const char *issuer_dn, const char *subject_dn) {
+  (void)issuer_dn;
+  (void)subject_dn;
+  return GALLUS_RESULT_OK;
+}
+
+/*
+ * Generate a self-signed P-256 certificate and its key into a
+ * temporary directory, trust it through a hashed CA directory and
+ * use it on both sides.
+ */
+static bool
+s_tls_setup(bool ktls) {
+  bool ret = false;
+  EVP_PKEY_CTX *pctx = NULL;
+  EVP_PKEY *pkey = NULL;
+  X509 *x = NULL;
+  X509_NAME *name;
+  FILE *fp;
+
+  snprintf(s_tls_dir, sizeof(s_tls_dir), "/tmp/session_test_XXXXXX");
+  if (mkdtemp(s_tls_dir) == NULL) {
+    return false;
+  }
+  snprintf(s_tls_ca_dir, sizeof(s_tls_ca_dir), "%s/ca", s_tls_dir);
+  snprintf(s_tls_key, sizeof(s_tls_key), "%s/key.pem", s_tls_dir);
+  snprintf(s_tls_cert, sizeof(s_tls_cert), "%s/cert.pem", s_tls_dir);
+  if (mkdir(s_tls_ca_dir, 0700) != 0) {
+    goto done;
+  }
+
+  pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+  if (pctx == NULL ||
+      EVP_PKEY_keygen_init(pctx) != 1 ||
+      EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx,
+                                             NID_X9_62_prime256v1) != 1 ||
+      EVP_PKEY_keygen(pctx, &pkey) != 1) {
+    goto done;
+  }
+
+  if ((x = X509_new()) == NULL) {
+    goto done;
+  }
+  X509_set_version(x, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(x), 1);
+  X509_gmtime_adj(X509_getm_notBefore(x), 0);
+  X509_gmtime_adj(X509_getm_notAfter(x), 3600);
+  X509_set_pubkey(x, pkey);
+  name = X509_get_subject_name(x);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                             (const unsigned char *)"gallus session test",
+                             -1, -1, 0);
+  X509_set_issuer_name(x, name);
+  if (X509_sign(x, pkey, EVP_sha256()) == 0) {
+    goto done;
+  }
+  snprintf(s_tls_ca_cert, sizeof(s_tls_ca_cert), "%s/%08lx.0",
+           s_tls_ca_dir, X509_NAME_hash(name));
+
+  if ((fp = fopen(s_tls_key, "w")) == NULL) {
+    goto done;
+  }
+  PEM_write_PrivateKey(fp, pkey, NULL, NULL, 0, NULL, NULL);
+  fclose(fp);
+  if ((fp = fopen(s_tls_cert, "w")) == NULL) {
+    goto done;
+  }
+  PEM_write_X509(fp, x);
+  fclose(fp);
+  if ((fp = fopen(s_tls_ca_cert, "w")) == NULL) {
+    goto done;
+  }
+  PEM_write_X509(fp, x);
+  fclose(fp);
+
+  gallus_session_tls_set_ca_dir(s_tls_ca_dir);
+  gallus_session_tls_set_server_cert(s_tls_cert);
+  gallus_session_tls_set_server_key(s_tls_key);
+  gallus_session_tls_set_client_cert(s_tls_cert);
+  gallus_session_tls_set_client_key(s_tls_key);
+  gallus_session_tls_set_certcheck_default(s_certcheck_any);
+  gallus_session_tls_set_ktls(ktls);
+  ret = true;
+
+done:
+  X509_free(x);
+  EVP_PKEY_free(pkey);
+  EVP_PKEY_CTX_free(pctx);
+  return ret;
+}
+
+static void
+s_tls_teardown(void) {
+  gallus_session_tls_set_ktls(false);
+  unlink(s_tls_ca_cert);
+  unlink(s_tls_cert);
+  unlink(s_tls_key);
+  rmdir(s_tls_ca_dir);
+  rmdir(s_tls_dir);
+}
+
+/*
+ * Drive a client handshake on the non-blocking active session.
+ */
+static gallus_result_t
+s_tls_connect(gallus_session_t c, gallus_ip_address_t *dst, uint16_t port) {
+  gallus_result_t ret;
+  gallus_session_t sesp[1];
+  size_t i;
+
+  ret = session_connect(c, dst, port, NULL, 0);
+  for (i = 0; i < 100 && ret == GALLUS_RESULT_EINPROGRESS; i++) {
+    sesp[0] = c;
+    (void)session_poll(sesp, 1, 100);
+    ret = session_connect_check(c);
+  }
+  return ret;
+}
+
+void
+test_session_listener_group_tls(void) {
+  gallus_result_t ret;
+  size_t i;
+  ssize_t n;
+  char buf[16];
+  gallus_session_t sesr, sest, sesp[1];
+  gallus_session_listener_group_t g = NULL;
+  gallus_ip_address_t *dst, *src;
+
+  /*
+   * The kTLS contexts are TLS_method() with TLS 1.2 at least and fall
+   * back to user space without the "tls" ULP; the plain ones pin
+   * TLSv1_method(), which recent OpenSSL refuses by default.
+   */
+  TEST_ASSERT_TRUE(s_tls_setup(true));
+  s_n_accepted = 0;
+
+  ret = gallus_ip_address_create("0.0.0.0", true, &src);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_ip_address_create("127.0.0.1", true, &dst);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  ret = session_listener_group_create(SESSION_TCP|SESSION_PASSIVE|SESSION_TLS,
+                                      src, 10026, 1,
+                                      s_listener_accepted, NULL, &g);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  ret = session_listener_group_set_handshake_timeout(&g, 0);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS, ret);
+  ret = session_listener_group_set_handshake_timeout(&g, 300 * 1000 * 1000);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  ret = session_listener_group_start(&g);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_listener_group_set_handshake_timeout(&g, 1000 * 1000 * 1000);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_BUSY, ret);
+
+  /* a plain TCP peer never sends a ClientHello, and is dropped. */
+  ret = session_create(SESSION_TCP|SESSION_ACTIVE, &sesr);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_connect(sesr, dst, 10026, NULL, 0);
+  TEST_ASSERT_TRUE(ret == GALLUS_RESULT_OK ||
+                   ret == GALLUS_RESULT_EINPROGRESS);
+  n = -1;
+  for (i = 0; i < 30 && n != 0; i++) {
+    session_read_event_set(sesr);
+    sesp[0] = sesr;
+    if (session_poll(sesp, 1, 100) > 0) {
+      n = session_read(sesr, buf, sizeof(buf));
+    }
+  }
+  TEST_ASSERT_EQUAL(0, n);
+  TEST_ASSERT_EQUAL(0, s_n_accepted);
+
+  /* a TLS peer finishing the handshake is delivered. */
+  ret = session_create(SESSION_TCP|SESSION_TLS|SESSION_ACTIVE, &sest);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = s_tls_connect(sest, dst, 10026);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  for (i = 0; i < 50 && s_n_accepted < 1; i++) {
+    usleep(100 * 1000);
+  }
+  TEST_ASSERT_EQUAL(1, s_n_accepted);
+
+  ret = session_listener_group_stop(&g);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  session_listener_group_destroy(&g);
+  TEST_ASSERT_NULL(g);
+
+  session_destroy(sest);
+  session_destroy(sesr);
+  gallus_ip_address_destroy(dst);
+  gallus_ip_address_destroy(src);
+  s_tls_teardown();
+}
+
+void
+test_session_tls_ktls_set_get(void) {
+  gallus_result_t ret;
+  bool ktls = true;
+  bool send = true, recv = true;
+  gallus_session_t ses;
+
+  ret = gallus_session_tls_get_ktls(NULL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS, ret);
+  ret = gallus_session_tls_get_ktls(&ktls);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_FALSE(ktls);
+
+  ret = gallus_session_tls_set_ktls(true);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_session_tls_get_ktls(&ktls);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_TRUE(ktls);
+
+  ret = gallus_session_tls_set_ktls(false);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_session_tls_get_ktls(&ktls);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_FALSE(ktls);
+
+  /* not a TLS session. */
+  ret = session_create(SESSION_TCP|SESSION_ACTIVE, &ses);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_session_tls_get_ktls_status(ses, &send, &recv);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS, ret);
+  session_destroy(ses);
+}
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+/*
+ * ENOENT: no "tls" ULP in the kernel. An unconnected socket gets
+ * ENOTCONN from the ULP itself when it exists.
+ */
+static bool
+s_ktls_ulp_available(void) {
+  int fd;
+  int r;
+  bool ret;
+
+  if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+    return false;
+  }
+  r = setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls"));
+  ret = (r == 0 || errno != ENOENT) ? true : false;
+  close(fd);
+  return ret;
+}
+
+static void
+s_write_all(gallus_session_t s, const char *buf, size_t n) {
+  ssize_t r;
+  size_t off = 0;
+  gallus_session_t sesp[1];
+
+  while (off < n) {
+    r = session_write(s, (void *)(buf + off), n - off);
+    TEST_ASSERT_TRUE(r >= 0);
+    if (r == 0) {
+      session_write_event_set(s);
+      sesp[0] = s;
+      (void)session_poll(sesp, 1, 100);
+    }
+    off += (size_t)r;
+  }
+}
+
+static void
+s_read_all(gallus_session_t s, char *buf, size_t n) {
+  ssize_t r;
+  size_t off = 0;
+  size_t i;
+  gallus_session_t sesp[1];
+
+  for (i = 0; i < 1000 && off < n; i++) {
+    session_read_event_set(s);
+    sesp[0] = s;
+    if (session_poll(sesp, 1, 100) <= 0) {
+      continue;
+    }
+    r = session_read(s, buf + off, n - off);
+    TEST_ASSERT_TRUE(r > 0 || (r < 0 && errno == EAGAIN));
+    if (r > 0) {
+      off += (size_t)r;
+    }
+  }
+  TEST_ASSERT_TRUE(off == n);
+}
+
+/*
+ * A loopback TLS pair exchanging tx both ways. With fallback the
+ * "tls" ULP is attached before the handshake, so that OpenSSL cannot
+ * attach it and has to stay on SSL_write().
+ */
+static void
+s_ktls_pair(uint16_t port, bool fallback, const char *tx,
+            char *c2s, char *s2c, size_t n, bool *send) {
+  gallus_result_t ret, rc, rs;
+  size_t i;
+  bool recv, ssend, srecv;
+  gallus_session_t sesc, sess, sesa = NULL, sesp[2];
+  gallus_ip_address_t *dst, *src;
+
+  ret = gallus_ip_address_create("0.0.0.0", true, &src);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_ip_address_create("127.0.0.1", true, &dst);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  ret = session_create(SESSION_TCP|SESSION_TLS|SESSION_PASSIVE, &sess);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_bind(sess, src, port);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_create(SESSION_TCP|SESSION_TLS|SESSION_ACTIVE, &sesc);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  rc = session_connect(sesc, dst, port, NULL, 0);
+  for (i = 0; i < 100 && sesa == NULL; i++) {
+    session_read_event_set(sess);
+    sesp[0] = sess;
+    if (session_poll(sesp, 1, 100) > 0) {
+      rs = session_accept_nonblocking(sess, &sesa);
+      TEST_ASSERT_TRUE(rs == GALLUS_RESULT_OK ||
+                       rs == GALLUS_RESULT_EINPROGRESS);
+    }
+  }
+  TEST_ASSERT_NOT_NULL(sesa);
+  if (fallback == true) {
+    (void)setsockopt(session_sockfd_get(sesc), SOL_TCP, TCP_ULP,
+                     "tls", sizeof("tls"));
+    (void)setsockopt(session_sockfd_get(sesa), SOL_TCP, TCP_ULP,
+                     "tls", sizeof("tls"));
+  }
+
+  rs = GALLUS_RESULT_EINPROGRESS;
+  for (i = 0; i < 100 && (rc == GALLUS_RESULT_EINPROGRESS ||
+                          rs == GALLUS_RESULT_EINPROGRESS); i++) {
+    sesp[0] = sesc;
+    sesp[1] = sesa;
+    (void)session_poll(sesp, 2, 100);
+    if (rc == GALLUS_RESULT_EINPROGRESS) {
+      rc = session_connect_check(sesc);
+    }
+    if (rs == GALLUS_RESULT_EINPROGRESS) {
+      rs = session_handshake(sesa);
+    }
+  }
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, rc);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, rs);
+
+  ret = gallus_session_tls_get_ktls_status(sesc, send, &recv);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_session_tls_get_ktls_status(sesa, &ssend, &srecv);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_EQUAL(*send, ssend);
+
+  s_write_all(sesc, tx, n);
+  s_read_all(sesa, c2s, n);
+  s_write_all(sesa, tx, n);
+  s_read_all(sesc, s2c, n);
+
+  session_destroy(sesc);
+  session_destroy(sesa);
+  session_destroy(sess);
+  gallus_ip_address_destroy(dst);
+  gallus_ip_address_destroy(src);
+}
+
+void
+test_session_tls_ktls_pair(void) {
+  static char tx[20000], c2s[2][20000], s2c[2][20000];
+  size_t i;
+  bool send;
+
+  for (i = 0; i < sizeof(tx); i++) {
+    tx[i] = (char)(i * 7 + i / 251);
+  }
+  TEST_ASSERT_TRUE(s_tls_setup(true));
+
+  /* the kernel refuses TLS_TX, SSL_write() carries the data. */
+  s_ktls_pair(10030, true, tx, c2s[0], s2c[0], sizeof(tx), &send);
+  TEST_ASSERT_FALSE(send);
+  TEST_ASSERT_EQUAL(0, memcmp(tx, c2s[0], sizeof(tx)));
+  TEST_ASSERT_EQUAL(0, memcmp(tx, s2c[0], sizeof(tx)));
+
+  if (s_ktls_ulp_available() == true) {
+    s_ktls_pair(10031, false, tx, c2s[1], s2c[1], sizeof(tx), &send);
+    TEST_ASSERT_TRUE(send);
+    TEST_ASSERT_EQUAL(0, memcmp(c2s[0], c2s[1], sizeof(tx)));
+    TEST_ASSERT_EQUAL(0, memcmp(s2c[0], s2c[1], sizeof(tx)));
+  } else {
+    fprintf(stderr, "no \"tls\" ULP, the kTLS offloaded case skipped.\n");
+  }
+
+  s_tls_teardown();
+}
+
+static size_t s_n_pool_accepted = 0;
+static volatile bool s_pool_server_closed = false;
+
+static void
+s_read_full(gallus_session_t s, void *buf, size_t n) {
+  ssize_t r;
+  size_t off = 0;
+
+  while (off < n) {
+    r = session_read(s, (char *)buf + off, n - off);
+    TEST_ASSERT_TRUE(r > 0);
+    off += (size_t)r;
+  }
+}
+
+static void
+s_read_frame(gallus_session_t s, char *frame, size_t *len) {
+  uint32_t plen;
+
+  s_read_full(s, frame, SESSION_CHANNEL_HEADER_SIZE);
+  memcpy(&plen, frame + 4, sizeof(plen));
+  plen = ntohl(plen);
+  TEST_ASSERT_TRUE(plen < 64);
+  s_read_full(s, frame + SESSION_CHANNEL_HEADER_SIZE, plen);
+  *len = SESSION_CHANNEL_HEADER_SIZE + plen;
+}
+
+static void *
+s_pool_server(void *arg) {
+  gallus_session_t l = (gallus_session_t)arg;
+  gallus_session_t c = NULL;
+  char f[2][64], buf[1];
+  size_t len[2];
+
+  /* 1st connection: answer two pipelined requests in reverse order. */
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, session_accept(l, &c));
+  __sync_fetch_and_add(&s_n_pool_accepted, 1);
+  s_read_frame(c, f[0], &len[0]);
+  s_read_frame(c, f[1], &len[1]);
+  TEST_ASSERT_EQUAL(len[1], session_write(c, f[1], len[1]));
+  TEST_ASSERT_EQUAL(len[0], session_write(c, f[0], len[0]));
+  session_destroy(c);
+  s_pool_server_closed = true;
+
+  /* 2nd connection: the pool replaces the stale one. */
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, session_accept(l, &c));
+  __sync_fetch_and_add(&s_n_pool_accepted, 1);
+  s_read_frame(c, f[0], &len[0]);
+  TEST_ASSERT_EQUAL(len[0], session_write(c, f[0], len[0]));
+  TEST_ASSERT_EQUAL(0, session_read(c, buf, sizeof(buf)));
+  session_destroy(c);
+
+  return NULL;
+}
+
+static void *
+s_pool_requester(void *arg) {
+  gallus_session_channel_t ch = (gallus_session_channel_t)arg;
+  char resp[16];
+  size_t len = 0;
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    session_channel_request(&ch, "first", 5,
+                                            resp, sizeof(resp), &len,
+                                            5000LL * 1000LL * 1000LL));
+  TEST_ASSERT_EQUAL(5, len);
+  TEST_ASSERT_EQUAL(0, memcmp(resp, "first", 5));
+
+  return NULL;
+}
+
+void
+test_session_pool_tcp(void) {
+  gallus_result_t ret;
+  gallus_session_t l = NULL, s1 = NULL, s2 = NULL;
+  gallus_session_pool_t sp = NULL;
+  gallus_session_channel_t ch = NULL;
+  gallus_ip_address_t *dst, *src;
+  pthread_t srv, req;
+  char resp[16];
+  size_t len = 0;
+  gallus_chrono_t to = 5000LL * 1000LL * 1000LL;
+  int i;
+
+  ret = gallus_ip_address_create("0.0.0.0", true, &src);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_ip_address_create("127.0.0.1", true, &dst);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_create(SESSION_TCP|SESSION_PASSIVE, &l);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_bind(l, src, 10027);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  pthread_create(&srv, NULL, s_pool_server, l);
+
+  ret = session_pool_create(0, &sp);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS, ret);
+  ret = session_pool_create(1, &sp);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+
+  ret = session_pool_acquire(&sp, SESSION_TCP, dst, 10027, to, &s1);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_NOT_NULL(s1);
+
+  /* only one connection per endpoint. */
+  ret = session_pool_acquire(&sp, SESSION_TCP, dst, 10027,
+                             100LL * 1000LL * 1000LL, &s2);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_TIMEDOUT, ret);
+  TEST_ASSERT_NULL(s2);
+
+  /* two requests in flight on one connection. */
+  ret = session_channel_create(s1, 4, &ch);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  pthread_create(&req, NULL, s_pool_requester, ch);
+  ret = session_channel_request(&ch, "second", 6, resp, sizeof(resp), &len,
+                                to);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_EQUAL(6, len);
+  TEST_ASSERT_EQUAL(0, memcmp(resp, "second", 6));
+  pthread_join(req, NULL);
+  session_channel_destroy(&ch);
+  TEST_ASSERT_NULL(ch);
+
+  ret = session_pool_release(&sp, &s1, true);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_NULL(s1);
+
+  /* the server has closed the 1st connection, it must be replaced. */
+  for (i = 0; i < 50 && s_pool_server_closed == false; i++) {
+    usleep(100 * 1000);
+  }
+  TEST_ASSERT_TRUE(s_pool_server_closed);
+  ret = session_pool_acquire(&sp, SESSION_TCP, dst, 10027, to, &s1);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_channel_create(s1, 4, &ch);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_channel_request(&ch, "third", 5, resp, 2, &len, to);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_TOO_LARGE, ret);
+  TEST_ASSERT_EQUAL(5, len);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, session_channel_get_error(&ch));
+  session_channel_destroy(&ch);
+
+  ret = session_pool_release(&sp, &s1, true);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_pool_release(&sp, &l, true);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_NOT_OWNER, ret);
+
+  session_pool_destroy(&sp);
+  TEST_ASSERT_NULL(sp);
+  pthread_join(srv, NULL);
+  TEST_ASSERT_EQUAL(2, s_n_pool_accepted);
+
+  session_destroy(l);
+  gallus_ip_address_destroy(dst);
+  gallus_ip_address_destroy(src);
+}
+
+/* the receive buffer of a channel, see session_channel.c */
+#define CHANNEL_RX_BUFSIZ	(SESSION_BUFSIZ * 4)
+
+static volatile bool s_full_peer_done = false;
+
+static void *
+s_full_peer(void *arg) {
+  gallus_session_t l = (gallus_session_t)arg;
+  gallus_session_t c = NULL;
+  static char f[CHANNEL_RX_BUFSIZ];
+  size_t len, i;
+  uint32_t plen;
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, session_accept(l, &c));
+  s_read_frame(c, f, &len);
+
+  /* a response frame of exactly one receive buffer, in one write. */
+  plen = htonl(CHANNEL_RX_BUFSIZ - SESSION_CHANNEL_HEADER_SIZE);
+  memcpy(f + 4, &plen, sizeof(plen));
+  for (i = SESSION_CHANNEL_HEADER_SIZE; i < sizeof(f); i++) {
+    f[i] = (char)i;
+  }
+  TEST_ASSERT_EQUAL(sizeof(f), session_write(c, f, sizeof(f)));
+
+  /* keep the connection open and quiet for a while. */
+  for (i = 0; i < 30 && s_full_peer_done == false; i++) {
+    usleep(100 * 1000);
+  }
+  session_destroy(c);
+
+  return NULL;
+}
+
+void
+test_session_channel_blocking_full_buffer(void) {
+  gallus_result_t ret;
+  gallus_session_t l = NULL, s1 = NULL;
+  gallus_session_channel_t ch = NULL;
+  gallus_ip_address_t *dst, *src;
+  gallus_chrono_t t0;
+  pthread_t peer;
+  static char resp[CHANNEL_RX_BUFSIZ];
+  size_t len = 0, i;
+  int val;
+
+  ret = gallus_ip_address_create("0.0.0.0", true, &src);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = gallus_ip_address_create("127.0.0.1", true, &dst);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_create(SESSION_TCP|SESSION_PASSIVE, &l);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_bind(l, src, 10028);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  pthread_create(&peer, NULL, s_full_peer, l);
+
+  ret = session_create(SESSION_TCP|SESSION_ACTIVE, &s1);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  ret = session_connect(s1, dst, 10028, NULL, 0);
+  TEST_ASSERT_TRUE(ret == GALLUS_RESULT_OK ||
+                   ret == GALLUS_RESULT_EINPROGRESS);
+  val = 0;
+  TEST_ASSERT_EQUAL(0, ioctl(session_sockfd_get(s1), FIONBIO, &val));
+
+  ret = session_channel_create(s1, 4, &ch);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_TRUE((fcntl(session_sockfd_get(s1), F_GETFL) & O_NONBLOCK)
+                   != 0);
+
+  /*
+   * The whole response fits the buffer, nothing more comes: the
+   * reader must not go back to the socket before the peer closes it.
+   */
+  t0 = gallus_chrono_now();
+  ret = session_channel_request(&ch, "full", 4, resp, sizeof(resp), &len,
+                                5000LL * 1000LL * 1000LL);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, ret);
+  TEST_ASSERT_TRUE(gallus_chrono_now() - t0 < 1000LL * 1000LL * 1000LL);
+  TEST_ASSERT_EQUAL(CHANNEL_RX_BUFSIZ - SESSION_CHANNEL_HEADER_SIZE, len);
+  for (i = 0; i < len; i++) {
+    TEST_ASSERT_EQUAL((char)(i + SESSION_CHANNEL_HEADER_SIZE), resp[i]);
+  }
+
+  s_full_peer_done = true;
+  pthread_join(peer, NULL);
+  session_channel_destroy(&ch);
+  session_destroy(s1);
+  session_destroy(l);
+  gallus_ip_address_destroy(dst);
+  gallus_ip_address_destroy(src);
+}
@@ -0,0 +1,262 @@
+#include "gallus_apis.h"
+#include "unity.h"
+
+
+
+
+
+#define N_ELEMS	200000
+
+
+typedef struct {
+  int32_t m_key;
+  uint32_t m_seq;
+  uint64_t m_pad;
+} rec_t;
+
+
+#define U64_LESS(a, b)	((a) < (b))
+#define REC_LESS(a, b)	((a).m_key < (b).m_key)
+
+GALLUS_SORT_DEFINE(s_sort_u64, uint64_t, U64_LESS)
+GALLUS_SORT_DEFINE(s_sort_rec, rec_t, REC_LESS)
+
+
+static gallus_thread_pool_t s_pool = NULL;
+static uint64_t s_u64[N_ELEMS];
+static rec_t s_recs[N_ELEMS];
+static uint64_t s_seed = 88172645463325252ULL;
+
+
+static inline uint64_t
+s_rand(void) {
+  s_seed ^= s_seed << 13;
+  s_seed ^= s_seed >> 7;
+  s_seed ^= s_seed << 17;
+  return s_seed;
+}
+
+
+static int
+s_cmp_u64(const void *a, const void *b, void *arg) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+
+  (void)arg;
+
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+static int
+s_cmp_rec(const void *a, const void *b, void *arg) {
+  const rec_t *x = (const rec_t *)a;
+  const rec_t *y = (const rec_t *)b;
+
+  (void)arg;
+
+  return (x->m_key < y->m_key) ? -1 : ((x->m_key > y->m_key) ? 1 : 0);
+}
+
+
+/*
+ * Random, sorted, reversed, all equal, few distinct and sawtooth.
+ */
+static void
+s_fill_u64(int pattern, size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    switch (pattern) {
+      case 0:
+        s_u64[i] = s_rand();
+        break;
+      case 1:
+        s_u64[i] = i;
+        break;
+      case 2:
+        s_u64[i] = n - i;
+        break;
+      case 3:
+        s_u64[i] = 42;
+        break;
+      case 4:
+        s_u64[i] = s_rand() % 4;
+        break;
+      default:
+        s_u64[i] = i % 1000;
+        break;
+    }
+  }
+}
+#define N_PATTERNS	6
+
+
+static void
+s_fill_recs(size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    s_recs[i].m_key = (int32_t)(s_rand() % 20000) - 10000;
+    s_recs[i].m_seq = (uint32_t)i;
+    s_recs[i].m_pad = 0;
+  }
+}
+
+
+static void
+s_check_u64(size_t n) {
+  size_t i;
+
+  for (i = 1; i < n; i++) {
+    if (s_u64[i - 1] > s_u64[i]) {
+      break;
+    }
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(n < 2 ? 1 : n, n < 2 ? 1 : i,
+                            "not sorted.");
+}
+
+
+static void
+s_check_recs(size_t n, bool is_stable) {
+  size_t i;
+
+  for (i = 1; i < n; i++) {
+    if (s_recs[i - 1].m_key > s_recs[i].m_key ||
+        (is_stable == true &&
+         s_recs[i - 1].m_key == s_recs[i].m_key &&
+         s_recs[i - 1].m_seq > s_recs[i].m_seq)) {
+      break;
+    }
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(n, i, "not sorted.");
+}
+
+
+
+
+
+void
+setUp(void) {
+  gallus_result_t ret;
+
+  (void)global_state_set(GLOBAL_STATE_STARTED);
+
+  ret = gallus_thread_pool_create_executor(&s_pool, "sort test", 3);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "executor create error.");
+}
+
+
+void
+tearDown(void) {
+  (void)gallus_thread_pool_shutdown_all(&s_pool, SHUTDOWN_GRACEFULLY, -1LL);
+  gallus_thread_pool_destroy(&s_pool);
+  s_pool = NULL;
+}
+
+
+
+
+
+void
+test_sort_define(void) {
+  static const size_t sizes[] = { 0, 1, 2, 23, 24, 129, 1000, N_ELEMS };
+  size_t i;
+  int p;
+
+  for (p = 0; p < N_PATTERNS; p++) {
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      s_fill_u64(p, sizes[i]);
+      s_sort_u64(s_u64, sizes[i]);
+      s_check_u64(sizes[i]);
+    }
+  }
+
+  s_fill_recs(N_ELEMS);
+  s_sort_rec(s_recs, N_ELEMS);
+  s_check_recs(N_ELEMS, false);
+}
+
+
+void
+test_radix_sort(void) {
+  static uint32_t u32[N_ELEMS];
+  size_t i;
+  int p;
+
+  for (p = 0; p < N_PATTERNS; p++) {
+    s_fill_u64(p, N_ELEMS);
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                      gallus_radix_sort_u64(s_u64, N_ELEMS));
+    s_check_u64(N_ELEMS);
+  }
+
+  for (i = 0; i < N_ELEMS; i++) {
+    u32[i] = (uint32_t)s_rand();
+  }
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_radix_sort_u32(u32, N_ELEMS));
+  for (i = 1; i < N_ELEMS; i++) {
+    if (u32[i - 1] > u32[i]) {
+      break;
+    }
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(N_ELEMS, i, "not sorted.");
+
+  /* signed keys, and stable. */
+  s_fill_recs(N_ELEMS);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_radix_sort_records(s_recs, N_ELEMS, sizeof(rec_t),
+                                              offsetof(rec_t, m_key),
+                                              sizeof(int32_t), true));
+  s_check_recs(N_ELEMS, true);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_radix_sort_u64(NULL, 0));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_radix_sort_u64(NULL, 1));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_radix_sort_records(s_recs, N_ELEMS, sizeof(rec_t),
+                                              0, 3, false));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_radix_sort_records(s_recs, N_ELEMS, sizeof(rec_t),
+                                              sizeof(rec_t) - 4, 8, false));
+}
+
+
+void
+test_parallel_sort(void) {
+  static const size_t sizes[] = { 0, 1, 1000, 8192 * 2 + 1, 8192 * 3 + 5,
+                                  N_ELEMS
+                                };
+  size_t i;
+  int p;
+
+  for (p = 0; p < N_PATTERNS; p++) {
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      s_fill_u64(p, sizes[i]);
+      TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                        gallus_parallel_sort_r(&s_pool, s_u64, sizes[i],
+                                               sizeof(uint64_t),
+                                               s_cmp_u64, NULL));
+      s_check_u64(sizes[i]);
+    }
+  }
+
+  s_fill_recs(N_ELEMS);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_parallel_sort_r(&s_pool, s_recs, N_ELEMS,
+                                           sizeof(rec_t), s_cmp_rec, NULL));
+  s_check_recs(N_ELEMS, false);
+
+  /* no pool. */
+  s_fill_u64(0, N_ELEMS);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_parallel_sort_r(NULL, s_u64, N_ELEMS,
+                                           sizeof(uint64_t),
+                                           s_cmp_u64, NULL));
+  s_check_u64(N_ELEMS);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_parallel_sort_r(&s_pool, s_u64, N_ELEMS,
+                                           sizeof(uint64_t), NULL, NULL));
+}
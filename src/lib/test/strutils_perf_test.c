@@ -0,0 +1,301 @@
+#include "unity.h"
+#include "gallus_apis.h"
+
+/*
+ * Throughput of the integer parsers on config/CLI like tokens.
+ *
+ * A table of tokens (short and long decimals, hex, negatives, SI
+ * prefixed) is parsed round robin; the numbers are ns/token and
+ * tokens/s. strtoll(3) on the same tokens is reported as a
+ * reference, it can't handle the prefixes and the SI suffixes so
+ * it only shows the floor.
+ *
+ * The tokenizers are run over a multi MB config like text, as MB/s.
+ *
+ * Environment:
+ *   STRUTILS_PERF_TOKENS	tokens per run (default 4000000)
+ *   STRUTILS_PERF_TEXT_MB	size of the text to tokenize (default 8)
+ */
+
+#define OUTPUT stdout
+
+#define DEFAULT_TOKENS	4000000
+#define DEFAULT_TEXT_MB	8
+
+static size_t s_n_tokens = DEFAULT_TOKENS;
+static size_t s_text_len = DEFAULT_TEXT_MB * 1024 * 1024;
+
+static const char *const s_tokens[] = {
+  "0",
+  "1",
+  "42",
+  "8080",
+  "65535",
+  "-1",
+  "-32768",
+  "100000",
+  "2147483647",
+  "4294967295",
+  "1234567890123",
+  "9223372036854775807",
+  "-9223372036854775808",
+  "18446744073709551615",
+  "0x10",
+  "0xdeadbeef",
+  "0xffffffffffffffff",
+  "  256  ",
+  "64k",
+  "16Mi",
+  "1G",
+  "\\0755",
+  "b1010",
+};
+#define N_TOKENS	(sizeof(s_tokens) / sizeof(s_tokens[0]))
+
+void
+setUp(void) {
+  const char *e;
+
+  if ((e = getenv("STRUTILS_PERF_TOKENS")) != NULL && atoi(e) > 0) {
+    s_n_tokens = (size_t)atoi(e);
+  }
+  if ((e = getenv("STRUTILS_PERF_TEXT_MB")) != NULL && atoi(e) > 0) {
+    s_text_len = (size_t)atoi(e) * 1024 * 1024;
+  }
+}
+
+void
+tearDown(void) {
+}
+
+
+
+
+
+static inline uint64_t
+s_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000LL + (uint64_t)ts.tv_nsec;
+}
+
+static void
+s_report(const char *label, size_t n, size_t n_ok, uint64_t total) {
+  fprintf(OUTPUT, "%-14s tokens %9zu (ok %9zu): %7.1f ns/token, "
+          "%12.0f tokens/s\n",
+          label, n, n_ok,
+          (double)total / (double)n,
+          (double)n * 1e9 / (double)total);
+  fflush(OUTPUT);
+}
+
+static void
+s_report_text(const char *label, size_t len, size_t n, uint64_t total) {
+  fprintf(OUTPUT, "%-14s bytes %9zu (tokens %9zu): %8.1f MB/s\n",
+          label, len, n,
+          (double)len * 1e9 / (double)total / (1024.0 * 1024.0));
+  fflush(OUTPUT);
+}
+
+/*
+ * Lines of "  key value, value;" with the words from s_tokens.
+ */
+static char *
+s_make_text(size_t len) {
+  char *buf = (char *)malloc(len + 1);
+  const char *w;
+  size_t i = 0, j = 0, l;
+
+  if (buf != NULL) {
+    while (i < len) {
+      w = s_tokens[j % N_TOKENS];
+      l = strlen(w);
+      if (i + l + 2 > len) {
+        break;
+      }
+      (void)memcpy(buf + i, w, l);
+      i += l;
+      buf[i++] = ((++j % 8) == 0) ? '\n' : ((j % 3) == 0 ? ',' : ' ');
+    }
+    (void)memset(buf + i, ' ', len - i);
+    buf[len] = '\0';
+  }
+
+  return buf;
+}
+
+
+
+
+
+void
+test_parse_int64(void) {
+  volatile int64_t sink = 0;
+  int64_t v;
+  size_t i, n_ok = 0;
+  uint64_t start = s_now();
+
+  for (i = 0; i < s_n_tokens; i++) {
+    if (gallus_str_parse_int64(s_tokens[i % N_TOKENS], &v) ==
+        GALLUS_RESULT_OK) {
+      sink += v;
+      n_ok++;
+    }
+  }
+  s_report("int64", s_n_tokens, n_ok, s_now() - start);
+  TEST_ASSERT_TRUE(n_ok > 0);
+}
+
+
+void
+test_parse_uint64(void) {
+  volatile uint64_t sink = 0;
+  uint64_t v;
+  size_t i, n_ok = 0;
+  uint64_t start = s_now();
+
+  for (i = 0; i < s_n_tokens; i++) {
+    if (gallus_str_parse_uint64(s_tokens[i % N_TOKENS], &v) ==
+        GALLUS_RESULT_OK) {
+      sink += v;
+      n_ok++;
+    }
+  }
+  s_report("uint64", s_n_tokens, n_ok, s_now() - start);
+  TEST_ASSERT_TRUE(n_ok > 0);
+}
+
+
+void
+test_parse_uint16(void) {
+  volatile uint64_t sink = 0;
+  uint16_t v;
+  size_t i, n_ok = 0;
+  uint64_t start = s_now();
+
+  for (i = 0; i < s_n_tokens; i++) {
+    if (gallus_str_parse_uint16(s_tokens[i % N_TOKENS], &v) ==
+        GALLUS_RESULT_OK) {
+      sink += v;
+      n_ok++;
+    }
+  }
+  s_report("uint16", s_n_tokens, n_ok, s_now() - start);
+  TEST_ASSERT_TRUE(n_ok > 0);
+}
+
+
+void
+test_parse_int64_by_base_10(void) {
+  volatile int64_t sink = 0;
+  int64_t v;
+  size_t i, n_ok = 0;
+  uint64_t start = s_now();
+
+  for (i = 0; i < s_n_tokens; i++) {
+    if (gallus_str_parse_int64_by_base(s_tokens[i % N_TOKENS], &v, 10) ==
+        GALLUS_RESULT_OK) {
+      sink += v;
+      n_ok++;
+    }
+  }
+  s_report("int64 base 10", s_n_tokens, n_ok, s_now() - start);
+  TEST_ASSERT_TRUE(n_ok > 0);
+}
+
+
+void
+test_parse_uint64_by_base_16(void) {
+  volatile uint64_t sink = 0;
+  uint64_t v;
+  size_t i, n_ok = 0;
+  uint64_t start = s_now();
+
+  for (i = 0; i < s_n_tokens; i++) {
+    if (gallus_str_parse_uint64_by_base(s_tokens[i % N_TOKENS], &v, 16) ==
+        GALLUS_RESULT_OK) {
+      sink += v;
+      n_ok++;
+    }
+  }
+  s_report("uint64 base 16", s_n_tokens, n_ok, s_now() - start);
+  TEST_ASSERT_TRUE(n_ok > 0);
+}
+
+
+void
+test_strtoll_reference(void) {
+  volatile int64_t sink = 0;
+  const char *s;
+  char *e;
+  long long v;
+  size_t i, n_ok = 0;
+  uint64_t start = s_now();
+
+  for (i = 0; i < s_n_tokens; i++) {
+    s = s_tokens[i % N_TOKENS];
+    errno = 0;
+    v = strtoll(s, &e, 0);
+    if (errno == 0 && e != s) {
+      sink += v;
+      n_ok++;
+    }
+  }
+  s_report("strtoll(3)", s_n_tokens, n_ok, s_now() - start);
+  TEST_ASSERT_TRUE(n_ok > 0);
+}
+
+
+void
+test_tokenize_text(void) {
+  char *text = s_make_text(s_text_len);
+  char *buf = (char *)malloc(s_text_len + 1);
+  char **tokens = (char **)malloc(sizeof(char *) * s_text_len / 2);
+  gallus_result_t n;
+  uint64_t start;
+
+  TEST_ASSERT_NOT_NULL(text);
+  TEST_ASSERT_NOT_NULL(buf);
+  TEST_ASSERT_NOT_NULL(tokens);
+
+  (void)memcpy(buf, text, s_text_len + 1);
+  start = s_now();
+  n = gallus_str_tokenize(buf, tokens, s_text_len / 2, " ,\n");
+  s_report_text("tokenize", s_text_len, (size_t)n, s_now() - start);
+  TEST_ASSERT_TRUE(n > 0);
+
+  (void)memcpy(buf, text, s_text_len + 1);
+  start = s_now();
+  n = gallus_str_tokenize_quote(buf, tokens, s_text_len / 2, " ,\n", "\"'");
+  s_report_text("tokenize quote", s_text_len, (size_t)n, s_now() - start);
+  TEST_ASSERT_TRUE(n > 0);
+
+  free(tokens);
+  free(buf);
+  free(text);
+}
+
+
+void
+test_tokenizer_text(void) {
+  char *text = s_make_text(s_text_len);
+  gallus_str_tokenizer_t tk;
+  gallus_str_token_t t;
+  volatile size_t sink = 0;
+  size_t n = 0;
+  uint64_t start;
+
+  TEST_ASSERT_NOT_NULL(text);
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_str_tokenizer_init(&tk, text, s_text_len,
+                                               " ,\n"));
+  start = s_now();
+  while (gallus_str_tokenizer_next(&tk, &t) == GALLUS_RESULT_OK) {
+    sink += t.m_len;
+    n++;
+  }
+  s_report_text("tokenizer", s_text_len, n, s_now() - start);
+  TEST_ASSERT_TRUE(n > 0);
+
+  free(text);
+}
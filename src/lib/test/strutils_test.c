@@ -346,6 +346,97 @@ test_gallus_str_tokenize_with_limit_05(void) {
   }
 }
 
+void
+test_gallus_str_tokenize_quote_max(void) {
+  gallus_result_t n_tokens = GALLUS_RESULT_ANY_FAILURES;
+  char *tokens[2];
+  char str[] = "foo bar\"baz";
+
+  /* tokens[max] must not be touched. */
+  tokens[1] = NULL;
+  n_tokens = gallus_str_tokenize_quote(str, tokens, 1, " ", "\"");
+  TEST_ASSERT_EQUAL_MESSAGE(1, n_tokens, "n_tokens error.");
+  TEST_ASSERT_EQUAL_MESSAGE(0, strcmp("foo", tokens[0]),
+                            "token string compare error.");
+  TEST_ASSERT_NULL(tokens[1]);
+}
+
+void
+test_gallus_str_tokenizer_01(void) {
+  gallus_str_tokenizer_t tk;
+  gallus_str_token_t t;
+  size_t i;
+  const char str[] = ",,foo,bar.baz,,hoge-1.";
+  const char *test_str[] = {
+    "foo",
+    "bar",
+    "baz",
+    "hoge-1"
+  };
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_str_tokenizer_init(&tk, str, strlen(str), ",."));
+  for (i = 0; i < sizeof(test_str) / sizeof(test_str[0]); i++) {
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_str_tokenizer_next(&tk, &t));
+    TEST_ASSERT_EQUAL(strlen(test_str[i]), t.m_len);
+    TEST_ASSERT_EQUAL(0, strncmp(test_str[i], t.m_str, t.m_len));
+  }
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_EOF, gallus_str_tokenizer_next(&tk, &t));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_EOF, gallus_str_tokenizer_next(&tk, &t));
+
+  /* the buffer is left as is. */
+  TEST_ASSERT_EQUAL(0, strcmp(",,foo,bar.baz,,hoge-1.", str));
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_str_tokenizer_init(&tk, "", 0, " "));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_EOF, gallus_str_tokenizer_next(&tk, &t));
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_str_tokenizer_init(NULL, str, strlen(str), ","));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_str_tokenizer_init(&tk, str, strlen(str), ""));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_str_tokenizer_next(&tk, NULL));
+}
+
+void
+test_gallus_str_tokenizer_02(void) {
+  /*
+   * Longer than a word and more delimiters than the word at a time
+   * scan handles, compared with gallus_str_tokenize().
+   */
+  const char *delms[] = { " ", " \t", " \t,;:" };
+  gallus_str_tokenizer_t tk;
+  gallus_str_token_t t;
+  char buf[4096];
+  char copy[4096];
+  char *tokens[4096];
+  gallus_result_t n_tokens;
+  size_t i, j, len;
+
+  for (j = 0; j < sizeof(delms) / sizeof(delms[0]); j++) {
+    srand((unsigned int)j);
+    len = sizeof(buf) - 1;
+    for (i = 0; i < len; i++) {
+      buf[i] = "abcdefgh \t,;:"[rand() % 13];
+    }
+    buf[len] = '\0';
+    (void)memcpy(copy, buf, sizeof(buf));
+
+    n_tokens = gallus_str_tokenize(copy, tokens, 4096, delms[j]);
+    TEST_ASSERT_TRUE(n_tokens > 0);
+
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                      gallus_str_tokenizer_init(&tk, buf, len, delms[j]));
+    for (i = 0; i < (size_t)n_tokens; i++) {
+      TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_str_tokenizer_next(&tk, &t));
+      TEST_ASSERT_EQUAL(tokens[i] - copy, t.m_str - buf);
+      TEST_ASSERT_EQUAL(strlen(tokens[i]), t.m_len);
+    }
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_EOF, gallus_str_tokenizer_next(&tk, &t));
+  }
+}
+
 void
 test_gallus_str_trim_right_01(void) {
   gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
@@ -0,0 +1,473 @@
+#include "unity.h"
+#include "gallus_apis.h"
+#include "gallus_task_internal.h"
+
+/*
+ * Throughput of tiny tasks on a thread pool.
+ *
+ * Every task only bumps a counter, so the numbers are the per task
+ * overhead of the pool: task create + hand over + run + destroy.
+ *
+ *   executor	gallus_thread_pool_create_executor() + gallus_task_submit()
+ *   acquire	gallus_thread_pool_acquire_thread() + gallus_task_run(),
+ *		one pooled thread per task
+ *
+ * Reported per run: tasks/s and the average submission cost seen by
+ * the submitter.
+ *
+ * The chain runs measure the critical path of a job of dependent
+ * steps, 1/100 of the tasks long:
+ *
+ *   then	each step is a gallus_future_then() continuation of the
+ *		previous one
+ *   wait	each step is submitted after gallus_task_wait() on the
+ *		previous one
+ *
+ * The reduce runs sum 4 * tasks doubles with gallus_parallel_reduce()
+ * on the caller only and on the pool.
+ *
+ * The fiber runs switch two fibers on a single carrier thread:
+ *
+ *   yield	both call gallus_fiber_yield() tasks times
+ *   cbuffer	both ping-pong tasks / 10 values through a gallus_cbuffer
+ *		of 1, parking on every get
+ *
+ * Environment:
+ *   THREAD_POOL_PERF_TASKS	executor tasks (default 1000000); the
+ *				acquire run uses 1/100 of it.
+ *   THREAD_POOL_PERF_WORKERS	pooled threads (default: online CPUs)
+ */
+
+#define OUTPUT stdout
+
+#define DEFAULT_TASKS	1000000
+
+static size_t s_n_tasks = DEFAULT_TASKS;
+static size_t s_n_workers = 0;
+
+static size_t s_n_done = 0;
+
+void
+setUp(void) {
+  const char *e;
+  long n;
+
+  if ((e = getenv("THREAD_POOL_PERF_TASKS")) != NULL && atoi(e) > 0) {
+    s_n_tasks = (size_t)atoi(e);
+  }
+  if ((e = getenv("THREAD_POOL_PERF_WORKERS")) != NULL && atoi(e) > 0) {
+    s_n_workers = (size_t)atoi(e);
+  } else if ((n = sysconf(_SC_NPROCESSORS_ONLN)) > 0) {
+    s_n_workers = (size_t)n;
+  } else {
+    s_n_workers = 1;
+  }
+
+  __atomic_store_n(&s_n_done, 0, __ATOMIC_RELAXED);
+
+  (void)global_state_set(GLOBAL_STATE_STARTED);
+}
+
+void
+tearDown(void) {
+}
+
+
+
+
+
+static inline uint64_t
+s_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000LL + (uint64_t)ts.tv_nsec;
+}
+
+static gallus_result_t
+s_tiny_main(gallus_task_t *tptr) {
+  (void)tptr;
+  (void)__atomic_add_fetch(&s_n_done, 1, __ATOMIC_RELAXED);
+  return GALLUS_RESULT_OK;
+}
+
+static bool
+s_wait_done(size_t n, uint64_t limit) {
+  uint64_t start = s_now();
+
+  while (__atomic_load_n(&s_n_done, __ATOMIC_ACQUIRE) < n) {
+    if (s_now() - start > limit) {
+      return false;
+    }
+    (void)usleep(100);
+  }
+  return true;
+}
+
+static void
+s_report(const char *label, size_t n, uint64_t submit, uint64_t total) {
+  fprintf(OUTPUT, "%-9s workers %3zu tasks %8zu: %12.0f tasks/s, "
+          "submit %7.1f ns/task, total %8.3f s\n",
+          label, s_n_workers, n,
+          (double)n * 1e9 / (double)total,
+          (double)submit / (double)n,
+          (double)total / 1e9);
+  fflush(OUTPUT);
+}
+
+
+
+
+
+void
+test_executor_tiny_tasks(void) {
+  gallus_thread_pool_t p = NULL;
+  gallus_result_t ret;
+  gallus_task_t t = NULL;
+  uint64_t start, submitted, done;
+  size_t i;
+
+  ret = gallus_thread_pool_create_executor(&p, "perf executor", s_n_workers);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "executor create error.");
+
+  start = s_now();
+  for (i = 0; i < s_n_tasks; i++) {
+    t = NULL;
+    ret = gallus_task_create(&t, 0, NULL, s_tiny_main, NULL, NULL);
+    if (ret != GALLUS_RESULT_OK) {
+      break;
+    }
+    ret = gallus_task_submit(&t, &p, GALLUS_TASK_DELETE_CONTEXT_AFTER_EXEC);
+    if (ret != GALLUS_RESULT_OK) {
+      gallus_task_destroy(&t);
+      break;
+    }
+  }
+  submitted = s_now();
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "task submit error.");
+
+  TEST_ASSERT_TRUE_MESSAGE(s_wait_done(s_n_tasks, 120LL * 1000LL * 1000LL *
+                                       1000LL),
+                           "tasks not finished.");
+  done = s_now();
+
+  s_report("executor", s_n_tasks, submitted - start, done - start);
+
+  ret = gallus_thread_pool_shutdown_all(&p, SHUTDOWN_GRACEFULLY, -1LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "shutdown error.");
+  gallus_thread_pool_destroy(&p);
+}
+
+
+void
+test_acquire_tiny_tasks(void) {
+  gallus_thread_pool_t p = NULL;
+  gallus_result_t ret;
+  gallus_task_t t = NULL;
+  gallus_pooled_thread_t thd = NULL;
+  uint64_t start, submitted, done;
+  size_t n = s_n_tasks / 100 > 0 ? s_n_tasks / 100 : 1;
+  size_t i;
+
+  ret = gallus_thread_pool_create(&p, "perf pool", s_n_workers);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "pool create error.");
+
+  start = s_now();
+  for (i = 0; i < n; i++) {
+    t = NULL;
+    ret = gallus_task_create(&t, 0, NULL, s_tiny_main, NULL, NULL);
+    if (ret != GALLUS_RESULT_OK) {
+      break;
+    }
+    ret = gallus_thread_pool_acquire_thread(&p, &thd, -1LL);
+    if (ret != GALLUS_RESULT_OK) {
+      gallus_task_destroy(&t);
+      break;
+    }
+    ret = gallus_task_run(&t, &thd,
+                          GALLUS_TASK_RELEASE_THREAD_AFTER_EXEC |
+                          GALLUS_TASK_DELETE_CONTEXT_AFTER_EXEC);
+    if (ret != GALLUS_RESULT_OK) {
+      break;
+    }
+  }
+  submitted = s_now();
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "task run error.");
+
+  TEST_ASSERT_TRUE_MESSAGE(s_wait_done(n, 120LL * 1000LL * 1000LL * 1000LL),
+                           "tasks not finished.");
+  done = s_now();
+
+  s_report("acquire", n, submitted - start, done - start);
+
+  /*
+   * The last runners may still be on their way back to the pool.
+   */
+  while (gallus_thread_pool_get_outstanding_thread_num(&p) <
+         (gallus_result_t)s_n_workers) {
+    (void)usleep(1000);
+  }
+  gallus_thread_pool_destroy(&p);
+}
+
+
+static gallus_result_t
+s_step(gallus_future_t *inputs, size_t n_inputs, void *arg, void **valptr) {
+  (void)arg;
+  (void)valptr;
+
+  (void)__atomic_add_fetch(&s_n_done, 1, __ATOMIC_RELAXED);
+
+  return (n_inputs > 0) ? gallus_future_get_result(&inputs[0]) + 1 : 1;
+}
+
+
+void
+test_chain_latency(void) {
+  gallus_thread_pool_t p = NULL;
+  gallus_result_t ret;
+  gallus_future_t head = NULL;
+  gallus_future_t f = NULL;
+  gallus_future_t nf = NULL;
+  gallus_task_t t = NULL;
+  uint64_t start, built, done;
+  size_t n = s_n_tasks / 100 > 0 ? s_n_tasks / 100 : 1;
+  size_t i;
+
+  ret = gallus_thread_pool_create_executor(&p, "perf chain", s_n_workers);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "executor create error.");
+
+  /*
+   * Build the whole chain first, then measure from the head
+   * completion to the tail.
+   */
+  ret = gallus_future_create(&head);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "future create error.");
+  f = head;
+  for (i = 0; i < n; i++) {
+    ret = gallus_future_then(&f, &p, s_step, NULL, &nf);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "then error.");
+    if (f != head) {
+      gallus_future_destroy(&f);
+    }
+    f = nf;
+  }
+
+  start = s_now();
+  (void)gallus_future_complete(&head, 0, NULL);
+  ret = gallus_future_wait(&f, -1LL);
+  done = s_now();
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "chain wait error.");
+  TEST_ASSERT_EQUAL_MESSAGE((gallus_result_t)n, gallus_future_get_result(&f),
+                            "chain result error.");
+  gallus_future_destroy(&f);
+  gallus_future_destroy(&head);
+
+  fprintf(OUTPUT, "then      workers %3zu steps %8zu: %10.1f ns/step\n",
+          s_n_workers, n, (double)(done - start) / (double)n);
+
+  start = s_now();
+  for (i = 0; i < n; i++) {
+    t = NULL;
+    ret = gallus_task_create(&t, 0, NULL, s_tiny_main, NULL, NULL);
+    if (ret != GALLUS_RESULT_OK) {
+      break;
+    }
+    ret = gallus_task_submit(&t, &p, 0);
+    if (ret == GALLUS_RESULT_OK) {
+      ret = gallus_task_wait(&t, -1LL);
+    }
+    gallus_task_destroy(&t);
+    if (ret != GALLUS_RESULT_OK) {
+      break;
+    }
+  }
+  built = s_now();
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "task wait error.");
+
+  fprintf(OUTPUT, "wait      workers %3zu steps %8zu: %10.1f ns/step\n",
+          s_n_workers, n, (double)(built - start) / (double)n);
+  fflush(OUTPUT);
+
+  ret = gallus_thread_pool_shutdown_all(&p, SHUTDOWN_GRACEFULLY, -1LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "shutdown error.");
+  gallus_thread_pool_destroy(&p);
+}
+
+
+static gallus_result_t
+s_sum_doubles(size_t begin, size_t end, void *acc, void *arg) {
+  const double *v = (const double *)arg;
+  double sum = 0.0;
+  size_t i;
+
+  for (i = begin; i < end; i++) {
+    sum += v[i];
+  }
+  *(double *)acc += sum;
+
+  return GALLUS_RESULT_OK;
+}
+
+
+static void
+s_add_doubles(void *acc, const void *other, void *arg) {
+  (void)arg;
+  *(double *)acc += *(const double *)other;
+}
+
+
+void
+test_parallel_reduce_sum(void) {
+  gallus_thread_pool_t p = NULL;
+  gallus_result_t ret;
+  size_t n = s_n_tasks * 4;
+  double *v = NULL;
+  double serial = 0.0;
+  double sum = 0.0;
+  uint64_t start, t_serial, t_pool;
+  size_t i;
+
+  v = (double *)malloc(sizeof(double) * n);
+  TEST_ASSERT_NOT_NULL_MESSAGE(v, "no memory.");
+  for (i = 0; i < n; i++) {
+    v[i] = (double)(i % 1000);
+  }
+
+  ret = gallus_thread_pool_create_executor(&p, "perf reduce", s_n_workers);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "executor create error.");
+
+  start = s_now();
+  ret = gallus_parallel_reduce(NULL, 0, n, 0, &serial, sizeof(serial),
+                               s_sum_doubles, s_add_doubles, v);
+  t_serial = s_now() - start;
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "reduce error.");
+
+  start = s_now();
+  ret = gallus_parallel_reduce(&p, 0, n, 0, &sum, sizeof(sum),
+                               s_sum_doubles, s_add_doubles, v);
+  t_pool = s_now() - start;
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "reduce error.");
+  TEST_ASSERT_TRUE_MESSAGE(serial == sum, "reduce result error.");
+
+  fprintf(OUTPUT, "reduce    workers %3zu elems %8zu: serial %8.3f ms, "
+          "pool %8.3f ms\n",
+          s_n_workers, n, (double)t_serial / 1e6, (double)t_pool / 1e6);
+  fflush(OUTPUT);
+
+  ret = gallus_thread_pool_shutdown_all(&p, SHUTDOWN_GRACEFULLY, -1LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "shutdown error.");
+  gallus_thread_pool_destroy(&p);
+  free(v);
+}
+
+
+static gallus_result_t
+s_fiber_yielder(void *arg) {
+  size_t n = (size_t)(uintptr_t)arg;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    (void)gallus_fiber_yield();
+  }
+
+  return GALLUS_RESULT_OK;
+}
+
+
+static gallus_cbuffer_t s_ping = NULL;
+static gallus_cbuffer_t s_pong = NULL;
+
+
+static gallus_result_t
+s_fiber_pinger(void *arg) {
+  size_t n = (size_t)(uintptr_t)arg;
+  gallus_result_t ret = GALLUS_RESULT_OK;
+  size_t i;
+  int v = 0;
+
+  for (i = 0; i < n && ret == GALLUS_RESULT_OK; i++) {
+    ret = gallus_cbuffer_put(&s_ping, &v, int, -1LL);
+    if (ret == GALLUS_RESULT_OK) {
+      ret = gallus_cbuffer_get(&s_pong, &v, int, -1LL);
+    }
+  }
+
+  return ret;
+}
+
+
+static gallus_result_t
+s_fiber_ponger(void *arg) {
+  size_t n = (size_t)(uintptr_t)arg;
+  gallus_result_t ret = GALLUS_RESULT_OK;
+  size_t i;
+  int v;
+
+  for (i = 0; i < n && ret == GALLUS_RESULT_OK; i++) {
+    ret = gallus_cbuffer_get(&s_ping, &v, int, -1LL);
+    if (ret == GALLUS_RESULT_OK) {
+      v++;
+      ret = gallus_cbuffer_put(&s_pong, &v, int, -1LL);
+    }
+  }
+
+  return ret;
+}
+
+
+void
+test_fiber_switch(void) {
+  gallus_fiber_sched_t s = NULL;
+  gallus_future_t f1 = NULL;
+  gallus_future_t f2 = NULL;
+  gallus_result_t ret;
+  uint64_t start, t_yield, t_cb;
+  size_t n = s_n_tasks;
+  size_t m = s_n_tasks / 10 > 0 ? s_n_tasks / 10 : 1;
+
+  ret = gallus_fiber_sched_create(&s, "perf fiber", 1, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "sched create error.");
+
+  start = s_now();
+  ret = gallus_fiber_spawn(&s, s_fiber_yielder, (void *)(uintptr_t)n, &f1);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "spawn error.");
+  ret = gallus_fiber_spawn(&s, s_fiber_yielder, (void *)(uintptr_t)n, &f2);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "spawn error.");
+  (void)gallus_future_wait(&f1, -1LL);
+  (void)gallus_future_wait(&f2, -1LL);
+  t_yield = s_now() - start;
+  gallus_future_destroy(&f1);
+  gallus_future_destroy(&f2);
+
+  ret = gallus_cbuffer_create(&s_ping, int, 1, NULL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "cbuffer create error.");
+  ret = gallus_cbuffer_create(&s_pong, int, 1, NULL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "cbuffer create error.");
+
+  start = s_now();
+  ret = gallus_fiber_spawn(&s, s_fiber_ponger, (void *)(uintptr_t)m, &f2);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "spawn error.");
+  ret = gallus_fiber_spawn(&s, s_fiber_pinger, (void *)(uintptr_t)m, &f1);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "spawn error.");
+  (void)gallus_future_wait(&f1, -1LL);
+  (void)gallus_future_wait(&f2, -1LL);
+  t_cb = s_now() - start;
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, gallus_future_get_result(&f1),
+                            "ping error.");
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, gallus_future_get_result(&f2),
+                            "pong error.");
+  gallus_future_destroy(&f1);
+  gallus_future_destroy(&f2);
+
+  fprintf(OUTPUT, "yield     fibers   2 steps %8zu: %10.1f ns/switch\n",
+          2 * n, (double)t_yield / (double)(2 * n));
+  fprintf(OUTPUT, "cbuffer   fibers   2 trips %8zu: %10.1f ns/trip\n",
+          m, (double)t_cb / (double)m);
+  fflush(OUTPUT);
+
+  gallus_cbuffer_destroy(&s_ping, false);
+  gallus_cbuffer_destroy(&s_pong, false);
+  ret = gallus_fiber_sched_shutdown(&s, -1LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "shutdown error.");
+  gallus_fiber_sched_destroy(&s);
+}
@@ -699,3 +699,388 @@ test_cancel(void) {
     }
   }
 }
+
+
+void
+test_executor_submit(void) {
+  size_t n = 64;
+
+  gallus_thread_pool_t p = NULL;
+  gallus_thread_pool_t p2 = NULL;
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  test_task_t tsks[n];
+  test_task_t tsk = NULL;
+  size_t i;
+
+  ret = gallus_thread_pool_create_executor(&p, "test executor", 4);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "executor create error.");
+
+  for (i = 0; i < n; i++) {
+    tsks[i] = NULL;
+    ret = s_create_test_task(&tsks[i], NULL, 0);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "task create error.");
+  }
+
+  for (i = 0; i < n; i++) {
+    ret = gallus_task_submit((gallus_task_t *)&tsks[i], &p, 0);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "task submit error.");
+  }
+
+  for (i = 0; i < n; i++) {
+    ret = gallus_task_wait((gallus_task_t *)&tsks[i], -1LL);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "task wait error.");
+    ret = gallus_task_get_exit_code((gallus_task_t *)&tsks[i]);
+    TEST_ASSERT_EQUAL_MESSAGE(10, ret,
+                              "exit code error.");
+    s_destroy_test_task(&tsks[i]);
+  }
+
+  ret = s_create_test_task(&tsk, NULL, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "task create error.");
+  ret = gallus_task_submit((gallus_task_t *)&tsk, &p,
+                           GALLUS_TASK_DELETE_CONTEXT_AFTER_EXEC);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "task submit error.");
+  TEST_ASSERT_NULL_MESSAGE(tsk, "task context not handed over.");
+
+  /* not an executor. */
+  ret = gallus_thread_pool_create(&p2, "test pool", 1);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "pool create error.");
+  ret = s_create_test_task(&tsk, NULL, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "task create error.");
+  ret = gallus_task_submit((gallus_task_t *)&tsk, &p2, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_INVALID_OBJECT, ret,
+                            "submit to a non executor pool.");
+  s_destroy_test_task(&tsk);
+  gallus_thread_pool_destroy(&p2);
+
+  ret = gallus_thread_pool_shutdown_all(&p, SHUTDOWN_GRACEFULLY, -1LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "executor shutdown error.");
+  gallus_thread_pool_destroy(&p);
+}
+
+
+void
+test_executor_shutdown(void) {
+  size_t n = 4;
+
+  gallus_thread_pool_t p = NULL;
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  test_task_t tsks[n];
+  size_t i;
+  size_t n_done = 0;
+  gallus_task_state_t s;
+
+  ret = gallus_thread_pool_create_executor(&p, "test executor", 1);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "executor create error.");
+
+  for (i = 0; i < n; i++) {
+    tsks[i] = NULL;
+    ret = s_create_test_task(&tsks[i], NULL, 1);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "task create error.");
+    ret = gallus_task_submit((gallus_task_t *)&tsks[i], &p, 0);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "task submit error.");
+  }
+
+  /*
+   * Only the running task finishes, the queued ones are dropped.
+   */
+  usleep(200 * 1000);
+  ret = gallus_thread_pool_shutdown_all(&p, SHUTDOWN_RIGHT_NOW,
+                                        5000LL * 1000LL * 1000LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "executor shutdown error.");
+
+  ret = gallus_task_submit((gallus_task_t *)&tsks[0], &p, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_NOT_OPERATIONAL, ret,
+                            "submit after shutdown.");
+
+  for (i = 0; i < n; i++) {
+    ret = gallus_task_wait((gallus_task_t *)&tsks[i], -1LL);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "task wait error.");
+    ret = gallus_task_get_state((gallus_task_t *)&tsks[i], &s);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "task state error.");
+    if (s == GALLUS_TASK_STATE_CLEAN_FINISHED) {
+      n_done++;
+    } else {
+      TEST_ASSERT_EQUAL_MESSAGE(GALLUS_TASK_STATE_RUNNER_SHUTDOWN, s,
+                                "task state error.");
+      ret = gallus_task_get_exit_code((gallus_task_t *)&tsks[i]);
+      TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_NOT_STARTED, ret,
+                                "exit code error.");
+    }
+    s_destroy_test_task(&tsks[i]);
+  }
+  TEST_ASSERT_TRUE_MESSAGE(n_done >= 1 && n_done < n,
+                           "unexpected number of finished tasks.");
+
+  gallus_thread_pool_destroy(&p);
+}
+
+
+#define N_ENQUEUERS	4
+#define N_ENQUEUES	1024
+
+
+typedef struct test_enqueuer_record {
+  gallus_thread_pool_t pool_;
+  test_task_t tsks_[N_ENQUEUES];
+  size_t n_accepted_;
+  gallus_result_t last_;
+} test_enqueuer_record;
+
+
+static void *
+s_enqueuer_main(void *arg) {
+  test_enqueuer_record *q = (test_enqueuer_record *)arg;
+  size_t i;
+
+  q->n_accepted_ = 0;
+  q->last_ = GALLUS_RESULT_OK;
+  for (i = 0; i < N_ENQUEUES && q->last_ == GALLUS_RESULT_OK; i++) {
+    q->tsks_[i] = NULL;
+    q->last_ = s_create_test_task(&q->tsks_[i], NULL, 0);
+    if (q->last_ != GALLUS_RESULT_OK) {
+      break;
+    }
+    q->last_ = gallus_task_submit((gallus_task_t *)&q->tsks_[i],
+                                  &q->pool_, 0);
+    if (q->last_ == GALLUS_RESULT_OK) {
+      q->n_accepted_++;
+    } else {
+      s_destroy_test_task(&q->tsks_[i]);
+    }
+    if ((i % 64) == 0) {
+      (void)sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+
+void
+test_executor_enqueue_while_stopping(void) {
+  static test_enqueuer_record qs[N_ENQUEUERS];
+  gallus_thread_pool_t p = NULL;
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  pthread_t thds[N_ENQUEUERS];
+  gallus_task_state_t s;
+  size_t round, i, j;
+
+  for (round = 0; round < 8; round++) {
+    p = NULL;
+    ret = gallus_thread_pool_create_executor(&p, "test executor", 2);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "executor create error.");
+
+    for (i = 0; i < N_ENQUEUERS; i++) {
+      qs[i].pool_ = p;
+      TEST_ASSERT_EQUAL(0, pthread_create(&thds[i], NULL,
+                                          s_enqueuer_main, &qs[i]));
+    }
+
+    /*
+     * Stop in the middle of the enqueues; every accepted task must
+     * still run, none is left behind in a stopped executor.
+     */
+    usleep((useconds_t)(round * 500));
+    ret = gallus_thread_pool_shutdown_all(&p, SHUTDOWN_GRACEFULLY, -1LL);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "executor shutdown error.");
+
+    for (i = 0; i < N_ENQUEUERS; i++) {
+      TEST_ASSERT_EQUAL(0, pthread_join(thds[i], NULL));
+      TEST_ASSERT_TRUE_MESSAGE(qs[i].last_ == GALLUS_RESULT_OK ||
+                               qs[i].last_ == GALLUS_RESULT_NOT_OPERATIONAL,
+                               "unexpected enqueue result.");
+      for (j = 0; j < qs[i].n_accepted_; j++) {
+        ret = gallus_task_wait((gallus_task_t *)&qs[i].tsks_[j],
+                               5000LL * 1000LL * 1000LL);
+        TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                                  "an accepted task is lost.");
+        ret = gallus_task_get_state((gallus_task_t *)&qs[i].tsks_[j], &s);
+        TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                                  "task state error.");
+        TEST_ASSERT_EQUAL_MESSAGE(GALLUS_TASK_STATE_CLEAN_FINISHED, s,
+                                  "an accepted task didn't run.");
+        s_destroy_test_task(&qs[i].tsks_[j]);
+      }
+    }
+
+    gallus_thread_pool_destroy(&p);
+  }
+}
+
+
+void
+test_elastic_grow_and_trim(void) {
+  size_t n_max = 6;
+
+  gallus_thread_pool_t p = NULL;
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_pooled_thread_t thds[n_max];
+  gallus_pooled_thread_t thd = NULL;
+  gallus_pool_stats_t st;
+  size_t i;
+
+  ret = gallus_thread_pool_create_elastic(&p, "test elastic", 4, 2, 0LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_INVALID_ARGS, ret,
+                            "min > max.");
+
+  /* no reaper, trimmed by hand. */
+  ret = gallus_thread_pool_create_elastic(&p, "test elastic", 2, n_max, 0LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "elastic pool create error.");
+
+  ret = gallus_thread_pool_get_stats(&p, &st);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "stats error.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, st.m_n_cur, "not pre-warmed.");
+  TEST_ASSERT_EQUAL(2, st.m_n_min);
+  TEST_ASSERT_EQUAL(n_max, st.m_n_max);
+  TEST_ASSERT_EQUAL(0, st.m_n_busy);
+
+  for (i = 0; i < n_max; i++) {
+    thds[i] = NULL;
+    ret = gallus_thread_pool_acquire_thread(&p, &thds[i], -1LL);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "thread acquisition error.");
+  }
+
+  ret = gallus_thread_pool_acquire_thread(&p, &thd, 10LL * 1000LL * 1000LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_TIMEDOUT, ret,
+                            "acquisition on a saturated pool.");
+
+  ret = gallus_thread_pool_get_stats(&p, &st);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "stats error.");
+  TEST_ASSERT_EQUAL_MESSAGE(n_max, st.m_n_cur, "not grown.");
+  TEST_ASSERT_EQUAL(n_max, st.m_n_busy);
+  TEST_ASSERT_EQUAL(n_max, st.m_n_busy_peak);
+  TEST_ASSERT_EQUAL(n_max, st.m_n_created);
+  TEST_ASSERT_EQUAL(n_max, st.m_n_acquired);
+  TEST_ASSERT_EQUAL(1, st.m_n_waited);
+  TEST_ASSERT_EQUAL(1, st.m_n_timedout);
+  TEST_ASSERT_TRUE_MESSAGE(st.m_wait_max >= 5LL * 1000LL * 1000LL &&
+                           st.m_wait_total == st.m_wait_max,
+                           "wait time error.");
+
+  for (i = 0; i < n_max; i++) {
+    ret = gallus_thread_pool_release_thread(&thds[i]);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "thread release error.");
+  }
+
+  /*
+   * All the threads were busy in the first window, idle in the second.
+   */
+  ret = gallus_thread_pool_trim(&p);
+  TEST_ASSERT_EQUAL_MESSAGE(0, ret, "trimmed busy threads.");
+  ret = gallus_thread_pool_trim(&p);
+  TEST_ASSERT_EQUAL_MESSAGE(n_max - 2, ret, "trim error.");
+
+  ret = gallus_thread_pool_get_stats(&p, &st);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "stats error.");
+  TEST_ASSERT_EQUAL_MESSAGE(2, st.m_n_cur, "not shrunk to the min.");
+  TEST_ASSERT_EQUAL(n_max - 2, st.m_n_retired);
+  ret = gallus_thread_pool_get_outstanding_thread_num(&p);
+  TEST_ASSERT_EQUAL_MESSAGE(n_max, ret, "outstanding thread num error.");
+
+  /* grows again. */
+  for (i = 0; i < n_max; i++) {
+    thds[i] = NULL;
+    ret = gallus_thread_pool_acquire_thread(&p, &thds[i], -1LL);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "thread acquisition error.");
+  }
+  for (i = 0; i < n_max; i++) {
+    ret = gallus_thread_pool_release_thread(&thds[i]);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "thread release error.");
+  }
+  ret = gallus_thread_pool_get_stats(&p, &st);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "stats error.");
+  TEST_ASSERT_EQUAL(n_max, st.m_n_cur);
+  TEST_ASSERT_EQUAL(n_max * 2 - 2, st.m_n_created);
+
+  ret = gallus_thread_pool_shutdown_all(&p, SHUTDOWN_GRACEFULLY, -1LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "shutdown error.");
+  ret = gallus_thread_pool_wait_all(&p, -1LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "wait error.");
+  gallus_thread_pool_destroy(&p);
+}
+
+
+void
+test_elastic_idle_reaping(void) {
+  size_t n_max = 4;
+
+  gallus_thread_pool_t p = NULL;
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+  gallus_pooled_thread_t thds[n_max];
+  gallus_pool_stats_t st;
+  test_task_t tsk = NULL;
+  size_t i;
+
+  ret = gallus_thread_pool_create_elastic(&p, "test elastic", 1, n_max,
+                                          50LL * 1000LL * 1000LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "elastic pool create error.");
+
+  for (i = 0; i < n_max; i++) {
+    thds[i] = NULL;
+    ret = gallus_thread_pool_acquire_thread(&p, &thds[i], -1LL);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "thread acquisition error.");
+  }
+  for (i = 0; i < n_max; i++) {
+    ret = gallus_thread_pool_release_thread(&thds[i]);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                              "thread release error.");
+  }
+
+  /* a couple of idle windows. */
+  for (i = 0; i < 100; i++) {
+    usleep(20 * 1000);
+    ret = gallus_thread_pool_get_stats(&p, &st);
+    TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "stats error.");
+    if (st.m_n_cur == 1) {
+      break;
+    }
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(1, st.m_n_cur, "idle threads not reaped.");
+  TEST_ASSERT_EQUAL(n_max - 1, st.m_n_retired);
+
+  /* the survivor still runs tasks. */
+  ret = s_create_test_task(&tsk, "test elastic", 0);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "task create error.");
+  ret = gallus_thread_pool_acquire_thread(&p, &thds[0], -1LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret,
+                            "thread acquisition error.");
+  ret = gallus_task_run((gallus_task_t *)&tsk, &thds[0],
+                        GALLUS_TASK_RELEASE_THREAD_AFTER_EXEC);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "task start error.");
+  ret = gallus_task_wait((gallus_task_t *)&tsk, -1LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "task wait error.");
+  ret = gallus_task_get_exit_code((gallus_task_t *)&tsk);
+  TEST_ASSERT_EQUAL_MESSAGE(10, ret, "exit code error.");
+  s_destroy_test_task(&tsk);
+
+  ret = gallus_thread_pool_shutdown_all(&p, SHUTDOWN_GRACEFULLY, -1LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "shutdown error.");
+  ret = gallus_thread_pool_wait_all(&p, -1LL);
+  TEST_ASSERT_EQUAL_MESSAGE(GALLUS_RESULT_OK, ret, "wait error.");
+  gallus_thread_pool_destroy(&p);
+}
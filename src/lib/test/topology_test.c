@@ -0,0 +1,95 @@
+#include "gallus_apis.h"
+#include "unity.h"
+
+
+
+
+
+void
+setUp(void) {
+}
+
+
+void
+tearDown(void) {
+}
+
+
+
+
+
+void
+test_cpu_info(void) {
+  gallus_cpu_info_t ci;
+
+  TEST_ASSERT_TRUE(gallus_topology_get_cpu_num() >= 1);
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_topology_get_cpu_info(0, &ci));
+  TEST_ASSERT_EQUAL(0, ci.m_cpu);
+  TEST_ASSERT_EQUAL(0, ci.m_core);
+  TEST_ASSERT_TRUE(ci.m_n_smt >= 1);
+  TEST_ASSERT_TRUE(ci.m_l2 <= ci.m_cpu);
+  TEST_ASSERT_TRUE(ci.m_l3 <= ci.m_l2);
+}
+
+
+void
+test_cpu_info_invalid(void) {
+  gallus_cpu_info_t ci;
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_topology_get_cpu_info(-1, &ci));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_topology_get_cpu_info(0, NULL));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OUT_OF_RANGE,
+                    gallus_topology_get_cpu_info(
+                      (int)gallus_topology_get_cpu_num(), &ci));
+}
+
+
+void
+test_usable_cpus(void) {
+  size_t n = gallus_topology_get_cpu_num();
+  int *cpus = (int *)malloc(sizeof(int) * n);
+  gallus_cpu_info_t a, b;
+  gallus_result_t r;
+  gallus_result_t i;
+
+  TEST_ASSERT_NOT_NULL(cpus);
+
+  r = gallus_topology_get_usable_cpus(cpus, n);
+  TEST_ASSERT_TRUE(r >= 1);
+  TEST_ASSERT_TRUE((size_t)r <= n);
+
+  /* the neighbors never go back to a farther domain. */
+  for (i = 1; i < r; i++) {
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                      gallus_topology_get_cpu_info(cpus[i - 1], &a));
+    TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                      gallus_topology_get_cpu_info(cpus[i], &b));
+    TEST_ASSERT_TRUE(a.m_node <= b.m_node);
+  }
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_topology_get_usable_cpus(NULL, n));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_INVALID_ARGS,
+                    gallus_topology_get_usable_cpus(cpus, 0));
+
+  free((void *)cpus);
+}
+
+
+void
+test_bbq_on_cpu(void) {
+  gallus_bbq_t q = NULL;
+  int v = 1;
+
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK,
+                    gallus_bbq_create_on_cpu(&q, int, 16, NULL, 0));
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_bbq_put(&q, &v, int, -1LL));
+  v = 0;
+  TEST_ASSERT_EQUAL(GALLUS_RESULT_OK, gallus_bbq_get(&q, &v, int, -1LL));
+  TEST_ASSERT_EQUAL(1, v);
+  gallus_bbq_shutdown(&q, true);
+  gallus_bbq_destroy(&q, true);
+}
@@ -0,0 +1,343 @@
+#include "gallus_apis.h"
+
+
+
+
+
+#define SYSFS_CPU_DIR	"/sys/devices/system/cpu"
+#define MAX_CACHE_INDEX	16
+
+
+
+
+
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+static bool s_is_inited = false;
+
+static gallus_cpu_info_t *s_cpus = NULL;
+static size_t s_n_cpus = 0;
+
+static void s_ctors(void) __attr_constructor__(106);
+static void s_dtors(void) __attr_destructor__(106);
+
+
+
+
+
+static inline bool
+s_read_line(const char *path, char *buf, size_t len) {
+  bool ret = false;
+  FILE *fp = fopen(path, "r");
+
+  if (fp != NULL) {
+    if (fgets(buf, (int)len, fp) != NULL) {
+      buf[strcspn(buf, "\n")] = '\0';
+      ret = true;
+    }
+    (void)fclose(fp);
+  }
+
+  return ret;
+}
+
+
+static inline int
+s_read_int(const char *path, int dflt) {
+  char buf[64];
+
+  if (s_read_line(path, buf, sizeof(buf)) == true) {
+    return (int)strtol(buf, NULL, 10);
+  }
+
+  return dflt;
+}
+
+
+/*
+ * Parse a cpu list like "0-3,8-11"; returns the lowest cpu and the #
+ * of the cpus in the list.
+ */
+static inline int
+s_parse_cpu_list(const char *str, size_t *nptr) {
+  int lowest = -1;
+  size_t n = 0;
+  const char *p = str;
+  char *e = NULL;
+  long b, l;
+
+  while (*p != '\0') {
+    b = strtol(p, &e, 10);
+    if (e == p) {
+      break;
+    }
+    l = b;
+    if (*e == '-') {
+      p = e + 1;
+      l = strtol(p, &e, 10);
+      if (e == p) {
+        break;
+      }
+    }
+    if (l >= b) {
+      if (lowest < 0 || b < lowest) {
+        lowest = (int)b;
+      }
+      n += (size_t)(l - b + 1);
+    }
+    if (*e != ',') {
+      break;
+    }
+    p = e + 1;
+  }
+
+  if (nptr != NULL) {
+    *nptr = n;
+  }
+
+  return lowest;
+}
+
+
+static inline int
+s_read_cpu_list(const char *path, size_t *nptr) {
+  char buf[1024];
+
+  if (s_read_line(path, buf, sizeof(buf)) == true) {
+    return s_parse_cpu_list(buf, nptr);
+  }
+
+  return -1;
+}
+
+
+static void
+s_load_cpu(int cpu, gallus_cpu_info_t *ci) {
+  char path[PATH_MAX];
+  char buf[64];
+  size_t n = 0;
+  int v;
+  int i;
+
+  /*
+   * Private unless the sysfs tells otherwise.
+   */
+  ci->m_cpu = cpu;
+  ci->m_core = cpu;
+  ci->m_package = 0;
+  ci->m_node = gallus_numa_node_of_cpu(cpu);
+  ci->m_l2 = cpu;
+  ci->m_l3 = cpu;
+  ci->m_n_smt = 1;
+
+  snprintf(path, sizeof(path),
+           SYSFS_CPU_DIR "/cpu%d/topology/physical_package_id", cpu);
+  if ((v = s_read_int(path, -1)) >= 0) {
+    ci->m_package = v;
+  }
+
+  snprintf(path, sizeof(path),
+           SYSFS_CPU_DIR "/cpu%d/topology/thread_siblings_list", cpu);
+  if ((v = s_read_cpu_list(path, &n)) >= 0 && n > 0) {
+    ci->m_core = v;
+    ci->m_n_smt = n;
+  }
+
+  for (i = 0; i < MAX_CACHE_INDEX; i++) {
+    int level;
+
+    snprintf(path, sizeof(path),
+             SYSFS_CPU_DIR "/cpu%d/cache/index%d/level", cpu, i);
+    if ((level = s_read_int(path, -1)) < 0) {
+      break;
+    }
+    snprintf(path, sizeof(path),
+             SYSFS_CPU_DIR "/cpu%d/cache/index%d/type", cpu, i);
+    if (s_read_line(path, buf, sizeof(buf)) == true &&
+        strcmp(buf, "Instruction") == 0) {
+      continue;
+    }
+    snprintf(path, sizeof(path),
+             SYSFS_CPU_DIR "/cpu%d/cache/index%d/shared_cpu_list", cpu, i);
+    if ((v = s_read_cpu_list(path, NULL)) < 0) {
+      continue;
+    }
+    if (level == 2) {
+      ci->m_l2 = v;
+    } else if (level == 3) {
+      ci->m_l3 = v;
+    }
+  }
+
+  /*
+   * No L3: the L2 is the last level.
+   */
+  if (ci->m_l3 == cpu && ci->m_l2 != cpu) {
+    ci->m_l3 = ci->m_l2;
+  }
+}
+
+
+static int
+s_cmp_cpu(const void *a, const void *b) {
+  const gallus_cpu_info_t *x = &s_cpus[*(const int *)a];
+  const gallus_cpu_info_t *y = &s_cpus[*(const int *)b];
+
+#define cmp_member(mem)                         \
+  if (x->mem != y->mem) {                       \
+    return (x->mem < y->mem) ? -1 : 1;          \
+  }
+
+  cmp_member(m_node);
+  cmp_member(m_package);
+  cmp_member(m_l3);
+  cmp_member(m_l2);
+  cmp_member(m_core);
+  cmp_member(m_cpu);
+#undef cmp_member
+
+  return 0;
+}
+
+
+
+
+
+static void
+s_once_proc(void) {
+  long n = sysconf(_SC_NPROCESSORS_CONF);
+  size_t i;
+
+  if (n <= 0) {
+    n = 1;
+  }
+
+  s_cpus = (gallus_cpu_info_t *)malloc(sizeof(gallus_cpu_info_t) *
+                                       (size_t)n);
+  if (s_cpus != NULL) {
+    for (i = 0; i < (size_t)n; i++) {
+      s_load_cpu((int)i, &s_cpus[i]);
+    }
+    s_n_cpus = (size_t)n;
+    s_is_inited = true;
+  } else {
+    gallus_exit_fatal("can't initialize the CPU topology table.\n");
+  }
+}
+
+
+static inline void
+s_init(void) {
+  (void)pthread_once(&s_once, s_once_proc);
+}
+
+
+static void
+s_ctors(void) {
+  s_init();
+
+  gallus_msg_debug(10, "The CPU topology module is initialized.\n");
+}
+
+
+static void
+s_dtors(void) {
+  if (s_is_inited == true) {
+    free((void *)s_cpus);
+    s_cpus = NULL;
+    s_n_cpus = 0;
+
+    gallus_msg_debug(10, "The CPU topology module is finalized.\n");
+  }
+}
+
+
+
+
+
+size_t
+gallus_topology_get_cpu_num(void) {
+  s_init();
+
+  return s_n_cpus;
+}
+
+
+gallus_result_t
+gallus_topology_get_cpu_info(int cpu, gallus_cpu_info_t *info) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  s_init();
+
+  if (likely(cpu >= 0 && info != NULL)) {
+    if (likely((size_t)cpu < s_n_cpus)) {
+      *info = s_cpus[cpu];
+      ret = GALLUS_RESULT_OK;
+    } else {
+      ret = GALLUS_RESULT_OUT_OF_RANGE;
+    }
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}
+
+
+gallus_result_t
+gallus_topology_get_usable_cpus(int *cpus, size_t n) {
+  gallus_result_t ret = GALLUS_RESULT_ANY_FAILURES;
+
+  s_init();
+
+  if (likely(cpus != NULL && n > 0)) {
+    int *all = (int *)malloc(sizeof(int) * s_n_cpus);
+    size_t n_all = 0;
+    size_t i;
+
+    if (unlikely(all == NULL)) {
+      return GALLUS_RESULT_NO_MEMORY;
+    }
+
+#ifdef GALLUS_OS_LINUX
+    {
+      cpu_set_t *set = CPU_ALLOC(s_n_cpus);
+      size_t set_sz = CPU_ALLOC_SIZE(s_n_cpus);
+
+      if (unlikely(set == NULL)) {
+        free((void *)all);
+        return GALLUS_RESULT_NO_MEMORY;
+      }
+      CPU_ZERO_S(set_sz, set);
+      if (unlikely(sched_getaffinity(0, set_sz, set) != 0)) {
+        CPU_FREE(set);
+        free((void *)all);
+        return GALLUS_RESULT_POSIX_API_ERROR;
+      }
+      for (i = 0; i < s_n_cpus; i++) {
+        if (CPU_ISSET_S(i, set_sz, set)) {
+          all[n_all++] = (int)i;
+        }
+      }
+      CPU_FREE(set);
+    }
+#else
+    for (i = 0; i < s_n_cpus; i++) {
+      all[n_all++] = (int)i;
+    }
+#endif /* GALLUS_OS_LINUX */
+
+    qsort((void *)all, n_all, sizeof(int), s_cmp_cpu);
+
+    if (n_all > n) {
+      n_all = n;
+    }
+    (void)memcpy((void *)cpus, (void *)all, sizeof(int) * n_all);
+    free((void *)all);
+
+    ret = (gallus_result_t)n_all;
+  } else {
+    ret = GALLUS_RESULT_INVALID_ARGS;
+  }
+
+  return ret;
+}